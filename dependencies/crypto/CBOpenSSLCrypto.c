@@ -17,6 +17,8 @@
 #include "CBDependencies.h" // cbitcoin dependencies to implement
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 #include <openssl/sha.h>
 #include <openssl/ripemd.h>
 #include <openssl/ssl.h>
@@ -24,6 +26,58 @@
 
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations" // For OSX Lion
 
+// Constants
+
+#define CB_ECDSA_MAX_PUBKEY_SIZE 65
+#define CB_ECDSA_THREAD_CACHE_SIZE 1024
+
+// Types
+
+/**
+ @brief A parsed public key in the verification cache.
+ */
+typedef struct{
+	unsigned char pubKey[CB_ECDSA_MAX_PUBKEY_SIZE]; /**< The serialised public key this entry was parsed from. */
+	int keyLen; /**< The length of the serialised public key, or zero when the entry is unused. */
+	EC_KEY * key; /**< The parsed key. The EC_KEY is kept when the entry is evicted, so it can be reused for another public key without setting up the group again. */
+	int hashNext; /**< The next entry in the same hash bucket or -1. */
+	int lruPrev; /**< The more recently used entry or -1. */
+	int lruNext; /**< The less recently used entry or -1. */
+} CBEcdsaKeyCacheEntry;
+
+/**
+ @brief A verification context with a least-recently-used cache of parsed public keys.
+ */
+typedef struct{
+	CBEcdsaKeyCacheEntry * entries;
+	int * buckets; /**< The first entry for each hash bucket or -1. */
+	int cacheSize;
+	int numBuckets; /**< Power of two. */
+	int numUsed; /**< The number of entries which have been taken from the array. */
+	int freeHead; /**< Entries that were taken but hold no key, linked by hashNext, or -1. */
+	int lruHead; /**< The most recently used entry or -1. */
+	int lruTail; /**< The least recently used entry or -1. */
+} CBEcdsaVerifyContext;
+
+// Thread-local context used by CBEcdsaVerify
+
+pthread_key_t CBEcdsaThreadContextKey;
+pthread_once_t CBEcdsaThreadContextOnce = PTHREAD_ONCE_INIT;
+
+// Check that the OpenSSL contexts fit into the cbitcoin contexts
+
+typedef char CBSha256ContextSizeCheck[sizeof(SHA256_CTX) <= CB_SHA256_CONTEXT_SIZE ? 1 : -1];
+typedef char CBSha512ContextSizeCheck[sizeof(SHA512_CTX) <= CB_SHA512_CONTEXT_SIZE ? 1 : -1];
+
+// Prototypes
+
+static void CBEcdsaThreadContextFree(void * vctx);
+static void CBEcdsaThreadContextKeyCreate(void);
+static uint32_t CBEcdsaPubKeyHash(unsigned char * pubKey, int keyLen);
+static void CBEcdsaVerifyContextUnlink(CBEcdsaVerifyContext * ctx, int index);
+static void CBEcdsaVerifyContextMakeHead(CBEcdsaVerifyContext * ctx, int index);
+static EC_KEY * CBEcdsaVerifyContextGetKey(CBEcdsaVerifyContext * ctx, unsigned char * pubKey, int keyLen);
+
 // Implementation
 
 void CBAddPoints(unsigned char * point1, unsigned char * point2) {
@@ -127,6 +181,110 @@ void CBSha512(unsigned char * data, int len, unsigned char * output) {
 	
 }
 
+void CBSha256Init(CBSha256Context * ctx) {
+	
+	SHA256_Init((SHA256_CTX *)ctx);
+	
+}
+
+void CBSha256Update(CBSha256Context * ctx, unsigned char * data, int length) {
+	
+	SHA256_Update((SHA256_CTX *)ctx, data, length);
+	
+}
+
+void CBSha256Final(CBSha256Context * ctx, unsigned char * output) {
+	
+	SHA256_Final(output, (SHA256_CTX *)ctx);
+	
+}
+
+void CBSha256GetMidstate(CBSha256Context * uctx, unsigned char * midstate) {
+	
+	SHA256_CTX * ctx = (SHA256_CTX *)uctx;
+	
+	for (int x = 0; x < 8; x++) {
+		CBInt32ToArrayBigEndian(midstate, x * 4, ctx->h[x]);
+	}
+	
+	// Nl and Nh hold the length in bits
+	uint64_t length = (((uint64_t)ctx->Nh << 32) | ctx->Nl) >> 3;
+	CBInt64ToArray(midstate, 32, length);
+	
+	memset(midstate + 40, 0, 64);
+	memcpy(midstate + 40, ctx->data, ctx->num);
+	
+}
+
+void CBSha256SetMidstate(CBSha256Context * uctx, unsigned char * midstate) {
+	
+	SHA256_CTX * ctx = (SHA256_CTX *)uctx;
+	
+	SHA256_Init(ctx);
+	for (int x = 0; x < 8; x++)
+		ctx->h[x] = CBArrayToInt32BigEndian(midstate, x * 4);
+	
+	uint64_t length = CBArrayToInt64(midstate, 32);
+	ctx->Nl = (SHA_LONG)(length << 3);
+	ctx->Nh = (SHA_LONG)(length >> 29);
+	
+	ctx->num = length % SHA256_CBLOCK;
+	memcpy(ctx->data, midstate + 40, ctx->num);
+	
+}
+
+void CBSha512Init(CBSha512Context * ctx) {
+	
+	SHA512_Init((SHA512_CTX *)ctx);
+	
+}
+
+void CBSha512Update(CBSha512Context * ctx, unsigned char * data, int length) {
+	
+	SHA512_Update((SHA512_CTX *)ctx, data, length);
+	
+}
+
+void CBSha512Final(CBSha512Context * ctx, unsigned char * output) {
+	
+	SHA512_Final(output, (SHA512_CTX *)ctx);
+	
+}
+
+void CBSha512GetMidstate(CBSha512Context * uctx, unsigned char * midstate) {
+	
+	SHA512_CTX * ctx = (SHA512_CTX *)uctx;
+	
+	for (int x = 0; x < 8; x++) {
+		CBInt64ToArrayBigEndian(midstate, x * 8, ctx->h[x]);
+	}
+	
+	// Nl holds the low 64 bits of the length in bits and Nh the high 64 bits.
+	uint64_t length = (ctx->Nl >> 3) | (ctx->Nh << 61);
+	CBInt64ToArray(midstate, 64, length);
+	
+	memset(midstate + 72, 0, 128);
+	memcpy(midstate + 72, ctx->u.p, ctx->num);
+	
+}
+
+void CBSha512SetMidstate(CBSha512Context * uctx, unsigned char * midstate) {
+	
+	SHA512_CTX * ctx = (SHA512_CTX *)uctx;
+	
+	SHA512_Init(ctx);
+	for (int x = 0; x < 8; x++)
+		ctx->h[x] = CBArrayToInt64BigEndian(midstate, x * 8);
+	
+	uint64_t length = CBArrayToInt64(midstate, 64);
+	ctx->Nl = length << 3;
+	ctx->Nh = length >> 61;
+	
+	ctx->num = length % SHA512_CBLOCK;
+	memcpy(ctx->u.p, midstate + 72, ctx->num);
+	
+}
+
 void CBRipemd160(unsigned char * data, int len, unsigned char * output) {
 	
 	RIPEMD160(data, len, output);
@@ -135,18 +293,198 @@ void CBRipemd160(unsigned char * data, int len, unsigned char * output) {
 
 bool CBEcdsaVerify(unsigned char * signature, int sigLen, unsigned char * hash, unsigned char * pubKey, int keyLen) {
 	
-	EC_KEY * eckey, * key;
-	int res = 0;
+	// Use a context local to this thread so that parsed public keys are reused between calls.
+	pthread_once(&CBEcdsaThreadContextOnce, CBEcdsaThreadContextKeyCreate);
+	CBDepObject ctx;
+	ctx.ptr = pthread_getspecific(CBEcdsaThreadContextKey);
+	if (ctx.ptr == NULL) {
+		if (!CBNewEcdsaVerifyContext(&ctx, CB_ECDSA_THREAD_CACHE_SIZE))
+			return false;
+		pthread_setspecific(CBEcdsaThreadContextKey, ctx.ptr);
+	}
+	
+	return CBEcdsaVerifyWithContext(ctx, signature, sigLen, hash, pubKey, keyLen);
+	
+}
+
+static void CBEcdsaThreadContextFree(void * vctx) {
+	
+	CBFreeEcdsaVerifyContext((CBDepObject){.ptr = vctx});
+	
+}
+
+static void CBEcdsaThreadContextKeyCreate(void) {
+	
+	pthread_key_create(&CBEcdsaThreadContextKey, CBEcdsaThreadContextFree);
+	
+}
+
+static uint32_t CBEcdsaPubKeyHash(unsigned char * pubKey, int keyLen) {
+	
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	for (int x = 0; x < keyLen; x++) {
+		hash ^= pubKey[x];
+		hash *= 16777619u;
+	}
+	
+	return hash;
+	
+}
+
+bool CBNewEcdsaVerifyContext(CBDepObject * uctx, int cacheSize) {
+	
+	if (cacheSize < 1)
+		cacheSize = 1;
+	
+	CBEcdsaVerifyContext * ctx = malloc(sizeof(*ctx));
+	if (ctx == NULL)
+		return false;
+	
+	// Use at least twice as many buckets as entries to keep chains short.
+	ctx->numBuckets = 1;
+	while (ctx->numBuckets < cacheSize * 2)
+		ctx->numBuckets <<= 1;
+	
+	ctx->entries = malloc(sizeof(*ctx->entries) * cacheSize);
+	ctx->buckets = malloc(sizeof(*ctx->buckets) * ctx->numBuckets);
+	if (ctx->entries == NULL || ctx->buckets == NULL) {
+		free(ctx->entries);
+		free(ctx->buckets);
+		free(ctx);
+		return false;
+	}
+	
+	ctx->cacheSize = cacheSize;
+	ctx->numUsed = 0;
+	ctx->freeHead = -1;
+	ctx->lruHead = ctx->lruTail = -1;
+	for (int x = 0; x < ctx->numBuckets; x++)
+		ctx->buckets[x] = -1;
+	for (int x = 0; x < cacheSize; x++) {
+		ctx->entries[x].keyLen = 0;
+		ctx->entries[x].key = NULL;
+	}
+	
+	uctx->ptr = ctx;
+	
+	return true;
+	
+}
+
+void CBFreeEcdsaVerifyContext(CBDepObject uctx) {
+	
+	CBEcdsaVerifyContext * ctx = uctx.ptr;
+	
+	for (int x = 0; x < ctx->cacheSize; x++)
+		EC_KEY_free(ctx->entries[x].key);
+	
+	free(ctx->entries);
+	free(ctx->buckets);
+	free(ctx);
+	
+}
+
+static void CBEcdsaVerifyContextUnlink(CBEcdsaVerifyContext * ctx, int index) {
+	
+	CBEcdsaKeyCacheEntry * entry = ctx->entries + index;
+	
+	if (entry->lruPrev == -1)
+		ctx->lruHead = entry->lruNext;
+	else
+		ctx->entries[entry->lruPrev].lruNext = entry->lruNext;
+	
+	if (entry->lruNext == -1)
+		ctx->lruTail = entry->lruPrev;
+	else
+		ctx->entries[entry->lruNext].lruPrev = entry->lruPrev;
+	
+}
+
+static void CBEcdsaVerifyContextMakeHead(CBEcdsaVerifyContext * ctx, int index) {
+	
+	CBEcdsaKeyCacheEntry * entry = ctx->entries + index;
 	
-	eckey = key = EC_KEY_new_by_curve_name(NID_secp256k1);
-	o2i_ECPublicKey(&key, (const unsigned char **)&pubKey, keyLen);
+	entry->lruPrev = -1;
+	entry->lruNext = ctx->lruHead;
+	if (ctx->lruHead != -1)
+		ctx->entries[ctx->lruHead].lruPrev = index;
+	ctx->lruHead = index;
+	if (ctx->lruTail == -1)
+		ctx->lruTail = index;
+	
+}
+
+static EC_KEY * CBEcdsaVerifyContextGetKey(CBEcdsaVerifyContext * ctx, unsigned char * pubKey, int keyLen) {
+	
+	int bucket = CBEcdsaPubKeyHash(pubKey, keyLen) & (ctx->numBuckets - 1);
+	
+	// Look for the key in the cache
+	for (int x = ctx->buckets[bucket]; x != -1; x = ctx->entries[x].hashNext) {
+		CBEcdsaKeyCacheEntry * entry = ctx->entries + x;
+		if (entry->keyLen == keyLen && memcmp(entry->pubKey, pubKey, keyLen) == 0) {
+			// Found the key, so move it to the front of the LRU list.
+			if (ctx->lruHead != x) {
+				CBEcdsaVerifyContextUnlink(ctx, x);
+				CBEcdsaVerifyContextMakeHead(ctx, x);
+			}
+			return entry->key;
+		}
+	}
+	
+	// Not in the cache. Take a free entry, a new entry or evict the least recently used one.
+	int index;
+	if (ctx->freeHead != -1) {
+		index = ctx->freeHead;
+		ctx->freeHead = ctx->entries[index].hashNext;
+	}else if (ctx->numUsed < ctx->cacheSize)
+		index = ctx->numUsed++;
+	else{
+		index = ctx->lruTail;
+		CBEcdsaKeyCacheEntry * evict = ctx->entries + index;
+		CBEcdsaVerifyContextUnlink(ctx, index);
+		// Remove from its hash bucket
+		int * link = ctx->buckets + (CBEcdsaPubKeyHash(evict->pubKey, evict->keyLen) & (ctx->numBuckets - 1));
+		while (*link != index)
+			link = &ctx->entries[*link].hashNext;
+		*link = evict->hashNext;
+		evict->keyLen = 0;
+	}
+	
+	CBEcdsaKeyCacheEntry * entry = ctx->entries + index;
+	
+	// An evicted EC_KEY already has the group and is reused.
+	if (entry->key == NULL)
+		entry->key = EC_KEY_new_by_curve_name(NID_secp256k1);
+	
+	const unsigned char * keyPtr = pubKey;
+	if (entry->key == NULL || o2i_ECPublicKey(&entry->key, &keyPtr, keyLen) == NULL) {
+		// Invalid public key, so do not cache it and place the entry on the free list.
+		ERR_clear_error();
+		entry->hashNext = ctx->freeHead;
+		ctx->freeHead = index;
+		return NULL;
+	}
+	
+	memcpy(entry->pubKey, pubKey, keyLen);
+	entry->keyLen = keyLen;
+	entry->hashNext = ctx->buckets[bucket];
+	ctx->buckets[bucket] = index;
+	CBEcdsaVerifyContextMakeHead(ctx, index);
+	
+	return entry->key;
+	
+}
+
+bool CBEcdsaVerifyWithContext(CBDepObject uctx, unsigned char * signature, int sigLen, unsigned char * hash, unsigned char * pubKey, int keyLen) {
 	
-	// If o2i_ECPublicKey fails it makes key equal to NULL.
-	if (key != NULL)
-		res = ECDSA_verify(0, hash, 32, signature, sigLen, key);
+	if (keyLen < 1 || keyLen > CB_ECDSA_MAX_PUBKEY_SIZE)
+		return false;
 	
-	EC_KEY_free(eckey);
+	EC_KEY * key = CBEcdsaVerifyContextGetKey(uctx.ptr, pubKey, keyLen);
+	if (key == NULL)
+		return false;
 	
-	return res == 1;
+	return ECDSA_verify(0, hash, 32, signature, sigLen, key) == 1;
 	
 }
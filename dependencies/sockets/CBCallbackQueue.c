@@ -13,74 +13,183 @@
 //  LICENSE file.
 
 #include "CBCallbackQueue.h"
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+pthread_mutex_t CBCallbackQueueWaitMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t CBCallbackQueueWaitCond = PTHREAD_COND_INITIALIZER;
+#endif
+
+__thread CBCallbackQueueItem * CBCallbackQueueCache = NULL; // Items for callbacks which do not block.
+__thread bool CBCallbackQueueCacheRegistered = false; // True when the cache is freed when the thread exits.
+__thread CBCallbackQueue * CBCallbackQueueRunning = NULL; // The queue being run by this thread.
+pthread_key_t CBCallbackQueueCacheKey;
+pthread_once_t CBCallbackQueueCacheOnce = PTHREAD_ONCE_INIT;
 
 void CBInitCallbackQueue(CBCallbackQueue * queue){
-	CBNewMutex(&queue->queueMutex);
-	queue->first = NULL;
+	queue->stub.next = NULL;
+	queue->head = queue->tail = &queue->stub;
+	queue->local = NULL;
+	queue->free = NULL;
+	queue->signalled = false;
 }
-CBCallbackQueueItem * CBCallbackQueueAdd(CBCallbackQueue * queue, void (*callback)(void *), void * arg, bool * nblock){
-	CBMutexLock(queue->queueMutex);
-	CBCallbackQueueItem * item = malloc(!*nblock ? sizeof(CBCallbackQueueItemBlocking) : sizeof(CBCallbackQueueItem));
-	item->userArg = arg;
+void CBInitCallbackQueueItem(CBCallbackQueueItem * item, void (*callback)(void *), void * arg, bool blocking){
 	item->userCallback = callback;
-	if (queue->first == NULL)
-		queue->first = queue->last = item;
-	else
-		queue->last = queue->last->next = item;
-	item->next = NULL;
-	CBCallbackQueueItemBlocking * blockingItem;
-	queue->last->blocking = !*nblock;
-	if (!*nblock) {
-		blockingItem = (CBCallbackQueueItemBlocking *)queue->last;
-		blockingItem->done = nblock;
-		CBNewCondition(&blockingItem->cond);
-		CBNewMutex(&blockingItem->mutex);
+	item->userArg = arg;
+	item->blocking = blocking;
+	item->cached = false;
+	item->done = 0;
+}
+void CBCallbackQueueCacheFree(void * unused){
+	UNUSED(unused);
+	while (CBCallbackQueueCache) {
+		CBCallbackQueueItem * item = CBCallbackQueueCache;
+		CBCallbackQueueCache = item->next;
+		free(item);
+	}
+}
+void CBCallbackQueueCacheKeyCreate(void){
+	pthread_key_create(&CBCallbackQueueCacheKey, CBCallbackQueueCacheFree);
+}
+CBCallbackQueueItem * CBCallbackQueueNewItem(CBCallbackQueue * queue, void (*callback)(void *), void * arg){
+	CBCallbackQueueItem * item = CBCallbackQueueCache;
+	if (! item) {
+		// Take all of the items which have been run. Taking them all at once cannot be confused by items being reused.
+		item = __atomic_exchange_n(&queue->free, NULL, __ATOMIC_ACQUIRE);
+		if (! item) {
+			item = malloc(sizeof(*item));
+			if (! item)
+				return NULL;
+			item->cached = true;
+			item->next = NULL;
+		}
+		if (! CBCallbackQueueCacheRegistered) {
+			// Free the cache when the thread exits.
+			pthread_once(&CBCallbackQueueCacheOnce, CBCallbackQueueCacheKeyCreate);
+			pthread_setspecific(CBCallbackQueueCacheKey, queue);
+			CBCallbackQueueCacheRegistered = true;
+		}
 	}
-	CBMutexUnlock(queue->queueMutex);
+	CBCallbackQueueCache = item->next;
+	item->userCallback = callback;
+	item->userArg = arg;
+	item->blocking = false;
 	return item;
 }
+CBCallbackQueueItem * CBCallbackQueuePop(CBCallbackQueue * queue){
+	CBCallbackQueueItem * tail = queue->tail;
+	CBCallbackQueueItem * next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+	if (tail == &queue->stub) {
+		if (! next)
+			return NULL;
+		queue->tail = tail = next;
+		next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+	}
+	if (next) {
+		queue->tail = next;
+		return tail;
+	}
+	if (tail != __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE))
+		// A producer has taken the head but not linked its item yet. It wakes the consumer when it has.
+		return NULL;
+	// Put the stub behind the last item so that the last item can be taken.
+	CBCallbackQueuePushShared(queue, &queue->stub);
+	next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+	if (next) {
+		queue->tail = next;
+		return tail;
+	}
+	return NULL;
+}
+bool CBCallbackQueuePush(CBCallbackQueue * queue, CBCallbackQueueItem * item){
+	if (CBCallbackQueueRunning == queue) {
+		// Given by a callback of this queue, so run it after that callback.
+		item->next = NULL;
+		if (queue->local)
+			queue->localLast->next = item;
+		else
+			queue->local = item;
+		queue->localLast = item;
+		return false;
+	}
+	CBCallbackQueuePushShared(queue, item);
+	// Only wake the consumer if no other producer has since it started running the queue.
+	return ! __atomic_exchange_n(&queue->signalled, true, __ATOMIC_SEQ_CST);
+}
+void CBCallbackQueuePushShared(CBCallbackQueue * queue, CBCallbackQueueItem * item){
+	__atomic_store_n(&item->next, NULL, __ATOMIC_RELAXED);
+	CBCallbackQueueItem * prev = __atomic_exchange_n(&queue->head, item, __ATOMIC_ACQ_REL);
+	__atomic_store_n(&prev->next, item, __ATOMIC_RELEASE);
+}
 void CBCallbackQueueWait(CBCallbackQueueItem * item){
-	CBCallbackQueueItemBlocking * blockingItem = (CBCallbackQueueItemBlocking *)item;
-	CBMutexLock(blockingItem->mutex);
-	if (!*blockingItem->done)
-		CBConditionWait(blockingItem->cond, blockingItem->mutex);
-	CBMutexUnlock(blockingItem->mutex);
-	// Free mutex and condition
-	CBFreeMutex(blockingItem->mutex);
-	CBFreeCondition(blockingItem->cond);
-	// Free item
-	free(item);
+#ifdef __linux__
+	while (! __atomic_load_n(&item->done, __ATOMIC_ACQUIRE))
+		syscall(SYS_futex, &item->done, FUTEX_WAIT_PRIVATE, 0, NULL, NULL, 0);
+#else
+	pthread_mutex_lock(&CBCallbackQueueWaitMutex);
+	while (! __atomic_load_n(&item->done, __ATOMIC_ACQUIRE))
+		pthread_cond_wait(&CBCallbackQueueWaitCond, &CBCallbackQueueWaitMutex);
+	pthread_mutex_unlock(&CBCallbackQueueWaitMutex);
+#endif
+}
+void CBCallbackQueueWake(CBCallbackQueueItem * item){
+	// The item belongs to the waiting thread, which may return as soon as done is set, so only the address is used after.
+	__atomic_store_n(&item->done, 1, __ATOMIC_RELEASE);
+#ifdef __linux__
+	syscall(SYS_futex, &item->done, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+	pthread_mutex_lock(&CBCallbackQueueWaitMutex);
+	pthread_cond_broadcast(&CBCallbackQueueWaitCond);
+	pthread_mutex_unlock(&CBCallbackQueueWaitMutex);
+#endif
 }
 void CBCallbackQueueRun(CBCallbackQueue * queue){
-	CBMutexLock(queue->queueMutex);
-	while (queue->first != NULL) {
-		CBCallbackQueueItem * item = queue->first;
-		queue->first = item->next;
-		item->userCallback(item->userArg);
-		// If blocking signal condition and make done
-		if (item->blocking) {
-			CBCallbackQueueItemBlocking * blockingItem = (CBCallbackQueueItemBlocking *)item;
-			CBMutexLock(blockingItem->mutex);
-			*blockingItem->done = true;
-			CBConditionSignal(blockingItem->cond);
-			CBMutexUnlock(blockingItem->mutex);
-		}else
-			// Free item
-			free(item);
+	CBCallbackQueue * outer = CBCallbackQueueRunning;
+	CBCallbackQueueRunning = queue;
+	// Producers adding items from now on wake the consumer again.
+	__atomic_store_n(&queue->signalled, false, __ATOMIC_SEQ_CST);
+	for (;;) {
+		CBCallbackQueueItem * item = queue->local;
+		if (item)
+			queue->local = item->next;
+		else if (! (item = CBCallbackQueuePop(queue)))
+			break;
+		CBCallbackQueueRunItem(queue, item);
 	}
-	CBMutexUnlock(queue->queueMutex);
+	CBCallbackQueueRunning = outer;
+}
+void CBCallbackQueueRunItem(CBCallbackQueue * queue, CBCallbackQueueItem * item){
+	void (*callback)(void *) = item->userCallback;
+	void * arg = item->userArg;
+	if (item->blocking) {
+		callback(arg);
+		CBCallbackQueueWake(item);
+		return;
+	}
+	if (item->cached) {
+		// Give the item back before running the callback, so that it can be reused for callbacks given by the callback.
+		CBCallbackQueueItem * head = __atomic_load_n(&queue->free, __ATOMIC_RELAXED);
+		do
+			item->next = head;
+		while (! __atomic_compare_exchange_n(&queue->free, &head, item, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	}
+	callback(arg);
 }
 void CBFreeCallbackQueue(CBCallbackQueue * queue){
-	CBFreeMutex(queue->queueMutex);
-	while (queue->first != NULL) {
-		CBCallbackQueueItem * item = queue->first;
-		queue->first = queue->first->next;
-		if (item->blocking) {
-			CBCallbackQueueItemBlocking * blockingItem = (CBCallbackQueueItemBlocking *)queue->last;
-			CBFreeMutex(blockingItem->mutex);
-			CBFreeCondition(blockingItem->cond);
-		}
-		// Free item
+	// Free the cached items which were not run. The other items belong to the threads which gave them.
+	CBCallbackQueueItem * item;
+	while ((item = queue->local)) {
+		queue->local = item->next;
+		if (item->cached)
+			free(item);
+	}
+	while ((item = CBCallbackQueuePop(queue)))
+		if (item->cached)
+			free(item);
+	while ((item = queue->free)) {
+		queue->free = item->next;
 		free(item);
 	}
 }
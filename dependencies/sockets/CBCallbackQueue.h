@@ -12,8 +12,14 @@
 //  or distributed except according to the terms contained in the
 //  LICENSE file.
 
+/**
+ @file
+ @brief A queue of callbacks given from any thread and run by the thread of an event loop. Items are added without locks to an intrusive multi-producer single-consumer queue, and callbacks are run without holding anything that producers need. Items for callbacks which do not block are taken from a cache for the thread, which is refilled with the items the queue has run. Blocking callers keep the item on their stack and wait on a futex in it. Callbacks given by a callback while the queue is being run are run straight after it, before the callbacks of other threads which follow.
+ */
+
 #include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include "CBDependencies.h"
 
@@ -23,29 +29,59 @@
 typedef struct CBCallbackQueueItem CBCallbackQueueItem;
 
 struct CBCallbackQueueItem{
+	CBCallbackQueueItem * next;
 	void  (*userCallback)(void *);
 	void * userArg;
-	bool blocking;
-	CBCallbackQueueItem * next;
+	bool blocking; /**< True when a thread waits for the callback with CBCallbackQueueWait. */
+	bool cached; /**< True when the item was given by CBCallbackQueueNewItem and is given back after running. */
+	uint32_t done; /**< Set to 1 when the callback of a blocking item has run. */
 };
 
 typedef struct{
-	CBCallbackQueueItem item;
-	bool * done;
-	CBDepObject cond;
-	CBDepObject mutex;
-} CBCallbackQueueItemBlocking;
-
-typedef struct{
-	CBCallbackQueueItem * first;
-	CBCallbackQueueItem * last;
-	CBDepObject queueMutex;
+	CBCallbackQueueItem * head; /**< The last item added. Exchanged by producers. */
+	CBCallbackQueueItem * tail; /**< The next item to run. Only used by the thread running the queue. */
+	CBCallbackQueueItem stub; /**< Kept in the queue so that producers never find it empty. */
+	CBCallbackQueueItem * local; /**< Items given by callbacks while the queue is being run. */
+	CBCallbackQueueItem * localLast;
+	CBCallbackQueueItem * free; /**< Items which have been run, taken all at once by producers for their caches. */
+	bool signalled; /**< True when the consumer has been woken and has not started running the queue. */
 }CBCallbackQueue;
 
 void CBInitCallbackQueue(CBCallbackQueue * queue);
-CBCallbackQueueItem * CBCallbackQueueAdd(CBCallbackQueue * queue, void (*callback)(void *), void * arg, bool * nblock);
+
+/**
+ @brief Initialises an item owned by the caller, which can be on the stack of a blocking caller.
+ @param item The item.
+ @param callback The callback.
+ @param arg The argument for the callback.
+ @param blocking True if the caller will wait with CBCallbackQueueWait.
+ */
+void CBInitCallbackQueueItem(CBCallbackQueueItem * item, void (*callback)(void *), void * arg, bool blocking);
+
+void CBCallbackQueueCacheFree(void * unused);
+void CBCallbackQueueCacheKeyCreate(void);
+
+/**
+ @brief Gets an item for a callback which does not block from the cache of the thread, taking the items the queue has run when the cache is empty.
+ @returns The item or NULL if it could not be allocated.
+ */
+CBCallbackQueueItem * CBCallbackQueueNewItem(CBCallbackQueue * queue, void (*callback)(void *), void * arg);
+CBCallbackQueueItem * CBCallbackQueuePop(CBCallbackQueue * queue);
+
+/**
+ @brief Adds an item to the queue.
+ @returns true if the consumer should be woken, false if it has been woken already.
+ */
+bool CBCallbackQueuePush(CBCallbackQueue * queue, CBCallbackQueueItem * item);
+void CBCallbackQueuePushShared(CBCallbackQueue * queue, CBCallbackQueueItem * item);
+
+/**
+ @brief Waits for the callback of a blocking item to have run.
+ */
 void CBCallbackQueueWait(CBCallbackQueueItem * item);
+void CBCallbackQueueWake(CBCallbackQueueItem * item);
 void CBCallbackQueueRun(CBCallbackQueue * queue);
+void CBCallbackQueueRunItem(CBCallbackQueue * queue, CBCallbackQueueItem * item);
 void CBFreeCallbackQueue(CBCallbackQueue * queue);
 
 #endif
@@ -0,0 +1,353 @@
+//
+//  CBDNSResolver.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+//  SEE HEADER FILE FOR DOCUMENTATION
+
+#include "CBDNSResolver.h"
+
+pthread_mutex_t CBDNSMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t CBDNSCond = PTHREAD_COND_INITIALIZER;
+CBDNSLookup * CBDNSLookups = NULL; // Lookups which have not been given to their communicators, in the order they were given.
+int CBDNSThreadNum = 0;
+int CBDNSIdleNum = 0;
+uint16_t CBDNSNextID = 0;
+
+void CBDNSAddIP(CBDNSLookup * lookup, unsigned char * ip, bool ipv4){
+	unsigned char ipv6[16] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF};
+	if (ipv4) {
+		memcpy(ipv6 + 12, ip, 4);
+		ip = ipv6;
+	}
+	if (lookup->ipNum == CB_DNS_MAX_ADDRESSES)
+		return;
+	for (int x = 0; x < lookup->ipNum; x++)
+		if (! memcmp(lookup->ips[x], ip, 16))
+			return;
+	memcpy(lookup->ips[lookup->ipNum++], ip, 16);
+}
+int CBDNSBuildQuery(unsigned char * buf, char * domain, uint16_t id, uint16_t type){
+	// Header with recursion desired and one question.
+	memset(buf, 0, 12);
+	buf[0] = id >> 8;
+	buf[1] = id;
+	buf[2] = 1;
+	buf[5] = 1;
+	int len = 12;
+	while (*domain) {
+		char * dot = strchr(domain, '.');
+		int labelLen = dot ? (int)(dot - domain) : (int)strlen(domain);
+		if (! labelLen || labelLen > 63)
+			return 0;
+		buf[len++] = labelLen;
+		memcpy(buf + len, domain, labelLen);
+		len += labelLen;
+		domain += labelLen + (dot != NULL);
+	}
+	buf[len++] = 0;
+	buf[len++] = type >> 8;
+	buf[len++] = type;
+	buf[len++] = 0;
+	buf[len++] = 1;
+	return len;
+}
+bool CBNetworkCommunicatorLoadDNS(void * vcomm, char * domain){
+	if (strlen(domain) > 253)
+		return false;
+	CBDNSLookup * lookup = malloc(sizeof(*lookup));
+	if (! lookup)
+		return false;
+	lookup->comm = vcomm;
+	strcpy(lookup->domain, domain);
+	lookup->ipNum = 0;
+	lookup->started = false;
+	lookup->cancelled = false;
+	lookup->next = NULL;
+	pthread_mutex_lock(&CBDNSMutex);
+	CBDNSLookup ** last = &CBDNSLookups;
+	while (*last)
+		last = &(*last)->next;
+	*last = lookup;
+	if (CBDNSIdleNum)
+		pthread_cond_signal(&CBDNSCond);
+	else if (CBDNSThreadNum < CB_DNS_THREADS) {
+		pthread_t thread;
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+		if (pthread_create(&thread, &attr, CBDNSResolverThread, NULL))
+			CBLogError("Could not create a thread to resolve %s.", domain);
+		else
+			CBDNSThreadNum++;
+		pthread_attr_destroy(&attr);
+		if (! CBDNSThreadNum) {
+			// No thread will take the lookup.
+			*last = NULL;
+			pthread_mutex_unlock(&CBDNSMutex);
+			free(lookup);
+			return false;
+		}
+	}
+	pthread_mutex_unlock(&CBDNSMutex);
+	return true;
+}
+void CBNetworkCommunicatorCancelDNS(void * comm){
+	pthread_mutex_lock(&CBDNSMutex);
+	for (CBDNSLookup * lookup = CBDNSLookups; lookup; lookup = lookup->next)
+		if (lookup->comm == comm)
+			__atomic_store_n(&lookup->cancelled, true, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&CBDNSMutex);
+	// CBNetworkCommunicatorOnDNSLoaded will not be called for the cancelled lookups.
+	((CBNetworkCommunicator *)comm)->dnsLookups = 0;
+}
+void CBDNSOnLoaded(void * vlookup){
+	CBDNSLookup * lookup = vlookup;
+	pthread_mutex_lock(&CBDNSMutex);
+	CBDNSRemoveLookup(lookup);
+	pthread_mutex_unlock(&CBDNSMutex);
+	if (lookup->cancelled) {
+		free(lookup);
+		return;
+	}
+	for (int x = 0; x < lookup->ipNum; x++) {
+		CBByteArray * ipBytes = CBNewByteArrayWithDataCopy(lookup->ips[x], 16);
+		CBNetworkAddress * addr = CBNewNetworkAddress(0, (CBSocketAddress){ipBytes, 8333}, CB_SERVICE_FULL_BLOCKS, false);
+		CBReleaseObject(ipBytes);
+		CBNetworkAddressManagerAddAddress(lookup->comm->addresses, addr);
+		CBReleaseObject(addr);
+	}
+	CBNetworkCommunicatorOnDNSLoaded(lookup->comm, lookup->domain, lookup->ipNum);
+	free(lookup);
+}
+bool CBDNSParseServer(char * server, struct sockaddr_storage * addr, socklen_t * addrLen){
+	char host[64];
+	int port = 53;
+	char * portStr = NULL;
+	memset(addr, 0, sizeof(*addr));
+	if (*server == '[') {
+		// IPv6 with a port as "[address]:port"
+		char * end = strchr(server, ']');
+		if (! end || end - server - 1 >= (int)sizeof(host))
+			return false;
+		memcpy(host, server + 1, end - server - 1);
+		host[end - server - 1] = '\0';
+		if (end[1] == ':')
+			portStr = end + 2;
+		else if (end[1])
+			return false;
+	}else{
+		if (strlen(server) >= sizeof(host))
+			return false;
+		strcpy(host, server);
+		char * colon = strchr(host, ':');
+		if (colon && ! strchr(colon + 1, ':')) {
+			*colon = '\0';
+			portStr = colon + 1;
+		}
+	}
+	if (portStr) {
+		char * end;
+		long value = strtol(portStr, &end, 10);
+		if (*end || end == portStr || value < 1 || value > 65535)
+			return false;
+		port = (int)value;
+	}
+	struct sockaddr_in * addr4 = (struct sockaddr_in *)addr;
+	struct sockaddr_in6 * addr6 = (struct sockaddr_in6 *)addr;
+	if (inet_pton(AF_INET, host, &addr4->sin_addr) == 1) {
+		addr4->sin_family = AF_INET;
+		addr4->sin_port = htons(port);
+		*addrLen = sizeof(*addr4);
+	}else if (inet_pton(AF_INET6, host, &addr6->sin6_addr) == 1) {
+		addr6->sin6_family = AF_INET6;
+		addr6->sin6_port = htons(port);
+		*addrLen = sizeof(*addr6);
+	}else
+		return false;
+	return true;
+}
+void CBDNSQuery(CBDNSLookup * lookup, char * server){
+	struct sockaddr_storage addr;
+	socklen_t addrLen;
+	if (! CBDNSParseServer(server, &addr, &addrLen)) {
+		CBLogError("CB_DNS_SERVER is not a valid address: %s", server);
+		return;
+	}
+	int fd = socket(addr.ss_family, SOCK_DGRAM, 0);
+	if (fd == -1) {
+		CBLogError("Could not create a socket to resolve %s: %s", lookup->domain, strerror(errno));
+		return;
+	}
+	// Connecting the socket means only datagrams from the server are received.
+	if (connect(fd, (struct sockaddr *)&addr, addrLen)) {
+		CBLogError("Could not connect to the DNS server %s: %s", server, strerror(errno));
+		close(fd);
+		return;
+	}
+	uint16_t types[2] = {CB_DNS_TYPE_A, CB_DNS_TYPE_AAAA};
+	uint16_t ids[2];
+	unsigned char queries[2][300];
+	int queryLens[2];
+	bool answered[2] = {false, false};
+	// Vary the IDs by time and by lookup, as answers are only accepted with matching IDs.
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	uint16_t id = (uint16_t)(now.tv_nsec ^ (now.tv_nsec >> 16)) + __atomic_fetch_add(&CBDNSNextID, 2, __ATOMIC_RELAXED);
+	for (int x = 0; x < 2; x++) {
+		ids[x] = id + x;
+		queryLens[x] = CBDNSBuildQuery(queries[x], lookup->domain, ids[x], types[x]);
+		if (! queryLens[x]) {
+			close(fd);
+			return;
+		}
+	}
+	for (int attempt = 0; attempt < CB_DNS_ATTEMPTS && ! (answered[0] && answered[1]); attempt++) {
+		for (int x = 0; x < 2; x++)
+			if (! answered[x])
+				send(fd, queries[x], queryLens[x], 0);
+		struct timespec start;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		while (! (answered[0] && answered[1])) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			int remaining = CB_DNS_TIMEOUT - (int)((now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000);
+			if (remaining <= 0)
+				break;
+			struct pollfd pfd = {fd, POLLIN, 0};
+			int res = poll(&pfd, 1, remaining);
+			if (res == -1 && errno == EINTR)
+				continue;
+			if (res <= 0)
+				break;
+			unsigned char buf[1500];
+			ssize_t len = recv(fd, buf, sizeof(buf), 0);
+			if (len < 12)
+				// Too short or an ICMP error from a connected socket.
+				continue;
+			uint16_t answerID = buf[0] << 8 | buf[1];
+			for (int x = 0; x < 2; x++)
+				if (! answered[x] && ids[x] == answerID) {
+					answered[x] = true;
+					CBDNSReadAnswer(lookup, buf, (int)len);
+				}
+		}
+	}
+	close(fd);
+}
+void CBDNSReadAnswer(CBDNSLookup * lookup, unsigned char * buf, int len){
+	// Must be a response without an error.
+	if (! (buf[2] & 0x80) || buf[3] & 0xF)
+		return;
+	int questions = buf[4] << 8 | buf[5];
+	int answers = buf[6] << 8 | buf[7];
+	int pos = 12;
+	for (int x = 0; x < questions; x++) {
+		pos = CBDNSSkipName(buf, len, pos);
+		if (pos == -1 || pos + 4 > len)
+			return;
+		pos += 4;
+	}
+	for (int x = 0; x < answers; x++) {
+		pos = CBDNSSkipName(buf, len, pos);
+		if (pos == -1 || pos + 10 > len)
+			return;
+		uint16_t type = buf[pos] << 8 | buf[pos + 1];
+		uint16_t class = buf[pos + 2] << 8 | buf[pos + 3];
+		int dataLen = buf[pos + 8] << 8 | buf[pos + 9];
+		pos += 10;
+		if (pos + dataLen > len)
+			return;
+		// CNAME records are followed by the addresses of the canonical name, so only addresses are used.
+		if (class == 1) {
+			if (type == CB_DNS_TYPE_A && dataLen == 4)
+				CBDNSAddIP(lookup, buf + pos, true);
+			else if (type == CB_DNS_TYPE_AAAA && dataLen == 16)
+				CBDNSAddIP(lookup, buf + pos, false);
+		}
+		pos += dataLen;
+	}
+}
+void CBDNSRemoveLookup(CBDNSLookup * lookup){
+	CBDNSLookup ** link = &CBDNSLookups;
+	while (*link != lookup)
+		link = &(*link)->next;
+	*link = lookup->next;
+}
+void CBDNSResolve(CBDNSLookup * lookup){
+	char * server = getenv("CB_DNS_SERVER");
+	if (server) {
+		CBDNSQuery(lookup, server);
+		return;
+	}
+	struct addrinfo hints, * first;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	// Otherwise each address is given for every socket type.
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(lookup->domain, NULL, &hints, &first))
+		return;
+	for (struct addrinfo * addrs = first; addrs; addrs = addrs->ai_next) {
+		if (addrs->ai_family == AF_INET)
+			CBDNSAddIP(lookup, (unsigned char *)&((struct sockaddr_in *)addrs->ai_addr)->sin_addr.s_addr, true);
+		else if (addrs->ai_family == AF_INET6)
+			CBDNSAddIP(lookup, ((struct sockaddr_in6 *)addrs->ai_addr)->sin6_addr.s6_addr, false);
+	}
+	freeaddrinfo(first);
+}
+void * CBDNSResolverThread(void * unused){
+	UNUSED(unused);
+	pthread_mutex_lock(&CBDNSMutex);
+	for (;;) {
+		CBDNSLookup * lookup = CBDNSLookups;
+		while (lookup && lookup->started)
+			lookup = lookup->next;
+		if (! lookup) {
+			struct timespec until;
+			clock_gettime(CLOCK_REALTIME, &until);
+			until.tv_sec += CB_DNS_IDLE_TIME;
+			CBDNSIdleNum++;
+			int res = pthread_cond_timedwait(&CBDNSCond, &CBDNSMutex, &until);
+			CBDNSIdleNum--;
+			if (res == ETIMEDOUT)
+				break;
+			continue;
+		}
+		lookup->started = true;
+		pthread_mutex_unlock(&CBDNSMutex);
+		if (! __atomic_load_n(&lookup->cancelled, __ATOMIC_RELAXED))
+			CBDNSResolve(lookup);
+		pthread_mutex_lock(&CBDNSMutex);
+		// The lookup stays in the list until it has been given to the communicator, so that it can still be cancelled.
+		if (lookup->cancelled) {
+			CBDNSRemoveLookup(lookup);
+			free(lookup);
+		}else if (! CBRunOnEventLoop(lookup->comm->eventLoop, CBDNSOnLoaded, lookup, false)) {
+			CBLogError("Could not give the addresses of %s to the event loop.", lookup->domain);
+			CBDNSRemoveLookup(lookup);
+			free(lookup);
+		}
+	}
+	CBDNSThreadNum--;
+	pthread_mutex_unlock(&CBDNSMutex);
+	return NULL;
+}
+int CBDNSSkipName(unsigned char * buf, int len, int pos){
+	while (pos < len) {
+		if ((buf[pos] & 0xC0) == 0xC0)
+			// A pointer ends the name.
+			return pos + 2 <= len ? pos + 2 : -1;
+		if (! buf[pos])
+			return pos + 1;
+		pos += buf[pos] + 1;
+	}
+	return -1;
+}
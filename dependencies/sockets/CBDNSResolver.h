@@ -0,0 +1,75 @@
+//
+//  CBDNSResolver.h
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+/**
+ @file
+ @brief Resolves seed domains for CBNetworkCommunicatorLoadDNS on a pool of resolver threads, so that the event loop does not wait for the resolver and the seeds are looked up at the same time. The addresses of each domain are given to the communicator on its event loop as soon as the domain is answered. Lookups use getaddrinfo, unless the CB_DNS_SERVER environment variable gives a DNS server as "address" or "address:port", in which case A and AAAA queries are sent to that server over UDP.
+ */
+
+#include "CBNetworkCommunicator.h"
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <string.h>
+#include <stdlib.h>
+
+#ifndef CBDNSRESOLVERH
+#define CBDNSRESOLVERH
+
+#define CB_DNS_THREADS 4 // The maximum number of resolver threads.
+#define CB_DNS_IDLE_TIME 30 // Seconds a resolver thread waits for another lookup before exiting.
+#define CB_DNS_MAX_ADDRESSES 64 // The maximum number of addresses taken from a domain.
+#define CB_DNS_TIMEOUT 2000 // Milliseconds to wait for answers from CB_DNS_SERVER before sending the queries again.
+#define CB_DNS_ATTEMPTS 3 // The number of times queries are sent to CB_DNS_SERVER.
+#define CB_DNS_TYPE_A 1
+#define CB_DNS_TYPE_AAAA 28
+
+typedef struct CBDNSLookup CBDNSLookup;
+
+/**
+ @brief A seed domain being resolved for a communicator.
+ */
+struct CBDNSLookup{
+	CBNetworkCommunicator * comm;
+	char domain[256];
+	unsigned char ips[CB_DNS_MAX_ADDRESSES][16]; /**< IPv6 or IPv4-mapped addresses. */
+	int ipNum;
+	bool started; /**< True when a resolver thread has taken the lookup. */
+	bool cancelled; /**< Set by CBNetworkCommunicatorCancelDNS so that the result is not given to the communicator. */
+	CBDNSLookup * next;
+};
+
+extern pthread_mutex_t CBDNSMutex; // Protects CBDNSLookups and the thread counts.
+extern CBDNSLookup * CBDNSLookups;
+
+void CBDNSAddIP(CBDNSLookup * lookup, unsigned char * ip, bool ipv4);
+int CBDNSBuildQuery(unsigned char * buf, char * domain, uint16_t id, uint16_t type);
+void CBDNSOnLoaded(void * vlookup);
+bool CBDNSParseServer(char * server, struct sockaddr_storage * addr, socklen_t * addrLen);
+void CBDNSQuery(CBDNSLookup * lookup, char * server);
+void CBDNSReadAnswer(CBDNSLookup * lookup, unsigned char * buf, int len);
+void CBDNSRemoveLookup(CBDNSLookup * lookup);
+void CBDNSResolve(CBDNSLookup * lookup);
+void * CBDNSResolverThread(void * unused);
+int CBDNSSkipName(unsigned char * buf, int len, int pos);
+
+#endif
@@ -0,0 +1,743 @@
+//
+//  CBEpollSockets.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+#include "CBEpollSockets.h"
+
+// The registrations of the sockets by file descriptor, so that the events of a socket share one registration and closing the socket can remove it.
+pthread_mutex_t CBEpollSocketsMutex = PTHREAD_MUTEX_INITIALIZER;
+CBEpollSocket ** CBEpollSockets = NULL;
+int CBEpollSocketsLength = 0;
+
+// The loop of the current thread and the socket being dispatched, so that reads and writes can record when a socket has been drained.
+__thread CBEventLoop * CBEpollCurrentLoop = NULL;
+__thread CBEpollSocket * CBEpollCurrentSocket = NULL;
+
+// Implementation
+
+CBSocketReturn CBNewSocket(CBDepObject * socketID, bool IPv6){
+	// You need to use PF_INET for IPv4 mapped IPv6 addresses despite using the IPv6 format.
+	socketID->i = socket(IPv6 ? PF_INET6 : PF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (socketID->i == -1) {
+		if (errno == EAFNOSUPPORT || errno == EPROTONOSUPPORT)
+			return CB_SOCKET_NO_SUPPORT;
+		return CB_SOCKET_BAD;
+	}
+	// Make address reusable
+	int i = 1;
+	setsockopt(socketID->i, SOL_SOCKET, SO_REUSEADDR, &i, sizeof(i));
+	return CB_SOCKET_OK;
+}
+bool CBSocketBind(CBDepObject * socketID, bool IPv6, int port){
+	struct addrinfo hints, *res, *ptr;
+	// Set hints for the computer's addresses.
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_flags = AI_PASSIVE;
+	hints.ai_family = IPv6 ? AF_INET6 : AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	// Get host for listening
+	char portStr[6];
+	sprintf(portStr, "%u", port);
+	if (getaddrinfo(NULL, portStr, &hints, &res))
+		return false;
+	// Attempt to bind to one of the addresses.
+	for(ptr = res; ptr != NULL; ptr = ptr->ai_next) {
+		if ((socketID->i = socket(ptr->ai_family, ptr->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ptr->ai_protocol)) == -1)
+			continue;
+		// Prevent EADDRINUSE
+		int opt = 1;
+		setsockopt(socketID->i, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+		if (bind(socketID->i, ptr->ai_addr, ptr->ai_addrlen) == -1) {
+			CBLogWarning("Bind gave the error %s for address on port %u.", strerror(errno), port);
+			close(socketID->i);
+			continue;
+		}
+		break; // Success.
+	}
+	freeaddrinfo(res);
+	return ptr != NULL;
+}
+bool CBSocketConnect(CBDepObject socketID, unsigned char * IP, bool IPv6, int port){
+	// Create sockaddr_in6 information for a IPv6 address
+	int res;
+	if (IPv6) {
+		struct sockaddr_in6 address;
+		memset(&address, 0, sizeof(address)); // Clear structure.
+		address.sin6_family = AF_INET6;
+		memcpy(&address.sin6_addr, IP, 16); // Move IP address into place.
+		address.sin6_port = htons(port); // Port number to network order
+		res = connect(socketID.i, (struct sockaddr *)&address, sizeof(address));
+	}else{
+		struct sockaddr_in address;
+		memset(&address, 0, sizeof(address)); // Clear structure.
+		address.sin_family = AF_INET;
+		memcpy(&address.sin_addr, IP + 12, 4); // Move IP address into place. Last 4 bytes for IPv4.
+		address.sin_port = htons(port); // Port number to network order
+		res = connect(socketID.i, (struct sockaddr *)&address, sizeof(address));
+	}
+	return res < 0 && errno == EINPROGRESS;
+}
+bool CBSocketListen(CBDepObject socketID, int maxConnections){
+	return listen(socketID.i, maxConnections) != -1;
+}
+bool CBSocketAccept(CBDepObject socketID, CBDepObject * connectionSocketID, void * vsockAddr){
+	struct sockaddr_storage addr_storage;
+	CBSocketAddress * sockAddr = vsockAddr;
+	struct sockaddr * addr = (struct sockaddr *)&addr_storage;
+	socklen_t addrLen = sizeof(addr_storage);
+	connectionSocketID->i = accept4(socketID.i, addr, &addrLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if (connectionSocketID->i == -1)
+		return false;
+	if (addr->sa_family == AF_INET) {
+		int ipInt = ((struct sockaddr_in *)addr)->sin_addr.s_addr;
+		sockAddr->ip = CBNewByteArrayWithDataCopy((unsigned char [16]){0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF, 0, 0, 0, 0}, 16);
+		CBInt32ToArray(CBByteArrayGetData(sockAddr->ip), 12, ipInt);
+		sockAddr->port = ((struct sockaddr_in *)addr)->sin_port;
+	}else{
+		sockAddr->ip = CBNewByteArrayWithDataCopy(((struct sockaddr_in6 *)addr)->sin6_addr.s6_addr, 16);
+		sockAddr->port = ((struct sockaddr_in6 *)addr)->sin6_port;
+	}
+	return true;
+}
+bool CBNewEventLoop(CBDepObject * loopID, void (*onError)(void *), void (*onDidTimeout)(void *, void *, CBTimeOutType), void * communicator){
+	CBEventLoop * loop = malloc(sizeof(*loop));
+	loop->epoll = epoll_create1(EPOLL_CLOEXEC);
+	if (loop->epoll == -1) {
+		CBLogError("Could not create an epoll instance: %s", strerror(errno));
+		free(loop);
+		return false;
+	}
+	// Create the eventfd for waking the loop. The data is NULL to tell it apart from sockets and timers.
+	loop->wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	struct epoll_event wakeEvent = {.events = EPOLLIN | EPOLLET, .data.ptr = NULL};
+	if (loop->wake == -1 || epoll_ctl(loop->epoll, EPOLL_CTL_ADD, loop->wake, &wakeEvent)) {
+		CBLogError("Could not create an eventfd for the event loop: %s", strerror(errno));
+		if (loop->wake != -1)
+			close(loop->wake);
+		close(loop->epoll);
+		free(loop);
+		return false;
+	}
+	loop->exit = false;
+	loop->onError = onError;
+	loop->onTimeOut = onDidTimeout;
+	loop->communicator = communicator;
+	loop->timeouts = NULL;
+	loop->timeoutNum = loop->timeoutCap = 0;
+	loop->ready = loop->dispatching = NULL;
+	loop->readyNum = loop->readyCap = loop->dispatchingCap = 0;
+	loop->freedSockets = NULL;
+	loop->freedTimers = NULL;
+	CBNewMutex(&loop->mutex);
+	// Create queue
+	CBInitCallbackQueue(&loop->queue);
+	// Create thread
+	CBNewThread(&loop->loopThread, CBStartEventLoop, loop);
+	loopID->ptr = loop;
+	return true;
+}
+
+void CBStartEventLoop(void * vloop){
+	CBEventLoop * loop = vloop;
+	CBEpollCurrentLoop = loop;
+	CBLogVerbose("Starting network event loop.");
+	struct epoll_event events[CB_EPOLL_MAX_EVENTS];
+	CBMutexLock(loop->mutex);
+	while (! loop->exit) {
+		int wait = CBEpollGetWaitTime(loop);
+		CBMutexUnlock(loop->mutex);
+		int num = epoll_wait(loop->epoll, events, CB_EPOLL_MAX_EVENTS, wait);
+		CBMutexLock(loop->mutex);
+		if (num == -1) {
+			if (errno == EINTR)
+				continue;
+			CBLogError("epoll_wait failed with the error %s", strerror(errno));
+			CBMutexUnlock(loop->mutex);
+			loop->onError(loop->communicator);
+			CBMutexLock(loop->mutex);
+			break;
+		}
+		bool runQueue = false;
+		for (int x = 0; x < num; x++) {
+			CBEpollSourceType * source = events[x].data.ptr;
+			if (! source) {
+				// Woken by another thread. Reading the eventfd resets it.
+				uint64_t count;
+				if (read(loop->wake, &count, sizeof(count))) {}
+				runQueue = true;
+			}else if (*source == CB_EPOLL_SOURCE_TIMER) {
+				CBTimer * timer = (CBTimer *)source;
+				uint64_t expirations;
+				if (! timer->callback || read(timer->fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+					// The timer ended or has not expired.
+					continue;
+				CBMutexUnlock(loop->mutex);
+				timer->callback(timer->arg);
+				CBMutexLock(loop->mutex);
+			}else{
+				CBEpollSocket * sock = (CBEpollSocket *)source;
+				if (sock->fd == -1)
+					continue;
+				uint32_t flags = events[x].events;
+				// Errors and hang-ups are given to the callbacks through their reads and writes.
+				if (flags & (EPOLLERR | EPOLLHUP))
+					flags |= EPOLLIN | EPOLLOUT;
+				if (flags & (EPOLLIN | EPOLLRDHUP)) {
+					sock->ready |= EPOLLIN;
+					sock->peek = false;
+				}
+				if (flags & EPOLLOUT)
+					sock->ready |= EPOLLOUT;
+				CBEpollQueueSocket(loop, sock);
+			}
+		}
+		// Run callbacks from other threads first, as they were given before the sockets became ready.
+		if (runQueue) {
+			CBMutexUnlock(loop->mutex);
+			CBCallbackQueueRun(&loop->queue);
+			CBMutexLock(loop->mutex);
+		}
+		// Dispatch the ready sockets. Sockets which remain ready are queued again for the next iteration.
+		CBEpollSocket ** dispatching = loop->ready;
+		uint32_t dispatchNum = loop->readyNum, dispatchingCap = loop->readyCap;
+		loop->ready = loop->dispatching;
+		loop->readyCap = loop->dispatchingCap;
+		loop->readyNum = 0;
+		loop->dispatching = dispatching;
+		loop->dispatchingCap = dispatchingCap;
+		for (uint32_t x = 0; x < dispatchNum; x++)
+			CBEpollDispatch(loop, dispatching[x]);
+		CBEpollDispatchTimeouts(loop);
+		CBEpollFreeObjects(loop, false);
+	}
+	CBMutexUnlock(loop->mutex);
+	// Break from loop. Free everything.
+	CBEpollFreeObjects(loop, true);
+	close(loop->wake);
+	close(loop->epoll);
+	free(loop->timeouts);
+	free(loop->ready);
+	free(loop->dispatching);
+	CBFreeMutex(loop->mutex);
+	CBFreeCallbackQueue(&loop->queue);
+	free(loop);
+}
+void CBEpollDispatch(CBEventLoop * loop, CBEpollSocket * sock){
+	// The loop mutex is locked, and is unlocked while the callbacks run.
+	sock->queued = false;
+	for (int side = 0; side < 2; side++) {
+		uint32_t flag = side ? EPOLLOUT : EPOLLIN;
+		for (int x = 0; x < CB_EPOLL_DISPATCH_MAX; x++) {
+			CBEvent * event = side ? sock->write : sock->read;
+			bool buffered = ! side && sock->bufferStart != sock->bufferEnd;
+			if (sock->fd == -1 || ! event || ! (buffered || sock->ready & flag))
+				break;
+			if (! sock->edge)
+				// Level-triggered sockets are given by epoll again while they remain ready.
+				sock->ready &= ~flag;
+			else if (! side && ! buffered && sock->peek && ! CBEpollHasData(sock)) {
+				// The last read took all the data.
+				sock->ready &= ~EPOLLIN;
+				break;
+			}
+			if (event->type == CB_EPOLL_EVENT_CONNECT) {
+				// Connection events only happen once.
+				sock->write = NULL;
+				CBEpollRemoveDeadline(loop, event);
+			}else if (! x && event->timeout)
+				// Restart the timeout as the event is active.
+				CBEpollSetDeadline(loop, event, CBEpollGetMilliseconds() + event->timeout);
+			CBEpollCurrentSocket = sock;
+			CBMutexUnlock(loop->mutex);
+			CBEpollRunEvent(event);
+			CBMutexLock(loop->mutex);
+			CBEpollCurrentSocket = NULL;
+		}
+	}
+	// If the socket is still ready it used up its turn, so continue in the next iteration.
+	CBEpollQueueSocket(loop, sock);
+}
+void CBEpollDispatchTimeouts(CBEventLoop * loop){
+	// The loop mutex is locked. Take one event at a time as the callbacks may remove other events.
+	uint64_t now = CBEpollGetMilliseconds();
+	while (loop->timeoutNum && loop->timeouts[0]->deadline <= now) {
+		CBEvent * event = loop->timeouts[0];
+		CBTimeOutType type;
+		if (event->type == CB_EPOLL_EVENT_CONNECT) {
+			// Connection events only happen once.
+			event->socket->write = NULL;
+			CBEpollRemoveDeadline(loop, event);
+			type = CB_TIMEOUT_CONNECT;
+		}else{
+			CBEpollSetDeadline(loop, event, now + event->timeout);
+			type = event->type == CB_EPOLL_EVENT_SEND ? CB_TIMEOUT_SEND : CB_TIMEOUT_RECEIVE;
+		}
+		void * peer = event->peer;
+		CBMutexUnlock(loop->mutex);
+		loop->onTimeOut(loop->communicator, peer, type);
+		CBMutexLock(loop->mutex);
+	}
+}
+void CBEpollFreeObjects(CBEventLoop * loop, bool all){
+	// Sockets in the ready list are kept until they have been taken from it.
+	CBEpollSocket ** sockPtr = &loop->freedSockets;
+	while (*sockPtr) {
+		CBEpollSocket * sock = *sockPtr;
+		if (sock->queued && ! all) {
+			sockPtr = &sock->nextFreed;
+			continue;
+		}
+		*sockPtr = sock->nextFreed;
+		free(sock->buffer);
+		free(sock);
+	}
+	while (loop->freedTimers) {
+		CBTimer * timer = loop->freedTimers;
+		loop->freedTimers = timer->nextFreed;
+		free(timer);
+	}
+}
+uint64_t CBEpollGetMilliseconds(void){
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (uint64_t)time.tv_sec * 1000 + time.tv_nsec / 1000000;
+}
+CBEpollSocket * CBEpollGetSocket(CBEventLoop * loop, int fd, bool edge){
+	pthread_mutex_lock(&CBEpollSocketsMutex);
+	if (fd >= CBEpollSocketsLength) {
+		int length = CBEpollSocketsLength ? CBEpollSocketsLength : 64;
+		while (length <= fd)
+			length *= 2;
+		CBEpollSockets = realloc(CBEpollSockets, length * sizeof(*CBEpollSockets));
+		memset(CBEpollSockets + CBEpollSocketsLength, 0, (length - CBEpollSocketsLength) * sizeof(*CBEpollSockets));
+		CBEpollSocketsLength = length;
+	}
+	CBEpollSocket * sock = CBEpollSockets[fd];
+	if (sock && sock->loop != loop) {
+		pthread_mutex_unlock(&CBEpollSocketsMutex);
+		CBLogError("The socket %i already has events on another event loop.", fd);
+		return NULL;
+	}
+	if (! sock) {
+		sock = malloc(sizeof(*sock));
+		sock->source = CB_EPOLL_SOURCE_SOCKET;
+		sock->loop = loop;
+		sock->fd = fd;
+		sock->edge = edge;
+		sock->ready = 0;
+		sock->peek = false;
+		sock->queued = false;
+		sock->eventNum = 0;
+		sock->read = sock->write = NULL;
+		sock->buffer = NULL;
+		sock->bufferStart = sock->bufferEnd = 0;
+		// Level-triggered sockets only ask for events while an event is pending.
+		struct epoll_event epollEvent = {.events = edge ? EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET : 0, .data.ptr = sock};
+		if (epoll_ctl(loop->epoll, EPOLL_CTL_ADD, fd, &epollEvent)) {
+			pthread_mutex_unlock(&CBEpollSocketsMutex);
+			CBLogError("Could not add the socket %i to epoll: %s", fd, strerror(errno));
+			free(sock);
+			return NULL;
+		}
+		CBEpollSockets[fd] = sock;
+	}
+	sock->eventNum++;
+	pthread_mutex_unlock(&CBEpollSocketsMutex);
+	return sock;
+}
+int CBEpollGetWaitTime(CBEventLoop * loop){
+	if (loop->readyNum)
+		return 0;
+	if (! loop->timeoutNum)
+		return -1;
+	uint64_t now = CBEpollGetMilliseconds(), deadline = loop->timeouts[0]->deadline;
+	return deadline > now ? (int)(deadline - now) : 0;
+}
+bool CBEpollHasData(CBEpollSocket * sock){
+	char byte;
+	// The end of the stream and errors are given to the callback by its read.
+	return recv(sock->fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT) != -1 || errno != EAGAIN;
+}
+void CBEpollHeapDown(CBEventLoop * loop, uint32_t x){
+	CBEvent * event = loop->timeouts[x];
+	for (;;) {
+		uint32_t child = x * 2 + 1;
+		if (child >= loop->timeoutNum)
+			break;
+		if (child + 1 < loop->timeoutNum && loop->timeouts[child + 1]->deadline < loop->timeouts[child]->deadline)
+			child++;
+		if (event->deadline <= loop->timeouts[child]->deadline)
+			break;
+		CBEpollHeapSet(loop, x, loop->timeouts[child]);
+		x = child;
+	}
+	CBEpollHeapSet(loop, x, event);
+}
+void CBEpollHeapSet(CBEventLoop * loop, uint32_t x, CBEvent * event){
+	loop->timeouts[x] = event;
+	event->heapIndex = x;
+}
+void CBEpollHeapUp(CBEventLoop * loop, uint32_t x){
+	CBEvent * event = loop->timeouts[x];
+	while (x) {
+		uint32_t parent = (x - 1) / 2;
+		if (loop->timeouts[parent]->deadline <= event->deadline)
+			break;
+		CBEpollHeapSet(loop, x, loop->timeouts[parent]);
+		x = parent;
+	}
+	CBEpollHeapSet(loop, x, event);
+}
+CBEvent * CBEpollNewEvent(CBDepObject loopID, CBDepObject socketID, CBEpollEventType type, void * peer){
+	CBEvent * event = malloc(sizeof(*event));
+	event->loop = loopID.ptr;
+	event->socket = CBEpollGetSocket(event->loop, socketID.i, type != CB_EPOLL_EVENT_ACCEPT);
+	if (! event->socket) {
+		free(event);
+		return NULL;
+	}
+	event->type = type;
+	event->peer = peer;
+	event->timeout = 0;
+	event->heapIndex = CB_EPOLL_NO_DEADLINE;
+	return event;
+}
+void CBEpollQueueSocket(CBEventLoop * loop, CBEpollSocket * sock){
+	if (sock->queued || sock->fd == -1
+		|| ! (((sock->ready & EPOLLIN || sock->bufferStart != sock->bufferEnd) && sock->read) || (sock->ready & EPOLLOUT && sock->write)))
+		return;
+	if (loop->readyNum == loop->readyCap) {
+		loop->readyCap = loop->readyCap ? loop->readyCap * 2 : 64;
+		loop->ready = realloc(loop->ready, loop->readyCap * sizeof(*loop->ready));
+	}
+	loop->ready[loop->readyNum++] = sock;
+	sock->queued = true;
+}
+int32_t CBEpollReadBuffer(CBEpollSocket * sock, unsigned char * data, int len){
+	uint32_t num = sock->bufferEnd - sock->bufferStart;
+	if ((uint32_t)len < num)
+		num = len;
+	memcpy(data, sock->buffer + sock->bufferStart, num);
+	sock->bufferStart += num;
+	if (sock->bufferStart == sock->bufferEnd)
+		sock->bufferStart = sock->bufferEnd = 0;
+	return (int32_t)num;
+}
+void CBEpollRemoveDeadline(CBEventLoop * loop, CBEvent * event){
+	if (event->heapIndex == CB_EPOLL_NO_DEADLINE)
+		return;
+	uint32_t x = event->heapIndex;
+	event->heapIndex = CB_EPOLL_NO_DEADLINE;
+	CBEvent * last = loop->timeouts[--loop->timeoutNum];
+	if (x != loop->timeoutNum) {
+		// Move the last event into the gap.
+		CBEpollHeapSet(loop, x, last);
+		CBEpollHeapUp(loop, x);
+		CBEpollHeapDown(loop, last->heapIndex);
+	}
+}
+void CBEpollRunEvent(CBEvent * event){
+	CBEventLoop * loop = event->loop;
+	if (event->type == CB_EPOLL_EVENT_ACCEPT)
+		event->onEvent.i(loop->communicator, (CBDepObject){.i = event->socket->fd});
+	else if (event->type == CB_EPOLL_EVENT_CONNECT) {
+		int optval = -1;
+		socklen_t optlen = sizeof(optval);
+		getsockopt(event->socket->fd, SOL_SOCKET, SO_ERROR, &optval, &optlen);
+		if (optval){
+			// Act as timeout
+			CBLogWarning("Connection error: %s", strerror(optval));
+			loop->onTimeOut(loop->communicator, event->peer, CB_TIMEOUT_CONNECT_ERROR);
+		}else
+			// Connection successful
+			event->onEvent.ptr(loop->communicator, event->peer);
+	}else
+		// Can send or receive
+		event->onEvent.ptr(loop->communicator, event->peer);
+}
+void CBEpollSetDeadline(CBEventLoop * loop, CBEvent * event, uint64_t deadline){
+	if (event->heapIndex == CB_EPOLL_NO_DEADLINE) {
+		if (loop->timeoutNum == loop->timeoutCap) {
+			loop->timeoutCap = loop->timeoutCap ? loop->timeoutCap * 2 : 64;
+			loop->timeouts = realloc(loop->timeouts, loop->timeoutCap * sizeof(*loop->timeouts));
+		}
+		event->deadline = deadline;
+		CBEpollHeapSet(loop, loop->timeoutNum++, event);
+		CBEpollHeapUp(loop, event->heapIndex);
+	}else{
+		bool earlier = deadline < event->deadline;
+		event->deadline = deadline;
+		if (earlier)
+			CBEpollHeapUp(loop, event->heapIndex);
+		else
+			CBEpollHeapDown(loop, event->heapIndex);
+	}
+}
+void CBEpollWake(CBEventLoop * loop){
+	uint64_t one = 1;
+	if (write(loop->wake, &one, sizeof(one))) {}
+}
+bool CBSocketCanAcceptEvent(CBDepObject * eventID, CBDepObject loopID, CBDepObject socketID, void (*onCanAccept)(void *, CBDepObject)){
+	CBEvent * event = CBEpollNewEvent(loopID, socketID, CB_EPOLL_EVENT_ACCEPT, NULL);
+	if (! event)
+		return false;
+	event->onEvent.i = onCanAccept;
+	eventID->ptr = event;
+	return true;
+}
+bool CBSocketDidConnectEvent(CBDepObject * eventID, CBDepObject loopID, CBDepObject socketID, void (*onDidConnect)(void *, void *), void * peer){
+	CBEvent * event = CBEpollNewEvent(loopID, socketID, CB_EPOLL_EVENT_CONNECT, peer);
+	if (! event)
+		return false;
+	event->onEvent.ptr = onDidConnect;
+	eventID->ptr = event;
+	return true;
+}
+bool CBSocketCanSendEvent(CBDepObject * eventID, CBDepObject loopID, CBDepObject socketID, void (*onCanSend)(void *, void *), void * peer){
+	CBEvent * event = CBEpollNewEvent(loopID, socketID, CB_EPOLL_EVENT_SEND, peer);
+	if (! event)
+		return false;
+	event->onEvent.ptr = onCanSend;
+	eventID->ptr = event;
+	return true;
+}
+bool CBSocketCanReceiveEvent(CBDepObject * eventID, CBDepObject loopID, CBDepObject socketID, void (*onCanReceive)(void *, void *), void * peer){
+	CBEvent * event = CBEpollNewEvent(loopID, socketID, CB_EPOLL_EVENT_RECEIVE, peer);
+	if (! event)
+		return false;
+	event->onEvent.ptr = onCanReceive;
+	eventID->ptr = event;
+	return true;
+}
+bool CBSocketAddEvent(CBDepObject eventID, int timeout){
+	CBEvent * event = eventID.ptr;
+	CBEventLoop * loop = event->loop;
+	CBEpollSocket * sock = event->socket;
+	bool reading = event->type == CB_EPOLL_EVENT_ACCEPT || event->type == CB_EPOLL_EVENT_RECEIVE;
+	CBMutexLock(loop->mutex);
+	event->timeout = timeout;
+	if (timeout)
+		CBEpollSetDeadline(loop, event, CBEpollGetMilliseconds() + timeout);
+	else
+		CBEpollRemoveDeadline(loop, event);
+	CBEvent ** pending = reading ? &sock->read : &sock->write;
+	if (*pending != event) {
+		if (*pending)
+			// Replace the other event for this direction.
+			CBEpollRemoveDeadline(loop, *pending);
+		*pending = event;
+		if (! sock->edge && sock->fd != -1) {
+			struct epoll_event epollEvent = {.events = EPOLLIN, .data.ptr = sock};
+			epoll_ctl(loop->epoll, EPOLL_CTL_MOD, sock->fd, &epollEvent);
+		}
+	}
+	// Readiness that came before the event was added does not give another edge, so dispatch it now.
+	CBEpollQueueSocket(loop, sock);
+	CBMutexUnlock(loop->mutex);
+	if (CBEpollCurrentLoop != loop)
+		// Wake the loop for the new timeout or readiness.
+		CBEpollWake(loop);
+	return true;
+}
+bool CBSocketRemoveEvent(CBDepObject eventID){
+	CBEvent * event = eventID.ptr;
+	CBEventLoop * loop = event->loop;
+	CBEpollSocket * sock = event->socket;
+	CBMutexLock(loop->mutex);
+	CBEpollRemoveDeadline(loop, event);
+	if (sock->read == event) {
+		sock->read = NULL;
+		if (! sock->edge && sock->fd != -1) {
+			struct epoll_event epollEvent = {.events = 0, .data.ptr = sock};
+			epoll_ctl(loop->epoll, EPOLL_CTL_MOD, sock->fd, &epollEvent);
+		}
+	}else if (sock->write == event)
+		sock->write = NULL;
+	CBMutexUnlock(loop->mutex);
+	return true;
+}
+void CBSocketFreeEvent(CBDepObject eventID){
+	CBEvent * event = eventID.ptr;
+	CBEventLoop * loop = event->loop;
+	CBEpollSocket * sock = event->socket;
+	CBSocketRemoveEvent(eventID);
+	free(event);
+	pthread_mutex_lock(&CBEpollSocketsMutex);
+	if (--sock->eventNum == 0) {
+		// No more events so remove the registration.
+		CBMutexLock(loop->mutex);
+		if (sock->fd != -1) {
+			epoll_ctl(loop->epoll, EPOLL_CTL_DEL, sock->fd, NULL);
+			CBEpollSockets[sock->fd] = NULL;
+			sock->fd = -1;
+		}
+		sock->nextFreed = loop->freedSockets;
+		loop->freedSockets = sock;
+		CBMutexUnlock(loop->mutex);
+	}
+	pthread_mutex_unlock(&CBEpollSocketsMutex);
+}
+int32_t CBSocketSend(CBDepObject socketID, unsigned char * data, int len){
+	ssize_t res = send(socketID.i, data, len, MSG_NOSIGNAL);
+	if (res < len && CBEpollCurrentSocket && CBEpollCurrentSocket->fd == socketID.i)
+		// The send buffer is full, so wait for the next edge.
+		CBEpollCurrentSocket->ready &= ~EPOLLOUT;
+	if (res >= 0)
+		return (int32_t)res;
+	if (errno == EAGAIN)
+		return 0; // False event. Wait again.
+	return CB_SOCKET_FAILURE; // Failure
+}
+int32_t CBSocketSendFile(CBDepObject socketID, CBDepObject file, uint64_t offset, int len){
+	// sendfile has no MSG_NOSIGNAL, so block SIGPIPE while sending and discard it if it was raised.
+	sigset_t pipeSet, oldSet;
+	sigemptyset(&pipeSet);
+	sigaddset(&pipeSet, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &pipeSet, &oldSet);
+	off_t off = (off_t)offset;
+	ssize_t res = sendfile(socketID.i, file.i, &off, len);
+	int err = errno;
+	if (res < 0 && err == EPIPE && ! sigismember(&oldSet, SIGPIPE)) {
+		struct timespec zero = {0, 0};
+		sigtimedwait(&pipeSet, NULL, &zero);
+	}
+	pthread_sigmask(SIG_SETMASK, &oldSet, NULL);
+	if (res < len && CBEpollCurrentSocket && CBEpollCurrentSocket->fd == socketID.i)
+		CBEpollCurrentSocket->ready &= ~EPOLLOUT;
+	if (res >= 0)
+		return (int32_t)res;
+	if (err == EAGAIN)
+		return 0; // False event. Wait again.
+	return CB_SOCKET_FAILURE; // Failure
+}
+int32_t CBSocketReceive(CBDepObject socketID, unsigned char * data, int len){
+	CBEpollSocket * sock = CBEpollCurrentSocket;
+	if (! sock || sock->fd != socketID.i) {
+		// Not dispatching this socket, but the loop may have data for it.
+		pthread_mutex_lock(&CBEpollSocketsMutex);
+		CBEpollSocket * registered = socketID.i < CBEpollSocketsLength ? CBEpollSockets[socketID.i] : NULL;
+		pthread_mutex_unlock(&CBEpollSocketsMutex);
+		if (registered && registered->bufferStart != registered->bufferEnd)
+			return CBEpollReadBuffer(registered, data, len);
+		sock = NULL;
+	}else if (sock->bufferStart != sock->bufferEnd)
+		return CBEpollReadBuffer(sock, data, len);
+	ssize_t res;
+	bool full;
+	if (sock && len < CB_EPOLL_RECEIVE_BUFFER_SIZE) {
+		// Read as much as there is for small reads, so that the next reads do not need system calls.
+		if (! sock->buffer)
+			sock->buffer = malloc(CB_EPOLL_RECEIVE_BUFFER_SIZE);
+		res = read(socketID.i, sock->buffer, CB_EPOLL_RECEIVE_BUFFER_SIZE);
+		full = res == CB_EPOLL_RECEIVE_BUFFER_SIZE;
+		if (res > 0) {
+			sock->bufferEnd = (uint32_t)res;
+			res = CBEpollReadBuffer(sock, data, len);
+		}
+	}else{
+		res = read(socketID.i, data, len);
+		full = res == len;
+	}
+	if (sock) {
+		if (! full)
+			// A short read empties the socket, so more data gives a new edge.
+			sock->ready &= ~EPOLLIN;
+		else
+			// There may be more data. Check before calling the callback again.
+			sock->peek = true;
+	}
+	if (res > 0)
+		return (int32_t)res; // OK, read data.
+	if (! res)
+		return CB_SOCKET_CONNECTION_CLOSE; // If read() gives zero it means the connection was closed.
+	if (errno == EAGAIN)
+		return 0; // False event. Wait again. No bytes read.
+	return CB_SOCKET_FAILURE; // Failure
+}
+bool CBStartTimer(CBDepObject loopID, CBDepObject * timer, int time, void (*callback)(void *), void * arg){
+	CBEventLoop * loop = loopID.ptr;
+	CBTimer * theTimer = malloc(sizeof(*theTimer));
+	theTimer->source = CB_EPOLL_SOURCE_TIMER;
+	theTimer->loop = loop;
+	theTimer->callback = callback;
+	theTimer->arg = arg;
+	theTimer->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	timer->ptr = theTimer;
+	if (theTimer->fd == -1) {
+		CBLogError("Could not create a timerfd: %s", strerror(errno));
+		theTimer->callback = NULL;
+		return false;
+	}
+	// A time of zero leaves the timer disarmed.
+	struct timespec period = {time / 1000, (time % 1000) * 1000000};
+	struct itimerspec spec = {period, period};
+	struct epoll_event epollEvent = {.events = EPOLLIN | EPOLLET, .data.ptr = theTimer};
+	return ! timerfd_settime(theTimer->fd, 0, &spec, NULL)
+		&& ! epoll_ctl(loop->epoll, EPOLL_CTL_ADD, theTimer->fd, &epollEvent);
+}
+void CBEndTimer(CBDepObject timer){
+	CBTimer * theTimer = timer.ptr;
+	CBEventLoop * loop = theTimer->loop;
+	// The timer may still be in the events being processed by the loop, so it is freed by the loop.
+	CBMutexLock(loop->mutex);
+	if (theTimer->fd != -1)
+		close(theTimer->fd);
+	theTimer->callback = NULL;
+	theTimer->nextFreed = loop->freedTimers;
+	loop->freedTimers = theTimer;
+	CBMutexUnlock(loop->mutex);
+}
+bool CBRunOnEventLoop(CBDepObject loopID, void (*callback)(void *), void * arg, bool block){
+	CBEventLoop * loop = loopID.ptr;
+	if (block) {
+		if (CBEpollCurrentLoop == loop){
+			// We are in the event loop already and we are supposed to block.
+			callback(arg);
+			return true;
+		}
+		// The item stays on the stack until the callback has run.
+		CBCallbackQueueItem item;
+		CBInitCallbackQueueItem(&item, callback, arg, true);
+		if (CBCallbackQueuePush(&loop->queue, &item))
+			CBEpollWake(loop);
+		CBCallbackQueueWait(&item);
+		return true;
+	}
+	CBCallbackQueueItem * item = CBCallbackQueueNewItem(&loop->queue, callback, arg);
+	if (! item)
+		return false;
+	if (CBCallbackQueuePush(&loop->queue, item))
+		CBEpollWake(loop);
+	return true;
+}
+void CBCloseSocket(CBDepObject socketID){
+	// Remove the registration so that a new socket with the same descriptor gets its own.
+	pthread_mutex_lock(&CBEpollSocketsMutex);
+	if (socketID.i < CBEpollSocketsLength && CBEpollSockets[socketID.i]) {
+		CBEpollSocket * sock = CBEpollSockets[socketID.i];
+		CBEpollSockets[socketID.i] = NULL;
+		CBMutexLock(sock->loop->mutex);
+		epoll_ctl(sock->loop->epoll, EPOLL_CTL_DEL, sock->fd, NULL);
+		sock->fd = -1;
+		CBMutexUnlock(sock->loop->mutex);
+	}
+	pthread_mutex_unlock(&CBEpollSocketsMutex);
+	close(socketID.i);
+}
+void CBExitEventLoop(CBDepObject loopID){
+	CBEventLoop * loop = loopID.ptr;
+	CBMutexLock(loop->mutex);
+	loop->exit = true;
+	CBMutexUnlock(loop->mutex);
+	CBEpollWake(loop);
+}
@@ -0,0 +1,182 @@
+//
+//  CBEpollSockets.h
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+/**
+ @file
+ @brief This is a Linux implementation of the networking dependencies for cbitcoin which uses epoll directly instead of libevent or libev. Each socket is registered once in edge-triggered mode for reading and writing, and the loop keeps calling the callback of a pending event until the socket has been drained to EAGAIN. Small reads take all the available data into a buffer for the socket, so that a message header and payload usually need one system call. Listening sockets are level-triggered so that one connection is accepted per callback. Timers use timerfd and other threads wake the loop with an eventfd. The timeouts of socket events are kept in a binary heap, which gives the time to wait for in epoll_wait.
+ */
+
+#ifndef __linux__
+#error "CBEpollSockets requires Linux. Use CBLibEventSockets on other systems."
+#endif
+
+#ifdef CB_EPOLL_FALLBACK
+// Compiled under other names for CBUringSockets, which uses this implementation when the kernel does not provide io_uring.
+#define CBNewSocket CBEpollNewSocket
+#define CBSocketBind CBEpollSocketBind
+#define CBSocketConnect CBEpollSocketConnect
+#define CBSocketListen CBEpollSocketListen
+#define CBSocketAccept CBEpollSocketAccept
+#define CBNewEventLoop CBEpollNewEventLoop
+#define CBStartEventLoop CBEpollStartEventLoop
+#define CBSocketCanAcceptEvent CBEpollSocketCanAcceptEvent
+#define CBSocketDidConnectEvent CBEpollSocketDidConnectEvent
+#define CBSocketCanSendEvent CBEpollSocketCanSendEvent
+#define CBSocketCanReceiveEvent CBEpollSocketCanReceiveEvent
+#define CBSocketAddEvent CBEpollSocketAddEvent
+#define CBSocketRemoveEvent CBEpollSocketRemoveEvent
+#define CBSocketFreeEvent CBEpollSocketFreeEvent
+#define CBSocketSend CBEpollSocketSend
+#define CBSocketSendFile CBEpollSocketSendFile
+#define CBSocketReceive CBEpollSocketReceive
+#define CBStartTimer CBEpollStartTimer
+#define CBEndTimer CBEpollEndTimer
+#define CBRunOnEventLoop CBEpollRunOnEventLoop
+#define CBCloseSocket CBEpollCloseSocket
+#define CBExitEventLoop CBEpollExitEventLoop
+#endif
+
+#include "CBCallbackQueue.h"
+#include "CBNetworkCommunicator.h"
+#include "CBThreads.h"
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <stdlib.h>
+
+#ifndef CBEPOLLSOCKETSH
+#define CBEPOLLSOCKETSH
+
+#define CB_EPOLL_MAX_EVENTS 256 // The number of epoll events taken in one loop iteration.
+#define CB_EPOLL_DISPATCH_MAX 16 // The number of times the callbacks of a socket are called in a row before other sockets get a turn.
+#define CB_EPOLL_NO_DEADLINE UINT32_MAX // The heap index of an event without a timeout.
+#define CB_EPOLL_RECEIVE_BUFFER_SIZE 4096 // Reads smaller than this take as much data as there is into the buffer of the socket.
+
+typedef enum{
+	CB_EPOLL_EVENT_ACCEPT,
+	CB_EPOLL_EVENT_CONNECT,
+	CB_EPOLL_EVENT_SEND,
+	CB_EPOLL_EVENT_RECEIVE
+} CBEpollEventType;
+
+/**
+ @brief The type of the object given as the data of an epoll registration. The eventfd for waking the loop is registered with NULL.
+ */
+typedef enum{
+	CB_EPOLL_SOURCE_SOCKET,
+	CB_EPOLL_SOURCE_TIMER
+} CBEpollSourceType;
+
+typedef struct CBEvent CBEvent;
+typedef struct CBEpollSocket CBEpollSocket;
+typedef struct CBTimer CBTimer;
+
+typedef struct{
+	int epoll; /**< The epoll file descriptor. */
+	int wake; /**< eventfd used to wake the loop from other threads. */
+	bool exit; /**< Set to stop the loop. */
+	void (*onError)(void *);
+	void (*onTimeOut)(void *, void *, CBTimeOutType); /**< Callback for timeouts */
+	void * communicator;
+	CBDepObject loopThread; /**< The thread for the event loop. */
+	CBCallbackQueue queue;
+	CBDepObject mutex; /**< Protects the pending events, the timeout heap, the ready sockets and the freed objects. */
+	CBEvent ** timeouts; /**< Binary heap of the pending events with timeouts, with the earliest deadline first. */
+	uint32_t timeoutNum;
+	uint32_t timeoutCap;
+	CBEpollSocket ** ready; /**< Sockets which are ready for a pending event. */
+	uint32_t readyNum;
+	uint32_t readyCap;
+	CBEpollSocket ** dispatching; /**< The ready sockets being dispatched in the current iteration. */
+	uint32_t dispatchingCap;
+	CBEpollSocket * freedSockets; /**< Sockets which are freed at the end of the loop iteration, as epoll events may still refer to them. */
+	CBTimer * freedTimers; /**< Timers which are freed at the end of the loop iteration. */
+}CBEventLoop;
+
+union CBOnEvent{
+	void (*i)(void *, CBDepObject);
+	void (*ptr)(void *, void *);
+};
+
+/**
+ @brief The epoll registration of a socket which is shared by the events of the socket.
+ */
+struct CBEpollSocket{
+	CBEpollSourceType source;
+	CBEventLoop * loop;
+	int fd; /**< The socket or -1 when the socket was closed or all the events were freed. */
+	bool edge; /**< True for edge-triggered sockets. Listening sockets are level-triggered. */
+	uint32_t ready; /**< EPOLLIN and EPOLLOUT for readiness which has not been used up. Only changed by the loop thread. */
+	bool peek; /**< True when the last read filled the buffer, so the socket may or may not have more data. */
+	bool queued; /**< True when in the ready list of the loop. */
+	int eventNum; /**< The number of events using this socket. Protected by CBEpollSocketsMutex. */
+	CBEvent * read; /**< The pending accept or receive event. */
+	CBEvent * write; /**< The pending connect or send event. */
+	unsigned char * buffer; /**< Data which was read from the socket for small reads and is given to the next reads. Allocated when first needed. */
+	uint32_t bufferStart;
+	uint32_t bufferEnd;
+	CBEpollSocket * nextFreed;
+};
+
+struct CBEvent{
+	CBEventLoop * loop;
+	CBEpollSocket * socket;
+	CBEpollEventType type;
+	union CBOnEvent onEvent;
+	void * peer;
+	int timeout; /**< The timeout in milliseconds or 0 for none. */
+	uint64_t deadline; /**< The time of the timeout in milliseconds of the monotonic clock. */
+	uint32_t heapIndex; /**< The index of the event in the timeout heap or CB_EPOLL_NO_DEADLINE. */
+};
+
+struct CBTimer{
+	CBEpollSourceType source;
+	CBEventLoop * loop;
+	int fd; /**< The timerfd */
+	void (*callback)(void *); /**< NULL when the timer has ended. */
+	void * arg;
+	CBTimer * nextFreed;
+};
+
+void CBStartEventLoop(void *);
+void CBEpollDispatch(CBEventLoop * loop, CBEpollSocket * sock);
+void CBEpollDispatchTimeouts(CBEventLoop * loop);
+void CBEpollFreeObjects(CBEventLoop * loop, bool all);
+uint64_t CBEpollGetMilliseconds(void);
+CBEpollSocket * CBEpollGetSocket(CBEventLoop * loop, int fd, bool edge);
+int CBEpollGetWaitTime(CBEventLoop * loop);
+bool CBEpollHasData(CBEpollSocket * sock);
+void CBEpollHeapDown(CBEventLoop * loop, uint32_t x);
+void CBEpollHeapSet(CBEventLoop * loop, uint32_t x, CBEvent * event);
+void CBEpollHeapUp(CBEventLoop * loop, uint32_t x);
+CBEvent * CBEpollNewEvent(CBDepObject loopID, CBDepObject socketID, CBEpollEventType type, void * peer);
+void CBEpollQueueSocket(CBEventLoop * loop, CBEpollSocket * sock);
+int32_t CBEpollReadBuffer(CBEpollSocket * sock, unsigned char * data, int len);
+void CBEpollRemoveDeadline(CBEventLoop * loop, CBEvent * event);
+void CBEpollRunEvent(CBEvent * event);
+void CBEpollSetDeadline(CBEventLoop * loop, CBEvent * event, uint64_t deadline);
+void CBEpollWake(CBEventLoop * loop);
+
+#endif
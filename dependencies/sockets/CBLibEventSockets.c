@@ -146,37 +146,6 @@ bool CBNewEventLoop(CBDepObject * loopID, void (*onError)(void *), void (*onDidT
 	return true;
 }
 
-bool CBNetworkCommunicatorLoadDNS(void * vcomm, char * domain){
-
-	CBNetworkCommunicator * comm = vcomm;
-
-	struct addrinfo * addrs;
-
-	if (getaddrinfo(domain, NULL, NULL, &addrs))
-		return false;
-
-	for (;addrs; addrs = addrs->ai_next) {
-
-		CBByteArray * ipBytes;
-
-		if (addrs->ai_family == AF_INET) {
-			int ipInt = ((struct sockaddr_in *)addrs->ai_addr)->sin_addr.s_addr;
-			ipBytes = CBNewByteArrayWithDataCopy((unsigned char [16]){0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF, 0, 0, 0, 0}, 16);
-			CBInt32ToArray(CBByteArrayGetData(ipBytes), 12, ipInt);
-		}else
-			ipBytes = CBNewByteArrayWithDataCopy(((struct sockaddr_in6 *)addrs->ai_addr)->sin6_addr.s6_addr, 16);
-
-		CBNetworkAddress * addr = CBNewNetworkAddress(0, (CBSocketAddress){ipBytes, 8333}, CB_SERVICE_FULL_BLOCKS, false);
-		CBReleaseObject(ipBytes);
-		CBNetworkAddressManagerAddAddress(comm->addresses, addr);
-		CBReleaseObject(addr);
-
-	}
-
-	return true;
-
-}
-
 void CBStartEventLoop(void * vloop){
 	CBEventLoop * loop = vloop;
 	// Start event loop
@@ -322,6 +291,37 @@ int32_t CBSocketSend(CBDepObject socketID, unsigned char * data, int len){
 		return 0; // False event. Wait again.
 	return CB_SOCKET_FAILURE; // Failure
 }
+int32_t CBSocketSendFile(CBDepObject socketID, CBDepObject file, uint64_t offset, int len){
+#ifdef __linux__
+	// sendfile has no MSG_NOSIGNAL, so block SIGPIPE while sending and discard it if it was raised.
+	sigset_t pipeSet, oldSet;
+	sigemptyset(&pipeSet);
+	sigaddset(&pipeSet, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &pipeSet, &oldSet);
+	off_t off = (off_t)offset;
+	ssize_t res = sendfile((evutil_socket_t)socketID.i, file.i, &off, len);
+	int err = errno;
+	if (res < 0 && err == EPIPE && ! sigismember(&oldSet, SIGPIPE)) {
+		struct timespec zero = {0, 0};
+		sigtimedwait(&pipeSet, NULL, &zero);
+	}
+	pthread_sigmask(SIG_SETMASK, &oldSet, NULL);
+	if (res >= 0)
+		return (int32_t)res;
+	if (err == EAGAIN)
+		return 0; // False event. Wait again.
+	return CB_SOCKET_FAILURE; // Failure
+#else
+	// Without sendfile, read the data and send it.
+	unsigned char buf[65536];
+	if (len > (int)sizeof(buf))
+		len = sizeof(buf);
+	ssize_t res = pread(file.i, buf, len, (off_t)offset);
+	if (res <= 0)
+		return CB_SOCKET_FAILURE;
+	return CBSocketSend(socketID, buf, (int)res);
+#endif
+}
 int32_t CBSocketReceive(CBDepObject socketID, unsigned char * data, int len){
 	ssize_t res = read((evutil_socket_t)socketID.i, data, len);
 	if (res > 0)
@@ -374,16 +374,25 @@ void CBDoRun(evutil_socket_t foo, short bar, void * arg){
 
 bool CBRunOnEventLoop(CBDepObject loopID, void (*callback)(void *), void * arg, bool block){
 	CBEventLoop * loop = loopID.ptr;
-	bool done = !block;
-	if (block && pthread_equal(((CBThread *)loop->loopThread.ptr)->thread, pthread_self()) != 0){
-		// We are in the event loop already and we are supposed to block.
-		callback(arg);
+	if (block) {
+		if (pthread_equal(((CBThread *)loop->loopThread.ptr)->thread, pthread_self()) != 0){
+			// We are in the event loop already and we are supposed to block.
+			callback(arg);
+			return true;
+		}
+		// The item stays on the stack until the callback has run.
+		CBCallbackQueueItem item;
+		CBInitCallbackQueueItem(&item, callback, arg, true);
+		if (CBCallbackQueuePush(&loop->queue, &item))
+			event_active(loop->userEvent, 0, 0);
+		CBCallbackQueueWait(&item);
 		return true;
 	}
-	CBCallbackQueueItem * item = CBCallbackQueueAdd(&loop->queue, callback, arg, &done);
-	event_active(loop->userEvent, 0, 0);
-	if (block)
-		CBCallbackQueueWait(item);
+	CBCallbackQueueItem * item = CBCallbackQueueNewItem(&loop->queue, callback, arg);
+	if (! item)
+		return false;
+	if (CBCallbackQueuePush(&loop->queue, item))
+		event_active(loop->userEvent, 0, 0);
 	return true;
 }
 void CBCloseSocket(CBDepObject socketID){
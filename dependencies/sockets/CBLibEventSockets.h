@@ -26,6 +26,10 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <signal.h>
+#endif
 #include <stdlib.h>
 
 #ifndef CBLIBEVENTSOCKETSH
@@ -312,16 +312,25 @@ void CBDoRun(struct ev_loop * loop,struct ev_async * watcher,int event){
 }
 bool CBRunOnEventLoop(CBDepObject loopID, void (*callback)(void *), void * arg, bool block){
 	CBEventLoop * loop = loopID.ptr;
-	bool done = !block;
 	if (pthread_equal(((CBThread *)loop->loopThread.ptr)->thread, pthread_self()) != 0){
 		// We are in the event loop already.
 		callback(arg);
 		return true;
 	}
-	CBCallbackQueueItem * item = CBCallbackQueueAdd(&loop->queue, callback, arg, &done);
-	ev_async_send(loop->base, (struct ev_async *)loop->userEvent);
-	if (block)
-		CBCallbackQueueWait(item);
+	if (block) {
+		// The item stays on the stack until the callback has run.
+		CBCallbackQueueItem item;
+		CBInitCallbackQueueItem(&item, callback, arg, true);
+		if (CBCallbackQueuePush(&loop->queue, &item))
+			ev_async_send(loop->base, (struct ev_async *)loop->userEvent);
+		CBCallbackQueueWait(&item);
+		return true;
+	}
+	CBCallbackQueueItem * item = CBCallbackQueueNewItem(&loop->queue, callback, arg);
+	if (! item)
+		return false;
+	if (CBCallbackQueuePush(&loop->queue, item))
+		ev_async_send(loop->base, (struct ev_async *)loop->userEvent);
 	return true;
 }
 void CBCloseSocket(CBDepObject socketID){
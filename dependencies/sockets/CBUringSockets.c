@@ -0,0 +1,1188 @@
+//
+//  CBUringSockets.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+#include "CBUringSockets.h"
+
+// The sockets with events by file descriptor, so that the events of a socket share its state and closing the socket can detach it.
+pthread_mutex_t CBUringSocketsMutex = PTHREAD_MUTEX_INITIALIZER;
+CBUringSocket ** CBUringSockets = NULL;
+int CBUringSocketsLength = 0;
+
+// Whether the kernel provides what is needed, which is checked once.
+pthread_once_t CBUringProbeOnce = PTHREAD_ONCE_INIT;
+bool CBUringSupported = false;
+
+// The loop of the current thread and the socket being dispatched.
+__thread CBEventLoop * CBUringCurrentLoop = NULL;
+__thread CBUringSocket * CBUringCurrentSocket = NULL;
+
+// Implementation
+
+CBSocketReturn CBNewSocket(CBDepObject * socketID, bool IPv6){
+	// Creating, binding and connecting sockets is the same as with epoll.
+	return CBEpollNewSocket(socketID, IPv6);
+}
+bool CBSocketBind(CBDepObject * socketID, bool IPv6, int port){
+	return CBEpollSocketBind(socketID, IPv6, port);
+}
+bool CBSocketConnect(CBDepObject socketID, unsigned char * IP, bool IPv6, int port){
+	return CBEpollSocketConnect(socketID, IP, IPv6, port);
+}
+bool CBSocketListen(CBDepObject socketID, int maxConnections){
+	if (listen(socketID.i, maxConnections) == -1)
+		return false;
+	if (CBUringIsSupported()) {
+		// The accept is only submitted once the socket is listening.
+		CBUringSocket * sock = CBUringFindSocket(socketID.i);
+		if (sock) {
+			CBMutexLock(sock->loop->mutex);
+			CBUringChangeSocket(sock->loop, sock);
+			CBMutexUnlock(sock->loop->mutex);
+			if (CBUringCurrentLoop != sock->loop)
+				CBUringWake(sock->loop);
+		}
+	}
+	return true;
+}
+bool CBSocketAccept(CBDepObject socketID, CBDepObject * connectionSocketID, void * vsockAddr){
+	if (! CBUringIsSupported())
+		return CBEpollSocketAccept(socketID, connectionSocketID, vsockAddr);
+	CBUringSocket * sock = CBUringFindSocket(socketID.i);
+	if (! sock)
+		// There is no accept event so accept directly.
+		return CBEpollSocketAccept(socketID, connectionSocketID, vsockAddr);
+	// Take a socket accepted by the kernel.
+	CBMutexLock(sock->loop->mutex);
+	if (! sock->acceptedNum) {
+		CBMutexUnlock(sock->loop->mutex);
+		return false;
+	}
+	int fd = sock->accepted[0];
+	memmove(sock->accepted, sock->accepted + 1, --sock->acceptedNum * sizeof(*sock->accepted));
+	CBMutexUnlock(sock->loop->mutex);
+	struct sockaddr_storage addr_storage;
+	CBSocketAddress * sockAddr = vsockAddr;
+	struct sockaddr * addr = (struct sockaddr *)&addr_storage;
+	socklen_t addrLen = sizeof(addr_storage);
+	if (getpeername(fd, addr, &addrLen)) {
+		// The connection was lost already.
+		close(fd);
+		return false;
+	}
+	connectionSocketID->i = fd;
+	if (addr->sa_family == AF_INET) {
+		int ipInt = ((struct sockaddr_in *)addr)->sin_addr.s_addr;
+		sockAddr->ip = CBNewByteArrayWithDataCopy((unsigned char [16]){0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF, 0, 0, 0, 0}, 16);
+		CBInt32ToArray(CBByteArrayGetData(sockAddr->ip), 12, ipInt);
+		sockAddr->port = ((struct sockaddr_in *)addr)->sin_port;
+	}else{
+		sockAddr->ip = CBNewByteArrayWithDataCopy(((struct sockaddr_in6 *)addr)->sin6_addr.s6_addr, 16);
+		sockAddr->port = ((struct sockaddr_in6 *)addr)->sin6_port;
+	}
+	return true;
+}
+bool CBNewEventLoop(CBDepObject * loopID, void (*onError)(void *), void (*onDidTimeout)(void *, void *, CBTimeOutType), void * communicator){
+	if (! CBUringIsSupported())
+		return CBEpollNewEventLoop(loopID, onError, onDidTimeout, communicator);
+	CBEventLoop * loop = calloc(1, sizeof(*loop));
+	if (! CBUringSetUp(loop, CB_URING_ENTRIES, CB_URING_COMPLETION_ENTRIES)) {
+		free(loop);
+		return false;
+	}
+	// The eventfd for waking the loop is blocking, so that the read submitted for it waits to be woken.
+	loop->wake = eventfd(0, EFD_CLOEXEC);
+	if (loop->wake == -1) {
+		CBLogError("Could not create an eventfd for the event loop: %s", strerror(errno));
+		CBUringFreeRing(loop);
+		free(loop);
+		return false;
+	}
+	loop->onError = onError;
+	loop->onTimeOut = onDidTimeout;
+	loop->communicator = communicator;
+	CBNewMutex(&loop->mutex);
+	// Create queue
+	CBInitCallbackQueue(&loop->queue);
+	// Create thread
+	CBNewThread(&loop->loopThread, CBStartEventLoop, loop);
+	loopID->ptr = loop;
+	return true;
+}
+void CBStartEventLoop(void * vloop){
+	CBEventLoop * loop = vloop;
+	CBUringCurrentLoop = loop;
+	CBLogVerbose("Starting network event loop with io_uring.");
+	CBMutexLock(loop->mutex);
+	while (! loop->exit) {
+		// Submit everything for this iteration with the wait for completions.
+		if (! loop->wakeArmed)
+			CBUringSubmit(loop, NULL, CB_URING_OP_WAKE);
+		CBUringSubmitChanges(loop);
+		int64_t wait = CBUringGetWaitTime(loop);
+		CBMutexUnlock(loop->mutex);
+		int res = CBUringEnter(loop, wait != 0, wait);
+		CBMutexLock(loop->mutex);
+		if (res < 0 && res != -EINTR && res != -ETIME && res != -EBUSY) {
+			CBLogError("io_uring_enter failed with the error %s", strerror(-res));
+			CBMutexUnlock(loop->mutex);
+			loop->onError(loop->communicator);
+			CBMutexLock(loop->mutex);
+			break;
+		}
+		bool runQueue = false;
+		CBUringReap(loop, &runQueue);
+		// Run callbacks from other threads first, as they were given before the completions.
+		if (runQueue) {
+			CBMutexUnlock(loop->mutex);
+			CBCallbackQueueRun(&loop->queue);
+			CBMutexLock(loop->mutex);
+		}
+		// Dispatch the ready sockets. Sockets which remain ready are queued again for the next iteration.
+		CBUringSocketList dispatching = loop->ready;
+		loop->ready = loop->dispatching;
+		loop->ready.num = 0;
+		loop->dispatching = dispatching;
+		for (uint32_t x = 0; x < dispatching.num; x++)
+			CBUringDispatch(loop, dispatching.sockets[x]);
+		CBUringDispatchDeadlines(loop);
+		CBUringFreeObjects(loop, false);
+	}
+	// Break from loop. The kernel may use the buffers until the requests complete, so cancel them and wait.
+	CBUringCancelAll(loop);
+	CBMutexUnlock(loop->mutex);
+	// Free everything.
+	CBUringFreeObjects(loop, true);
+	close(loop->wake);
+	CBUringFreeRing(loop);
+	free(loop->deadlines);
+	free(loop->ready.sockets);
+	free(loop->dispatching.sockets);
+	free(loop->changed.sockets);
+	free(loop->starved.sockets);
+	CBFreeMutex(loop->mutex);
+	CBFreeCallbackQueue(&loop->queue);
+	free(loop);
+}
+void CBUringAddAccepted(CBUringSocket * sock, int fd){
+	if (sock->acceptedNum == sock->acceptedCap) {
+		sock->acceptedCap = sock->acceptedCap ? sock->acceptedCap * 2 : 8;
+		sock->accepted = realloc(sock->accepted, sock->acceptedCap * sizeof(*sock->accepted));
+	}
+	sock->accepted[sock->acceptedNum++] = fd;
+}
+void CBUringAddReceived(CBUringSocket * sock, uint16_t id, uint32_t length){
+	if (sock->receivedNum == sock->receivedCap) {
+		// Grow the ring, putting the buffers in order at the start.
+		uint32_t cap = sock->receivedCap ? sock->receivedCap * 2 : 8;
+		CBUringBuffer * received = malloc(cap * sizeof(*received));
+		for (uint32_t x = 0; x < sock->receivedNum; x++)
+			received[x] = sock->received[(sock->receivedStart + x) & (sock->receivedCap - 1)];
+		free(sock->received);
+		sock->received = received;
+		sock->receivedCap = cap;
+		sock->receivedStart = 0;
+	}
+	sock->received[(sock->receivedStart + sock->receivedNum++) & (sock->receivedCap - 1)] = (CBUringBuffer){id, 0, length};
+}
+bool CBUringCancel(CBEventLoop * loop, CBUringSocket * sock, CBUringOp op){
+	struct io_uring_sqe * sqe = CBUringGetSubmission(loop);
+	if (! sqe)
+		return false;
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = (uint64_t)(uintptr_t)sock | op;
+	sqe->user_data = CB_URING_OP_CANCEL;
+	return true;
+}
+void CBUringCancelAll(CBEventLoop * loop){
+	// The loop mutex is locked.
+	struct io_uring_sqe * sqe = CBUringGetSubmission(loop);
+	if (! sqe)
+		return;
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+	sqe->user_data = CB_URING_OP_CANCEL;
+	// The read of the eventfd may be waiting in a kernel thread, so complete it.
+	CBUringWake(loop);
+	while (loop->pending) {
+		int res = CBUringEnter(loop, 1, -1);
+		if (res < 0 && res != -EINTR && res != -EBUSY) {
+			CBLogError("Could not wait for the io_uring requests to be cancelled: %s", strerror(-res));
+			break;
+		}
+		bool runQueue;
+		CBUringReap(loop, &runQueue);
+	}
+}
+void CBUringCancelSocket(CBEventLoop * loop, int fd){
+	// The requests hold the socket open, so cancel them now for the socket to be released when it is closed, so that the address can be bound again.
+	struct io_uring_sync_cancel_reg reg;
+	memset(&reg, 0, sizeof(reg));
+	reg.fd = fd;
+	reg.flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+	reg.timeout.tv_sec = reg.timeout.tv_nsec = -1;
+	if (syscall(__NR_io_uring_register, loop->ring, IORING_REGISTER_SYNC_CANCEL, &reg, 1) && errno != ENOENT)
+		// The kernel cannot cancel synchronously, so end the requests by shutting down the socket.
+		shutdown(fd, SHUT_RDWR);
+}
+void CBUringChangeSocket(CBEventLoop * loop, CBUringSocket * sock){
+	if (sock->changed)
+		return;
+	sock->changed = true;
+	CBUringSocketListAdd(&loop->changed, sock);
+}
+void CBUringComplete(CBEventLoop * loop, struct io_uring_cqe * cqe, bool * runQueue){
+	CBUringOp op = cqe->user_data & CB_URING_OP_MASK;
+	CBUringSocket * sock = (CBUringSocket *)(uintptr_t)(cqe->user_data & ~(uint64_t)CB_URING_OP_MASK);
+	bool more = cqe->flags & IORING_CQE_F_MORE;
+	int res = cqe->res;
+	if (op == CB_URING_OP_CANCEL)
+		return;
+	if (! more)
+		loop->pending--;
+	switch (op) {
+		case CB_URING_OP_WAKE:
+			// Woken by another thread. The read reset the eventfd.
+			loop->wakeArmed = false;
+			*runQueue = true;
+			return;
+		case CB_URING_OP_RECEIVE:
+			if (cqe->flags & IORING_CQE_F_BUFFER) {
+				uint16_t id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+				if (res > 0 && sock->fd != -1)
+					CBUringAddReceived(sock, id, (uint32_t)res);
+				else
+					CBUringReturnBuffer(loop, id);
+			}
+			if (! more)
+				sock->receiving = sock->throttled = false;
+			if (! res)
+				sock->closed = true;
+			else if (res == -ENOBUFS) {
+				// Receive again when a buffer is returned.
+				if (! sock->starved) {
+					sock->starved = true;
+					CBUringSocketListAdd(&loop->starved, sock);
+				}
+				break;
+			}else if (res == -EINVAL && loop->multishotReceive) {
+				CBLogVerbose("The kernel does not support multishot receives, so each receive is submitted again.");
+				loop->multishotReceive = false;
+			}else if (res < 0 && res != -ECANCELED)
+				sock->error = -res;
+			if (! more || sock->receivedNum >= CB_URING_SOCKET_BUFFERS)
+				// Receive again, or stop receiving until the data has been read.
+				CBUringChangeSocket(loop, sock);
+			break;
+		case CB_URING_OP_SEND:
+			sock->sending = false;
+			if (res > 0) {
+				sock->sendLength -= (uint32_t)res;
+				memmove(sock->sendBuffer, sock->sendBuffer + res, sock->sendLength);
+			}else if (res < 0 && res != -EAGAIN && res != -ECANCELED)
+				sock->error = -res;
+			if (sock->sendLength)
+				CBUringChangeSocket(loop, sock);
+			else
+				// The file can be sent after the buffered data.
+				sock->fileBlocked = false;
+			break;
+		case CB_URING_OP_ACCEPT:
+			if (res >= 0) {
+				if (sock->fd == -1)
+					close(res);
+				else
+					CBUringAddAccepted(sock, res);
+			}else if (res != -ECANCELED)
+				CBLogWarning("Accepting a connection gave the error %s", strerror(-res));
+			if (! more) {
+				sock->accepting = false;
+				CBUringChangeSocket(loop, sock);
+			}
+			break;
+		case CB_URING_OP_CONNECT:
+			// The callback gets any error of the connection with SO_ERROR.
+			sock->polling = false;
+			if (res != -ECANCELED)
+				sock->connected = true;
+			break;
+		case CB_URING_OP_WRITABLE:
+			sock->pollingWritable = sock->fileBlocked = false;
+			if (res < 0 && res != -ECANCELED)
+				sock->error = -res;
+			break;
+		case CB_URING_OP_CANCEL:
+			break;
+	}
+	CBUringQueueSocket(loop, sock);
+}
+void CBUringDispatch(CBEventLoop * loop, CBUringSocket * sock){
+	// The loop mutex is locked, and is unlocked while the callbacks run.
+	sock->queued = false;
+	for (int side = 0; side < 2; side++) {
+		for (int x = 0; x < CB_URING_DISPATCH_MAX; x++) {
+			CBEvent * event = side ? sock->write : sock->read;
+			if (sock->fd == -1 || ! CBUringIsReady(sock, side))
+				break;
+			if (event->type == CB_URING_EVENT_CONNECT) {
+				// Connection events only happen once.
+				sock->write = NULL;
+				CBUringRemoveDeadline(loop, &event->deadline);
+			}else if (! x && event->timeout)
+				// Restart the timeout as the event is active.
+				CBUringSetDeadline(loop, &event->deadline, CBUringGetMilliseconds() + event->timeout);
+			CBUringCurrentSocket = sock;
+			CBMutexUnlock(loop->mutex);
+			CBUringRunEvent(event);
+			CBMutexLock(loop->mutex);
+			CBUringCurrentSocket = NULL;
+		}
+	}
+	// If the socket is still ready it used up its turn, so continue in the next iteration.
+	CBUringQueueSocket(loop, sock);
+}
+void CBUringDispatchDeadlines(CBEventLoop * loop){
+	// The loop mutex is locked. Take one deadline at a time as the callbacks may remove others.
+	uint64_t now = CBUringGetMilliseconds();
+	while (loop->deadlineNum && loop->deadlines[0]->time <= now) {
+		CBUringDeadline * deadline = loop->deadlines[0];
+		if (deadline->timer) {
+			CBTimer * timer = (CBTimer *)deadline;
+			// Keep to the period unless the loop has fallen behind.
+			uint64_t next = deadline->time + timer->time;
+			CBUringSetDeadline(loop, deadline, next > now ? next : now + timer->time);
+			CBMutexUnlock(loop->mutex);
+			timer->callback(timer->arg);
+			CBMutexLock(loop->mutex);
+			continue;
+		}
+		CBEvent * event = (CBEvent *)deadline;
+		CBTimeOutType type;
+		if (event->type == CB_URING_EVENT_CONNECT) {
+			// Connection events only happen once.
+			event->socket->write = NULL;
+			CBUringRemoveDeadline(loop, deadline);
+			type = CB_TIMEOUT_CONNECT;
+		}else{
+			CBUringSetDeadline(loop, deadline, now + event->timeout);
+			type = event->type == CB_URING_EVENT_SEND ? CB_TIMEOUT_SEND : CB_TIMEOUT_RECEIVE;
+		}
+		void * peer = event->peer;
+		CBMutexUnlock(loop->mutex);
+		loop->onTimeOut(loop->communicator, peer, type);
+		CBMutexLock(loop->mutex);
+	}
+}
+int CBUringEnter(CBEventLoop * loop, unsigned minComplete, int64_t wait){
+	// Give the new submissions to the kernel.
+	__atomic_store_n(loop->sqTail, loop->sqLocalTail, __ATOMIC_RELEASE);
+	unsigned toSubmit = loop->sqLocalTail - __atomic_load_n(loop->sqHead, __ATOMIC_ACQUIRE);
+	if (! toSubmit && ! minComplete)
+		return 0;
+	struct __kernel_timespec time = {wait / 1000, (wait % 1000) * 1000000};
+	struct io_uring_getevents_arg arg = {.sigmask = 0, .sigmask_sz = _NSIG / 8, .ts = wait > 0 ? (uint64_t)(uintptr_t)&time : 0};
+	long res = syscall(__NR_io_uring_enter, loop->ring, toSubmit, minComplete, (minComplete ? IORING_ENTER_GETEVENTS : 0) | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+	return res < 0 ? -errno : (int)res;
+}
+CBUringSocket * CBUringFindSocket(int fd){
+	if (CBUringCurrentSocket && CBUringCurrentSocket->fd == fd)
+		return CBUringCurrentSocket;
+	pthread_mutex_lock(&CBUringSocketsMutex);
+	CBUringSocket * sock = fd < CBUringSocketsLength ? CBUringSockets[fd] : NULL;
+	pthread_mutex_unlock(&CBUringSocketsMutex);
+	return sock;
+}
+void CBUringFreeObjects(CBEventLoop * loop, bool all){
+	CBUringSocket ** sockPtr = &loop->freedSockets;
+	while (*sockPtr) {
+		CBUringSocket * sock = *sockPtr;
+		if (! all && (sock->queued || sock->changed || sock->starved || CBUringIsBusy(sock))) {
+			// Wait until the socket is out of the lists and the kernel has completed the requests.
+			sockPtr = &sock->nextFreed;
+			continue;
+		}
+		*sockPtr = sock->nextFreed;
+		if (! all)
+			for (uint32_t x = 0; x < sock->receivedNum; x++)
+				CBUringReturnBuffer(loop, sock->received[(sock->receivedStart + x) & (sock->receivedCap - 1)].id);
+		for (uint32_t x = 0; x < sock->acceptedNum; x++)
+			close(sock->accepted[x]);
+		free(sock->received);
+		free(sock->sendBuffer);
+		free(sock->accepted);
+		free(sock);
+	}
+	while (loop->freedTimers) {
+		CBTimer * timer = loop->freedTimers;
+		loop->freedTimers = timer->nextFreed;
+		free(timer);
+	}
+}
+void CBUringFreeRing(CBEventLoop * loop){
+	// Closing the ring also removes the buffer ring registration.
+	if (loop->ring != -1)
+		close(loop->ring);
+	if (loop->sqes && loop->sqes != MAP_FAILED)
+		munmap(loop->sqes, loop->sqesSize);
+	if (loop->cqMap && loop->cqMap != MAP_FAILED && loop->cqMap != loop->sqMap)
+		munmap(loop->cqMap, loop->cqMapSize);
+	if (loop->sqMap && loop->sqMap != MAP_FAILED)
+		munmap(loop->sqMap, loop->sqMapSize);
+	if (loop->bufferRing && loop->bufferRing != MAP_FAILED)
+		munmap(loop->bufferRing, CB_URING_BUFFER_NUM * sizeof(struct io_uring_buf));
+	free(loop->buffers);
+}
+uint64_t CBUringGetMilliseconds(void){
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (uint64_t)time.tv_sec * 1000 + time.tv_nsec / 1000000;
+}
+CBUringSocket * CBUringGetSocket(CBEventLoop * loop, int fd){
+	pthread_mutex_lock(&CBUringSocketsMutex);
+	if (fd >= CBUringSocketsLength) {
+		int length = CBUringSocketsLength ? CBUringSocketsLength : 64;
+		while (length <= fd)
+			length *= 2;
+		CBUringSockets = realloc(CBUringSockets, length * sizeof(*CBUringSockets));
+		memset(CBUringSockets + CBUringSocketsLength, 0, (length - CBUringSocketsLength) * sizeof(*CBUringSockets));
+		CBUringSocketsLength = length;
+	}
+	CBUringSocket * sock = CBUringSockets[fd];
+	if (sock && sock->loop != loop) {
+		pthread_mutex_unlock(&CBUringSocketsMutex);
+		CBLogError("The socket %i already has events on another event loop.", fd);
+		return NULL;
+	}
+	if (! sock) {
+		sock = calloc(1, sizeof(*sock));
+		sock->loop = loop;
+		sock->fd = fd;
+		CBUringSockets[fd] = sock;
+	}
+	sock->eventNum++;
+	pthread_mutex_unlock(&CBUringSocketsMutex);
+	return sock;
+}
+struct io_uring_sqe * CBUringGetSubmission(CBEventLoop * loop){
+	if (loop->sqLocalTail - __atomic_load_n(loop->sqHead, __ATOMIC_ACQUIRE) == loop->sqEntries) {
+		// The queue is full, so give it to the kernel now.
+		CBUringEnter(loop, 0, 0);
+		if (loop->sqLocalTail - __atomic_load_n(loop->sqHead, __ATOMIC_ACQUIRE) == loop->sqEntries) {
+			CBLogError("The io_uring submission queue is full.");
+			return NULL;
+		}
+	}
+	struct io_uring_sqe * sqe = &loop->sqes[loop->sqLocalTail++ & loop->sqMask];
+	memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+int64_t CBUringGetWaitTime(CBEventLoop * loop){
+	if (loop->ready.num)
+		return 0;
+	if (! loop->deadlineNum)
+		return -1;
+	uint64_t now = CBUringGetMilliseconds(), deadline = loop->deadlines[0]->time;
+	return deadline > now ? (int64_t)(deadline - now) : 0;
+}
+void CBUringHeapDown(CBEventLoop * loop, uint32_t x){
+	CBUringDeadline * deadline = loop->deadlines[x];
+	for (;;) {
+		uint32_t child = x * 2 + 1;
+		if (child >= loop->deadlineNum)
+			break;
+		if (child + 1 < loop->deadlineNum && loop->deadlines[child + 1]->time < loop->deadlines[child]->time)
+			child++;
+		if (deadline->time <= loop->deadlines[child]->time)
+			break;
+		CBUringHeapSet(loop, x, loop->deadlines[child]);
+		x = child;
+	}
+	CBUringHeapSet(loop, x, deadline);
+}
+void CBUringHeapSet(CBEventLoop * loop, uint32_t x, CBUringDeadline * deadline){
+	loop->deadlines[x] = deadline;
+	deadline->heapIndex = x;
+}
+void CBUringHeapUp(CBEventLoop * loop, uint32_t x){
+	CBUringDeadline * deadline = loop->deadlines[x];
+	while (x) {
+		uint32_t parent = (x - 1) / 2;
+		if (loop->deadlines[parent]->time <= deadline->time)
+			break;
+		CBUringHeapSet(loop, x, loop->deadlines[parent]);
+		x = parent;
+	}
+	CBUringHeapSet(loop, x, deadline);
+}
+bool CBUringIsBusy(CBUringSocket * sock){
+	return sock->receiving || sock->sending || sock->accepting || sock->polling || sock->pollingWritable;
+}
+bool CBUringIsListening(int fd){
+	int listening = 0;
+	socklen_t len = sizeof(listening);
+	return ! getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) && listening;
+}
+bool CBUringIsReady(CBUringSocket * sock, bool write){
+	CBEvent * event = write ? sock->write : sock->read;
+	if (! event)
+		return false;
+	switch (event->type) {
+		case CB_URING_EVENT_ACCEPT:
+			return sock->acceptedNum;
+		case CB_URING_EVENT_RECEIVE:
+			// The end of the stream and errors are given to the callback by its read.
+			return sock->receivedNum || sock->closed || sock->error;
+		case CB_URING_EVENT_CONNECT:
+			return sock->connected;
+		case CB_URING_EVENT_SEND:
+			// While sending the buffer cannot be moved, so it can only be filled to its current size.
+			return sock->error || (! sock->fileBlocked && sock->sendLength < (sock->sending ? sock->sendCap : CB_URING_SEND_BUFFER_SIZE));
+	}
+	return false;
+}
+bool CBUringIsSupported(void){
+	pthread_once(&CBUringProbeOnce, CBUringProbe);
+	return CBUringSupported;
+}
+CBEvent * CBUringNewEvent(CBDepObject loopID, CBDepObject socketID, CBUringEventType type, void * peer){
+	CBEvent * event = malloc(sizeof(*event));
+	event->loop = loopID.ptr;
+	event->socket = CBUringGetSocket(event->loop, socketID.i);
+	if (! event->socket) {
+		free(event);
+		return NULL;
+	}
+	event->type = type;
+	event->peer = peer;
+	event->timeout = 0;
+	event->deadline.heapIndex = CB_URING_NO_DEADLINE;
+	event->deadline.timer = false;
+	return event;
+}
+void CBUringProbe(void){
+	if (getenv("CB_NO_IO_URING")) {
+		CBLogVerbose("CB_NO_IO_URING is set, so epoll is used instead of io_uring.");
+		return;
+	}
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	int ring = (int)syscall(__NR_io_uring_setup, 4, &params);
+	if (ring == -1) {
+		CBLogVerbose("io_uring is not available (%s), so epoll is used instead.", strerror(errno));
+		return;
+	}
+	unsigned features = IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+	bool supported = (params.features & features) == features;
+	// Check the operations which are used.
+	struct io_uring_probe * probe = calloc(1, sizeof(*probe) + 256 * sizeof(struct io_uring_probe_op));
+	if (supported && ! syscall(__NR_io_uring_register, ring, IORING_REGISTER_PROBE, probe, 256)) {
+		uint8_t ops[] = {IORING_OP_RECV, IORING_OP_SEND, IORING_OP_ACCEPT, IORING_OP_POLL_ADD, IORING_OP_ASYNC_CANCEL, IORING_OP_READ};
+		for (size_t x = 0; x < sizeof(ops); x++)
+			if (ops[x] >= probe->ops_len || ! (probe->ops[ops[x]].flags & IO_URING_OP_SUPPORTED))
+				supported = false;
+	}else
+		supported = false;
+	free(probe);
+	// Buffer rings came with multishot accepts, so registering one checks for both.
+	if (supported) {
+		struct io_uring_buf_ring * bufferRing = mmap(NULL, sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		struct io_uring_buf_reg reg;
+		memset(&reg, 0, sizeof(reg));
+		reg.ring_addr = (uint64_t)(uintptr_t)bufferRing;
+		reg.ring_entries = 1;
+		reg.bgid = CB_URING_BUFFER_GROUP;
+		supported = bufferRing != MAP_FAILED && ! syscall(__NR_io_uring_register, ring, IORING_REGISTER_PBUF_RING, &reg, 1);
+		if (supported)
+			syscall(__NR_io_uring_register, ring, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+		if (bufferRing != MAP_FAILED)
+			munmap(bufferRing, sizeof(struct io_uring_buf));
+	}
+	close(ring);
+	if (! supported)
+		CBLogVerbose("The kernel lacks io_uring features which are needed, so epoll is used instead.");
+	CBUringSupported = supported;
+}
+void CBUringQueueSocket(CBEventLoop * loop, CBUringSocket * sock){
+	if (sock->queued || sock->fd == -1 || ! (CBUringIsReady(sock, false) || CBUringIsReady(sock, true)))
+		return;
+	CBUringSocketListAdd(&loop->ready, sock);
+	sock->queued = true;
+}
+void CBUringReap(CBEventLoop * loop, bool * runQueue){
+	*runQueue = false;
+	unsigned head = *loop->cqHead, tail = __atomic_load_n(loop->cqTail, __ATOMIC_ACQUIRE);
+	for (; head != tail; head++)
+		CBUringComplete(loop, &loop->cqes[head & loop->cqMask], runQueue);
+	__atomic_store_n(loop->cqHead, head, __ATOMIC_RELEASE);
+}
+void CBUringRemoveDeadline(CBEventLoop * loop, CBUringDeadline * deadline){
+	if (deadline->heapIndex == CB_URING_NO_DEADLINE)
+		return;
+	uint32_t x = deadline->heapIndex;
+	deadline->heapIndex = CB_URING_NO_DEADLINE;
+	CBUringDeadline * last = loop->deadlines[--loop->deadlineNum];
+	if (x != loop->deadlineNum) {
+		// Move the last deadline into the gap.
+		CBUringHeapSet(loop, x, last);
+		CBUringHeapUp(loop, x);
+		CBUringHeapDown(loop, last->heapIndex);
+	}
+}
+void CBUringReturnBuffer(CBEventLoop * loop, uint16_t id){
+	// The loop mutex is locked. The tail shares memory with the first buffer, so only the fields of the buffer are set.
+	struct io_uring_buf * buf = &loop->bufferRing->bufs[loop->bufferTail & (CB_URING_BUFFER_NUM - 1)];
+	buf->addr = (uint64_t)(uintptr_t)(loop->buffers + (size_t)id * CB_URING_BUFFER_SIZE);
+	buf->len = CB_URING_BUFFER_SIZE;
+	buf->bid = id;
+	__atomic_store_n(&loop->bufferRing->tail, ++loop->bufferTail, __ATOMIC_RELEASE);
+	// Sockets which ran out of buffers can receive again.
+	for (uint32_t x = 0; x < loop->starved.num; x++) {
+		loop->starved.sockets[x]->starved = false;
+		CBUringChangeSocket(loop, loop->starved.sockets[x]);
+	}
+	loop->starved.num = 0;
+}
+void CBUringRunEvent(CBEvent * event){
+	CBEventLoop * loop = event->loop;
+	if (event->type == CB_URING_EVENT_ACCEPT)
+		event->onEvent.i(loop->communicator, (CBDepObject){.i = event->socket->fd});
+	else if (event->type == CB_URING_EVENT_CONNECT) {
+		int optval = -1;
+		socklen_t optlen = sizeof(optval);
+		getsockopt(event->socket->fd, SOL_SOCKET, SO_ERROR, &optval, &optlen);
+		if (optval){
+			// Act as timeout
+			CBLogWarning("Connection error: %s", strerror(optval));
+			loop->onTimeOut(loop->communicator, event->peer, CB_TIMEOUT_CONNECT_ERROR);
+		}else
+			// Connection successful
+			event->onEvent.ptr(loop->communicator, event->peer);
+	}else
+		// Can send or receive
+		event->onEvent.ptr(loop->communicator, event->peer);
+}
+uint32_t CBUringSendSpace(CBUringSocket * sock, int len){
+	uint32_t want = sock->sendLength + (uint32_t)len;
+	if (want > CB_URING_SEND_BUFFER_SIZE)
+		want = CB_URING_SEND_BUFFER_SIZE;
+	if (want > sock->sendCap && ! sock->sending) {
+		// Grow the buffer, which cannot move while the kernel is sending from it.
+		uint32_t cap = sock->sendCap ? sock->sendCap : 4096;
+		while (cap < want)
+			cap *= 2;
+		sock->sendBuffer = realloc(sock->sendBuffer, cap);
+		sock->sendCap = cap;
+	}
+	uint32_t space = sock->sendCap - sock->sendLength;
+	return space < (uint32_t)len ? space : (uint32_t)len;
+}
+void CBUringSetDeadline(CBEventLoop * loop, CBUringDeadline * deadline, uint64_t time){
+	if (deadline->heapIndex == CB_URING_NO_DEADLINE) {
+		if (loop->deadlineNum == loop->deadlineCap) {
+			loop->deadlineCap = loop->deadlineCap ? loop->deadlineCap * 2 : 64;
+			loop->deadlines = realloc(loop->deadlines, loop->deadlineCap * sizeof(*loop->deadlines));
+		}
+		deadline->time = time;
+		CBUringHeapSet(loop, loop->deadlineNum++, deadline);
+		CBUringHeapUp(loop, deadline->heapIndex);
+	}else{
+		bool earlier = time < deadline->time;
+		deadline->time = time;
+		if (earlier)
+			CBUringHeapUp(loop, deadline->heapIndex);
+		else
+			CBUringHeapDown(loop, deadline->heapIndex);
+	}
+}
+bool CBUringSetUp(CBEventLoop * loop, unsigned entries, unsigned completionEntries){
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	params.flags = IORING_SETUP_CQSIZE;
+	params.cq_entries = completionEntries;
+	loop->ring = (int)syscall(__NR_io_uring_setup, entries, &params);
+	if (loop->ring == -1) {
+		CBLogError("Could not create an io_uring instance: %s", strerror(errno));
+		return false;
+	}
+	// Map the rings and the submission entries.
+	loop->sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	loop->cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP && loop->cqMapSize > loop->sqMapSize)
+		loop->sqMapSize = loop->cqMapSize;
+	loop->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	loop->sqMap = mmap(NULL, loop->sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, loop->ring, IORING_OFF_SQ_RING);
+	loop->cqMap = params.features & IORING_FEAT_SINGLE_MMAP ? loop->sqMap
+		: mmap(NULL, loop->cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, loop->ring, IORING_OFF_CQ_RING);
+	loop->sqes = mmap(NULL, loop->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, loop->ring, IORING_OFF_SQES);
+	loop->bufferRing = mmap(NULL, CB_URING_BUFFER_NUM * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (loop->sqMap == MAP_FAILED || loop->cqMap == MAP_FAILED || loop->sqes == MAP_FAILED || loop->bufferRing == MAP_FAILED) {
+		CBLogError("Could not map the io_uring queues: %s", strerror(errno));
+		CBUringFreeRing(loop);
+		return false;
+	}
+	unsigned char * sq = loop->sqMap, * cq = loop->cqMap;
+	loop->sqHead = (unsigned *)(sq + params.sq_off.head);
+	loop->sqTail = (unsigned *)(sq + params.sq_off.tail);
+	loop->sqMask = *(unsigned *)(sq + params.sq_off.ring_mask);
+	loop->sqEntries = params.sq_entries;
+	loop->sqLocalTail = *loop->sqTail;
+	// The entries are used in order, so the array of indices is set once.
+	unsigned * array = (unsigned *)(sq + params.sq_off.array);
+	for (unsigned x = 0; x < loop->sqEntries; x++)
+		array[x] = x;
+	loop->cqHead = (unsigned *)(cq + params.cq_off.head);
+	loop->cqTail = (unsigned *)(cq + params.cq_off.tail);
+	loop->cqMask = *(unsigned *)(cq + params.cq_off.ring_mask);
+	loop->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+	// Provide the receive buffers.
+	loop->buffers = malloc((size_t)CB_URING_BUFFER_NUM * CB_URING_BUFFER_SIZE);
+	struct io_uring_buf_reg reg;
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (uint64_t)(uintptr_t)loop->bufferRing;
+	reg.ring_entries = CB_URING_BUFFER_NUM;
+	reg.bgid = CB_URING_BUFFER_GROUP;
+	if (syscall(__NR_io_uring_register, loop->ring, IORING_REGISTER_PBUF_RING, &reg, 1)) {
+		CBLogError("Could not register the io_uring receive buffers: %s", strerror(errno));
+		CBUringFreeRing(loop);
+		return false;
+	}
+	for (uint16_t x = 0; x < CB_URING_BUFFER_NUM; x++)
+		CBUringReturnBuffer(loop, x);
+	loop->multishotReceive = true;
+	return true;
+}
+void CBUringSocketListAdd(CBUringSocketList * list, CBUringSocket * sock){
+	if (list->num == list->cap) {
+		list->cap = list->cap ? list->cap * 2 : 64;
+		list->sockets = realloc(list->sockets, list->cap * sizeof(*list->sockets));
+	}
+	list->sockets[list->num++] = sock;
+}
+bool CBUringSubmit(CBEventLoop * loop, CBUringSocket * sock, CBUringOp op){
+	struct io_uring_sqe * sqe = CBUringGetSubmission(loop);
+	if (! sqe)
+		return false;
+	sqe->user_data = (uint64_t)(uintptr_t)sock | op;
+	switch (op) {
+		case CB_URING_OP_RECEIVE:
+			// The kernel takes a buffer for the data from the buffer ring.
+			sqe->opcode = IORING_OP_RECV;
+			sqe->fd = sock->fd;
+			sqe->flags = IOSQE_BUFFER_SELECT;
+			sqe->buf_group = CB_URING_BUFFER_GROUP;
+			if (loop->multishotReceive)
+				sqe->ioprio = IORING_RECV_MULTISHOT;
+			sock->receiving = true;
+			break;
+		case CB_URING_OP_SEND:
+			sqe->opcode = IORING_OP_SEND;
+			sqe->fd = sock->fd;
+			sqe->addr = (uint64_t)(uintptr_t)sock->sendBuffer;
+			sqe->len = sock->sendLength;
+			sqe->msg_flags = MSG_NOSIGNAL;
+			sock->sending = true;
+			break;
+		case CB_URING_OP_ACCEPT:
+			sqe->opcode = IORING_OP_ACCEPT;
+			sqe->fd = sock->fd;
+			sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+			sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+			sock->accepting = true;
+			break;
+		case CB_URING_OP_CONNECT:
+			// Wait for the socket to become writable, which happens when the connection completes or fails.
+			sqe->opcode = IORING_OP_POLL_ADD;
+			sqe->fd = sock->fd;
+			sqe->poll32_events = POLLOUT;
+			sock->polling = true;
+			break;
+		case CB_URING_OP_WRITABLE:
+			sqe->opcode = IORING_OP_POLL_ADD;
+			sqe->fd = sock->fd;
+			sqe->poll32_events = POLLOUT;
+			sock->pollingWritable = true;
+			break;
+		case CB_URING_OP_WAKE:
+			sqe->opcode = IORING_OP_READ;
+			sqe->fd = loop->wake;
+			sqe->addr = (uint64_t)(uintptr_t)&loop->wakeValue;
+			sqe->len = sizeof(loop->wakeValue);
+			loop->wakeArmed = true;
+			break;
+		case CB_URING_OP_CANCEL:
+			break;
+	}
+	loop->pending++;
+	return true;
+}
+void CBUringSubmitChanges(CBEventLoop * loop){
+	// The loop mutex is locked. Sockets which could not be submitted for stay in the list.
+	uint32_t kept = 0;
+	for (uint32_t x = 0; x < loop->changed.num; x++) {
+		CBUringSocket * sock = loop->changed.sockets[x];
+		bool done = true;
+		if (sock->fd == -1) {
+			// The socket was detached, so cancel the requests. The kernel holds the socket open until they complete.
+			if (! sock->cancelled)
+				done = sock->cancelled = (! sock->receiving || CBUringCancel(loop, sock, CB_URING_OP_RECEIVE))
+					&& (! sock->sending || CBUringCancel(loop, sock, CB_URING_OP_SEND))
+					&& (! sock->accepting || CBUringCancel(loop, sock, CB_URING_OP_ACCEPT))
+					&& (! sock->polling || CBUringCancel(loop, sock, CB_URING_OP_CONNECT))
+					&& (! sock->pollingWritable || CBUringCancel(loop, sock, CB_URING_OP_WRITABLE));
+		}else{
+			CBEvent * read = sock->read, * write = sock->write;
+			if (read && read->type == CB_URING_EVENT_ACCEPT) {
+				// An accept fails until the socket is listening, and CBSocketListen changes the socket again.
+				if (! sock->accepting && CBUringIsListening(sock->fd))
+					done = CBUringSubmit(loop, sock, CB_URING_OP_ACCEPT);
+			}else if (sock->receivedNum >= CB_URING_SOCKET_BUFFERS) {
+				// Stop receiving until the data has been read.
+				if (sock->receiving && ! sock->throttled)
+					done = sock->throttled = CBUringCancel(loop, sock, CB_URING_OP_RECEIVE);
+			}else if (read && ! sock->receiving && ! sock->closed && ! sock->error)
+				done = CBUringSubmit(loop, sock, CB_URING_OP_RECEIVE);
+			if (write && write->type == CB_URING_EVENT_CONNECT && ! sock->polling && ! sock->connected)
+				done = CBUringSubmit(loop, sock, CB_URING_OP_CONNECT) && done;
+			if (sock->sendLength && ! sock->sending && ! sock->error)
+				// All the data for the socket is sent with one submission.
+				done = CBUringSubmit(loop, sock, CB_URING_OP_SEND) && done;
+			else if (sock->fileBlocked && ! sock->sendLength && ! sock->sending && ! sock->pollingWritable && ! sock->error)
+				// Wait for space to send the file.
+				done = CBUringSubmit(loop, sock, CB_URING_OP_WRITABLE) && done;
+		}
+		if (done)
+			sock->changed = false;
+		else
+			loop->changed.sockets[kept++] = sock;
+	}
+	loop->changed.num = kept;
+}
+void CBUringWake(CBEventLoop * loop){
+	uint64_t one = 1;
+	if (write(loop->wake, &one, sizeof(one))) {}
+}
+bool CBSocketCanAcceptEvent(CBDepObject * eventID, CBDepObject loopID, CBDepObject socketID, void (*onCanAccept)(void *, CBDepObject)){
+	if (! CBUringIsSupported())
+		return CBEpollSocketCanAcceptEvent(eventID, loopID, socketID, onCanAccept);
+	CBEvent * event = CBUringNewEvent(loopID, socketID, CB_URING_EVENT_ACCEPT, NULL);
+	if (! event)
+		return false;
+	event->onEvent.i = onCanAccept;
+	eventID->ptr = event;
+	return true;
+}
+bool CBSocketDidConnectEvent(CBDepObject * eventID, CBDepObject loopID, CBDepObject socketID, void (*onDidConnect)(void *, void *), void * peer){
+	if (! CBUringIsSupported())
+		return CBEpollSocketDidConnectEvent(eventID, loopID, socketID, onDidConnect, peer);
+	CBEvent * event = CBUringNewEvent(loopID, socketID, CB_URING_EVENT_CONNECT, peer);
+	if (! event)
+		return false;
+	event->onEvent.ptr = onDidConnect;
+	eventID->ptr = event;
+	return true;
+}
+bool CBSocketCanSendEvent(CBDepObject * eventID, CBDepObject loopID, CBDepObject socketID, void (*onCanSend)(void *, void *), void * peer){
+	if (! CBUringIsSupported())
+		return CBEpollSocketCanSendEvent(eventID, loopID, socketID, onCanSend, peer);
+	CBEvent * event = CBUringNewEvent(loopID, socketID, CB_URING_EVENT_SEND, peer);
+	if (! event)
+		return false;
+	event->onEvent.ptr = onCanSend;
+	eventID->ptr = event;
+	return true;
+}
+bool CBSocketCanReceiveEvent(CBDepObject * eventID, CBDepObject loopID, CBDepObject socketID, void (*onCanReceive)(void *, void *), void * peer){
+	if (! CBUringIsSupported())
+		return CBEpollSocketCanReceiveEvent(eventID, loopID, socketID, onCanReceive, peer);
+	CBEvent * event = CBUringNewEvent(loopID, socketID, CB_URING_EVENT_RECEIVE, peer);
+	if (! event)
+		return false;
+	event->onEvent.ptr = onCanReceive;
+	eventID->ptr = event;
+	return true;
+}
+bool CBSocketAddEvent(CBDepObject eventID, int timeout){
+	if (! CBUringIsSupported())
+		return CBEpollSocketAddEvent(eventID, timeout);
+	CBEvent * event = eventID.ptr;
+	CBEventLoop * loop = event->loop;
+	CBUringSocket * sock = event->socket;
+	bool reading = event->type == CB_URING_EVENT_ACCEPT || event->type == CB_URING_EVENT_RECEIVE;
+	CBMutexLock(loop->mutex);
+	event->timeout = timeout;
+	if (timeout)
+		CBUringSetDeadline(loop, &event->deadline, CBUringGetMilliseconds() + timeout);
+	else
+		CBUringRemoveDeadline(loop, &event->deadline);
+	CBEvent ** pending = reading ? &sock->read : &sock->write;
+	if (*pending != event) {
+		if (*pending)
+			// Replace the other event for this direction.
+			CBUringRemoveDeadline(loop, &(*pending)->deadline);
+		*pending = event;
+		// Submit what the event needs.
+		CBUringChangeSocket(loop, sock);
+	}
+	// Dispatch what the socket already has.
+	CBUringQueueSocket(loop, sock);
+	CBMutexUnlock(loop->mutex);
+	if (CBUringCurrentLoop != loop)
+		// Wake the loop for the new timeout or submission.
+		CBUringWake(loop);
+	return true;
+}
+bool CBSocketRemoveEvent(CBDepObject eventID){
+	if (! CBUringIsSupported())
+		return CBEpollSocketRemoveEvent(eventID);
+	CBEvent * event = eventID.ptr;
+	CBEventLoop * loop = event->loop;
+	CBUringSocket * sock = event->socket;
+	CBMutexLock(loop->mutex);
+	CBUringRemoveDeadline(loop, &event->deadline);
+	// Requests continue, so that data is received and accepted without the event, up to the limit on buffers.
+	if (sock->read == event)
+		sock->read = NULL;
+	else if (sock->write == event)
+		sock->write = NULL;
+	CBMutexUnlock(loop->mutex);
+	return true;
+}
+void CBSocketFreeEvent(CBDepObject eventID){
+	if (! CBUringIsSupported()) {
+		CBEpollSocketFreeEvent(eventID);
+		return;
+	}
+	CBEvent * event = eventID.ptr;
+	CBEventLoop * loop = event->loop;
+	CBUringSocket * sock = event->socket;
+	CBSocketRemoveEvent(eventID);
+	free(event);
+	bool detached = false, busy = false;
+	int fd = sock->fd;
+	pthread_mutex_lock(&CBUringSocketsMutex);
+	if (--sock->eventNum == 0) {
+		// No more events so detach the socket and free it once the kernel is done with it.
+		CBMutexLock(loop->mutex);
+		if (sock->fd != -1) {
+			CBUringSockets[sock->fd] = NULL;
+			busy = CBUringIsBusy(sock);
+			sock->fd = -1;
+			CBUringChangeSocket(loop, sock);
+			detached = true;
+		}
+		sock->nextFreed = loop->freedSockets;
+		loop->freedSockets = sock;
+		CBMutexUnlock(loop->mutex);
+	}
+	pthread_mutex_unlock(&CBUringSocketsMutex);
+	if (busy)
+		CBUringCancelSocket(loop, fd);
+	if (detached && CBUringCurrentLoop != loop)
+		CBUringWake(loop);
+}
+int32_t CBSocketSend(CBDepObject socketID, unsigned char * data, int len){
+	if (! CBUringIsSupported())
+		return CBEpollSocketSend(socketID, data, len);
+	CBUringSocket * sock = CBUringFindSocket(socketID.i);
+	if (! sock)
+		// Without events the socket is not used with io_uring.
+		return CBEpollSocketSend(socketID, data, len);
+	CBEventLoop * loop = sock->loop;
+	int32_t res;
+	CBMutexLock(loop->mutex);
+	if (sock->error)
+		res = CB_SOCKET_FAILURE;
+	else{
+		// Copy the data to be sent with the next submission.
+		res = (int32_t)CBUringSendSpace(sock, len);
+		if (res) {
+			memcpy(sock->sendBuffer + sock->sendLength, data, res);
+			sock->sendLength += (uint32_t)res;
+			if (! sock->sending)
+				CBUringChangeSocket(loop, sock);
+		}
+	}
+	CBMutexUnlock(loop->mutex);
+	if (res > 0 && CBUringCurrentLoop != loop)
+		CBUringWake(loop);
+	return res;
+}
+int32_t CBSocketSendFile(CBDepObject socketID, CBDepObject file, uint64_t offset, int len){
+	if (! CBUringIsSupported())
+		return CBEpollSocketSendFile(socketID, file, offset, len);
+	CBUringSocket * sock = CBUringFindSocket(socketID.i);
+	if (! sock)
+		return CBEpollSocketSendFile(socketID, file, offset, len);
+	CBEventLoop * loop = sock->loop;
+	CBMutexLock(loop->mutex);
+	if (sock->error) {
+		CBMutexUnlock(loop->mutex);
+		return CB_SOCKET_FAILURE;
+	}
+	if (sock->sendLength || sock->sending) {
+		// The buffered data goes first, so wait for it to be sent rather than copying the file into the buffer.
+		sock->fileBlocked = true;
+		CBMutexUnlock(loop->mutex);
+		return 0;
+	}
+	CBMutexUnlock(loop->mutex);
+	// Nothing is queued, so the kernel sends from the file. Sends for a socket are only made by its send event, so nothing is added to the buffer meanwhile.
+	int32_t res = CBEpollSocketSendFile(socketID, file, offset, len);
+	if (res != CB_SOCKET_FAILURE && res < len) {
+		// The socket is full, so wait until it is writable.
+		CBMutexLock(loop->mutex);
+		sock->fileBlocked = true;
+		CBUringChangeSocket(loop, sock);
+		CBMutexUnlock(loop->mutex);
+		if (CBUringCurrentLoop != loop)
+			CBUringWake(loop);
+	}
+	return res;
+}
+int32_t CBSocketReceive(CBDepObject socketID, unsigned char * data, int len){
+	if (! CBUringIsSupported())
+		return CBEpollSocketReceive(socketID, data, len);
+	CBUringSocket * sock = CBUringFindSocket(socketID.i);
+	if (! sock)
+		return CBEpollSocketReceive(socketID, data, len);
+	CBEventLoop * loop = sock->loop;
+	int32_t res = 0;
+	CBMutexLock(loop->mutex);
+	// Copy out of the received buffers, giving the buffers back to the kernel when they are empty.
+	while (res < len && sock->receivedNum) {
+		CBUringBuffer * buf = &sock->received[sock->receivedStart];
+		uint32_t num = buf->end - buf->start;
+		if ((uint32_t)(len - res) < num)
+			num = (uint32_t)(len - res);
+		memcpy(data + res, loop->buffers + (size_t)buf->id * CB_URING_BUFFER_SIZE + buf->start, num);
+		res += (int32_t)num;
+		buf->start += num;
+		if (buf->start == buf->end) {
+			CBUringReturnBuffer(loop, buf->id);
+			sock->receivedStart = (sock->receivedStart + 1) & (sock->receivedCap - 1);
+			sock->receivedNum--;
+			if (! sock->receiving)
+				// Receive again if receiving was stopped.
+				CBUringChangeSocket(loop, sock);
+		}
+	}
+	if (! res) {
+		if (sock->error)
+			res = CB_SOCKET_FAILURE;
+		else if (sock->closed)
+			res = CB_SOCKET_CONNECTION_CLOSE;
+	}
+	CBMutexUnlock(loop->mutex);
+	return res;
+}
+bool CBStartTimer(CBDepObject loopID, CBDepObject * timer, int time, void (*callback)(void *), void * arg){
+	if (! CBUringIsSupported())
+		return CBEpollStartTimer(loopID, timer, time, callback, arg);
+	CBEventLoop * loop = loopID.ptr;
+	CBTimer * theTimer = malloc(sizeof(*theTimer));
+	theTimer->loop = loop;
+	theTimer->time = time;
+	theTimer->callback = callback;
+	theTimer->arg = arg;
+	theTimer->deadline.heapIndex = CB_URING_NO_DEADLINE;
+	theTimer->deadline.timer = true;
+	timer->ptr = theTimer;
+	if (time) {
+		// A time of zero leaves the timer disarmed.
+		CBMutexLock(loop->mutex);
+		CBUringSetDeadline(loop, &theTimer->deadline, CBUringGetMilliseconds() + time);
+		CBMutexUnlock(loop->mutex);
+		if (CBUringCurrentLoop != loop)
+			CBUringWake(loop);
+	}
+	return true;
+}
+void CBEndTimer(CBDepObject timer){
+	if (! CBUringIsSupported()) {
+		CBEpollEndTimer(timer);
+		return;
+	}
+	CBTimer * theTimer = timer.ptr;
+	CBEventLoop * loop = theTimer->loop;
+	// The timer may be running its callback, so it is freed by the loop.
+	CBMutexLock(loop->mutex);
+	CBUringRemoveDeadline(loop, &theTimer->deadline);
+	theTimer->callback = NULL;
+	theTimer->nextFreed = loop->freedTimers;
+	loop->freedTimers = theTimer;
+	CBMutexUnlock(loop->mutex);
+}
+bool CBRunOnEventLoop(CBDepObject loopID, void (*callback)(void *), void * arg, bool block){
+	if (! CBUringIsSupported())
+		return CBEpollRunOnEventLoop(loopID, callback, arg, block);
+	CBEventLoop * loop = loopID.ptr;
+	if (block) {
+		if (CBUringCurrentLoop == loop){
+			// We are in the event loop already and we are supposed to block.
+			callback(arg);
+			return true;
+		}
+		// The item stays on the stack until the callback has run.
+		CBCallbackQueueItem item;
+		CBInitCallbackQueueItem(&item, callback, arg, true);
+		if (CBCallbackQueuePush(&loop->queue, &item))
+			CBUringWake(loop);
+		CBCallbackQueueWait(&item);
+		return true;
+	}
+	CBCallbackQueueItem * item = CBCallbackQueueNewItem(&loop->queue, callback, arg);
+	if (! item)
+		return false;
+	if (CBCallbackQueuePush(&loop->queue, item))
+		CBUringWake(loop);
+	return true;
+}
+void CBCloseSocket(CBDepObject socketID){
+	if (! CBUringIsSupported()) {
+		CBEpollCloseSocket(socketID);
+		return;
+	}
+	// Detach the socket so that a new socket with the same descriptor gets its own state, and cancel its requests.
+	CBEventLoop * loop = NULL;
+	bool busy = false;
+	pthread_mutex_lock(&CBUringSocketsMutex);
+	if (socketID.i < CBUringSocketsLength && CBUringSockets[socketID.i]) {
+		CBUringSocket * sock = CBUringSockets[socketID.i];
+		CBUringSockets[socketID.i] = NULL;
+		loop = sock->loop;
+		CBMutexLock(loop->mutex);
+		busy = CBUringIsBusy(sock);
+		sock->fd = -1;
+		CBUringChangeSocket(loop, sock);
+		CBMutexUnlock(loop->mutex);
+	}
+	pthread_mutex_unlock(&CBUringSocketsMutex);
+	if (loop && busy)
+		CBUringCancelSocket(loop, socketID.i);
+	close(socketID.i);
+	if (loop && CBUringCurrentLoop != loop)
+		CBUringWake(loop);
+}
+void CBExitEventLoop(CBDepObject loopID){
+	if (! CBUringIsSupported()) {
+		CBEpollExitEventLoop(loopID);
+		return;
+	}
+	CBEventLoop * loop = loopID.ptr;
+	CBMutexLock(loop->mutex);
+	loop->exit = true;
+	CBMutexUnlock(loop->mutex);
+	CBUringWake(loop);
+}
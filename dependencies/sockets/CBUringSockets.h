@@ -0,0 +1,271 @@
+//
+//  CBUringSockets.h
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+/**
+ @file
+ @brief This is a Linux implementation of the networking dependencies for cbitcoin which uses io_uring, so that the loop makes one system call for each iteration instead of one for each read and write. Listening sockets use a multishot accept and the accepted sockets are queued for CBSocketAccept. Sockets with receive events use a multishot receive into buffers provided to the kernel by the loop, and CBSocketReceive copies out of the buffers without a system call. CBSocketSend copies into a buffer for the socket, which is sent with one submission for each loop iteration while no send is in progress. The callbacks are called in the same way as the other implementations, so a can send event is called while the send buffer has room and a can receive event is called while there is received data. Timeouts and timers are kept in a binary heap which gives the time to wait for completions. liburing is not needed as the rings are mapped directly. When the kernel does not provide the io_uring features which are needed, or CB_NO_IO_URING is set in the environment, every function uses the epoll implementation instead.
+ */
+
+#ifndef __linux__
+#error "CBUringSockets requires Linux. Use CBLibEventSockets on other systems."
+#endif
+
+#include "CBCallbackQueue.h"
+#include "CBNetworkCommunicator.h"
+#include "CBThreads.h"
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <signal.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <stdlib.h>
+
+#ifndef CBURINGSOCKETSH
+#define CBURINGSOCKETSH
+
+#define CB_URING_ENTRIES 256 // The size of the submission queue. The queue is submitted early if it becomes full.
+#define CB_URING_COMPLETION_ENTRIES 4096 // The size of the completion queue, which is large as multishot requests give many completions.
+#define CB_URING_BUFFER_NUM 1024 // The number of receive buffers provided to the kernel, which must be a power of two.
+#define CB_URING_BUFFER_SIZE 4096
+#define CB_URING_BUFFER_GROUP 0
+#define CB_URING_SOCKET_BUFFERS 64 // Receiving for a socket is stopped when it holds this many buffers, until the data is read.
+#define CB_URING_SEND_BUFFER_SIZE 65536 // The most data waiting to be sent for a socket.
+#define CB_URING_DISPATCH_MAX 16 // The number of times the callbacks of a socket are called in a row before other sockets get a turn.
+#define CB_URING_NO_DEADLINE UINT32_MAX // The heap index of an event or timer without a deadline.
+#define CB_URING_OP_MASK 7 // The bits of the user data of a submission which give the operation. The rest is the socket.
+
+typedef enum{
+	CB_URING_EVENT_ACCEPT,
+	CB_URING_EVENT_CONNECT,
+	CB_URING_EVENT_SEND,
+	CB_URING_EVENT_RECEIVE
+} CBUringEventType;
+
+/**
+ @brief The operation of a submission. The wake read and cancellations are given with a NULL socket.
+ */
+typedef enum{
+	CB_URING_OP_RECEIVE,
+	CB_URING_OP_SEND,
+	CB_URING_OP_ACCEPT,
+	CB_URING_OP_CONNECT,
+	CB_URING_OP_WRITABLE,
+	CB_URING_OP_WAKE,
+	CB_URING_OP_CANCEL
+} CBUringOp;
+
+typedef struct CBEvent CBEvent;
+typedef struct CBUringSocket CBUringSocket;
+typedef struct CBTimer CBTimer;
+
+/**
+ @brief The position of an event or timer in the deadline heap.
+ */
+typedef struct{
+	uint64_t time; /**< The deadline in milliseconds of the monotonic clock. */
+	uint32_t heapIndex; /**< The index in the heap or CB_URING_NO_DEADLINE. */
+	bool timer; /**< True for timers and false for events. */
+} CBUringDeadline;
+
+typedef struct{
+	CBUringSocket ** sockets;
+	uint32_t num;
+	uint32_t cap;
+} CBUringSocketList;
+
+/**
+ @brief Data received into a provided buffer which has not been read yet.
+ */
+typedef struct{
+	uint16_t id;
+	uint32_t start;
+	uint32_t end;
+} CBUringBuffer;
+
+typedef struct{
+	int ring; /**< The io_uring file descriptor. */
+	unsigned * sqHead;
+	unsigned * sqTail;
+	unsigned sqMask;
+	unsigned sqEntries;
+	unsigned sqLocalTail; /**< The tail including submissions which have not been given to the kernel. */
+	struct io_uring_sqe * sqes;
+	unsigned * cqHead;
+	unsigned * cqTail;
+	unsigned cqMask;
+	struct io_uring_cqe * cqes;
+	void * sqMap;
+	size_t sqMapSize;
+	void * cqMap; /**< The same as sqMap when the kernel maps both rings together. */
+	size_t cqMapSize;
+	size_t sqesSize;
+	struct io_uring_buf_ring * bufferRing;
+	unsigned char * buffers;
+	uint16_t bufferTail;
+	uint32_t pending; /**< The number of submitted requests which have not completed, not counting cancellations. */
+	bool multishotReceive; /**< False when the kernel does not support multishot receives, so that each receive is submitted again. */
+	int wake; /**< eventfd used to wake the loop from other threads. */
+	uint64_t wakeValue;
+	bool wakeArmed;
+	bool exit; /**< Set to stop the loop. */
+	void (*onError)(void *);
+	void (*onTimeOut)(void *, void *, CBTimeOutType); /**< Callback for timeouts */
+	void * communicator;
+	CBDepObject loopThread; /**< The thread for the event loop. */
+	CBCallbackQueue queue;
+	CBDepObject mutex; /**< Protects the sockets, the deadline heap, the socket lists and the freed objects. */
+	CBUringDeadline ** deadlines; /**< Binary heap of the event timeouts and timers, with the earliest deadline first. */
+	uint32_t deadlineNum;
+	uint32_t deadlineCap;
+	CBUringSocketList ready; /**< Sockets which are ready for a pending event. */
+	CBUringSocketList dispatching; /**< The ready sockets being dispatched in the current iteration. */
+	CBUringSocketList changed; /**< Sockets which need submissions or cancellations. */
+	CBUringSocketList starved; /**< Sockets which stopped receiving as there were no free buffers. */
+	CBUringSocket * freedSockets; /**< Sockets which are freed once the kernel has completed all requests for them. */
+	CBTimer * freedTimers; /**< Timers which are freed at the end of the loop iteration. */
+}CBEventLoop;
+
+union CBOnEvent{
+	void (*i)(void *, CBDepObject);
+	void (*ptr)(void *, void *);
+};
+
+/**
+ @brief The state of a socket which is shared by the events of the socket. The address is the user data of the submissions for the socket, so it is kept until the kernel has completed them.
+ */
+struct CBUringSocket{
+	CBEventLoop * loop;
+	int fd; /**< The socket or -1 when the socket was closed or all the events were freed. */
+	int eventNum; /**< The number of events using this socket. Protected by CBUringSocketsMutex. */
+	CBEvent * read; /**< The pending accept or receive event. */
+	CBEvent * write; /**< The pending connect or send event. */
+	bool queued; /**< True when in the ready list of the loop. */
+	bool changed; /**< True when in the changed list of the loop. */
+	bool starved; /**< True when in the starved list of the loop. */
+	bool receiving; /**< True while a receive has been submitted. */
+	bool throttled; /**< True when the receive was cancelled as the socket holds too many buffers. */
+	bool sending;
+	bool accepting;
+	bool polling; /**< True while waiting for a connection to complete. */
+	bool pollingWritable; /**< True while waiting for the socket to become writable for CBSocketSendFile. */
+	bool fileBlocked; /**< True when CBSocketSendFile could not send, until the buffered data has been sent or the socket is writable. */
+	bool cancelled; /**< True when the requests were cancelled after the socket was detached. */
+	bool connected; /**< True when the connection completed, with or without an error. */
+	bool closed; /**< True when the end of the stream was received. */
+	int error; /**< The error of a receive or send, or zero. */
+	CBUringBuffer * received; /**< Ring of received data in the order it was received. */
+	uint32_t receivedStart;
+	uint32_t receivedNum;
+	uint32_t receivedCap;
+	unsigned char * sendBuffer; /**< The data waiting to be sent, which grows up to CB_URING_SEND_BUFFER_SIZE. */
+	uint32_t sendLength;
+	uint32_t sendCap;
+	int * accepted; /**< Accepted sockets for CBSocketAccept. */
+	uint32_t acceptedNum;
+	uint32_t acceptedCap;
+	CBUringSocket * nextFreed;
+};
+
+struct CBEvent{
+	CBUringDeadline deadline; /**< First, so that the heap can give the event. */
+	CBEventLoop * loop;
+	CBUringSocket * socket;
+	CBUringEventType type;
+	union CBOnEvent onEvent;
+	void * peer;
+	int timeout; /**< The timeout in milliseconds or 0 for none. */
+};
+
+struct CBTimer{
+	CBUringDeadline deadline; /**< First, so that the heap can give the timer. */
+	CBEventLoop * loop;
+	int time; /**< The period in milliseconds. */
+	void (*callback)(void *); /**< NULL when the timer has ended. */
+	void * arg;
+	CBTimer * nextFreed;
+};
+
+void CBStartEventLoop(void *);
+void CBUringAddAccepted(CBUringSocket * sock, int fd);
+void CBUringAddReceived(CBUringSocket * sock, uint16_t id, uint32_t length);
+bool CBUringCancel(CBEventLoop * loop, CBUringSocket * sock, CBUringOp op);
+void CBUringCancelAll(CBEventLoop * loop);
+void CBUringCancelSocket(CBEventLoop * loop, int fd);
+void CBUringChangeSocket(CBEventLoop * loop, CBUringSocket * sock);
+void CBUringComplete(CBEventLoop * loop, struct io_uring_cqe * cqe, bool * runQueue);
+void CBUringDispatch(CBEventLoop * loop, CBUringSocket * sock);
+void CBUringDispatchDeadlines(CBEventLoop * loop);
+int CBUringEnter(CBEventLoop * loop, unsigned minComplete, int64_t wait);
+CBUringSocket * CBUringFindSocket(int fd);
+void CBUringFreeObjects(CBEventLoop * loop, bool all);
+void CBUringFreeRing(CBEventLoop * loop);
+uint64_t CBUringGetMilliseconds(void);
+struct io_uring_sqe * CBUringGetSubmission(CBEventLoop * loop);
+CBUringSocket * CBUringGetSocket(CBEventLoop * loop, int fd);
+int64_t CBUringGetWaitTime(CBEventLoop * loop);
+void CBUringHeapDown(CBEventLoop * loop, uint32_t x);
+void CBUringHeapSet(CBEventLoop * loop, uint32_t x, CBUringDeadline * deadline);
+void CBUringHeapUp(CBEventLoop * loop, uint32_t x);
+bool CBUringIsBusy(CBUringSocket * sock);
+bool CBUringIsListening(int fd);
+bool CBUringIsReady(CBUringSocket * sock, bool write);
+bool CBUringIsSupported(void);
+CBEvent * CBUringNewEvent(CBDepObject loopID, CBDepObject socketID, CBUringEventType type, void * peer);
+void CBUringProbe(void);
+void CBUringQueueSocket(CBEventLoop * loop, CBUringSocket * sock);
+void CBUringReap(CBEventLoop * loop, bool * runQueue);
+void CBUringRemoveDeadline(CBEventLoop * loop, CBUringDeadline * deadline);
+void CBUringReturnBuffer(CBEventLoop * loop, uint16_t id);
+void CBUringRunEvent(CBEvent * event);
+uint32_t CBUringSendSpace(CBUringSocket * sock, int len);
+void CBUringSetDeadline(CBEventLoop * loop, CBUringDeadline * deadline, uint64_t time);
+bool CBUringSetUp(CBEventLoop * loop, unsigned entries, unsigned completionEntries);
+void CBUringSocketListAdd(CBUringSocketList * list, CBUringSocket * sock);
+bool CBUringSubmit(CBEventLoop * loop, CBUringSocket * sock, CBUringOp op);
+void CBUringSubmitChanges(CBEventLoop * loop);
+void CBUringWake(CBEventLoop * loop);
+
+// The epoll implementation, compiled with CB_EPOLL_FALLBACK.
+
+CBSocketReturn CBEpollNewSocket(CBDepObject * socketID, bool IPv6);
+bool CBEpollSocketBind(CBDepObject * socketID, bool IPv6, int port);
+bool CBEpollSocketConnect(CBDepObject socketID, unsigned char * IP, bool IPv6, int port);
+bool CBEpollSocketListen(CBDepObject socketID, int maxConnections);
+bool CBEpollSocketAccept(CBDepObject socketID, CBDepObject * connectionSocketID, void * sockAddr);
+bool CBEpollNewEventLoop(CBDepObject * loopID, void (*onError)(void *), void (*onDidTimeout)(void *, void *, CBTimeOutType), void * communicator);
+bool CBEpollSocketCanAcceptEvent(CBDepObject * eventID, CBDepObject loopID, CBDepObject socketID, void (*onCanAccept)(void *, CBDepObject));
+bool CBEpollSocketDidConnectEvent(CBDepObject * eventID, CBDepObject loopID, CBDepObject socketID, void (*onDidConnect)(void *, void *), void * peer);
+bool CBEpollSocketCanSendEvent(CBDepObject * eventID, CBDepObject loopID, CBDepObject socketID, void (*onCanSend)(void *, void *), void * peer);
+bool CBEpollSocketCanReceiveEvent(CBDepObject * eventID, CBDepObject loopID, CBDepObject socketID, void (*onCanReceive)(void *, void *), void * peer);
+bool CBEpollSocketAddEvent(CBDepObject eventID, int timeout);
+bool CBEpollSocketRemoveEvent(CBDepObject eventID);
+void CBEpollSocketFreeEvent(CBDepObject eventID);
+int32_t CBEpollSocketSend(CBDepObject socketID, unsigned char * data, int len);
+int32_t CBEpollSocketSendFile(CBDepObject socketID, CBDepObject file, uint64_t offset, int len);
+int32_t CBEpollSocketReceive(CBDepObject socketID, unsigned char * data, int len);
+bool CBEpollStartTimer(CBDepObject loopID, CBDepObject * timer, int time, void (*callback)(void *), void * arg);
+void CBEpollEndTimer(CBDepObject timer);
+bool CBEpollRunOnEventLoop(CBDepObject loopID, void (*callback)(void *), void * arg, bool block);
+void CBEpollCloseSocket(CBDepObject socketID);
+void CBEpollExitEventLoop(CBDepObject loopID);
+
+#endif
@@ -0,0 +1,118 @@
+//
+//  CBFile.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//  
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+// Includes
+
+#include "CBFile.h"
+
+// Implementation
+
+bool CBFileOpen(CBDepObject * file, char * filename, bool create) {
+
+	file->i = open(filename, O_RDWR | (create ? O_CREAT : 0), S_IRUSR | S_IWUSR);
+	return file->i != -1;
+
+}
+
+bool CBFileOpenReadOnly(CBDepObject * file, char * filename) {
+
+	file->i = open(filename, O_RDONLY);
+	return file->i != -1;
+
+}
+
+void CBFileClose(CBDepObject file) {
+
+	close(file.i);
+
+}
+
+bool CBFileGetLength(CBDepObject file, uint64_t * length) {
+
+	struct stat info;
+	if (fstat(file.i, &info))
+		return false;
+	*length = info.st_size;
+	return true;
+
+}
+
+bool CBFileMap(CBDepObject file, uint64_t offset, uint64_t length, void ** map) {
+
+	*map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, file.i, offset);
+	return *map != MAP_FAILED;
+
+}
+
+bool CBFileMapReadOnly(CBDepObject file, uint64_t offset, uint64_t length, void ** map) {
+
+	*map = mmap(NULL, length, PROT_READ, MAP_SHARED, file.i, offset);
+	return *map != MAP_FAILED;
+
+}
+
+bool CBFileRead(CBDepObject file, unsigned char * data, uint32_t length, uint64_t offset) {
+
+	while (length) {
+		ssize_t res = pread(file.i, data, length, offset);
+		if (res <= 0)
+			return false;
+		data += res;
+		length -= res;
+		offset += res;
+	}
+	return true;
+
+}
+
+bool CBFileSetLength(CBDepObject file, uint64_t length) {
+
+	return ! ftruncate(file.i, length);
+
+}
+
+bool CBFileSync(CBDepObject file) {
+
+	return ! fsync(file.i);
+
+}
+
+bool CBFileSyncMap(void * map, uint64_t offset, uint64_t length) {
+
+	// msync needs the start to be page aligned.
+	uint64_t pageSize = sysconf(_SC_PAGESIZE);
+	uint64_t aligned = offset - offset % pageSize;
+	return ! msync((unsigned char *)map + aligned, length + offset - aligned, MS_SYNC);
+
+}
+
+void CBFileUnmap(void * map, uint64_t length) {
+
+	munmap(map, length);
+
+}
+
+bool CBFileWrite(CBDepObject file, unsigned char * data, uint32_t length, uint64_t offset) {
+
+	while (length) {
+		ssize_t res = pwrite(file.i, data, length, offset);
+		if (res <= 0)
+			return false;
+		data += res;
+		length -= res;
+		offset += res;
+	}
+	return true;
+
+}
@@ -157,6 +157,12 @@ void CBConditionSignal(CBDepObject cond) {
 
 }
 
+void CBConditionBroadcast(CBDepObject cond) {
+
+	CBAssertExpression(pthread_cond_broadcast(cond.ptr), == 0);
+
+}
+
 int CBGetNumberOfCores(void) {
 
 	return sysconf(_SC_NPROCESSORS_ONLN);
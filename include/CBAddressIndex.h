@@ -0,0 +1,88 @@
+//
+//  CBAddressIndex.h
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+/**
+ @file
+ @brief A sorted index of the RIPEMD-160 hashes of addresses for matching outputs against a large watch list. The index is built from newline separated base 58 addresses, which are decoded in parallel without creating CBAddress objects.
+ */
+
+#ifndef CBADDRESSINDEXH
+#define CBADDRESSINDEXH
+
+//  Includes
+
+#include "CBBase58.h"
+#include "CBThreadPoolQueue.h"
+
+/**
+ @brief Structure for CBAddressIndex objects. @see CBAddressIndex.h
+ */
+typedef struct{
+	unsigned char (*hashes)[20]; /**< The sorted RIPEMD-160 hashes without duplicates. */
+	int hashNum; /**< The number of hashes. */
+	int * badLines; /**< The line numbers, starting at one, of lines which could not be decoded, in ascending order. */
+	int badLineNum; /**< The number of bad lines. */
+} CBAddressIndex;
+
+/**
+ @brief A section of the text decoded by one thread, which is internal to CBAddressIndex.c.
+ */
+typedef struct CBAddressIndexSection CBAddressIndexSection;
+
+/**
+ @brief Initialises a CBAddressIndex from newline separated base 58 addresses, such as a memory mapped file. Whitespace around addresses and empty lines are ignored. Lines which fail to decode, have a bad checksum or a different prefix are recorded in badLines.
+ @param self The CBAddressIndex to initialise.
+ @param text The text, which does not need to be terminated.
+ @param length The length of the text.
+ @param prefix The prefix of the addresses.
+ @param numThreads The number of threads of the shared thread pool to decode with. If less than one, the number of cores is used.
+ @returns true if every line was decoded, false if there are bad lines.
+ */
+bool CBInitAddressIndexFromText(CBAddressIndex * self, char * text, size_t length, CBBase58Prefix prefix, int numThreads);
+
+/**
+ @brief Frees the data of a CBAddressIndex.
+ @param self The CBAddressIndex to destroy.
+ */
+void CBDestroyAddressIndex(CBAddressIndex * self);
+
+//  Functions
+
+/**
+ @brief Determines if a RIPEMD-160 hash is in the index, using a binary search.
+ @param self The CBAddressIndex.
+ @param hash The 20 byte hash.
+ @returns true if the hash is in the index, false otherwise.
+ */
+bool CBAddressIndexContains(CBAddressIndex * self, unsigned char * hash);
+
+/**
+ @brief Compares two RIPEMD-160 hashes for qsort and bsearch.
+ */
+int CBAddressIndexCompare(const void * a, const void * b);
+
+/**
+ @brief Decodes one of the sections of the text on the shared thread pool.
+ @param sections The array of sections.
+ @param item The index of the section.
+ */
+void CBAddressIndexProcess(void * sections, int item);
+
+/**
+ @brief Decodes the addresses of a section and sorts the hashes.
+ @param section The section to decode.
+ */
+void CBAddressIndexSectionDecode(CBAddressIndexSection * section);
+
+#endif
@@ -41,6 +41,16 @@ void CBDecodeBase58(CBBigInt * bi, char * str);
  */
 bool CBDecodeBase58Checked(CBBigInt * bi, char * str);
 
+/**
+ @brief Decodes a base 58 string with a 4 byte checksum into a fixed number of bytes without any allocations. The bytes are in the usual big-endian order, unlike the CBBigInt functions.
+ @param bytes A pointer to hold the decoded data, including the checksum.
+ @param size The number of bytes the string must decode into.
+ @param str The base 58 string, which does not need to be terminated.
+ @param strLen The length of the string.
+ @returns true if the string decoded into exactly "size" bytes with a correct checksum, false otherwise.
+ */
+bool CBDecodeBase58CheckedFixed(unsigned char * bytes, int size, char * str, int strLen);
+
 /**
  @brief Encodes byte data into base 58.
  @param bytes Pointer to a normalised CBBigInt containing the byte data to encode. Will almost certainly be modified. Copy data beforehand if needed.
@@ -23,6 +23,7 @@
 //  Includes
 
 #include "CBTransaction.h"
+#include "CBCursor.h"
 #include "CBBigInt.h"
 #include "CBValidationFunctions.h"
 
@@ -48,8 +49,19 @@ typedef struct{
 	unsigned int nonce; /**< Nounce used in generating the block. */
 	int transactionNum; /**< Number of transactions in the block. */
 	CBTransaction ** transactions; /**< The transactions included in this block. NULL if only the header has been received. */
+	CBArena * arena; /**< If not NULL, the objects made when deserialising the block are allocated in this arena, which is released with the block. */
 } CBBlock;
 
+/**
+ @brief Holds the transactions of a block being deserialised on a thread pool.
+ */
+typedef struct{
+	CBBlock * block;
+	bool hash; /**< If true the transactions are hashed. */
+	bool failed;
+	int itemNum; /**< The number of ranges the transactions are split into. */
+} CBBlockDeserialiseJob;
+
 /**
  @brief Creates a new CBBlock object. Set the members after creating the block object.
  @returns A new CBBlock object.
@@ -63,6 +75,13 @@ CBBlock * CBNewBlock(void);
  */
 CBBlock * CBNewBlockFromData(CBByteArray * data);
 
+/**
+ @brief Creates a new CBBlock object which allocates the objects made when deserialising it in an arena. The memory of the arena is freed when the block and all of the objects deserialised with it are freed, rather than returning each object to a pool.
+ @param data Serialised block data.
+ @returns A new CBBlock object.
+ */
+CBBlock * CBNewBlockFromDataWithArena(CBByteArray * data);
+
 /**
  @brief Creates a new CBBlock object with the genesis information for the bitcoin block chain. This will have serialised data as well as object data.
  @returns A new CBBlock object.
@@ -150,6 +169,48 @@ unsigned char * CBBlockCalculateMerkleRoot(CBBlock * self);
  */
 int CBBlockDeserialise(CBBlock * self, bool transactions);
 
+/**
+ @brief Deserialises a CBBlock with the current arena of the thread set by CBBlockDeserialise.
+ @param self The CBBlock object
+ @param transactions If true deserialise transactions. If false there do not deserialise for transactions.
+ @returns The length read on success, 0 on failure.
+ */
+int CBBlockDeserialiseData(CBBlock * self, bool transactions);
+
+/**
+ @brief Deserialises the header of a CBBlock and the number of transactions.
+ @param self The CBBlock object
+ @param cursor A CBCursor to initialise for the block data, which is left after the number of transactions.
+ @param txNum The number of transactions to be set.
+ @returns true on success, false on failure.
+ */
+bool CBBlockDeserialiseHeader(CBBlock * self, CBCursor * cursor, CBVarInt * txNum);
+
+/**
+ @brief Deserialises a range of the transactions of a CBBlockDeserialiseJob on the shared thread pool.
+ @param job The CBBlockDeserialiseJob.
+ @param item The number of the range.
+ */
+void CBBlockDeserialiseProcess(void * job, int item);
+
+/**
+ @brief Deserialises a range of transactions of a block which have their data set.
+ @param job The CBBlockDeserialiseJob.
+ @param start The first transaction.
+ @param end The transaction after the last one.
+ @returns true on success, false if a transaction failed to deserialise.
+ */
+bool CBBlockDeserialiseTransactions(CBBlockDeserialiseJob * job, int start, int end);
+
+/**
+ @brief Deserialises a CBBlock with transactions across a number of threads. The transaction boundaries are found first by scanning the data without making any objects, which rejects bad lengths, and then the transactions are deserialised in parallel. The block arena is only used for the transaction objects themselves.
+ @param self The CBBlock object
+ @param hash If true, the transaction hashes are also calculated in parallel.
+ @param numThreads The number of threads of the shared thread pool to use. If less than 1 the number of cores is used.
+ @returns The length read on success, CB_DESERIALISE_ERROR on failure.
+ */
+int CBBlockDeserialiseWithThreads(CBBlock * self, bool hash, int numThreads);
+
 /**
  @brief Retrieves or calculates the hash for a block. Hashes taken from this fuction are cached.
  @param self The CBBlock object. This should be serialised.
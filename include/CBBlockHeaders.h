@@ -23,6 +23,7 @@
 //  Includes
 
 #include "CBBlock.h"
+#include "CBHeaderArray.h"
 
 // Cosntants
 
@@ -35,6 +36,7 @@ typedef struct{
 	CBMessage base; /**< CBMessage base structure */
 	int headerNum; /**< The number of headers. */
 	CBBlock * blockHeaders[2000]; /**< The block headers as CBBlock objects with no transactions. The number of transactions is given however. */
+	CBHeaderArray * headerArray; /**< If not NULL, the headers are in this CBHeaderArray instead of blockHeaders and headerNum is zero. @see CBBlockHeadersDeserialiseFlat */
 } CBBlockHeaders;
 
 /**
@@ -98,10 +100,17 @@ int CBBlockHeadersCalculateLength(CBBlockHeaders * self);
 */
 int CBBlockHeadersDeserialise(CBBlockHeaders * self);
 
+/**
+ @brief Deserialises a CBBlockHeaders into a CBHeaderArray, without a CBBlock object for each header.
+ @param self The CBBlockHeaders object
+ @returns The length read on success, CB_DESERIALISE_ERROR on failure.
+ */
+int CBBlockHeadersDeserialiseFlat(CBBlockHeaders * self);
+
 void CBBlockHeadersPrepareBytes(CBBlockHeaders * self);
 
 /**
- @brief Serialises a CBBlockHeaders to the byte data.
+ @brief Serialises a CBBlockHeaders to the byte data. If there is a headerArray, the headers are serialised from it.
  @param self The CBBlockHeaders object
  @param force Serialises everything, replacing any previous serialisation of children objects.
  @returns The length written on success, 0 on failure.
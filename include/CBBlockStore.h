@@ -0,0 +1,205 @@
+//
+//  CBBlockStore.h
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+/**
+ @file
+ @brief An append-only store of serialised blocks in flat files, with an index of where each block is, found by the block hash. The block files are memory mapped read-only for reading, up to their length, and only the most recently used files are kept open, and blocks can be given as CBMessage objects with a file-backed payload, so a CBNetworkCommunicator sends them to peers straight from the page cache with CBSocketSendFile rather than from a serialised CBBlock. The index records are memory mapped and hold the message checksum of each block so it is not calculated for each send. The number of records is synced to disk after the block data and the records, and records after it are only accepted on opening when their block data is complete, so a partly written block is dropped after a crash. The records are in the byte order of the machine.
+ */
+
+#ifndef CBBLOCKSTOREH
+#define CBBLOCKSTOREH
+
+//  Includes
+
+#include "CBBlock.h"
+
+// Constants and Macros
+
+#define CB_BLOCK_STORE_MAGIC 0x53424243 // "CBBS" in little-endian
+#define CB_BLOCK_STORE_FILE_SIZE 0x8000000 // The default maximum size of a block file, 128MB.
+#define CB_BLOCK_STORE_GROW 4096 // The number of records to extend the index file by.
+#define CB_BLOCK_STORE_MIN_TABLE 4096 // The minimum number of hash table slots.
+#define CB_BLOCK_STORE_MAX_OPEN_FILES 16 // The default number of block files kept open and mapped at once.
+#define CBBlockStoreGetRecord(self, x) ((self)->records + (x))
+
+/**
+ @brief A record of where a block is in a CBBlockStore. The first record in the index file holds a CBBlockStoreIndexHeader instead.
+ */
+typedef struct{
+	unsigned char hash[32];
+	uint32_t fileID; /**< The number of the block file. */
+	uint32_t offset; /**< The position of the block in the file. */
+	uint32_t length; /**< The length of the serialised block. */
+	unsigned char checksum[4]; /**< The message checksum of the serialised block. */
+} CBBlockStoreRecord;
+
+/**
+ @brief The start of the index file.
+ */
+typedef struct{
+	uint32_t magic;
+	uint32_t recordSize;
+	uint32_t fileSize; /**< The maximum size of a block file. */
+	uint32_t syncedNum; /**< The number of records which were written to disk, with their blocks, before this was. */
+} CBBlockStoreIndexHeader;
+
+/**
+ @brief A block file of a CBBlockStore.
+ */
+typedef struct{
+	CBDepObject file;
+	bool open; /**< True if the file is open. */
+	bool writable; /**< True if the file was opened for adding blocks, rather than for reading only. */
+	unsigned char * map; /**< The file mapped read-only from the start, or NULL if it has not been mapped since it was opened. */
+	uint64_t mapLength; /**< The length of the mapping, which was the length of the file when it was mapped. */
+	uint32_t lastUse; /**< The useCount of the store when the file was last used. */
+} CBBlockStoreFile;
+
+/**
+ @brief Structure for CBBlockStore objects. @see CBBlockStore.h
+ */
+typedef struct{
+	char * dataDir;
+	CBDepObject indexFile;
+	CBBlockStoreIndexHeader * indexHeader; /**< The start of the mapped index file. */
+	CBBlockStoreRecord * records; /**< The mapped records, in the order the blocks were added. */
+	uint32_t blockNum; /**< The number of blocks. */
+	uint32_t capacity; /**< The number of records the index file has space for. */
+	uint32_t fileSize; /**< The maximum size of a block file. */
+	uint32_t * table; /**< A hash table of the records in memory. A slot has the record index plus one or zero when empty. */
+	uint32_t tableSize; /**< The number of slots, which is a power of two. */
+	CBBlockStoreFile * files; /**< The block files, opened when needed. */
+	uint32_t fileNum; /**< The number of elements in files. */
+	uint32_t openFileNum; /**< The number of open block files. */
+	uint32_t maxOpenFiles; /**< The number of block files which can be open at once, after which the least recently used file is closed. */
+	uint32_t useCount; /**< Increased each time a block file is used. */
+	uint32_t appendFile; /**< The block file to add blocks to. */
+	uint32_t appendOffset; /**< The position to add the next block to in the append file. */
+	uint32_t unsyncedFile; /**< The first block file written to since the last sync. */
+} CBBlockStore;
+
+/**
+ @brief Initialises a CBBlockStore by opening or creating the index file in a directory. Block files are opened when needed.
+ @param self The CBBlockStore to initialise.
+ @param dataDir The directory for the files, which should exist.
+ @param fileSize The maximum size of a block file for a new store, or 0 for CB_BLOCK_STORE_FILE_SIZE. An existing store uses the size it was created with.
+ @returns true on success, false on failure.
+ */
+bool CBInitBlockStore(CBBlockStore * self, char * dataDir, uint32_t fileSize);
+
+/**
+ @brief Syncs and closes the files of a CBBlockStore.
+ @param self The CBBlockStore to destroy.
+ */
+void CBDestroyBlockStore(CBBlockStore * self);
+
+//  Functions
+
+/**
+ @brief Adds a serialised block to the end of the last block file, or to a new block file if it does not fit.
+ @param self The CBBlockStore.
+ @param hash The 32 byte hash of the block.
+ @param data The serialised block.
+ @param length The length of the serialised block.
+ @returns true on success, false on failure.
+ */
+bool CBBlockStoreAppend(CBBlockStore * self, unsigned char * hash, unsigned char * data, uint32_t length);
+
+/**
+ @brief Adds a serialised CBBlock.
+ @param self The CBBlockStore.
+ @param block The serialised CBBlock.
+ @returns true on success, false on failure.
+ */
+bool CBBlockStoreAppendBlock(CBBlockStore * self, CBBlock * block);
+
+/**
+ @brief Unmaps and closes a block file. A file which was added to since the last sync is synced first.
+ @param self The CBBlockStore.
+ @param fileID The number of the open block file.
+ */
+void CBBlockStoreCloseFile(CBBlockStore * self, uint32_t fileID);
+
+/**
+ @brief Finds the record of a block.
+ @param self The CBBlockStore.
+ @param hash The 32 byte hash of the block.
+ @returns The record or NULL if the block is not in the store.
+ */
+CBBlockStoreRecord * CBBlockStoreFind(CBBlockStore * self, unsigned char * hash);
+
+/**
+ @brief Gets a new CBBlock with a copy of the data of a block, deserialised with the transactions.
+ @param self The CBBlockStore.
+ @param hash The 32 byte hash of the block.
+ @returns The CBBlock or NULL if the block is not in the store or could not be deserialised.
+ */
+CBBlock * CBBlockStoreGetBlock(CBBlockStore * self, unsigned char * hash);
+
+/**
+ @brief Gets the mapped data of a block, which is read from the page cache without copying. The file is mapped again when the block is past the end of the mapping.
+ @param self The CBBlockStore.
+ @param record The record of the block.
+ @returns The serialised block, which can be used until the CBBlockStore is next used, or NULL if the block file could not be opened or mapped or is too short.
+ */
+unsigned char * CBBlockStoreGetData(CBBlockStore * self, CBBlockStoreRecord * record);
+
+/**
+ @brief Gets a block file, opening it if needed. When maxOpenFiles files are open, the least recently used file is closed first.
+ @param self The CBBlockStore.
+ @param fileID The number of the block file.
+ @param write If true the file is opened for adding blocks and created if it does not exist. Otherwise an existing file is opened for reading only.
+ @returns The block file, which can be used until the CBBlockStore is next used, or NULL on failure.
+ */
+CBBlockStoreFile * CBBlockStoreGetFile(CBBlockStore * self, uint32_t fileID, bool write);
+
+/**
+ @brief Gets the path of a block file.
+ @param self The CBBlockStore.
+ @param fileID The number of the block file.
+ @param filename Set to the path, which should have space for the length of dataDir and 30 more characters.
+ */
+void CBBlockStoreGetFileName(CBBlockStore * self, uint32_t fileID, char * filename);
+
+/**
+ @brief Gets a new "block" message with the payload in the block file, to send with CBNetworkCommunicatorSendMessage without serialising or copying the block. The message has its own read-only handle of the file, so the message can be kept after the file is closed by the store.
+ @param self The CBBlockStore.
+ @param hash The 32 byte hash of the block.
+ @returns The CBMessage or NULL if the block is not in the store or the block file could not be opened.
+ */
+CBMessage * CBBlockStoreGetMessage(CBBlockStore * self, unsigned char * hash);
+
+/**
+ @brief Adds a record to the hash table, growing the table when needed.
+ @param self The CBBlockStore.
+ @param x The index of the record.
+ */
+void CBBlockStoreIndex(CBBlockStore * self, uint32_t x);
+
+/**
+ @brief Determines if a record after the synced records follows the record before it in the block files and has complete block data with the correct hash and checksum.
+ @param self The CBBlockStore.
+ @param x The index of the record.
+ @returns true if the record is valid, false otherwise.
+ */
+bool CBBlockStoreRecordIsValid(CBBlockStore * self, uint32_t x);
+
+/**
+ @brief Writes the block files which were added to, and then the records, to disk, and then the number of records.
+ @param self The CBBlockStore.
+ @returns true on success, false on failure.
+ */
+bool CBBlockStoreSync(CBBlockStore * self);
+
+#endif
@@ -23,6 +23,7 @@
 //  Includes
 
 #include "CBObject.h"
+#include "CBPool.h"
 #include "CBDependencies.h"
 #include "CBVarInt.h"
 #include "CBSanitiseOutput.h"
@@ -39,7 +40,8 @@
  */
 typedef struct{
 	unsigned char * data; /**< Pointer to byte data */
-	int references; /**< References to this data */
+	int references; /**< References to this data, changed atomically. */
+	unsigned char allocation; /**< The CBAllocation of this structure. */
 }CBSharedData;
 
 /**
@@ -52,6 +54,16 @@ typedef struct{
 	int length; /**< Length of byte array. */
 } CBByteArray;
 
+/**
+ @brief The pool for CBByteArray objects, including CBScript objects.
+ */
+extern CBPool CBByteArrayPool;
+
+/**
+ @brief The pool for CBSharedData.
+ */
+extern CBPool CBSharedDataPool;
+
 /**
  @brief Creates a CBByteArray object from a C string. The termination character is not included in the new CBByteArray.
  @param string The string to put into a CBByteArray.
@@ -93,6 +105,13 @@ CBByteArray * CBNewByteArrayWithData(unsigned char * data, int size);
 CBByteArray * CBNewByteArrayWithDataCopy(unsigned char * data, int size);
 CBByteArray * CBNewByteArrayFromHex(char * hex);
 
+/**
+ @brief Creates new CBSharedData with one reference, from the current arena or the pool.
+ @param data The byte data which is taken by the CBSharedData.
+ @returns The new CBSharedData.
+ */
+CBSharedData * CBNewSharedData(unsigned char * data);
+
 /**
  @brief Initialises a CBByteArray object from a C string. The termination character is not included in the new CBByteArray.
  @param self The CBByteArray object to initialise
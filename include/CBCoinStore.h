@@ -0,0 +1,353 @@
+//
+//  CBCoinStore.h
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+/**
+ @file
+ @brief A store of unspent transaction outputs (coins) for full validation, keyed by the previous output hash and index used by CBTransactionInput. Changes are made to an in-memory write-back cache which is written to disk in batches when it goes over a memory limit or when CBCoinStoreFlush is called.
+
+ On disk the coins are in an append-only log, where each batch is written with a checksum and the chain tip it leads to. A memory mapped hash table finds the log position of each unspent coin from the key. The table is only changed after the batch is synced, and is marked as being changed until it is synced after the batch, so after a crash the table is either brought up to date from the batches after it or made again from the whole log. Batches which were not completely written are dropped, so the store opens at the tip of the last complete batch. Spent coins stay in the log, which is not compacted.
+
+ Connecting a block adds undo data for the coins it spends to the top of an undo file, which is used to disconnect the block in a reorganisation. CBCoinStorePrefetch reads the coins of a block from disk into the cache across a number of threads before the scripts are validated, so that connecting the block does not wait on disk reads. The hash table is in the byte order of the machine.
+ */
+
+#ifndef CBCOINSTOREH
+#define CBCOINSTOREH
+
+//  Includes
+
+#include "CBBlock.h"
+
+// Constants and Macros
+
+#define CB_COIN_KEY_SIZE 36 // The previous output hash and the index.
+#define CB_COIN_MATURITY 100 // The number of blocks before coinbase outputs can be spent.
+#define CB_COIN_STORE_MAGIC 0x53434243 // "CBCS" in little-endian
+#define CB_COIN_STORE_MIN_TABLE 65536 // The minimum number of hash table slots.
+#define CB_COIN_STORE_MIN_BUCKETS 4096 // The minimum number of cache buckets.
+#define CB_COIN_STORE_DELETED UINT64_MAX // The offset of a slot of a spent coin.
+#define CB_COIN_STORE_BATCH_HEADER 48 // The length of the start of a batch in the log.
+#define CB_COIN_STORE_ADD_HEADER 53 // The length of an added coin in the log without the script.
+#define CB_COIN_STORE_UNDO_FOOTER 36 // The length of the undo data and the block hash after the undo data of a block.
+
+/**
+ @brief The types of entries in the coin log.
+ */
+typedef enum{
+	CB_COIN_LOG_ADD = 1, /**< A coin which is unspent, followed by the key, value, height and coinbase flag, script length and script. */
+	CB_COIN_LOG_SPEND = 2, /**< A coin which was spent, followed by the key. */
+} CBCoinLogType;
+
+/**
+ @brief The flags of a coin in the cache.
+ */
+typedef enum{
+	CB_COIN_DIRTY = 1, /**< The coin has been changed since it was flushed. */
+	CB_COIN_FRESH = 2, /**< The coin is not on disk, so it can be removed from the cache when spent before being flushed. */
+	CB_COIN_SPENT = 4, /**< The coin has been spent, which is written to disk when flushed. */
+} CBCoinFlags;
+
+/**
+ @brief The results of connecting and disconnecting blocks.
+ */
+typedef enum{
+	CB_COIN_STORE_OK, /**< The block was connected or disconnected. */
+	CB_COIN_STORE_INVALID, /**< The block is invalid and the changes were rolled back. */
+	CB_COIN_STORE_ERROR, /**< The block could not be connected or disconnected because of an error, and the coins are unchanged. */
+	CB_COIN_STORE_FLUSH_ERROR, /**< The block was connected or disconnected and the tip was changed, but the cache could not be flushed. The changes are kept in the cache. */
+} CBCoinStoreResult;
+
+/**
+ @brief An unspent transaction output, in one allocation with the script.
+ */
+typedef struct CBCoin{
+	struct CBCoin * next; /**< The next coin in the cache bucket. */
+	unsigned char key[CB_COIN_KEY_SIZE];
+	uint64_t value;
+	uint32_t height; /**< The height of the block with the transaction. */
+	bool coinbase;
+	uint8_t flags; /**< @see CBCoinFlags */
+	uint32_t scriptLength;
+	unsigned char * script; /**< The output script, which follows the coin in memory. */
+} CBCoin;
+
+/**
+ @brief A slot of the hash table on disk.
+ */
+typedef struct{
+	uint64_t tag; /**< The hash of the key, which gives the first slot to look in. */
+	uint64_t offset; /**< The position of the added coin in the log plus one, zero if the slot is empty or CB_COIN_STORE_DELETED if the coin was spent. */
+} CBCoinStoreSlot;
+
+/**
+ @brief The start of the hash table file, which is followed by the slots.
+ */
+typedef struct{
+	uint32_t magic;
+	uint32_t clean; /**< Zero while the table is being changed. */
+	uint64_t tableSize; /**< The number of slots, which is a power of two. */
+	uint64_t usedSlots; /**< The number of slots which are not empty, including slots of spent coins. */
+	uint64_t coinNum; /**< The number of unspent coins on disk. */
+	uint64_t logLength; /**< The length of the log which is in the table. */
+	uint64_t undoLength; /**< The length of the undo file at the end of the last batch in the table. */
+	unsigned char tip[32]; /**< The hash of the last connected block at the end of the last batch in the table. */
+} CBCoinStoreIndexHeader;
+
+/**
+ @brief Structure for CBCoinStore objects. @see CBCoinStore.h
+ */
+typedef struct{
+	CBDepObject logFile;
+	CBDepObject indexFile;
+	CBDepObject undoFile;
+	CBCoinStoreIndexHeader * indexHeader; /**< The start of the mapped hash table file. */
+	uint64_t indexLength; /**< The length of the mapped hash table file. */
+	CBCoinStoreSlot * table; /**< The mapped hash table slots. */
+	CBCoin ** buckets; /**< The cache of coins. */
+	uint32_t bucketNum; /**< The number of buckets, which is a power of two. */
+	uint32_t cachedNum; /**< The number of coins in the cache. */
+	uint64_t cacheSize; /**< The memory used by the coins in the cache. */
+	uint64_t cacheLimit; /**< The memory the cache may use before it is flushed and cleared. */
+	uint64_t undoLength; /**< The length of the undo data. */
+	unsigned char tip[32]; /**< The hash of the last connected block, which is zero with no blocks. */
+} CBCoinStore;
+
+/**
+ @brief Reads coins from disk for CBCoinStorePrefetch.
+ */
+typedef struct{
+	CBCoinStore * store;
+	unsigned char * keys; /**< The keys to read. */
+	CBCoin ** coins; /**< Set to the coins which were found, or NULL. */
+	bool failed; /**< Set to true if reading failed. */
+	int keyNum; /**< The number of keys to read. */
+	int itemNum; /**< The number of ranges the keys are split into. */
+} CBCoinStorePrefetchJob;
+
+/**
+ @brief Initialises a CBCoinStore by opening or creating the files in a directory. The table is brought up to date with the log if needed.
+ @param self The CBCoinStore to initialise.
+ @param dataDir The directory for the files, which should exist.
+ @param cacheLimit The memory in bytes the cache may use before it is flushed.
+ @returns true on success, false on failure.
+ */
+bool CBInitCoinStore(CBCoinStore * self, char * dataDir, uint64_t cacheLimit);
+
+/**
+ @brief Flushes the cache and closes the files of a CBCoinStore.
+ @param self The CBCoinStore to destroy.
+ */
+void CBDestroyCoinStore(CBCoinStore * self);
+
+//  Functions
+
+/**
+ @brief Adds an unspent coin to the cache, replacing an existing coin with the same key.
+ @param self The CBCoinStore.
+ @param key The key of the coin.
+ @param value The value of the coin.
+ @param height The height of the block of the coin.
+ @param coinbase true if the coin is from a coinbase transaction.
+ @param script The output script.
+ @param scriptLength The length of the output script.
+ */
+void CBCoinStoreAdd(CBCoinStore * self, unsigned char * key, uint64_t value, uint32_t height, bool coinbase, unsigned char * script, uint32_t scriptLength);
+
+/**
+ @brief Applies the entries of a batch from the log to the hash table.
+ @param self The CBCoinStore.
+ @param data The entries.
+ @param length The length of the entries.
+ @param offset The position of the entries in the log.
+ @returns true on success, false on failure.
+ */
+bool CBCoinStoreApplyBatch(CBCoinStore * self, unsigned char * data, uint32_t length, uint64_t offset);
+
+/**
+ @brief Adds a coin to the cache.
+ @param self The CBCoinStore.
+ @param coin The coin, which is owned by the cache.
+ */
+void CBCoinStoreCacheAdd(CBCoinStore * self, CBCoin * coin);
+
+/**
+ @brief Removes every coin from the cache.
+ @param self The CBCoinStore.
+ */
+void CBCoinStoreCacheClear(CBCoinStore * self);
+
+/**
+ @brief Finds a coin in the cache, including spent coins which have not been flushed.
+ @param self The CBCoinStore.
+ @param key The key of the coin.
+ @returns The coin or NULL if it is not in the cache.
+ */
+CBCoin * CBCoinStoreCacheFind(CBCoinStore * self, unsigned char * key);
+
+/**
+ @brief Removes a coin from the cache and frees it.
+ @param self The CBCoinStore.
+ @param coin The coin to remove.
+ */
+void CBCoinStoreCacheRemove(CBCoinStore * self, CBCoin * coin);
+
+/**
+ @brief Validates the inputs of the transactions of a block against the coins, spends the coins and adds the outputs of the transactions. The coins must not be spent before maturity and the inputs must have at least the value of the outputs, and the coinbase outputs must not be over the block reward and the fees. The block is rolled back on failure. The scripts are not validated, which should be done before with the coins from CBCoinStoreGet after CBCoinStorePrefetch. Outputs with scripts starting with OP_RETURN are not added as they cannot be spent. The undo data is added to the undo file and the cache is flushed if it goes over the limit.
+ @param self The CBCoinStore.
+ @param block The deserialised block, which should follow the tip.
+ @param height The height of the block.
+ @returns CB_COIN_STORE_OK if the block was connected, CB_COIN_STORE_INVALID if the block is invalid, CB_COIN_STORE_ERROR if the block could not be connected because of an error or CB_COIN_STORE_FLUSH_ERROR if the block was connected but the flush failed.
+ */
+CBCoinStoreResult CBCoinStoreConnectBlock(CBCoinStore * self, CBBlock * block, uint32_t height);
+
+/**
+ @brief Disconnects the block at the tip using its undo data, so that the coins are as they were before the block.
+ @param self The CBCoinStore.
+ @param block The deserialised block at the tip.
+ @returns CB_COIN_STORE_OK if the block was disconnected, CB_COIN_STORE_ERROR if the block could not be disconnected or CB_COIN_STORE_FLUSH_ERROR if the block was disconnected but the flush failed.
+ */
+CBCoinStoreResult CBCoinStoreDisconnectBlock(CBCoinStore * self, CBBlock * block);
+
+/**
+ @brief Finds the slot of a coin in the hash table.
+ @param self The CBCoinStore.
+ @param key The key of the coin.
+ @param slot Set to the index of the slot.
+ @returns 1 if found, 0 if not found, and -1 if the log could not be read.
+ */
+int CBCoinStoreFindSlot(CBCoinStore * self, unsigned char * key, uint64_t * slot);
+
+/**
+ @brief Writes the changed coins to disk as a batch in the log and updates the hash table. The coins are then kept in the cache unless it is over the limit, in which case it is cleared.
+ @param self The CBCoinStore.
+ @returns true on success, false on failure.
+ */
+bool CBCoinStoreFlush(CBCoinStore * self);
+
+/**
+ @brief Gets an unspent coin, from the cache or from disk, in which case it is added to the cache.
+ @param self The CBCoinStore.
+ @param hash The hash of the transaction of the output.
+ @param index The index of the output.
+ @returns The coin, which can be used until the CBCoinStore is next changed, or NULL if there is no such unspent coin or it could not be read.
+ */
+CBCoin * CBCoinStoreGet(CBCoinStore * self, unsigned char * hash, uint32_t index);
+
+/**
+ @brief Gets an unspent coin from the cache or from disk.
+ @param self The CBCoinStore.
+ @param key The key of the coin.
+ @returns The coin or NULL.
+ */
+CBCoin * CBCoinStoreGetByKey(CBCoinStore * self, unsigned char * key);
+
+/**
+ @brief Gets the tag of a key for the hash table.
+ @param key The key.
+ @returns The tag.
+ */
+uint64_t CBCoinStoreGetTag(unsigned char * key);
+
+/**
+ @brief Adds a slot to the hash table, growing the table if needed.
+ @param self The CBCoinStore.
+ @param tag The tag of the key.
+ @param offset The position of the coin in the log.
+ @returns true on success, false if the table could not be grown.
+ */
+bool CBCoinStoreInsertSlot(CBCoinStore * self, uint64_t tag, uint64_t offset);
+
+/**
+ @brief Makes the key of a coin.
+ @param key The CB_COIN_KEY_SIZE bytes to set.
+ @param hash The hash of the transaction.
+ @param index The index of the output.
+ */
+void CBCoinStoreMakeKey(unsigned char * key, unsigned char * hash, uint32_t index);
+
+/**
+ @brief Reads the coins of the inputs of a block from disk into the cache across a number of threads. Inputs of coins in the cache or which are not on disk are skipped.
+ @param self The CBCoinStore.
+ @param block The deserialised block.
+ @param numThreads The number of threads to use. If less than 1 the number of cores is used. The threads are from the shared thread pool.
+ @returns true on success, false if reading failed.
+ */
+bool CBCoinStorePrefetch(CBCoinStore * self, CBBlock * block, int numThreads);
+
+/**
+ @brief Reads a range of the coins of a CBCoinStorePrefetchJob.
+ @param job The job.
+ @param start The first key to read.
+ @param end The key after the last one.
+ @returns true on success, false if reading failed.
+ */
+bool CBCoinStorePrefetchCoins(CBCoinStorePrefetchJob * job, int start, int end);
+
+/**
+ @brief Reads a range of the coins of a CBCoinStorePrefetchJob on the shared thread pool.
+ @param job The job.
+ @param item The number of the range.
+ */
+void CBCoinStorePrefetchProcess(void * job, int item);
+
+/**
+ @brief Reads a coin from disk. This does not change the CBCoinStore and can be called by a number of threads at once.
+ @param self The CBCoinStore.
+ @param key The key of the coin.
+ @param coin Set to a new coin, which is not in the cache, or NULL if the coin is not on disk.
+ @returns true on success, false if reading failed.
+ */
+bool CBCoinStoreReadCoin(CBCoinStore * self, unsigned char * key, CBCoin ** coin);
+
+/**
+ @brief Makes the hash table again from the whole log.
+ @param self The CBCoinStore.
+ @returns true on success, false on failure.
+ */
+bool CBCoinStoreRebuildTable(CBCoinStore * self);
+
+/**
+ @brief Applies the complete batches of the log after logLength to the hash table and truncates the log after them. If the log is shorter than logLength, the table is made again from the log.
+ @param self The CBCoinStore.
+ @returns true on success, false on failure.
+ */
+bool CBCoinStoreReplay(CBCoinStore * self);
+
+/**
+ @brief Makes the hash table larger, removing the slots of spent coins.
+ @param self The CBCoinStore.
+ @param tableSize The new number of slots.
+ @returns true on success, false on failure.
+ */
+bool CBCoinStoreResizeTable(CBCoinStore * self, uint64_t tableSize);
+
+/**
+ @brief Spends an unspent coin.
+ @param self The CBCoinStore.
+ @param coin The coin from CBCoinStoreGet, which can no longer be used.
+ */
+void CBCoinStoreSpend(CBCoinStore * self, CBCoin * coin);
+
+/**
+ @brief Undoes the changes of the first transactions of a block, such as when disconnecting it or when it fails to connect.
+ @param self The CBCoinStore.
+ @param block The block.
+ @param txNum The number of transactions which were connected.
+ @param inputNum The number of inputs of the transaction after them which were spent.
+ @param undo The undo data of the spent coins.
+ @param undoLength The length of the undo data.
+ @returns true on success, false if the undo data is bad.
+ */
+bool CBCoinStoreUndo(CBCoinStore * self, CBBlock * block, int txNum, int inputNum, unsigned char * undo, uint32_t undoLength);
+
+#endif
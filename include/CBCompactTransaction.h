@@ -0,0 +1,122 @@
+//
+//  CBCompactTransaction.h
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+/**
+ @file
+ @brief An immutable transaction in a single allocation, for keeping many transactions in memory such as in a memory pool. Fixed size records for the inputs and outputs point into a copy of the serialised transaction, so there are no objects for the inputs, outputs or scripts. Inherits CBObject.
+ */
+
+#ifndef CBCOMPACTTRANSACTIONH
+#define CBCOMPACTTRANSACTIONH
+
+//  Includes
+
+#include "CBTransaction.h"
+
+// Getter
+
+#define CBGetCompactTransaction(x) ((CBCompactTransaction *)x)
+
+// Macros for the serialised data of inputs and outputs
+
+#define CBCompactInputPrevOutHash(tx, x) ((tx)->data + (tx)->inputs[x].offset)
+#define CBCompactInputScript(tx, x) ((tx)->data + (tx)->inputs[x].scriptOffset)
+#define CBCompactOutputScript(tx, x) ((tx)->data + (tx)->outputs[x].scriptOffset)
+
+/**
+ @brief An input of a CBCompactTransaction.
+ */
+typedef struct{
+	uint32_t offset; /**< The offset of the input in the transaction data, which is where the previous output hash is. */
+	uint32_t prevOutIndex; /**< The index of the previous output. */
+	uint32_t sequence;
+	uint32_t scriptOffset; /**< The offset of the input script in the transaction data. */
+	uint32_t scriptLength;
+} CBCompactInput;
+
+/**
+ @brief An output of a CBCompactTransaction.
+ */
+typedef struct{
+	uint64_t value;
+	uint32_t scriptOffset; /**< The offset of the output script in the transaction data. */
+	uint32_t scriptLength;
+} CBCompactOutput;
+
+/**
+ @brief Structure for CBCompactTransaction objects. @see CBCompactTransaction.h
+ */
+typedef struct{
+	CBObject base;
+	int version;
+	uint32_t lockTime;
+	int inputNum;
+	int outputNum;
+	int length; /**< The length of the serialised transaction. */
+	bool hashSet;
+	unsigned char hash[32];
+	CBCompactOutput * outputs; /**< The outputs, which follow the structure in memory. */
+	CBCompactInput * inputs; /**< The inputs, which follow the outputs. */
+	unsigned char * data; /**< The serialised transaction, which follows the inputs. */
+} CBCompactTransaction;
+
+/**
+ @brief Creates a new CBCompactTransaction from serialised data.
+ @param data The serialised transaction, which is copied.
+ @param length The length of the data, which may be longer than the transaction.
+ @returns The new CBCompactTransaction or NULL if the data is not a valid transaction.
+ */
+CBCompactTransaction * CBNewCompactTransactionFromData(unsigned char * data, int length);
+
+/**
+ @brief Creates a new CBCompactTransaction from a CBTransaction, which is serialised if it has no bytes.
+ @param tx The CBTransaction.
+ @returns The new CBCompactTransaction or NULL on failure.
+ */
+CBCompactTransaction * CBNewCompactTransactionFromTransaction(CBTransaction * tx);
+
+/**
+ @brief Frees a CBCompactTransaction.
+ @param self The CBCompactTransaction to free.
+ */
+void CBFreeCompactTransaction(void * self);
+
+//  Functions
+
+/**
+ @brief Gets the hash of a CBCompactTransaction, calculating it if needed.
+ @param self The CBCompactTransaction.
+ @returns The 32 byte hash.
+ */
+unsigned char * CBCompactTransactionGetHash(CBCompactTransaction * self);
+
+/**
+ @brief Checks serialised transaction data and finds the numbers of inputs and outputs and the length.
+ @param data The serialised transaction.
+ @param length The length of the data, which may be longer than the transaction.
+ @param inputNum Set to the number of inputs.
+ @param outputNum Set to the number of outputs.
+ @param txLength Set to the length of the transaction.
+ @returns true if the data has a valid transaction, false otherwise.
+ */
+bool CBCompactTransactionMeasure(unsigned char * data, int length, int * inputNum, int * outputNum, int * txLength);
+
+/**
+ @brief Creates a CBTransaction from a CBCompactTransaction.
+ @param self The CBCompactTransaction.
+ @returns A new deserialised CBTransaction.
+ */
+CBTransaction * CBCompactTransactionToTransaction(CBCompactTransaction * self);
+
+#endif
@@ -0,0 +1,154 @@
+//
+//  CBCursor.h
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+/**
+ @file
+ @brief Reads serialised data from a CBByteArray for deserialisation. The functions are inline so that each read is a load from a pointer into the data rather than a library call through the shared data of the byte array. Fixed size reads do not check bounds, so CBCursorHas should be used first. Var ints are checked as their size is only known from the first byte.
+ */
+
+#ifndef CBCURSORH
+#define CBCURSORH
+
+//  Includes
+
+#include "CBByteArray.h"
+
+/**
+ @brief Structure for CBCursor objects. @see CBCursor.h
+ */
+typedef struct{
+	unsigned char * data; /**< The data being read. */
+	int length; /**< The length of the data. */
+	int offset; /**< The offset of the next byte to read. */
+} CBCursor;
+
+/**
+ @brief Initialises a CBCursor at the start of a CBByteArray. The byte array must not be changed while it is read.
+ @param self The CBCursor to initialise.
+ @param bytes The CBByteArray to read.
+ */
+static inline void CBInitCursor(CBCursor * self, CBByteArray * bytes) {
+	self->data = bytes->sharedData->data + bytes->offset;
+	self->length = bytes->length;
+	self->offset = 0;
+}
+
+//  Functions
+
+/**
+ @brief Determines if there are enough bytes remaining to read.
+ @param self The CBCursor.
+ @param size The number of bytes needed.
+ @returns true if there are at least size bytes remaining, false otherwise.
+ */
+static inline bool CBCursorHas(CBCursor * self, long long int size) {
+	return size <= self->length - self->offset;
+}
+
+/**
+ @brief Gets a pointer to the next byte, so that bytes can be copied out.
+ @param self The CBCursor.
+ @returns A pointer to the data at the offset.
+ */
+static inline unsigned char * CBCursorPointer(CBCursor * self) {
+	return self->data + self->offset;
+}
+
+/**
+ @brief Reads a byte.
+ @param self The CBCursor.
+ @returns The byte.
+ */
+static inline uint8_t CBCursorReadByte(CBCursor * self) {
+	return self->data[self->offset++];
+}
+
+/**
+ @brief Reads a little-endian 16-bit integer.
+ @param self The CBCursor.
+ @returns The integer.
+ */
+static inline uint16_t CBCursorReadInt16(CBCursor * self) {
+	self->offset += 2;
+	return CBArrayToInt16(self->data, self->offset - 2);
+}
+
+/**
+ @brief Reads a little-endian 32-bit integer.
+ @param self The CBCursor.
+ @returns The integer.
+ */
+static inline uint32_t CBCursorReadInt32(CBCursor * self) {
+	self->offset += 4;
+	return CBArrayToInt32(self->data, self->offset - 4);
+}
+
+/**
+ @brief Reads a little-endian 64-bit integer.
+ @param self The CBCursor.
+ @returns The integer.
+ */
+static inline uint64_t CBCursorReadInt64(CBCursor * self) {
+	self->offset += 8;
+	return CBArrayToInt64(self->data, self->offset - 8);
+}
+
+/**
+ @brief Reads a big-endian port number.
+ @param self The CBCursor.
+ @returns The port.
+ */
+static inline uint16_t CBCursorReadPort(CBCursor * self) {
+	self->offset += 2;
+	return (uint16_t)(self->data[self->offset - 2] << 8 | self->data[self->offset - 1]);
+}
+
+/**
+ @brief Reads a var int after checking there are enough bytes for it.
+ @param self The CBCursor.
+ @param varInt The CBVarInt to set.
+ @returns true if the var int was read, false if there were not enough bytes, in which case the offset is not moved.
+ */
+static inline bool CBCursorReadVarInt(CBCursor * self, CBVarInt * varInt) {
+	if (self->offset >= self->length)
+		return false;
+	unsigned char first = self->data[self->offset];
+	if (first < 253) {
+		varInt->size = 1;
+		varInt->val = first;
+	}else{
+		varInt->size = first == 253 ? 3 : (first == 254 ? 5 : 9);
+		if (self->length - self->offset < varInt->size)
+			return false;
+		if (first == 253)
+			varInt->val = CBArrayToInt16(self->data, self->offset + 1);
+		else if (first == 254)
+			varInt->val = CBArrayToInt32(self->data, self->offset + 1);
+		else
+			varInt->val = CBArrayToInt64(self->data, self->offset + 1);
+	}
+	self->offset += varInt->size;
+	return true;
+}
+
+/**
+ @brief Moves the offset forward.
+ @param self The CBCursor.
+ @param size The number of bytes to skip.
+ */
+static inline void CBCursorSkip(CBCursor * self, int size) {
+	self->offset += size;
+}
+
+#endif
@@ -39,6 +39,28 @@ typedef union{
 
 #define CB_PUBKEY_SIZE 33
 #define CB_PRIVKEY_SIZE 32
+#define CB_SHA256_CONTEXT_SIZE 128
+#define CB_SHA512_CONTEXT_SIZE 224
+#define CB_SHA256_MIDSTATE_SIZE 104 // 32 bytes of state, 8 for the length processed and 64 for unprocessed data
+#define CB_SHA512_MIDSTATE_SIZE 200 // 64 bytes of state, 8 for the length processed and 128 for unprocessed data
+
+// Types
+
+/**
+ @brief Holds the state of a streaming SHA-256 hash. This may be copied with assignment to fork the hash from the current state.
+ */
+typedef union{
+	uint64_t align;
+	unsigned char data[CB_SHA256_CONTEXT_SIZE];
+} CBSha256Context;
+
+/**
+ @brief Holds the state of a streaming SHA-512 hash. This may be copied with assignment to fork the hash from the current state.
+ */
+typedef union{
+	uint64_t align;
+	unsigned char data[CB_SHA512_CONTEXT_SIZE];
+} CBSha512Context;
 
 // Functions
 
@@ -72,6 +94,86 @@ void CBSha256(unsigned char * data, int length, unsigned char * output);
 void CBSha512(unsigned char * data, int len, unsigned char * output);
 #pragma weak CBSha512
 
+/**
+ @brief Starts a streaming SHA-256 hash.
+ @param ctx The context to initialise.
+ */
+void CBSha256Init(CBSha256Context * ctx);
+#pragma weak CBSha256Init
+
+/**
+ @brief Adds data to a streaming SHA-256 hash.
+ @param ctx The hash context.
+ @param data A pointer to the byte data to hash.
+ @param length The length of the data to hash.
+ */
+void CBSha256Update(CBSha256Context * ctx, unsigned char * data, int length);
+#pragma weak CBSha256Update
+
+/**
+ @brief Finishes a streaming SHA-256 hash. The context must be initialised again before further use.
+ @param ctx The hash context.
+ @param output A pointer to hold a 32-byte hash.
+ */
+void CBSha256Final(CBSha256Context * ctx, unsigned char * output);
+#pragma weak CBSha256Final
+
+/**
+ @brief Exports the state of a streaming SHA-256 hash in a portable form. The first 32 bytes are the state words in big-endian, followed by the number of bytes processed as a 64-bit little-endian integer and then the unprocessed data, padded with zeros to 64 bytes.
+ @param ctx The hash context.
+ @param midstate A pointer to hold CB_SHA256_MIDSTATE_SIZE bytes.
+ */
+void CBSha256GetMidstate(CBSha256Context * ctx, unsigned char * midstate);
+#pragma weak CBSha256GetMidstate
+
+/**
+ @brief Sets the state of a streaming SHA-256 hash from a midstate given by CBSha256GetMidstate.
+ @param ctx The hash context to set.
+ @param midstate CB_SHA256_MIDSTATE_SIZE bytes of midstate.
+ */
+void CBSha256SetMidstate(CBSha256Context * ctx, unsigned char * midstate);
+#pragma weak CBSha256SetMidstate
+
+/**
+ @brief Starts a streaming SHA-512 hash.
+ @param ctx The context to initialise.
+ */
+void CBSha512Init(CBSha512Context * ctx);
+#pragma weak CBSha512Init
+
+/**
+ @brief Adds data to a streaming SHA-512 hash.
+ @param ctx The hash context.
+ @param data A pointer to the byte data to hash.
+ @param length The length of the data to hash.
+ */
+void CBSha512Update(CBSha512Context * ctx, unsigned char * data, int length);
+#pragma weak CBSha512Update
+
+/**
+ @brief Finishes a streaming SHA-512 hash. The context must be initialised again before further use.
+ @param ctx The hash context.
+ @param output A pointer to hold a 64-byte hash.
+ */
+void CBSha512Final(CBSha512Context * ctx, unsigned char * output);
+#pragma weak CBSha512Final
+
+/**
+ @brief Exports the state of a streaming SHA-512 hash in a portable form. The first 64 bytes are the state words in big-endian, followed by the number of bytes processed as a 64-bit little-endian integer and then the unprocessed data, padded with zeros to 128 bytes.
+ @param ctx The hash context.
+ @param midstate A pointer to hold CB_SHA512_MIDSTATE_SIZE bytes.
+ */
+void CBSha512GetMidstate(CBSha512Context * ctx, unsigned char * midstate);
+#pragma weak CBSha512GetMidstate
+
+/**
+ @brief Sets the state of a streaming SHA-512 hash from a midstate given by CBSha512GetMidstate.
+ @param ctx The hash context to set.
+ @param midstate CB_SHA512_MIDSTATE_SIZE bytes of midstate.
+ */
+void CBSha512SetMidstate(CBSha512Context * ctx, unsigned char * midstate);
+#pragma weak CBSha512SetMidstate
+
 /**
  @brief RIPEMD-160 cryptographic hash function.
  @param data A pointer to the byte data to hash.
@@ -102,6 +204,35 @@ void CBSha160(unsigned char * data, int length, unsigned char * output);
 bool CBEcdsaVerify(unsigned char * signature, int sigLen, unsigned char * hash, unsigned char * pubKey, int keyLen);
 #pragma weak CBEcdsaVerify
 
+/**
+ @brief Creates a reusable ECDSA verification context. The context holds the curve setup and a least-recently-used cache of parsed public keys so that repeatedly used keys are only decoded once. A context must only be used by one thread at a time.
+ @param ctx A pointer to the CBDepObject for the new context.
+ @param cacheSize The maximum number of parsed public keys to keep in the cache.
+ @returns true on success and false on failure.
+ */
+bool CBNewEcdsaVerifyContext(CBDepObject * ctx, int cacheSize);
+#pragma weak CBNewEcdsaVerifyContext
+
+/**
+ @brief Frees an ECDSA verification context.
+ @param ctx The context to free.
+ */
+void CBFreeEcdsaVerifyContext(CBDepObject ctx);
+#pragma weak CBFreeEcdsaVerifyContext
+
+/**
+ @brief Verifies an ECDSA signature in the same way as CBEcdsaVerify, using the curve setup and public key cache of a verification context.
+ @param ctx The verification context.
+ @param signature BER encoded signature bytes.
+ @param sigLen The length of the signature bytes.
+ @param hash A 32 byte hash for checking the signature against.
+ @param pubKey Public key bytes to check this signature with.
+ @param keyLen The length of the public key bytes.
+ @returns true if the signature is valid and false if invalid.
+ */
+bool CBEcdsaVerifyWithContext(CBDepObject ctx, unsigned char * signature, int sigLen, unsigned char * hash, unsigned char * pubKey, int keyLen);
+#pragma weak CBEcdsaVerifyWithContext
+
 // NETWORKING DEPENDENCIES
 
 // Constants and Macros
@@ -184,9 +315,22 @@ bool CBSocketAccept(CBDepObject socketID, CBDepObject * connectionSocketID, void
 bool CBNewEventLoop(CBDepObject * loopID, void (*onError)(void *), void (*onDidTimeout)(void *, void *, CBTimeOutType), void * communicator);
 #pragma weak CBNewEventLoop
 
+/**
+ @brief Starts resolving a domain without blocking. When the domain has been resolved, the addresses should be added to the address manager of the CBNetworkCommunicator with the default port on its event loop, followed by a call to CBNetworkCommunicatorOnDNSLoaded, also on the event loop.
+ @param comm The CBNetworkCommunicator.
+ @param domain The domain to resolve.
+ @returns true if the lookup was started and CBNetworkCommunicatorOnDNSLoaded will be called, false otherwise.
+ */
 bool CBNetworkCommunicatorLoadDNS(void * comm, char * domain);
 #pragma weak CBNetworkCommunicatorLoadDNS
 
+/**
+ @brief Stops the results of lookups started by CBNetworkCommunicatorLoadDNS from being given to a CBNetworkCommunicator, and sets dnsLookups of the CBNetworkCommunicator to zero. No result should be given after this returns. Called on the event loop.
+ @param comm The CBNetworkCommunicator.
+ */
+void CBNetworkCommunicatorCancelDNS(void * comm);
+#pragma weak CBNetworkCommunicatorCancelDNS
+
 /**
  @brief Runs a callback on the event loop.
  @param loopID The loop ID
@@ -277,6 +421,17 @@ void CBSocketFreeEvent(CBDepObject eventID);
 int32_t CBSocketSend(CBDepObject socketID, unsigned char * data, int len);
 #pragma weak CBSocketSend
 
+/**
+ @brief Sends data from a file to a socket, without copying the data into user space where possible. This should be non-blocking.
+ @param socketID The socket id to send to.
+ @param file The file to send from, opened with CBFileOpen.
+ @param offset The position in the file of the data.
+ @param len The length of the data to send.
+ @returns The number of bytes actually sent, and CB_SOCKET_FAILURE on failure that suggests further data cannot be sent.
+ */
+int32_t CBSocketSendFile(CBDepObject socketID, CBDepObject file, uint64_t offset, int len);
+#pragma weak CBSocketSendFile
+
 /**
  @brief Receives data from a socket. This should be non-blocking.
  @param socketID The socket id to receive data from.
@@ -398,9 +553,128 @@ void CBConditionWait(CBDepObject cond, CBDepObject mutex);
 void CBConditionSignal(CBDepObject cond);
 #pragma weak CBConditionSignal
 
+void CBConditionBroadcast(CBDepObject cond);
+#pragma weak CBConditionBroadcast
+
 int CBGetNumberOfCores(void);
 #pragma weak CBGetNumberOfCores
 
+// STORAGE DEPENDENCIES
+
+/**
+ @brief Opens a file for reading and writing.
+ @param file The file object to set.
+ @param filename The path of the file.
+ @param create If true the file is created if it does not exist.
+ @returns true on success, false on failure.
+ */
+bool CBFileOpen(CBDepObject * file, char * filename, bool create);
+#pragma weak CBFileOpen
+
+/**
+ @brief Opens an existing file for reading only.
+ @param file The file object to set.
+ @param filename The path of the file.
+ @returns true on success, false on failure.
+ */
+bool CBFileOpenReadOnly(CBDepObject * file, char * filename);
+#pragma weak CBFileOpenReadOnly
+
+/**
+ @brief Closes a file.
+ @param file The file object.
+ */
+void CBFileClose(CBDepObject file);
+#pragma weak CBFileClose
+
+/**
+ @brief Gets the length of a file.
+ @param file The file object.
+ @param length Set to the length of the file.
+ @returns true on success, false on failure.
+ */
+bool CBFileGetLength(CBDepObject file, uint64_t * length);
+#pragma weak CBFileGetLength
+
+/**
+ @brief Maps a region of a file into memory so that it can be read and written as memory. The region should be within the length of the file.
+ @param file The file object.
+ @param offset The offset of the region in the file, which should be a multiple of the page size.
+ @param length The length of the region.
+ @param map Set to the start of the mapped memory.
+ @returns true on success, false on failure.
+ */
+bool CBFileMap(CBDepObject file, uint64_t offset, uint64_t length, void ** map);
+#pragma weak CBFileMap
+
+/**
+ @brief Maps a region of a file into memory for reading only, which works for files opened with CBFileOpenReadOnly. The region should be within the length of the file.
+ @param file The file object.
+ @param offset The offset of the region in the file, which should be a multiple of the page size.
+ @param length The length of the region.
+ @param map Set to the start of the mapped memory.
+ @returns true on success, false on failure.
+ */
+bool CBFileMapReadOnly(CBDepObject file, uint64_t offset, uint64_t length, void ** map);
+#pragma weak CBFileMapReadOnly
+
+/**
+ @brief Reads data from a file.
+ @param file The file object.
+ @param data The memory to read into.
+ @param length The number of bytes to read.
+ @param offset The offset in the file to read from.
+ @returns true if all of the bytes were read, false otherwise.
+ */
+bool CBFileRead(CBDepObject file, unsigned char * data, uint32_t length, uint64_t offset);
+#pragma weak CBFileRead
+
+/**
+ @brief Changes the length of a file. Extra bytes are zero.
+ @param file The file object.
+ @param length The new length.
+ @returns true on success, false on failure.
+ */
+bool CBFileSetLength(CBDepObject file, uint64_t length);
+#pragma weak CBFileSetLength
+
+/**
+ @brief Writes data written to a file to the disk.
+ @param file The file object.
+ @returns true on success, false on failure.
+ */
+bool CBFileSync(CBDepObject file);
+#pragma weak CBFileSync
+
+/**
+ @brief Writes changes to mapped memory to the disk.
+ @param map The start of mapped memory from CBFileMap.
+ @param offset The offset of the changes from the start of the mapped memory.
+ @param length The length of the changes.
+ @returns true on success, false on failure.
+ */
+bool CBFileSyncMap(void * map, uint64_t offset, uint64_t length);
+#pragma weak CBFileSyncMap
+
+/**
+ @brief Unmaps memory mapped with CBFileMap.
+ @param map The start of the mapped memory.
+ @param length The length of the mapped memory.
+ */
+void CBFileUnmap(void * map, uint64_t length);
+#pragma weak CBFileUnmap
+
+/**
+ @brief Writes data to a file.
+ @param file The file object.
+ @param data The data to write.
+ @param length The number of bytes to write.
+ @param offset The offset in the file to write to.
+ @returns true if all of the bytes were written, false otherwise.
+ */
+bool CBFileWrite(CBDepObject file, unsigned char * data, uint32_t length, uint64_t offset);
+#pragma weak CBFileWrite
+
 // LOGGING DEPENDENCIES
 
 /**
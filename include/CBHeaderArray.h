@@ -0,0 +1,203 @@
+//
+//  CBHeaderArray.h
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+/**
+ @file
+ @brief A growable array of packed 80 byte block headers, for headers-first synchronisation without a CBBlock object for each header. Headers are appended straight from "headers" message payloads and their hashes are kept in a parallel array, calculated when needed. Inherits CBObject.
+ */
+
+#ifndef CBHEADERARRAYH
+#define CBHEADERARRAYH
+
+//  Includes
+
+#include "CBBlock.h"
+#include "CBHeaderHasher.h"
+
+// Constants and Macros
+
+#define CB_HEADER_SIZE 80
+#define CBGetHeaderArray(x) ((CBHeaderArray *)x)
+
+// Macros for the fields of a header in the array
+
+#define CBHeaderArrayGetHeader(self, x) ((self)->headers + (x) * CB_HEADER_SIZE)
+#define CBHeaderArrayGetPrevBlockHash(self, x) (CBHeaderArrayGetHeader(self, x) + 4)
+#define CBHeaderArrayGetMerkleRoot(self, x) (CBHeaderArrayGetHeader(self, x) + 36)
+#define CBHeaderArrayGetVersion(self, x) CBArrayToInt32(CBHeaderArrayGetHeader(self, x), 0)
+#define CBHeaderArrayGetTime(self, x) CBArrayToInt32(CBHeaderArrayGetHeader(self, x), 68)
+#define CBHeaderArrayGetTarget(self, x) CBArrayToInt32(CBHeaderArrayGetHeader(self, x), 72)
+#define CBHeaderArrayGetNonce(self, x) CBArrayToInt32(CBHeaderArrayGetHeader(self, x), 76)
+
+/**
+ @brief Structure for CBHeaderArray objects. @see CBHeaderArray.h
+ */
+typedef struct{
+	CBObject base;
+	int headerNum; /**< The number of headers. */
+	int capacity; /**< The number of headers there is memory for. */
+	int hashedNum; /**< The number of headers from the start which have their hash calculated. */
+	unsigned char * headers; /**< The serialised headers, each CB_HEADER_SIZE bytes. */
+	unsigned char * hashes; /**< The 32 byte hashes of the headers. */
+} CBHeaderArray;
+
+/**
+ @brief A validation of headers in a CBHeaderArray across a number of threads.
+ */
+typedef struct{
+	CBHeaderArray * array;
+	int firstInvalid; /**< The lowest invalid index found so far, or headerNum. */
+	int start; /**< The first header to validate. */
+	int num; /**< The number of headers to validate. */
+	int itemNum; /**< The number of ranges the headers are split into. */
+} CBHeaderArrayValidateJob;
+
+/**
+ @brief Creates a new CBHeaderArray.
+ @param capacity The number of headers to allocate memory for at first.
+ @returns A new CBHeaderArray object.
+ */
+CBHeaderArray * CBNewHeaderArray(int capacity);
+
+/**
+ @brief Creates a new CBHeaderArray from the payload of a "headers" message.
+ @param data The payload data.
+ @param length The length of the payload data.
+ @returns A new CBHeaderArray object or NULL if the data is invalid.
+ */
+CBHeaderArray * CBNewHeaderArrayFromPayload(unsigned char * data, int length);
+
+/**
+ @brief Initialises a CBHeaderArray.
+ @param self The CBHeaderArray to initialise.
+ @param capacity The number of headers to allocate memory for at first.
+ */
+void CBInitHeaderArray(CBHeaderArray * self, int capacity);
+
+/**
+ @brief Frees the memory used by a CBHeaderArray.
+ @param self The CBHeaderArray to destroy.
+ */
+void CBDestroyHeaderArray(void * self);
+
+/**
+ @brief Frees a CBHeaderArray object and also calls CBDestroyHeaderArray.
+ @param self The CBHeaderArray object to free.
+ */
+void CBFreeHeaderArray(void * self);
+
+//  Functions
+
+/**
+ @brief Adds a serialised header to the end of the array.
+ @param self The CBHeaderArray.
+ @param header The 80 byte serialised header.
+ */
+void CBHeaderArrayAppend(CBHeaderArray * self, unsigned char * header);
+
+/**
+ @brief Adds the header of a serialised CBBlock to the end of the array.
+ @param self The CBHeaderArray.
+ @param block The CBBlock, which should be serialised.
+ */
+void CBHeaderArrayAppendBlock(CBHeaderArray * self, CBBlock * block);
+
+/**
+ @brief Adds the headers from the payload of a "headers" message to the end of the array. The data is checked before any headers are added so the array is unchanged on failure.
+ @param self The CBHeaderArray.
+ @param data The payload data.
+ @param length The length of the payload data.
+ @returns The length read on success, CB_DESERIALISE_ERROR on failure.
+ */
+int CBHeaderArrayAppendPayload(CBHeaderArray * self, unsigned char * data, int length);
+
+/**
+ @brief Calculates the hashes of the headers which do not have a hash yet, using CBHeaderHasherHashHeaders.
+ @param self The CBHeaderArray.
+ */
+void CBHeaderArrayCalculateHashes(CBHeaderArray * self);
+
+/**
+ @brief Finds the first header which does not follow the previous header or which does not meet its proof of work target. The targets themselves are not checked against the chain. This is CBHeaderArrayValidate from the first header with one thread.
+ @param self The CBHeaderArray.
+ @param prevHash The hash of the block the first header should follow, or NULL to not check the linkage of the first header.
+ @returns The index of the first invalid header or headerNum if all headers are valid.
+ */
+int CBHeaderArrayFindInvalid(CBHeaderArray * self, unsigned char * prevHash);
+
+/**
+ @brief Gets a new CBBlock with the header at an index, for when an object is needed.
+ @param self The CBHeaderArray.
+ @param x The index of the header.
+ @returns A new deserialised CBBlock with no transactions.
+ */
+CBBlock * CBHeaderArrayGetBlock(CBHeaderArray * self, int x);
+
+/**
+ @brief Gets the hash of a header, calculating the hashes upto it if needed.
+ @param self The CBHeaderArray.
+ @param x The index of the header.
+ @returns The 32 byte hash.
+ */
+unsigned char * CBHeaderArrayGetHash(CBHeaderArray * self, int x);
+
+/**
+ @brief Gets the length of the headers as the payload of a "headers" message.
+ @param self The CBHeaderArray.
+ @returns The length.
+ */
+int CBHeaderArrayPayloadLength(CBHeaderArray * self);
+
+/**
+ @brief Ensures there is memory for a number of headers.
+ @param self The CBHeaderArray.
+ @param capacity The number of headers needed.
+ */
+void CBHeaderArrayReserve(CBHeaderArray * self, int capacity);
+
+/**
+ @brief Serialises the headers as the payload of a "headers" message, with a zero transaction number and a null byte for each.
+ @param self The CBHeaderArray.
+ @param data The data to write to, which should be at least CBHeaderArrayPayloadLength bytes.
+ @returns The length written.
+ */
+int CBHeaderArraySerialisePayload(CBHeaderArray * self, unsigned char * data);
+
+/**
+ @brief Validates headers from an index to the end of the array across a number of threads. The headers are split into ranges which are hashed and checked for proof of work and linkage within the range on a thread pool, and then the linkage between the ranges is checked. The targets themselves are not checked against the chain.
+ @param self The CBHeaderArray.
+ @param start The index of the first header to validate.
+ @param prevHash The hash of the block the first header should follow. If NULL, the hash of the header before start is used, or the linkage of the first header is not checked when start is zero.
+ @param numThreads The number of threads of the shared thread pool to use. If less than 1 the number of cores is used.
+ @returns The index of the first invalid header or headerNum if all headers are valid.
+ */
+int CBHeaderArrayValidate(CBHeaderArray * self, int start, unsigned char * prevHash, int numThreads);
+
+/**
+ @brief Validates a range of the headers of a CBHeaderArrayValidateJob on the shared thread pool, lowering firstInvalid when an invalid header is found.
+ @param job The CBHeaderArrayValidateJob.
+ @param item The number of the range.
+ */
+void CBHeaderArrayValidateProcess(void * job, int item);
+
+/**
+ @brief Hashes a range of headers and checks the proof of work of each and the linkage within the range.
+ @param self The CBHeaderArray.
+ @param start The first header.
+ @param end The header after the last one.
+ @returns The index of the first invalid header or end if all headers are valid.
+ */
+int CBHeaderArrayValidateRange(CBHeaderArray * self, int start, int end);
+
+#endif
@@ -0,0 +1,134 @@
+//
+//  CBHeaderHasher.h
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+/**
+ @file
+ @brief Hashes block headers for rolling the nonce, time and extra nonce of a block template. The SHA-256 state after the first 64 bytes of the header is cached, so each nonce only requires the last 16 bytes to be hashed. CBHeaderHasherHashLanes hashes CB_HEADER_HASHER_LANES nonces at once with the lanes laid out for the compiler to vectorise.
+ */
+
+#ifndef CBHEADERHASHERH
+#define CBHEADERHASHERH
+
+//  Includes
+
+#include "CBTransaction.h"
+#include "CBMerkleNode.h"
+
+// Constants and Macros
+
+#define CB_HEADER_HASHER_LANES 8
+
+/**
+ @brief Structure for CBHeaderHasher objects. @see CBHeaderHasher.h
+ */
+typedef struct{
+	unsigned char header[80]; /**< The serialised header. The nonce is set by the hashing functions. */
+	CBSha256Context midstateCtx; /**< The SHA-256 context after the first 64 bytes of the header. */
+	uint32_t midstate[8]; /**< The SHA-256 state words after the first 64 bytes of the header. */
+	uint32_t target[8]; /**< The expanded target as little-endian 32-bit words with the most significant last. */
+} CBHeaderHasher;
+
+/**
+ @brief Initialises a CBHeaderHasher.
+ @param self The CBHeaderHasher to initialise.
+ @param header The 80 byte serialised block header.
+ */
+void CBInitHeaderHasher(CBHeaderHasher * self, unsigned char * header);
+
+//  Functions
+
+/**
+ @brief Hashes the header with a nonce. The nonce is set in the header.
+ @param self The CBHeaderHasher.
+ @param nonce The nonce.
+ @param hash A pointer to hold the 32 byte hash.
+ */
+void CBHeaderHasherHash(CBHeaderHasher * self, uint32_t nonce, unsigned char * hash);
+
+/**
+ @brief Hashes a number of serialised headers, CB_HEADER_HASHER_LANES at a time.
+ @param headers The 80 byte serialised headers, one after the other.
+ @param num The number of headers.
+ @param hashes A pointer to hold 32 bytes for each header.
+ */
+void CBHeaderHasherHashHeaders(unsigned char * headers, int num, unsigned char * hashes);
+
+/**
+ @brief Hashes the header with CB_HEADER_HASHER_LANES nonces at once.
+ @param self The CBHeaderHasher.
+ @param nonces CB_HEADER_HASHER_LANES nonces.
+ @param hashes A pointer to hold 32 bytes for each nonce.
+ */
+void CBHeaderHasherHashLanes(CBHeaderHasher * self, uint32_t * nonces, unsigned char * hashes);
+
+/**
+ @brief Calculates the final SHA-256 state words of the double SHA-256 header hash for CB_HEADER_HASHER_LANES nonces. The hash is the state words in big-endian.
+ @param self The CBHeaderHasher.
+ @param nonces CB_HEADER_HASHER_LANES nonces.
+ @param state The state words for each lane to be set.
+ */
+void CBHeaderHasherHashLanesState(CBHeaderHasher * self, uint32_t * nonces, uint32_t state[8][CB_HEADER_HASHER_LANES]);
+
+/**
+ @brief Determines if a hash meets the target of the header. Unlike CBValidateProofOfWork, this does not check the target against CB_MAX_TARGET so that easier test network targets can be used.
+ @param self The CBHeaderHasher.
+ @param hash The 32 byte hash.
+ @returns true if the hash is not above the target, false otherwise.
+ */
+bool CBHeaderHasherMeetsTarget(CBHeaderHasher * self, unsigned char * hash);
+
+/**
+ @brief Searches for a nonce which gives a hash meeting the target.
+ @param self The CBHeaderHasher.
+ @param nonce The nonce to start from. This is set to the nonce found or to the nonce after the last one tried.
+ @param count The number of nonces to try.
+ @param hash A pointer to hold the 32 byte hash when a nonce is found.
+ @returns true if a nonce was found, false otherwise.
+ */
+bool CBHeaderHasherSearch(CBHeaderHasher * self, uint32_t * nonce, uint32_t count, unsigned char * hash);
+
+/**
+ @brief Sets the extra nonce of a serialised coinbase transaction, then updates the merkle root of the header using the left branch of the merkle tree.
+ @param self The CBHeaderHasher.
+ @param coinbase The serialised coinbase transaction.
+ @param offset The offset of the extra nonce in the serialised coinbase transaction.
+ @param size The number of bytes of the extra nonce, upto 8.
+ @param extraNonce The extra nonce, which is written in little-endian.
+ @param branch The left branch of the merkle tree. @see CBMerkleTreeGetLeftBranch
+ @param branchNum The number of hashes in the branch.
+ */
+void CBHeaderHasherSetExtraNonce(CBHeaderHasher * self, CBTransaction * coinbase, int offset, int size, uint64_t extraNonce, unsigned char * branch, int branchNum);
+
+/**
+ @brief Sets the merkle root of the header and recalculates the midstate.
+ @param self The CBHeaderHasher.
+ @param merkleRoot The 32 byte merkle root.
+ */
+void CBHeaderHasherSetMerkleRoot(CBHeaderHasher * self, unsigned char * merkleRoot);
+
+/**
+ @brief Sets the time of the header. The time is in the last 16 bytes so the midstate is not affected.
+ @param self The CBHeaderHasher.
+ @param time The time to set.
+ */
+void CBHeaderHasherSetTime(CBHeaderHasher * self, uint32_t time);
+
+/**
+ @brief Does SHA-256 compression on CB_HEADER_HASHER_LANES blocks at once.
+ @param state The state words for each lane, to be updated.
+ @param block The 16 message words for each lane.
+ */
+void CBHeaderHasherTransformLanes(uint32_t state[8][CB_HEADER_HASHER_LANES], uint32_t block[16][CB_HEADER_HASHER_LANES]);
+
+#endif
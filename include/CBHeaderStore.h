@@ -0,0 +1,214 @@
+//
+//  CBHeaderStore.h
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+/**
+ @file
+ @brief An append-only store of the headers of a block chain, memory mapped so that it can be reopened without reading or hashing the headers again. Each header has a fixed size record with its hash, height, the cumulative work of the chain upto it and status flags, so the record of a height is found directly. A hash table of heights, also memory mapped, finds the height of a hash. The number of records is synced to disk after the records themselves, and records after it are only accepted on opening when their checksum and linkage are correct, so a partly written tail is dropped after a crash. The records are in the byte order of the machine.
+ */
+
+#ifndef CBHEADERSTOREH
+#define CBHEADERSTOREH
+
+//  Includes
+
+#include "CBHeaderArray.h"
+#include "CBChainDescriptor.h"
+
+// Constants and Macros
+
+#define CB_HEADER_STORE_MAGIC 0x53484243 // "CBHS" in little-endian
+#define CB_HEADER_STORE_INDEX_MAGIC 0x49484243 // "CBHI" in little-endian
+#define CB_HEADER_STORE_GROW 8192 // The number of records to extend the file by.
+#define CB_HEADER_STORE_MIN_TABLE 65536 // The minimum number of hash table slots.
+#define CBHeaderStoreGetRecord(self, height) ((self)->records + (height))
+
+/**
+ @brief The status flags of a header in a CBHeaderStore.
+ */
+typedef enum{
+	CB_HEADER_STORE_VALID = 1, /**< The header has been validated. */
+	CB_HEADER_STORE_HAVE_DATA = 2, /**< The block data is stored. */
+	CB_HEADER_STORE_FULLY_VALID = 4, /**< The block has been fully validated. */
+	CB_HEADER_STORE_INVALID = 8, /**< The block has been found to be invalid. */
+} CBHeaderStoreFlags;
+
+/**
+ @brief A record of a header in a CBHeaderStore. The first record in the file holds a CBHeaderStoreFileHeader instead.
+ */
+typedef struct{
+	unsigned char header[80]; /**< The serialised header. */
+	unsigned char hash[32];
+	unsigned char work[32]; /**< The cumulative work of the chain upto and including this header, as a 256-bit little-endian integer. */
+	uint32_t height;
+	uint32_t flags; /**< @see CBHeaderStoreFlags */
+	uint32_t checksum; /**< The first four bytes of the SHA-256 hash of the record before the checksum. */
+	uint32_t reserved;
+} CBHeaderStoreRecord;
+
+/**
+ @brief The start of the header record file.
+ */
+typedef struct{
+	uint32_t magic;
+	uint32_t recordSize;
+	uint32_t syncedNum; /**< The number of records which were written to disk before this was. */
+} CBHeaderStoreFileHeader;
+
+/**
+ @brief The start of the hash table file, which is followed by the slots. A slot has the height plus one of a header or zero when empty.
+ */
+typedef struct{
+	uint32_t magic;
+	uint32_t tableSize; /**< The number of slots, which is a power of two. */
+	uint32_t indexedNum; /**< The number of records which were in the table when it was last synced. */
+	uint32_t usedSlots; /**< The number of slots which are not empty, including slots of removed headers. */
+} CBHeaderStoreIndexHeader;
+
+/**
+ @brief Structure for CBHeaderStore objects. @see CBHeaderStore.h
+ */
+typedef struct{
+	CBDepObject recordFile;
+	CBDepObject indexFile;
+	CBHeaderStoreFileHeader * fileHeader; /**< The start of the mapped record file. */
+	CBHeaderStoreRecord * records; /**< The mapped records, where the index is the height. */
+	uint32_t headerNum; /**< The number of headers. */
+	uint32_t capacity; /**< The number of records the file has space for. */
+	CBHeaderStoreIndexHeader * indexHeader; /**< The start of the mapped hash table file. */
+	uint32_t * table; /**< The mapped hash table slots. */
+} CBHeaderStore;
+
+/**
+ @brief Initialises a CBHeaderStore by opening or creating the files in a directory.
+ @param self The CBHeaderStore to initialise.
+ @param dataDir The directory for the files, which should exist.
+ @returns true on success, false on failure.
+ */
+bool CBInitHeaderStore(CBHeaderStore * self, char * dataDir);
+
+/**
+ @brief Syncs and closes the files of a CBHeaderStore.
+ @param self The CBHeaderStore to destroy.
+ */
+void CBDestroyHeaderStore(CBHeaderStore * self);
+
+//  Functions
+
+/**
+ @brief Adds a header to the top of the chain.
+ @param self The CBHeaderStore.
+ @param header The 80 byte serialised header.
+ @param hash The 32 byte hash of the header or NULL to calculate it.
+ @param flags The status flags of the header.
+ @returns true on success, false if the header does not follow the last header, has a target which cannot be valid, or the files could not be extended or indexed, in which case the header is not added.
+ */
+bool CBHeaderStoreAppend(CBHeaderStore * self, unsigned char * header, unsigned char * hash, uint32_t flags);
+
+/**
+ @brief Adds headers of a CBHeaderArray to the top of the chain, using the hashes in the array.
+ @param self The CBHeaderStore.
+ @param array The CBHeaderArray.
+ @param start The index of the first header to add.
+ @param flags The status flags of the headers.
+ @returns The index of the first header which could not be added, or headerNum of the array if all were added.
+ */
+int CBHeaderStoreAppendArray(CBHeaderStore * self, CBHeaderArray * array, int start, uint32_t flags);
+
+/**
+ @brief Adds the header of a serialised CBBlock to the top of the chain.
+ @param self The CBHeaderStore.
+ @param block The serialised CBBlock.
+ @param flags The status flags of the header.
+ @returns true on success, false on failure.
+ */
+bool CBHeaderStoreAppendBlock(CBHeaderStore * self, CBBlock * block, uint32_t flags);
+
+/**
+ @brief Calculates the checksum of a record.
+ @param record The record.
+ @returns The checksum.
+ */
+uint32_t CBHeaderStoreCalculateChecksum(CBHeaderStoreRecord * record);
+
+/**
+ @brief Finds the height of a header in the hash table, or in the records when the table could not be made.
+ @param self The CBHeaderStore.
+ @param hash The 32 byte hash of the header.
+ @param height Set to the height of the header when found.
+ @returns true if the header was found, false otherwise.
+ */
+bool CBHeaderStoreFind(CBHeaderStore * self, unsigned char * hash, uint32_t * height);
+
+/**
+ @brief Gets a new CBBlock with the header at a height.
+ @param self The CBHeaderStore.
+ @param height The height of the header.
+ @returns A new deserialised CBBlock with no transactions.
+ */
+CBBlock * CBHeaderStoreGetBlock(CBHeaderStore * self, uint32_t height);
+
+/**
+ @brief Creates a CBChainDescriptor from the top of the chain, with the last ten hashes and then hashes with a gap which doubles down to the genesis block. The hashes are found by height, so only O(log n) records are read.
+ @param self The CBHeaderStore.
+ @returns A new CBChainDescriptor.
+ */
+CBChainDescriptor * CBHeaderStoreGetChainDescriptor(CBHeaderStore * self);
+
+/**
+ @brief Adds the height of a record to the hash table, if it is not there already, growing the table when needed and making it when it could not be made before.
+ @param self The CBHeaderStore.
+ @param height The height of the record.
+ @returns true on success, false if the table could not be grown.
+ */
+bool CBHeaderStoreIndex(CBHeaderStore * self, uint32_t height);
+
+/**
+ @brief Clears the hash table and adds all of the records to it, at a size suitable for the number of records.
+ @param self The CBHeaderStore.
+ @returns true on success, false on failure.
+ */
+bool CBHeaderStoreRebuildIndex(CBHeaderStore * self);
+
+/**
+ @brief Determines if a record was completely written with the correct height and linkage to the record before it.
+ @param self The CBHeaderStore.
+ @param height The height of the record.
+ @returns true if the record is valid, false otherwise.
+ */
+bool CBHeaderStoreRecordIsValid(CBHeaderStore * self, uint32_t height);
+
+/**
+ @brief Sets the status flags of a header.
+ @param self The CBHeaderStore.
+ @param height The height of the header.
+ @param flags The new status flags.
+ */
+void CBHeaderStoreSetFlags(CBHeaderStore * self, uint32_t height, uint32_t flags);
+
+/**
+ @brief Writes the records and the hash table to disk, and then the number of records which have been written.
+ @param self The CBHeaderStore.
+ @returns true on success, false on failure.
+ */
+bool CBHeaderStoreSync(CBHeaderStore * self);
+
+/**
+ @brief Removes headers from the top of the chain, such as for a reorganisation. This is synced to disk immediately so that the headers are not recovered after a crash.
+ @param self The CBHeaderStore.
+ @param headerNum The new number of headers.
+ @returns true on success, false on failure.
+ */
+bool CBHeaderStoreTruncate(CBHeaderStore * self, uint32_t headerNum);
+
+#endif
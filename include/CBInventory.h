@@ -27,6 +27,7 @@
 // Constants and Macros
 
 #define CBGetInventory(x) ((CBInventory *)x)
+#define CB_INVENTORY_MAX_ITEMS 50000 // The most items allowed in an inventory message.
 
 /**
  @brief Structure for CBInventory objects. @see CBInventory.h
@@ -48,6 +48,14 @@ CBMerkleNode * CBBuildMerkleTree(CBByteArray ** hashes, int numHashes);
  */
 void CBFreeMerkleTree(CBMerkleNode * root);
 
+/**
+ @brief Gets the merkle branch of the first (coinbase) hash in a tree, which is the right sibling at each level along the far left of the tree. This can be used with CBMerkleRootFromLeftBranch to recalculate the root when only the first hash changes.
+ @param root The merkle tree root node.
+ @param branch A pointer to hold the branch hashes from the bottom of the tree upwards. This needs 32 bytes for each level below the root.
+ @returns The number of hashes in the branch. For a tree of a single hash this is zero, as the root of a single hash is the hash itself.
+ */
+int CBMerkleTreeGetLeftBranch(CBMerkleNode * root, unsigned char * branch);
+
 /**
  @brief Gets a list of hashes for a level in a merkle tree. If the merkle tree's deepest level is smaller than specified by "level", the lowest level in the tree is returned.
  @param root The merkle tree root node.
@@ -56,4 +64,13 @@ void CBFreeMerkleTree(CBMerkleNode * root);
  */
 CBMerkleNode * CBMerkleTreeGetLevel(CBMerkleNode * root, int level);
 
+/**
+ @brief Calculates a merkle root from the first hash and its left branch.
+ @param hash The first hash in the tree.
+ @param branch The branch from CBMerkleTreeGetLeftBranch.
+ @param branchNum The number of hashes in the branch.
+ @param root A pointer to hold the 32 byte root.
+ */
+void CBMerkleRootFromLeftBranch(unsigned char * hash, unsigned char * branch, int branchNum, unsigned char * root);
+
 #endif
@@ -61,12 +61,17 @@ typedef enum{
  @brief Structure for CBMessage objects. @see CBMessage.h
  */
 typedef struct CBMessage{
-	CBObjectMutex base; /**< CBObjectMutex base structure */
+	CBObject base; /**< CBObject base structure */
 	CBMessageType type; /**< The type of the message */
 	unsigned char * altText; /**< For an alternative message: This is the type text. */
 	CBByteArray * bytes; /**< Raw message data minus the message header. When serialising this should be assigned to a CBByteArray large enough to hold the serialised data. */
 	unsigned char checksum[4]; /**< The message checksum. When sending messages using a CBNetworkCommunicator, this is calculated for you. */
 	bool serialised; /**< True if this object has been serialised. If an object as already been serialised it is not serialised by parent objects. For instance when serialising a block, the transactions are not serialised if they have been already. However objects can be explicitly reserialised */
+	bool fileBody; /**< True if the payload is in a file rather than "bytes", so that a CBNetworkCommunicator sends it with CBSocketSendFile. */
+	CBDepObject file; /**< For a file-backed payload: The file, opened with CBFileOpen or CBFileOpenReadOnly, which must stay open until the message is sent. */
+	bool closeFile; /**< For a file-backed payload: If true the file belongs to the message and is closed when the message is freed. */
+	uint64_t fileOffset; /**< For a file-backed payload: The position of the payload in the file. */
+	uint32_t fileLength; /**< For a file-backed payload: The length of the payload. */
 } CBMessage;
 
 /**
@@ -76,6 +81,17 @@ typedef struct CBMessage{
  */
 CBMessage * CBNewMessageByObject(void);
 
+/**
+ @brief Creates a new CBMessage object with a payload in a file, which is sent without copying it into memory.
+ @param type The type of the message.
+ @param file The file with the payload, opened with CBFileOpen.
+ @param offset The position of the payload in the file.
+ @param length The length of the payload.
+ @param checksum The 4 byte checksum of the payload, which is not calculated when sending.
+ @returns A new CBMessage object.
+ */
+CBMessage * CBNewMessageByFile(CBMessageType type, CBDepObject file, uint64_t offset, uint32_t length, unsigned char * checksum);
+
 /**
  @brief Initialises a CBMessage object
  @param self The CBMessage object to initialise
@@ -90,6 +106,17 @@ void CBInitMessageByObject(CBMessage * self);
  */
 void CBInitMessageByData(CBMessage * self, CBByteArray * data);
 
+/**
+ @brief Initialises a CBMessage object with a payload in a file.
+ @param self The CBMessage object to initialise
+ @param type The type of the message.
+ @param file The file with the payload, opened with CBFileOpen.
+ @param offset The position of the payload in the file.
+ @param length The length of the payload.
+ @param checksum The 4 byte checksum of the payload.
+ */
+void CBInitMessageByFile(CBMessage * self, CBMessageType type, CBDepObject file, uint64_t offset, uint32_t length, unsigned char * checksum);
+
 /**
  @brief Release and free all of the objects stored by the CBMessage object.
  @param self The CBMessage object to free.
@@ -32,6 +32,7 @@
 
 #define CBGetNetworkAddress(x) ((CBNetworkAddress *)x)
 #define CB_NETWORK_ADDR_STR_SIZE 48
+#define CB_NETWORK_ADDRESS_DEFAULT_LATENCY 500 // The connection time in milliseconds assumed for addresses which have not been connected to.
 
 typedef enum{
 	CB_SERVICE_FULL_BLOCKS = 1, /**< Service for full blocks. Node maintains the entire blockchain. */
@@ -56,6 +57,10 @@ typedef struct{
 	bool isPublic; /**< If true the address is public and should be relayed. If true, upon a lost or failed connection, return to addresses list. If false the address is private and should be forgotten when connections are closed and never relayed. Addresses are made public when we receive them in an address broadcast. */
 	int bucket; /**< The bucket number for this address. */
 	bool bucketSet; /**< True if the bucket has been previously set */
+	int connectLatency; /**< The smoothed time in milliseconds taken to connect to this address, or 0 if unknown. Not serialised. */
+	uint16_t connectAttempts; /**< Connections to this address which succeeded or failed. */
+	uint16_t connectSuccesses;
+	long long int lastConnectAttempt; /**< The time in milliseconds a connection to this address was last attempted, or 0 if never. */
 } CBNetworkAddress;
 
 /**
@@ -118,6 +123,14 @@ void CBFreeNetworkAddress(void * self);
  */
 int CBNetworkAddressDeserialise(CBNetworkAddress * self, bool timestamp);
 
+/**
+ @brief Compares addresses by CBNetworkAddressGetConnectScore for qsort, so that the best addresses to connect to are first.
+ @param addr1 A pointer to the first CBNetworkAddress pointer.
+ @param addr2 A pointer to the second CBNetworkAddress pointer.
+ @returns A negative number if the first address is better, a positive number if the second is better, else 0.
+ */
+int CBNetworkAddressCompareConnectScore(const void * addr1, const void * addr2);
+
 /**
  @brief Compares two network addresses
  @param self The CBNetworkAddress object
@@ -134,6 +147,33 @@ bool CBNetworkAddressEquals(CBNetworkAddress * self, CBNetworkAddress * addr);
  */
 long long int CBNetworkAddressGetGroup(CBNetworkAddress * addr);
 
+/**
+ @brief Gets the expected time to get a connection to an address from past connections, which is the time to connect divided by the chance of success. One success and one failure are assumed before any connections are made.
+ @param self The CBNetworkAddress object
+ @returns The score, lower being better.
+ */
+int64_t CBNetworkAddressGetConnectScore(CBNetworkAddress * self);
+
+/**
+ @brief Sets the connection statistics of a new address.
+ @param self The CBNetworkAddress object
+ */
+void CBNetworkAddressInitConnectStats(CBNetworkAddress * self);
+
+/**
+ @brief Records the result of a connection to an address.
+ @param self The CBNetworkAddress object
+ @param success True if the connection was made, false if it failed.
+ */
+void CBNetworkAddressRecordConnect(CBNetworkAddress * self, bool success);
+
+/**
+ @brief Records the time taken to connect to an address.
+ @param self The CBNetworkAddress object
+ @param latency The time taken in milliseconds.
+ */
+void CBNetworkAddressRecordConnectLatency(CBNetworkAddress * self, int latency);
+
 /**
  @brief Serialises a CBNetworkAddress to the byte data.
  @param self The CBNetworkAddress object
@@ -39,6 +39,14 @@
 
 #define CBGetNetworkCommunicator(x) ((CBNetworkCommunicator *)x)
 #define CB_SEED_DOMAINS (char *[]){"seed.bitcoin.sipa.be", "dnsseed.bluematt.me", "dnsseed.bitcoin.dashjr.org", "bitseed.xf2.org"}
+#define CB_NETWORK_COMMUNICATOR_TIMEOUT_TICK 100 // The length in milliseconds of the ticks of the timing wheel for the timeouts of peers.
+#define CB_NETWORK_COMMUNICATOR_MAX_CONNECTING 32 // The most connections attempted at once.
+#define CB_NETWORK_COMMUNICATOR_RACE_DELAY 250 // Milliseconds a connection is attempted before another is raced against it.
+#define CB_NETWORK_COMMUNICATOR_CANDIDATES 4 // The number of addresses ranked for each connection needed.
+#define CB_NETWORK_COMMUNICATOR_RETRY_INTERVAL 10000 // Milliseconds before a connection to an address is attempted again.
+#define CB_NETWORK_COMMUNICATOR_TRICKLE_INTERVAL 5000 // The default mean time in milliseconds between announcements of transactions to a peer.
+#define CB_NETWORK_COMMUNICATOR_KNOWN_INVENTORY 50000 // The default number of the most recent inventory hashes remembered for each peer.
+#define CB_NETWORK_COMMUNICATOR_KNOWN_INVENTORY_FALSE_POSITIVE_RATE 0.000001 // The default chance that an inventory item is taken to be known by a peer when it is not.
 #define CB_NULL_ADDRESS (unsigned char []){0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0xff, 0xff, 0x0, 0x0, 0x0, 0x0}
 
 typedef enum{
@@ -59,6 +67,8 @@ typedef enum{
 	CB_NETWORK_COMMUNICATOR_DETERMINE_IP6 = 16, /**< Determine IPv6 by looking for the receiving IPv6 in version messages. */
 	CB_NETWORK_COMMUNICATOR_BOOTSTRAP = 32, /**< Discover nodes through DNS or use fallback nodes if necessary. Only relevant if  CB_NETWORK_COMMUNICATOR_INCOMING_ONLY is not set. */
 	CB_NETWORK_COMMUNICATOR_INCOMING_ONLY = 64, /**< Only accept incoming connections. Do not initiate any connections. */
+	CB_NETWORK_COMMUNICATOR_FLAT_HEADERS = 128, /**< Deserialise "headers" messages into a CBHeaderArray rather than a CBBlock for each header. @see CBBlockHeadersDeserialiseFlat */
+	CB_NETWORK_COMMUNICATOR_BATCH_RECEIVE = 256, /**< Read from peers into a buffer of CB_RECEIVE_BUFFER_SIZE and process every complete message in it, rather than reading each message header and payload separately. Payloads which do not fit in the buffer are read into the message. */
 }CBNetworkCommunicatorFlags;
 
 /*
@@ -102,6 +112,7 @@ typedef struct{
 	bool (*acceptingType)(CBNetworkCommunicator * self, CBPeer * peer, CBMessageType type); /**< Return true if the network communicator should accept the message type, else false. */
 	CBOnMessageReceivedAction (*onMessageReceived)(CBNetworkCommunicator * self, CBPeer * peer, CBMessage * message); /**< The callback for when a message has been received from a peer. The first argument is the CBNetworkCommunicator responsible for receiving the message. The second argument is the CBNetworkAddress peer the message was received from. Return the action that should be done after returning. Access the message by the "receive" feild in the CBNetworkAddress peer. Lookup the type of the message and then cast and/or handle the message approriately. The alternative message bytes can be found in the peer's "alternativeTypeBytes" field. Do not delay the thread for very long. */
 	void (*onNetworkError)(CBNetworkCommunicator * self, CBErrorReason reason); /**< Called when both IPv4 and IPv6 fails. Has an argument for the network communicator. */
+	void (*onSendQueueDrained)(CBNetworkCommunicator * self, CBPeer * peer); /**< Called when the send queue of a peer which refused a message falls below CB_SEND_QUEUE_LOW_WATERMARK, so that the refused messages can be sent again. May be NULL. */
 } CBNetworkCommunicatorCallbacks;
 
 /**
@@ -144,6 +155,25 @@ struct CBNetworkCommunicator {
 	CBDepObject retryConnectionsTimer;
 	bool addedHardcodedSeeds;
 	bool tryConnectionTimerStarted;
+	CBTimerWheel timeOuts; /**< The timeouts of the receive and send events of peers, which are restarted with nearly every message. Connection timeouts are given to the socket events. */
+	CBDepObject timeOutTimer; /**< Periodic timer which advances timeOuts. */
+	bool timeOutTimerStarted;
+	int dnsLookups; /**< The number of seed domains being resolved. */
+	int raceConnections; /**< The number of connections which can be attempted beyond maxConnections, to race against attempts taking longer than CB_NETWORK_COMMUNICATOR_RACE_DELAY. The slowest attempts are cancelled when enough connections succeed. The default is 2. */
+	CBPeer * connecting[CB_NETWORK_COMMUNICATOR_MAX_CONNECTING]; /**< Peers being connected to, in the order the attempts started. */
+	int connectingNum;
+	CBDepObject raceTimer; /**< Periodic timer which races connections while there are attempts. */
+	bool raceTimerStarted;
+	long long int connectivityStart; /**< The time connections were tried with no peers, to log the time taken to reach maxConnections, or 0. */
+	int trickleInterval; /**< The mean time in milliseconds announcements of transactions wait for, so that they are sent to each peer in batches. Each batch waits for a random time up to twice this. The default is CB_NETWORK_COMMUNICATOR_TRICKLE_INTERVAL. */
+	uint32_t knownInventoryItems; /**< The number of the most recent inventory hashes remembered as known by each peer, so that they are not announced to the peer. Memory for this is allocated when a connection works. The default is CB_NETWORK_COMMUNICATOR_KNOWN_INVENTORY. */
+	double knownInventoryFalsePositiveRate; /**< The chance that an inventory item is taken to be known by a peer when it is not, and so is not announced to the peer. Lower rates use more memory. The default is CB_NETWORK_COMMUNICATOR_KNOWN_INVENTORY_FALSE_POSITIVE_RATE. */
+	uint64_t announcedItems; /**< The number of inventory items announced to peers, including blocks. */
+	uint64_t announceDuplicates; /**< The number of inventory items not announced because the peer knew about them. */
+	uint64_t announceBatches; /**< The number of inv messages sent with transactions which waited for the trickle timer. */
+	int announceBatchMax; /**< The most items in one batch. */
+	int announceLatency; /**< The smoothed time in milliseconds from the first item being added to a batch to the batch being queued. */
+	int announceLatencyMax; /**< The longest time in milliseconds from the first item being added to a batch to the batch being queued. */
 	CBNetworkCommunicatorCallbacks callbacks;
 };
 
@@ -173,6 +203,24 @@ void CBFreeNetworkCommunicator(void * self);
 
 //  Functions
 
+/**
+ @brief Announces an inventory item to a peer unless the peer is known to have it. Blocks are announced straight away. Transactions are added to the announcements waiting for the peer, which are sent as one inv message after a random time (see trickleInterval), or when there are CB_INVENTORY_MAX_ITEMS of them.
+ @param self The CBNetworkCommunicator object.
+ @param peer The peer to announce the item to.
+ @param type The type of the item.
+ @param hash The hash of the item.
+ @returns true if the item is being announced, false if the peer knows about the item or the item could not be announced.
+ */
+bool CBNetworkCommunicatorAnnounce(CBNetworkCommunicator * self, CBPeer * peer, CBInventoryItemType type, CBByteArray * hash);
+/**
+ @brief Announces an inventory item to every connected peer which is not known to have it, with CBNetworkCommunicatorAnnounce.
+ @param self The CBNetworkCommunicator object.
+ @param type The type of the item.
+ @param hash The hash of the item.
+ @param except A peer not to announce the item to, such as the peer it came from, or NULL.
+ @returns The number of peers the item is being announced to.
+ */
+int CBNetworkCommunicatorAnnounceToAll(CBNetworkCommunicator * self, CBInventoryItemType type, CBByteArray * hash, CBPeer * except);
 /**
  @brief Accepts an incomming connection.
  @param vself The CBNetworkCommunicator object.
@@ -188,6 +236,19 @@ void CBNetworkCommunicatorAcceptConnection(void * vself, CBDepObject socket);
  */
 bool CBNetworkCommunicatorCanConnect(CBNetworkCommunicator * self, CBNetworkAddress * addr);
 
+/**
+ @brief Cancels a connection attempt which is no longer needed. The address is returned to the address manager.
+ @param self The CBNetworkCommunicator object.
+ @param peer The peer being connected to.
+ */
+void CBNetworkCommunicatorCancelConnect(CBNetworkCommunicator * self, CBPeer * peer);
+
+/**
+ @brief Advances the timing wheel of the peer timeouts. Called by the timeout timer.
+ @param vself The CBNetworkCommunicator object.
+ */
+void CBNetworkCommunicatorCheckTimeOuts(void * vself);
+
 /**
  @brief Connects to a peer. This peer will be added to the peer list if it connects correctly.
  @param self The CBNetworkCommunicator object.
@@ -195,6 +256,14 @@ bool CBNetworkCommunicatorCanConnect(CBNetworkCommunicator * self, CBNetworkAddr
  @returns CB_CONNECT_OK if successful. CB_CONNECT_NO_SUPPORT if the IP version is not supported. CB_CONNECT_BAD if the connection failed and the address will be penalised. CB_CONNECT_FAIL if the connection failed but the address will not be penalised.
  */
 CBConnectReturn CBNetworkCommunicatorConnect(CBNetworkCommunicator * self, CBPeer * peer);
+
+/**
+ @brief Attempts connections to the best of the stored addresses, ranked by past connections. Addresses attempted within CB_NETWORK_COMMUNICATOR_RETRY_INTERVAL are skipped.
+ @param self The CBNetworkCommunicator object.
+ @param num The number of connections to attempt.
+ @returns The number of connections being attempted.
+ */
+int CBNetworkCommunicatorConnectCandidates(CBNetworkCommunicator * self, int num);
 void CBNetworkCommunicatorDetermineIP(CBNetworkCommunicator * self, CBNetworkAddress * addr, bool ipv4);
 
 /**
@@ -212,7 +281,20 @@ void CBNetworkCommunicatorDidConnect(void * vself, void * vpeer);
  @param stopping If true, do not call "onNetworkError" or remove the peer from the address manager because the CBNetworkCommunicator is stopping.
  */
 void CBNetworkCommunicatorDisconnect(CBNetworkCommunicator * self, CBPeer * peer, int penalty, bool stopping);
+/**
+ @brief Sends the announcements waiting for a peer as an inv message. If the message is refused, the announcements wait for another random time.
+ @param self The CBNetworkCommunicator object.
+ @param peer The peer.
+ @returns true if the announcements were queued or there were none, false otherwise.
+ */
+bool CBNetworkCommunicatorFlushAnnouncements(CBNetworkCommunicator * self, CBPeer * peer);
 CBNetworkAddress * CBNetworkCommunicatorGetOurMainAddress(CBNetworkCommunicator * self, CBIPType recipientType);
+/**
+ @brief Gets the priority a message type is sent with.
+ @param type The type of the message.
+ @returns The CBSendPriority for the message type.
+ */
+CBSendPriority CBNetworkCommunicatorGetSendPriority(CBMessageType type);
 
 /**
  @brief Gets a new version message for this.
@@ -228,6 +310,12 @@ CBVersion * CBNetworkCommunicatorGetVersion(CBNetworkCommunicator * self, CBNetw
  @returns true if reachable, false if not reachable.
  */
 bool CBNetworkCommunicatorIsReachable(CBNetworkCommunicator * self, CBIPType type);
+/**
+ @brief Creates the filter of the inventory known by a peer, with knownInventoryItems and knownInventoryFalsePositiveRate, when the connection to the peer works. Without the filter, inventory is announced to the peer even if it is known.
+ @param self The CBNetworkCommunicator object.
+ @param peer The peer.
+ */
+void CBNetworkCommunicatorNewKnownInventory(CBNetworkCommunicator * self, CBPeer * peer);
 void CBNetworkCommunicatorNoPeers(CBNetworkCommunicator * self);
 
 /**
@@ -237,6 +325,13 @@ void CBNetworkCommunicatorNoPeers(CBNetworkCommunicator * self);
  */
 void CBNetworkCommunicatorOnCanReceive(void * vself, void * vpeer);
 
+/**
+ @brief Called when a peer socket is ready for reading with CB_NETWORK_COMMUNICATOR_BATCH_RECEIVE, when a payload is not being read into a message. Reads as much as fits into the receive buffer of the peer and processes the complete messages in it.
+ @param self The CBNetworkCommunicator object.
+ @param peer The CBPeer with data to read.
+ */
+void CBNetworkCommunicatorOnCanReceiveBatch(CBNetworkCommunicator * self, CBPeer * peer);
+
 /**
  @brief Called when a peer socket is ready for writing.
  @param vself The CBNetworkCommunicator object.
@@ -244,6 +339,14 @@ void CBNetworkCommunicatorOnCanReceive(void * vself, void * vpeer);
  */
 void CBNetworkCommunicatorOnCanSend(void * vself, void * vpeer);
 
+/**
+ @brief Called on the event loop when a seed domain has been resolved, after its addresses have been added. Tries connections to the addresses.
+ @param self The CBNetworkCommunicator object.
+ @param domain The domain.
+ @param addrNum The number of addresses found.
+ */
+void CBNetworkCommunicatorOnDNSLoaded(CBNetworkCommunicator * self, char * domain, int addrNum);
+
 /**
  @brief Called when a header is received.
  @param self The CBNetworkCommunicator object.
@@ -272,6 +375,13 @@ void CBNetworkCommunicatorOnMessageReceived(CBNetworkCommunicator * self, CBPeer
  */
 void CBNetworkCommunicatorOnTimeOut(void * vself, void * vpeer, CBTimeOutType type);
 
+/**
+ @brief Called when an entry of a peer expires in the timing wheel. The receive or send timeouts are given to CBNetworkCommunicatorOnTimeOut and the trickle timer sends the waiting announcements.
+ @param vself The CBNetworkCommunicator object.
+ @param entry The receiveTimer, sendTimer or trickleTimer of the peer.
+ */
+void CBNetworkCommunicatorOnPeerTimeOut(void * vself, CBTimerWheelEntry * entry);
+
 /**
  @brief Processes a new received message for auto discovery.
  @param self The CBNetworkCommunicator object.
@@ -295,15 +405,29 @@ CBOnMessageReceivedAction CBNetworkCommunicatorProcessMessageAutoHandshake(CBNet
  @returns true if peer should be disconnected, false otherwise.
  */
 CBOnMessageReceivedAction CBNetworkCommunicatorProcessMessageAutoPingPong(CBNetworkCommunicator * self, CBPeer * peer);
+
+/**
+ @brief Attempts more connections when attempts are taking longer than CB_NETWORK_COMMUNICATOR_RACE_DELAY, up to raceConnections beyond maxConnections. Called by the race timer.
+ @param vself The CBNetworkCommunicator object.
+ */
+void CBNetworkCommunicatorRaceConnections(void * vself);
+
+/**
+ @brief Removes a peer from the connection attempts, stopping the race timer when there are no more.
+ @param self The CBNetworkCommunicator object.
+ @param peer The peer.
+ */
+void CBNetworkCommunicatorRemoveConnecting(CBNetworkCommunicator * self, CBPeer * peer);
 void CBNetworkCommunicatorRetryConnections(CBNetworkCommunicator * self);
 void CBNetworkCommunicatorRetryConnectionsProcess(void * vself);
 
 /**
- @brief Sends a message by placing it on the send queue. Will serialise standard messages (unless serialised already) but not alternative messages or alert messages. This function is mutex protected.
+ @brief Sends a message by placing it on the send queue for its priority (see CBSendPriority). Will serialise standard messages (unless serialised already) but not alternative messages or alert messages. Messages with a file-backed payload (see CBNewMessageByFile) are sent with CBSocketSendFile, so the payload is not copied into memory. When the message would take the bytes queued for the peer over CB_SEND_QUEUE_MAX_BYTES, it is refused unless it is a control message or nothing is queued, and the onSendQueueDrained callback is called when the queue has drained below CB_SEND_QUEUE_LOW_WATERMARK. This function is mutex protected.
  @param self The CBNetworkCommunicator object.
  @param peer The CBPeer.
  @param message The CBMessage to send.
  @param callback The callback for when the send has complete. If NULL, no call is made.
+ @returns true if the message was queued, false if it was refused or there was an error.
  */
 bool CBNetworkCommunicatorSendMessage(CBNetworkCommunicator * self, CBPeer * peer, CBMessage * message, void (*callback)(void *, void *));
 
@@ -350,6 +474,28 @@ void CBNetworkCommunicatorSetOurIPv6(CBNetworkCommunicator * self, CBNetworkAddr
  */
 void CBNetworkCommunicatorSetReachability(CBNetworkCommunicator * self, CBIPType type, bool reachable);
 
+/**
+ @brief Sets the timeout of the receive event of a peer, which restarts whenever data is received.
+ @param self The CBNetworkCommunicator object.
+ @param peer The peer.
+ @param timeOut The timeout in milliseconds or zero for none.
+ */
+void CBNetworkCommunicatorSetReceiveTimeOut(CBNetworkCommunicator * self, CBPeer * peer, int timeOut);
+
+/**
+ @brief Sets or restarts a timeout of a peer in the timing wheel, starting the timer for the wheel if it has not been started.
+ @param self The CBNetworkCommunicator object.
+ @param entry The receiveTimer or sendTimer of the peer.
+ @param timeOut The timeout in milliseconds or zero for none.
+ */
+void CBNetworkCommunicatorSetTimeOut(CBNetworkCommunicator * self, CBTimerWheelEntry * entry, int timeOut);
+/**
+ @brief Sets the trickle timer of a peer to a random time up to twice trickleInterval.
+ @param self The CBNetworkCommunicator object.
+ @param peer The peer.
+ */
+void CBNetworkCommunicatorSetTrickleTimer(CBNetworkCommunicator * self, CBPeer * peer);
+
 /**
  @brief Sets the user agent.
  @param self The CBNetworkCommunicator object.
@@ -388,7 +534,19 @@ void CBNetworkCommunicatorStopListening(CBNetworkCommunicator * self);
 void CBNetworkCommunicatorStopPings(CBNetworkCommunicator * self);
 
 /**
- @brief Looks at the stored addresses and tries to connect to addresses up to the maximum number of allowed connections or as many as there are in the case the maximum number of connections is greater than the number of addresses, plus connected peers.
+ @brief Stops the race timer.
+ @param self The CBNetworkCommunicator object.
+ */
+void CBNetworkCommunicatorStopRacing(CBNetworkCommunicator * self);
+
+/**
+ @brief Stops the timer of the peer timeouts, when there are no peers with timeouts.
+ @param self The CBNetworkCommunicator object.
+ */
+void CBNetworkCommunicatorStopTimeOuts(CBNetworkCommunicator * self);
+
+/**
+ @brief Looks at the stored addresses and tries to connect to addresses up to the maximum number of allowed connections or as many as there are in the case the maximum number of connections is greater than the number of addresses, plus connected peers. The addresses are chosen with CBNetworkCommunicatorConnectCandidates.
  @param self The CBNetworkCommunicator object.
  */
 void CBNetworkCommunicatorTryConnections(CBNetworkCommunicator * self, bool dns);
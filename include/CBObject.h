@@ -36,25 +36,31 @@
 
 #define CBGetObject(x) ((CBObject *)x)
 
+/**
+ @brief How the memory of an object was allocated. @see CBPool.h
+ */
+typedef enum{
+	CB_ALLOCATION_MALLOC,
+	CB_ALLOCATION_POOL,
+	CB_ALLOCATION_ARENA,
+} CBAllocation;
+
 /**
  @brief Base structure for all other structures. @see CBObject.h
  */
 typedef struct{
 	void (*free)(void *); /**< Pointer to the function to free the object. */
 	int references; /**< Keeps a count of the references to an object for memory management. */
-	bool usesMutex;
+	bool threadSafe; /**< If true the reference count is changed with atomic operations so that the object can be retained and released by different threads. */
+	unsigned char allocation; /**< The CBAllocation of an object from CBAllocObject. This is not set by CBInitObject and is only used by types which free their memory with CBFreeObjectMemory. */
 } CBObject;
 
-typedef struct{
-	CBObject base;
-	CBDepObject refMutex;
-} CBObjectMutex;
-
 /**
  @brief Initialises a CBObject
  @param self The CBObject to initialise
+ @param threadSafe If true the object can be retained and released by different threads at once.
  */
-void CBInitObject(CBObject * self, bool useMutex);
+void CBInitObject(CBObject * self, bool threadSafe);
 
 //  Functions
 
@@ -26,11 +26,15 @@
 #include "CBVersion.h"
 #include "CBInventory.h"
 #include "CBAssociativeArray.h"
+#include "CBTimerWheel.h"
+#include "CBRollingBloomFilter.h"
 
 // Constants and Macros
 
 #define CB_NODE_MAX_ADDRESSES_24_HOURS 100 // Maximum number of addresses accepted by a peer in 24 hours. ??? Not implemented
-#define CB_SEND_QUEUE_MAX_SIZE 10 // Sent no more than 10 messages at once to a peer.
+#define CB_SEND_QUEUE_MAX_BYTES 4000000 // Messages are refused when the bytes queued for a peer would go over this, unless they are control messages or nothing is queued.
+#define CB_SEND_QUEUE_LOW_WATERMARK 1000000 // After a message is refused, onSendQueueDrained is called when the bytes queued for the peer fall below this.
+#define CB_RECEIVE_BUFFER_SIZE 65536 // The size of the buffer for reading a number of messages at once with CB_NETWORK_COMMUNICATOR_BATCH_RECEIVE.
 #define CBGetPeer(x) ((CBPeer *)x)
 
 typedef enum{
@@ -42,25 +46,48 @@ typedef enum{
 	CB_HANDSHAKE_DONE = 15
 }CBHandshakeStatus;
 
+/**
+ @brief The priority classes of messages sent to peers. A message is only sent when no message of a higher priority is queued, but a message which has started sending is always finished first.
+ */
+typedef enum{
+	CB_SEND_PRIORITY_CONTROL, /**< version, verack, ping, pong and alert messages. These are never refused for the size of the queue. */
+	CB_SEND_PRIORITY_BLOCK, /**< block and headers messages and requests for them. */
+	CB_SEND_PRIORITY_TX, /**< tx, inv and alternative messages. */
+	CB_SEND_PRIORITY_ADDR, /**< addr and getaddr messages. */
+	CB_SEND_PRIORITY_NUM
+} CBSendPriority;
+
+typedef struct CBSendQueueItem CBSendQueueItem;
+
 /**
  @brief Stores a message to send in the queue with the callback to call when the message is sent.
  */
-typedef struct{
+struct CBSendQueueItem{
 	CBMessage * message;
 	void (*callback)(void *, void *);
-} CBSendQueueItem;
+	uint32_t size; /**< The number of bytes to send including the header. */
+	long long int queueTime; /**< The time in milliseconds the message was queued. */
+	CBSendQueueItem * next;
+};
 
 /**
  @brief Structure for CBPeer objects. @see CBPeer.h
 */
 typedef struct{
-	CBObjectMutex base;
+	CBObject base;
 	CBNetworkAddress * addr; /**< The CBNetworkAddress of this peer */
 	CBDepObject socketID; /**< Not used in the bitcoin protocol. This is used by cbitcoin to store a socket ID for a connection to a CBNetworkAddress. The socket here is not closed when the CBNetworkAddress is freed so needs to be closed elsewhere. */
 	CBMessage * receive; /**< Receiving message. NULL if not receiving. This message is exclusive to the peer. */
-	CBSendQueueItem sendQueue[CB_SEND_QUEUE_MAX_SIZE]; /**< Messages to send to this peer. NULL if not sending anything. */
-	int sendQueueSize; /**< Upto 10 messages in queue */
-	int sendQueueFront; /**< Index of the front of the queue */
+	CBSendQueueItem * sendQueue[CB_SEND_PRIORITY_NUM]; /**< The first message waiting to be sent to this peer for each priority. */
+	CBSendQueueItem * sendQueueLast[CB_SEND_PRIORITY_NUM]; /**< The last message waiting to be sent to this peer for each priority. */
+	CBSendQueueItem * sending; /**< The message being sent. NULL if a message has not been taken from the queue. */
+	int sendQueueSize; /**< The number of messages queued, including the one being sent. */
+	uint32_t sendQueueBytes; /**< The number of bytes of the queued messages, including the one being sent. */
+	bool sendQueueFull; /**< True when a message has been refused and the queue has not yet fallen below CB_SEND_QUEUE_LOW_WATERMARK. */
+	uint32_t sendQueueRefused; /**< The number of messages refused as the queue was full. */
+	uint32_t messagesSent; /**< The number of messages sent to this peer. */
+	int sendQueueLatency; /**< The smoothed time in milliseconds messages take from being queued to being sent. */
+	int sendQueueLatencyMax; /**< The longest time in milliseconds a message has taken from being queued to being sent. */
 	int messageSent; /**< Used by a CBNetworkCommunicator to store the message length send. When the header is sent, 24 bytes are taken off. */
 	bool sentHeader; /**< True if the sending message's header has been sent. */
 	unsigned char * sendingHeader; /**< Stores header to send */
@@ -68,11 +95,20 @@ typedef struct{
 	CBDepObject receiveEvent; /**< Event for receving data from this peer */
 	CBDepObject sendEvent; /**< Event for sending data from this peer */
 	CBDepObject connectEvent; /**< Event for connecting to the peer. */
+	CBTimerWheelEntry receiveTimer; /**< Used by a CBNetworkCommunicator for the timeout of the receive event. */
+	CBTimerWheelEntry sendTimer; /**< Used by a CBNetworkCommunicator for the timeout of the send event. */
+	CBTimerWheelEntry trickleTimer; /**< Used by a CBNetworkCommunicator for when the waiting announcements are sent. */
+	CBInventory * announcements; /**< Inventory waiting to be announced to this peer. NULL when there is nothing waiting. */
+	long long int announcementsTime; /**< The time in milliseconds the first waiting announcement was added. */
+	CBRollingBloomFilter * knownInventory; /**< The hashes of inventory this peer has announced or been announced. The oldest hashes are forgotten so that the memory used is fixed. NULL until the connection is working. */
+	int receiveTimeOut; /**< The timeout of the receive event, which restarts when data is received. */
 	CBHandshakeStatus handshakeStatus;
 	CBVersion * versionMessage; /**< The version message from this peer. */
 	unsigned char * headerBuffer; /**< Used by a CBNetworkCommunicator to read the message header before processing. */
 	int messageReceived; /**< Used by a CBNetworkCommunicator to store the message length received. When the header is received 24 bytes are taken off. */
 	bool receivedHeader; /**< True if the receiving message's header has been received. */
+	unsigned char * receiveBuffer; /**< With CB_NETWORK_COMMUNICATOR_BATCH_RECEIVE, the data read from the socket which has not been processed. NULL until the first read. */
+	uint32_t receiveBufferLength; /**< The length of the data in receiveBuffer. */
 	int64_t timeOffset; /**< The offset from the system time this peer has */
 	long long int time; /**< Time of the last own address brodcast. */
 	bool connectionWorking; /**< True when the connection has been successful and the peer has ben added to the CBNetworkAddressManager. */
@@ -80,6 +116,8 @@ typedef struct{
 	CBMessageType typeExpected; /**< Type we expect in response. */
 	bool incomming; /**< Node from an incomming connection if true */
 	bool connecting;
+	long long int connectStart; /**< The time in milliseconds the connection attempt started. */
+	bool raced; /**< True when another connection has been attempted because this attempt is slow. */
 	long long int downloadTime; /**< Download time for this peer (in millisconds), not taking the latency into account. Use for determining effeciency. */
 	long long int downloadAmount; /**< Downloaded bytes measured for this peer. */
 	long long int downloadTimerStart; /**< Used to measure download time (in millisconds). */
@@ -103,4 +141,39 @@ void CBInitPeer(CBPeer * self, CBNetworkAddress * addr);
 void CBDestroyPeer(CBPeer * peer);
 void CBFreePeer(void * peer);
 
+//  Functions
+
+/**
+ @brief Records that a peer knows about an inventory item.
+ @param self The CBPeer object.
+ @param hash The hash of the inventory item.
+ @returns true if the item was recorded, false if the peer was already known to have it. true without recording the item if the peer has no knownInventory.
+ */
+bool CBPeerAddKnownInventory(CBPeer * self, CBByteArray * hash);
+/**
+ @brief Releases the messages queued for a peer and frees the items of the queue, including the message being sent.
+ @param self The CBPeer object.
+ */
+void CBPeerClearSendQueue(CBPeer * self);
+/**
+ @brief Determines if a peer is known to have an inventory item.
+ @param self The CBPeer object.
+ @param hash The hash of the inventory item.
+ @returns true if the peer has announced the item or has been announced it, unless it has been forgotten. false otherwise.
+ */
+bool CBPeerKnowsInventory(CBPeer * self, CBByteArray * hash);
+/**
+ @brief Takes the first message of the highest priority from the send queue, so that it becomes the message being sent.
+ @param self The CBPeer object.
+ @returns The item for the message, which is also in "sending", or NULL if nothing is queued.
+ */
+CBSendQueueItem * CBPeerPopSendQueue(CBPeer * self);
+/**
+ @brief Adds a message to the back of the send queue for its priority. The size of the item is added to sendQueueBytes.
+ @param self The CBPeer object.
+ @param item The item for the message.
+ @param priority The priority of the message.
+ */
+void CBPeerPushSendQueue(CBPeer * self, CBSendQueueItem * item, CBSendPriority priority);
+
 #endif
@@ -0,0 +1,258 @@
+//
+//  CBPool.h
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+/**
+ @file
+ @brief Allocators for objects which are created in large numbers, such as the objects of deserialised transactions.
+ @details A CBPool gives fixed size objects from slabs of memory, which are not returned to the system, and can keep a per-thread cache of free objects so that most allocations do not need to take the pool lock. A CBArena gives objects from large chunks of memory. An arena is freed entirely when the last object in it is freed, so all of the objects belonging to a block can be freed together.
+ 
+ CBAllocObject uses the current arena of the thread if there is one, or else the pool. The free function of an object should call CBFreeObjectMemory, which frees the memory according to how it was allocated.
+ */
+
+#ifndef CBPOOLH
+#define CBPOOLH
+
+//  Includes
+
+#include "CBObject.h"
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+
+// Constants
+
+#define CB_POOL_SLAB_SIZE 65536
+#define CB_POOL_CACHE_SIZE 64 /**< The maximum number of free objects a thread keeps for a pool. Half are moved at a time to and from the pool. */
+#define CB_ARENA_CHUNK_SIZE 65536 /**< Chunks are aligned to their size so that an object can find its arena. */
+#define CB_POOL_LOCK_SPINS 64 /**< The number of times a thread pauses while waiting for the pool lock before it yields the processor. */
+
+// Tells the processor that a thread is spinning, so that it uses less power and gives way to the other hardware thread of the core.
+#if defined(__x86_64__) || defined(__i386__)
+#define CBPoolPause() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define CBPoolPause() __asm__ __volatile__("yield")
+#else
+#define CBPoolPause()
+#endif
+
+/**
+ @brief The pools with thread caches.
+ */
+typedef enum{
+	CB_POOL_CACHE_BYTE_ARRAY,
+	CB_POOL_CACHE_SHARED_DATA,
+	CB_POOL_CACHE_TRANSACTION_INPUT,
+	CB_POOL_CACHE_TRANSACTION_OUTPUT,
+	CB_POOL_CACHE_TRANSACTION,
+	CB_POOL_CACHE_NUM,
+	CB_POOL_CACHE_NONE = -1, /**< The pool has no thread cache. */
+} CBPoolCacheID;
+
+/**
+ @brief A free object in a pool.
+ */
+typedef struct CBPoolObject CBPoolObject;
+
+struct CBPoolObject{
+	CBPoolObject * next;
+};
+
+/**
+ @brief Structure for CBPool objects. @see CBPool.h
+ */
+typedef struct{
+	int size; /**< The size of the objects. */
+	CBPoolCacheID cacheID; /**< The thread cache used by the pool or CB_POOL_CACHE_NONE. */
+	bool lock; /**< Spin lock for the free objects and slabs. */
+	CBPoolObject * free; /**< The free objects. */
+	void * slabs; /**< The slabs, linked by the first pointer of each. */
+	int slabNum; /**< The number of slabs allocated. */
+} CBPool;
+
+/**
+ @brief The free objects of a pool for one thread.
+ */
+typedef struct{
+	CBPoolObject * free;
+	int freeNum;
+	CBPool * pool; /**< The pool the objects are returned to when the thread exits, or NULL if the thread has not used the cache. */
+} CBPoolCache;
+
+/**
+ @brief The start of a chunk of an arena.
+ */
+typedef struct CBArenaChunk CBArenaChunk;
+
+/**
+ @brief Structure for CBArena objects. @see CBPool.h
+ */
+typedef struct{
+	int references; /**< One for the owner and one for each object in the arena. */
+	CBArenaChunk * chunks; /**< The chunks, with the current one first. */
+	int used; /**< The bytes used in the current chunk. */
+	int chunkNum; /**< The number of chunks allocated. */
+} CBArena;
+
+struct CBArenaChunk{
+	CBArena * arena;
+	CBArenaChunk * next;
+};
+
+/**
+ @brief Initialises a pool at compile time.
+ @param type The type of the objects.
+ @param cacheID @see CBPoolCacheID
+ */
+#define CB_POOL_INIT(type, cacheID) {((sizeof(type) + 15) / 16) * 16, cacheID, false, NULL, NULL, 0}
+
+/**
+ @brief Creates a new arena, owned by the caller.
+ @returns The new arena or NULL on failure.
+ */
+CBArena * CBNewArena(void);
+
+/**
+ @brief Frees the slabs of a pool. All objects of the pool must have been freed and the thread caches flushed.
+ @param self The pool.
+ */
+void CBDestroyPool(CBPool * self);
+
+//  Functions
+
+/**
+ @brief Allocates memory in the current arena of the thread if there is one, or else from a pool.
+ @param pool The pool for the type.
+ @param allocation Set to how the memory was allocated.
+ @returns The allocated memory or NULL on failure.
+ */
+void * CBAlloc(CBPool * pool, CBAllocation * allocation);
+
+/**
+ @brief Allocates an object with CBAlloc and sets the allocation member of the object.
+ @param pool The pool for objects of the type.
+ @returns The memory for the object or NULL on failure.
+ */
+void * CBAllocObject(CBPool * pool);
+
+/**
+ @brief Allocates memory from an arena, which is retained by the allocation.
+ @param self The arena.
+ @param size The size of the allocation, which must fit in a chunk.
+ @returns The allocated memory or NULL on failure.
+ */
+void * CBArenaAlloc(CBArena * self, int size);
+
+/**
+ @brief Gets the arena an allocation was made from.
+ @param ptr The allocation.
+ @returns The arena.
+ */
+CBArena * CBArenaFromPointer(void * ptr);
+
+/**
+ @brief Releases a reference to an arena, freeing all chunks when there are no references left.
+ @param self The arena.
+ */
+void CBArenaRelease(CBArena * self);
+
+/**
+ @brief Frees memory according to how it was allocated.
+ @param ptr The memory to free.
+ @param allocation How the memory was allocated.
+ @param pool The pool for the type.
+ */
+void CBFreeMemory(void * ptr, CBAllocation allocation, CBPool * pool);
+
+/**
+ @brief Frees the memory of an object according to how it was allocated.
+ @param self The object.
+ @param pool The pool for objects of the type.
+ */
+void CBFreeObjectMemory(void * self, CBPool * pool);
+
+/**
+ @brief Gets the current arena of the thread.
+ @returns The current arena or NULL.
+ */
+CBArena * CBGetCurrentArena(void);
+
+/**
+ @brief Allocates memory from a pool.
+ @param self The pool.
+ @returns The allocated memory or NULL on failure.
+ */
+void * CBPoolAlloc(CBPool * self);
+
+/**
+ @brief Moves objects from the pool into the cache of the thread.
+ @param self The pool.
+ @param cache The thread cache for the pool.
+ @returns true if there is at least one object in the cache, false if no memory could be allocated.
+ */
+bool CBPoolFillCache(CBPool * self, CBPoolCache * cache);
+
+/**
+ @brief Returns the objects in the cache of the thread back to the pool. This is done for every pool when a thread exits.
+ @param self The pool.
+ */
+void CBPoolFlushThreadCache(CBPool * self);
+
+/**
+ @brief Returns the objects in all of the caches of the thread back to their pools. Called when a thread which has used a cache exits.
+ @param unused Not used.
+ */
+void CBPoolFlushThreadCaches(void * unused);
+
+/**
+ @brief Gets the cache of the thread for a pool, and the first time a thread uses a cache, arranges for the caches to be flushed when the thread exits.
+ @param self The pool, which has a cache.
+ @returns The cache.
+ */
+CBPoolCache * CBPoolGetThreadCache(CBPool * self);
+
+/**
+ @brief Creates the key used to flush the caches of threads when they exit.
+ */
+void CBPoolThreadCacheKeyCreate(void);
+
+/**
+ @brief Returns memory to a pool.
+ @param self The pool.
+ @param ptr The memory to free.
+ */
+void CBPoolFree(CBPool * self, void * ptr);
+
+/**
+ @brief Locks a pool. While the lock is held by another thread, the lock is read without writing to it, pausing between reads, and after CB_POOL_LOCK_SPINS reads the thread yields the processor, in case the holder is waiting to run.
+ @param self The pool.
+ */
+void CBPoolLock(CBPool * self);
+
+/**
+ @brief Adds a slab of free objects to a pool. The pool should be locked.
+ @param self The pool.
+ @returns true on success, false if the slab could not be allocated.
+ */
+bool CBPoolNewSlab(CBPool * self);
+
+void CBPoolUnlock(CBPool * self);
+
+/**
+ @brief Sets the current arena of the thread which is used by CBAllocObject.
+ @param arena The arena or NULL to allocate from pools.
+ @returns The previous arena so that it can be restored.
+ */
+CBArena * CBSetCurrentArena(CBArena * arena);
+
+#endif
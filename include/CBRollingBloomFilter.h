@@ -0,0 +1,141 @@
+//
+//  CBRollingBloomFilter.h
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+/**
+ @file
+ @brief A bloom filter of 32 byte hashes which forgets the oldest hashes, so that it remembers the most recent hashes in a fixed amount of memory. Inherits CBObject
+ @details The filter has two generations, each holding up to half of the hashes to remember. When the current generation is full, the older generation is cleared and becomes the current generation, so between half and all of the hashes are remembered. Hashes are found in either generation.
+
+ Each generation is a split block bloom filter. A hash is given one block of a cache line, which is sixteen 32 bit words, and sets one bit in every word. The bits are chosen by multiplying the hash with a different odd number for each word, so adding and searching do the same simple operations on all sixteen words, which compilers turn into vector instructions. The number of blocks is chosen to give the requested false positive rate, taking into account that some blocks have more hashes than others.
+ */
+
+#ifndef CBROLLINGBLOOMFILTERH
+#define CBROLLINGBLOOMFILTERH
+
+//  Includes
+
+#include "CBObject.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Constants and Macros
+
+#define CBGetRollingBloomFilter(x) ((CBRollingBloomFilter *)x)
+#define CB_BLOOM_BLOCK_WORDS 16 // The number of 32 bit words in a block, which fill a cache line.
+
+typedef uint32_t CBBloomBlock[CB_BLOOM_BLOCK_WORDS];
+
+/**
+ @brief Structure for CBRollingBloomFilter objects. @see CBRollingBloomFilter.h
+ */
+typedef struct{
+	CBObject base;
+	CBBloomBlock * generations[2]; /**< The blocks of each generation, aligned to cache lines. Both are in one allocation starting at generations[0]. */
+	uint32_t blockNum; /**< The number of blocks in each generation. */
+	uint32_t generationItems; /**< The number of hashes added to a generation before the next. */
+	uint32_t itemNum; /**< The number of hashes added to the current generation. */
+	int current; /**< The index of the current generation. */
+	uint64_t seed; /**< Mixed into the hashes, so that the blocks and bits used differ between filters. */
+} CBRollingBloomFilter;
+
+/**
+ @brief Creates a new CBRollingBloomFilter object.
+ @param items The number of most recent hashes to remember. At least half of these are always remembered.
+ @param falsePositiveRate The chance, between 0 and 1, that a hash which was not added is found.
+ @param seed A random number so that the positions of hashes cannot be predicted.
+ @returns A new CBRollingBloomFilter object, or NULL on failure.
+ */
+CBRollingBloomFilter * CBNewRollingBloomFilter(uint32_t items, double falsePositiveRate, uint64_t seed);
+
+/**
+ @brief Initialises a CBRollingBloomFilter object.
+ @param self The CBRollingBloomFilter object to initialise.
+ @param items The number of most recent hashes to remember. At least half of these are always remembered.
+ @param falsePositiveRate The chance, between 0 and 1, that a hash which was not added is found.
+ @param seed A random number so that the positions of hashes cannot be predicted.
+ @returns true on success, false on failure.
+ */
+bool CBInitRollingBloomFilter(CBRollingBloomFilter * self, uint32_t items, double falsePositiveRate, uint64_t seed);
+
+/**
+ @brief Frees the blocks of a CBRollingBloomFilter object.
+ @param self The CBRollingBloomFilter object to destroy.
+ */
+void CBDestroyRollingBloomFilter(void * self);
+
+/**
+ @brief Frees a CBRollingBloomFilter object and also calls CBDestroyRollingBloomFilter.
+ @param self The CBRollingBloomFilter object to free.
+ */
+void CBFreeRollingBloomFilter(void * self);
+
+//  Functions
+
+/**
+ @brief Adds a hash to the current generation of the filter, unless it is found there already. A hash found only in the older generation is added again so that it is remembered as recently seen. When the current generation is full, the oldest hashes are forgotten.
+ @param self The CBRollingBloomFilter object.
+ @param hash The 32 byte hash.
+ @returns true if the hash was not found in the filter, false if the hash was found in either generation.
+ */
+bool CBRollingBloomFilterAdd(CBRollingBloomFilter * self, unsigned char * hash);
+
+/**
+ @brief Determines if the bits of a hash are set in a block.
+ @param block The block.
+ @param masks The bits from CBRollingBloomFilterGetMasks.
+ @returns true if every bit is set, false otherwise.
+ */
+bool CBRollingBloomFilterBlockContains(uint32_t * block, uint32_t * masks);
+
+/**
+ @brief Determines if a hash is in the filter.
+ @param self The CBRollingBloomFilter object.
+ @param hash The 32 byte hash.
+ @returns true if the hash was added and has not been forgotten, or by chance for a false positive. false if the hash is not in the filter.
+ */
+bool CBRollingBloomFilterContains(CBRollingBloomFilter * self, unsigned char * hash);
+
+/**
+ @brief Calculates the false positive rate of a full generation.
+ @param items The number of hashes in the generation.
+ @param blockNum The number of blocks in the generation.
+ @returns The chance that a hash which was not added is found in the generation.
+ */
+double CBRollingBloomFilterFalsePositiveRate(uint32_t items, uint32_t blockNum);
+
+/**
+ @brief Calculates the fewest blocks for a generation to have a false positive rate.
+ @param items The number of hashes in the generation.
+ @param falsePositiveRate The false positive rate.
+ @returns The number of blocks.
+ */
+uint32_t CBRollingBloomFilterGetBlockNum(uint32_t items, double falsePositiveRate);
+
+/**
+ @brief Gets the bit to set or test in each word of a block for a hash.
+ @param hash The lower 32 bits of the result of CBRollingBloomFilterHash.
+ @param masks Set to a mask with one bit for each word.
+ */
+void CBRollingBloomFilterGetMasks(uint32_t hash, uint32_t * masks);
+
+/**
+ @brief Hashes a 32 byte hash with the seed of a filter. The upper 32 bits choose the block and the lower 32 bits choose the bits.
+ @param self The CBRollingBloomFilter object.
+ @param hash The 32 byte hash.
+ @returns The 64 bit hash.
+ */
+uint64_t CBRollingBloomFilterHash(CBRollingBloomFilter * self, unsigned char * hash);
+
+#endif
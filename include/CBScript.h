@@ -322,6 +322,15 @@ int CBScriptGetPushAmount(CBScript * self, int * offset);
  */
 int CBScriptGetSigOpCount(CBScript * self, bool inP2SH);
 
+/**
+ @brief Returns the number of sigops of script data.
+ @param data The script data.
+ @param length The length of the script.
+ @param inP2SH true when getting sigops for a P2SH script.
+ @retuns the number of sigops as used for validation.
+ */
+int CBScriptGetSigOpCountFromData(unsigned char * data, int length, bool inP2SH);
+
 /**
  @brief Determines if a script object matches the public-key hash verification template. 
  @param self The CBScript object.
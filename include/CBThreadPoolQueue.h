@@ -12,6 +12,9 @@
 //  or distributed except according to the terms contained in the
 //  LICENSE file.
 
+#ifndef CBTHREADPOOLQUEUEH
+#define CBTHREADPOOLQUEUEH
+
 #include "CBDependencies.h"
 #include "CBObject.h"
 #include <stdlib.h>
@@ -32,6 +35,21 @@ typedef struct{
 
 typedef struct CBThreadPoolQueue CBThreadPoolQueue;
 
+/**
+ @brief Work given to the shared thread pool by CBThreadPoolRun. The items are numbered from zero and are taken by the threads in turn.
+ */
+typedef struct CBThreadPoolJob CBThreadPoolJob;
+
+struct CBThreadPoolJob{
+	void (*process)(void * object, int item);
+	void * object;
+	int itemNum;
+	int next; /**< The next item to take, increased atomically. */
+	int threads; /**< The most pool threads which can run items of this job. */
+	int running; /**< The pool threads running items of this job, so the job is finished when all items are taken and this is zero. */
+	CBThreadPoolJob * nextJob; /**< The next job with items left to take. */
+};
+
 typedef struct{
 	CBQueue queue;
 	CBDepObject thread;
@@ -62,3 +80,37 @@ void CBThreadPoolQueueAdd(CBThreadPoolQueue * self, CBQueueItem * item);
 void CBThreadPoolQueueClear(CBThreadPoolQueue * self);
 void CBThreadPoolQueueThreadLoop(void * self);
 void CBThreadPoolQueueWaitUntilFinished(CBThreadPoolQueue * self);
+
+/**
+ @brief Creates the mutex and conditions of the shared thread pool.
+ */
+void CBThreadPoolInit(void);
+
+/**
+ @brief Removes a job from the jobs with items left to take, if it is there. The pool mutex must be held.
+ @param job The job.
+ */
+void CBThreadPoolRemoveJob(CBThreadPoolJob * job);
+
+/**
+ @brief Processes items of a number of items across the shared thread pool and returns when all are processed. The calling thread processes items too. The pool is started the first time it is used, and threads are only added when more are needed, so threads are not started for each call. Many threads can run jobs at once, and the process function can call this again.
+ @param process Called for each item with the object and the number of the item.
+ @param object Given to the process function.
+ @param itemNum The number of items.
+ @param numThreads The number of threads to process the items with, including the calling thread.
+ */
+void CBThreadPoolRun(void (*process)(void * object, int item), void * object, int itemNum, int numThreads);
+
+/**
+ @brief Takes items from a job and processes them until none are left.
+ @param job The job.
+ */
+void CBThreadPoolRunItems(CBThreadPoolJob * job);
+
+/**
+ @brief The loop of the threads of the shared thread pool, which run items of jobs.
+ @param unused Not used.
+ */
+void CBThreadPoolWorkerLoop(void * unused);
+
+#endif
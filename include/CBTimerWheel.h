@@ -0,0 +1,115 @@
+//
+//  CBTimerWheel.h
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+/**
+ @file
+ @brief A hashed timing wheel for timeouts which are changed far more often than they expire, such as the timeouts of peers which are restarted whenever data is received.
+ @details The wheel is advanced by a periodic timer in ticks of a fixed length, so deadlines are rounded up to a tick. Each slot of the wheel has a list of entries, and an entry is placed into the slot of its deadline or, when the deadline is more than one revolution away, into the last slot before coming round again, from where it is moved on when the slot is reached.
+
+ An entry records the tick of the slot it is in. Setting a deadline which is not before that tick only changes the deadline of the entry, which is moved when its slot is reached. Earlier deadlines move the entry. Both are done in constant time.
+ */
+
+#ifndef CBTIMERWHEELH
+#define CBTIMERWHEELH
+
+//  Includes
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Constants
+
+#define CB_TIMER_WHEEL_SLOTS 256 /**< The number of slots in the wheel. Must be a power of two. */
+
+/**
+ @brief An entry of a CBTimerWheel, which is placed in the object with the timeout.
+ */
+typedef struct CBTimerWheelEntry CBTimerWheelEntry;
+
+struct CBTimerWheelEntry{
+	CBTimerWheelEntry * next; /**< NULL when the entry is not in the wheel. */
+	CBTimerWheelEntry * prev;
+	uint64_t deadline; /**< The tick the entry expires at. */
+	uint64_t slotTick; /**< The tick of the slot the entry is in, which is never after the deadline. */
+	void * owner; /**< The object with the timeout. */
+};
+
+/**
+ @brief Structure for CBTimerWheel objects. @see CBTimerWheel.h
+ */
+typedef struct{
+	CBTimerWheelEntry slots[CB_TIMER_WHEEL_SLOTS]; /**< The heads of circular lists of entries. */
+	uint64_t tick; /**< The last tick which was processed. */
+	int64_t startTime; /**< The time in milliseconds of tick zero. */
+	int tickTime; /**< The length of a tick in milliseconds. */
+	void (*onExpire)(void *, CBTimerWheelEntry *); /**< Called with the entries which expire. The entry has been removed from the wheel and can be set again. */
+	void * arg; /**< The first argument for onExpire. */
+} CBTimerWheel;
+
+/**
+ @brief Initialises a CBTimerWheel.
+ @param self The CBTimerWheel to initialise.
+ @param tickTime The length of a tick in milliseconds.
+ @param time The current time in milliseconds.
+ @param onExpire The function called with entries which expire.
+ @param arg The first argument for onExpire.
+ */
+void CBInitTimerWheel(CBTimerWheel * self, int tickTime, int64_t time, void (*onExpire)(void *, CBTimerWheelEntry *), void * arg);
+
+/**
+ @brief Initialises an entry which is not in a wheel.
+ @param entry The CBTimerWheelEntry to initialise.
+ @param owner The object with the timeout.
+ */
+void CBInitTimerWheelEntry(CBTimerWheelEntry * entry, void * owner);
+
+//  Functions
+
+/**
+ @brief Processes the ticks up to a time, calling onExpire for each entry which expired. The callback can add and remove entries.
+ @param self The CBTimerWheel.
+ @param time The current time in milliseconds.
+ */
+void CBTimerWheelAdvance(CBTimerWheel * self, int64_t time);
+
+/**
+ @brief Places an entry into the slot for its deadline or into the furthest slot when the deadline is more than one revolution away.
+ @param self The CBTimerWheel.
+ @param entry The CBTimerWheelEntry which is not in the wheel.
+ */
+void CBTimerWheelInsert(CBTimerWheel * self, CBTimerWheelEntry * entry);
+
+/**
+ @brief Determines if an entry is in a wheel.
+ @param entry The CBTimerWheelEntry.
+ @returns true if the entry will expire unless removed, false otherwise.
+ */
+bool CBTimerWheelIsPending(CBTimerWheelEntry * entry);
+
+/**
+ @brief Removes an entry from its wheel if it is in one.
+ @param entry The CBTimerWheelEntry.
+ */
+void CBTimerWheelRemove(CBTimerWheelEntry * entry);
+
+/**
+ @brief Sets an entry to expire after a timeout, replacing any deadline it had. The deadline is counted from the end of the current tick and rounded up to a tick, so the entry expires up to two ticks late.
+ @param self The CBTimerWheel.
+ @param entry The CBTimerWheelEntry.
+ @param timeout The timeout in milliseconds. If zero the entry is removed.
+ */
+void CBTimerWheelSet(CBTimerWheel * self, CBTimerWheelEntry * entry, int timeout);
+
+#endif
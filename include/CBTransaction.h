@@ -26,6 +26,7 @@
 #include "CBTransactionInput.h"
 #include "CBTransactionOutput.h"
 #include "CBHDKeys.h"
+#include "CBThreadPoolQueue.h"
 
 // Constants and Macros
 
@@ -35,6 +36,18 @@
 #define CB_MAX_DER_SIG_SIZE 74
 #define CBGetTransaction(x) ((CBTransaction *)x)
 
+/**
+ @brief Describes how CBTransactionSignAll should sign an input. This is filled by the keyring callback.
+ */
+typedef struct{
+	CBScriptOutputType type; /**< The type of the script being satisfied: CB_TX_OUTPUT_TYPE_KEYHASH, CB_TX_OUTPUT_TYPE_PUBKEY or CB_TX_OUTPUT_TYPE_MULTISIG. For P2SH this is the type of p2shScript. */
+	CBByteArray * prevOutSubScript; /**< The sub script used for the signature hash. Not retained. */
+	CBKeyPair ** keys; /**< The keys to sign with. Multisig signatures are placed in this order. Not retained. */
+	int keyNum; /**< The number of keys. Only CB_TX_OUTPUT_TYPE_MULTISIG may use more than one. Zero leaves the input unchanged. */
+	CBSignType signType; /**< The signature type to use. */
+	CBScript * p2shScript; /**< If not NULL this script is pushed after the signatures to spend a P2SH output. Not retained. */
+} CBTransactionInputSigner;
+
 /**
  @brief Structure for CBTransaction objects. @see CBTransaction.h
 */
@@ -50,6 +63,26 @@ typedef struct{
 	int lockTime; /**< Time for the transaction to be valid */
 } CBTransaction;
 
+/**
+ @brief The pool for CBTransaction objects.
+ */
+extern CBPool CBTransactionPool;
+
+/**
+ @brief The serialised parts of the signature hash data which are common to every input of a transaction. @see CBTransactionGetSigHashParts
+ */
+typedef struct{
+	unsigned char * inputs; /**< The input count followed by every input with an empty script. */
+	int inputsLen;
+	unsigned char * outputs; /**< The output count followed by every output. */
+	int outputsLen;
+} CBTransactionSigHashParts;
+
+/**
+ @brief The shared state of a CBTransactionSignAll call, which is internal to CBTransaction.c.
+ */
+typedef struct CBTransactionSignAllJob CBTransactionSignAllJob;
+
 /**
  @brief Creates a new CBTransaction object with no inputs or outputs.
  @returns A new CBTransaction object.
@@ -144,6 +177,31 @@ unsigned char * CBTransactionGetHash(CBTransaction * self);
  */
 bool CBTransactionGetInputHashForSignature(void * vself, CBByteArray * prevOutSubScript, int input, CBSignType signType, unsigned char * hash);
 
+/**
+ @brief Gets the signature hash for an input using the parts that are common to every input. This is equivalent to CBTransactionGetInputHashForSignature. Only CB_SIGHASH_ALL signatures use the parts, other signatures types are passed to CBTransactionGetInputHashForSignature.
+ @param self The CBTransaction object.
+ @param parts The parts from CBTransactionGetSigHashParts.
+ @param prevOutSubScript The sub script from the output.
+ @param input The index of the input to sign.
+ @param signType The type of signature to get the data for.
+ @param hash The 32 byte data hash for signing or checking signatures.
+ @returns true if the hash has been retreived with no problems. false is returned if the hash is invalid.
+ */
+bool CBTransactionGetInputHashForSignatureFromParts(CBTransaction * self, CBTransactionSigHashParts * parts, CBByteArray * prevOutSubScript, int input, CBSignType signType, unsigned char * hash);
+
+/**
+ @brief Serialises the parts of the signature hash data which are common to every input. These need to be obtained again if the transaction is modified, except for input scripts.
+ @param self The CBTransaction object.
+ @param parts The parts to set. Free with CBFreeTransactionSigHashParts.
+ */
+void CBTransactionGetSigHashParts(CBTransaction * self, CBTransactionSigHashParts * parts);
+
+/**
+ @brief Frees the data of CBTransactionSigHashParts.
+ @param parts The parts to free.
+ */
+void CBFreeTransactionSigHashParts(CBTransactionSigHashParts * parts);
+
 void CBTransactionHashToString(CBTransaction * self, char output[CB_TX_HASH_STR_SIZE]);
 
 bool CBTransactionInputIsStandard(CBScript * inputScript, CBScript * outputScript, CBScript * p2sh);
@@ -167,6 +225,31 @@ void CBTransactionPrepareBytes(CBTransaction * self);
  */
 int CBTransactionSerialise(CBTransaction * self, bool force);
 
+/**
+ @brief Signs many inputs of a transaction at once. The keyring is asked how to sign each input, the parts of the signature hash data which are common to every input are serialised once and the signatures are produced in parallel. Finally all of the input scripts are written in a single pass into one CBByteArray which the inputs reference. Existing scripts of signed inputs are replaced.
+ @param self The CBTransaction object.
+ @param keyring A function which fills the CBTransactionInputSigner for an input, returning false on failure. This is only called from the calling thread, in order of the inputs.
+ @param keyringObj An object passed to the keyring function.
+ @param numThreads The number of threads of the shared thread pool to sign with. If less than one, the number of cores is used.
+ @returns true if all inputs were signed successfully and false otherwise.
+ */
+bool CBTransactionSignAll(CBTransaction * self, bool (*keyring)(void * keyringObj, int input, CBTransactionInputSigner * signer), void * keyringObj, int numThreads);
+
+/**
+ @brief Produces the signatures for one input of a CBTransactionSignAll job.
+ @param job The signing job.
+ @param input The index of the input.
+ @returns true on success and false on failure.
+ */
+bool CBTransactionSignAllInput(CBTransactionSignAllJob * job, int input);
+
+/**
+ @brief Signs an input of a CBTransactionSignAll job on the shared thread pool.
+ @param job The signing job.
+ @param input The index of the input.
+ */
+void CBTransactionSignAllProcess(void * job, int input);
+
 bool CBTransactionSignMultisigInput(CBTransaction * self, CBKeyPair * key, CBByteArray * prevOutSubScript, int input, CBSignType signType);
 
 bool CBTransactionSignPubKeyHashInput(CBTransaction * self, CBKeyPair * key, CBByteArray * prevOutSubScript, int input, CBSignType signType);
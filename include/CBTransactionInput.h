@@ -49,6 +49,11 @@ typedef struct{
 	CBPrevOut prevOut; /**< A locator for a previous output being spent. */
 } CBTransactionInput;
 
+/**
+ @brief The pool for CBTransactionInput objects.
+ */
+extern CBPool CBTransactionInputPool;
+
 /**
  @brief Creates a new CBTransactionInput object.
  @returns A new CBTransactionInput object.
@@ -39,6 +39,11 @@ typedef struct{
 	CBScript * scriptObject; /**< The output script object */
 } CBTransactionOutput;
 
+/**
+ @brief The pool for CBTransactionOutput objects.
+ */
+extern CBPool CBTransactionOutputPool;
+
 /**
  @brief Creates a new CBTransactionOutput object.
  @returns A new CBTransactionOutput object.
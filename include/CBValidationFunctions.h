@@ -22,6 +22,7 @@
 
 #include "CBConstants.h"
 #include "CBBlock.h"
+#include "CBCompactTransaction.h"
 
 // Constants and Macros
 
@@ -59,6 +60,31 @@ void CBCalculateMerkleRoot(unsigned char * hashes, int hashNum);
  */
 int CBCalculateTarget(int oldTarget, int time);
 
+/**
+ @brief Returns the number of sigops from a CBCompactTransaction without P2SH scripts. @see CBTransactionGetSigOps
+ @param tx The transaction.
+ @returns the number of sigops for validation.
+ */
+int CBCompactTransactionGetSigOps(CBCompactTransaction * tx);
+
+/**
+ @brief Determines if a CBCompactTransaction is final. @see CBTransactionIsFinal
+ @param tx The transaction.
+ @param time The time for determining if the transaction is final.
+ @param height The block height for determining if the transaction is final.
+ @returns true if final and false if not final.
+ */
+bool CBCompactTransactionIsFinal(CBCompactTransaction * tx, long long int time, long long int height);
+
+/**
+ @brief Does the basic validation of CBTransactionValidateBasic on a CBCompactTransaction.
+ @param tx The transaction to validate.
+ @param coinbase true to validate for a coinbase transaction, false to validate for a non-coinbase transaction.
+ @param outputValue Pointer to the integer to hold the output value calculated by this function.
+ @returns true if transaction passes basic validation or false.
+ */
+bool CBCompactTransactionValidateBasic(CBCompactTransaction * tx, bool coinbase, long long int * outputValue);
+
 /**
  @brief Returns the number of sigops from a transaction but does not include P2SH scripts. P2SH sigop counting requires that the previous output is known to be a P2SH output.
  @param tx The transaction.
@@ -0,0 +1,250 @@
+//
+//  CBAddressIndex.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+//  SEE HEADER FILE FOR DOCUMENTATION
+
+#include "CBAddressIndex.h"
+
+struct CBAddressIndexSection{
+	char * text; // The start of the section, which starts on a new line.
+	size_t length; // The length of the section which ends after a newline or at the end of the text.
+	CBBase58Prefix prefix; // The expected address prefix.
+	unsigned char (*hashes)[20]; // The decoded hashes, sorted.
+	int hashNum;
+	int * badLines; // The bad line numbers relative to the start of the section, starting at zero.
+	int badLineNum;
+	int lineNum; // The number of lines in the section.
+};
+
+//  Initialiser
+
+bool CBInitAddressIndexFromText(CBAddressIndex * self, char * text, size_t length, CBBase58Prefix prefix, int numThreads) {
+	
+	if (numThreads < 1)
+		numThreads = CBGetNumberOfCores();
+	
+	// Do not give threads tiny sections.
+	int sectionNum = length / 65536 + 1;
+	if (sectionNum > numThreads)
+		sectionNum = numThreads;
+	
+	// Split the text into sections on line boundaries
+	CBAddressIndexSection * sections = malloc(sizeof(*sections) * sectionNum);
+	size_t cursor = 0;
+	
+	for (int x = 0; x < sectionNum; x++) {
+		
+		size_t end = length;
+		
+		if (x != sectionNum - 1) {
+			end = length / sectionNum * (x + 1);
+			if (end < cursor)
+				end = cursor;
+			char * newline = memchr(text + end, '\n', length - end);
+			end = newline ? (size_t)(newline - text) + 1 : length;
+		}
+		
+		sections[x].text = text + cursor;
+		sections[x].length = end - cursor;
+		sections[x].prefix = prefix;
+		cursor = end;
+		
+	}
+	
+	// Decode the sections
+	CBThreadPoolRun(CBAddressIndexProcess, sections, sectionNum, sectionNum);
+	
+	// Collect the sorted runs of hashes from each section and the bad lines with absolute line numbers.
+	int hashNum = 0;
+	int badLineNum = 0;
+	
+	for (int x = 0; x < sectionNum; x++) {
+		hashNum += sections[x].hashNum;
+		badLineNum += sections[x].badLineNum;
+	}
+	
+	unsigned char (*hashes)[20] = malloc(sizeof(*hashes) * (hashNum + 1));
+	int * runs = malloc(sizeof(*runs) * (sectionNum + 1));
+	
+	self->badLines = malloc(sizeof(*self->badLines) * (badLineNum + 1));
+	self->badLineNum = 0;
+	
+	int lineOffset = 1;
+	runs[0] = 0;
+	
+	for (int x = 0; x < sectionNum; x++) {
+		
+		memcpy(hashes + runs[x], sections[x].hashes, sizeof(*hashes) * sections[x].hashNum);
+		runs[x + 1] = runs[x] + sections[x].hashNum;
+		
+		for (int y = 0; y < sections[x].badLineNum; y++)
+			self->badLines[self->badLineNum++] = sections[x].badLines[y] + lineOffset;
+		lineOffset += sections[x].lineNum;
+		
+		free(sections[x].hashes);
+		free(sections[x].badLines);
+		
+	}
+	
+	free(sections);
+	
+	// Merge pairs of runs until there is one run
+	unsigned char (*temp)[20] = malloc(sizeof(*temp) * (hashNum + 1));
+	int runNum = sectionNum;
+	
+	while (runNum > 1) {
+		
+		int newRunNum = 0;
+		
+		for (int x = 0; x < runNum; x += 2) {
+			
+			int a = runs[x];
+			int out = a;
+			
+			if (x + 1 == runNum) {
+				// Odd run out
+				memcpy(temp + a, hashes + a, sizeof(*hashes) * (runs[x + 1] - a));
+			}else{
+				
+				int aEnd = runs[x + 1];
+				int b = aEnd;
+				int bEnd = runs[x + 2];
+				
+				while (a < aEnd && b < bEnd) {
+					if (memcmp(hashes[b], hashes[a], 20) < 0)
+						memcpy(temp[out++], hashes[b++], 20);
+					else
+						memcpy(temp[out++], hashes[a++], 20);
+				}
+				
+				memcpy(temp + out, hashes + a, sizeof(*hashes) * (aEnd - a));
+				out += aEnd - a;
+				memcpy(temp + out, hashes + b, sizeof(*hashes) * (bEnd - b));
+				
+			}
+			
+			runs[newRunNum++] = runs[x];
+			
+		}
+		
+		runs[newRunNum] = hashNum;
+		runNum = newRunNum;
+		
+		unsigned char (*swap)[20] = hashes;
+		hashes = temp;
+		temp = swap;
+		
+	}
+	
+	free(temp);
+	free(runs);
+	
+	// Remove duplicates
+	self->hashNum = 0;
+	
+	for (int x = 0; x < hashNum; x++)
+		if (!self->hashNum || memcmp(hashes[x], hashes[self->hashNum - 1], 20))
+			memmove(hashes[self->hashNum++], hashes[x], 20);
+	
+	self->hashes = hashes;
+	
+	return self->badLineNum == 0;
+	
+}
+
+//  Destructor
+
+void CBDestroyAddressIndex(CBAddressIndex * self) {
+	
+	free(self->hashes);
+	free(self->badLines);
+	
+}
+
+//  Functions
+
+int CBAddressIndexCompare(const void * a, const void * b) {
+	
+	return memcmp(a, b, 20);
+	
+}
+
+bool CBAddressIndexContains(CBAddressIndex * self, unsigned char * hash) {
+	
+	return bsearch(hash, self->hashes, self->hashNum, sizeof(*self->hashes), CBAddressIndexCompare) != NULL;
+	
+}
+
+void CBAddressIndexProcess(void * sections, int item) {
+	
+	CBAddressIndexSectionDecode((CBAddressIndexSection *)sections + item);
+	
+}
+
+void CBAddressIndexSectionDecode(CBAddressIndexSection * section) {
+	
+	// Count the lines to allocate the hashes
+	section->lineNum = 0;
+	
+	for (char * cursor = section->text, * end = section->text + section->length; cursor < end; section->lineNum++) {
+		char * newline = memchr(cursor, '\n', end - cursor);
+		cursor = newline ? newline + 1 : end;
+	}
+	
+	section->hashes = malloc(sizeof(*section->hashes) * (section->lineNum + 1));
+	section->hashNum = 0;
+	section->badLines = NULL;
+	section->badLineNum = 0;
+	
+	char * cursor = section->text;
+	char * end = section->text + section->length;
+	
+	for (int line = 0; line < section->lineNum; line++) {
+		
+		char * newline = memchr(cursor, '\n', end - cursor);
+		char * lineEnd = newline ? newline : end;
+		
+		// Trim whitespace
+		while (cursor < lineEnd && (*cursor == ' ' || *cursor == '\t'))
+			cursor++;
+		while (lineEnd > cursor && (lineEnd[-1] == ' ' || lineEnd[-1] == '\t' || lineEnd[-1] == '\r'))
+			lineEnd--;
+		
+		if (cursor != lineEnd) {
+			
+			// 1 prefix byte, 20 hash bytes and 4 checksum bytes.
+			unsigned char data[25];
+			
+			if (lineEnd - cursor <= 40
+				&& CBDecodeBase58CheckedFixed(data, 25, cursor, lineEnd - cursor)
+				&& data[0] == section->prefix)
+				memcpy(section->hashes[section->hashNum++], data + 1, 20);
+			else{
+				if (!(section->badLineNum & (section->badLineNum - 1))) {
+					// Grow to the next power of two
+					int * temp = realloc(section->badLines, sizeof(*section->badLines) * (section->badLineNum ? section->badLineNum * 2 : 1));
+					section->badLines = temp;
+				}
+				section->badLines[section->badLineNum++] = line;
+			}
+			
+		}
+		
+		cursor = newline ? newline + 1 : end;
+		
+	}
+	
+	qsort(section->hashes, section->hashNum, sizeof(*section->hashes), CBAddressIndexCompare);
+	
+}
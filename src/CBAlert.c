@@ -15,6 +15,7 @@
 //  SEE HEADER FILE FOR DOCUMENTATION 
 
 #include "CBAlert.h"
+#include "CBCursor.h"
 
 //  Constructors
 
@@ -158,7 +159,10 @@ int CBAlertDeserialise(CBAlert * self) {
 		return CB_DESERIALISE_ERROR;
 	}
 	
-	CBVarInt payloadLen = CBByteArrayReadVarInt(bytes, 0);
+	CBCursor cursor;
+	CBInitCursor(&cursor, bytes);
+	CBVarInt payloadLen;
+	CBCursorReadVarInt(&cursor, &payloadLen); // There are at least 47 bytes
 	if (bytes->length < payloadLen.size + payloadLen.val + 1) { // Plus one byte for signature var int. After this check the payload size is used to check the payload contents.
 		CBLogError("Attempting to deserialise a CBAlert with less bytes than required for payload.");
 		return CB_DESERIALISE_ERROR;
@@ -172,51 +176,40 @@ int CBAlertDeserialise(CBAlert * self) {
 		return CB_DESERIALISE_ERROR;
 	}
 	
-	int cursor = payloadLen.size;
-	
-	self->version = CBByteArrayReadInt32(bytes, cursor);
-	cursor += 4;
-	self->relayUntil = CBByteArrayReadInt64(bytes, cursor);
-	cursor += 8;
-	self->expiration = CBByteArrayReadInt64(bytes, cursor);
-	cursor += 8;
-	self->ID = CBByteArrayReadInt32(bytes, cursor);
-	cursor += 4;
-	self->cancel = CBByteArrayReadInt32(bytes, cursor);
-	cursor += 4;
+	self->version = CBCursorReadInt32(&cursor);
+	self->relayUntil = CBCursorReadInt64(&cursor);
+	self->expiration = CBCursorReadInt64(&cursor);
+	self->ID = CBCursorReadInt32(&cursor);
+	self->cancel = CBCursorReadInt32(&cursor);
 	
 	// Add cancel ids
-	CBVarInt setCancelLen = CBByteArrayReadVarInt(bytes, cursor);
+	CBVarInt setCancelLen;
+	CBCursorReadVarInt(&cursor, &setCancelLen);
 	if (payloadLen.val < 44 + setCancelLen.size + setCancelLen.val * 4) {
 		CBLogError("Attempting to deserialise a CBAlert with a payload var int smaller than required to cover the cancel set.");
 		return CB_DESERIALISE_ERROR;
 	}
 	
 	self->setCancelNum = setCancelLen.val;
-	cursor += setCancelLen.size;
 	
 	if (self->setCancelNum) {
 		self->setCancel = malloc(sizeof(*self->setCancel) * self->setCancelNum);
-		for (int x = 0; x < self->setCancelNum; x++) {
-			CBByteArrayReadInt32(bytes, cursor);
-			cursor += 4;
-		}
+		for (int x = 0; x < self->setCancelNum; x++)
+			self->setCancel[x] = CBCursorReadInt32(&cursor);
 	}
 	
-	self->minVer = CBByteArrayReadInt32(bytes, cursor);
-	cursor += 4;
-	self->maxVer = CBByteArrayReadInt32(bytes, cursor);
-	cursor += 4;
+	self->minVer = CBCursorReadInt32(&cursor);
+	self->maxVer = CBCursorReadInt32(&cursor);
 	
 	// User Agent strings
-	CBVarInt userAgentsLen = CBByteArrayReadVarInt(bytes, cursor);
-	if (payloadLen.val < 7 + cursor + userAgentsLen.size + userAgentsLen.val - payloadLen.size) { // 7 for priority and 3 strings
+	CBVarInt userAgentsLen;
+	CBCursorReadVarInt(&cursor, &userAgentsLen);
+	if (payloadLen.val < 7 + cursor.offset + userAgentsLen.val - payloadLen.size) { // 7 for priority and 3 strings
 		CBLogError("Attempting to deserialise a CBAlert with a payload var int smaller than required to cover the cancel set and the user agent set assuming empty strings.");
 		return CB_DESERIALISE_ERROR;
 	}
 	
 	self->userAgentNum = userAgentsLen.val;
-	cursor += userAgentsLen.size;
 	
 	if (self->userAgentNum) {
 		
@@ -225,89 +218,85 @@ int CBAlertDeserialise(CBAlert * self) {
 		for (int x = 0; x < self->userAgentNum; x++) {
 			// Add each user agent checking each time for space in the payload.
 			// No need to check space as there is enough data afterwards for safety.
-			CBVarInt userAgentLen = CBByteArrayReadVarInt(bytes, cursor);
-			cursor += userAgentLen.size;
+			CBVarInt userAgentLen;
+			CBCursorReadVarInt(&cursor, &userAgentLen);
 			
-			if (payloadLen.val < 7 + cursor + userAgentLen.val + self->userAgentNum - x - payloadLen.size) { // 7 for priority and 3 strings. The current user agent size and the rest as if empty strings.
+			if (payloadLen.val < 7 + cursor.offset + userAgentLen.val + self->userAgentNum - x - payloadLen.size) { // 7 for priority and 3 strings. The current user agent size and the rest as if empty strings.
 				CBLogError("Attempting to deserialise a CBAlert with a payload var int smaller than required to cover the cancel set and the user agent set up to user agent %" PRIu16 ".", x);
 				return CB_DESERIALISE_ERROR;
 			}
 			
 			// Enough space so set user agent
 			if (userAgentLen.val){
-				self->userAgents[x] = CBNewByteArraySubReference(bytes, cursor, (int)userAgentLen.val);
+				self->userAgents[x] = CBNewByteArraySubReference(bytes, cursor.offset, (int)userAgentLen.val);
 				CBByteArraySanitise(self->userAgents[x]);
 			}else
 				self->userAgents[x] = NULL;
 			
-			cursor += userAgentLen.val;
+			CBCursorSkip(&cursor, (int)userAgentLen.val);
 		}
 		
 	}
 	
-	self->priority = CBByteArrayReadInt32(bytes, cursor);
-	cursor += 4;
+	self->priority = CBCursorReadInt32(&cursor);
 	
 	// Strings. Make sure to check the first byte in the var ints to ensure enough space
-	int size = CBByteArrayReadVarIntSize(bytes, cursor);
+	int size = CBVarIntDecodeSize(CBCursorPointer(&cursor), 0);
 	
-	if (payloadLen.val < cursor + size + 2u - payloadLen.size) {
+	if (payloadLen.val < cursor.offset + size + 2u - payloadLen.size) {
 		CBLogError("Attempting to deserialise a CBAlert with a payload var int smaller than required to cover the hidden string var int.");
 		return CB_DESERIALISE_ERROR;
 	}
 		
-	CBVarInt hiddenCommentLen = CBByteArrayReadVarInt(bytes, cursor);
-	cursor += size;
+	CBVarInt hiddenCommentLen;
+	CBCursorReadVarInt(&cursor, &hiddenCommentLen);
 	
-	if (payloadLen.val < cursor + hiddenCommentLen.val + 2 - payloadLen.size) {
+	if (payloadLen.val < cursor.offset + hiddenCommentLen.val + 2 - payloadLen.size) {
 		CBLogError("Attempting to deserialise a CBAlert with a payload var int smaller than required to cover the hidden string.");
 		return CB_DESERIALISE_ERROR;
 	}
 		
-	self->hiddenComment = hiddenCommentLen.val ? CBNewByteArraySubReference(bytes, cursor, (int)hiddenCommentLen.val) : NULL;
-	cursor += hiddenCommentLen.val;
+	self->hiddenComment = hiddenCommentLen.val ? CBNewByteArraySubReference(bytes, cursor.offset, (int)hiddenCommentLen.val) : NULL;
+	CBCursorSkip(&cursor, (int)hiddenCommentLen.val);
 	
 	// Displayed string.
-	size = CBByteArrayReadVarIntSize(bytes, cursor);
+	size = CBVarIntDecodeSize(CBCursorPointer(&cursor), 0);
 	
-	if (payloadLen.val >= cursor + size + 1u - payloadLen.size) {
+	if (payloadLen.val >= cursor.offset + size + 1u - payloadLen.size) {
 		
-		CBVarInt displayedCommentLen = CBByteArrayReadVarInt(bytes, cursor);
-		cursor += size;
+		CBVarInt displayedCommentLen;
+		CBCursorReadVarInt(&cursor, &displayedCommentLen);
 		
-		if (payloadLen.val >= cursor + displayedCommentLen.val + 1 - payloadLen.size) {
+		if (payloadLen.val >= cursor.offset + displayedCommentLen.val + 1 - payloadLen.size) {
 			
-			self->displayedComment = displayedCommentLen.val ? CBNewByteArraySubReference(bytes, cursor, (int)displayedCommentLen.val) : NULL;
-			cursor += displayedCommentLen.val;
+			self->displayedComment = displayedCommentLen.val ? CBNewByteArraySubReference(bytes, cursor.offset, (int)displayedCommentLen.val) : NULL;
+			CBCursorSkip(&cursor, (int)displayedCommentLen.val);
 			
 			// Reserved string
-			size = CBByteArrayReadVarIntSize(bytes, cursor);
+			size = CBVarIntDecodeSize(CBCursorPointer(&cursor), 0);
 			
-			if (payloadLen.val >= cursor + size - payloadLen.size) {
+			if (payloadLen.val >= cursor.offset + size - payloadLen.size) {
 				
-				CBVarInt reservedLen = CBByteArrayReadVarInt(bytes, cursor);
-				cursor += size;
+				CBVarInt reservedLen;
+				CBCursorReadVarInt(&cursor, &reservedLen);
 				
-				if (payloadLen.val == cursor + reservedLen.val - payloadLen.size) {
+				if (payloadLen.val == cursor.offset + reservedLen.val - payloadLen.size) {
 					
-					self->reserved = reservedLen.val ? CBNewByteArraySubReference(bytes, cursor, (int)reservedLen.val) : NULL;
-					cursor += reservedLen.val;
+					self->reserved = reservedLen.val ? CBNewByteArraySubReference(bytes, cursor.offset, (int)reservedLen.val) : NULL;
+					CBCursorSkip(&cursor, (int)reservedLen.val);
 					
 					// Finally do signature
-					size  = CBByteArrayReadVarIntSize(bytes, cursor);
+					CBVarInt sigLen;
 					
-					if (bytes->length >= cursor + size) {
-						
-						CBVarInt sigLen = CBByteArrayReadVarInt(bytes, cursor);
-						cursor += size;
+					if (CBCursorReadVarInt(&cursor, &sigLen)) {
 						
-						if (bytes->length >= cursor + sigLen.val){
+						if (CBCursorHas(&cursor, sigLen.val)){
 							
 							self->payload = CBNewByteArraySubReference(bytes, payloadLen.size, (int)payloadLen.val);
-							self->signature = CBNewByteArraySubReference(bytes, cursor, (int)sigLen.val);
+							self->signature = CBNewByteArraySubReference(bytes, cursor.offset, (int)sigLen.val);
 							
 							// Done signature OK. Now return successfully.
-							return cursor += sigLen.val;
+							return cursor.offset + (int)sigLen.val;
 							
 						}else
 							CBLogError("Attempting to deserialise a CBAlert with a byte array length smaller than required to cover the signature.");
@@ -328,7 +317,7 @@ int CBAlertDeserialise(CBAlert * self) {
 			if (self->displayedComment) CBReleaseObject(self->displayedComment);
 			
 		}else
-			CBLogError("Attempting to deserialise a CBAlert with a payload var int smaller than required to cover the displayed string. %" PRIu64 " < %" PRIu64, payloadLen.val, cursor + displayedCommentLen.val + 1);
+			CBLogError("Attempting to deserialise a CBAlert with a payload var int smaller than required to cover the displayed string. %" PRIu64 " < %" PRIu64, payloadLen.val, cursor.offset + displayedCommentLen.val + 1);
 		
 	}else
 		CBLogError("Attempting to deserialise a CBAlert with a payload var int smaller than required to cover the displayed string var int.");
@@ -89,6 +89,64 @@ bool CBDecodeBase58Checked(CBBigInt * bi, char * str){
 	return true;
 }
 
+bool CBDecodeBase58CheckedFixed(unsigned char * bytes, int size, char * str, int strLen) {
+	
+	memset(bytes, 0, size);
+	
+	int ones = 0;
+	while (ones < strLen && str[ones] == '1')
+		ones++;
+	
+	for (int x = ones; x < strLen; x++) {
+		
+		// Get index in alphabet array
+		int digit = str[x];
+		if (digit < '1' || digit > 'z')
+			return false;
+		if (digit <= '9') // Numbers
+			digit -= '1';
+		else if (digit >= 'A' && digit <= 'H')
+			digit -= 'A' - 9;
+		else if (digit >= 'J' && digit <= 'N')
+			digit -= 'J' - 17;
+		else if (digit >= 'P' && digit <= 'Z')
+			digit -= 'P' - 22;
+		else if (digit >= 'a' && digit <= 'k')
+			digit -= 'a' - 33;
+		else if (digit >= 'm')
+			digit -= 'm' - 44;
+		else
+			return false;
+		
+		// bytes = bytes * 58 + digit
+		int carry = digit;
+		for (int y = size; y--;) {
+			carry += bytes[y] * 58;
+			bytes[y] = carry;
+			carry >>= 8;
+		}
+		if (carry)
+			// Too large
+			return false;
+		
+	}
+	
+	// Each leading one is a zero byte and the remaining data must not have any more, else the data is shorter than expected.
+	int zeros = 0;
+	while (zeros < size && !bytes[zeros])
+		zeros++;
+	if (zeros != ones)
+		return false;
+	
+	// Check the checksum
+	unsigned char checksum[32];
+	CBSha256(bytes, size - 4, checksum);
+	CBSha256(checksum, 32, checksum);
+	
+	return !memcmp(checksum, bytes + size - 4, 4);
+	
+}
+
 char * CBEncodeBase58(CBBigInt * bi) {
 
 	// XXX Improvements?
@@ -15,6 +15,7 @@
 //  SEE HEADER FILE FOR DOCUMENTATION
 
 #include "CBBlock.h"
+#include "CBCompactTransaction.h"
 
 //  Constructor2
 
@@ -38,6 +39,15 @@ CBBlock * CBNewBlockFromData(CBByteArray * data) {
 	
 }
 
+CBBlock * CBNewBlockFromDataWithArena(CBByteArray * data) {
+	
+	CBBlock * self = CBNewBlockFromData(data);
+	self->arena = CBNewArena();
+	
+	return self;
+	
+}
+
 CBBlock * CBNewBlockGenesis() {
 	
 	CBBlock * self = malloc(sizeof(*self));
@@ -67,6 +77,7 @@ void CBInitBlock(CBBlock * self) {
 	self->transactions = NULL;
 	self->transactionNum = 0;
 	self->hashSet = false;
+	self->arena = NULL;
 	memset(self->hash, 0, 32);
 	
 	CBInitMessageByObject(CBGetMessage(self));
@@ -80,6 +91,7 @@ void CBInitBlockFromData(CBBlock * self, CBByteArray * data) {
 	self->transactions = NULL;
 	self->transactionNum = 0;
 	self->hashSet = false;
+	self->arena = NULL;
 	memset(self->hash, 0, 32);
 	
 	CBInitMessageByData(CBGetMessage(self), data);
@@ -94,6 +106,7 @@ void CBInitBlockGenesis(CBBlock * self) {
 	
 	memcpy(self->hash, genesisHash, 32);
 	self->hashSet = true;
+	self->arena = NULL;
 	
 	CBInitMessageByData(CBGetMessage(self), data);
 	CBReleaseObject(data);
@@ -109,6 +122,7 @@ void CBInitBlockGenesisHeader(CBBlock * self) {
 	
 	memcpy(self->hash, genesisHash, 32);
 	self->hashSet = true;
+	self->arena = NULL;
 	
 	CBInitMessageByData(CBGetMessage(self), data);
 	CBReleaseObject(data);
@@ -134,6 +148,10 @@ void CBDestroyBlock(void * vself) {
 	
 	CBDestroyMessage(CBGetObject(self));
 	
+	// The arena is freed once all of the objects in it are freed too.
+	if (self->arena)
+		CBArenaRelease(self->arena);
+	
 }
 void CBFreeBlock(void * self) {
 	
@@ -195,25 +213,23 @@ unsigned char * CBBlockCalculateMerkleRoot(CBBlock * self) {
 
 int CBBlockDeserialise(CBBlock * self, bool transactions) {
 	
-	CBByteArray * bytes = CBGetMessage(self)->bytes;
-	if (! bytes) {
-		CBLogError("Attempting to deserialise a CBBlock with no bytes.");
-		return CB_DESERIALISE_ERROR;
-	}
-	if (bytes->length < 82) {
-		CBLogError("Attempting to deserialise a CBBlock with less than 82 bytes (%u bytes). Minimum for header (With null byte).", bytes->length);
-		return CB_DESERIALISE_ERROR;
-	}
+	CBArena * prevArena = CBSetCurrentArena(self->arena);
+	int len = CBBlockDeserialiseData(self, transactions);
+	CBSetCurrentArena(prevArena);
 	
-	self->version = CBByteArrayReadInt32(bytes, 0);
-	self->prevBlockHash = CBByteArraySubReference(bytes, 4, 32);
-	self->merkleRoot = CBByteArraySubReference(bytes, 36, 32);
-	self->time = CBByteArrayReadInt32(bytes, 68);
-	self->target = CBByteArrayReadInt32(bytes, 72);
-	self->nonce = CBByteArrayReadInt32(bytes, 76);
+	return len;
+	
+}
+
+int CBBlockDeserialiseData(CBBlock * self, bool transactions) {
+	
+	CBByteArray * bytes = CBGetMessage(self)->bytes;
+	CBCursor cursor;
+	CBVarInt txNumVI;
 	
 	// If first VarInt is zero, then stop here for headers, otherwise look for 8 more bytes and continue
-	CBVarInt txNumVI = CBByteArrayReadVarInt(bytes, 80);
+	if (! CBBlockDeserialiseHeader(self, &cursor, &txNumVI))
+		return CB_DESERIALISE_ERROR;
 	
 	if (transactions && txNumVI.val) {
 		
@@ -224,7 +240,7 @@ int CBBlockDeserialise(CBBlock * self, bool transactions) {
 			return CB_DESERIALISE_ERROR;
 		}
 		
-		if (txNumVI.val * 60 > bytes->length - 81) {
+		if (txNumVI.val < 0 || txNumVI.val > (bytes->length - 81) / 60) {
 			CBLogError("Attempting to deserialise a CBBlock with too many transactions for the byte data length.");
 			return CB_DESERIALISE_ERROR;
 		}
@@ -232,17 +248,18 @@ int CBBlockDeserialise(CBBlock * self, bool transactions) {
 		self->transactionNum = (int)txNumVI.val;
 		self->transactions = malloc(sizeof(*self->transactions) * self->transactionNum);
 		
-		int cursor = 80 + txNumVI.size;
-		
 		for (int x = 0; x < self->transactionNum; x++) {
 			
-			CBByteArray * data = CBByteArraySubReference(bytes, cursor, bytes->length-cursor);
+			CBByteArray * data = CBByteArraySubReference(bytes, cursor.offset, bytes->length - cursor.offset);
 			CBTransaction * transaction = CBNewTransactionFromData(data);
 			int len = CBTransactionDeserialise(transaction);
 			
 			if (len == CB_DESERIALISE_ERROR){
 				CBLogError("CBBlock cannot be deserialised because of an error with the transaction number %" PRIu16 ".", x);
 				CBReleaseObject(data);
+				CBReleaseObject(transaction);
+				// Only release the transactions which were deserialised
+				self->transactionNum = x;
 				return CB_DESERIALISE_ERROR;
 			}
 			
@@ -250,31 +267,177 @@ int CBBlockDeserialise(CBBlock * self, bool transactions) {
 			data->length = len;
 			CBReleaseObject(data);
 			self->transactions[x] = transaction;
-			cursor += len;
+			CBCursorSkip(&cursor, len);
 			
 		}
 		
-		return cursor;
+		return cursor.offset;
 	}
 	// Just header
 	
-	if (bytes->length < 80 + txNumVI.size + 1) {
+	if (! CBCursorHas(&cursor, 1)) {
 		CBLogError("Attempting to deserialise a CBBlock header with not enough space to cover the var int.");
 		return CB_DESERIALISE_ERROR;
 	}
 	
 	// This value is undefined in the protocol. Should best be zero when getting the headers since there is not supposed to be any transactions. Would have probably been better if the var int was dropped completely for headers only.
-	self->transactionNum = (int)CBByteArrayReadVarInt(bytes, 80).val;
+	self->transactionNum = (int)txNumVI.val;
 
 	self->transactions = NULL;
 	
 	// Ensure null byte is null. This null byte is a bit of a nuissance but it exists in the protocol when there are no transactions.
-	if (CBByteArrayGetByte(bytes, 80 + txNumVI.size) != 0) {
+	if (CBCursorReadByte(&cursor) != 0) {
 		CBLogError("Attempting to deserialise a CBBlock header with a final byte which is not null.");
 		return CB_DESERIALISE_ERROR;
 	}
 	
-	return 80 + txNumVI.size + 1; // 80 header bytes, the var int and the null byte
+	return cursor.offset; // 80 header bytes, the var int and the null byte
+	
+}
+
+bool CBBlockDeserialiseHeader(CBBlock * self, CBCursor * cursor, CBVarInt * txNum) {
+	
+	CBByteArray * bytes = CBGetMessage(self)->bytes;
+	if (! bytes) {
+		CBLogError("Attempting to deserialise a CBBlock with no bytes.");
+		return false;
+	}
+	if (bytes->length < 82) {
+		CBLogError("Attempting to deserialise a CBBlock with less than 82 bytes (%u bytes). Minimum for header (With null byte).", bytes->length);
+		return false;
+	}
+	
+	CBInitCursor(cursor, bytes);
+	self->version = CBCursorReadInt32(cursor);
+	self->prevBlockHash = CBByteArraySubReference(bytes, 4, 32);
+	self->merkleRoot = CBByteArraySubReference(bytes, 36, 32);
+	CBCursorSkip(cursor, 64);
+	self->time = CBCursorReadInt32(cursor);
+	self->target = CBCursorReadInt32(cursor);
+	self->nonce = CBCursorReadInt32(cursor);
+	
+	if (! CBCursorReadVarInt(cursor, txNum)) {
+		CBLogError("Attempting to deserialise a CBBlock with not enough space to cover the var int.");
+		return false;
+	}
+	
+	return true;
+	
+}
+
+void CBBlockDeserialiseProcess(void * vjob, int item) {
+	
+	CBBlockDeserialiseJob * job = vjob;
+	long long int txNum = job->block->transactionNum;
+	
+	if (! CBBlockDeserialiseTransactions(job, (int)(txNum * item / job->itemNum), (int)(txNum * (item + 1) / job->itemNum)))
+		__atomic_store_n(&job->failed, true, __ATOMIC_RELAXED);
+	
+}
+
+bool CBBlockDeserialiseTransactions(CBBlockDeserialiseJob * job, int start, int end) {
+	
+	for (int x = start; x < end; x++) {
+		
+		CBTransaction * tx = job->block->transactions[x];
+		
+		if (CBTransactionDeserialise(tx) != CBGetMessage(tx)->bytes->length) {
+			CBLogError("CBBlock cannot be deserialised because of an error with the transaction number %i.", x);
+			return false;
+		}
+		
+		if (job->hash)
+			CBTransactionGetHash(tx);
+		
+	}
+	
+	return true;
+	
+}
+
+int CBBlockDeserialiseWithThreads(CBBlock * self, bool hash, int numThreads) {
+	
+	CBCursor cursor;
+	CBVarInt txNumVI;
+	
+	if (! CBBlockDeserialiseHeader(self, &cursor, &txNumVI))
+		return CB_DESERIALISE_ERROR;
+	
+	// A header only block has nothing to do in parallel
+	if (txNumVI.val == 0) {
+		CBReleaseObject(self->prevBlockHash);
+		CBReleaseObject(self->merkleRoot);
+		return CBBlockDeserialise(self, true);
+	}
+	
+	if (txNumVI.val < 0 || txNumVI.val > (cursor.length - 81) / 60) {
+		CBLogError("Attempting to deserialise a CBBlock with too many transactions for the byte data length.");
+		return CB_DESERIALISE_ERROR;
+	}
+	
+	// Find the transaction boundaries without making any objects
+	int txNum = (int)txNumVI.val;
+	int * offsets = malloc(sizeof(*offsets) * (txNum + 1));
+	offsets[0] = cursor.offset;
+	
+	for (int x = 0; x < txNum; x++) {
+		
+		int inputNum, outputNum, length;
+		
+		if (! CBCompactTransactionMeasure(cursor.data + offsets[x], cursor.length - offsets[x], &inputNum, &outputNum, &length)) {
+			CBLogError("CBBlock cannot be deserialised because of an error with the transaction number %i.", x);
+			free(offsets);
+			return CB_DESERIALISE_ERROR;
+		}
+		
+		offsets[x + 1] = offsets[x] + length;
+		
+	}
+	
+	// Make the transactions with the block arena. The objects made by other threads do not use the arena.
+	CBArena * prevArena = CBSetCurrentArena(self->arena);
+	CBByteArray * bytes = CBGetMessage(self)->bytes;
+	
+	self->transactionNum = txNum;
+	self->transactions = malloc(sizeof(*self->transactions) * txNum);
+	
+	for (int x = 0; x < txNum; x++) {
+		CBByteArray * data = CBByteArraySubReference(bytes, offsets[x], offsets[x + 1] - offsets[x]);
+		self->transactions[x] = CBNewTransactionFromData(data);
+		CBReleaseObject(data);
+	}
+	
+	CBSetCurrentArena(prevArena);
+	
+	int length = offsets[txNum];
+	free(offsets);
+	
+	// Deserialise the transactions
+	if (numThreads < 1)
+		numThreads = CBGetNumberOfCores();
+	if (numThreads > txNum)
+		numThreads = txNum;
+	
+	// Use more ranges than threads so that the threads are balanced when the transaction sizes vary.
+	CBBlockDeserialiseJob job = {self, hash, false, numThreads == 1 ? 1 : numThreads * 4};
+	if (job.itemNum > txNum)
+		job.itemNum = txNum;
+	
+	CBThreadPoolRun(CBBlockDeserialiseProcess, &job, job.itemNum, numThreads);
+	
+	if (job.failed) {
+		
+		for (int x = 0; x < txNum; x++)
+			CBReleaseObject(self->transactions[x]);
+		free(self->transactions);
+		self->transactions = NULL;
+		self->transactionNum = 0;
+		
+		return CB_DESERIALISE_ERROR;
+		
+	}
+	
+	return length;
 	
 }
 
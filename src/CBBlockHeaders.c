@@ -15,6 +15,7 @@
 //  SEE HEADER FILE FOR DOCUMENTATION 
 
 #include "CBBlockHeaders.h"
+#include "CBCursor.h"
 
 //  Constructors
 
@@ -43,6 +44,7 @@ CBBlockHeaders * CBNewBlockHeadersFromData(CBByteArray * data) {
 void CBInitBlockHeaders(CBBlockHeaders * self) {
 	
 	self->headerNum = 0;
+	self->headerArray = NULL;
 	CBInitMessageByObject(CBGetMessage(self));
 	
 }
@@ -50,6 +52,7 @@ void CBInitBlockHeaders(CBBlockHeaders * self) {
 void CBInitBlockHeadersFromData(CBBlockHeaders * self, CBByteArray * data) {
 	
 	self->headerNum = 0;
+	self->headerArray = NULL;
 	CBInitMessageByData(CBGetMessage(self), data);
 	
 }
@@ -61,6 +64,8 @@ void CBDestroyBlockHeaders(void * vself) {
 	CBBlockHeaders * self = vself;
 	for (int x = 0; x < self->headerNum; x++)
 		CBReleaseObject(self->blockHeaders[x]);
+	if (self->headerArray)
+		CBReleaseObject(self->headerArray);
 	CBDestroyMessage(self);
 	
 }
@@ -83,6 +88,9 @@ void CBBlockHeadersAddBlockHeader(CBBlockHeaders * self, CBBlock * header) {
 
 int CBBlockHeadersCalculateLength(CBBlockHeaders * self) {
 	
+	if (self->headerArray)
+		return CBHeaderArrayPayloadLength(self->headerArray);
+	
 	return CBVarIntSizeOf(self->headerNum) + self->headerNum * 81;
 	
 }
@@ -99,7 +107,13 @@ int CBBlockHeadersDeserialise(CBBlockHeaders * self) {
 		return CB_DESERIALISE_ERROR;
 	}
 	
-	CBVarInt headerNum = CBByteArrayReadVarInt(bytes, 0);
+	CBCursor cursor;
+	CBInitCursor(&cursor, bytes);
+	CBVarInt headerNum;
+	if (! CBCursorReadVarInt(&cursor, &headerNum)) {
+		CBLogError("Attempting to deserialise a CBBlockHeaders with less bytes than required for the var int.");
+		return CB_DESERIALISE_ERROR;
+	}
 	if (headerNum.val > 2000) {
 		CBLogError("Attempting to deserialise a CBBlockHeaders with a var int over 2000.");
 		return CB_DESERIALISE_ERROR;
@@ -107,12 +121,11 @@ int CBBlockHeadersDeserialise(CBBlockHeaders * self) {
 	
 	// Deserialise each header
 	self->headerNum = headerNum.val;
-	int cursor = headerNum.size;
 	
 	for (int x = 0; x < headerNum.val; x++) {
 		
 		// Make new CBBlock from the rest of the data.
-		CBByteArray * data = CBByteArraySubReference(bytes, cursor, bytes->length-cursor);
+		CBByteArray * data = CBByteArraySubReference(bytes, cursor.offset, bytes->length - cursor.offset);
 		self->blockHeaders[x] = CBNewBlockFromData(data);
 		
 		// Deserialise
@@ -126,11 +139,27 @@ int CBBlockHeadersDeserialise(CBBlockHeaders * self) {
 		// Adjust length
 		data->length = len;
 		CBReleaseObject(data);
-		cursor += len;
+		CBCursorSkip(&cursor, len);
 		
 	}
 	
-	return cursor;
+	return cursor.offset;
+	
+}
+
+int CBBlockHeadersDeserialiseFlat(CBBlockHeaders * self) {
+	
+	CBByteArray * bytes = CBGetMessage(self)->bytes;
+	if (! bytes) {
+		CBLogError("Attempting to deserialise a CBBlockHeaders with no bytes.");
+		return CB_DESERIALISE_ERROR;
+	}
+	
+	if (self->headerArray)
+		CBReleaseObject(self->headerArray);
+	self->headerArray = CBNewHeaderArray(0);
+	
+	return CBHeaderArrayAppendPayload(self->headerArray, CBByteArrayGetData(bytes), bytes->length);
 	
 }
 
@@ -152,6 +181,16 @@ int CBBlockHeadersSerialise(CBBlockHeaders * self, bool force) {
 		return 0;
 	}
 	
+	if (self->headerArray) {
+		if (bytes->length < CBHeaderArrayPayloadLength(self->headerArray)) {
+			CBLogError("Attempting to serialise a CBBlockHeaders with less bytes than required for the header array.");
+			return 0;
+		}
+		bytes->length = CBHeaderArraySerialisePayload(self->headerArray, CBByteArrayGetData(bytes));
+		CBGetMessage(self)->serialised = true;
+		return bytes->length;
+	}
+	
 	CBVarInt num = CBVarIntFromUInt64(self->headerNum);
 	CBByteArraySetVarInt(bytes, 0, num);
 	int cursor = num.size;
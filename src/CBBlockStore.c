@@ -0,0 +1,432 @@
+//
+//  CBBlockStore.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+//  SEE HEADER FILE FOR DOCUMENTATION
+
+#include "CBBlockStore.h"
+
+//  Initialiser
+
+bool CBInitBlockStore(CBBlockStore * self, char * dataDir, uint32_t fileSize) {
+	
+	char filename[strlen(dataDir) + 20];
+	uint64_t length;
+	
+	// Open the index
+	sprintf(filename, "%s/blockIndex.dat", dataDir);
+	if (! CBFileOpen(&self->indexFile, filename, true)) {
+		CBLogError("Could not open the block store index file %s.", filename);
+		return false;
+	}
+	if (! CBFileGetLength(self->indexFile, &length)) {
+		CBLogError("Could not get the length of the block store index file.");
+		CBFileClose(self->indexFile);
+		return false;
+	}
+	bool new = length == 0;
+	if (new) {
+		length = (uint64_t)(CB_BLOCK_STORE_GROW + 1) * sizeof(CBBlockStoreRecord);
+		if (! CBFileSetLength(self->indexFile, length)) {
+			CBLogError("Could not set the length of a new block store index file.");
+			CBFileClose(self->indexFile);
+			return false;
+		}
+	}else if (length % sizeof(CBBlockStoreRecord) || length < 2 * sizeof(CBBlockStoreRecord)) {
+		CBLogError("The block store index file has a bad length.");
+		CBFileClose(self->indexFile);
+		return false;
+	}
+	if (! CBFileMap(self->indexFile, 0, length, (void **)&self->indexHeader)) {
+		CBLogError("Could not map the block store index file.");
+		CBFileClose(self->indexFile);
+		return false;
+	}
+	self->records = (CBBlockStoreRecord *)self->indexHeader + 1;
+	self->capacity = (uint32_t)(length / sizeof(CBBlockStoreRecord) - 1);
+	if (new) {
+		self->indexHeader->magic = CB_BLOCK_STORE_MAGIC;
+		self->indexHeader->recordSize = sizeof(CBBlockStoreRecord);
+		self->indexHeader->fileSize = fileSize ? fileSize : CB_BLOCK_STORE_FILE_SIZE;
+		self->indexHeader->syncedNum = 0;
+	}else if (self->indexHeader->magic != CB_BLOCK_STORE_MAGIC || self->indexHeader->recordSize != sizeof(CBBlockStoreRecord)) {
+		CBLogError("The block store index file is not a block store index or has a different record size.");
+		CBFileUnmap(self->indexHeader, length);
+		CBFileClose(self->indexFile);
+		return false;
+	}
+	
+	self->dataDir = malloc(strlen(dataDir) + 1);
+	strcpy(self->dataDir, dataDir);
+	self->fileSize = self->indexHeader->fileSize;
+	self->files = NULL;
+	self->fileNum = 0;
+	self->openFileNum = 0;
+	self->maxOpenFiles = CB_BLOCK_STORE_MAX_OPEN_FILES;
+	self->useCount = 0;
+	self->table = NULL;
+	self->tableSize = 0;
+	
+	// The synced records are trusted, and records after them are accepted when their blocks were completely written.
+	self->blockNum = self->indexHeader->syncedNum < self->capacity ? self->indexHeader->syncedNum : self->capacity;
+	while (self->blockNum < self->capacity && CBBlockStoreRecordIsValid(self, self->blockNum))
+		self->blockNum++;
+	
+	// Clear the records which were not accepted, so that they are not accepted after later blocks are added.
+	for (uint32_t x = self->blockNum; x < self->capacity && CBBlockStoreGetRecord(self, x)->length; x++)
+		memset(CBBlockStoreGetRecord(self, x), 0, sizeof(CBBlockStoreRecord));
+	
+	// Continue from the end of the last block
+	if (self->blockNum) {
+		CBBlockStoreRecord * last = CBBlockStoreGetRecord(self, self->blockNum - 1);
+		self->appendFile = last->fileID;
+		self->appendOffset = last->offset + last->length;
+	}else{
+		self->appendFile = 0;
+		self->appendOffset = 0;
+	}
+	self->unsyncedFile = self->appendFile;
+	
+	// Make the hash table
+	for (uint32_t x = 0; x < self->blockNum; x++)
+		CBBlockStoreIndex(self, x);
+	
+	return true;
+	
+}
+
+//  Destructor
+
+void CBDestroyBlockStore(CBBlockStore * self) {
+	
+	CBBlockStoreSync(self);
+	CBFileUnmap(self->indexHeader, (uint64_t)(self->capacity + 1) * sizeof(CBBlockStoreRecord));
+	CBFileClose(self->indexFile);
+	for (uint32_t x = 0; x < self->fileNum; x++)
+		if (self->files[x].open)
+			CBBlockStoreCloseFile(self, x);
+	free(self->files);
+	free(self->table);
+	free(self->dataDir);
+	
+}
+
+//  Functions
+
+bool CBBlockStoreAppend(CBBlockStore * self, unsigned char * hash, unsigned char * data, uint32_t length) {
+	
+	// Blocks are only stored once
+	if (CBBlockStoreFind(self, hash))
+		return true;
+	
+	if (length < 80 || length > self->fileSize) {
+		CBLogError("Attempting to add a block to a CBBlockStore with a length of %u which is not between 80 and the file size.", length);
+		return false;
+	}
+	
+	// Use a new block file when the block does not fit in the last.
+	if ((uint64_t)self->appendOffset + length > self->fileSize) {
+		self->appendFile++;
+		self->appendOffset = 0;
+	}
+	CBBlockStoreFile * file = CBBlockStoreGetFile(self, self->appendFile, true);
+	if (! file)
+		return false;
+	if (! CBFileWrite(file->file, data, length, self->appendOffset)) {
+		CBLogError("Could not write a block to the block file %u.", self->appendFile);
+		return false;
+	}
+	
+	// Extend the index file when full
+	if (self->blockNum == self->capacity) {
+		uint64_t oldLength = (uint64_t)(self->capacity + 1) * sizeof(CBBlockStoreRecord);
+		uint64_t newLength = oldLength + (uint64_t)CB_BLOCK_STORE_GROW * sizeof(CBBlockStoreRecord);
+		CBBlockStoreIndexHeader * map;
+		if (! CBFileSetLength(self->indexFile, newLength)) {
+			CBLogError("Could not extend the block store index file.");
+			return false;
+		}
+		CBFileUnmap(self->indexHeader, oldLength);
+		if (! CBFileMap(self->indexFile, 0, newLength, (void **)&map)) {
+			// Try to get the old mapping back.
+			CBLogError("Could not map the extended block store index file.");
+			CBFileSetLength(self->indexFile, oldLength);
+			CBFileMap(self->indexFile, 0, oldLength, (void **)&self->indexHeader);
+			self->records = (CBBlockStoreRecord *)self->indexHeader + 1;
+			return false;
+		}
+		self->indexHeader = map;
+		self->records = (CBBlockStoreRecord *)map + 1;
+		self->capacity += CB_BLOCK_STORE_GROW;
+	}
+	
+	CBBlockStoreRecord * record = CBBlockStoreGetRecord(self, self->blockNum);
+	memcpy(record->hash, hash, 32);
+	record->fileID = self->appendFile;
+	record->offset = self->appendOffset;
+	record->length = length;
+	unsigned char hash1[32], hash2[32];
+	CBSha256(data, length, hash1);
+	CBSha256(hash1, 32, hash2);
+	memcpy(record->checksum, hash2, 4);
+	
+	self->appendOffset += length;
+	CBBlockStoreIndex(self, self->blockNum++);
+	
+	return true;
+	
+}
+
+bool CBBlockStoreAppendBlock(CBBlockStore * self, CBBlock * block) {
+	
+	return CBBlockStoreAppend(self, CBBlockGetHash(block), CBByteArrayGetData(CBGetMessage(block)->bytes), CBGetMessage(block)->bytes->length);
+	
+}
+
+void CBBlockStoreCloseFile(CBBlockStore * self, uint32_t fileID) {
+	
+	CBBlockStoreFile * file = self->files + fileID;
+	
+	// Closing does not write the blocks to disk, so blocks not yet synced are written first.
+	if (file->writable && fileID >= self->unsyncedFile && ! CBFileSync(file->file))
+		CBLogError("Could not sync the block file %u before closing it.", fileID);
+	if (file->map)
+		CBFileUnmap(file->map, file->mapLength);
+	CBFileClose(file->file);
+	file->open = false;
+	self->openFileNum--;
+	
+}
+
+CBBlockStoreRecord * CBBlockStoreFind(CBBlockStore * self, unsigned char * hash) {
+	
+	if (! self->tableSize)
+		return NULL;
+	
+	uint32_t mask = self->tableSize - 1;
+	
+	for (uint32_t slot = CBArrayToInt32(hash, 0) & mask; self->table[slot]; slot = (slot + 1) & mask) {
+		CBBlockStoreRecord * record = CBBlockStoreGetRecord(self, self->table[slot] - 1);
+		if (! memcmp(record->hash, hash, 32))
+			return record;
+	}
+	
+	return NULL;
+	
+}
+
+CBBlock * CBBlockStoreGetBlock(CBBlockStore * self, unsigned char * hash) {
+	
+	CBBlockStoreRecord * record = CBBlockStoreFind(self, hash);
+	if (! record)
+		return NULL;
+	unsigned char * data = CBBlockStoreGetData(self, record);
+	if (! data)
+		return NULL;
+	
+	CBByteArray * bytes = CBNewByteArrayWithDataCopy(data, record->length);
+	CBBlock * block = CBNewBlockFromData(bytes);
+	CBReleaseObject(bytes);
+	if (CBBlockDeserialise(block, true) == CB_DESERIALISE_ERROR) {
+		CBLogError("Could not deserialise a block from the block store.");
+		CBReleaseObject(block);
+		return NULL;
+	}
+	memcpy(block->hash, hash, 32);
+	block->hashSet = true;
+	
+	return block;
+	
+}
+
+unsigned char * CBBlockStoreGetData(CBBlockStore * self, CBBlockStoreRecord * record) {
+	
+	CBBlockStoreFile * file = CBBlockStoreGetFile(self, record->fileID, false);
+	if (! file)
+		return NULL;
+	
+	// Map the file again to its new length when the block was added after it was mapped.
+	uint64_t end = (uint64_t)record->offset + record->length;
+	if (file->mapLength < end) {
+		uint64_t length;
+		if (! CBFileGetLength(file->file, &length) || length < end) {
+			CBLogError("The block file %u is shorter than a block in it.", record->fileID);
+			return NULL;
+		}
+		if (file->map)
+			CBFileUnmap(file->map, file->mapLength);
+		void * map;
+		if (! CBFileMapReadOnly(file->file, 0, length, &map)) {
+			CBLogError("Could not map the block file %u.", record->fileID);
+			file->map = NULL;
+			file->mapLength = 0;
+			return NULL;
+		}
+		file->map = map;
+		file->mapLength = length;
+	}
+	
+	return file->map + record->offset;
+	
+}
+
+CBBlockStoreFile * CBBlockStoreGetFile(CBBlockStore * self, uint32_t fileID, bool write) {
+	
+	if (fileID >= self->fileNum) {
+		self->files = realloc(self->files, (fileID + 1) * sizeof(*self->files));
+		for (uint32_t x = self->fileNum; x <= fileID; x++)
+			self->files[x].open = false;
+		self->fileNum = fileID + 1;
+	}
+	
+	CBBlockStoreFile * file = self->files + fileID;
+	if (file->open) {
+		if (file->writable || ! write) {
+			file->lastUse = ++self->useCount;
+			return file;
+		}
+		// Open the file again for adding blocks.
+		CBBlockStoreCloseFile(self, fileID);
+	}
+	
+	// Close the least recently used files when too many are open.
+	while (self->openFileNum && self->openFileNum >= self->maxOpenFiles) {
+		uint32_t oldest = 0;
+		for (uint32_t x = 0; x < self->fileNum; x++)
+			if (self->files[x].open && (! self->files[oldest].open || self->files[x].lastUse < self->files[oldest].lastUse))
+				oldest = x;
+		CBBlockStoreCloseFile(self, oldest);
+	}
+	
+	char filename[strlen(self->dataDir) + 30];
+	CBBlockStoreGetFileName(self, fileID, filename);
+	if (! (write ? CBFileOpen(&file->file, filename, true) : CBFileOpenReadOnly(&file->file, filename))) {
+		CBLogError("Could not open the block file %s.", filename);
+		return NULL;
+	}
+	file->open = true;
+	file->writable = write;
+	file->map = NULL;
+	file->mapLength = 0;
+	file->lastUse = ++self->useCount;
+	self->openFileNum++;
+	
+	return file;
+	
+}
+
+void CBBlockStoreGetFileName(CBBlockStore * self, uint32_t fileID, char * filename) {
+	
+	sprintf(filename, "%s/blocks%u.dat", self->dataDir, fileID);
+	
+}
+
+CBMessage * CBBlockStoreGetMessage(CBBlockStore * self, unsigned char * hash) {
+	
+	CBBlockStoreRecord * record = CBBlockStoreFind(self, hash);
+	if (! record)
+		return NULL;
+	
+	// The store can close its files while the message is queued, so the message has its own.
+	char filename[strlen(self->dataDir) + 30];
+	CBDepObject file;
+	CBBlockStoreGetFileName(self, record->fileID, filename);
+	if (! CBFileOpenReadOnly(&file, filename)) {
+		CBLogError("Could not open the block file %s.", filename);
+		return NULL;
+	}
+	CBMessage * message = CBNewMessageByFile(CB_MESSAGE_TYPE_BLOCK, file, record->offset, record->length, record->checksum);
+	message->closeFile = true;
+	
+	return message;
+	
+}
+
+void CBBlockStoreIndex(CBBlockStore * self, uint32_t x) {
+	
+	// Keep the table at most half full.
+	if ((x + 1) * 2 > self->tableSize) {
+		self->tableSize = self->tableSize ? self->tableSize * 2 : CB_BLOCK_STORE_MIN_TABLE;
+		free(self->table);
+		self->table = calloc(self->tableSize, sizeof(*self->table));
+		for (uint32_t y = 0; y < x; y++)
+			CBBlockStoreIndex(self, y);
+	}
+	
+	uint32_t mask = self->tableSize - 1;
+	uint32_t slot = CBArrayToInt32(CBBlockStoreGetRecord(self, x)->hash, 0) & mask;
+	while (self->table[slot])
+		slot = (slot + 1) & mask;
+	self->table[slot] = x + 1;
+	
+}
+
+bool CBBlockStoreRecordIsValid(CBBlockStore * self, uint32_t x) {
+	
+	CBBlockStoreRecord * record = CBBlockStoreGetRecord(self, x);
+	
+	if (record->length < 80 || record->length > self->fileSize || record->offset > self->fileSize - record->length)
+		return false;
+	
+	// The block must follow the last, or be at the start of the next file.
+	if (x) {
+		CBBlockStoreRecord * prev = CBBlockStoreGetRecord(self, x - 1);
+		if (! (record->fileID == prev->fileID && record->offset == prev->offset + prev->length)
+			&& ! (record->fileID == prev->fileID + 1 && record->offset == 0))
+			return false;
+	}else if (record->fileID || record->offset)
+		return false;
+	
+	// Check the block was written
+	CBBlockStoreFile * file = CBBlockStoreGetFile(self, record->fileID, false);
+	uint64_t length;
+	if (! file || ! CBFileGetLength(file->file, &length) || length < (uint64_t)record->offset + record->length)
+		return false;
+	
+	unsigned char * data = CBBlockStoreGetData(self, record);
+	if (! data)
+		return false;
+	unsigned char hash[32], hash2[32];
+	CBSha256(data, 80, hash);
+	CBSha256(hash, 32, hash2);
+	if (memcmp(hash2, record->hash, 32))
+		return false;
+	CBSha256(data, record->length, hash);
+	CBSha256(hash, 32, hash2);
+	
+	return ! memcmp(hash2, record->checksum, 4);
+	
+}
+
+bool CBBlockStoreSync(CBBlockStore * self) {
+	
+	// Write the blocks before the records, and the records before the number of records.
+	for (uint32_t x = self->unsyncedFile; x <= self->appendFile && x < self->fileNum; x++)
+		if (self->files[x].open && self->files[x].writable && ! CBFileSync(self->files[x].file)) {
+			CBLogError("Could not sync the block file %u.", x);
+			return false;
+		}
+	if (! CBFileSyncMap(self->indexHeader, 0, (uint64_t)(self->capacity + 1) * sizeof(CBBlockStoreRecord))) {
+		CBLogError("Could not sync the block store records.");
+		return false;
+	}
+	self->indexHeader->syncedNum = self->blockNum;
+	if (! CBFileSyncMap(self->indexHeader, 0, sizeof(CBBlockStoreIndexHeader))) {
+		CBLogError("Could not sync the block store index header.");
+		return false;
+	}
+	self->unsyncedFile = self->appendFile;
+	
+	return true;
+	
+}
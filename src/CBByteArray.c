@@ -16,11 +16,14 @@
 
 #include "CBByteArray.h"
 
+CBPool CBByteArrayPool = CB_POOL_INIT(CBByteArray, CB_POOL_CACHE_BYTE_ARRAY);
+CBPool CBSharedDataPool = CB_POOL_INIT(CBSharedData, CB_POOL_CACHE_SHARED_DATA);
+
 //  Constructor
 
 CBByteArray * CBNewByteArrayFromString(char * string, bool terminator) {
 	
-	CBByteArray * self = malloc(sizeof(*self));
+	CBByteArray * self = CBAllocObject(&CBByteArrayPool);
 	CBGetObject(self)->free = CBFreeByteArray;
 	CBInitByteArrayFromString(self, string, terminator);
 	
@@ -30,7 +33,7 @@ CBByteArray * CBNewByteArrayFromString(char * string, bool terminator) {
 
 CBByteArray * CBNewByteArrayOfSize(int size) {
 	
-	CBByteArray * self = malloc(sizeof(*self));
+	CBByteArray * self = CBAllocObject(&CBByteArrayPool);
 	CBGetObject(self)->free = CBFreeByteArray;
 	CBInitByteArrayOfSize(self, size);
 	
@@ -40,7 +43,7 @@ CBByteArray * CBNewByteArrayOfSize(int size) {
 
 CBByteArray * CBNewByteArraySubReference(CBByteArray * ref, int offset, int length) {
 	
-	CBByteArray * self = malloc(sizeof(*self));
+	CBByteArray * self = CBAllocObject(&CBByteArrayPool);
 	CBGetObject(self)->free = CBFreeByteArray;
 	CBInitByteArraySubReference(self, ref, offset, length);
 	
@@ -50,7 +53,7 @@ CBByteArray * CBNewByteArraySubReference(CBByteArray * ref, int offset, int leng
 
 CBByteArray * CBNewByteArrayWithData(unsigned char * data, int size) {
 	
-	CBByteArray * self = malloc(sizeof(*self));
+	CBByteArray * self = CBAllocObject(&CBByteArrayPool);
 	CBGetObject(self)->free = CBFreeByteArray;
 	CBInitByteArrayWithData(self, data, size);
 	
@@ -60,7 +63,7 @@ CBByteArray * CBNewByteArrayWithData(unsigned char * data, int size) {
 
 CBByteArray * CBNewByteArrayWithDataCopy(unsigned char * data, int size) {
 	
-	CBByteArray * self = malloc(sizeof(*self));
+	CBByteArray * self = CBAllocObject(&CBByteArrayPool);
 	CBGetObject(self)->free = CBFreeByteArray;
 	CBInitByteArrayWithDataCopy(self, data, size);
 	
@@ -70,7 +73,7 @@ CBByteArray * CBNewByteArrayWithDataCopy(unsigned char * data, int size) {
 
 CBByteArray * CBNewByteArrayFromHex(char * hex) {
 	
-	CBByteArray * self = malloc(sizeof(*self));
+	CBByteArray * self = CBAllocObject(&CBByteArrayPool);
 	CBGetObject(self)->free = CBFreeByteArray;
 	CBInitByteArrayFromHex(self, hex);
 	
@@ -78,6 +81,21 @@ CBByteArray * CBNewByteArrayFromHex(char * hex) {
 	
 }
 
+CBSharedData * CBNewSharedData(unsigned char * data) {
+	
+	CBAllocation allocation;
+	CBSharedData * self = CBAlloc(&CBSharedDataPool, &allocation);
+	if (!self)
+		return NULL;
+	
+	self->allocation = allocation;
+	self->data = data;
+	self->references = 1;
+	
+	return self;
+	
+}
+
 //  Initialisers
 
 
@@ -86,9 +104,7 @@ void CBInitByteArrayFromString(CBByteArray * self, char * string, bool terminato
 	CBInitObject(CBGetObject(self), false);
 	
 	self->length = (int)(strlen(string) + terminator);
-	self->sharedData = malloc(sizeof(*self->sharedData));
-	self->sharedData->data = malloc(self->length);
-	self->sharedData->references = 1;
+	self->sharedData = CBNewSharedData(malloc(self->length));
 	self->offset = 0;
 	
 	memcpy(self->sharedData->data, string, self->length);
@@ -102,11 +118,9 @@ void CBInitByteArrayOfSize(CBByteArray * self, int size) {
 	self->length = size;
 	self->offset = 0;
 	
-	if (size){
-		self->sharedData = malloc(sizeof(*self->sharedData));
-		self->sharedData->references = 1;
-		self->sharedData->data = malloc(size);
-	}else
+	if (size)
+		self->sharedData = CBNewSharedData(malloc(size));
+	else
 		self->sharedData = NULL;
 	
 }
@@ -117,8 +131,8 @@ void CBInitByteArraySubReference(CBByteArray * self, CBByteArray * ref, int offs
 	
 	self->sharedData = ref->sharedData;
 	
-	// Since a new reference to the shared data is being made, an increase in the reference count must be made.
-	self->sharedData->references++;
+	// Since a new reference to the shared data is being made, an increase in the reference count must be made. Sub references of a block are made and released on many threads, so this is atomic.
+	__atomic_fetch_add(&self->sharedData->references, 1, __ATOMIC_RELAXED);
 	
 	self->length = length;
 	self->offset = ref->offset + offset;
@@ -128,9 +142,7 @@ void CBInitByteArrayWithData(CBByteArray * self, unsigned char * data, int size)
 	
 	CBInitObject(CBGetObject(self), false);
 	
-	self->sharedData = malloc(sizeof(*self->sharedData));
-	self->sharedData->data = data;
-	self->sharedData->references = 1;
+	self->sharedData = CBNewSharedData(data);
 	self->length = size;
 	self->offset = 0;
 	
@@ -140,9 +152,7 @@ void CBInitByteArrayWithDataCopy(CBByteArray * self, unsigned char * data, int s
 	
 	CBInitObject(CBGetObject(self), false);
 	
-	self->sharedData = malloc(sizeof(*self->sharedData));
-	self->sharedData->data = malloc(size);
-	self->sharedData->references = 1;
+	self->sharedData = CBNewSharedData(malloc(size));
 	self->length = size;
 	self->offset = 0;
 	
@@ -168,7 +178,7 @@ void CBDestroyByteArray(void * self) {
 void CBFreeByteArray(void * self) {
 	
 	CBDestroyByteArray(self);
-	free(self);
+	CBFreeObjectMemory(self, &CBByteArrayPool);
 	
 }
 
@@ -177,11 +187,11 @@ void CBByteArrayReleaseSharedData(CBByteArray * self) {
 	if (! self->sharedData)
 		return;
 	
-	self->sharedData->references--;
-	if (self->sharedData->references < 1) {
-		// Shared data now owned by nothing so free it 
+	if (__atomic_fetch_sub(&self->sharedData->references, 1, __ATOMIC_RELEASE) == 1) {
+		// Shared data now owned by nothing so free it. The uses of the data by other threads must happen before.
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
 		free(self->sharedData->data);
-		free(self->sharedData);
+		CBFreeMemory(self->sharedData, self->sharedData->allocation, &CBSharedDataPool);
 	}
 	
 }
@@ -368,7 +378,7 @@ void CBByteArrayChangeReference(CBByteArray * self, CBByteArray * ref, int offse
 	self->sharedData = ref->sharedData;
 	
 	// Since a new reference to the shared data is being made, an increase in the reference count must be made.
-	self->sharedData->references++;
+	__atomic_fetch_add(&self->sharedData->references, 1, __ATOMIC_RELAXED);
 	
 	// New offset for shared data
 	self->offset = ref->offset + offset;
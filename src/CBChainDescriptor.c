@@ -15,6 +15,7 @@
 //  SEE HEADER FILE FOR DOCUMENTATION 
 
 #include "CBChainDescriptor.h"
+#include "CBCursor.h"
 
 //  Constructors
 
@@ -101,12 +102,18 @@ int CBChainDescriptorDeserialise(CBChainDescriptor * self) {
 		return CB_DESERIALISE_ERROR;
 	}
 	
-	CBVarInt hashNum = CBByteArrayReadVarInt(bytes, 0);
+	CBCursor cursor;
+	CBInitCursor(&cursor, bytes);
+	CBVarInt hashNum;
+	if (! CBCursorReadVarInt(&cursor, &hashNum)) {
+		CBLogError("Attempting to deserialise a CBChainDescriptor with less bytes than required for the var int.");
+		return CB_DESERIALISE_ERROR;
+	}
 	if (hashNum.val > 500) {
 		CBLogError("Attempting to deserialise a CBChainDescriptor with a var int over 500.");
 		return CB_DESERIALISE_ERROR;
 	}
-	if (bytes->length < hashNum.size + hashNum.val * 32) {
+	if (! CBCursorHas(&cursor, hashNum.val * 32)) {
 		CBLogError("Attempting to deserialise a CBChainDescriptor with less bytes than required for the hashes.");
 		return CB_DESERIALISE_ERROR;
 	}
@@ -114,13 +121,12 @@ int CBChainDescriptorDeserialise(CBChainDescriptor * self) {
 	// Deserialise each hash
 	self->hashes = malloc(sizeof(*self->hashes) * (size_t)hashNum.val);
 	self->hashNum = hashNum.val;
-	int cursor = hashNum.size;
 	for (int x = 0; x < self->hashNum; x++) {
-		self->hashes[x] = CBNewByteArraySubReference(bytes, cursor, 32);
-		cursor += 32;
+		self->hashes[x] = CBNewByteArraySubReference(bytes, cursor.offset, 32);
+		CBCursorSkip(&cursor, 32);
 	}
 	
-	return cursor;
+	return cursor.offset;
 	
 }
 
@@ -0,0 +1,955 @@
+//
+//  CBCoinStore.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+//  SEE HEADER FILE FOR DOCUMENTATION
+
+#include "CBCoinStore.h"
+#include "CBValidationFunctions.h"
+
+//  Initialiser
+
+bool CBInitCoinStore(CBCoinStore * self, char * dataDir, uint64_t cacheLimit) {
+	
+	char filename[strlen(dataDir) + 20];
+	uint64_t length = 0;
+	
+	sprintf(filename, "%s/coins.dat", dataDir);
+	if (! CBFileOpen(&self->logFile, filename, true)) {
+		CBLogError("Could not open the coin log file %s.", filename);
+		return false;
+	}
+	sprintf(filename, "%s/coinUndo.dat", dataDir);
+	if (! CBFileOpen(&self->undoFile, filename, true)) {
+		CBLogError("Could not open the coin undo file %s.", filename);
+		CBFileClose(self->logFile);
+		return false;
+	}
+	sprintf(filename, "%s/coinIndex.dat", dataDir);
+	if (! CBFileOpen(&self->indexFile, filename, true)) {
+		CBLogError("Could not open the coin index file %s.", filename);
+		CBFileClose(self->logFile);
+		CBFileClose(self->undoFile);
+		return false;
+	}
+	
+	// Use the existing table if it was synced after the last change.
+	self->indexHeader = NULL;
+	bool valid = false;
+	if (! CBFileGetLength(self->indexFile, &length)) {
+		CBLogError("Could not get the length of the coin index file.");
+	}else if (length >= sizeof(CBCoinStoreIndexHeader)) {
+		if (CBFileMap(self->indexFile, 0, length, (void **)&self->indexHeader)) {
+			CBCoinStoreIndexHeader * header = self->indexHeader;
+			uint64_t slotBytes = length - sizeof(CBCoinStoreIndexHeader);
+			self->indexLength = length;
+			self->table = (CBCoinStoreSlot *)(header + 1);
+			valid = header->magic == CB_COIN_STORE_MAGIC
+				&& header->clean
+				&& header->tableSize >= CB_COIN_STORE_MIN_TABLE
+				&& ! (header->tableSize & (header->tableSize - 1))
+				&& slotBytes % sizeof(CBCoinStoreSlot) == 0
+				&& slotBytes / sizeof(CBCoinStoreSlot) == header->tableSize;
+		}else
+			CBLogError("Could not map the coin index file.");
+	}
+	if (! valid && length)
+		CBLogError("The coin index is being made again from the coin log.");
+	if (! (valid ? CBCoinStoreReplay(self) : CBCoinStoreRebuildTable(self))) {
+		if (self->indexHeader)
+			CBFileUnmap(self->indexHeader, self->indexLength);
+		CBFileClose(self->logFile);
+		CBFileClose(self->undoFile);
+		CBFileClose(self->indexFile);
+		return false;
+	}
+	
+	self->undoLength = self->indexHeader->undoLength;
+	memcpy(self->tip, self->indexHeader->tip, 32);
+	self->cacheLimit = cacheLimit;
+	self->cacheSize = 0;
+	self->cachedNum = 0;
+	self->bucketNum = CB_COIN_STORE_MIN_BUCKETS;
+	self->buckets = calloc(self->bucketNum, sizeof(*self->buckets));
+	
+	return true;
+	
+}
+
+//  Destructor
+
+void CBDestroyCoinStore(CBCoinStore * self) {
+	
+	CBCoinStoreFlush(self);
+	CBCoinStoreCacheClear(self);
+	free(self->buckets);
+	CBFileUnmap(self->indexHeader, self->indexLength);
+	CBFileClose(self->logFile);
+	CBFileClose(self->undoFile);
+	CBFileClose(self->indexFile);
+	
+}
+
+//  Functions
+
+void CBCoinStoreAdd(CBCoinStore * self, unsigned char * key, uint64_t value, uint32_t height, bool coinbase, unsigned char * script, uint32_t scriptLength) {
+	
+	uint8_t flags = CB_COIN_DIRTY;
+	
+	CBCoin * old = CBCoinStoreCacheFind(self, key);
+	if (old) {
+		if (old->flags & CB_COIN_FRESH)
+			flags |= CB_COIN_FRESH;
+		CBCoinStoreCacheRemove(self, old);
+	}else if (! coinbase)
+		// Only coinbase transactions can have the hash of an earlier transaction, so other coins are not on disk.
+		flags |= CB_COIN_FRESH;
+	else{
+		uint64_t slot;
+		if (CBCoinStoreFindSlot(self, key, &slot) == 0)
+			flags |= CB_COIN_FRESH;
+	}
+	
+	CBCoin * coin = malloc(sizeof(*coin) + scriptLength);
+	memcpy(coin->key, key, CB_COIN_KEY_SIZE);
+	coin->value = value;
+	coin->height = height;
+	coin->coinbase = coinbase;
+	coin->flags = flags;
+	coin->scriptLength = scriptLength;
+	coin->script = (unsigned char *)(coin + 1);
+	memcpy(coin->script, script, scriptLength);
+	CBCoinStoreCacheAdd(self, coin);
+	
+}
+
+bool CBCoinStoreApplyBatch(CBCoinStore * self, unsigned char * data, uint32_t length, uint64_t offset) {
+	
+	for (uint32_t x = 0; x < length;) {
+		
+		unsigned char * key = data + x + 1;
+		uint64_t slot;
+		int found;
+		
+		if (data[x] == CB_COIN_LOG_ADD) {
+			
+			if (length - x < CB_COIN_STORE_ADD_HEADER
+				|| length - x - CB_COIN_STORE_ADD_HEADER < CBArrayToInt32(data, x + 49)) {
+				CBLogError("An added coin goes past the end of a coin log batch.");
+				return false;
+			}
+			
+			found = CBCoinStoreFindSlot(self, key, &slot);
+			if (found == -1)
+				return false;
+			if (found)
+				self->table[slot].offset = offset + x + 1;
+			else{
+				if (! CBCoinStoreInsertSlot(self, CBCoinStoreGetTag(key), offset + x + 1))
+					return false;
+				self->indexHeader->coinNum++;
+			}
+			
+			x += CB_COIN_STORE_ADD_HEADER + CBArrayToInt32(data, x + 49);
+			
+		}else if (data[x] == CB_COIN_LOG_SPEND) {
+			
+			if (length - x < 1 + CB_COIN_KEY_SIZE) {
+				CBLogError("A spent coin goes past the end of a coin log batch.");
+				return false;
+			}
+			
+			found = CBCoinStoreFindSlot(self, key, &slot);
+			if (found == -1)
+				return false;
+			if (found) {
+				self->table[slot].offset = CB_COIN_STORE_DELETED;
+				self->indexHeader->coinNum--;
+			}
+			
+			x += 1 + CB_COIN_KEY_SIZE;
+			
+		}else{
+			CBLogError("A coin log batch has an entry with the bad type %u.", data[x]);
+			return false;
+		}
+		
+	}
+	
+	return true;
+	
+}
+
+void CBCoinStoreCacheAdd(CBCoinStore * self, CBCoin * coin) {
+	
+	// Keep at most one coin for each bucket on average.
+	if (self->cachedNum >= self->bucketNum) {
+		uint32_t bucketNum = self->bucketNum * 2;
+		CBCoin ** buckets = calloc(bucketNum, sizeof(*buckets));
+		for (uint32_t x = 0; x < self->bucketNum; x++)
+			for (CBCoin * next, * cached = self->buckets[x]; cached; cached = next) {
+				uint32_t bucket = (uint32_t)CBCoinStoreGetTag(cached->key) & (bucketNum - 1);
+				next = cached->next;
+				cached->next = buckets[bucket];
+				buckets[bucket] = cached;
+			}
+		free(self->buckets);
+		self->buckets = buckets;
+		self->bucketNum = bucketNum;
+	}
+	
+	uint32_t bucket = (uint32_t)CBCoinStoreGetTag(coin->key) & (self->bucketNum - 1);
+	coin->next = self->buckets[bucket];
+	self->buckets[bucket] = coin;
+	self->cachedNum++;
+	self->cacheSize += sizeof(*coin) + coin->scriptLength;
+	
+}
+
+void CBCoinStoreCacheClear(CBCoinStore * self) {
+	
+	for (uint32_t x = 0; x < self->bucketNum; x++) {
+		for (CBCoin * next, * coin = self->buckets[x]; coin; coin = next) {
+			next = coin->next;
+			free(coin);
+		}
+		self->buckets[x] = NULL;
+	}
+	self->cachedNum = 0;
+	self->cacheSize = 0;
+	
+}
+
+CBCoin * CBCoinStoreCacheFind(CBCoinStore * self, unsigned char * key) {
+	
+	for (CBCoin * coin = self->buckets[(uint32_t)CBCoinStoreGetTag(key) & (self->bucketNum - 1)]; coin; coin = coin->next)
+		if (! memcmp(coin->key, key, CB_COIN_KEY_SIZE))
+			return coin;
+	
+	return NULL;
+	
+}
+
+void CBCoinStoreCacheRemove(CBCoinStore * self, CBCoin * coin) {
+	
+	CBCoin ** prev = self->buckets + ((uint32_t)CBCoinStoreGetTag(coin->key) & (self->bucketNum - 1));
+	while (*prev != coin)
+		prev = &(*prev)->next;
+	*prev = coin->next;
+	self->cachedNum--;
+	self->cacheSize -= sizeof(*coin) + coin->scriptLength;
+	free(coin);
+	
+}
+
+CBCoinStoreResult CBCoinStoreConnectBlock(CBCoinStore * self, CBBlock * block, uint32_t height) {
+	
+	if (memcmp(CBByteArrayGetData(block->prevBlockHash), self->tip, 32)) {
+		CBLogError("Attempting to connect a block to a CBCoinStore which does not follow the tip.");
+		return CB_COIN_STORE_ERROR;
+	}
+	if (block->transactionNum < 1) {
+		CBLogError("Attempting to connect a block without a coinbase transaction to a CBCoinStore.");
+		return CB_COIN_STORE_INVALID;
+	}
+	
+	unsigned char * undo = NULL;
+	uint32_t undoLength = 0, undoCapacity = 0;
+	uint64_t fees = 0, coinbaseValue = 0;
+	unsigned char key[CB_COIN_KEY_SIZE];
+	bool valid = true, error = false;
+	int txNum, inputNum = 0;
+	
+	for (txNum = 0; valid && txNum < block->transactionNum; txNum++) {
+		
+		CBTransaction * tx = block->transactions[txNum];
+		uint64_t inputValue = 0, outputValue = 0;
+		
+		// Spend the coins of the inputs, keeping them as undo data.
+		for (inputNum = 0; txNum && inputNum < tx->inputNum; inputNum++) {
+			
+			CBPrevOut * prevOut = &tx->inputs[inputNum]->prevOut;
+			CBCoin * coin = CBCoinStoreGet(self, CBByteArrayGetData(prevOut->hash), prevOut->index);
+			
+			if (! coin) {
+				CBLogError("The transaction %i of a block spends an output which is not unspent.", txNum);
+				valid = false;
+				break;
+			}
+			if (coin->coinbase && height < coin->height + CB_COIN_MATURITY) {
+				CBLogError("The transaction %i of a block spends a coinbase output before maturity.", txNum);
+				valid = false;
+				break;
+			}
+			inputValue += coin->value;
+			if (coin->value > CB_MAX_MONEY || inputValue > CB_MAX_MONEY) {
+				CBLogError("The transaction %i of a block has inputs with too much value.", txNum);
+				valid = false;
+				break;
+			}
+			
+			if (undoCapacity - undoLength < 16 + coin->scriptLength) {
+				undoCapacity = (undoLength + 16 + coin->scriptLength) * 2;
+				undo = realloc(undo, undoCapacity);
+			}
+			CBInt64ToArray(undo, undoLength, coin->value);
+			CBInt32ToArray(undo, undoLength + 8, coin->height << 1 | coin->coinbase);
+			CBInt32ToArray(undo, undoLength + 12, coin->scriptLength);
+			memcpy(undo + undoLength + 16, coin->script, coin->scriptLength);
+			undoLength += 16 + coin->scriptLength;
+			
+			CBCoinStoreSpend(self, coin);
+			
+		}
+		if (! valid)
+			break;
+		
+		for (int x = 0; x < tx->outputNum; x++) {
+			outputValue += tx->outputs[x]->value;
+			if (tx->outputs[x]->value > CB_MAX_MONEY || outputValue > CB_MAX_MONEY) {
+				CBLogError("The transaction %i of a block has outputs with too much value.", txNum);
+				valid = false;
+				break;
+			}
+		}
+		if (! valid)
+			break;
+		
+		if (txNum == 0)
+			coinbaseValue = outputValue;
+		else if (outputValue > inputValue) {
+			CBLogError("The transaction %i of a block has outputs with more value than the inputs.", txNum);
+			valid = false;
+			break;
+		}else
+			fees += inputValue - outputValue;
+		
+		// Add the outputs which can be spent
+		unsigned char * hash = CBTransactionGetHash(tx);
+		for (int x = 0; x < tx->outputNum; x++) {
+			CBScript * script = tx->outputs[x]->scriptObject;
+			if (script->length && CBByteArrayGetByte(script, 0) == CB_SCRIPT_OP_RETURN)
+				continue;
+			CBCoinStoreMakeKey(key, hash, x);
+			CBCoinStoreAdd(self, key, tx->outputs[x]->value, height, txNum == 0, CBByteArrayGetData(script), script->length);
+		}
+		inputNum = 0;
+		
+	}
+	
+	if (valid && coinbaseValue > (uint64_t)CBCalculateBlockReward(height) + fees) {
+		CBLogError("The coinbase transaction of a block has outputs with more value than the reward and fees.");
+		valid = false;
+	}
+	
+	if (valid) {
+		// Add the undo data to the undo file with the length and block hash after it.
+		if (undoCapacity - undoLength < CB_COIN_STORE_UNDO_FOOTER)
+			undo = realloc(undo, undoLength + CB_COIN_STORE_UNDO_FOOTER);
+		CBInt32ToArray(undo, undoLength, undoLength);
+		memcpy(undo + undoLength + 4, CBBlockGetHash(block), 32);
+		if (! CBFileWrite(self->undoFile, undo, undoLength + CB_COIN_STORE_UNDO_FOOTER, self->undoLength)) {
+			CBLogError("Could not write the undo data of a block.");
+			valid = false;
+			error = true;
+		}
+	}
+	
+	if (! valid) {
+		CBCoinStoreUndo(self, block, txNum, inputNum, undo, undoLength);
+		free(undo);
+		return error ? CB_COIN_STORE_ERROR : CB_COIN_STORE_INVALID;
+	}
+	
+	free(undo);
+	self->undoLength += undoLength + CB_COIN_STORE_UNDO_FOOTER;
+	memcpy(self->tip, CBBlockGetHash(block), 32);
+	
+	// The block stays connected when the flush fails.
+	if (self->cacheSize > self->cacheLimit && ! CBCoinStoreFlush(self))
+		return CB_COIN_STORE_FLUSH_ERROR;
+	
+	return CB_COIN_STORE_OK;
+	
+}
+
+CBCoinStoreResult CBCoinStoreDisconnectBlock(CBCoinStore * self, CBBlock * block) {
+	
+	unsigned char footer[CB_COIN_STORE_UNDO_FOOTER];
+	
+	if (memcmp(CBBlockGetHash(block), self->tip, 32)) {
+		CBLogError("Attempting to disconnect a block from a CBCoinStore which is not the tip.");
+		return CB_COIN_STORE_ERROR;
+	}
+	if (self->undoLength < CB_COIN_STORE_UNDO_FOOTER
+		|| ! CBFileRead(self->undoFile, footer, CB_COIN_STORE_UNDO_FOOTER, self->undoLength - CB_COIN_STORE_UNDO_FOOTER)) {
+		CBLogError("Could not read the end of the undo data of a block.");
+		return CB_COIN_STORE_ERROR;
+	}
+	
+	uint32_t undoLength = CBArrayToInt32(footer, 0);
+	if (memcmp(footer + 4, CBBlockGetHash(block), 32) || self->undoLength - CB_COIN_STORE_UNDO_FOOTER < undoLength) {
+		CBLogError("The undo data at the top of the undo file is not for the block being disconnected.");
+		return CB_COIN_STORE_ERROR;
+	}
+	
+	unsigned char * undo = malloc(undoLength + 1);
+	uint64_t start = self->undoLength - CB_COIN_STORE_UNDO_FOOTER - undoLength;
+	if (! CBFileRead(self->undoFile, undo, undoLength, start)) {
+		CBLogError("Could not read the undo data of a block.");
+		free(undo);
+		return CB_COIN_STORE_ERROR;
+	}
+	if (! CBCoinStoreUndo(self, block, block->transactionNum, 0, undo, undoLength)) {
+		free(undo);
+		return CB_COIN_STORE_ERROR;
+	}
+	free(undo);
+	
+	self->undoLength = start;
+	memcpy(self->tip, CBByteArrayGetData(block->prevBlockHash), 32);
+	
+	if (self->cacheSize > self->cacheLimit && ! CBCoinStoreFlush(self))
+		return CB_COIN_STORE_FLUSH_ERROR;
+	
+	return CB_COIN_STORE_OK;
+	
+}
+
+int CBCoinStoreFindSlot(CBCoinStore * self, unsigned char * key, uint64_t * slot) {
+	
+	uint64_t tag = CBCoinStoreGetTag(key);
+	uint64_t mask = self->indexHeader->tableSize - 1;
+	unsigned char stored[CB_COIN_KEY_SIZE];
+	
+	for (uint64_t x = tag & mask; self->table[x].offset; x = (x + 1) & mask) {
+		if (self->table[x].tag != tag || self->table[x].offset == CB_COIN_STORE_DELETED)
+			continue;
+		// The key follows the type of the entry.
+		if (! CBFileRead(self->logFile, stored, CB_COIN_KEY_SIZE, self->table[x].offset)) {
+			CBLogError("Could not read the key of a coin from the coin log.");
+			return -1;
+		}
+		if (! memcmp(stored, key, CB_COIN_KEY_SIZE)) {
+			*slot = x;
+			return 1;
+		}
+	}
+	
+	return 0;
+	
+}
+
+bool CBCoinStoreFlush(CBCoinStore * self) {
+	
+	CBCoinStoreIndexHeader * header = self->indexHeader;
+	uint64_t length = 0;
+	
+	for (uint32_t x = 0; x < self->bucketNum; x++)
+		for (CBCoin * coin = self->buckets[x]; coin; coin = coin->next)
+			if (coin->flags & CB_COIN_SPENT)
+				length += 1 + CB_COIN_KEY_SIZE;
+			else if (coin->flags & CB_COIN_DIRTY)
+				length += CB_COIN_STORE_ADD_HEADER + coin->scriptLength;
+	
+	if (length == 0 && ! memcmp(self->tip, header->tip, 32) && self->undoLength == header->undoLength)
+		return true;
+	if (length > UINT32_MAX - CB_COIN_STORE_BATCH_HEADER) {
+		CBLogError("The coin cache has too many changes to flush in one batch.");
+		return false;
+	}
+	
+	// Make the batch
+	unsigned char * batch = malloc(CB_COIN_STORE_BATCH_HEADER + length);
+	unsigned char * entry = batch + CB_COIN_STORE_BATCH_HEADER;
+	for (uint32_t x = 0; x < self->bucketNum; x++)
+		for (CBCoin * coin = self->buckets[x]; coin; coin = coin->next) {
+			if (coin->flags & CB_COIN_SPENT) {
+				entry[0] = CB_COIN_LOG_SPEND;
+				memcpy(entry + 1, coin->key, CB_COIN_KEY_SIZE);
+				entry += 1 + CB_COIN_KEY_SIZE;
+			}else if (coin->flags & CB_COIN_DIRTY) {
+				entry[0] = CB_COIN_LOG_ADD;
+				memcpy(entry + 1, coin->key, CB_COIN_KEY_SIZE);
+				CBInt64ToArray(entry, 37, coin->value);
+				CBInt32ToArray(entry, 45, coin->height << 1 | coin->coinbase);
+				CBInt32ToArray(entry, 49, coin->scriptLength);
+				memcpy(entry + CB_COIN_STORE_ADD_HEADER, coin->script, coin->scriptLength);
+				entry += CB_COIN_STORE_ADD_HEADER + coin->scriptLength;
+			}
+		}
+	unsigned char hash[32];
+	CBSha256(batch + CB_COIN_STORE_BATCH_HEADER, (uint32_t)length, hash);
+	CBInt32ToArray(batch, 0, (uint32_t)length);
+	memcpy(batch + 4, hash, 4);
+	CBInt64ToArray(batch, 8, self->undoLength);
+	memcpy(batch + 16, self->tip, 32);
+	
+	// Write the undo data and the batch before changing the table.
+	uint64_t offset = header->logLength;
+	if (! CBFileWrite(self->logFile, batch, CB_COIN_STORE_BATCH_HEADER + (uint32_t)length, offset)
+		|| ! CBFileSync(self->undoFile)
+		|| ! CBFileSync(self->logFile)) {
+		CBLogError("Could not write a batch to the coin log.");
+		free(batch);
+		return false;
+	}
+	header->clean = 0;
+	if (! CBFileSyncMap(header, 0, sizeof(*header))) {
+		CBLogError("Could not sync the coin index header.");
+		free(batch);
+		return false;
+	}
+	
+	// If this fails the table is made again from the log when next opened.
+	bool applied = CBCoinStoreApplyBatch(self, batch + CB_COIN_STORE_BATCH_HEADER, (uint32_t)length, offset + CB_COIN_STORE_BATCH_HEADER);
+	free(batch);
+	if (! applied)
+		return false;
+	
+	header = self->indexHeader;
+	if (! CBFileSyncMap(header, 0, self->indexLength)) {
+		CBLogError("Could not sync the coin index.");
+		return false;
+	}
+	header->logLength = offset + CB_COIN_STORE_BATCH_HEADER + length;
+	header->undoLength = self->undoLength;
+	memcpy(header->tip, self->tip, 32);
+	header->clean = 1;
+	if (! CBFileSyncMap(header, 0, sizeof(*header))) {
+		CBLogError("Could not sync the coin index header.");
+		return false;
+	}
+	
+	// Remove the spent coins and keep the others as being on disk.
+	for (uint32_t x = 0; x < self->bucketNum; x++)
+		for (CBCoin ** prev = self->buckets + x; *prev;) {
+			CBCoin * coin = *prev;
+			if (coin->flags & CB_COIN_SPENT) {
+				*prev = coin->next;
+				self->cachedNum--;
+				self->cacheSize -= sizeof(*coin) + coin->scriptLength;
+				free(coin);
+			}else{
+				coin->flags = 0;
+				prev = &coin->next;
+			}
+		}
+	
+	if (self->cacheSize > self->cacheLimit)
+		CBCoinStoreCacheClear(self);
+	
+	return true;
+	
+}
+
+CBCoin * CBCoinStoreGet(CBCoinStore * self, unsigned char * hash, uint32_t index) {
+	
+	unsigned char key[CB_COIN_KEY_SIZE];
+	CBCoinStoreMakeKey(key, hash, index);
+	
+	return CBCoinStoreGetByKey(self, key);
+	
+}
+
+CBCoin * CBCoinStoreGetByKey(CBCoinStore * self, unsigned char * key) {
+	
+	CBCoin * coin = CBCoinStoreCacheFind(self, key);
+	if (coin)
+		return coin->flags & CB_COIN_SPENT ? NULL : coin;
+	
+	if (! CBCoinStoreReadCoin(self, key, &coin))
+		return NULL;
+	if (coin)
+		CBCoinStoreCacheAdd(self, coin);
+	
+	return coin;
+	
+}
+
+uint64_t CBCoinStoreGetTag(unsigned char * key) {
+	
+	// The transaction hash is already random, but the outputs of a transaction differ only by the index.
+	uint64_t tag;
+	memcpy(&tag, key, 8);
+	
+	return tag ^ (CBArrayToInt32(key, 32) * 0x9E3779B97F4A7C15ULL);
+	
+}
+
+bool CBCoinStoreInsertSlot(CBCoinStore * self, uint64_t tag, uint64_t offset) {
+	
+	CBCoinStoreIndexHeader * header = self->indexHeader;
+	
+	// Keep the table at most half full, and grow it if more than a quarter is unspent coins. Otherwise the slots of spent coins are cleared.
+	if ((header->usedSlots + 1) * 2 > header->tableSize
+		&& ! CBCoinStoreResizeTable(self, (header->coinNum + 1) * 4 > header->tableSize ? header->tableSize * 2 : header->tableSize))
+		return false;
+	
+	header = self->indexHeader;
+	uint64_t mask = header->tableSize - 1, x;
+	for (x = tag & mask; self->table[x].offset && self->table[x].offset != CB_COIN_STORE_DELETED; x = (x + 1) & mask);
+	if (! self->table[x].offset)
+		header->usedSlots++;
+	self->table[x].tag = tag;
+	self->table[x].offset = offset;
+	
+	return true;
+	
+}
+
+void CBCoinStoreMakeKey(unsigned char * key, unsigned char * hash, uint32_t index) {
+	
+	memcpy(key, hash, 32);
+	CBInt32ToArray(key, 32, index);
+	
+}
+
+bool CBCoinStorePrefetch(CBCoinStore * self, CBBlock * block, int numThreads) {
+	
+	int inputNum = 0, keyNum = 0;
+	
+	for (int x = 1; x < block->transactionNum; x++)
+		inputNum += block->transactions[x]->inputNum;
+	if (! inputNum)
+		return true;
+	
+	// Find the inputs with coins which are not in the cache
+	CBCoinStorePrefetchJob job = {self, malloc(inputNum * CB_COIN_KEY_SIZE), NULL, false, 0, 0};
+	for (int x = 1; x < block->transactionNum; x++)
+		for (int y = 0; y < block->transactions[x]->inputNum; y++) {
+			CBPrevOut * prevOut = &block->transactions[x]->inputs[y]->prevOut;
+			unsigned char * key = job.keys + keyNum * CB_COIN_KEY_SIZE;
+			CBCoinStoreMakeKey(key, CBByteArrayGetData(prevOut->hash), prevOut->index);
+			if (! CBCoinStoreCacheFind(self, key))
+				keyNum++;
+		}
+	if (! keyNum) {
+		free(job.keys);
+		return true;
+	}
+	job.coins = malloc(keyNum * sizeof(*job.coins));
+	
+	if (numThreads < 1)
+		numThreads = CBGetNumberOfCores();
+	if (numThreads > keyNum)
+		numThreads = keyNum;
+	
+	// Use more ranges than threads so that the threads are balanced when some reads are from the page cache.
+	job.keyNum = keyNum;
+	job.itemNum = numThreads == 1 ? 1 : numThreads * 4;
+	if (job.itemNum > keyNum)
+		job.itemNum = keyNum;
+	
+	CBThreadPoolRun(CBCoinStorePrefetchProcess, &job, job.itemNum, numThreads);
+	
+	// Add the coins to the cache on this thread. A coin spent twice in the block is read twice.
+	for (int x = 0; x < keyNum; x++)
+		if (job.coins[x]) {
+			if (CBCoinStoreCacheFind(self, job.coins[x]->key))
+				free(job.coins[x]);
+			else
+				CBCoinStoreCacheAdd(self, job.coins[x]);
+		}
+	
+	free(job.keys);
+	free(job.coins);
+	
+	return ! job.failed;
+	
+}
+
+bool CBCoinStorePrefetchCoins(CBCoinStorePrefetchJob * job, int start, int end) {
+	
+	bool ok = true;
+	
+	for (int x = start; x < end; x++)
+		if (! CBCoinStoreReadCoin(job->store, job->keys + x * CB_COIN_KEY_SIZE, job->coins + x))
+			ok = false;
+	
+	return ok;
+	
+}
+
+void CBCoinStorePrefetchProcess(void * vjob, int item) {
+	
+	CBCoinStorePrefetchJob * job = vjob;
+	
+	if (! CBCoinStorePrefetchCoins(job, (int)((long long int)job->keyNum * item / job->itemNum), (int)((long long int)job->keyNum * (item + 1) / job->itemNum)))
+		__atomic_store_n(&job->failed, true, __ATOMIC_RELAXED);
+	
+}
+
+bool CBCoinStoreReadCoin(CBCoinStore * self, unsigned char * key, CBCoin ** coin) {
+	
+	uint64_t tag = CBCoinStoreGetTag(key);
+	uint64_t mask = self->indexHeader->tableSize - 1;
+	uint64_t logLength = self->indexHeader->logLength;
+	unsigned char data[128];
+	
+	*coin = NULL;
+	
+	for (uint64_t x = tag & mask; self->table[x].offset; x = (x + 1) & mask) {
+		
+		if (self->table[x].tag != tag || self->table[x].offset == CB_COIN_STORE_DELETED)
+			continue;
+		
+		// Read the coin with the start of the script, which is usually all of it.
+		uint64_t pos = self->table[x].offset - 1;
+		uint32_t length = logLength - pos < sizeof(data) ? (uint32_t)(logLength - pos) : sizeof(data);
+		if (pos >= logLength || length < CB_COIN_STORE_ADD_HEADER || ! CBFileRead(self->logFile, data, length, pos)) {
+			CBLogError("Could not read a coin from the coin log.");
+			return false;
+		}
+		if (memcmp(data + 1, key, CB_COIN_KEY_SIZE))
+			continue;
+		
+		uint32_t scriptLength = CBArrayToInt32(data, 49);
+		if (logLength - pos - CB_COIN_STORE_ADD_HEADER < scriptLength) {
+			CBLogError("A coin in the coin log goes past the end of the log.");
+			return false;
+		}
+		uint32_t heightAndCoinbase = CBArrayToInt32(data, 45);
+		CBCoin * new = malloc(sizeof(*new) + scriptLength);
+		memcpy(new->key, key, CB_COIN_KEY_SIZE);
+		new->value = CBArrayToInt64(data, 37);
+		new->height = heightAndCoinbase >> 1;
+		new->coinbase = heightAndCoinbase & 1;
+		new->flags = 0;
+		new->scriptLength = scriptLength;
+		new->script = (unsigned char *)(new + 1);
+		uint32_t read = length - CB_COIN_STORE_ADD_HEADER < scriptLength ? length - CB_COIN_STORE_ADD_HEADER : scriptLength;
+		memcpy(new->script, data + CB_COIN_STORE_ADD_HEADER, read);
+		if (read < scriptLength
+			&& ! CBFileRead(self->logFile, new->script + read, scriptLength - read, pos + CB_COIN_STORE_ADD_HEADER + read)) {
+			CBLogError("Could not read the script of a coin from the coin log.");
+			free(new);
+			return false;
+		}
+		*coin = new;
+		return true;
+		
+	}
+	
+	return true;
+	
+}
+
+bool CBCoinStoreRebuildTable(CBCoinStore * self) {
+	
+	uint64_t length = sizeof(CBCoinStoreIndexHeader) + (uint64_t)CB_COIN_STORE_MIN_TABLE * sizeof(CBCoinStoreSlot);
+	
+	if (self->indexHeader)
+		CBFileUnmap(self->indexHeader, self->indexLength);
+	self->indexHeader = NULL;
+	if (! CBFileSetLength(self->indexFile, length)
+		|| ! CBFileMap(self->indexFile, 0, length, (void **)&self->indexHeader)) {
+		CBLogError("Could not make a new coin index file.");
+		self->indexHeader = NULL;
+		return false;
+	}
+	self->indexLength = length;
+	self->table = (CBCoinStoreSlot *)(self->indexHeader + 1);
+	
+	CBCoinStoreIndexHeader * header = self->indexHeader;
+	memset(header, 0, length);
+	header->magic = CB_COIN_STORE_MAGIC;
+	header->tableSize = CB_COIN_STORE_MIN_TABLE;
+	
+	return CBCoinStoreReplay(self);
+	
+}
+
+bool CBCoinStoreReplay(CBCoinStore * self) {
+	
+	unsigned char head[CB_COIN_STORE_BATCH_HEADER], hash[32];
+	unsigned char * data = NULL;
+	uint64_t length;
+	
+	if (! CBFileGetLength(self->logFile, &length)) {
+		CBLogError("Could not get the length of the coin log.");
+		return false;
+	}
+	if (length < self->indexHeader->logLength) {
+		// The table has coins which are not in the log, so it cannot be used.
+		CBLogError("The coin log is shorter than the coin index, so the coin index is being made again from the coin log.");
+		return CBCoinStoreRebuildTable(self);
+	}
+	
+	// Apply the batches after the table which were completely written.
+	while (length - self->indexHeader->logLength >= CB_COIN_STORE_BATCH_HEADER) {
+		uint64_t offset = self->indexHeader->logLength;
+		if (! CBFileRead(self->logFile, head, CB_COIN_STORE_BATCH_HEADER, offset)) {
+			CBLogError("Could not read the start of a batch in the coin log.");
+			free(data);
+			return false;
+		}
+		uint32_t batchLength = CBArrayToInt32(head, 0);
+		if (length - offset - CB_COIN_STORE_BATCH_HEADER < batchLength)
+			break;
+		data = realloc(data, batchLength + 1);
+		if (! CBFileRead(self->logFile, data, batchLength, offset + CB_COIN_STORE_BATCH_HEADER)) {
+			CBLogError("Could not read a batch in the coin log.");
+			free(data);
+			return false;
+		}
+		CBSha256(data, batchLength, hash);
+		if (memcmp(hash, head + 4, 4))
+			break;
+		self->indexHeader->clean = 0;
+		if (! CBCoinStoreApplyBatch(self, data, batchLength, offset + CB_COIN_STORE_BATCH_HEADER)) {
+			free(data);
+			return false;
+		}
+		self->indexHeader->logLength = offset + CB_COIN_STORE_BATCH_HEADER + batchLength;
+		self->indexHeader->undoLength = CBArrayToInt64(head, 8);
+		memcpy(self->indexHeader->tip, head + 16, 32);
+	}
+	free(data);
+	
+	// Remove a batch which was not completely written so that the next batch is written over it.
+	if (length > self->indexHeader->logLength && ! CBFileSetLength(self->logFile, self->indexHeader->logLength)) {
+		CBLogError("Could not remove an incomplete batch from the coin log.");
+		return false;
+	}
+	
+	if (! self->indexHeader->clean) {
+		if (! CBFileSyncMap(self->indexHeader, 0, self->indexLength)) {
+			CBLogError("Could not sync the coin index.");
+			return false;
+		}
+		self->indexHeader->clean = 1;
+		if (! CBFileSyncMap(self->indexHeader, 0, sizeof(CBCoinStoreIndexHeader))) {
+			CBLogError("Could not sync the coin index header.");
+			return false;
+		}
+	}
+	
+	return true;
+	
+}
+
+bool CBCoinStoreResizeTable(CBCoinStore * self, uint64_t tableSize) {
+	
+	CBCoinStoreIndexHeader * header = self->indexHeader;
+	uint64_t length = sizeof(CBCoinStoreIndexHeader) + tableSize * sizeof(CBCoinStoreSlot);
+	uint64_t liveNum = 0;
+	
+	// Take the slots of unspent coins
+	CBCoinStoreSlot * live = malloc(header->coinNum * sizeof(*live) + sizeof(*live));
+	for (uint64_t x = 0; x < header->tableSize; x++)
+		if (self->table[x].offset && self->table[x].offset != CB_COIN_STORE_DELETED)
+			live[liveNum++] = self->table[x];
+	
+	if (length != self->indexLength) {
+		if (! CBFileSetLength(self->indexFile, length)) {
+			CBLogError("Could not extend the coin index file.");
+			free(live);
+			return false;
+		}
+		CBFileUnmap(header, self->indexLength);
+		if (! CBFileMap(self->indexFile, 0, length, (void **)&header)) {
+			// Try to get the old mapping back.
+			CBLogError("Could not map the extended coin index file.");
+			free(live);
+			CBFileSetLength(self->indexFile, self->indexLength);
+			CBFileMap(self->indexFile, 0, self->indexLength, (void **)&self->indexHeader);
+			self->table = (CBCoinStoreSlot *)(self->indexHeader + 1);
+			return false;
+		}
+		self->indexHeader = header;
+		self->indexLength = length;
+		self->table = (CBCoinStoreSlot *)(header + 1);
+	}
+	
+	memset(self->table, 0, tableSize * sizeof(CBCoinStoreSlot));
+	header->tableSize = tableSize;
+	header->usedSlots = liveNum;
+	uint64_t mask = tableSize - 1;
+	for (uint64_t x = 0; x < liveNum; x++) {
+		uint64_t y = live[x].tag & mask;
+		while (self->table[y].offset)
+			y = (y + 1) & mask;
+		self->table[y] = live[x];
+	}
+	free(live);
+	
+	return true;
+	
+}
+
+void CBCoinStoreSpend(CBCoinStore * self, CBCoin * coin) {
+	
+	// A coin which is not on disk does not need to be written.
+	if (coin->flags & CB_COIN_FRESH)
+		CBCoinStoreCacheRemove(self, coin);
+	else
+		coin->flags |= CB_COIN_SPENT | CB_COIN_DIRTY;
+	
+}
+
+bool CBCoinStoreUndo(CBCoinStore * self, CBBlock * block, int txNum, int inputNum, unsigned char * undo, uint32_t undoLength) {
+	
+	unsigned char key[CB_COIN_KEY_SIZE];
+	int total = 0;
+	
+	if (txNum >= block->transactionNum)
+		inputNum = 0;
+	total = inputNum;
+	for (int x = 1; x < txNum && x < block->transactionNum; x++)
+		total += block->transactions[x]->inputNum;
+	
+	// Find the undo data of each spent coin, checking it before making any changes.
+	uint32_t * offsets = malloc(total * sizeof(*offsets) + sizeof(*offsets));
+	uint32_t pos = 0;
+	for (int x = 0; x < total; x++) {
+		if (undoLength - pos < 16 || undoLength - pos - 16 < CBArrayToInt32(undo, pos + 12)) {
+			pos = UINT32_MAX;
+			break;
+		}
+		offsets[x] = pos;
+		pos += 16 + CBArrayToInt32(undo, pos + 12);
+	}
+	if (pos != undoLength) {
+		CBLogError("The undo data of a block does not match the inputs of the block.");
+		free(offsets);
+		return false;
+	}
+	
+	// Go backwards through the transactions, removing the outputs and adding back the spent coins.
+	for (int x = txNum < block->transactionNum ? txNum : block->transactionNum - 1; x >= 0; x--) {
+		CBTransaction * tx = block->transactions[x];
+		int spent = inputNum;
+		if (x < txNum) {
+			unsigned char * hash = CBTransactionGetHash(tx);
+			for (int y = 0; y < tx->outputNum; y++) {
+				CBCoinStoreMakeKey(key, hash, y);
+				CBCoin * coin = CBCoinStoreGetByKey(self, key);
+				if (coin)
+					CBCoinStoreSpend(self, coin);
+			}
+			spent = x ? tx->inputNum : 0;
+		}
+		for (int y = spent - 1; y >= 0; y--) {
+			unsigned char * data = undo + offsets[--total];
+			CBPrevOut * prevOut = &tx->inputs[y]->prevOut;
+			uint32_t heightAndCoinbase = CBArrayToInt32(data, 8);
+			CBCoinStoreMakeKey(key, CBByteArrayGetData(prevOut->hash), prevOut->index);
+			CBCoinStoreAdd(self, key, CBArrayToInt64(data, 0), heightAndCoinbase >> 1, heightAndCoinbase & 1, data + 16, CBArrayToInt32(data, 12));
+		}
+	}
+	free(offsets);
+	
+	return true;
+	
+}
@@ -0,0 +1,233 @@
+//
+//  CBCompactTransaction.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+//  SEE HEADER FILE FOR DOCUMENTATION
+
+#include "CBCompactTransaction.h"
+
+//  Constructors
+
+CBCompactTransaction * CBNewCompactTransactionFromData(unsigned char * data, int length) {
+
+	int inputNum, outputNum, txLength;
+	if (! CBCompactTransactionMeasure(data, length, &inputNum, &outputNum, &txLength))
+		return NULL;
+
+	// Everything goes into one allocation. The outputs go first as they have 64-bit values.
+	CBCompactTransaction * self = malloc(sizeof(*self) + sizeof(*self->outputs) * outputNum + sizeof(*self->inputs) * inputNum + txLength);
+	CBInitObject(CBGetObject(self), false);
+	CBGetObject(self)->free = CBFreeCompactTransaction;
+	self->outputs = (CBCompactOutput *)(self + 1);
+	self->inputs = (CBCompactInput *)(self->outputs + outputNum);
+	self->data = (unsigned char *)(self->inputs + inputNum);
+	self->inputNum = inputNum;
+	self->outputNum = outputNum;
+	self->length = txLength;
+	self->hashSet = false;
+	memcpy(self->data, data, txLength);
+
+	// The data has been checked so it can now be read without bounds checks
+	data = self->data;
+	self->version = CBArrayToInt32(data, 0);
+	int cursor = 4 + CBVarIntDecodeSize(data, 4);
+
+	for (int x = 0; x < inputNum; x++) {
+
+		CBCompactInput * input = self->inputs + x;
+		input->offset = cursor;
+		input->prevOutIndex = CBArrayToInt32(data, cursor + 32);
+		CBVarInt scriptLen = CBVarIntDecodeData(data, cursor + 36);
+		input->scriptOffset = cursor + 36 + scriptLen.size;
+		input->scriptLength = (uint32_t)scriptLen.val;
+		cursor = input->scriptOffset + input->scriptLength;
+		input->sequence = CBArrayToInt32(data, cursor);
+		cursor += 4;
+
+	}
+
+	cursor += CBVarIntDecodeSize(data, cursor);
+
+	for (int x = 0; x < outputNum; x++) {
+
+		CBCompactOutput * output = self->outputs + x;
+		output->value = CBArrayToInt64(data, cursor);
+		CBVarInt scriptLen = CBVarIntDecodeData(data, cursor + 8);
+		output->scriptOffset = cursor + 8 + scriptLen.size;
+		output->scriptLength = (uint32_t)scriptLen.val;
+		cursor = output->scriptOffset + output->scriptLength;
+
+	}
+
+	self->lockTime = CBArrayToInt32(data, cursor);
+
+	return self;
+
+}
+
+CBCompactTransaction * CBNewCompactTransactionFromTransaction(CBTransaction * tx) {
+
+	CBByteArray * bytes = CBGetMessage(tx)->bytes;
+
+	if (! bytes) {
+		CBTransactionPrepareBytes(tx);
+		if (! CBTransactionSerialise(tx, false)) {
+			CBLogError("Could not serialise a transaction for a CBCompactTransaction.");
+			return NULL;
+		}
+		bytes = CBGetMessage(tx)->bytes;
+	}
+
+	CBCompactTransaction * self = CBNewCompactTransactionFromData(CBByteArrayGetData(bytes), bytes->length);
+	if (self && tx->hashSet) {
+		memcpy(self->hash, tx->hash, 32);
+		self->hashSet = true;
+	}
+
+	return self;
+
+}
+
+//  Destructor
+
+void CBFreeCompactTransaction(void * self) {
+
+	free(self);
+
+}
+
+//  Functions
+
+unsigned char * CBCompactTransactionGetHash(CBCompactTransaction * self) {
+
+	if (! self->hashSet) {
+		unsigned char hash[32];
+		CBSha256(self->data, self->length, hash);
+		CBSha256(hash, 32, self->hash);
+		self->hashSet = true;
+	}
+
+	return self->hash;
+
+}
+
+bool CBCompactTransactionMeasure(unsigned char * data, int length, int * inputNum, int * outputNum, int * txLength) {
+
+	if (length < 10) {
+		CBLogError("Attempting to read a CBCompactTransaction with less than 10 bytes.");
+		return false;
+	}
+
+	// Read the number of inputs. The length is at least 10 so the var int can be read.
+	CBVarInt num = CBVarIntDecodeData(data, 4);
+	if (num.val < 1 || num.val > (length - 10) / 41) {
+		CBLogError("Attempting to read a CBCompactTransaction with a bad var int for the number of inputs.");
+		return false;
+	}
+
+	*inputNum = (int)num.val;
+	int cursor = 4 + num.size;
+
+	for (int x = 0; x < *inputNum; x++) {
+
+		// Need the previous output, the first byte of the script length and the sequence
+		if (length - cursor < 41) {
+			CBLogError("Attempting to read a CBCompactTransaction with not enough bytes for input number %i.", x);
+			return false;
+		}
+
+		cursor += 36;
+		if (length - cursor < CBVarIntDecodeSize(data, cursor) + 4) {
+			CBLogError("Attempting to read a CBCompactTransaction with not enough bytes for the script length of input number %i.", x);
+			return false;
+		}
+
+		CBVarInt scriptLen = CBVarIntDecodeData(data, cursor);
+		if (scriptLen.val < 0 || scriptLen.val > 10000) {
+			CBLogError("Attempting to read a CBCompactTransaction with too big a script for input number %i.", x);
+			return false;
+		}
+
+		cursor += scriptLen.size + (int)scriptLen.val;
+		if (length - cursor < 4) {
+			CBLogError("Attempting to read a CBCompactTransaction with not enough bytes for the script of input number %i.", x);
+			return false;
+		}
+		cursor += 4;
+
+	}
+
+	// Needs at least 5 more for the output var int and the lockTime
+	if (length - cursor < 5 || length - cursor < CBVarIntDecodeSize(data, cursor) + 4) {
+		CBLogError("Attempting to read a CBCompactTransaction with not enough bytes for the outputs and lockTime.");
+		return false;
+	}
+
+	num = CBVarIntDecodeData(data, cursor);
+	if (num.val < 1 || num.val > (length - 10) / 9) {
+		CBLogError("Attempting to read a CBCompactTransaction with a bad var int for the number of outputs.");
+		return false;
+	}
+
+	*outputNum = (int)num.val;
+	cursor += num.size;
+
+	for (int x = 0; x < *outputNum; x++) {
+
+		if (length - cursor < 9 || length - cursor < 8 + CBVarIntDecodeSize(data, cursor + 8)) {
+			CBLogError("Attempting to read a CBCompactTransaction with not enough bytes for output number %i.", x);
+			return false;
+		}
+
+		CBVarInt scriptLen = CBVarIntDecodeData(data, cursor + 8);
+		if (scriptLen.val < 0 || scriptLen.val > 10000) {
+			CBLogError("Attempting to read a CBCompactTransaction with too big a script for output number %i.", x);
+			return false;
+		}
+
+		cursor += 8 + scriptLen.size + (int)scriptLen.val;
+		if (cursor > length) {
+			CBLogError("Attempting to read a CBCompactTransaction with not enough bytes for the script of output number %i.", x);
+			return false;
+		}
+
+	}
+
+	if (length - cursor < 4) {
+		CBLogError("Attempting to read a CBCompactTransaction with not enough bytes for the lockTime.");
+		return false;
+	}
+
+	*txLength = cursor + 4;
+
+	return true;
+
+}
+
+CBTransaction * CBCompactTransactionToTransaction(CBCompactTransaction * self) {
+
+	CBByteArray * bytes = CBNewByteArrayWithDataCopy(self->data, self->length);
+	CBTransaction * tx = CBNewTransactionFromData(bytes);
+	CBReleaseObject(bytes);
+
+	// The data has already been checked.
+	CBTransactionDeserialise(tx);
+
+	if (self->hashSet) {
+		memcpy(tx->hash, self->hash, 32);
+		tx->hashSet = true;
+	}
+
+	return tx;
+
+}
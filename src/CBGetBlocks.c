@@ -15,6 +15,7 @@
 //  SEE HEADER FILE FOR DOCUMENTATION 
 
 #include "CBGetBlocks.h"
+#include "CBCursor.h"
 
 //  Constructors
 
@@ -105,7 +106,9 @@ int CBGetBlocksDeserialise(CBGetBlocks * self) {
 		return CB_DESERIALISE_ERROR;
 	}
 	
-	self->version = CBByteArrayReadInt32(bytes, 0);
+	CBCursor cursor;
+	CBInitCursor(&cursor, bytes);
+	self->version = CBCursorReadInt32(&cursor);
 	
 	// Deserialise the CBChainDescriptor
 	
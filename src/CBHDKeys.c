@@ -290,26 +290,28 @@ CBWIF * CBHDKeyGetWIF(CBHDKey * key) {
 void CBHDKeyHmacSha512(unsigned char * inputData, unsigned char * chainCode, unsigned char * output) {
 
 	// SHA512 has block size of 1024 bits or 128 bytes
-	unsigned char msg[192], inner[32], outer[32], hash[64]; 	
-
-	memcpy(msg, chainCode, 32);
-
-	for (int x = 0; x < 32; x++) {
-		inner[x] = msg[x] ^ 0x36;
-		outer[x] = msg[x] ^ 0x5c;
-	}
-
-	memcpy(msg, inner, 32);
-	memset(msg + 32, 0x36, 96);
-	memcpy(msg + 128, inputData, 37);
-
-	CBSha512(msg, 165, hash);
-
-	memcpy(msg + 128, hash, 64);
-	memcpy(msg, outer, 32);
-	memset(msg + 32, 0x5c, 96);
-
-	CBSha512(msg, 192, output);
+	unsigned char pad[128], hash[64];
+	CBSha512Context ctx;
+
+	// Inner hash
+	memset(pad + 32, 0x36, 96);
+	for (int x = 0; x < 32; x++)
+		pad[x] = chainCode[x] ^ 0x36;
+
+	CBSha512Init(&ctx);
+	CBSha512Update(&ctx, pad, 128);
+	CBSha512Update(&ctx, inputData, 37);
+	CBSha512Final(&ctx, hash);
+
+	// Outer hash
+	memset(pad + 32, 0x5c, 96);
+	for (int x = 0; x < 32; x++)
+		pad[x] = chainCode[x] ^ 0x5c;
+
+	CBSha512Init(&ctx);
+	CBSha512Update(&ctx, pad, 128);
+	CBSha512Update(&ctx, hash, 64);
+	CBSha512Final(&ctx, output);
 
 }
 
@@ -0,0 +1,308 @@
+//
+//  CBHeaderArray.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+//  SEE HEADER FILE FOR DOCUMENTATION
+
+#include "CBHeaderArray.h"
+#include "CBValidationFunctions.h"
+
+//  Constructors
+
+CBHeaderArray * CBNewHeaderArray(int capacity) {
+	
+	CBHeaderArray * self = malloc(sizeof(*self));
+	CBInitObject(CBGetObject(self), false);
+	CBGetObject(self)->free = CBFreeHeaderArray;
+	CBInitHeaderArray(self, capacity);
+	
+	return self;
+	
+}
+
+CBHeaderArray * CBNewHeaderArrayFromPayload(unsigned char * data, int length) {
+	
+	CBHeaderArray * self = CBNewHeaderArray(0);
+	if (CBHeaderArrayAppendPayload(self, data, length) == CB_DESERIALISE_ERROR) {
+		CBFreeHeaderArray(self);
+		return NULL;
+	}
+	
+	return self;
+	
+}
+
+//  Initialiser
+
+void CBInitHeaderArray(CBHeaderArray * self, int capacity) {
+	
+	self->headerNum = 0;
+	self->hashedNum = 0;
+	self->capacity = 0;
+	self->headers = NULL;
+	self->hashes = NULL;
+	CBHeaderArrayReserve(self, capacity);
+	
+}
+
+//  Destructor
+
+void CBDestroyHeaderArray(void * vself) {
+	
+	CBHeaderArray * self = vself;
+	free(self->headers);
+	free(self->hashes);
+	
+}
+
+void CBFreeHeaderArray(void * self) {
+	
+	CBDestroyHeaderArray(self);
+	free(self);
+	
+}
+
+//  Functions
+
+void CBHeaderArrayAppend(CBHeaderArray * self, unsigned char * header) {
+	
+	CBHeaderArrayReserve(self, self->headerNum + 1);
+	memcpy(CBHeaderArrayGetHeader(self, self->headerNum++), header, CB_HEADER_SIZE);
+	
+}
+
+void CBHeaderArrayAppendBlock(CBHeaderArray * self, CBBlock * block) {
+	
+	CBHeaderArrayAppend(self, CBByteArrayGetData(CBGetMessage(block)->bytes));
+	if (block->hashSet && self->hashedNum == self->headerNum - 1) {
+		// Keep the hash we already have
+		memcpy(self->hashes + self->hashedNum * 32, block->hash, 32);
+		self->hashedNum++;
+	}
+	
+}
+
+int CBHeaderArrayAppendPayload(CBHeaderArray * self, unsigned char * data, int length) {
+	
+	if (length < 1) {
+		CBLogError("Attempting to add headers from a payload with no bytes.");
+		return CB_DESERIALISE_ERROR;
+	}
+	int cursor = CBVarIntDecodeSize(data, 0);
+	if (cursor > length) {
+		CBLogError("Attempting to add headers from a payload with less bytes than required for the var int.");
+		return CB_DESERIALISE_ERROR;
+	}
+	CBVarInt headerNum = CBVarIntDecodeData(data, 0);
+	if (headerNum.val < 0 || headerNum.val > 2000) {
+		CBLogError("Attempting to add headers from a payload with a var int over 2000.");
+		return CB_DESERIALISE_ERROR;
+	}
+	
+	// Copy the headers after the existing ones and only include them once they have all been read.
+	CBHeaderArrayReserve(self, self->headerNum + (int)headerNum.val);
+	
+	for (int x = 0; x < headerNum.val; x++) {
+		
+		// Each header is followed by a transaction number, which is skipped, and a null byte.
+		if (length - cursor < CB_HEADER_SIZE + 2) {
+			CBLogError("Attempting to add headers from a payload with less bytes than required for the header number %i.", x);
+			return CB_DESERIALISE_ERROR;
+		}
+		int txNumSize = CBVarIntDecodeSize(data, cursor + CB_HEADER_SIZE);
+		if (length - cursor < CB_HEADER_SIZE + txNumSize + 1) {
+			CBLogError("Attempting to add headers from a payload with less bytes than required for the transaction number of the header number %i.", x);
+			return CB_DESERIALISE_ERROR;
+		}
+		if (data[cursor + CB_HEADER_SIZE + txNumSize]) {
+			CBLogError("Attempting to add headers from a payload where the header number %i does not end with a null byte.", x);
+			return CB_DESERIALISE_ERROR;
+		}
+		
+		memcpy(CBHeaderArrayGetHeader(self, self->headerNum + x), data + cursor, CB_HEADER_SIZE);
+		cursor += CB_HEADER_SIZE + txNumSize + 1;
+		
+	}
+	
+	self->headerNum += headerNum.val;
+	
+	return cursor;
+	
+}
+
+void CBHeaderArrayCalculateHashes(CBHeaderArray * self) {
+	
+	CBHeaderHasherHashHeaders(CBHeaderArrayGetHeader(self, self->hashedNum), self->headerNum - self->hashedNum, self->hashes + self->hashedNum * 32);
+	self->hashedNum = self->headerNum;
+	
+}
+
+int CBHeaderArrayFindInvalid(CBHeaderArray * self, unsigned char * prevHash) {
+	
+	return CBHeaderArrayValidate(self, 0, prevHash, 1);
+	
+}
+
+CBBlock * CBHeaderArrayGetBlock(CBHeaderArray * self, int x) {
+	
+	// The header with a zero transaction number and the null byte
+	CBByteArray * bytes = CBNewByteArrayOfSize(CB_HEADER_SIZE + 2);
+	CBByteArraySetBytes(bytes, 0, CBHeaderArrayGetHeader(self, x), CB_HEADER_SIZE);
+	CBByteArraySetInt16(bytes, CB_HEADER_SIZE, 0);
+	
+	CBBlock * block = CBNewBlockFromData(bytes);
+	CBReleaseObject(bytes);
+	CBBlockDeserialise(block, false);
+	
+	if (x < self->hashedNum) {
+		memcpy(block->hash, self->hashes + x * 32, 32);
+		block->hashSet = true;
+	}
+	
+	return block;
+	
+}
+
+unsigned char * CBHeaderArrayGetHash(CBHeaderArray * self, int x) {
+	
+	if (x >= self->hashedNum)
+		CBHeaderArrayCalculateHashes(self);
+	
+	return self->hashes + x * 32;
+	
+}
+
+int CBHeaderArrayPayloadLength(CBHeaderArray * self) {
+	
+	return CBVarIntSizeOf(self->headerNum) + self->headerNum * (CB_HEADER_SIZE + 2);
+	
+}
+
+void CBHeaderArrayReserve(CBHeaderArray * self, int capacity) {
+	
+	if (capacity <= self->capacity)
+		return;
+	
+	if (capacity < self->capacity * 2)
+		capacity = self->capacity * 2;
+	
+	self->headers = realloc(self->headers, capacity * CB_HEADER_SIZE);
+	self->hashes = realloc(self->hashes, capacity * 32);
+	self->capacity = capacity;
+	
+}
+
+int CBHeaderArraySerialisePayload(CBHeaderArray * self, unsigned char * data) {
+	
+	CBVarInt num = CBVarIntFromUInt64(self->headerNum);
+	CBByteArraySetVarIntData(data, 0, num);
+	int cursor = num.size;
+	
+	for (int x = 0; x < self->headerNum; x++) {
+		memcpy(data + cursor, CBHeaderArrayGetHeader(self, x), CB_HEADER_SIZE);
+		data[cursor + CB_HEADER_SIZE] = 0;
+		data[cursor + CB_HEADER_SIZE + 1] = 0;
+		cursor += CB_HEADER_SIZE + 2;
+	}
+	
+	return cursor;
+	
+}
+
+int CBHeaderArrayValidate(CBHeaderArray * self, int start, unsigned char * prevHash, int numThreads) {
+	
+	int num = self->headerNum - start;
+	if (num <= 0)
+		return self->headerNum;
+	
+	if (! prevHash && start) {
+		// Only hash upto the header before start as the rest are hashed below.
+		if (self->hashedNum < start) {
+			CBHeaderHasherHashHeaders(CBHeaderArrayGetHeader(self, self->hashedNum), start - self->hashedNum, self->hashes + self->hashedNum * 32);
+			self->hashedNum = start;
+		}
+		prevHash = self->hashes + (start - 1) * 32;
+	}
+	
+	if (prevHash && memcmp(CBHeaderArrayGetPrevBlockHash(self, start), prevHash, 32))
+		return start;
+	
+	if (numThreads < 1)
+		numThreads = CBGetNumberOfCores();
+	
+	// Use more items than threads so that a slow thread does not hold up the rest, but keep whole lanes in each item.
+	int itemNum = numThreads == 1 ? 1 : numThreads * 4;
+	if (itemNum > num / CB_HEADER_HASHER_LANES)
+		itemNum = num / CB_HEADER_HASHER_LANES;
+	if (itemNum < 1)
+		itemNum = 1;
+	
+	CBHeaderArrayValidateJob job = {self, self->headerNum, start, num, itemNum};
+	
+	CBThreadPoolRun(CBHeaderArrayValidateProcess, &job, itemNum, numThreads);
+	
+	// Check the linkage between the ranges, upto the first invalid header found.
+	for (int x = 1; x < itemNum; x++) {
+		int first = start + (int)((long long int)num * x / itemNum);
+		if (first >= job.firstInvalid)
+			break;
+		if (memcmp(CBHeaderArrayGetPrevBlockHash(self, first), self->hashes + (first - 1) * 32, 32)) {
+			job.firstInvalid = first;
+			break;
+		}
+	}
+	
+	// All of the headers from start have been hashed
+	if (self->hashedNum >= start)
+		self->hashedNum = self->headerNum;
+	
+	return job.firstInvalid;
+	
+}
+
+void CBHeaderArrayValidateProcess(void * vjob, int item) {
+	
+	CBHeaderArrayValidateJob * job = vjob;
+	int start = job->start + (int)((long long int)job->num * item / job->itemNum);
+	int end = job->start + (int)((long long int)job->num * (item + 1) / job->itemNum);
+	
+	int invalid = CBHeaderArrayValidateRange(job->array, start, end);
+	if (invalid == end)
+		return;
+	
+	// Keep the lowest invalid index
+	int current = __atomic_load_n(&job->firstInvalid, __ATOMIC_RELAXED);
+	while (invalid < current
+		   && ! __atomic_compare_exchange_n(&job->firstInvalid, &current, invalid, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	
+}
+
+int CBHeaderArrayValidateRange(CBHeaderArray * self, int start, int end) {
+	
+	CBHeaderHasherHashHeaders(CBHeaderArrayGetHeader(self, start), end - start, self->hashes + start * 32);
+	
+	for (int x = start; x < end; x++) {
+		
+		// Check the header follows the last
+		if (x > start && memcmp(CBHeaderArrayGetPrevBlockHash(self, x), self->hashes + (x - 1) * 32, 32))
+			return x;
+		
+		// Check the proof of work
+		if (! CBValidateProofOfWork(self->hashes + x * 32, CBHeaderArrayGetTarget(self, x)))
+			return x;
+		
+	}
+	
+	return end;
+	
+}
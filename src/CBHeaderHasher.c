@@ -0,0 +1,338 @@
+//
+//  CBHeaderHasher.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+//  SEE HEADER FILE FOR DOCUMENTATION
+
+#include "CBHeaderHasher.h"
+
+// SHA-256 constants
+
+#define CBRotr32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+const uint32_t CBSha256RoundConstants[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+const uint32_t CBSha256InitialState[8] = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+//  Initialiser
+
+void CBInitHeaderHasher(CBHeaderHasher * self, unsigned char * header) {
+	
+	memcpy(self->header, header, 80);
+	
+	// Calculate the midstate
+	CBHeaderHasherSetMerkleRoot(self, header + 36);
+	
+	// Expand the target into a 256-bit little-endian number.
+	unsigned int bits = CBArrayToInt32(header, 72);
+	int zeroBytes = bits >> 24;
+	unsigned char target[32];
+	memset(target, 0, 32);
+	
+	// A negative mantissa gives a zero target.
+	if (!(bits & 0x800000)) {
+		if (zeroBytes > 32)
+			// Overflowed so allow any hash.
+			memset(target, 0xFF, 32);
+		else for (int x = 0; x < 3; x++) {
+			int pos = zeroBytes - 3 + x;
+			if (pos >= 0)
+				target[pos] = bits >> (8 * x);
+		}
+	}
+	
+	for (int x = 0; x < 8; x++)
+		self->target[x] = CBArrayToInt32(target, x * 4);
+	
+}
+
+//  Functions
+
+void CBHeaderHasherHash(CBHeaderHasher * self, uint32_t nonce, unsigned char * hash) {
+	
+	CBInt32ToArray(self->header, 76, nonce);
+	
+	// Only the last 16 bytes need to be hashed from the midstate
+	CBSha256Context ctx = self->midstateCtx;
+	unsigned char firstHash[32];
+	
+	CBSha256Update(&ctx, self->header + 64, 16);
+	CBSha256Final(&ctx, firstHash);
+	CBSha256(firstHash, 32, hash);
+	
+}
+
+void CBHeaderHasherHashHeaders(unsigned char * headers, int num, unsigned char * hashes) {
+	
+	uint32_t state[8][CB_HEADER_HASHER_LANES];
+	uint32_t block[16][CB_HEADER_HASHER_LANES];
+	
+	for (int done = 0; done < num; done += CB_HEADER_HASHER_LANES) {
+		
+		// Unused lanes repeat the last header.
+		int lanes = num - done < CB_HEADER_HASHER_LANES ? num - done : CB_HEADER_HASHER_LANES;
+		
+		// Hash the first 64 bytes of each header.
+		for (int x = 0; x < CB_HEADER_HASHER_LANES; x++) {
+			unsigned char * header = headers + (done + (x < lanes ? x : lanes - 1)) * 80;
+			for (int y = 0; y < 8; y++)
+				state[y][x] = CBSha256InitialState[y];
+			for (int y = 0; y < 16; y++)
+				block[y][x] = CBArrayToInt32BigEndian(header, y * 4);
+		}
+		
+		CBHeaderHasherTransformLanes(state, block);
+		
+		// Hash the last 16 bytes with the padding.
+		for (int x = 0; x < CB_HEADER_HASHER_LANES; x++) {
+			unsigned char * header = headers + (done + (x < lanes ? x : lanes - 1)) * 80;
+			for (int y = 0; y < 4; y++)
+				block[y][x] = CBArrayToInt32BigEndian(header, 64 + y * 4);
+			block[4][x] = 0x80000000;
+			for (int y = 5; y < 15; y++)
+				block[y][x] = 0;
+			block[15][x] = 640; // 80 bytes in bits
+		}
+		
+		CBHeaderHasherTransformLanes(state, block);
+		
+		// Hash the first hash
+		for (int x = 0; x < CB_HEADER_HASHER_LANES; x++) {
+			for (int y = 0; y < 8; y++) {
+				block[y][x] = state[y][x];
+				state[y][x] = CBSha256InitialState[y];
+			}
+			block[8][x] = 0x80000000;
+			for (int y = 9; y < 15; y++)
+				block[y][x] = 0;
+			block[15][x] = 256; // 32 bytes in bits
+		}
+		
+		CBHeaderHasherTransformLanes(state, block);
+		
+		for (int x = 0; x < lanes; x++)
+			for (int y = 0; y < 8; y++) {
+				CBInt32ToArrayBigEndian(hashes, (done + x) * 32 + y * 4, state[y][x]);
+			}
+		
+	}
+	
+}
+
+void CBHeaderHasherHashLanes(CBHeaderHasher * self, uint32_t * nonces, unsigned char * hashes) {
+	
+	uint32_t state[8][CB_HEADER_HASHER_LANES];
+	
+	CBHeaderHasherHashLanesState(self, nonces, state);
+	
+	for (int x = 0; x < CB_HEADER_HASHER_LANES; x++)
+		for (int y = 0; y < 8; y++) {
+			CBInt32ToArrayBigEndian(hashes, x * 32 + y * 4, state[y][x]);
+		}
+	
+}
+
+void CBHeaderHasherHashLanesState(CBHeaderHasher * self, uint32_t * nonces, uint32_t state[8][CB_HEADER_HASHER_LANES]) {
+	
+	uint32_t block[16][CB_HEADER_HASHER_LANES];
+	uint32_t tail[3];
+	
+	for (int x = 0; x < 3; x++)
+		tail[x] = CBArrayToInt32BigEndian(self->header, 64 + x * 4);
+	
+	// Hash the last 16 bytes of the header from the midstate.
+	for (int x = 0; x < CB_HEADER_HASHER_LANES; x++) {
+		
+		unsigned char nonce[4];
+		CBInt32ToArray(nonce, 0, nonces[x]);
+		
+		for (int y = 0; y < 8; y++)
+			state[y][x] = self->midstate[y];
+		
+		for (int y = 0; y < 3; y++)
+			block[y][x] = tail[y];
+		
+		block[3][x] = CBArrayToInt32BigEndian(nonce, 0);
+		block[4][x] = 0x80000000;
+		for (int y = 5; y < 15; y++)
+			block[y][x] = 0;
+		block[15][x] = 640; // 80 bytes in bits
+		
+	}
+	
+	CBHeaderHasherTransformLanes(state, block);
+	
+	// Hash the first hash
+	for (int x = 0; x < CB_HEADER_HASHER_LANES; x++) {
+		
+		for (int y = 0; y < 8; y++) {
+			block[y][x] = state[y][x];
+			state[y][x] = CBSha256InitialState[y];
+		}
+		
+		block[8][x] = 0x80000000;
+		for (int y = 9; y < 15; y++)
+			block[y][x] = 0;
+		block[15][x] = 256; // 32 bytes in bits
+		
+	}
+	
+	CBHeaderHasherTransformLanes(state, block);
+	
+}
+
+bool CBHeaderHasherMeetsTarget(CBHeaderHasher * self, unsigned char * hash) {
+	
+	// Compare from the most significant word
+	for (int x = 8; x--;) {
+		uint32_t word = CBArrayToInt32(hash, x * 4);
+		if (word < self->target[x])
+			return true;
+		if (word > self->target[x])
+			return false;
+	}
+	
+	// Equal to the target
+	return true;
+	
+}
+
+bool CBHeaderHasherSearch(CBHeaderHasher * self, uint32_t * nonce, uint32_t count, unsigned char * hash) {
+	
+	uint32_t state[8][CB_HEADER_HASHER_LANES];
+	uint32_t nonces[CB_HEADER_HASHER_LANES];
+	
+	// Count in 64 bits so that a count near UINT32_MAX does not wrap around.
+	for (uint64_t done = 0; done < count; done += CB_HEADER_HASHER_LANES) {
+		
+		for (int x = 0; x < CB_HEADER_HASHER_LANES; x++)
+			nonces[x] = *nonce + (uint32_t)done + x;
+		
+		CBHeaderHasherHashLanesState(self, nonces, state);
+		
+		for (int x = 0; x < CB_HEADER_HASHER_LANES && done + x < count; x++) {
+			
+			// The most significant word of the hash is the last state word in little-endian. Reject most hashes on this word alone.
+			unsigned char top[4];
+			CBInt32ToArrayBigEndian(top, 0, state[7][x]);
+			if (CBArrayToInt32(top, 0) > self->target[7])
+				continue;
+			
+			for (int y = 0; y < 8; y++) {
+				CBInt32ToArrayBigEndian(hash, y * 4, state[y][x]);
+			}
+			
+			if (CBHeaderHasherMeetsTarget(self, hash)) {
+				*nonce = nonces[x];
+				CBInt32ToArray(self->header, 76, *nonce);
+				return true;
+			}
+			
+		}
+		
+	}
+	
+	*nonce += count;
+	
+	return false;
+	
+}
+
+void CBHeaderHasherSetExtraNonce(CBHeaderHasher * self, CBTransaction * coinbase, int offset, int size, uint64_t extraNonce, unsigned char * branch, int branchNum) {
+	
+	// Write the extra nonce into the coinbase
+	unsigned char * data = CBByteArrayGetData(CBGetMessage(coinbase)->bytes) + offset;
+	for (int x = 0; x < size; x++)
+		data[x] = extraNonce >> (8 * x);
+	
+	// Rehash the coinbase and calculate the merkle root with it.
+	coinbase->hashSet = false;
+	unsigned char merkleRoot[32];
+	CBMerkleRootFromLeftBranch(CBTransactionGetHash(coinbase), branch, branchNum, merkleRoot);
+	
+	CBHeaderHasherSetMerkleRoot(self, merkleRoot);
+	
+}
+
+void CBHeaderHasherSetMerkleRoot(CBHeaderHasher * self, unsigned char * merkleRoot) {
+	
+	memmove(self->header + 36, merkleRoot, 32);
+	
+	// The first 64 bytes have changed so recalculate the midstate.
+	unsigned char midstate[CB_SHA256_MIDSTATE_SIZE];
+	
+	CBSha256Init(&self->midstateCtx);
+	CBSha256Update(&self->midstateCtx, self->header, 64);
+	CBSha256GetMidstate(&self->midstateCtx, midstate);
+	
+	for (int x = 0; x < 8; x++)
+		self->midstate[x] = CBArrayToInt32BigEndian(midstate, x * 4);
+	
+}
+
+void CBHeaderHasherSetTime(CBHeaderHasher * self, uint32_t time) {
+	
+	CBInt32ToArray(self->header, 68, time);
+	
+}
+
+void CBHeaderHasherTransformLanes(uint32_t state[8][CB_HEADER_HASHER_LANES], uint32_t block[16][CB_HEADER_HASHER_LANES]) {
+	
+	// Each operation is done for all lanes in an inner loop so that it can be vectorised.
+	uint32_t w[64][CB_HEADER_HASHER_LANES];
+	uint32_t v[8][CB_HEADER_HASHER_LANES];
+	
+	memcpy(w, block, sizeof(*w) * 16);
+	memcpy(v, state, sizeof(v));
+	
+	// Message schedule
+	for (int t = 16; t < 64; t++)
+		for (int l = 0; l < CB_HEADER_HASHER_LANES; l++) {
+			uint32_t s0 = CBRotr32(w[t-15][l], 7) ^ CBRotr32(w[t-15][l], 18) ^ (w[t-15][l] >> 3);
+			uint32_t s1 = CBRotr32(w[t-2][l], 17) ^ CBRotr32(w[t-2][l], 19) ^ (w[t-2][l] >> 10);
+			w[t][l] = w[t-16][l] + s0 + w[t-7][l] + s1;
+		}
+	
+	// Compression rounds
+	for (int t = 0; t < 64; t++)
+		for (int l = 0; l < CB_HEADER_HASHER_LANES; l++) {
+			uint32_t e = v[4][l];
+			uint32_t a = v[0][l];
+			uint32_t t1 = v[7][l] + (CBRotr32(e, 6) ^ CBRotr32(e, 11) ^ CBRotr32(e, 25)) + ((e & v[5][l]) ^ (~e & v[6][l])) + CBSha256RoundConstants[t] + w[t][l];
+			uint32_t t2 = (CBRotr32(a, 2) ^ CBRotr32(a, 13) ^ CBRotr32(a, 22)) + ((a & v[1][l]) ^ (a & v[2][l]) ^ (v[1][l] & v[2][l]));
+			v[7][l] = v[6][l];
+			v[6][l] = v[5][l];
+			v[5][l] = e;
+			v[4][l] = v[3][l] + t1;
+			v[3][l] = v[2][l];
+			v[2][l] = v[1][l];
+			v[1][l] = a;
+			v[0][l] = t1 + t2;
+		}
+	
+	for (int x = 0; x < 8; x++)
+		for (int l = 0; l < CB_HEADER_HASHER_LANES; l++)
+			state[x][l] += v[x][l];
+	
+}
@@ -0,0 +1,434 @@
+//
+//  CBHeaderStore.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+//  SEE HEADER FILE FOR DOCUMENTATION
+
+#include "CBHeaderStore.h"
+#include "CBValidationFunctions.h"
+#include <stddef.h>
+
+//  Initialiser
+
+bool CBInitHeaderStore(CBHeaderStore * self, char * dataDir) {
+	
+	char filename[strlen(dataDir) + 20];
+	uint64_t length;
+	
+	// Open the records
+	sprintf(filename, "%s/headers.dat", dataDir);
+	if (! CBFileOpen(&self->recordFile, filename, true)) {
+		CBLogError("Could not open the header store file %s.", filename);
+		return false;
+	}
+	if (! CBFileGetLength(self->recordFile, &length)) {
+		CBLogError("Could not get the length of the header store file.");
+		CBFileClose(self->recordFile);
+		return false;
+	}
+	bool new = length == 0;
+	if (new) {
+		length = (uint64_t)(CB_HEADER_STORE_GROW + 1) * sizeof(CBHeaderStoreRecord);
+		if (! CBFileSetLength(self->recordFile, length)) {
+			CBLogError("Could not set the length of a new header store file.");
+			CBFileClose(self->recordFile);
+			return false;
+		}
+	}else if (length % sizeof(CBHeaderStoreRecord) || length < 2 * sizeof(CBHeaderStoreRecord)) {
+		CBLogError("The header store file has a bad length.");
+		CBFileClose(self->recordFile);
+		return false;
+	}
+	if (! CBFileMap(self->recordFile, 0, length, (void **)&self->fileHeader)) {
+		CBLogError("Could not map the header store file.");
+		CBFileClose(self->recordFile);
+		return false;
+	}
+	self->records = (CBHeaderStoreRecord *)self->fileHeader + 1;
+	self->capacity = (uint32_t)(length / sizeof(CBHeaderStoreRecord) - 1);
+	if (new) {
+		self->fileHeader->magic = CB_HEADER_STORE_MAGIC;
+		self->fileHeader->recordSize = sizeof(CBHeaderStoreRecord);
+		self->fileHeader->syncedNum = 0;
+	}else if (self->fileHeader->magic != CB_HEADER_STORE_MAGIC || self->fileHeader->recordSize != sizeof(CBHeaderStoreRecord)) {
+		CBLogError("The header store file is not a header store or has a different record size.");
+		CBFileUnmap(self->fileHeader, length);
+		CBFileClose(self->recordFile);
+		return false;
+	}
+	
+	// The synced records are trusted, and records after them are accepted when they were completely written.
+	self->headerNum = self->fileHeader->syncedNum < self->capacity ? self->fileHeader->syncedNum : self->capacity;
+	while (self->headerNum < self->capacity && CBHeaderStoreRecordIsValid(self, self->headerNum))
+		self->headerNum++;
+	
+	// Open the hash table
+	sprintf(filename, "%s/headerIndex.dat", dataDir);
+	self->indexHeader = NULL;
+	if (! CBFileOpen(&self->indexFile, filename, true)) {
+		CBLogError("Could not open the header store index file %s.", filename);
+		CBFileUnmap(self->fileHeader, length);
+		CBFileClose(self->recordFile);
+		return false;
+	}
+	if (CBFileGetLength(self->indexFile, &length)
+		&& length >= sizeof(CBHeaderStoreIndexHeader)
+		&& CBFileMap(self->indexFile, 0, length, (void **)&self->indexHeader)) {
+		
+		self->table = (uint32_t *)(self->indexHeader + 1);
+		uint32_t tableSize = self->indexHeader->tableSize;
+		
+		if (self->indexHeader->magic == CB_HEADER_STORE_INDEX_MAGIC
+			&& tableSize >= CB_HEADER_STORE_MIN_TABLE
+			&& ! (tableSize & (tableSize - 1))
+			&& length == sizeof(CBHeaderStoreIndexHeader) + (uint64_t)tableSize * 4) {
+			
+			// Add any records which were not indexed when the table was synced.
+			uint32_t x = self->indexHeader->indexedNum < self->headerNum ? self->indexHeader->indexedNum : self->headerNum;
+			for (; x < self->headerNum; x++)
+				if (! CBHeaderStoreIndex(self, x))
+					break;
+			if (x == self->headerNum)
+				return true;
+			
+		}
+		
+	}
+	
+	// The hash table needs to be made again.
+	if (! CBHeaderStoreRebuildIndex(self)) {
+		CBDestroyHeaderStore(self);
+		return false;
+	}
+	
+	return true;
+	
+}
+
+//  Destructor
+
+void CBDestroyHeaderStore(CBHeaderStore * self) {
+	
+	if (self->indexHeader) {
+		CBHeaderStoreSync(self);
+		CBFileUnmap(self->indexHeader, sizeof(CBHeaderStoreIndexHeader) + (uint64_t)self->indexHeader->tableSize * 4);
+	}
+	CBFileUnmap(self->fileHeader, (uint64_t)(self->capacity + 1) * sizeof(CBHeaderStoreRecord));
+	CBFileClose(self->recordFile);
+	CBFileClose(self->indexFile);
+	
+}
+
+//  Functions
+
+bool CBHeaderStoreAppend(CBHeaderStore * self, unsigned char * header, unsigned char * hash, uint32_t flags) {
+	
+	// Check the header follows the last
+	if (self->headerNum && memcmp(header + 4, CBHeaderStoreGetRecord(self, self->headerNum - 1)->hash, 32)) {
+		CBLogError("Attempting to add a header to a CBHeaderStore which does not follow the last header.");
+		return false;
+	}
+	
+	// The work cannot be calculated for targets which cannot be valid. The exponent has the same lower limit as in CBValidateProofOfWork.
+	uint32_t target = CBArrayToInt32(header, 72);
+	if ((target >> 24) < 3 || (target >> 24) > 32 || ! (target & 0x00FFFFFF) || target & 0x00800000) {
+		CBLogError("Attempting to add a header to a CBHeaderStore with a bad target.");
+		return false;
+	}
+	
+	// Extend the file when full
+	if (self->headerNum == self->capacity) {
+		uint64_t oldLength = (uint64_t)(self->capacity + 1) * sizeof(CBHeaderStoreRecord);
+		uint64_t newLength = oldLength + (uint64_t)CB_HEADER_STORE_GROW * sizeof(CBHeaderStoreRecord);
+		CBHeaderStoreFileHeader * map;
+		if (! CBFileSetLength(self->recordFile, newLength)) {
+			CBLogError("Could not extend the header store file.");
+			return false;
+		}
+		CBFileUnmap(self->fileHeader, oldLength);
+		if (! CBFileMap(self->recordFile, 0, newLength, (void **)&map)) {
+			// Try to get the old mapping back.
+			CBLogError("Could not map the extended header store file.");
+			CBFileSetLength(self->recordFile, oldLength);
+			CBFileMap(self->recordFile, 0, oldLength, (void **)&self->fileHeader);
+			self->records = (CBHeaderStoreRecord *)self->fileHeader + 1;
+			return false;
+		}
+		self->fileHeader = map;
+		self->records = (CBHeaderStoreRecord *)map + 1;
+		self->capacity += CB_HEADER_STORE_GROW;
+	}
+	
+	CBHeaderStoreRecord * record = CBHeaderStoreGetRecord(self, self->headerNum);
+	memcpy(record->header, header, 80);
+	if (hash)
+		memcpy(record->hash, hash, 32);
+	else{
+		unsigned char hash2[32];
+		CBSha256(header, 80, hash2);
+		CBSha256(hash2, 32, record->hash);
+	}
+	
+	// Add the work of this header to the work of the last
+	CBBigInt work;
+	CBCalculateBlockWork(&work, target);
+	if (self->headerNum)
+		memcpy(record->work, CBHeaderStoreGetRecord(self, self->headerNum - 1)->work, 32);
+	else
+		memset(record->work, 0, 32);
+	int carry = 0;
+	for (int x = 0; x < 32; x++) {
+		carry += record->work[x] + (x < work.length ? work.data[x] : 0);
+		record->work[x] = carry;
+		carry >>= 8;
+	}
+	free(work.data);
+	
+	record->height = self->headerNum;
+	record->flags = flags;
+	record->reserved = 0;
+	record->checksum = CBHeaderStoreCalculateChecksum(record);
+	
+	self->headerNum++;
+	
+	if (! CBHeaderStoreIndex(self, self->headerNum - 1)) {
+		// The header cannot be found, so it is not added.
+		self->headerNum--;
+		return false;
+	}
+	
+	return true;
+	
+}
+
+int CBHeaderStoreAppendArray(CBHeaderStore * self, CBHeaderArray * array, int start, uint32_t flags) {
+	
+	CBHeaderArrayCalculateHashes(array);
+	
+	for (int x = start; x < array->headerNum; x++)
+		if (! CBHeaderStoreAppend(self, CBHeaderArrayGetHeader(array, x), CBHeaderArrayGetHash(array, x), flags))
+			return x;
+	
+	return array->headerNum;
+	
+}
+
+bool CBHeaderStoreAppendBlock(CBHeaderStore * self, CBBlock * block, uint32_t flags) {
+	
+	return CBHeaderStoreAppend(self, CBByteArrayGetData(CBGetMessage(block)->bytes), block->hashSet ? block->hash : NULL, flags);
+	
+}
+
+uint32_t CBHeaderStoreCalculateChecksum(CBHeaderStoreRecord * record) {
+	
+	unsigned char hash[32];
+	CBSha256((unsigned char *)record, offsetof(CBHeaderStoreRecord, checksum), hash);
+	
+	return CBArrayToInt32(hash, 0);
+	
+}
+
+bool CBHeaderStoreFind(CBHeaderStore * self, unsigned char * hash, uint32_t * height) {
+	
+	if (! self->indexHeader) {
+		// The table could not be made, so search the records, newest first.
+		for (uint32_t x = self->headerNum; x--;)
+			if (! memcmp(CBHeaderStoreGetRecord(self, x)->hash, hash, 32)) {
+				*height = x;
+				return true;
+			}
+		return false;
+	}
+	
+	uint32_t mask = self->indexHeader->tableSize - 1;
+	
+	for (uint32_t slot = CBArrayToInt32(hash, 0) & mask; self->table[slot]; slot = (slot + 1) & mask) {
+		// Slots of removed headers remain, so check the height is in the chain.
+		uint32_t found = self->table[slot] - 1;
+		if (found < self->headerNum && ! memcmp(CBHeaderStoreGetRecord(self, found)->hash, hash, 32)) {
+			*height = found;
+			return true;
+		}
+	}
+	
+	return false;
+	
+}
+
+CBBlock * CBHeaderStoreGetBlock(CBHeaderStore * self, uint32_t height) {
+	
+	CBHeaderStoreRecord * record = CBHeaderStoreGetRecord(self, height);
+	
+	// The header with a zero transaction number and the null byte
+	CBByteArray * bytes = CBNewByteArrayOfSize(82);
+	CBByteArraySetBytes(bytes, 0, record->header, 80);
+	CBByteArraySetInt16(bytes, 80, 0);
+	
+	CBBlock * block = CBNewBlockFromData(bytes);
+	CBReleaseObject(bytes);
+	CBBlockDeserialise(block, false);
+	memcpy(block->hash, record->hash, 32);
+	block->hashSet = true;
+	
+	return block;
+	
+}
+
+CBChainDescriptor * CBHeaderStoreGetChainDescriptor(CBHeaderStore * self) {
+	
+	CBChainDescriptor * chainDesc = CBNewChainDescriptor();
+	if (! self->headerNum)
+		return chainDesc;
+	
+	uint32_t height = self->headerNum - 1;
+	uint32_t step = 1;
+	
+	for (;;) {
+		CBChainDescriptorTakeHash(chainDesc, CBNewByteArrayWithDataCopy(CBHeaderStoreGetRecord(self, height)->hash, 32));
+		if (! height)
+			break;
+		// After the last ten hashes, double the gap each time.
+		if (chainDesc->hashNum >= 10)
+			step *= 2;
+		height = height > step ? height - step : 0;
+	}
+	
+	return chainDesc;
+	
+}
+
+bool CBHeaderStoreIndex(CBHeaderStore * self, uint32_t height) {
+	
+	// Keep the table at most half full, and try to make the table again if it could not be made before.
+	if (! self->indexHeader || (self->indexHeader->usedSlots + 1) * 2 > self->indexHeader->tableSize)
+		return CBHeaderStoreRebuildIndex(self);
+	
+	unsigned char * hash = CBHeaderStoreGetRecord(self, height)->hash;
+	uint32_t mask = self->indexHeader->tableSize - 1;
+	uint32_t slot = CBArrayToInt32(hash, 0) & mask;
+	
+	for (; self->table[slot]; slot = (slot + 1) & mask)
+		if (self->table[slot] == height + 1)
+			// Already in the table
+			return true;
+	
+	self->table[slot] = height + 1;
+	self->indexHeader->usedSlots++;
+	
+	return true;
+	
+}
+
+bool CBHeaderStoreRebuildIndex(CBHeaderStore * self) {
+	
+	// Start with a quarter of the slots used.
+	uint32_t tableSize = CB_HEADER_STORE_MIN_TABLE;
+	while (tableSize < self->headerNum * 4ULL)
+		tableSize *= 2;
+	
+	if (self->indexHeader)
+		CBFileUnmap(self->indexHeader, sizeof(CBHeaderStoreIndexHeader) + (uint64_t)self->indexHeader->tableSize * 4);
+	self->indexHeader = NULL;
+	
+	uint64_t length = sizeof(CBHeaderStoreIndexHeader) + (uint64_t)tableSize * 4;
+	if (! CBFileSetLength(self->indexFile, length)
+		|| ! CBFileMap(self->indexFile, 0, length, (void **)&self->indexHeader)) {
+		CBLogError("Could not make the header store index file.");
+		self->indexHeader = NULL;
+		return false;
+	}
+	
+	self->table = (uint32_t *)(self->indexHeader + 1);
+	memset(self->table, 0, (size_t)tableSize * 4);
+	self->indexHeader->magic = CB_HEADER_STORE_INDEX_MAGIC;
+	self->indexHeader->tableSize = tableSize;
+	self->indexHeader->indexedNum = 0;
+	self->indexHeader->usedSlots = 0;
+	
+	for (uint32_t x = 0; x < self->headerNum; x++)
+		CBHeaderStoreIndex(self, x);
+	
+	return true;
+	
+}
+
+bool CBHeaderStoreRecordIsValid(CBHeaderStore * self, uint32_t height) {
+	
+	CBHeaderStoreRecord * record = CBHeaderStoreGetRecord(self, height);
+	
+	return record->height == height
+		&& record->checksum == CBHeaderStoreCalculateChecksum(record)
+		&& (! height || ! memcmp(record->header + 4, CBHeaderStoreGetRecord(self, height - 1)->hash, 32));
+	
+}
+
+void CBHeaderStoreSetFlags(CBHeaderStore * self, uint32_t height, uint32_t flags) {
+	
+	CBHeaderStoreRecord * record = CBHeaderStoreGetRecord(self, height);
+	record->flags = flags;
+	record->checksum = CBHeaderStoreCalculateChecksum(record);
+	
+}
+
+bool CBHeaderStoreSync(CBHeaderStore * self) {
+	
+	// Write the records before the number of records, and the table before the number indexed.
+	if (! CBFileSyncMap(self->fileHeader, 0, (uint64_t)(self->capacity + 1) * sizeof(CBHeaderStoreRecord))) {
+		CBLogError("Could not sync the header store records.");
+		return false;
+	}
+	self->fileHeader->syncedNum = self->headerNum;
+	if (! CBFileSyncMap(self->fileHeader, 0, sizeof(CBHeaderStoreFileHeader))) {
+		CBLogError("Could not sync the header store file header.");
+		return false;
+	}
+	if (! self->indexHeader && ! CBHeaderStoreRebuildIndex(self))
+		return false;
+	if (! CBFileSyncMap(self->indexHeader, 0, sizeof(CBHeaderStoreIndexHeader) + (uint64_t)self->indexHeader->tableSize * 4)) {
+		CBLogError("Could not sync the header store index.");
+		return false;
+	}
+	self->indexHeader->indexedNum = self->headerNum;
+	if (! CBFileSyncMap(self->indexHeader, 0, sizeof(CBHeaderStoreIndexHeader))) {
+		CBLogError("Could not sync the header store index header.");
+		return false;
+	}
+	
+	return true;
+	
+}
+
+bool CBHeaderStoreTruncate(CBHeaderStore * self, uint32_t headerNum) {
+	
+	if (headerNum >= self->headerNum)
+		return true;
+	
+	// Clear the removed records so that they are not recovered when opening, even if the same headers are added again.
+	uint64_t length = (uint64_t)(self->headerNum - headerNum) * sizeof(CBHeaderStoreRecord);
+	memset(CBHeaderStoreGetRecord(self, headerNum), 0, length);
+	self->headerNum = headerNum;
+	if (! CBFileSyncMap(self->fileHeader, (uint64_t)(headerNum + 1) * sizeof(CBHeaderStoreRecord), length)) {
+		CBLogError("Could not sync the removal of headers from the header store.");
+		return false;
+	}
+	if (self->fileHeader->syncedNum > headerNum) {
+		self->fileHeader->syncedNum = headerNum;
+		if (! CBFileSyncMap(self->fileHeader, 0, sizeof(CBHeaderStoreFileHeader))) {
+			CBLogError("Could not sync the header store file header.");
+			return false;
+		}
+	}
+	
+	return true;
+	
+}
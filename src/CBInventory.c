@@ -15,6 +15,7 @@
 //  SEE HEADER FILE FOR DOCUMENTATION 
 
 #include "CBInventory.h"
+#include "CBCursor.h"
 
 //  Constructors
 
@@ -110,9 +111,15 @@ int CBInventoryDeserialise(CBInventory * self) {
 		return CB_DESERIALISE_ERROR;
 	}
 	
-	CBVarInt itemNum = CBByteArrayReadVarInt(bytes, 0);
-	if (itemNum.val > 50000) {
-		CBLogError("Attempting to deserialise a CBInventory with a var int over 50000.");
+	CBCursor cursor;
+	CBInitCursor(&cursor, bytes);
+	CBVarInt itemNum;
+	if (! CBCursorReadVarInt(&cursor, &itemNum)) {
+		CBLogError("Attempting to deserialise a CBInventory with less bytes than required for the var int.");
+		return CB_DESERIALISE_ERROR;
+	}
+	if (itemNum.val > CB_INVENTORY_MAX_ITEMS) {
+		CBLogError("Attempting to deserialise a CBInventory with a var int over %u.", CB_INVENTORY_MAX_ITEMS);
 		return CB_DESERIALISE_ERROR;
 	}
 	
@@ -120,12 +127,10 @@ int CBInventoryDeserialise(CBInventory * self) {
 	self->itemFront = NULL;
 	
 	// Run through the items and deserialise each one.
-	int cursor = itemNum.size;
-	
 	for (int x = 0; x < itemNum.val; x++) {
 		
 		// Make new CBInventoryItem from the rest of the data.
-		CBByteArray * data = CBByteArraySubReference(bytes, cursor, bytes->length-cursor);
+		CBByteArray * data = CBByteArraySubReference(bytes, cursor.offset, bytes->length - cursor.offset);
 		CBInventoryItem * item = CBNewInventoryItemFromData(data);
 		
 		// Deserialise
@@ -142,11 +147,11 @@ int CBInventoryDeserialise(CBInventory * self) {
 		// Adjust length
 		data->length = len;
 		CBReleaseObject(data);
-		cursor += len;
+		CBCursorSkip(&cursor, len);
 		
 	}
 	
-	return cursor;
+	return cursor.offset;
 }
 
 void CBInventoryPrepareBytes(CBInventory * self) {
@@ -235,7 +240,7 @@ int CBInventorySerialise(CBInventory * self, bool force) {
 
 bool CBInventoryTakeInventoryItem(CBInventory * self, CBInventoryItem * item) {
 	
-	if (self->itemNum == 50000)
+	if (self->itemNum == CB_INVENTORY_MAX_ITEMS)
 		return false;
 	
 	if (self->itemFront == NULL)
@@ -15,6 +15,7 @@
 //  SEE HEADER FILE FOR DOCUMENTATION 
 
 #include "CBInventoryItem.h"
+#include "CBCursor.h"
 
 //  Constructors
 
@@ -70,7 +71,9 @@ int CBInventoryItemDeserialise(CBInventoryItem * self){
 		CBLogError("Attempting to deserialise a CBInventoryItem with less than 36 bytes.");
 		return CB_DESERIALISE_ERROR;
 	}
-	self->type = CBByteArrayReadInt32(bytes, 0);
+	CBCursor cursor;
+	CBInitCursor(&cursor, bytes);
+	self->type = CBCursorReadInt32(&cursor);
 	self->hash = CBByteArraySubReference(bytes, 4, 32);
 	return 36;
 }
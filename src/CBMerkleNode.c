@@ -66,6 +66,20 @@ void CBFreeMerkleTree(CBMerkleNode * root){
 		free(node);
 	}
 }
+int CBMerkleTreeGetLeftBranch(CBMerkleNode * root, unsigned char * branch){
+	// A tree built from a single hash has the hash duplicated under the root, but the real root is the hash itself.
+	if (root->left == NULL || (root->left == root->right && root->left->left == NULL))
+		return 0;
+	// Get the depth of the tree
+	int depth = 0;
+	for (CBMerkleNode * node = root; node->left != NULL; node = node->left)
+		depth++;
+	// Take the right sibling on each level from the top down, placing them from the bottom up.
+	int x = depth;
+	for (CBMerkleNode * node = root; node->left != NULL; node = node->left)
+		memcpy(branch + --x * 32, node->right->hash, 32);
+	return depth;
+}
 CBMerkleNode * CBMerkleTreeGetLevel(CBMerkleNode * root, int level){
 	for (int x = 0; x < level; x++) {
 		if (root->left == NULL)
@@ -74,3 +88,14 @@ CBMerkleNode * CBMerkleTreeGetLevel(CBMerkleNode * root, int level){
 	}
 	return root;
 }
+void CBMerkleRootFromLeftBranch(unsigned char * hash, unsigned char * branch, int branchNum, unsigned char * root){
+	unsigned char cat[64];
+	memcpy(cat, hash, 32);
+	for (int x = 0; x < branchNum; x++) {
+		memcpy(cat + 32, branch + x * 32, 32);
+		// Double SHA256
+		CBSha256(cat, 64, root);
+		CBSha256(root, 32, cat);
+	}
+	memcpy(root, cat, 32);
+}
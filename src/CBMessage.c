@@ -22,12 +22,25 @@ CBMessage * CBNewMessageByObject() {
 	
 	CBMessage * self = malloc(sizeof(*self));
 	CBGetObject(self)->free = CBFreeMessage;
+	// Received messages are reallocated into other types, some of which are freed with CBFreeObjectMemory.
+	CBGetObject(self)->allocation = CB_ALLOCATION_MALLOC;
 	CBInitMessageByObject(self);
 	
 	return self;
 	
 }
 
+CBMessage * CBNewMessageByFile(CBMessageType type, CBDepObject file, uint64_t offset, uint32_t length, unsigned char * checksum) {
+	
+	CBMessage * self = malloc(sizeof(*self));
+	CBGetObject(self)->free = CBFreeMessage;
+	CBGetObject(self)->allocation = CB_ALLOCATION_MALLOC;
+	CBInitMessageByFile(self, type, file, offset, length, checksum);
+	
+	return self;
+	
+}
+
 //  Initialiser
 
 void CBInitMessageByObject(CBMessage * self) {
@@ -35,6 +48,7 @@ void CBInitMessageByObject(CBMessage * self) {
 	CBInitObject(CBGetObject(self), true);
 	self->bytes = NULL;
 	self->serialised = false;
+	self->fileBody = false;
 	
 }
 
@@ -44,6 +58,23 @@ void CBInitMessageByData(CBMessage * self, CBByteArray * data) {
 	self->bytes = data;
 	CBRetainObject(data); // Retain data for this object.
 	self->serialised = true;
+	self->fileBody = false;
+	
+}
+
+void CBInitMessageByFile(CBMessage * self, CBMessageType type, CBDepObject file, uint64_t offset, uint32_t length, unsigned char * checksum) {
+	
+	CBInitObject(CBGetObject(self), true);
+	self->type = type;
+	self->bytes = NULL;
+	// There is nothing to serialise
+	self->serialised = true;
+	self->fileBody = true;
+	self->file = file;
+	self->closeFile = false;
+	self->fileOffset = offset;
+	self->fileLength = length;
+	memcpy(self->checksum, checksum, 4);
 	
 }
 
@@ -53,6 +84,7 @@ void CBDestroyMessage(void * vself) {
 	
 	CBMessage * self = vself;
 	if (self->bytes) CBReleaseObject(self->bytes);
+	if (self->fileBody && self->closeFile) CBFileClose(self->file);
 	
 }
 
@@ -15,6 +15,7 @@
 //  SEE HEADER FILE FOR DOCUMENTATION 
 
 #include "CBNetworkAddress.h"
+#include "CBCursor.h"
 
 //  Constructor
 
@@ -49,6 +50,7 @@ void CBInitNetworkAddress(CBNetworkAddress * self, long long int lastSeen, CBSoc
 	}
 	self->services = services;
 	self->bucketSet = false;
+	CBNetworkAddressInitConnectStats(self);
 	CBInitMessageByObject(CBGetMessage(self));
 }
 
@@ -57,6 +59,7 @@ void CBInitNetworkAddressFromData(CBNetworkAddress * self, CBByteArray * data, b
 	self->sockAddr.ip = NULL;
 	self->bucketSet = false;
 	self->isPublic = isPublic;
+	CBNetworkAddressInitConnectStats(self);
 
 	CBInitMessageByData(CBGetMessage(self), data);
 
@@ -76,6 +79,11 @@ void CBFreeNetworkAddress(void * self){
 
 //  Functions
 
+int CBNetworkAddressCompareConnectScore(const void * addr1, const void * addr2){
+	int64_t score1 = CBNetworkAddressGetConnectScore(*(CBNetworkAddress **)addr1);
+	int64_t score2 = CBNetworkAddressGetConnectScore(*(CBNetworkAddress **)addr2);
+	return (score1 > score2) - (score1 < score2);
+}
 int CBNetworkAddressDeserialise(CBNetworkAddress * self, bool timestamp){
 
 	CBByteArray * bytes = CBGetMessage(self)->bytes;
@@ -90,28 +98,27 @@ int CBNetworkAddressDeserialise(CBNetworkAddress * self, bool timestamp){
 		return CB_DESERIALISE_ERROR;
 	}
 
-	int start;
+	CBCursor cursor;
+	CBInitCursor(&cursor, bytes);
 	unsigned long long int twoHoursAgo = time(NULL) - 3600;
 
 	if (timestamp) {
 		// Make sure we do not set self->lastSeen later than one hour ago.
-		self->lastSeen = CBByteArrayReadInt32(bytes, 0);
+		self->lastSeen = CBCursorReadInt32(&cursor);
 		if (self->lastSeen > twoHoursAgo)
 			self->lastSeen = twoHoursAgo;
-		start = 4;
-	}else{
+	}else
 		self->lastSeen = twoHoursAgo;
-		start = 0;
-	}
 
-	self->services = (CBVersionServices) CBByteArrayReadInt64(bytes, start);
-	self->sockAddr.ip = CBNewByteArraySubReference(bytes, start + 8, 16);
+	self->services = (CBVersionServices) CBCursorReadInt64(&cursor);
+	self->sockAddr.ip = CBNewByteArraySubReference(bytes, cursor.offset, 16);
+	CBCursorSkip(&cursor, 16);
 
 	// Determine IP type
 	self->type = CBGetIPType(CBByteArrayGetData(self->sockAddr.ip));
-	self->sockAddr.port = CBByteArrayReadPort(bytes, start + 24);
+	self->sockAddr.port = CBCursorReadPort(&cursor);
 
-	return start + 26;
+	return cursor.offset;
 
 }
 bool CBNetworkAddressEquals(CBNetworkAddress * self, CBNetworkAddress * addr){
@@ -184,6 +191,32 @@ long long int CBNetworkAddressGetGroup(CBNetworkAddress * addr){
 
 }
 
+int64_t CBNetworkAddressGetConnectScore(CBNetworkAddress * self){
+	int64_t latency = self->connectLatency ? self->connectLatency : CB_NETWORK_ADDRESS_DEFAULT_LATENCY;
+	return latency * (self->connectAttempts + 2) / (self->connectSuccesses + 1);
+}
+void CBNetworkAddressInitConnectStats(CBNetworkAddress * self){
+	self->connectLatency = 0;
+	self->connectAttempts = 0;
+	self->connectSuccesses = 0;
+	self->lastConnectAttempt = 0;
+}
+void CBNetworkAddressRecordConnect(CBNetworkAddress * self, bool success){
+	if (self->connectAttempts == UINT16_MAX) {
+		// Halve the counts, which keeps the success rate.
+		self->connectAttempts /= 2;
+		self->connectSuccesses /= 2;
+	}
+	self->connectAttempts++;
+	if (success)
+		self->connectSuccesses++;
+}
+void CBNetworkAddressRecordConnectLatency(CBNetworkAddress * self, int latency){
+	if (latency < 1)
+		latency = 1;
+	// Recent connections are given more weight.
+	self->connectLatency = self->connectLatency ? (self->connectLatency * 3 + latency) / 4 : latency;
+}
 int CBNetworkAddressSerialise(CBNetworkAddress * self, bool timestamp){
 	CBByteArray * bytes = CBGetMessage(self)->bytes;
 	if (! bytes) {
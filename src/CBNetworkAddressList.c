@@ -15,6 +15,7 @@
 //  SEE HEADER FILE FOR DOCUMENTATION 
 
 #include "CBNetworkAddressList.h"
+#include "CBCursor.h"
 
 //  Constructors
 
@@ -111,7 +112,13 @@ int CBNetworkAddressListDeserialise(CBNetworkAddressList * self) {
 		return CB_DESERIALISE_ERROR;
 	}
 	
-	CBVarInt num = CBByteArrayReadVarInt(bytes, 0);
+	CBCursor cursor;
+	CBInitCursor(&cursor, bytes);
+	CBVarInt num;
+	if (! CBCursorReadVarInt(&cursor, &num)) {
+		CBLogError("Attempting to deserialise a CBNetworkAddressList with less bytes than required for the var int.");
+		return CB_DESERIALISE_ERROR;
+	}
 	if (num.val > 1000) {
 		CBLogError("Attempting to deserialise a CBNetworkAddressList with a var int over 1000.");
 		return CB_DESERIALISE_ERROR;
@@ -120,13 +127,11 @@ int CBNetworkAddressListDeserialise(CBNetworkAddressList * self) {
 	self->addresses = malloc(sizeof(*self->addresses) * (size_t)num.val);
 	self->addrNum = (int)num.val;
 	
-	int cursor = num.size;
-	
 	for (int x = 0; x < num.val; x++) {
 		
 		// Make new CBNetworkAddress from the rest of the data.
 		int len;
-		CBByteArray * data = CBByteArraySubReference(bytes, cursor, bytes->length-cursor);
+		CBByteArray * data = CBByteArraySubReference(bytes, cursor.offset, bytes->length - cursor.offset);
 		
 		// Create a new network address object. It is public since it is in an address broadcast.
 		self->addresses[x] = CBNewNetworkAddressFromData(data, true);
@@ -147,11 +152,11 @@ int CBNetworkAddressListDeserialise(CBNetworkAddressList * self) {
 		// Adjust length
 		data->length = len;
 		CBReleaseObject(data);
-		cursor += len;
+		CBCursorSkip(&cursor, len);
 		
 	}
 	
-	return cursor;
+	return cursor.offset;
 	
 }
 
@@ -16,6 +16,7 @@
 
 #include "CBNetworkCommunicator.h"
 #include "CBSeedNodes.h"
+#include "CBCursor.h"
 
 //  Constructor
 
@@ -57,6 +58,18 @@ bool CBInitNetworkCommunicator(CBNetworkCommunicator * self, CBVersionServices s
 	self->altMaxSizes = NULL;
 	self->addedHardcodedSeeds = false;
 	self->tryConnectionTimerStarted = false;
+	self->timeOutTimerStarted = false;
+	self->dnsLookups = 0;
+	self->connectingNum = 0;
+	self->raceTimerStarted = false;
+	self->connectivityStart = 0;
+	self->announcedItems = 0;
+	self->announceDuplicates = 0;
+	self->announceBatches = 0;
+	self->announceBatchMax = 0;
+	self->announceLatency = 0;
+	self->announceLatencyMax = 0;
+	CBInitTimerWheel(&self->timeOuts, CB_NETWORK_COMMUNICATOR_TIMEOUT_TICK, CBGetMilliseconds(), CBNetworkCommunicatorOnPeerTimeOut, self);
 	// Default settings
 	self->maxAddresses = 1000000;
 	self->maxConnections = 8;
@@ -67,6 +80,10 @@ bool CBInitNetworkCommunicator(CBNetworkCommunicator * self, CBVersionServices s
 	self->timeOut = 5400000;
 	self->heartBeat = 1800000;
 	self->connectionTimeOut = 5000;
+	self->raceConnections = 2;
+	self->trickleInterval = CB_NETWORK_COMMUNICATOR_TRICKLE_INTERVAL;
+	self->knownInventoryItems = CB_NETWORK_COMMUNICATOR_KNOWN_INVENTORY;
+	self->knownInventoryFalsePositiveRate = CB_NETWORK_COMMUNICATOR_KNOWN_INVENTORY_FALSE_POSITIVE_RATE;
 	self->flags = 0;
 	self->services = services;
 	self->blockHeight = 0;
@@ -106,6 +123,53 @@ void CBFreeNetworkCommunicator(void * self){
 
 //  Functions
 
+bool CBNetworkCommunicatorAnnounce(CBNetworkCommunicator * self, CBPeer * peer, CBInventoryItemType type, CBByteArray * hash){
+	if (! peer->connectionWorking)
+		return false;
+	if (CBPeerKnowsInventory(peer, hash)) {
+		self->announceDuplicates++;
+		return false;
+	}
+	// Serialising the item changes the hash to refer to the message, so the hash is copied to leave the given hash alone.
+	CBByteArray * hashCopy = CBByteArrayCopy(hash);
+	CBInventoryItem * item = CBNewInventoryItem(type, hashCopy);
+	CBReleaseObject(hashCopy);
+	if (type == CB_INVENTORY_ITEM_BLOCK) {
+		// Blocks are announced straight away.
+		CBInventory * inv = CBNewInventory();
+		CBGetMessage(inv)->type = CB_MESSAGE_TYPE_INV;
+		CBInventoryTakeInventoryItem(inv, item);
+		bool ok = CBNetworkCommunicatorSendMessage(self, peer, CBGetMessage(inv), NULL);
+		CBReleaseObject(inv);
+		if (! ok)
+			return false;
+	}else{
+		if (! peer->announcements) {
+			// First announcement of a batch.
+			peer->announcements = CBNewInventory();
+			CBGetMessage(peer->announcements)->type = CB_MESSAGE_TYPE_INV;
+			peer->announcementsTime = CBGetMilliseconds();
+			CBNetworkCommunicatorSetTrickleTimer(self, peer);
+		}
+		if (! CBInventoryTakeInventoryItem(peer->announcements, item)) {
+			// The batch is full and could not be sent.
+			CBReleaseObject(item);
+			return false;
+		}
+		if (peer->announcements->itemNum == CB_INVENTORY_MAX_ITEMS)
+			CBNetworkCommunicatorFlushAnnouncements(self, peer);
+	}
+	CBPeerAddKnownInventory(peer, hash);
+	self->announcedItems++;
+	return true;
+}
+int CBNetworkCommunicatorAnnounceToAll(CBNetworkCommunicator * self, CBInventoryItemType type, CBByteArray * hash, CBPeer * except){
+	int num = 0;
+	CBAssociativeArrayForEach(CBPeer * peer, &self->addresses->peers)
+		if (peer != except && CBNetworkCommunicatorAnnounce(self, peer, type, hash))
+			num++;
+	return num;
+}
 void CBNetworkCommunicatorAcceptConnection(void * vself, CBDepObject socket){
 	CBNetworkCommunicator * self = vself;
 	CBDepObject connectSocketID;
@@ -123,10 +187,11 @@ void CBNetworkCommunicatorAcceptConnection(void * vself, CBDepObject socket){
 	// Set up receive event
 	if (CBSocketCanReceiveEvent(&peer->receiveEvent, self->eventLoop, peer->socketID, CBNetworkCommunicatorOnCanReceive, peer)) {
 		// The event works
-		if (CBSocketAddEvent(peer->receiveEvent, self->responseTimeOut)){ // Begin receive event.
+		if (CBSocketAddEvent(peer->receiveEvent, 0)){ // Begin receive event. The timeout is kept in the timing wheel.
 			// Success
 			if (CBSocketCanSendEvent(&peer->sendEvent, self->eventLoop, peer->socketID, CBNetworkCommunicatorOnCanSend, peer)) {
 				// Both events work. Take the peer.
+				CBNetworkCommunicatorSetReceiveTimeOut(self, peer, self->responseTimeOut);
 				CBMutexLock(self->peersMutex);
 				CBNetworkAddressManagerTakePeer(self->addresses, peer);
 				CBMutexUnlock(self->peersMutex);
@@ -134,9 +199,10 @@ void CBNetworkCommunicatorAcceptConnection(void * vself, CBDepObject socket){
 					// Got first peer, start pings
 					CBNetworkCommunicatorStartPings(self);
 				peer->connectionWorking = true;
+				CBNetworkCommunicatorNewKnownInventory(self, peer);
 				self->attemptingOrWorkingConnections++;
 				self->numIncommingConnections++;
-				if (self->numIncommingConnections == self->maxIncommingConnections || self->attemptingOrWorkingConnections == self->maxConnections) {
+				if (self->numIncommingConnections == self->maxIncommingConnections || self->attemptingOrWorkingConnections >= self->maxConnections) {
 					// Reached maximum connections, stop listening.
 					CBNetworkCommunicatorStopListening(self);
 					self->stoppedListening = true;
@@ -155,9 +221,30 @@ void CBNetworkCommunicatorAcceptConnection(void * vself, CBDepObject socket){
 	CBReleaseObject(peer);
 	CBLogError("Failure setting up events for incoming peer.");
 }
+void CBNetworkCommunicatorCancelConnect(CBNetworkCommunicator * self, CBPeer * peer){
+	CBNetworkCommunicatorRemoveConnecting(self, peer);
+	CBSocketFreeEvent(peer->connectEvent);
+	CBCloseSocket(peer->socketID);
+	peer->connecting = false;
+	peer->disconnected = true;
+	self->attemptingOrWorkingConnections--;
+	// The attempt took at least this long. It did not fail, so the address is returned as it was.
+	int elapsed = (int)(CBGetMilliseconds() - peer->connectStart);
+	if (elapsed > peer->addr->connectLatency)
+		peer->addr->connectLatency = elapsed;
+	CBNetworkAddressManagerAddAddress(self->addresses, peer->addr);
+	CBLogVerbose("Cancelled the connection attempt to %s", peer->peerStr);
+	CBReleaseObject(peer);
+}
+void CBNetworkCommunicatorCheckTimeOuts(void * vself){
+	CBNetworkCommunicator * self = vself;
+	CBTimerWheelAdvance(&self->timeOuts, CBGetMilliseconds());
+}
 CBConnectReturn CBNetworkCommunicatorConnect(CBNetworkCommunicator * self, CBPeer * peer){
 	if (! CBNetworkCommunicatorIsReachable(self, peer->addr->type))
 		return CB_CONNECT_NO_SUPPORT;
+	if (self->connectingNum == CB_NETWORK_COMMUNICATOR_MAX_CONNECTING)
+		return CB_CONNECT_ERROR;
 	bool isIPv6 = peer->addr->type & CB_IP_IP6
 				  || peer->addr->type & CB_IP_TOR
 				  || peer->addr->type & CB_IP_I2P;
@@ -180,6 +267,14 @@ CBConnectReturn CBNetworkCommunicatorConnect(CBNetworkCommunicator * self, CBPee
 			if (CBSocketAddEvent(peer->connectEvent, self->connectionTimeOut)) {
 				self->attemptingOrWorkingConnections++;
 				peer->connecting = true; // In the process of connecting.
+				peer->connectStart = peer->addr->lastConnectAttempt = CBGetMilliseconds();
+				peer->raced = false;
+				self->connecting[self->connectingNum++] = peer;
+				if (! self->raceTimerStarted) {
+					// Check for slow attempts to race.
+					self->raceTimerStarted = true;
+					CBStartTimer(self->eventLoop, &self->raceTimer, CB_NETWORK_COMMUNICATOR_RACE_DELAY / 2, CBNetworkCommunicatorRaceConnections, self);
+				}
 				return CB_CONNECT_OK;
 			}else
 				CBSocketFreeEvent(peer->connectEvent);
@@ -190,6 +285,59 @@ CBConnectReturn CBNetworkCommunicatorConnect(CBNetworkCommunicator * self, CBPee
 	CBCloseSocket(peer->socketID);
 	return CB_CONNECT_FAILED;
 }
+int CBNetworkCommunicatorConnectCandidates(CBNetworkCommunicator * self, int num){
+	if (num > CB_NETWORK_COMMUNICATOR_MAX_CONNECTING - self->connectingNum)
+		num = CB_NETWORK_COMMUNICATOR_MAX_CONNECTING - self->connectingNum;
+	// Take more addresses than needed and connect to those which have connected quickly and reliably before.
+	int candidateNum = num * CB_NETWORK_COMMUNICATOR_CANDIDATES;
+	if (candidateNum > self->addresses->addrNum)
+		candidateNum = self->addresses->addrNum; // Cannot connect to any more than the address we have
+	if (num <= 0 || candidateNum <= 0)
+		return 0;
+	CBNetworkAddress ** addrs = malloc(sizeof(*addrs) * candidateNum);
+	candidateNum = CBNetworkAddressManagerGetAddresses(self->addresses, candidateNum, addrs);
+	qsort(addrs, candidateNum, sizeof(*addrs), CBNetworkAddressCompareConnectScore);
+	long long int now = CBGetMilliseconds();
+	int started = 0;
+	for (int x = 0; x < candidateNum; x++) {
+		if (started == num
+			|| (addrs[x]->lastConnectAttempt && now - addrs[x]->lastConnectAttempt < CB_NETWORK_COMMUNICATOR_RETRY_INTERVAL)) {
+			// Not needed or tried recently.
+			CBReleaseObject(addrs[x]);
+			continue;
+		}
+		// Remove the address from the address manager
+		CBNetworkAddressManagerRemoveAddress(self->addresses, addrs[x]);
+		// We haven't got the address as a peer.
+		// Convert network address into peer
+		CBPeer * peer = CBNewPeer(addrs[x]);
+		CBReleaseObject(addrs[x]);
+		char addrStr[CB_NETWORK_ADDR_STR_SIZE];
+		CBNetworkAddressToString(peer->addr, addrStr);
+		strcpy(peer->peerStr, addrStr);
+		peer->incomming = false;
+		CBConnectReturn res = CBNetworkCommunicatorConnect(self, peer);
+		if (res == CB_CONNECT_ERROR || res == CB_CONNECT_FAILED) {
+			// Add address back to manager
+			if (res == CB_CONNECT_FAILED) {
+				// Add penalty if failed
+				peer->addr->lastSeen -= 3600;
+				CBNetworkAddressRecordConnect(peer->addr, false);
+			}
+			// Re-insert into the address manager, since we could not connect this time. If it fails, ignore and the address will not be added.
+			CBNetworkAddressManagerAddAddress(self->addresses, peer->addr);
+			CBReleaseObject(peer);
+			CBLogWarning("Unable to connect to the address: %s", addrStr);
+		}else if (res == CB_CONNECT_OK) {
+			started++;
+			CBLogVerbose("Made a connection to peer %s", addrStr);
+		}
+		// Either the connection was OK and it should either timeout or finalise, or we forget about it because it is not supported.
+	}
+	// Free address pointer memory.
+	free(addrs);
+	return started;
+}
 void CBNetworkCommunicatorDetermineIP(CBNetworkCommunicator * self, CBNetworkAddress * addr, bool ipv4){
 	int * count = ipv4 ? self->ip4Count : self->ip6Count;
 	CBNetworkAddress ** ips = ipv4 ? self->ip4s : self->ip6s;
@@ -230,13 +378,15 @@ void CBNetworkCommunicatorDidConnect(void * vself, void * vpeer){
 	CBPeer * peer = vpeer;
 	peer->connecting = false; // No longer in the process of connecting.
 	CBSocketFreeEvent(peer->connectEvent); // No longer need this event.
+	CBNetworkCommunicatorRemoveConnecting(self, peer);
 	// Check to see if in the meantime, that we have not been connected to by the peer. Double connections are bad m'kay.
 	if (! CBNetworkAddressManagerGotPeer(self->addresses, peer->addr)){
 		// Make receive event
 		if (CBSocketCanReceiveEvent(&peer->receiveEvent, self->eventLoop, peer->socketID, CBNetworkCommunicatorOnCanReceive, peer)) {
 			// Make send event
 			if (CBSocketCanSendEvent(&peer->sendEvent, self->eventLoop, peer->socketID, CBNetworkCommunicatorOnCanSend, peer)) {
-				if (CBSocketAddEvent(peer->sendEvent, self->sendTimeOut)) {
+				if (CBSocketAddEvent(peer->sendEvent, 0)) {
+					CBNetworkCommunicatorSetTimeOut(self, &peer->sendTimer, self->sendTimeOut);
 					CBMutexLock(self->peersMutex);
 					CBNetworkAddressManagerTakePeer(self->addresses, peer);
 					CBMutexUnlock(self->peersMutex);
@@ -244,6 +394,16 @@ void CBNetworkCommunicatorDidConnect(void * vself, void * vpeer){
 						// Got first peer, start pings
 						CBNetworkCommunicatorStartPings(self);
 					peer->connectionWorking = true;
+					CBNetworkCommunicatorNewKnownInventory(self, peer);
+					CBNetworkAddressRecordConnect(peer->addr, true);
+					CBNetworkAddressRecordConnectLatency(peer->addr, (int)(CBGetMilliseconds() - peer->connectStart));
+					// With enough connections, cancel the slowest attempts which were raced against others.
+					while (self->attemptingOrWorkingConnections > self->maxConnections && self->connectingNum)
+						CBNetworkCommunicatorCancelConnect(self, self->connecting[0]);
+					if (self->connectivityStart && self->addresses->peersNum >= self->maxConnections) {
+						CBLogVerbose("Reached %i connections in %lli ms", self->addresses->peersNum, CBGetMilliseconds() - self->connectivityStart);
+						self->connectivityStart = 0;
+					}
 					// Connection OK, so begin handshake if auto handshaking is enabled.
 					if (self->flags & CB_NETWORK_COMMUNICATOR_AUTO_HANDSHAKE){
 						CBVersion * version = CBNetworkCommunicatorGetVersion(self, peer->addr);
@@ -285,6 +445,7 @@ void CBNetworkCommunicatorDisconnect(CBNetworkCommunicator * self, CBPeer * peer
 	peer->disconnected = true;
 	CBLogVerbose("Disconnecting from %s", peer->peerStr);
 	bool wasWorking = peer->connectionWorking;
+	bool wasConnecting = peer->connecting;
 	peer->connectionWorking = false;
 	// Close the socket
 	CBCloseSocket(peer->socketID);
@@ -301,12 +462,18 @@ void CBNetworkCommunicatorDisconnect(CBNetworkCommunicator * self, CBPeer * peer
 		// Release data created when connection was working
 		CBSocketFreeEvent(peer->receiveEvent);
 		CBSocketFreeEvent(peer->sendEvent);
+		CBTimerWheelRemove(&peer->receiveTimer);
+		CBTimerWheelRemove(&peer->sendTimer);
+		CBTimerWheelRemove(&peer->trickleTimer);
+		// Release the announcements which were waiting.
+		if (peer->announcements) {
+			CBReleaseObject(peer->announcements);
+			peer->announcements = NULL;
+		}
 		// Release the receiving message object if it exists.
 		if (peer->receive) CBReleaseObject(peer->receive);
 		// Release all messages in the send queue
-		// Ensure the send queue is not being modified by mutex
-		for (int x = 0; x < peer->sendQueueSize; x++)
-			CBReleaseObject(peer->sendQueue[(peer->sendQueueFront + x) % CB_SEND_QUEUE_MAX_SIZE].message);
+		CBPeerClearSendQueue(peer);
 		if (peer->addr->isPublic) {
 			// Public peer, return to addresses list.
 			// Apply the penalty given
@@ -325,14 +492,31 @@ void CBNetworkCommunicatorDisconnect(CBNetworkCommunicator * self, CBPeer * peer
 	}else{
 		// Else we release the object from control of the CBNetworkCommunicator
 		// Free connectEvent only if we are connecting to it.
-		if (peer->connecting)
+		if (wasConnecting) {
 			CBSocketFreeEvent(peer->connectEvent);
+			CBNetworkCommunicatorRemoveConnecting(self, peer);
+			CBNetworkAddressRecordConnect(peer->addr, false);
+			if (peer->addr->isPublic && ! stopping) {
+				// Keep the address with its connection statistics, so it is tried after others.
+				peer->addr->penalty += penalty;
+				CBNetworkAddressManagerAddAddress(self->addresses, peer->addr);
+			}
+		}
 		CBReleaseObject(peer);
 	}
-	if (self->addresses->peersNum == 0 && self->flags & CB_NETWORK_COMMUNICATOR_AUTO_PING)
-		// No more peers so stop pings
-		CBNetworkCommunicatorStopPings(self);
+	if (self->addresses->peersNum == 0) {
+		if (self->flags & CB_NETWORK_COMMUNICATOR_AUTO_PING)
+			// No more peers so stop pings
+			CBNetworkCommunicatorStopPings(self);
+		// No more timeouts until there is another peer.
+		CBNetworkCommunicatorStopTimeOuts(self);
+	}
 	if (! stopping) {
+		if (wasConnecting
+			&& self->attemptingOrWorkingConnections < self->maxConnections
+			&& ! (self->flags & CB_NETWORK_COMMUNICATOR_INCOMING_ONLY))
+			// Replace the failed attempt straight away.
+			CBNetworkCommunicatorConnectCandidates(self, 1);
 		if (self->attemptingOrWorkingConnections != 0)
 			// Try for more connections in 20 seconds.
 			CBNetworkCommunicatorRetryConnections(self);
@@ -341,6 +525,28 @@ void CBNetworkCommunicatorDisconnect(CBNetworkCommunicator * self, CBPeer * peer
 			CBNetworkCommunicatorNoPeers(self);
 	}
 }
+bool CBNetworkCommunicatorFlushAnnouncements(CBNetworkCommunicator * self, CBPeer * peer){
+	CBInventory * inv = peer->announcements;
+	if (! inv)
+		return true;
+	CBTimerWheelRemove(&peer->trickleTimer);
+	if (! CBNetworkCommunicatorSendMessage(self, peer, CBGetMessage(inv), NULL)) {
+		// Try again later, such as when the send queue has room.
+		CBLogVerbose("Could not send %i announcements to %s.", inv->itemNum, peer->peerStr);
+		CBNetworkCommunicatorSetTrickleTimer(self, peer);
+		return false;
+	}
+	int latency = (int)(CBGetMilliseconds() - peer->announcementsTime);
+	self->announceLatency = self->announceBatches ? (3 * self->announceLatency + latency) / 4 : latency;
+	if (latency > self->announceLatencyMax)
+		self->announceLatencyMax = latency;
+	if (inv->itemNum > self->announceBatchMax)
+		self->announceBatchMax = inv->itemNum;
+	self->announceBatches++;
+	peer->announcements = NULL;
+	CBReleaseObject(inv);
+	return true;
+}
 CBNetworkAddress * CBNetworkCommunicatorGetOurMainAddress(CBNetworkCommunicator * self, CBIPType recipientType){
 	// I2P or Tor used if available
 	if (self->ipData[CB_TOR_NETWORK].isSet)
@@ -352,6 +558,27 @@ CBNetworkAddress * CBNetworkCommunicatorGetOurMainAddress(CBNetworkCommunicator
 		return self->ipData[CB_IP6_NETWORK].ourAddress;
 	return self->ipData[CB_IP4_NETWORK].ourAddress;
 }
+CBSendPriority CBNetworkCommunicatorGetSendPriority(CBMessageType type){
+	switch (type) {
+		case CB_MESSAGE_TYPE_VERSION:
+		case CB_MESSAGE_TYPE_VERACK:
+		case CB_MESSAGE_TYPE_PING:
+		case CB_MESSAGE_TYPE_PONG:
+		case CB_MESSAGE_TYPE_ALERT:
+			return CB_SEND_PRIORITY_CONTROL;
+		case CB_MESSAGE_TYPE_BLOCK:
+		case CB_MESSAGE_TYPE_HEADERS:
+		case CB_MESSAGE_TYPE_GETBLOCKS:
+		case CB_MESSAGE_TYPE_GETHEADERS:
+		case CB_MESSAGE_TYPE_GETDATA:
+			return CB_SEND_PRIORITY_BLOCK;
+		case CB_MESSAGE_TYPE_ADDR:
+		case CB_MESSAGE_TYPE_GETADDR:
+			return CB_SEND_PRIORITY_ADDR;
+		default:
+			return CB_SEND_PRIORITY_TX;
+	}
+}
 CBVersion * CBNetworkCommunicatorGetVersion(CBNetworkCommunicator * self, CBNetworkAddress * addRecv){
 	CBNetworkAddress * sourceAddr = CBNetworkCommunicatorGetOurMainAddress(self, addRecv->type);
 	self->nonce = rand();
@@ -371,7 +598,17 @@ bool CBNetworkCommunicatorIsReachable(CBNetworkCommunicator * self, CBIPType typ
 		return false;
 	return self->reachability & type;
 }
+void CBNetworkCommunicatorNewKnownInventory(CBNetworkCommunicator * self, CBPeer * peer){
+	if (peer->knownInventory)
+		return;
+	peer->knownInventory = CBNewRollingBloomFilter(self->knownInventoryItems, self->knownInventoryFalsePositiveRate, CBSecureRandomInteger(self->addresses->rndGen));
+	if (! peer->knownInventory)
+		CBLogError("Could not create the filter of known inventory for %s.", peer->peerStr);
+}
 void CBNetworkCommunicatorNoPeers(CBNetworkCommunicator * self){
+	if (self->dnsLookups)
+		// CBNetworkCommunicatorOnDNSLoaded tries again when the seeds have been resolved.
+		return;
 	// Give error
 	self->callbacks.onNetworkError(self, CB_ERROR_NO_PEERS);
 	if (!(self->flags & CB_NETWORK_COMMUNICATOR_BOOTSTRAP)
@@ -396,6 +633,13 @@ void CBNetworkCommunicatorNoPeers(CBNetworkCommunicator * self){
 void CBNetworkCommunicatorOnCanReceive(void * vself, void * vpeer){
 	CBNetworkCommunicator * self = vself;
 	CBPeer * peer = vpeer;
+	// Restart the receive timeout, as libevent does for events with timeouts.
+	CBNetworkCommunicatorSetTimeOut(self, &peer->receiveTimer, peer->receiveTimeOut);
+	if (self->flags & CB_NETWORK_COMMUNICATOR_BATCH_RECEIVE && ! peer->receivedHeader) {
+		// Read messages through the receive buffer. Large payloads are continued below.
+		CBNetworkCommunicatorOnCanReceiveBatch(self, peer);
+		return;
+	}
 	// Node kindly has some data available in the socket buffer.
 	if (! peer->receive) {
 		// New message to be received.
@@ -404,11 +648,7 @@ void CBNetworkCommunicatorOnCanReceive(void * vself, void * vpeer){
 		peer->headerBuffer = malloc(24); // Twenty-four bytes for the message header.
 		peer->messageReceived = 0; // So far received nothing.
 		// From now on use timeout for receiving data.
-		if (! CBSocketAddEvent(peer->receiveEvent, self->recvTimeOut)){
-			CBLogError("Could not change the timeout for a peer's receive event for receiving a new message");
-			CBNetworkCommunicatorDisconnect(self, peer, 0, false);
-			return;
-		}
+		CBNetworkCommunicatorSetReceiveTimeOut(self, peer, self->recvTimeOut);
 		// Start download timer
 		peer->downloadTimerStart = CBGetMilliseconds();
 	}
@@ -454,13 +694,80 @@ void CBNetworkCommunicatorOnCanReceive(void * vself, void * vpeer){
 		}
 	}
 }
+void CBNetworkCommunicatorOnCanReceiveBatch(CBNetworkCommunicator * self, CBPeer * peer){
+	if (! peer->receiveBuffer)
+		peer->receiveBuffer = malloc(CB_RECEIVE_BUFFER_SIZE);
+	bool wasEmpty = peer->receiveBufferLength == 0;
+	int32_t num = CBSocketReceive(peer->socketID, peer->receiveBuffer + peer->receiveBufferLength, CB_RECEIVE_BUFFER_SIZE - peer->receiveBufferLength);
+	if (num == CB_SOCKET_CONNECTION_CLOSE) {
+		CBNetworkCommunicatorDisconnect(self, peer, 7200, false); // Remove with penalty for disconnection
+		return;
+	}
+	if (num == CB_SOCKET_FAILURE) {
+		CBNetworkCommunicatorDisconnect(self, peer, 0, false);
+		return;
+	}
+	peer->receiveBufferLength += num;
+	// Keep the peer while processing the messages, as disconnecting releases it.
+	CBRetainObject(peer);
+	uint32_t start = 0;
+	bool processed = false;
+	while (! peer->disconnected && peer->receiveBufferLength - start >= 24) {
+		unsigned char * header = peer->receiveBuffer + start;
+		uint32_t size = CBArrayToInt32(header, CB_MESSAGE_HEADER_LENGTH);
+		uint32_t available = peer->receiveBufferLength - start - 24;
+		if (size > available && size <= CB_RECEIVE_BUFFER_SIZE - 24)
+			// Wait for the rest of the message, which fits in the buffer.
+			break;
+		// Process the header as when reading it by itself.
+		peer->receive = CBNewMessageByObject();
+		peer->receive->serialised = true;
+		peer->downloadTimerStart = CBGetMilliseconds();
+		peer->headerBuffer = malloc(24);
+		memcpy(peer->headerBuffer, header, 24);
+		start += 24;
+		processed = true;
+		CBNetworkCommunicatorOnHeaderRecieved(self, peer);
+		if (peer->disconnected || ! peer->receivedHeader)
+			// Disconnected or an empty message which was processed with the header.
+			continue;
+		// Copy the payload into the message.
+		uint32_t copy = size < available ? size : available;
+		memcpy(CBByteArrayGetData(peer->receive->bytes), peer->receiveBuffer + start, copy);
+		start += copy;
+		peer->messageReceived = copy;
+		if (copy == size)
+			CBNetworkCommunicatorOnMessageReceived(self, peer);
+		else
+			// The payload is too large for the buffer, so the rest is read into the message.
+			CBNetworkCommunicatorSetReceiveTimeOut(self, peer, self->recvTimeOut);
+	}
+	if (! peer->disconnected) {
+		// Move the part of the next message to the start of the buffer.
+		peer->receiveBufferLength -= start;
+		memmove(peer->receiveBuffer, peer->receiveBuffer + start, peer->receiveBufferLength);
+		if (peer->receiveBufferLength && (wasEmpty || processed) && ! peer->receivedHeader)
+			// Use the timeout for receiving data now that a new message has started.
+			CBNetworkCommunicatorSetReceiveTimeOut(self, peer, self->recvTimeOut);
+	}
+	CBReleaseObject(peer);
+}
 void CBNetworkCommunicatorOnCanSend(void * vself, void * vpeer){
 	CBNetworkCommunicator * self = vself;
 	CBPeer * peer = vpeer;
 	bool finished = false;
+	// Restart the send timeout
+	CBNetworkCommunicatorSetTimeOut(self, &peer->sendTimer, self->sendTimeOut);
 	// Can now send data
-	// Get the message we are sending.
-	CBMessage * toSend = peer->sendQueue[peer->sendQueueFront].message;
+	// Get the message we are sending, or take the next message of the highest priority.
+	CBSendQueueItem * item = peer->sending;
+	if (! item && ! (item = CBPeerPopSendQueue(peer))) {
+		// Nothing to send
+		CBSocketRemoveEvent(peer->sendEvent);
+		CBTimerWheelRemove(&peer->sendTimer);
+		return;
+	}
+	CBMessage * toSend = item->message;
 	if (! peer->sentHeader) {
 		// Need to send the header
 		if (peer->messageSent == 0) {
@@ -517,7 +824,9 @@ void CBNetworkCommunicatorOnCanSend(void * vself, void * vpeer){
 					break;
 			}
 			// Length
-			if (toSend->bytes){
+			if (toSend->fileBody){
+				CBInt32ToArray(peer->sendingHeader, CB_MESSAGE_HEADER_LENGTH, toSend->fileLength);
+			}else if (toSend->bytes){
 				CBInt32ToArray(peer->sendingHeader, CB_MESSAGE_HEADER_LENGTH, toSend->bytes->length);
 			}else
 				memset(peer->sendingHeader + CB_MESSAGE_HEADER_LENGTH, 0, 4);
@@ -533,7 +842,7 @@ void CBNetworkCommunicatorOnCanSend(void * vself, void * vpeer){
 			if (peer->messageSent == 24) {
 				// Done header
 				free(peer->sendingHeader);
-				if (toSend->bytes) {
+				if (toSend->fileBody || toSend->bytes) {
 					// Now send the bytes
 					peer->messageSent = 0;
 					peer->sentHeader = true;
@@ -544,12 +853,20 @@ void CBNetworkCommunicatorOnCanSend(void * vself, void * vpeer){
 		}
 	}else{
 		// Sent header
-		int32_t len = CBSocketSend(peer->socketID, CBByteArrayGetData(toSend->bytes) + peer->messageSent, toSend->bytes->length - peer->messageSent);
+		int32_t len, length;
+		if (toSend->fileBody) {
+			// Send the payload straight from the file.
+			length = toSend->fileLength;
+			len = CBSocketSendFile(peer->socketID, toSend->file, toSend->fileOffset + peer->messageSent, length - peer->messageSent);
+		}else{
+			length = toSend->bytes->length;
+			len = CBSocketSend(peer->socketID, CBByteArrayGetData(toSend->bytes) + peer->messageSent, length - peer->messageSent);
+		}
 		if (len == CB_SOCKET_FAILURE)
 			CBNetworkCommunicatorDisconnect(self, peer, 0, false);
 		else{
 			peer->messageSent += len;
-			if (peer->messageSent == toSend->bytes->length)
+			if (peer->messageSent == length)
 				// Sent the entire payload.
 				finished = true;
 		}
@@ -564,29 +881,57 @@ void CBNetworkCommunicatorOnCanSend(void * vself, void * vpeer){
 		peer->messageSent = 0;
 		peer->sentHeader = false;
 		// Done sending message.
-		if (peer->typeExpected != CB_MESSAGE_TYPE_NONE)
-			CBSocketAddEvent(peer->receiveEvent, self->responseTimeOut); // Expect response.
+		if (peer->typeExpected != CB_MESSAGE_TYPE_NONE) {
+			// Expect response. For peers we connected to, the receive event is added when the first response is expected.
+			if (! CBTimerWheelIsPending(&peer->receiveTimer))
+				CBSocketAddEvent(peer->receiveEvent, 0);
+			CBNetworkCommunicatorSetReceiveTimeOut(self, peer, self->responseTimeOut);
+		}
 		// Remove message from queue.
+		peer->sending = NULL;
 		peer->sendQueueSize--;
-		char typeStr[CB_MESSAGE_TYPE_STR_SIZE];
-		CBMessageTypeToString(toSend->type, typeStr);
+		peer->sendQueueBytes -= item->size;
+		// Record how long the message was queued for.
+		int latency = (int)(CBGetMilliseconds() - item->queueTime);
+		peer->sendQueueLatency = peer->messagesSent ? (3 * peer->sendQueueLatency + latency) / 4 : latency;
+		if (latency > peer->sendQueueLatencyMax)
+			peer->sendQueueLatencyMax = latency;
+		peer->messagesSent++;
 		CBReleaseObject(toSend);
-		if (peer->sendQueueSize) {
-			peer->sendQueueFront++;
-			if (peer->sendQueueFront == CB_SEND_QUEUE_MAX_SIZE)
-				peer->sendQueueFront = 0;
-		}else
+		if (! peer->sendQueueSize) {
 			// Remove send event as we have nothing left to send
 			CBSocketRemoveEvent(peer->sendEvent);
-		// Now call the callback, since the message was sent, unless the callback is NULL
-		if (peer->sendQueue[peer->sendQueueFront].callback)
-			peer->sendQueue[peer->sendQueueFront].callback(self, peer);
+			CBTimerWheelRemove(&peer->sendTimer);
+		}
+		// Now call the callback, since the message was sent, unless the callback is NULL. Keep the peer in case a callback disconnects it.
+		void (*callback)(void *, void *) = item->callback;
+		free(item);
+		CBRetainObject(peer);
+		if (callback)
+			callback(self, peer);
+		if (peer->sendQueueFull && peer->sendQueueBytes < CB_SEND_QUEUE_LOW_WATERMARK && ! peer->disconnected) {
+			// Room for the messages which were refused.
+			peer->sendQueueFull = false;
+			if (self->callbacks.onSendQueueDrained)
+				self->callbacks.onSendQueueDrained(self, peer);
+		}
+		CBReleaseObject(peer);
 	}
 }
+void CBNetworkCommunicatorOnDNSLoaded(CBNetworkCommunicator * self, char * domain, int addrNum){
+	self->dnsLookups--;
+	if (addrNum)
+		CBLogVerbose("Got %i addresses from %s", addrNum, domain);
+	else
+		CBLogWarning("Unable to get address information from %s", domain);
+	CBNetworkCommunicatorTryConnections(self, false);
+}
 void CBNetworkCommunicatorOnHeaderRecieved(CBNetworkCommunicator * self, CBPeer * peer){
 	// Make a CBByteArray. ??? Could be modified not to use a CBByteArray, but it is cleaner this way and easier to maintain.
 	CBByteArray * header = CBNewByteArrayWithData(peer->headerBuffer, 24);
-	int networkID = CBByteArrayReadInt32(header, 0);
+	CBCursor cursor;
+	CBInitCursor(&cursor, header);
+	int networkID = CBCursorReadInt32(&cursor);
 	if (networkID != self->networkID){
 		// The network ID bytes is not what we are looking for. We will have to remove the peer.
 		CBReleaseObject(header);
@@ -595,7 +940,8 @@ void CBNetworkCommunicatorOnHeaderRecieved(CBNetworkCommunicator * self, CBPeer
 		return;
 	}
 	CBMessageType type = CB_MESSAGE_TYPE_NONE;
-	int size = CBByteArrayReadInt32(header, 16);
+	CBCursorSkip(&cursor, 12); // The type bytes
+	int size = CBCursorReadInt32(&cursor);
 	bool error = false;
 	CBByteArray * typeBytes = CBNewByteArraySubReference(header, 4, 12);
 	if (! memcmp(CBByteArrayGetData(typeBytes), "version\0\0\0\0\0", 12)) {
@@ -703,10 +1049,7 @@ void CBNetworkCommunicatorOnHeaderRecieved(CBNetworkCommunicator * self, CBPeer
 	// The type and size is OK, make the message
 	peer->receive->type = type;
 	// Get checksum
-	peer->receive->checksum[0] = CBByteArrayGetByte(header, 20);
-	peer->receive->checksum[1] = CBByteArrayGetByte(header, 21);
-	peer->receive->checksum[2] = CBByteArrayGetByte(header, 22);
-	peer->receive->checksum[3] = CBByteArrayGetByte(header, 23);
+	memcpy(peer->receive->checksum, CBCursorPointer(&cursor), 4);
 	// Message is now ready. Free the header.
 	CBReleaseObject(header); // Took the header buffer which should be freed here.
 	if (size) {
@@ -728,7 +1071,7 @@ void CBNetworkCommunicatorOnMessageReceived(CBNetworkCommunicator * self, CBPeer
 	peer->downloadTime += CBGetMilliseconds() - peer->downloadTimerStart;
 	peer->downloadAmount += 24 + (peer->receive->bytes ? peer->receive->bytes->length : 0);
 	// If not expecting a response still, put timeout back to normal.
-	CBSocketAddEvent(peer->receiveEvent, peer->typeExpected != CB_MESSAGE_TYPE_NONE ? self->responseTimeOut : self->timeOut);
+	CBNetworkCommunicatorSetReceiveTimeOut(self, peer, peer->typeExpected != CB_MESSAGE_TYPE_NONE ? self->responseTimeOut : self->timeOut);
 	// Check checksum
 	unsigned char hash[32];
 	unsigned char hash2[32];
@@ -788,12 +1131,18 @@ void CBNetworkCommunicatorOnMessageReceived(CBNetworkCommunicator * self, CBPeer
 			peer->receive = realloc(peer->receive, sizeof(CBBlock));
 			CBGetObject(peer->receive)->free = CBFreeBlock;
 			CBGetBlock(peer->receive)->hashSet = false;
+			CBGetBlock(peer->receive)->arena = NULL;
 			len = CBBlockDeserialise(CBGetBlock(peer->receive), true); // true -> Including transactions.
 			break;
 		case CB_MESSAGE_TYPE_HEADERS:
 			peer->receive = realloc(peer->receive, sizeof(CBBlockHeaders));
 			CBGetObject(peer->receive)->free = CBFreeBlockHeaders;
-			len = CBBlockHeadersDeserialise(CBGetBlockHeaders(peer->receive));
+			CBGetBlockHeaders(peer->receive)->headerNum = 0;
+			CBGetBlockHeaders(peer->receive)->headerArray = NULL;
+			if (self->flags & CB_NETWORK_COMMUNICATOR_FLAT_HEADERS)
+				len = CBBlockHeadersDeserialiseFlat(CBGetBlockHeaders(peer->receive));
+			else
+				len = CBBlockHeadersDeserialise(CBGetBlockHeaders(peer->receive));
 			break;
 		case CB_MESSAGE_TYPE_PING:
 			if (peer->versionMessage->version >= 60000 && self->version >= 60000){
@@ -822,6 +1171,10 @@ void CBNetworkCommunicatorOnMessageReceived(CBNetworkCommunicator * self, CBPeer
 		return;
 	}
 	// Deserialisation was sucessful.
+	if (peer->receive->type == CB_MESSAGE_TYPE_INV)
+		// The peer knows about the inventory it announces, so it is not announced back.
+		for (CBInventoryItem * item = CBGetInventory(peer->receive)->itemFront; item; item = item->next)
+			CBPeerAddKnownInventory(peer, item->hash);
 	char messageTypeStr[CB_MESSAGE_TYPE_STR_SIZE];
 	CBMessageTypeToString(peer->receive->type, messageTypeStr);
 	CBLogVerbose("Processing message from %s with the type %s.", peer->peerStr, messageTypeStr);
@@ -863,6 +1216,14 @@ void CBNetworkCommunicatorOnMessageReceived(CBNetworkCommunicator * self, CBPeer
 		// Node misbehaving. Disconnect.
 		CBNetworkCommunicatorDisconnect(self, peer, CB_24_HOURS, false);
 }
+void CBNetworkCommunicatorOnPeerTimeOut(void * vself, CBTimerWheelEntry * entry){
+	CBPeer * peer = entry->owner;
+	if (entry == &peer->trickleTimer) {
+		CBNetworkCommunicatorFlushAnnouncements(vself, peer);
+		return;
+	}
+	CBNetworkCommunicatorOnTimeOut(vself, peer, entry == &peer->sendTimer ? CB_TIMEOUT_SEND : CB_TIMEOUT_RECEIVE);
+}
 void CBNetworkCommunicatorOnTimeOut(void * vself, void * vpeer, CBTimeOutType type){
 	CBNetworkCommunicator * self = vself;
 	CBPeer * peer = vpeer;
@@ -1182,6 +1543,34 @@ CBOnMessageReceivedAction CBNetworkCommunicatorProcessMessageAutoPingPong(CBNetw
 	}
 	return CB_MESSAGE_ACTION_CONTINUE;
 }
+void CBNetworkCommunicatorRaceConnections(void * vself){
+	CBNetworkCommunicator * self = vself;
+	int room = self->maxConnections + self->raceConnections - self->attemptingOrWorkingConnections;
+	if (room <= 0 || self->flags & CB_NETWORK_COMMUNICATOR_INCOMING_ONLY)
+		return;
+	// Race an attempt against each attempt which is slow, oldest first.
+	long long int now = CBGetMilliseconds();
+	int slow = 0;
+	for (int x = 0; x < self->connectingNum && slow < room; x++) {
+		CBPeer * peer = self->connecting[x];
+		if (! peer->raced && now - peer->connectStart >= CB_NETWORK_COMMUNICATOR_RACE_DELAY) {
+			peer->raced = true;
+			slow++;
+		}
+	}
+	if (slow)
+		CBNetworkCommunicatorConnectCandidates(self, slow);
+}
+void CBNetworkCommunicatorRemoveConnecting(CBNetworkCommunicator * self, CBPeer * peer){
+	for (int x = 0; x < self->connectingNum; x++)
+		if (self->connecting[x] == peer) {
+			self->connectingNum--;
+			memmove(self->connecting + x, self->connecting + x + 1, (self->connectingNum - x) * sizeof(*self->connecting));
+			break;
+		}
+	if (! self->connectingNum)
+		CBNetworkCommunicatorStopRacing(self);
+}
 void CBNetworkCommunicatorRetryConnections(CBNetworkCommunicator * self){
 	// Wait 20 Seconds before trying connections.
 	if (!self->tryConnectionTimerStarted) {
@@ -1198,11 +1587,13 @@ void CBNetworkCommunicatorRetryConnectionsProcess(void * vself){
 	self->tryConnectionTimerStarted = false;
 }
 bool CBNetworkCommunicatorSendMessage(CBNetworkCommunicator * self, CBPeer * peer, CBMessage * message, void (*callback)(void *, void *)){
-	if (peer->sendQueueSize == CB_SEND_QUEUE_MAX_SIZE || !peer->connectionWorking)
+	if (! peer->connectionWorking)
 		return false;
 	char typeStr[CB_MESSAGE_TYPE_STR_SIZE];
 	CBMessageTypeToString(message->type, typeStr);
 	CBLogVerbose("Sending message of type %s (%u) to %s.", typeStr, message->type, peer->peerStr);
+	// Messages given already serialised may not be CBInventory objects, so only the items of inventory serialised here are recorded as known.
+	bool recordInventory = message->type == CB_MESSAGE_TYPE_INV && ! message->serialised;
 	// Serialise message if needed.
 	if (! message->serialised) {
 		int len;
@@ -1279,22 +1670,46 @@ bool CBNetworkCommunicatorSendMessage(CBNetworkCommunicator * self, CBPeer * pee
 		CBSha256(CBByteArrayGetData(message->bytes), message->bytes->length, hash);
 		CBSha256(hash, 32, hash2);
 		memcpy(message->checksum, hash2, 4);
-	}else{
-		// Empty bytes checksum
+	}else if (! message->fileBody) {
+		// Empty bytes checksum. The checksum of a file-backed payload is given with the file.
 		message->checksum[0] = 0x5D;
 		message->checksum[1] = 0xF6;
 		message->checksum[2] = 0xE0;
 		message->checksum[3] = 0xE2;
 	}
-	// Add the message and callback to the send queue
-	int sendQueueIndex = (peer->sendQueueFront + peer->sendQueueSize) % CB_SEND_QUEUE_MAX_SIZE;
-	peer->sendQueue[sendQueueIndex].message = message;
-	peer->sendQueue[sendQueueIndex].callback = callback;
-	if (peer->sendQueueSize == 0
-		&& !CBSocketAddEvent(peer->sendEvent, self->sendTimeOut))
+	// Check there is room in the send queue.
+	CBSendPriority priority = CBNetworkCommunicatorGetSendPriority(message->type);
+	uint32_t size = 24 + (message->fileBody ? message->fileLength : (message->bytes ? (uint32_t)message->bytes->length : 0));
+	if (peer->sendQueueSize && priority != CB_SEND_PRIORITY_CONTROL
+		&& peer->sendQueueBytes + size > CB_SEND_QUEUE_MAX_BYTES) {
+		peer->sendQueueFull = true;
+		peer->sendQueueRefused++;
+		CBLogVerbose("Refused message of type %s for %s with %u bytes queued.", typeStr, peer->peerStr, peer->sendQueueBytes);
 		return false;
-	peer->sendQueueSize++;
+	}
+	CBSendQueueItem * item = malloc(sizeof(*item));
+	if (! item) {
+		CBLogError("Could not allocate memory for a send queue item.");
+		return false;
+	}
+	if (peer->sendQueueSize == 0) {
+		if (! CBSocketAddEvent(peer->sendEvent, 0)){
+			free(item);
+			return false;
+		}
+		CBNetworkCommunicatorSetTimeOut(self, &peer->sendTimer, self->sendTimeOut);
+	}
+	// Add the message and callback to the send queue
+	item->message = message;
+	item->callback = callback;
+	item->size = size;
+	item->queueTime = CBGetMilliseconds();
+	CBPeerPushSendQueue(peer, item, priority);
 	CBRetainObject(message);
+	if (recordInventory)
+		// The peer will know about the inventory we announce.
+		for (CBInventoryItem * invItem = CBGetInventory(message)->itemFront; invItem; invItem = invItem->next)
+			CBPeerAddKnownInventory(peer, invItem->hash);
 	return true;
 }
 void CBNetworkCommunicatorSendPings(void * vself){
@@ -1349,6 +1764,25 @@ void CBNetworkCommunicatorSetReachability(CBNetworkCommunicator * self, CBIPType
 	else
 		self->reachability &= ~type;
 }
+void CBNetworkCommunicatorSetReceiveTimeOut(CBNetworkCommunicator * self, CBPeer * peer, int timeOut){
+	peer->receiveTimeOut = timeOut;
+	CBNetworkCommunicatorSetTimeOut(self, &peer->receiveTimer, timeOut);
+}
+void CBNetworkCommunicatorSetTimeOut(CBNetworkCommunicator * self, CBTimerWheelEntry * entry, int timeOut){
+	if (! self->timeOutTimerStarted && timeOut) {
+		// Bring the wheel up to date, as it was not advanced while the timer was stopped.
+		CBTimerWheelAdvance(&self->timeOuts, CBGetMilliseconds());
+		if (! CBStartTimer(self->eventLoop, &self->timeOutTimer, CB_NETWORK_COMMUNICATOR_TIMEOUT_TICK, CBNetworkCommunicatorCheckTimeOuts, self))
+			CBLogError("Could not start the timer for the timeouts of peers.");
+		else
+			self->timeOutTimerStarted = true;
+	}
+	CBTimerWheelSet(&self->timeOuts, entry, timeOut);
+}
+void CBNetworkCommunicatorSetTrickleTimer(CBNetworkCommunicator * self, CBPeer * peer){
+	// At least one millisecond as zero removes the entry.
+	CBNetworkCommunicatorSetTimeOut(self, &peer->trickleTimer, self->trickleInterval ? 1 + rand() % (2 * self->trickleInterval) : 1);
+}
 void CBNetworkCommunicatorSetUserAgent(CBNetworkCommunicator * self, CBByteArray * userAgent){
 	CBRetainObject(userAgent);
 	self->userAgent = userAgent;
@@ -1389,6 +1823,9 @@ void CBNetworkCommunicatorStartPings(CBNetworkCommunicator * self){
 	CBStartTimer(self->eventLoop, &self->pingTimer, self->heartBeat, CBNetworkCommunicatorSendPings, self);
 }
 void CBNetworkCommunicatorStop(CBNetworkCommunicator * self){
+	// Cancel connection attempts
+	while (self->connectingNum)
+		CBNetworkCommunicatorCancelConnect(self, self->connecting[0]);
 	if (self->ipData[0].isListening || self->ipData[1].isListening || self->ipData[2].isListening || self->ipData[3].isListening)
 		CBNetworkCommunicatorStopListening(self);
 	// Disconnect all the peers
@@ -1396,6 +1833,9 @@ void CBNetworkCommunicatorStop(CBNetworkCommunicator * self){
 		CBNetworkCommunicatorDisconnect(self, peer, 0, true); // "true" we are stopping.
 	// Now reset the peers arrays. The addresses were released in CBNetworkCommunicatorDisconnect, so this function only clears the array nodes.
 	CBNetworkAddressManagerClearPeers(self->addresses);
+	CBNetworkCommunicatorStopTimeOuts(self);
+	// Results of seed lookups are no longer wanted.
+	CBNetworkCommunicatorCancelDNS(self);
 }
 void CBNetworkCommunicatorStopListening(CBNetworkCommunicator * self){
 	for (int x = 0; x < 4; x++) {
@@ -1412,49 +1852,34 @@ void CBNetworkCommunicatorStopPings(CBNetworkCommunicator * self){
 		self->isPinging = false;
 	}
 }
+void CBNetworkCommunicatorStopRacing(CBNetworkCommunicator * self){
+	if (self->raceTimerStarted){
+		CBEndTimer(self->raceTimer);
+		self->raceTimerStarted = false;
+	}
+}
+void CBNetworkCommunicatorStopTimeOuts(CBNetworkCommunicator * self){
+	if (self->timeOutTimerStarted){
+		CBEndTimer(self->timeOutTimer);
+		self->timeOutTimerStarted = false;
+	}
+}
 void CBNetworkCommunicatorTryConnections(CBNetworkCommunicator * self, bool dns){
 	if (self->attemptingOrWorkingConnections >= self->maxConnections
 		|| self->flags & CB_NETWORK_COMMUNICATOR_INCOMING_ONLY)
 		return; // Cannot connect to any more peers
-	if (dns && self->flags & CB_NETWORK_COMMUNICATOR_BOOTSTRAP)
-		// Get DNS nodes
-		CBForEach(char * domain, CB_SEED_DOMAINS)
-			if (!CBNetworkCommunicatorLoadDNS(self, domain))
+	if (dns && self->flags & CB_NETWORK_COMMUNICATOR_BOOTSTRAP && ! self->dnsLookups)
+		// Get DNS nodes. The domains are resolved at the same time and the addresses are tried as each domain is answered.
+		CBForEach(char * domain, CB_SEED_DOMAINS) {
+			if (CBNetworkCommunicatorLoadDNS(self, domain))
+				self->dnsLookups++;
+			else
 				CBLogWarning("Unable to get address information from %s", domain);
-	int connectTo = self->maxConnections - self->attemptingOrWorkingConnections;
-	int addrNum = self->addresses->addrNum;
-	if (addrNum < connectTo)
-		connectTo = addrNum; // Cannot connect to any more than the address we have
-	CBNetworkAddress ** addrs = malloc(sizeof(*addrs) * connectTo);
-	connectTo = CBNetworkAddressManagerGetAddresses(self->addresses, connectTo, addrs);
-	for (long long int x = 0; x < connectTo; x++) {
-		// Remove the address from the address manager
-		CBNetworkAddressManagerRemoveAddress(self->addresses, addrs[x]);
-		// We haven't got the address as a peer.
-		// Convert network address into peer
-		CBPeer * peer = CBNewPeer(addrs[x]);
-		CBReleaseObject(addrs[x]);
-		char addrStr[CB_NETWORK_ADDR_STR_SIZE];
-		CBNetworkAddressToString(peer->addr, addrStr);
-		strcpy(peer->peerStr, addrStr);
-		peer->incomming = false;
-		CBConnectReturn res = CBNetworkCommunicatorConnect(self, peer);
-		if (res == CB_CONNECT_ERROR || res == CB_CONNECT_FAILED) {
-			// Add address back to manager
-			if (res == CB_CONNECT_FAILED)
-				// Add penalty if failed
-				peer->addr->lastSeen -= 3600;
-			// Re-insert into the address manager, since we could not connect this time. If it fails, ignore and the address will not be added.
-			CBNetworkAddressManagerAddAddress(self->addresses, peer->addr);
-			CBReleaseObject(peer);
-			CBLogWarning("Unable to connect to the address: %s", addrStr);
-		}else if (res == CB_CONNECT_OK) {
-			CBLogVerbose("Made a connection to peer %s", addrStr);
 		}
-		// Either the connection was OK and it should either timeout or finalise, or we forget about it because it is not supported.
-	}
+	if (! self->connectivityStart && ! self->addresses->peersNum)
+		self->connectivityStart = CBGetMilliseconds();
+	// Attempts raced against others count towards the connections needed, as the slowest are cancelled.
+	CBNetworkCommunicatorConnectCandidates(self, self->maxConnections - self->attemptingOrWorkingConnections);
 	if (self->attemptingOrWorkingConnections == 0)
 		CBNetworkCommunicatorNoPeers(self);
-	// Free address pointer memory.
-	free(addrs);
 }
@@ -18,42 +18,31 @@
 
 //  Initialiser
 
-void CBInitObject(CBObject * self, bool useMutex){
+void CBInitObject(CBObject * self, bool threadSafe){
 	self->references = 1;
-	self->usesMutex = useMutex;
-	if (useMutex)
-		CBNewMutex(&((CBObjectMutex *)self)->refMutex);
+	self->threadSafe = threadSafe;
 }
 
 //  Functions
 
 void CBReleaseObject(void * self){
 	CBObject * obj = self;
-	CBDepObject refMutex;
-	bool usesMutex = obj->usesMutex;
-	if (usesMutex){
-		refMutex = ((CBObjectMutex *)self)->refMutex;
-		CBMutexLock(refMutex);
-	}
 	// Decrement reference counter. Free if no more references.
-	obj->references--;
-	if (obj->references < 1){
-		obj->free(obj);
-		if (usesMutex) {
-			CBMutexUnlock(refMutex);
-			CBFreeMutex(refMutex);
-		}
-	}else if (usesMutex)
-		CBMutexUnlock(refMutex);
+	if (obj->threadSafe){
+		// Use release ordering so that this thread's use of the object happens before the object is freed by any thread.
+		if (__atomic_fetch_sub(&obj->references, 1, __ATOMIC_RELEASE) != 1)
+			return;
+		// The thread freeing the object must see the uses of all other threads.
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	}else if (--obj->references > 0)
+		return;
+	obj->free(obj);
 }
 void CBRetainObject(void * self){
-	// Increment reference counter.
+	// Increment reference counter. A new reference can only be made from an existing one, so no ordering is needed.
 	CBObject * obj = self;
-	if (obj->usesMutex){
-		CBDepObject mutex = ((CBObjectMutex *)self)->refMutex;
-		CBMutexLock(mutex);
-		obj->references++;
-		CBMutexUnlock(mutex);
-	}else
+	if (obj->threadSafe)
+		__atomic_fetch_add(&obj->references, 1, __ATOMIC_RELAXED);
+	else
 		obj->references++;
 }
@@ -33,6 +33,8 @@ void CBInitPeer(CBPeer * self, CBNetworkAddress * addr){
 	self->addr = addr;
 	self->receive = NULL;
 	self->receivedHeader = false;
+	self->receiveBuffer = NULL;
+	self->receiveBufferLength = 0;
 	self->handshakeStatus = CB_HANDSHAKE_NONE;
 	self->versionMessage = NULL;
 	self->timeOffset = 0;
@@ -44,19 +46,86 @@ void CBInitPeer(CBPeer * self, CBNetworkAddress * addr){
 	self->downloadTime = 0;
 	self->downloadAmount = 0;
 	self->downloadTimerStart = 0;
-	self->sendQueueFront = 0;
+	for (int x = 0; x < CB_SEND_PRIORITY_NUM; x++)
+		self->sendQueue[x] = NULL;
+	self->sending = NULL;
 	self->sendQueueSize = 0;
+	self->sendQueueBytes = 0;
+	self->sendQueueFull = false;
+	self->sendQueueRefused = 0;
+	self->messagesSent = 0;
+	self->sendQueueLatency = 0;
+	self->sendQueueLatencyMax = 0;
 	self->messageReceived = false;
 	self->allowRelay = true;
 	self->disconnected = false;
 	self->typeExpected = CB_MESSAGE_TYPE_NONE;
+	CBInitTimerWheelEntry(&self->receiveTimer, self);
+	CBInitTimerWheelEntry(&self->sendTimer, self);
+	CBInitTimerWheelEntry(&self->trickleTimer, self);
+	self->announcements = NULL;
+	self->announcementsTime = 0;
+	self->knownInventory = NULL;
+	self->receiveTimeOut = 0;
 	strcpy(self->peerStr, "unknown");
 }
 
 void CBDestroyPeer(CBPeer * peer){
 	CBReleaseObject(peer->addr);
+	free(peer->receiveBuffer);
+	CBPeerClearSendQueue(peer);
+	if (peer->announcements)
+		CBReleaseObject(peer->announcements);
+	if (peer->knownInventory)
+		CBReleaseObject(peer->knownInventory);
 }
 void CBFreePeer(void * peer){
 	CBDestroyPeer(peer);
 	free(peer);
 }
+
+//  Functions
+
+bool CBPeerAddKnownInventory(CBPeer * self, CBByteArray * hash){
+	if (! self->knownInventory)
+		return true;
+	return CBRollingBloomFilterAdd(self->knownInventory, CBByteArrayGetData(hash));
+}
+void CBPeerClearSendQueue(CBPeer * self){
+	if (self->sending) {
+		CBReleaseObject(self->sending->message);
+		free(self->sending);
+		self->sending = NULL;
+	}
+	for (int x = 0; x < CB_SEND_PRIORITY_NUM; x++)
+		while (self->sendQueue[x]) {
+			CBSendQueueItem * item = self->sendQueue[x];
+			self->sendQueue[x] = item->next;
+			CBReleaseObject(item->message);
+			free(item);
+		}
+	self->sendQueueSize = 0;
+	self->sendQueueBytes = 0;
+}
+bool CBPeerKnowsInventory(CBPeer * self, CBByteArray * hash){
+	return self->knownInventory && CBRollingBloomFilterContains(self->knownInventory, CBByteArrayGetData(hash));
+}
+CBSendQueueItem * CBPeerPopSendQueue(CBPeer * self){
+	for (int x = 0; x < CB_SEND_PRIORITY_NUM; x++)
+		if (self->sendQueue[x]) {
+			self->sending = self->sendQueue[x];
+			self->sendQueue[x] = self->sending->next;
+			return self->sending;
+		}
+	return NULL;
+}
+void CBPeerPushSendQueue(CBPeer * self, CBSendQueueItem * item, CBSendPriority priority){
+	item->next = NULL;
+	if (self->sendQueue[priority])
+		self->sendQueueLast[priority]->next = item;
+	else
+		self->sendQueue[priority] = item;
+	self->sendQueueLast[priority] = item;
+	self->sendQueueSize++;
+	self->sendQueueBytes += item->size;
+}
@@ -15,6 +15,7 @@
 //  SEE HEADER FILE FOR DOCUMENTATION 
 
 #include "CBPingPong.h"
+#include "CBCursor.h"
 
 //  Constructors
 
@@ -81,7 +82,9 @@ int CBPingPongDeserialise(CBPingPong * self) {
 		return CB_DESERIALISE_ERROR;
 	}
 	
-	self->ID = CBByteArrayReadInt64(bytes, 0);
+	CBCursor cursor;
+	CBInitCursor(&cursor, bytes);
+	self->ID = CBCursorReadInt64(&cursor);
 	
 	return 8;
 	
@@ -0,0 +1,371 @@
+//
+//  CBPool.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+//  SEE HEADER FILE FOR DOCUMENTATION
+
+#include "CBPool.h"
+
+// The thread caches and current arena are thread-local so that they need no locking.
+__thread CBPoolCache CBPoolThreadCaches[CB_POOL_CACHE_NUM];
+__thread CBArena * CBCurrentArena = NULL;
+__thread bool CBPoolThreadCachesRegistered = false; // True when the caches are flushed when the thread exits.
+pthread_key_t CBPoolThreadCacheKey;
+pthread_once_t CBPoolThreadCacheOnce = PTHREAD_ONCE_INIT;
+
+//  Constructor
+
+CBArena * CBNewArena(void) {
+	
+	CBArena * self = malloc(sizeof(*self));
+	if (!self)
+		return NULL;
+	
+	self->references = 1;
+	self->chunks = NULL;
+	self->used = CB_ARENA_CHUNK_SIZE;
+	self->chunkNum = 0;
+	
+	return self;
+	
+}
+
+//  Destructor
+
+void CBDestroyPool(CBPool * self) {
+	
+	while (self->slabs) {
+		void * next = *(void **)self->slabs;
+		free(self->slabs);
+		self->slabs = next;
+	}
+	
+	self->free = NULL;
+	self->slabNum = 0;
+	
+}
+
+//  Functions
+
+void * CBAlloc(CBPool * pool, CBAllocation * allocation) {
+	
+	if (CBCurrentArena) {
+		*allocation = CB_ALLOCATION_ARENA;
+		return CBArenaAlloc(CBCurrentArena, pool->size);
+	}
+	
+	*allocation = CB_ALLOCATION_POOL;
+	
+	return CBPoolAlloc(pool);
+	
+}
+
+void * CBAllocObject(CBPool * pool) {
+	
+	CBAllocation allocation;
+	CBObject * self = CBAlloc(pool, &allocation);
+	if (!self)
+		return NULL;
+	
+	self->allocation = allocation;
+	
+	return self;
+	
+}
+
+void * CBArenaAlloc(CBArena * self, int size) {
+	
+	// Keep allocations aligned to 16 bytes
+	size = (size + 15) & ~15;
+	
+	if (self->used + size > CB_ARENA_CHUNK_SIZE) {
+		
+		// Allocate a new chunk aligned to its size
+		CBArenaChunk * chunk;
+		if (posix_memalign((void **)&chunk, CB_ARENA_CHUNK_SIZE, CB_ARENA_CHUNK_SIZE))
+			return NULL;
+		
+		chunk->arena = self;
+		chunk->next = self->chunks;
+		self->chunks = chunk;
+		self->used = (sizeof(*chunk) + 15) & ~15;
+		self->chunkNum++;
+		
+	}
+	
+	void * ptr = (char *)self->chunks + self->used;
+	self->used += size;
+	
+	// The objects can be freed on other threads
+	__atomic_fetch_add(&self->references, 1, __ATOMIC_RELAXED);
+	
+	return ptr;
+	
+}
+
+CBArena * CBArenaFromPointer(void * ptr) {
+	
+	return ((CBArenaChunk *)((uintptr_t)ptr & ~(uintptr_t)(CB_ARENA_CHUNK_SIZE - 1)))->arena;
+	
+}
+
+void CBArenaRelease(CBArena * self) {
+	
+	if (__atomic_fetch_sub(&self->references, 1, __ATOMIC_ACQ_REL) != 1)
+		return;
+	
+	// Free all of the chunks at once
+	while (self->chunks) {
+		CBArenaChunk * next = self->chunks->next;
+		free(self->chunks);
+		self->chunks = next;
+	}
+	
+	free(self);
+	
+}
+
+void CBFreeMemory(void * ptr, CBAllocation allocation, CBPool * pool) {
+	
+	switch (allocation) {
+		case CB_ALLOCATION_POOL:
+			CBPoolFree(pool, ptr);
+			break;
+		case CB_ALLOCATION_ARENA:
+			CBArenaRelease(CBArenaFromPointer(ptr));
+			break;
+		default:
+			free(ptr);
+			break;
+	}
+	
+}
+
+void CBFreeObjectMemory(void * self, CBPool * pool) {
+	
+	CBFreeMemory(self, CBGetObject(self)->allocation, pool);
+	
+}
+
+CBArena * CBGetCurrentArena(void) {
+	
+	return CBCurrentArena;
+	
+}
+
+void * CBPoolAlloc(CBPool * self) {
+	
+	CBPoolObject * obj;
+	
+	if (self->cacheID != CB_POOL_CACHE_NONE) {
+		
+		CBPoolCache * cache = CBPoolGetThreadCache(self);
+		
+		if (!cache->freeNum && !CBPoolFillCache(self, cache))
+			return NULL;
+		
+		obj = cache->free;
+		cache->free = obj->next;
+		cache->freeNum--;
+		
+		return obj;
+		
+	}
+	
+	CBPoolLock(self);
+	
+	if (!self->free && !CBPoolNewSlab(self)) {
+		CBPoolUnlock(self);
+		return NULL;
+	}
+	
+	obj = self->free;
+	self->free = obj->next;
+	
+	CBPoolUnlock(self);
+	
+	return obj;
+	
+}
+
+bool CBPoolFillCache(CBPool * self, CBPoolCache * cache) {
+	
+	CBPoolLock(self);
+	
+	while (cache->freeNum < CB_POOL_CACHE_SIZE / 2) {
+		
+		if (!self->free && !CBPoolNewSlab(self))
+			break;
+		
+		CBPoolObject * obj = self->free;
+		self->free = obj->next;
+		obj->next = cache->free;
+		cache->free = obj;
+		cache->freeNum++;
+		
+	}
+	
+	CBPoolUnlock(self);
+	
+	return cache->freeNum != 0;
+	
+}
+
+void CBPoolFlushThreadCache(CBPool * self) {
+	
+	if (self->cacheID == CB_POOL_CACHE_NONE)
+		return;
+	
+	CBPoolCache * cache = CBPoolThreadCaches + self->cacheID;
+	
+	if (!cache->free)
+		return;
+	
+	CBPoolLock(self);
+	
+	while (cache->free) {
+		CBPoolObject * obj = cache->free;
+		cache->free = obj->next;
+		obj->next = self->free;
+		self->free = obj;
+	}
+	
+	cache->freeNum = 0;
+	
+	CBPoolUnlock(self);
+	
+}
+
+void CBPoolFlushThreadCaches(void * unused) {
+	
+	UNUSED(unused);
+	
+	for (int x = 0; x < CB_POOL_CACHE_NUM; x++)
+		if (CBPoolThreadCaches[x].pool)
+			CBPoolFlushThreadCache(CBPoolThreadCaches[x].pool);
+	
+}
+
+void CBPoolFree(CBPool * self, void * ptr) {
+	
+	CBPoolObject * obj = ptr;
+	
+	if (self->cacheID != CB_POOL_CACHE_NONE) {
+		
+		CBPoolCache * cache = CBPoolGetThreadCache(self);
+		
+		obj->next = cache->free;
+		cache->free = obj;
+		
+		if (++cache->freeNum > CB_POOL_CACHE_SIZE) {
+			
+			// Give half back to the pool
+			CBPoolLock(self);
+			
+			while (cache->freeNum > CB_POOL_CACHE_SIZE / 2) {
+				obj = cache->free;
+				cache->free = obj->next;
+				obj->next = self->free;
+				self->free = obj;
+				cache->freeNum--;
+			}
+			
+			CBPoolUnlock(self);
+			
+		}
+		
+		return;
+		
+	}
+	
+	CBPoolLock(self);
+	
+	obj->next = self->free;
+	self->free = obj;
+	
+	CBPoolUnlock(self);
+	
+}
+
+CBPoolCache * CBPoolGetThreadCache(CBPool * self) {
+	
+	CBPoolCache * cache = CBPoolThreadCaches + self->cacheID;
+	
+	if (!CBPoolThreadCachesRegistered) {
+		// Flush the caches when the thread exits. The value only needs to be non-NULL for the destructor to be called.
+		pthread_once(&CBPoolThreadCacheOnce, CBPoolThreadCacheKeyCreate);
+		pthread_setspecific(CBPoolThreadCacheKey, CBPoolThreadCaches);
+		CBPoolThreadCachesRegistered = true;
+	}
+	
+	cache->pool = self;
+	
+	return cache;
+	
+}
+
+void CBPoolLock(CBPool * self) {
+	
+	int spins = 0;
+	while (__atomic_test_and_set(&self->lock, __ATOMIC_ACQUIRE))
+		while (__atomic_load_n(&self->lock, __ATOMIC_RELAXED)) {
+			if (spins < CB_POOL_LOCK_SPINS) {
+				spins++;
+				CBPoolPause();
+			}else
+				sched_yield();
+		}
+	
+}
+
+bool CBPoolNewSlab(CBPool * self) {
+	
+	// The first 16 bytes of the slab link the slabs.
+	char * slab = malloc(CB_POOL_SLAB_SIZE);
+	if (!slab)
+		return false;
+	
+	*(void **)slab = self->slabs;
+	self->slabs = slab;
+	self->slabNum++;
+	
+	for (int offset = 16; offset + self->size <= CB_POOL_SLAB_SIZE; offset += self->size) {
+		CBPoolObject * obj = (CBPoolObject *)(slab + offset);
+		obj->next = self->free;
+		self->free = obj;
+	}
+	
+	return true;
+	
+}
+
+void CBPoolThreadCacheKeyCreate(void) {
+	
+	pthread_key_create(&CBPoolThreadCacheKey, CBPoolFlushThreadCaches);
+	
+}
+
+void CBPoolUnlock(CBPool * self) {
+	
+	__atomic_clear(&self->lock, __ATOMIC_RELEASE);
+	
+}
+
+CBArena * CBSetCurrentArena(CBArena * arena) {
+	
+	CBArena * prev = CBCurrentArena;
+	CBCurrentArena = arena;
+	
+	return prev;
+	
+}
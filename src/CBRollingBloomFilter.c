@@ -0,0 +1,179 @@
+//
+//  CBRollingBloomFilter.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+//  SEE HEADER FILE FOR DOCUMENTATION
+
+#include "CBRollingBloomFilter.h"
+
+// Odd numbers which choose the bit of each word of a block.
+const uint32_t CBBloomSalts[CB_BLOOM_BLOCK_WORDS] = {
+	0x47b6137b, 0x44974d91, 0x8824ad5b, 0xa2b7289d, 0x705495c7, 0x2df1424b, 0x9efc4947, 0x5c6bfb31,
+	0x9e3779b9, 0x85ebca6b, 0xc2b2ae35, 0x27d4eb2f, 0x165667b1, 0xd3a2646d, 0xfd7046c5, 0xb55a4f09
+};
+
+//  Constructor
+
+CBRollingBloomFilter * CBNewRollingBloomFilter(uint32_t items, double falsePositiveRate, uint64_t seed){
+	CBRollingBloomFilter * self = malloc(sizeof(*self));
+	if (! self)
+		return NULL;
+	CBGetObject(self)->free = CBFreeRollingBloomFilter;
+	if (! CBInitRollingBloomFilter(self, items, falsePositiveRate, seed)) {
+		free(self);
+		return NULL;
+	}
+	return self;
+}
+
+//  Initialiser
+
+bool CBInitRollingBloomFilter(CBRollingBloomFilter * self, uint32_t items, double falsePositiveRate, uint64_t seed){
+	CBInitObject(CBGetObject(self), false);
+	self->generationItems = items / 2 + 1;
+	// A hash can be found in either generation, so each has half of the false positive rate.
+	self->blockNum = CBRollingBloomFilterGetBlockNum(self->generationItems, falsePositiveRate / 2);
+	void * blocks;
+	if (posix_memalign(&blocks, sizeof(CBBloomBlock), 2 * (size_t)self->blockNum * sizeof(CBBloomBlock))) {
+		CBLogError("Could not allocate %u blocks for a rolling bloom filter.", 2 * self->blockNum);
+		return false;
+	}
+	memset(blocks, 0, 2 * (size_t)self->blockNum * sizeof(CBBloomBlock));
+	self->generations[0] = blocks;
+	self->generations[1] = self->generations[0] + self->blockNum;
+	self->itemNum = 0;
+	self->current = 0;
+	self->seed = seed;
+	return true;
+}
+
+//  Destructor
+
+void CBDestroyRollingBloomFilter(void * self){
+	free(CBGetRollingBloomFilter(self)->generations[0]);
+}
+void CBFreeRollingBloomFilter(void * self){
+	CBDestroyRollingBloomFilter(self);
+	free(self);
+}
+
+//  Functions
+
+bool CBRollingBloomFilterAdd(CBRollingBloomFilter * self, unsigned char * hash){
+	uint64_t h = CBRollingBloomFilterHash(self, hash);
+	uint32_t index = (h >> 32) * self->blockNum >> 32;
+	uint32_t masks[CB_BLOOM_BLOCK_WORDS];
+	CBRollingBloomFilterGetMasks((uint32_t)h, masks);
+	if (CBRollingBloomFilterBlockContains(self->generations[self->current][index], masks))
+		return false;
+	// A hash only in the older generation is added to the current generation, so that it is not forgotten when the older generation is cleared.
+	bool found = CBRollingBloomFilterBlockContains(self->generations[! self->current][index], masks);
+	if (self->itemNum == self->generationItems) {
+		// Forget the older generation and use it for the next hashes.
+		self->current = ! self->current;
+		memset(self->generations[self->current], 0, self->blockNum * sizeof(CBBloomBlock));
+		self->itemNum = 0;
+	}
+	uint32_t * block = self->generations[self->current][index];
+	for (int x = 0; x < CB_BLOOM_BLOCK_WORDS; x++)
+		block[x] |= masks[x];
+	self->itemNum++;
+	return ! found;
+}
+bool CBRollingBloomFilterBlockContains(uint32_t * block, uint32_t * masks){
+	// Test every word without branches.
+	uint32_t missing = 0;
+	for (int x = 0; x < CB_BLOOM_BLOCK_WORDS; x++)
+		missing |= masks[x] & ~block[x];
+	return ! missing;
+}
+bool CBRollingBloomFilterContains(CBRollingBloomFilter * self, unsigned char * hash){
+	uint64_t h = CBRollingBloomFilterHash(self, hash);
+	uint32_t index = (h >> 32) * self->blockNum >> 32;
+	uint32_t masks[CB_BLOOM_BLOCK_WORDS];
+	CBRollingBloomFilterGetMasks((uint32_t)h, masks);
+	return CBRollingBloomFilterBlockContains(self->generations[0][index], masks)
+		|| CBRollingBloomFilterBlockContains(self->generations[1][index], masks);
+}
+double CBRollingBloomFilterFalsePositiveRate(uint32_t items, uint32_t blockNum){
+	// The number of hashes in a block is binomially distributed. A block with j hashes gives a false positive when the bit of each word is one of those set, which has a chance of 1 - (31/32)^j for each word.
+	if (blockNum == 1) {
+		// Every hash is in the one block.
+		double word = 1;
+		for (uint32_t j = 0; j < items; j++)
+			word *= 31.0 / 32.0;
+		word = 1 - word;
+		word *= word;
+		word *= word;
+		word *= word;
+		return word * word;
+	}
+	double p = 1.0 / blockNum;
+	// The chance of a block having no hashes, (1 - p)^items, by squaring.
+	double prob = 1;
+	double square = 1 - p;
+	for (uint32_t x = items; x; x >>= 1, square *= square)
+		if (x & 1)
+			prob *= square;
+	if (prob == 0)
+		// Too many hashes for each block.
+		return 1;
+	double mean = (double)items / blockNum;
+	double rate = 0;
+	double clear = 1; // (31/32)^j
+	for (uint32_t j = 0; j <= items; j++) {
+		double word = 1 - clear;
+		word *= word; // 2
+		word *= word; // 4
+		word *= word; // 8
+		word *= word; // 16 words
+		rate += prob * word;
+		if (j > mean && prob < 1e-20)
+			break;
+		prob *= (double)(items - j) / (j + 1) * p / (1 - p);
+		clear *= 31.0 / 32.0;
+	}
+	return rate;
+}
+uint32_t CBRollingBloomFilterGetBlockNum(uint32_t items, double falsePositiveRate){
+	// Search for the fewest blocks, up to one for each hash.
+	uint32_t low = 1, high = items ? items : 1;
+	while (low < high) {
+		uint32_t mid = low + (high - low) / 2;
+		if (CBRollingBloomFilterFalsePositiveRate(items, mid) <= falsePositiveRate)
+			high = mid;
+		else
+			low = mid + 1;
+	}
+	return low;
+}
+void CBRollingBloomFilterGetMasks(uint32_t hash, uint32_t * masks){
+	for (int x = 0; x < CB_BLOOM_BLOCK_WORDS; x++)
+		masks[x] = (uint32_t)1 << ((hash * CBBloomSalts[x]) >> 27);
+}
+uint64_t CBRollingBloomFilterHash(CBRollingBloomFilter * self, unsigned char * hash){
+	uint64_t h = self->seed;
+	for (int x = 0; x < 32; x += 8) {
+		uint64_t word;
+		memcpy(&word, hash + x, 8);
+		h = (h ^ word) * 0x9E3779B97F4A7C15ULL;
+		h ^= h >> 29;
+	}
+	// Finalise so that every bit of the result depends on every bit of the hash.
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+	return h;
+}
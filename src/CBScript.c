@@ -27,44 +27,44 @@ CBScript * CBNewScriptOfSize(int size){
 }
 
 CBScript * CBNewScriptFromString(char * string){
-	CBScript * self = malloc(sizeof(*self));
+	CBScript * self = CBAllocObject(&CBByteArrayPool);
 	CBGetObject(self)->free = CBFreeByteArray;
 	if (CBInitScriptFromString(self, string))
 		return self;
-	free(self);
+	CBFreeObjectMemory(self, &CBByteArrayPool);
 	return NULL;
 }
 
 CBScript * CBNewScriptMultisigOutput(unsigned char ** pubKeys, int m, int n){
-	CBScript * self = malloc(sizeof(*self));
+	CBScript * self = CBAllocObject(&CBByteArrayPool);
 	CBGetObject(self)->free = CBFreeByteArray;
 	CBInitScriptMultisigOutput(self, pubKeys, m, n);
 	return self;
 }
 
 CBScript * CBNewScriptP2SHOutput(CBScript * script){
-	CBScript * self = malloc(sizeof(*self));
+	CBScript * self = CBAllocObject(&CBByteArrayPool);
 	CBGetObject(self)->free = CBFreeByteArray;
 	CBInitScriptP2SHOutput(self, script);
 	return self;
 }
 
 CBScript * CBNewScriptPubKeyHashOutputFromAddress(CBAddress * address){
-	CBScript * self = malloc(sizeof(*self));
+	CBScript * self = CBAllocObject(&CBByteArrayPool);
 	CBGetObject(self)->free = CBFreeByteArray;
 	CBInitScriptPubKeyHashOutputFromAddress(self, address);
 	return self;
 }
 
 CBScript * CBNewScriptPubKeyHashOutput(unsigned char * pubKeyHash){
-	CBScript * self = malloc(sizeof(*self));
+	CBScript * self = CBAllocObject(&CBByteArrayPool);
 	CBGetObject(self)->free = CBFreeByteArray;
 	CBInitScriptPubKeyHashOutput(self, pubKeyHash);
 	return self;
 }
 
 CBScript * CBNewScriptPubKeyOutput(unsigned char * pubKey){
-	CBScript * self = malloc(sizeof(*self));
+	CBScript * self = CBAllocObject(&CBByteArrayPool);
 	CBGetObject(self)->free = CBFreeByteArray;
 	CBInitScriptPubKeyOutput(self, pubKey);
 	return self;
@@ -1366,27 +1366,30 @@ int CBScriptGetPushAmount(CBScript * self, int * offset){
 	return pushAmount;
 }
 int CBScriptGetSigOpCount(CBScript * self, bool inP2SH){
+	return CBScriptGetSigOpCountFromData(CBByteArrayGetData(self), self->length, inP2SH);
+}
+int CBScriptGetSigOpCountFromData(unsigned char * data, int length, bool inP2SH){
 	int sigOps = 0;
 	CBScriptOp lastOp = CB_SCRIPT_OP_INVALIDOPCODE;
 	int cursor = 0;
-	for (;cursor < self->length;) {
-		CBScriptOp op = CBByteArrayGetByte(self, cursor);
+	for (;cursor < length;) {
+		CBScriptOp op = data[cursor];
 		if (op < 76) {
 			cursor += op + 1;
 		}else if (op < 79){
 			cursor++;
-			if(self->length - cursor < 1)
+			if(length - cursor < 1)
 				break; // Needs at least one more byte
 			if (op == CB_SCRIPT_OP_PUSHDATA1)
-				cursor += 1 + CBByteArrayGetByte(self, cursor);
+				cursor += 1 + data[cursor];
 			else if (op == CB_SCRIPT_OP_PUSHDATA2){
-				if (self->length - cursor < 2)
+				if (length - cursor < 2)
 					break; // Not enough space.
-				cursor += 2 + CBByteArrayReadInt16(self, cursor);
+				cursor += 2 + CBArrayToInt16(data, cursor);
 			}else{
-				if (self->length - cursor < 4)
+				if (length - cursor < 4)
 					break; // Not enough space.
-				cursor += 4 + CBByteArrayReadInt32(self, cursor);
+				cursor += 4 + CBArrayToInt32(data, cursor);
 			}
 		}else if (op == CB_SCRIPT_OP_CHECKSIG || op == CB_SCRIPT_OP_CHECKSIGVERIFY){
 			sigOps++;
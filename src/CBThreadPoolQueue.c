@@ -16,6 +16,14 @@
 
 #include "CBThreadPoolQueue.h"
 #include <assert.h>
+#include <pthread.h>
+
+CBThreadPoolJob * CBThreadPoolJobs = NULL; // The jobs with items left to take, newest first.
+int CBThreadPoolThreadNum = 0;
+CBDepObject CBThreadPoolMutex;
+CBDepObject CBThreadPoolWorkCond; // Signalled when a job is added.
+CBDepObject CBThreadPoolDoneCond; // Signalled when the last thread stops running items of a job.
+pthread_once_t CBThreadPoolOnce = PTHREAD_ONCE_INIT;
 
 void CBInitThreadPoolQueue(CBThreadPoolQueue * self, int numThreads, void (*process)(CBThreadPoolQueue * threadPoolQueue, void * item), void (*destroy)(void * item)){
 	// Create threads
@@ -69,6 +77,72 @@ void CBFreeQueue(CBQueue * queue, void (*destroy)(void * item)){
 	}
 }
 
+void CBThreadPoolInit(void){
+	CBNewMutex(&CBThreadPoolMutex);
+	CBNewCondition(&CBThreadPoolWorkCond);
+	CBNewCondition(&CBThreadPoolDoneCond);
+}
+void CBThreadPoolRemoveJob(CBThreadPoolJob * job){
+	for (CBThreadPoolJob ** ptr = &CBThreadPoolJobs; *ptr; ptr = &(*ptr)->nextJob)
+		if (*ptr == job) {
+			*ptr = job->nextJob;
+			return;
+		}
+}
+void CBThreadPoolRun(void (*process)(void * object, int item), void * object, int itemNum, int numThreads){
+	if (numThreads <= 1 || itemNum <= 1) {
+		for (int x = 0; x < itemNum; x++)
+			process(object, x);
+		return;
+	}
+	// The calling thread runs items too, so it needs one fewer pool thread.
+	CBThreadPoolJob job = {process, object, itemNum, 0, numThreads - 1, 0, NULL};
+	pthread_once(&CBThreadPoolOnce, CBThreadPoolInit);
+	CBMutexLock(CBThreadPoolMutex);
+	for (; CBThreadPoolThreadNum < job.threads; CBThreadPoolThreadNum++) {
+		// The threads are kept for the life of the process.
+		CBDepObject thread;
+		CBNewThread(&thread, CBThreadPoolWorkerLoop, NULL);
+	}
+	// Newer jobs are taken first, so that a job given by a process function finishes before the threads return to the job which gave it.
+	job.nextJob = CBThreadPoolJobs;
+	CBThreadPoolJobs = &job;
+	CBConditionBroadcast(CBThreadPoolWorkCond);
+	CBMutexUnlock(CBThreadPoolMutex);
+	CBThreadPoolRunItems(&job);
+	// All items are taken. Wait for the pool threads still running items.
+	CBMutexLock(CBThreadPoolMutex);
+	CBThreadPoolRemoveJob(&job);
+	while (job.running)
+		CBConditionWait(CBThreadPoolDoneCond, CBThreadPoolMutex);
+	CBMutexUnlock(CBThreadPoolMutex);
+}
+void CBThreadPoolRunItems(CBThreadPoolJob * job){
+	for (int item; (item = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->itemNum;)
+		job->process(job->object, item);
+}
+void CBThreadPoolWorkerLoop(void * unused){
+	UNUSED(unused);
+	CBMutexLock(CBThreadPoolMutex);
+	for (;;) {
+		// Find a job which can take another thread.
+		CBThreadPoolJob * job;
+		for (;;) {
+			for (job = CBThreadPoolJobs; job && job->running == job->threads; job = job->nextJob);
+			if (job)
+				break;
+			CBConditionWait(CBThreadPoolWorkCond, CBThreadPoolMutex);
+		}
+		job->running++;
+		CBMutexUnlock(CBThreadPoolMutex);
+		CBThreadPoolRunItems(job);
+		CBMutexLock(CBThreadPoolMutex);
+		// No items are left, so the job is not given to other threads.
+		CBThreadPoolRemoveJob(job);
+		if (--job->running == 0)
+			CBConditionBroadcast(CBThreadPoolDoneCond);
+	}
+}
 void CBThreadPoolQueueAdd(CBThreadPoolQueue * self, CBQueueItem * item){
 	item->next = NULL;
 	item->active = false;
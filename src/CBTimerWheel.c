@@ -0,0 +1,96 @@
+//
+//  CBTimerWheel.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+//  SEE HEADER FILE FOR DOCUMENTATION
+
+#include "CBTimerWheel.h"
+
+//  Initialisers
+
+void CBInitTimerWheel(CBTimerWheel * self, int tickTime, int64_t time, void (*onExpire)(void *, CBTimerWheelEntry *), void * arg){
+	for (int x = 0; x < CB_TIMER_WHEEL_SLOTS; x++)
+		self->slots[x].next = self->slots[x].prev = &self->slots[x];
+	self->tick = 0;
+	self->startTime = time;
+	self->tickTime = tickTime;
+	self->onExpire = onExpire;
+	self->arg = arg;
+}
+void CBInitTimerWheelEntry(CBTimerWheelEntry * entry, void * owner){
+	entry->next = NULL;
+	entry->owner = owner;
+}
+
+//  Functions
+
+void CBTimerWheelAdvance(CBTimerWheel * self, int64_t time){
+	if (time < self->startTime)
+		return;
+	uint64_t target = (time - self->startTime) / self->tickTime;
+	while (self->tick < target) {
+		self->tick++;
+		CBTimerWheelEntry * slot = &self->slots[self->tick & (CB_TIMER_WHEEL_SLOTS - 1)];
+		if (slot->next == slot)
+			continue;
+		// Move the entries into a list of their own, so that the callbacks can change the wheel. Entries removed by the callbacks are unlinked from this list.
+		CBTimerWheelEntry due;
+		due.next = slot->next;
+		due.prev = slot->prev;
+		due.next->prev = &due;
+		due.prev->next = &due;
+		slot->next = slot->prev = slot;
+		while (due.next != &due) {
+			CBTimerWheelEntry * entry = due.next;
+			CBTimerWheelRemove(entry);
+			if (entry->deadline > self->tick)
+				// The deadline was extended or is further than one revolution, so move the entry on.
+				CBTimerWheelInsert(self, entry);
+			else
+				self->onExpire(self->arg, entry);
+		}
+	}
+}
+void CBTimerWheelInsert(CBTimerWheel * self, CBTimerWheelEntry * entry){
+	// The slot for the current tick has been processed, so the furthest slot is one before it.
+	uint64_t furthest = self->tick + CB_TIMER_WHEEL_SLOTS - 1;
+	entry->slotTick = entry->deadline < furthest ? entry->deadline : furthest;
+	CBTimerWheelEntry * slot = &self->slots[entry->slotTick & (CB_TIMER_WHEEL_SLOTS - 1)];
+	entry->next = slot;
+	entry->prev = slot->prev;
+	slot->prev->next = entry;
+	slot->prev = entry;
+}
+bool CBTimerWheelIsPending(CBTimerWheelEntry * entry){
+	return entry->next != NULL;
+}
+void CBTimerWheelRemove(CBTimerWheelEntry * entry){
+	if (! entry->next)
+		return;
+	entry->prev->next = entry->next;
+	entry->next->prev = entry->prev;
+	entry->next = NULL;
+}
+void CBTimerWheelSet(CBTimerWheel * self, CBTimerWheelEntry * entry, int timeout){
+	if (! timeout) {
+		CBTimerWheelRemove(entry);
+		return;
+	}
+	// Count from the end of the current tick, as part of it may have passed.
+	entry->deadline = self->tick + 1 + (timeout + self->tickTime - 1) / self->tickTime;
+	if (entry->next && entry->deadline >= entry->slotTick)
+		// The entry is in a slot which is reached before the deadline, so it is moved on from there.
+		return;
+	CBTimerWheelRemove(entry);
+	CBTimerWheelInsert(self, entry);
+}
@@ -15,14 +15,27 @@
 //  SEE HEADER FILE FOR DOCUMENTATION
 
 #include "CBTransaction.h"
+#include "CBCursor.h"
 #include <stdio.h>
 #include <assert.h>
 
+CBPool CBTransactionPool = CB_POOL_INIT(CBTransaction, CB_POOL_CACHE_TRANSACTION);
+
+struct CBTransactionSignAllJob{
+	CBTransaction * tx;
+	CBTransactionInputSigner * signers;
+	CBTransactionSigHashParts parts;
+	unsigned char (*sigs)[CB_MAX_DER_SIG_SIZE]; // The signatures for all inputs, by the key order of each input.
+	int * sigLens;
+	int * firstSig; // The index of the first signature of each input in sigs.
+	bool failed; // Set by any of the threads of the pool.
+};
+
 //  Constructor
 
 CBTransaction * CBNewTransaction(int lockTime, int version) {
 	
-	CBTransaction * self = malloc(sizeof(*self));
+	CBTransaction * self = CBAllocObject(&CBTransactionPool);
 	CBGetObject(self)->free = CBFreeTransaction;
 	CBInitTransaction(self, lockTime, version);
 	
@@ -32,7 +45,7 @@ CBTransaction * CBNewTransaction(int lockTime, int version) {
 
 CBTransaction * CBNewTransactionFromData(CBByteArray * bytes) {
 	
-	CBTransaction * self = malloc(sizeof(*self));
+	CBTransaction * self = CBAllocObject(&CBTransactionPool);
 	CBGetObject(self)->free = CBFreeTransaction;
 	CBInitTransactionFromData(self, bytes);
 	
@@ -88,7 +101,14 @@ void CBDestroyTransaction(void * vself) {
 void CBFreeTransaction(void * self) {
 	
 	CBDestroyTransaction(self);
-	free(self);
+	CBFreeObjectMemory(self, &CBTransactionPool);
+	
+}
+
+void CBFreeTransactionSigHashParts(CBTransactionSigHashParts * parts) {
+	
+	free(parts->inputs);
+	free(parts->outputs);
 	
 }
 
@@ -182,28 +202,32 @@ int CBTransactionDeserialise(CBTransaction * self) {
 		return CB_DESERIALISE_ERROR;
 	}
 	
-	self->version = CBByteArrayReadInt32(bytes, 0);
+	CBCursor cursor;
+	CBInitCursor(&cursor, bytes);
+	self->version = CBCursorReadInt32(&cursor);
 	
-	CBVarInt inputOutputLen = CBByteArrayReadVarInt(bytes, 4);
-	if (! inputOutputLen.val
-		|| inputOutputLen.val * 41 > bytes->length - 10) {
+	CBVarInt inputOutputLen;
+	if (! CBCursorReadVarInt(&cursor, &inputOutputLen)
+		|| inputOutputLen.val < 1
+		|| inputOutputLen.val > (bytes->length - 10) / 41) {
 		CBLogError("Attempting to deserialise a CBTransaction with a bad var int for the number of inputs.");
 		return CB_DESERIALISE_ERROR;
 	}
 	
-	int cursor = 4 + inputOutputLen.size;
-	
 	self->inputNum = (int)inputOutputLen.val;
 	self->inputs = malloc(sizeof(*self->inputs) * self->inputNum);
 	
 	for (int x = 0; x < self->inputNum; x++) {
 		
-		CBByteArray * data = CBByteArraySubReference(bytes, cursor, bytes->length-cursor);
+		CBByteArray * data = CBByteArraySubReference(bytes, cursor.offset, bytes->length - cursor.offset);
 		CBTransactionInput * input = CBNewTransactionInputFromData(data);
 		int len = CBTransactionInputDeserialise(input);
 		if (len == CB_DESERIALISE_ERROR){
 			CBLogError("CBTransaction cannot be deserialised because of an error with the input number %u.", x);
 			CBReleaseObject(data);
+			CBReleaseObject(input);
+			// Only release the inputs which were deserialised
+			self->inputNum = x;
 			return CB_DESERIALISE_ERROR;
 		}
 		
@@ -213,36 +237,36 @@ int CBTransactionDeserialise(CBTransaction * self) {
 		self->inputs[x] = input;
 		
 		// Move along to next input
-		cursor += len;
+		CBCursorSkip(&cursor, len);
 	}
 	
 	// Needs at least 5 more for the output CBVarInt and the lockTime
-	if (bytes->length < cursor + 5) {
+	if (! CBCursorHas(&cursor, 5)) {
 		CBLogError("Attempting to deserialise a CBTransaction with not enough bytes for the outputs and lockTime.");
 		return CB_DESERIALISE_ERROR;
 	}
 	
-	inputOutputLen = CBByteArrayReadVarInt(bytes, cursor);
-	if (inputOutputLen.val == 0
-		|| inputOutputLen.val * 9 > bytes->length - 10) {
+	if (! CBCursorReadVarInt(&cursor, &inputOutputLen)
+		|| inputOutputLen.val < 1
+		|| inputOutputLen.val > (bytes->length - 10) / 9) {
 		CBLogError("Attempting to deserialise a CBTransaction with a bad var int for the number of outputs.");
 		return CB_DESERIALISE_ERROR;
 	}
 	
-	// Move past output CBVarInt
-	cursor += inputOutputLen.size;
-	
 	self->outputNum = (int)inputOutputLen.val;
 	self->outputs = malloc(sizeof(*self->outputs) * self->outputNum);
 	
 	for (int x = 0; x < self->outputNum; x++) {
 		
-		CBByteArray * data = CBByteArraySubReference(bytes, cursor, bytes->length-cursor);
+		CBByteArray * data = CBByteArraySubReference(bytes, cursor.offset, bytes->length - cursor.offset);
 		CBTransactionOutput * output = CBNewTransactionOutputFromData(data);
 		int len = CBTransactionOutputDeserialise(output);
 		if (len == CB_DESERIALISE_ERROR){
 			CBLogError("CBTransaction cannot be deserialised because of an error with the output number %u.", x);
 			CBReleaseObject(data);
+			CBReleaseObject(output);
+			// Only release the outputs which were deserialised
+			self->outputNum = x;
 			return CB_DESERIALISE_ERROR;
 		}
 		
@@ -252,18 +276,18 @@ int CBTransactionDeserialise(CBTransaction * self) {
 		self->outputs[x] = output;
 		
 		// Move along to next output
-		cursor += len; 
+		CBCursorSkip(&cursor, len);
 	}
 	
 	// Ensure 4 bytes are available for lockTime
-	if (bytes->length < cursor + 4) {
+	if (! CBCursorHas(&cursor, 4)) {
 		CBLogError("Attempting to deserialise a CBTransaction with not enough bytes for the lockTime.");
 		return CB_DESERIALISE_ERROR;
 	}
 	
-	self->lockTime = CBByteArrayReadInt32(bytes, cursor);
+	self->lockTime = CBCursorReadInt32(&cursor);
 	
-	return cursor + 4;
+	return cursor.offset;
 	
 }
 
@@ -280,7 +304,6 @@ unsigned char * CBTransactionGetHash(CBTransaction * self) {
 
 bool CBTransactionGetInputHashForSignature(void * vself, CBByteArray * prevOutSubScript, int input, CBSignType signType, unsigned char * hash) {
 	
-	int cursor;
 	CBTransaction * self = vself;
 	
 	if (self->inputNum < input + 1)
@@ -288,161 +311,223 @@ bool CBTransactionGetInputHashForSignature(void * vself, CBByteArray * prevOutSu
 	
 	int last5Bits = (signType & 0x1f);
 	
-	CBVarInt prevOutputSubScriptVarInt = CBVarIntFromUInt64(prevOutSubScript->length);
-	
-	// Version, lock time and the sign type make up 12 bytes.
-	int sizeOfData = 12 + prevOutSubScript->length + prevOutputSubScriptVarInt.size;
-	
-	if (signType & CB_SIGHASH_ANYONECANPAY)
-		// Just this one input. 32 bytes for outPointerHash, 4 for outPointerIndex, 4 for sequence and one for the *inputNum* var int
-		sizeOfData += 41;
-	else
-		// All inputs with 1 byte var int except one.
-		sizeOfData += CBVarIntSizeOf(self->inputNum) + self->inputNum * 41 - 1;
-	
-	if (last5Bits == CB_SIGHASH_NONE)
-		// Just for the CBVarInt and no outputs.
-		sizeOfData++;
+	if (last5Bits == CB_SIGHASH_SINGLE && self->outputNum < input + 1)
+		return false;
 	
-	else if ((signType & 0x1f) == CB_SIGHASH_SINGLE) {
-		
-		if (self->outputNum < input + 1)
-			return false;
-		
-		// For outputs up to the input index
-		sizeOfData += CBVarIntSizeOf(input + 1) + input * 9;
-		
-		// The size for the output at the input index.
-		int len = CBGetByteArray(self->outputs[input]->scriptObject)->length;
-		sizeOfData += 8 + CBVarIntSizeOf(len) + len;
-		
-	}else{
-		
-		// All outputs. Default to SIGHASH_ALL
-		sizeOfData += CBVarIntSizeOf(self->outputNum);
-		
-		for (int x = 0; x < self->outputNum; x++) {
-			int len = CBGetByteArray(self->outputs[x]->scriptObject)->length;
-			sizeOfData += 8 + CBVarIntSizeOf(len) + len;
-		}
-		
-	}
+	// Hash the data straight from the transaction objects. buf is used for integers.
+	CBSha256Context ctx;
+	unsigned char buf[9];
+	CBVarInt varInt;
 	
-	CBByteArray * data = CBNewByteArrayOfSize(sizeOfData);
+	CBSha256Init(&ctx);
 	
-	CBByteArraySetInt32(data, 0, self->version);
+	CBInt32ToArray(buf, 0, self->version);
+	CBSha256Update(&ctx, buf, 4);
 	
-	// Copy input data. Scripts are not copied for the inputs.
+	// Hash input data. Scripts are not hashed for the inputs.
 	if (signType & CB_SIGHASH_ANYONECANPAY) {
 		
-		CBByteArraySetVarInt(data, 4, CBVarIntFromUInt64(1)); // Only the input the signature is for.
-		CBByteArrayCopyByteArray(data, 5, self->inputs[input]->prevOut.hash);
-		CBByteArraySetInt32(data, 37, self->inputs[input]->prevOut.index);
+		buf[0] = 1; // Only the input the signature is for.
+		CBSha256Update(&ctx, buf, 1);
+		CBSha256Update(&ctx, CBByteArrayGetData(self->inputs[input]->prevOut.hash), 32);
+		CBInt32ToArray(buf, 0, self->inputs[input]->prevOut.index);
+		CBSha256Update(&ctx, buf, 4);
 		
 		// Add prevOutSubScript
-		CBByteArraySetVarInt(data, 41, prevOutputSubScriptVarInt);
-		cursor = 41 + prevOutputSubScriptVarInt.size;
-		CBByteArrayCopyByteArray(data, cursor, prevOutSubScript);
-		cursor += prevOutSubScript->length;
-		CBByteArraySetInt32(data, cursor, self->inputs[input]->sequence);
-		cursor += 4;
+		varInt = CBVarIntFromUInt64(prevOutSubScript->length);
+		CBByteArraySetVarIntData(buf, 0, varInt);
+		CBSha256Update(&ctx, buf, varInt.size);
+		CBSha256Update(&ctx, CBByteArrayGetData(prevOutSubScript), prevOutSubScript->length);
+		
+		CBInt32ToArray(buf, 0, self->inputs[input]->sequence);
+		CBSha256Update(&ctx, buf, 4);
 		
 	}else{
 		
-		CBVarInt inputNum = CBVarIntFromUInt64(self->inputNum);
-		CBByteArraySetVarInt(data, 4, inputNum);
-		cursor = 4 + inputNum.size;
+		varInt = CBVarIntFromUInt64(self->inputNum);
+		CBByteArraySetVarIntData(buf, 0, varInt);
+		CBSha256Update(&ctx, buf, varInt.size);
 		
 		for (int x = 0; x < self->inputNum; x++) {
 			
-			CBByteArrayCopyByteArray(data, cursor, self->inputs[x]->prevOut.hash);
-			cursor += 32;
-			CBByteArraySetInt32(data, cursor, self->inputs[x]->prevOut.index);
-			cursor += 4;
+			CBSha256Update(&ctx, CBByteArrayGetData(self->inputs[x]->prevOut.hash), 32);
+			CBInt32ToArray(buf, 0, self->inputs[x]->prevOut.index);
+			CBSha256Update(&ctx, buf, 4);
 			
 			// Add prevOutSubScript if the input is for the signature.
 			if (x == input) {
-				CBByteArraySetVarInt(data, cursor, prevOutputSubScriptVarInt);
-				cursor += prevOutputSubScriptVarInt.size;
-				CBByteArrayCopyByteArray(data, cursor, prevOutSubScript);
-				cursor += prevOutSubScript->length;
+				varInt = CBVarIntFromUInt64(prevOutSubScript->length);
+				CBByteArraySetVarIntData(buf, 0, varInt);
+				CBSha256Update(&ctx, buf, varInt.size);
+				CBSha256Update(&ctx, CBByteArrayGetData(prevOutSubScript), prevOutSubScript->length);
 			}else{
-				CBByteArraySetVarInt(data, cursor, CBVarIntFromUInt64(0));
-				cursor++;
+				buf[0] = 0;
+				CBSha256Update(&ctx, buf, 1);
 			}
 			
-			if ((signType == CB_SIGHASH_NONE || signType == CB_SIGHASH_SINGLE) && x != input)
-				CBByteArraySetInt32(data, cursor, 0);
-			else
+			if ((signType == CB_SIGHASH_NONE || signType == CB_SIGHASH_SINGLE) && x != input){
+				CBInt32ToArray(buf, 0, 0);
+			}else{
 				// SIGHASH_ALL or input index for signing sequence
-				CBByteArraySetInt32(data, cursor, self->inputs[x]->sequence);
-			cursor += 4;
+				CBInt32ToArray(buf, 0, self->inputs[x]->sequence);
+			}
+			CBSha256Update(&ctx, buf, 4);
+			
 		}
 	}
 	
-	// Copy output data
+	// Hash output data
 	if (last5Bits == CB_SIGHASH_NONE) {
 		
-		CBVarInt varInt = CBVarIntFromUInt64(0);
-		CBByteArraySetVarInt(data, cursor, varInt);
-		cursor++;
+		buf[0] = 0;
+		CBSha256Update(&ctx, buf, 1);
 		
-	}else if (last5Bits == CB_SIGHASH_SINGLE) {
-		
-		CBVarInt varInt = CBVarIntFromUInt64(input + 1);
-		CBByteArraySetVarInt(data, cursor, varInt);
-		cursor += varInt.size;
-		
-		for (int x = 0; x < input; x++) {
-			CBByteArraySetInt64(data, cursor, CB_OUTPUT_VALUE_MINUS_ONE);
-			cursor += 8;
-			CBByteArraySetVarInt(data, cursor, CBVarIntFromUInt64(0));
-			cursor++;
-		}
-		
-		CBByteArraySetInt64(data, cursor, self->outputs[input]->value);
-		cursor += 8;
-		varInt = CBVarIntFromUInt64(CBGetByteArray(self->outputs[input]->scriptObject)->length);
-		CBByteArraySetVarInt(data, cursor, varInt);
-		cursor += varInt.size;
-		CBByteArrayCopyByteArray(data, cursor, CBGetByteArray(self->outputs[input]->scriptObject));
-		cursor += varInt.val;
+	}else{
 		
-	}else{ // SIGHASH_ALL
+		// For SIGHASH_SINGLE hash outputs up to the input index. Otherwise default to SIGHASH_ALL.
+		int outputNum = (last5Bits == CB_SIGHASH_SINGLE) ? input + 1 : self->outputNum;
 		
-		CBVarInt varInt = CBVarIntFromUInt64(self->outputNum);
-		CBByteArraySetVarInt(data, cursor, varInt);
-		cursor += varInt.size;
+		varInt = CBVarIntFromUInt64(outputNum);
+		CBByteArraySetVarIntData(buf, 0, varInt);
+		CBSha256Update(&ctx, buf, varInt.size);
 		
-		for (int x = 0; x < self->outputNum; x++) {
-			CBByteArraySetInt64(data, cursor, self->outputs[x]->value);
-			cursor += 8;
-			varInt = CBVarIntFromUInt64(CBGetByteArray(self->outputs[x]->scriptObject)->length);
-			CBByteArraySetVarInt(data, cursor, varInt);
-			cursor += varInt.size;
-			CBByteArrayCopyByteArray(data, cursor, CBGetByteArray(self->outputs[x]->scriptObject));
-			cursor += varInt.val;
+		for (int x = 0; x < outputNum; x++) {
+			
+			if (last5Bits == CB_SIGHASH_SINGLE && x != input) {
+				CBInt64ToArray(buf, 0, CB_OUTPUT_VALUE_MINUS_ONE);
+				buf[8] = 0;
+				CBSha256Update(&ctx, buf, 9);
+				continue;
+			}
+			
+			CBByteArray * script = CBGetByteArray(self->outputs[x]->scriptObject);
+			CBInt64ToArray(buf, 0, self->outputs[x]->value);
+			CBSha256Update(&ctx, buf, 8);
+			varInt = CBVarIntFromUInt64(script->length);
+			CBByteArraySetVarIntData(buf, 0, varInt);
+			CBSha256Update(&ctx, buf, varInt.size);
+			CBSha256Update(&ctx, CBByteArrayGetData(script), script->length);
+			
 		}
 		
 	}
 	
-	// Set lockTime and sign type
-	CBByteArraySetInt32(data, cursor, self->lockTime);
-	CBByteArraySetInt32(data, cursor + 4, signType);
+	// Hash lockTime and sign type
+	CBInt32ToArray(buf, 0, self->lockTime);
+	CBInt32ToArray(buf, 4, signType);
+	CBSha256Update(&ctx, buf, 8);
+	
+	// Now hash the hash
+	unsigned char firstHash[32];
+	CBSha256Final(&ctx, firstHash);
+	CBSha256(firstHash, 32, hash);
+	
+	return true;
+	
+}
+
+bool CBTransactionGetInputHashForSignatureFromParts(CBTransaction * self, CBTransactionSigHashParts * parts, CBByteArray * prevOutSubScript, int input, CBSignType signType, unsigned char * hash) {
+	
+	int last5Bits = (signType & 0x1f);
+	
+	// Only signatures covering all outputs and the sequence of all inputs can use the parts.
+	if (last5Bits == CB_SIGHASH_NONE || last5Bits == CB_SIGHASH_SINGLE)
+		return CBTransactionGetInputHashForSignature(self, prevOutSubScript, input, signType, hash);
+	
+	if (self->inputNum < input + 1)
+		return false;
+	
+	int inputOffset = CBVarIntSizeOf(self->inputNum) + input * 41;
+	
+	CBSha256Context ctx;
+	unsigned char buf[9];
+	
+	CBSha256Init(&ctx);
 	
-	// Must always be like this
-	assert(sizeOfData == cursor + 8);
+	CBInt32ToArray(buf, 0, self->version);
+	CBSha256Update(&ctx, buf, 4);
 	
-	// Now hash the data
+	// Hash the input data up to the script of the input being signed
+	if (signType & CB_SIGHASH_ANYONECANPAY) {
+		buf[0] = 1;
+		CBSha256Update(&ctx, buf, 1);
+		CBSha256Update(&ctx, parts->inputs + inputOffset, 36);
+	}else
+		CBSha256Update(&ctx, parts->inputs, inputOffset + 36);
+	
+	// Add prevOutSubScript in place of the empty script
+	CBVarInt varInt = CBVarIntFromUInt64(prevOutSubScript->length);
+	CBByteArraySetVarIntData(buf, 0, varInt);
+	CBSha256Update(&ctx, buf, varInt.size);
+	CBSha256Update(&ctx, CBByteArrayGetData(prevOutSubScript), prevOutSubScript->length);
+	
+	// Hash the rest of the input data
+	if (signType & CB_SIGHASH_ANYONECANPAY)
+		CBSha256Update(&ctx, parts->inputs + inputOffset + 37, 4);
+	else
+		CBSha256Update(&ctx, parts->inputs + inputOffset + 37, parts->inputsLen - inputOffset - 37);
+	
+	// Hash output data
+	CBSha256Update(&ctx, parts->outputs, parts->outputsLen);
+	
+	// Hash lockTime and sign type
+	CBInt32ToArray(buf, 0, self->lockTime);
+	CBInt32ToArray(buf, 4, signType);
+	CBSha256Update(&ctx, buf, 8);
+	
+	// Now hash the hash
 	unsigned char firstHash[32];
-	CBSha256(CBByteArrayGetData(data), sizeOfData, firstHash);
+	CBSha256Final(&ctx, firstHash);
 	CBSha256(firstHash, 32, hash);
-	CBReleaseObject(data);
 	
 	return true;
 	
 }
 
+void CBTransactionGetSigHashParts(CBTransaction * self, CBTransactionSigHashParts * parts) {
+	
+	// Serialise all inputs with empty scripts
+	CBVarInt varInt = CBVarIntFromUInt64(self->inputNum);
+	parts->inputsLen = varInt.size + self->inputNum * 41;
+	parts->inputs = malloc(parts->inputsLen);
+	
+	CBByteArraySetVarIntData(parts->inputs, 0, varInt);
+	int cursor = varInt.size;
+	
+	for (int x = 0; x < self->inputNum; x++) {
+		memcpy(parts->inputs + cursor, CBByteArrayGetData(self->inputs[x]->prevOut.hash), 32);
+		CBInt32ToArray(parts->inputs, cursor + 32, self->inputs[x]->prevOut.index);
+		parts->inputs[cursor + 36] = 0;
+		CBInt32ToArray(parts->inputs, cursor + 37, self->inputs[x]->sequence);
+		cursor += 41;
+	}
+	
+	// Serialise all outputs
+	varInt = CBVarIntFromUInt64(self->outputNum);
+	parts->outputsLen = varInt.size;
+	
+	for (int x = 0; x < self->outputNum; x++) {
+		int len = CBGetByteArray(self->outputs[x]->scriptObject)->length;
+		parts->outputsLen += 8 + CBVarIntSizeOf(len) + len;
+	}
+	
+	parts->outputs = malloc(parts->outputsLen);
+	CBByteArraySetVarIntData(parts->outputs, 0, varInt);
+	cursor = varInt.size;
+	
+	for (int x = 0; x < self->outputNum; x++) {
+		CBByteArray * script = CBGetByteArray(self->outputs[x]->scriptObject);
+		CBInt64ToArray(parts->outputs, cursor, self->outputs[x]->value);
+		cursor += 8;
+		varInt = CBVarIntFromUInt64(script->length);
+		CBByteArraySetVarIntData(parts->outputs, cursor, varInt);
+		cursor += varInt.size;
+		memcpy(parts->outputs + cursor, CBByteArrayGetData(script), script->length);
+		cursor += script->length;
+	}
+	
+}
+
 void CBTransactionHashToString(CBTransaction * self, char output[CB_TX_HASH_STR_SIZE]) {
 	
 	unsigned char * hash = CBTransactionGetHash(self);
@@ -663,6 +748,189 @@ int CBTransactionSerialise(CBTransaction * self, bool force) {
 	
 }
 
+bool CBTransactionSignAll(CBTransaction * self, bool (*keyring)(void * keyringObj, int input, CBTransactionInputSigner * signer), void * keyringObj, int numThreads) {
+	
+	CBTransactionSignAllJob job;
+	job.tx = self;
+	job.failed = false;
+	job.signers = malloc(sizeof(*job.signers) * self->inputNum);
+	job.firstSig = malloc(sizeof(*job.firstSig) * self->inputNum);
+	job.sigs = NULL;
+	job.sigLens = NULL;
+	
+	// Ask the keyring how to sign each input
+	int sigNum = 0;
+	int signNum = 0;
+	
+	for (int x = 0; x < self->inputNum; x++) {
+		
+		CBTransactionInputSigner * signer = job.signers + x;
+		signer->keyNum = 0;
+		signer->p2shScript = NULL;
+		
+		if (!keyring(keyringObj, x, signer)) {
+			CBLogError("The keyring failed to give the signing information for input number %i.", x);
+			job.failed = true;
+			break;
+		}
+		
+		if (signer->keyNum
+			&& signer->type != CB_TX_OUTPUT_TYPE_MULTISIG
+			&& (signer->keyNum != 1 || (signer->type != CB_TX_OUTPUT_TYPE_KEYHASH && signer->type != CB_TX_OUTPUT_TYPE_PUBKEY))) {
+			CBLogError("Cannot sign input number %i with %i keys for the output type %i.", x, signer->keyNum, signer->type);
+			job.failed = true;
+			break;
+		}
+		
+		job.firstSig[x] = sigNum;
+		sigNum += signer->keyNum;
+		if (signer->keyNum)
+			signNum++;
+		
+	}
+	
+	if (!job.failed) {
+		
+		job.sigs = malloc(sizeof(*job.sigs) * sigNum);
+		job.sigLens = malloc(sizeof(*job.sigLens) * sigNum);
+		
+		// Serialise the signature hash data which is shared by all the inputs.
+		CBTransactionGetSigHashParts(self, &job.parts);
+		
+		// Produce the signatures
+		if (numThreads < 1)
+			numThreads = CBGetNumberOfCores();
+		if (numThreads > signNum)
+			numThreads = signNum;
+		
+		CBThreadPoolRun(CBTransactionSignAllProcess, &job, self->inputNum, numThreads);
+		
+		CBFreeTransactionSigHashParts(&job.parts);
+		
+		if (__atomic_load_n(&job.failed, __ATOMIC_RELAXED))
+			CBLogError("Unable to produce the signatures for a transaction.");
+		
+	}
+	
+	if (!job.failed && signNum) {
+		
+		// Find the length of all the input scripts
+		int scriptsLen = 0;
+		int * scriptLens = malloc(sizeof(*scriptLens) * self->inputNum);
+		
+		for (int x = 0; x < self->inputNum; x++) {
+			
+			CBTransactionInputSigner * signer = job.signers + x;
+			scriptLens[x] = 0;
+			
+			for (int y = 0; y < signer->keyNum; y++) {
+				// Signature with the sign type.
+				int len = job.sigLens[job.firstSig[x] + y] + 1;
+				scriptLens[x] += CBScriptGetLengthOfPushOp(len) + len;
+			}
+			
+			if (signer->keyNum) {
+				if (signer->type == CB_TX_OUTPUT_TYPE_KEYHASH)
+					scriptLens[x] += CBScriptGetLengthOfPushOp(CB_PUBKEY_SIZE) + CB_PUBKEY_SIZE;
+				else if (signer->type == CB_TX_OUTPUT_TYPE_MULTISIG)
+					// OP_0 for the extra value taken by OP_CHECKMULTISIG
+					scriptLens[x]++;
+				if (signer->p2shScript)
+					scriptLens[x] += CBScriptGetLengthOfPushOp(signer->p2shScript->length) + signer->p2shScript->length;
+			}
+			
+			scriptsLen += scriptLens[x];
+			
+		}
+		
+		// Write all of the scripts into one byte array, with each input referencing its part.
+		CBByteArray * scripts = CBNewByteArrayOfSize(scriptsLen);
+		int cursor = 0;
+		
+		for (int x = 0; x < self->inputNum; x++) {
+			
+			CBTransactionInputSigner * signer = job.signers + x;
+			if (!signer->keyNum)
+				continue;
+			
+			CBScript * inScript = CBByteArraySubReference(scripts, cursor, scriptLens[x]);
+			int offset = 0;
+			
+			if (signer->type == CB_TX_OUTPUT_TYPE_MULTISIG)
+				CBByteArraySetByte(inScript, offset++, CB_SCRIPT_OP_0);
+			
+			for (int y = 0; y < signer->keyNum; y++) {
+				int sig = job.firstSig[x] + y;
+				// Add the sign type after the signature
+				job.sigs[sig][job.sigLens[sig]] = signer->signType;
+				CBScriptWritePushOp(inScript, offset, job.sigs[sig], job.sigLens[sig] + 1);
+				offset += CBScriptGetLengthOfPushOp(job.sigLens[sig] + 1) + job.sigLens[sig] + 1;
+			}
+			
+			if (signer->type == CB_TX_OUTPUT_TYPE_KEYHASH) {
+				CBScriptWritePushOp(inScript, offset, signer->keys[0]->pubkey.key, CB_PUBKEY_SIZE);
+				offset += CBScriptGetLengthOfPushOp(CB_PUBKEY_SIZE) + CB_PUBKEY_SIZE;
+			}
+			
+			if (signer->p2shScript)
+				CBScriptWritePushOp(inScript, offset, CBByteArrayGetData(signer->p2shScript), signer->p2shScript->length);
+			
+			if (self->inputs[x]->scriptObject)
+				CBReleaseObject(self->inputs[x]->scriptObject);
+			self->inputs[x]->scriptObject = inScript;
+			
+			cursor += scriptLens[x];
+			
+		}
+		
+		CBReleaseObject(scripts);
+		free(scriptLens);
+		
+	}
+	
+	free(job.signers);
+	free(job.firstSig);
+	free(job.sigs);
+	free(job.sigLens);
+	
+	return !job.failed;
+	
+}
+
+bool CBTransactionSignAllInput(CBTransactionSignAllJob * job, int input) {
+	
+	CBTransactionInputSigner * signer = job->signers + input;
+	
+	// Obtain the signature hash
+	unsigned char hash[32];
+	if (!CBTransactionGetInputHashForSignatureFromParts(job->tx, &job->parts, signer->prevOutSubScript, input, signer->signType, hash)) {
+		CBLogError("Unable to obtain a hash for producing the signatures of input number %i.", input);
+		return false;
+	}
+	
+	// Produce a signature for each key
+	for (int x = 0; x < signer->keyNum; x++) {
+		int sig = job->firstSig[input] + x;
+		job->sigLens[sig] = CBKeySign(signer->keys[x]->privkey, hash, job->sigs[sig]);
+	}
+	
+	return true;
+	
+}
+
+void CBTransactionSignAllProcess(void * vjob, int input) {
+	
+	CBTransactionSignAllJob * job = vjob;
+	
+	// Inputs without keys are not signed, and no more are signed after a failure.
+	if (!job->signers[input].keyNum || __atomic_load_n(&job->failed, __ATOMIC_RELAXED))
+		return;
+	
+	if (!CBTransactionSignAllInput(job, input))
+		__atomic_store_n(&job->failed, true, __ATOMIC_RELAXED);
+	
+}
+
 bool CBTransactionSignMultisigInput(CBTransaction * self, CBKeyPair * key, CBByteArray * prevOutSubScript, int input, CBSignType signType) {
 	
 	CBScript * inScript;
@@ -15,12 +15,15 @@
 //  SEE HEADER FILE FOR DOCUMENTATION
 
 #include "CBTransactionInput.h"
+#include "CBCursor.h"
+
+CBPool CBTransactionInputPool = CB_POOL_INIT(CBTransactionInput, CB_POOL_CACHE_TRANSACTION_INPUT);
 
 //  Constructors
 
 CBTransactionInput * CBNewTransactionInput(CBScript * script, int sequence, CBByteArray * prevOutHash, int prevOutIndex) {
 	
-	CBTransactionInput * self = malloc(sizeof(*self));
+	CBTransactionInput * self = CBAllocObject(&CBTransactionInputPool);
 	CBGetObject(self)->free = CBFreeTransactionInput;
 	CBInitTransactionInput(self, script, sequence, prevOutHash, prevOutIndex);
 	return self;
@@ -28,7 +31,7 @@ CBTransactionInput * CBNewTransactionInput(CBScript * script, int sequence, CBBy
 }
 CBTransactionInput * CBNewTransactionInputTakeScriptAndHash(CBScript * script, int sequence, CBByteArray * prevOutHash, int prevOutIndex) {
 	
-	CBTransactionInput * self = malloc(sizeof(*self));
+	CBTransactionInput * self = CBAllocObject(&CBTransactionInputPool);
 	CBGetObject(self)->free = CBFreeTransactionInput;
 	CBInitTransactionInputTakeScriptAndHash(self, script, sequence, prevOutHash, prevOutIndex);
 	return self;
@@ -37,7 +40,7 @@ CBTransactionInput * CBNewTransactionInputTakeScriptAndHash(CBScript * script, i
 
 CBTransactionInput * CBNewTransactionInputFromData(CBByteArray * data) {
 	
-	CBTransactionInput * self = malloc(sizeof(*self));
+	CBTransactionInput * self = CBAllocObject(&CBTransactionInputPool);
 	CBGetObject(self)->free = CBFreeTransactionInput;
 	CBInitTransactionInputFromData(self, data);
 	return self;
@@ -87,7 +90,7 @@ void CBDestroyTransactionInput(void * vself) {
 void CBFreeTransactionInput(void * self) {
 	
 	CBDestroyTransactionInput(self);
-	free(self);
+	CBFreeObjectMemory(self, &CBTransactionInputPool);
 	
 }
 
@@ -111,8 +114,17 @@ int CBTransactionInputDeserialise(CBTransactionInput * self) {
 		return CB_DESERIALISE_ERROR;
 	}
 	
-	CBVarInt scriptLen = CBByteArrayReadVarInt(bytes, 36);
-	if (scriptLen.val > 10000) {
+	CBCursor cursor;
+	CBInitCursor(&cursor, bytes);
+	CBCursorSkip(&cursor, 32);
+	self->prevOut.index = CBCursorReadInt32(&cursor);
+	
+	CBVarInt scriptLen;
+	if (! CBCursorReadVarInt(&cursor, &scriptLen)) {
+		CBLogError("Attempting to deserialise a CBTransactionInput with less bytes than needed for the script length var int.");
+		return CB_DESERIALISE_ERROR;
+	}
+	if (scriptLen.val < 0 || scriptLen.val > 10000) {
 		CBLogError("Attempting to deserialise a CBTransactionInput with too big a script.");
 		return CB_DESERIALISE_ERROR;
 	}
@@ -125,9 +137,9 @@ int CBTransactionInputDeserialise(CBTransactionInput * self) {
 	
 	// Deserialise by subreferencing byte arrays and reading integers.
 	self->prevOut.hash = CBByteArraySubReference(bytes, 0, 32);
-	self->prevOut.index = CBByteArrayReadInt32(bytes, 32);
-	self->scriptObject = CBNewScriptFromReference(bytes, 36 + scriptLen.size, (int) scriptLen.val);
-	self->sequence = CBByteArrayReadInt32(bytes, (int) (36 + scriptLen.size + scriptLen.val));
+	self->scriptObject = CBNewScriptFromReference(bytes, cursor.offset, (int) scriptLen.val);
+	CBCursorSkip(&cursor, (int) scriptLen.val);
+	self->sequence = CBCursorReadInt32(&cursor);
 	
 	return reqLen;
 	
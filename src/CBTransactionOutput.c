@@ -15,12 +15,15 @@
 //  SEE HEADER FILE FOR DOCUMENTATION
 
 #include "CBTransactionOutput.h"
+#include "CBCursor.h"
+
+CBPool CBTransactionOutputPool = CB_POOL_INIT(CBTransactionOutput, CB_POOL_CACHE_TRANSACTION_OUTPUT);
 
 //  Constructors
 
 CBTransactionOutput * CBNewTransactionOutput(long long int value, CBScript * script) {
 	
-	CBTransactionOutput * self = malloc(sizeof(*self));
+	CBTransactionOutput * self = CBAllocObject(&CBTransactionOutputPool);
 	CBGetObject(self)->free = CBFreeTransactionOutput;
 	CBInitTransactionOutput(self, value, script);
 	return self;
@@ -29,7 +32,7 @@ CBTransactionOutput * CBNewTransactionOutput(long long int value, CBScript * scr
 
 CBTransactionOutput * CBNewTransactionOutputTakeScript(long long int value, CBScript * script) {
 	
-	CBTransactionOutput * self = malloc(sizeof(*self));
+	CBTransactionOutput * self = CBAllocObject(&CBTransactionOutputPool);
 	CBGetObject(self)->free = CBFreeTransactionOutput;
 	CBInitTransactionOutputTakeScript(self, value, script);
 	return self;
@@ -38,7 +41,7 @@ CBTransactionOutput * CBNewTransactionOutputTakeScript(long long int value, CBSc
 
 CBTransactionOutput * CBNewTransactionOutputFromData(CBByteArray * data) {
 	
-	CBTransactionOutput * self = malloc(sizeof(*self));
+	CBTransactionOutput * self = CBAllocObject(&CBTransactionOutputPool);
 	CBGetObject(self)->free = CBFreeTransactionOutput;
 	CBInitTransactionOutputFromData(self, data);
 	return self;
@@ -84,7 +87,7 @@ void CBDestroyTransactionOutput(void * vself) {
 void CBFreeTransactionOutput(void * self) {
 	
 	CBDestroyTransactionOutput(self);
-	free(self);
+	CBFreeObjectMemory(self, &CBTransactionOutputPool);
 	
 }
 
@@ -108,23 +111,16 @@ int CBTransactionOutputDeserialise(CBTransactionOutput * self) {
 		return CB_DESERIALISE_ERROR;
 	}
 	
-	int x = CBByteArrayGetByte(bytes, 8); // Check length for decoding CBVarInt
-	if (x < 253)
-		x = 9;
-	else if (x == 253)
-		x = 11;
-	else if (x == 254)
-		x = 13;
-	else
-		x = 17;
-	
-	if (bytes->length < x) {
-		CBLogError("Attempting to deserialise a CBTransactionOutput with less than %i bytes required.", x);
+	CBCursor cursor;
+	CBInitCursor(&cursor, bytes);
+	self->value = CBCursorReadInt64(&cursor);
+	
+	CBVarInt scriptLen;
+	if (! CBCursorReadVarInt(&cursor, &scriptLen)) {
+		CBLogError("Attempting to deserialise a CBTransactionOutput with less bytes than required for the script length var int.");
 		return CB_DESERIALISE_ERROR;
 	}
-	
-	CBVarInt scriptLen = CBByteArrayReadVarInt(bytes, 8); // Can now decode.
-	if (scriptLen.val > 10000) {
+	if (scriptLen.val < 0 || scriptLen.val > 10000) {
 		CBLogError("Attempting to deserialise a CBTransactionInput with too big a script.");
 		return CB_DESERIALISE_ERROR;
 	}
@@ -136,8 +132,7 @@ int CBTransactionOutputDeserialise(CBTransactionOutput * self) {
 	}
 	
 	// Deserialise by subreferencing byte arrays and reading integers.
-	self->value = CBByteArrayReadInt64(bytes, 0);
-	self->scriptObject = CBNewScriptFromReference(bytes, 8 + scriptLen.size, (int) scriptLen.val);
+	self->scriptObject = CBNewScriptFromReference(bytes, cursor.offset, (int) scriptLen.val);
 	
 	return reqLen;
 	
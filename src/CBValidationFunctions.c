@@ -43,7 +43,9 @@ void CBCalculateBlockWork(CBBigInt * work, int target) {
 		
 		for (int y = 0; y < 4; y++) {
 			
-			work->data[i] = workSeg >> ((3 - y) * 8);
+			// With three zero bytes the first byte is past the end, and is only non-zero when the work is too large for 32 bytes.
+			if (i < 32)
+				work->data[i] = workSeg >> ((3 - y) * 8);
 			
 			if (! i) {
 				CBBigIntNormalise(work);
@@ -149,6 +151,87 @@ int CBCalculateTarget(int oldTarget, int time) {
 	
 }
 
+int CBCompactTransactionGetSigOps(CBCompactTransaction * tx) {
+	
+	int sigOps = 0;
+	
+	for (int x = 0; x < tx->inputNum; x++)
+		sigOps += CBScriptGetSigOpCountFromData(CBCompactInputScript(tx, x), tx->inputs[x].scriptLength, false);
+	
+	for (int x = 0; x < tx->outputNum; x++)
+		sigOps += CBScriptGetSigOpCountFromData(CBCompactOutputScript(tx, x), tx->outputs[x].scriptLength, false);
+	
+	return sigOps;
+	
+}
+
+bool CBCompactTransactionIsFinal(CBCompactTransaction * tx, long long int time, long long int height) {
+	
+	if (tx->lockTime) {
+		
+		if (tx->lockTime < (tx->lockTime < CB_LOCKTIME_THRESHOLD ? (int64_t)height : (int64_t)time))
+			return true;
+		
+		for (int x = 0; x < tx->inputNum; x++)
+			if (tx->inputs[x].sequence != CB_TX_INPUT_FINAL)
+				return false;
+		
+	}
+	
+	return true;
+	
+}
+
+bool CBCompactTransactionValidateBasic(CBCompactTransaction * tx, bool coinbase, long long int * outputValue) {
+	
+	if (tx->length > CB_BLOCK_MAX_SIZE)
+		return false;
+	
+	// Check that outputs do not overflow. See CBTransactionValidateBasic
+	*outputValue = 0;
+	
+	for (int x = 0; x < tx->outputNum; x++) {
+		
+		if (tx->outputs[x].value > CB_MAX_MONEY)
+			return false;
+		
+		*outputValue += tx->outputs[x].value;
+		
+		if (*outputValue > CB_MAX_MONEY)
+			return false;
+		
+	}
+	
+	if (coinbase) {
+		
+		// Validate input script for coinbase
+		if (tx->inputs[0].scriptLength < 2
+			|| tx->inputs[0].scriptLength > 100)
+			return false;
+		
+	}else for (int x = 0; x < tx->inputNum; x++) {
+		
+		// Check each input for null previous output hashes.
+		unsigned char * hash = CBCompactInputPrevOutHash(tx, x);
+		int y = 0;
+		while (y < 32 && ! hash[y])
+			y++;
+		if (y == 32)
+			return false;
+		
+	}
+	
+	// Check for duplicate transaction output spends
+	for (int x = 0; x < tx->inputNum; x++)
+		for (int y = 0; y < x; y++)
+			if (tx->inputs[y].prevOutIndex == tx->inputs[x].prevOutIndex
+				&& ! memcmp(CBCompactInputPrevOutHash(tx, y), CBCompactInputPrevOutHash(tx, x), 32))
+				return false;
+	
+	return true;
+	
+}
+
 int CBTransactionGetSigOps(CBTransaction * tx) {
 	int sigOps = 0;
 	
@@ -238,8 +321,8 @@ bool CBValidateProofOfWork(unsigned char * hash, int target) {
 	// Get trailing zero bytes
 	int zeroBytes = target >> 24;
 	
-	// Check target is less than or equal to maximum.
-	if (target > CB_MAX_TARGET)
+	// Check target is less than or equal to maximum and has enough bytes for the mantissa.
+	if (target > CB_MAX_TARGET || zeroBytes < 3)
 		return false;
 	
 	// Modify the target to the mantissa (significand).
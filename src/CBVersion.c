@@ -15,6 +15,7 @@
 //  SEE HEADER FILE FOR DOCUMENTATION 
 
 #include "CBVersion.h"
+#include "CBCursor.h"
 
 //  Constructor
 
@@ -106,9 +107,11 @@ int CBVersionDeserialise(CBVersion * self) {
 		return CB_DESERIALISE_ERROR;
 	}
 	
-	self->version = CBByteArrayReadInt32(bytes, 0);
-	self->services = (CBVersionServices) CBByteArrayReadInt64(bytes, 4);
-	self->time = CBByteArrayReadInt64(bytes, 12);
+	CBCursor cursor;
+	CBInitCursor(&cursor, bytes);
+	self->version = CBCursorReadInt32(&cursor);
+	self->services = (CBVersionServices) CBCursorReadInt64(&cursor);
+	self->time = CBCursorReadInt64(&cursor);
 	
 	// Get data from 20 bytes to the end of the byte array to deserialise the recieving network address.
 	CBByteArray * data = CBByteArraySubReference(bytes, 20, bytes->length - 20);
@@ -138,16 +141,17 @@ int CBVersionDeserialise(CBVersion * self) {
 	data->length = len;
 	CBReleaseObject(data);
 	
-	self->nonce = CBByteArrayReadInt64(bytes, 72);
+	CBCursorSkip(&cursor, 52); // Past the two network addresses
+	self->nonce = CBCursorReadInt64(&cursor);
 	
-	int x = CBByteArrayGetByte(bytes, 80); // Check length for decoding CBVarInt
-	if (x > 253){
+	if (CBCursorPointer(&cursor)[0] > 253){ // Check length for decoding CBVarInt
 		CBLogError("Attempting to deserialise a CBVersion with a var string that is too big.");
 		return CB_DESERIALISE_ERROR;
 	}
 	
-	CBVarInt varInt = CBByteArrayReadVarInt(bytes, 80);
-	if (bytes->length < 84 + varInt.size + varInt.val) {
+	CBVarInt varInt;
+	if (! CBCursorReadVarInt(&cursor, &varInt)
+		|| ! CBCursorHas(&cursor, varInt.val + 4)) {
 		CBLogError("Attempting to deserialise a CBVersion without enough space to cover the userAgent and block height.");
 		return CB_DESERIALISE_ERROR;
 	}
@@ -156,13 +160,14 @@ int CBVersionDeserialise(CBVersion * self) {
 		return CB_DESERIALISE_ERROR;
 	}
 	
-	self->userAgent = CBNewByteArraySubReference(bytes, 80 + varInt.size, (int)varInt.val);
+	self->userAgent = CBNewByteArraySubReference(bytes, cursor.offset, (int)varInt.val);
+	CBCursorSkip(&cursor, (int)varInt.val);
 	
 	// Ensure user agent uses safe characters
 	CBByteArraySanitise(self->userAgent);
 	
-	self->blockHeight = CBByteArrayReadInt32(bytes, 80 + varInt.size + (int)varInt.val);
-	return 84 + varInt.size + (int)varInt.val;
+	self->blockHeight = CBCursorReadInt32(&cursor);
+	return cursor.offset;
 }
 int CBVersionCalculateLength(CBVersion * self){
 	int len = 46; // Version, services, time and receiving address.
@@ -0,0 +1,154 @@
+//
+//  testCBAddressIndex.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stdarg.h"
+#include "CBAddressIndex.h"
+#include "CBAddress.h"
+
+#define NUM_ADDRESSES 6000
+
+void CBLogError(char * format, ...);
+void CBLogError(char * format, ...){
+	va_list argptr;
+	va_start(argptr, format);
+	vfprintf(stderr, format, argptr);
+	va_end(argptr);
+	printf("\n");
+}
+
+int main(){
+	unsigned int s = (unsigned int)time(NULL);
+	s = 1413590400;
+	printf("Session = %ui\n", s);
+	srand(s);
+	// Test the fixed decoder against CBAddress
+	unsigned char data[25];
+	CBByteArray * str = CBNewByteArrayFromString("1BvBMSEYstWetqTFn5Au4m4GFg7xJaNVN2", false);
+	CBAddress * addr = CBNewAddressFromString(str, false);
+	if (!CBDecodeBase58CheckedFixed(data, 25, "1BvBMSEYstWetqTFn5Au4m4GFg7xJaNVN2", 34)
+		|| data[0] != 0
+		|| memcmp(data + 1, CBByteArrayGetData(CBGetByteArray(addr)) + 1, 20)) {
+		printf("DECODE FIXED FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBReleaseObject(addr);
+	CBReleaseObject(str);
+	if (CBDecodeBase58CheckedFixed(data, 25, "1BvBMSEYstWetqTFn5Au4m4GFg7xJaNVN3", 34)) {
+		printf("DECODE FIXED BAD CHECKSUM FAIL\n");
+		return EXIT_FAILURE;
+	}
+	if (CBDecodeBase58CheckedFixed(data, 25, "11BvBMSEYstWetqTFn5Au4m4GFg7xJaNVN2", 35)) {
+		printf("DECODE FIXED EXTRA ZERO FAIL\n");
+		return EXIT_FAILURE;
+	}
+	if (CBDecodeBase58CheckedFixed(data, 25, "1BvBMSEYstWetqTFn5Au4m4GFg7xJaNVN0", 34)) {
+		printf("DECODE FIXED BAD CHARACTER FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Make a watch list with bad lines, duplicates, blank lines and whitespace
+	unsigned char (*hashes)[20] = malloc(sizeof(*hashes) * NUM_ADDRESSES);
+	char * text = malloc(NUM_ADDRESSES * 40);
+	size_t length = 0;
+	int badLines[NUM_ADDRESSES], badLineNum = 0, line = 1;
+	unsigned char last[20];
+	for (int x = 0; x < NUM_ADDRESSES; x++, line++) {
+		if (x % 10 == 3) {
+			// Duplicate
+			memcpy(hashes[x], last, 20);
+		}else for (int y = 0; y < 20; y++)
+			hashes[x][y] = rand();
+		// Sometimes give a zero first byte to test leading ones
+		if (x % 17 == 0)
+			hashes[x][0] = 0;
+		memcpy(last, hashes[x], 20);
+		CBAddress * address = CBNewAddressFromRIPEMD160Hash(hashes[x], CB_PREFIX_PRODUCTION_ADDRESS, false);
+		CBByteArray * string = CBChecksumBytesGetString(CBGetChecksumBytes(address));
+		if (x % 50 == 7) {
+			// Blank line
+			text[length++] = '\n';
+			line++;
+		}
+		if (x % 13 == 5)
+			text[length++] = ' ';
+		// The string length includes the termination character.
+		memcpy(text + length, CBByteArrayGetData(string), string->length - 1);
+		if (x % 31 == 9) {
+			// Corrupt the address
+			text[length + 10] = text[length + 10] == 'z' ? 'y' : 'z';
+			badLines[badLineNum++] = line;
+			memset(hashes[x], 0xFF, 20);
+		}
+		length += string->length - 1;
+		if (x % 11 == 4)
+			text[length++] = '\r';
+		if (x != NUM_ADDRESSES - 1)
+			text[length++] = '\n';
+		CBReleaseObject(string);
+		CBReleaseObject(address);
+	}
+	// A test network address is bad
+	memcpy(text + length, "\nmipcBbFg9gMiCh81Kj8tqqdgoZub1ZJRfn", 35);
+	length += 35;
+	badLines[badLineNum++] = ++line - 1;
+	// Get the expected index
+	qsort(hashes, NUM_ADDRESSES, 20, CBAddressIndexCompare);
+	int expectedNum = 0;
+	for (int x = 0; x < NUM_ADDRESSES; x++)
+		if (hashes[x][0] != 0xFF || hashes[x][1] != 0xFF)
+			if (!expectedNum || memcmp(hashes[x], hashes[expectedNum - 1], 20))
+				memcpy(hashes[expectedNum++], hashes[x], 20);
+	for (int threads = 1; threads <= 5; threads += 2) {
+		CBAddressIndex index;
+		if (CBInitAddressIndexFromText(&index, text, length, CB_PREFIX_PRODUCTION_ADDRESS, threads)) {
+			printf("NO BAD LINES FAIL WITH %i THREADS\n", threads);
+			return EXIT_FAILURE;
+		}
+		if (index.badLineNum != badLineNum || memcmp(index.badLines, badLines, sizeof(*badLines) * badLineNum)) {
+			printf("BAD LINES FAIL WITH %i THREADS\n", threads);
+			return EXIT_FAILURE;
+		}
+		if (index.hashNum != expectedNum || memcmp(index.hashes, hashes, 20 * expectedNum)) {
+			printf("HASHES FAIL WITH %i THREADS\n", threads);
+			return EXIT_FAILURE;
+		}
+		for (int x = 0; x < 20; x++) {
+			if (!CBAddressIndexContains(&index, hashes[rand() % expectedNum])) {
+				printf("CONTAINS FAIL WITH %i THREADS\n", threads);
+				return EXIT_FAILURE;
+			}
+			unsigned char missing[20];
+			for (int y = 0; y < 20; y++)
+				missing[y] = rand();
+			if (CBAddressIndexContains(&index, missing)) {
+				printf("NOT CONTAINS FAIL WITH %i THREADS\n", threads);
+				return EXIT_FAILURE;
+			}
+		}
+		CBDestroyAddressIndex(&index);
+	}
+	// Empty text
+	CBAddressIndex index;
+	if (!CBInitAddressIndexFromText(&index, text, 0, CB_PREFIX_PRODUCTION_ADDRESS, 2) || index.hashNum) {
+		printf("EMPTY FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBDestroyAddressIndex(&index);
+	free(text);
+	free(hashes);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,289 @@
+//
+//  testCBAnnouncements.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "CBNetworkCommunicator.h"
+
+#define PORT 45591
+#define TX_NUM 1000
+#define TRICKLE 200
+
+pthread_mutex_t stateMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t stateCond = PTHREAD_COND_INITIALIZER;
+CBPeer * thePeer = NULL;
+bool gotInv = false;
+CBNetworkCommunicator * theComm;
+int announced, refused;
+long long int announceStart;
+
+long long int CBGetMilliseconds(void){
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+CBByteArray * getHash(int x);
+CBByteArray * getHash(int x){
+	CBByteArray * hash = CBNewByteArrayOfSize(32);
+	memset(CBByteArrayGetData(hash), 0, 32);
+	CBByteArraySetInt32(hash, 0, x + 1);
+	CBByteArraySetInt32(hash, 8, x);
+	return hash;
+}
+
+void onPeerConnection(CBNetworkCommunicator * comm, CBPeer * peer);
+void onPeerConnection(CBNetworkCommunicator * comm, CBPeer * peer){
+	UNUSED(comm);
+	thePeer = peer;
+	// The test does not do a handshake, so let the peer send inventory straight away.
+	peer->handshakeStatus = CB_HANDSHAKE_GOT_VERSION;
+}
+bool acceptType(CBNetworkCommunicator * comm, CBPeer * peer, CBMessageType type);
+bool acceptType(CBNetworkCommunicator * comm, CBPeer * peer, CBMessageType type){
+	UNUSED(comm && peer && type);
+	return true;
+}
+CBOnMessageReceivedAction onMessageReceived(CBNetworkCommunicator * comm, CBPeer * peer, CBMessage * message);
+CBOnMessageReceivedAction onMessageReceived(CBNetworkCommunicator * comm, CBPeer * peer, CBMessage * message){
+	UNUSED(comm && peer);
+	if (message->type == CB_MESSAGE_TYPE_INV) {
+		pthread_mutex_lock(&stateMutex);
+		gotInv = true;
+		pthread_cond_signal(&stateCond);
+		pthread_mutex_unlock(&stateMutex);
+	}
+	return CB_MESSAGE_ACTION_CONTINUE;
+}
+void onNetworkError(CBNetworkCommunicator * comm, CBErrorReason reason);
+void onNetworkError(CBNetworkCommunicator * comm, CBErrorReason reason){
+	UNUSED(comm && reason);
+	printf("NETWORK ERROR FAIL\n");
+	exit(EXIT_FAILURE);
+}
+void onBadTime(void * foo);
+void onBadTime(void * foo){
+	UNUSED(foo);
+	printf("BAD TIME FAIL\n");
+	exit(EXIT_FAILURE);
+}
+
+void startListening(void * comm);
+void startListening(void * comm){
+	CBNetworkCommunicatorStartListening(comm);
+}
+void stop(void * comm);
+void stop(void * comm){
+	CBNetworkCommunicatorStop(comm);
+}
+
+void announceTransactions(void * unused);
+void announceTransactions(void * unused){
+	UNUSED(unused);
+	announceStart = CBGetMilliseconds();
+	announced = refused = 0;
+	// The first transaction was announced by the peer, and the first ten are given twice.
+	for (int x = 0; x < TX_NUM + 10; x++) {
+		CBByteArray * hash = getHash(x % TX_NUM);
+		if (CBNetworkCommunicatorAnnounceToAll(theComm, CB_INVENTORY_ITEM_TX, hash, NULL))
+			announced++;
+		else
+			refused++;
+		CBReleaseObject(hash);
+	}
+	// Blocks are not held back.
+	CBByteArray * hash = getHash(TX_NUM);
+	CBByteArraySetByte(hash, 31, 0xBB);
+	if (! CBNetworkCommunicatorAnnounce(theComm, thePeer, CB_INVENTORY_ITEM_BLOCK, hash)) {
+		printf("BLOCK ANNOUNCE FAIL\n");
+		exit(EXIT_FAILURE);
+	}
+	CBReleaseObject(hash);
+}
+void announceFull(void * unused);
+void announceFull(void * unused){
+	UNUSED(unused);
+	// A full batch is sent without waiting.
+	theComm->trickleInterval = 60000;
+	// Without the filter of known inventory every item is announced, so a false positive cannot refuse one.
+	CBReleaseObject(thePeer->knownInventory);
+	thePeer->knownInventory = NULL;
+	for (int x = 0; x < CB_INVENTORY_MAX_ITEMS + 5; x++) {
+		CBByteArray * hash = getHash(x + TX_NUM + 1);
+		CBByteArraySetByte(hash, 31, 0xFF);
+		if (! CBNetworkCommunicatorAnnounce(theComm, thePeer, CB_INVENTORY_ITEM_TX, hash)) {
+			printf("FULL ANNOUNCE FAIL\n");
+			exit(EXIT_FAILURE);
+		}
+		CBReleaseObject(hash);
+	}
+	if (! thePeer->announcements || thePeer->announcements->itemNum != 5) {
+		printf("FULL BATCH FAIL\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+bool readAll(int fd, unsigned char * buf, int len);
+bool readAll(int fd, unsigned char * buf, int len){
+	while (len) {
+		ssize_t num = recv(fd, buf, len, 0);
+		if (num <= 0)
+			return false;
+		buf += num;
+		len -= num;
+	}
+	return true;
+}
+
+unsigned char * readInv(int fd, int * itemNum);
+unsigned char * readInv(int fd, int * itemNum){
+	unsigned char header[24];
+	if (! readAll(fd, header, 24) || strncmp((char *)header + CB_MESSAGE_HEADER_TYPE, "inv", 12)) {
+		printf("READ INV HEADER FAIL\n");
+		exit(EXIT_FAILURE);
+	}
+	uint32_t length = CBArrayToInt32(header, CB_MESSAGE_HEADER_LENGTH);
+	unsigned char * payload = malloc(length);
+	if (! readAll(fd, payload, length)) {
+		printf("READ INV FAIL\n");
+		exit(EXIT_FAILURE);
+	}
+	CBVarInt num = CBVarIntDecodeData(payload, 0);
+	if (length != num.size + num.val * 36) {
+		printf("INV LENGTH FAIL\n");
+		exit(EXIT_FAILURE);
+	}
+	*itemNum = (int)num.val;
+	// Move the items to the start.
+	memmove(payload, payload + num.size, num.val * 36);
+	return payload;
+}
+
+int main(){
+	CBNetworkCommunicatorCallbacks callbacks = {onPeerConnection, acceptType, onMessageReceived, onNetworkError};
+	CBNetworkCommunicator * comm = theComm = CBNewNetworkCommunicator(0, callbacks);
+	CBNetworkAddressManager * addrMan = CBNewNetworkAddressManager(onBadTime);
+	addrMan->callbackHandler = comm;
+	CBNetworkCommunicatorSetNetworkAddressManager(comm, addrMan);
+	CBReleaseObject(addrMan);
+	CBNetworkCommunicatorSetReachability(comm, CB_IP_IP4 | CB_IP_LOCAL, true);
+	CBByteArray * ip = CBNewByteArrayWithDataCopy((unsigned char [16]){0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF, 127, 0, 0, 1}, 16);
+	CBNetworkAddress * ourAddr = CBNewNetworkAddress(0, (CBSocketAddress){ip, PORT}, 0, false);
+	CBReleaseObject(ip);
+	CBNetworkCommunicatorSetOurIPv4(comm, ourAddr);
+	CBReleaseObject(ourAddr);
+	comm->networkID = CB_PRODUCTION_NETWORK_BYTES;
+	comm->flags = 0;
+	comm->maxConnections = 1;
+	comm->maxIncommingConnections = 1;
+	comm->trickleInterval = TRICKLE;
+	// Make false positives of the known inventory too unlikely to refuse an announcement.
+	comm->knownInventoryFalsePositiveRate = 0.000000001;
+	CBRunOnEventLoop(comm->eventLoop, startListening, comm, true);
+	if (! comm->ipData[CB_IP4_NETWORK].isListening) {
+		printf("LISTEN FAIL\n");
+		return EXIT_FAILURE;
+	}
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr = {0};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(PORT);
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		printf("CONNECT FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// The peer announces the first transaction.
+	unsigned char inv[24 + 37] = {0};
+	CBInt32ToArray(inv, CB_MESSAGE_HEADER_NETWORK_ID, CB_PRODUCTION_NETWORK_BYTES);
+	memcpy(inv + CB_MESSAGE_HEADER_TYPE, "inv", 3);
+	CBInt32ToArray(inv, CB_MESSAGE_HEADER_LENGTH, 37);
+	inv[24] = 1;
+	CBInt32ToArray(inv, 25, CB_INVENTORY_ITEM_TX);
+	CBByteArray * hash = getHash(0);
+	memcpy(inv + 29, CBByteArrayGetData(hash), 32);
+	CBReleaseObject(hash);
+	unsigned char sha[32], sha2[32];
+	CBSha256(inv + 24, 37, sha);
+	CBSha256(sha, 32, sha2);
+	memcpy(inv + CB_MESSAGE_HEADER_CHECKSUM, sha2, 4);
+	if (send(fd, inv, sizeof(inv), 0) != sizeof(inv)) {
+		printf("SEND INV FAIL\n");
+		return EXIT_FAILURE;
+	}
+	struct timespec until;
+	clock_gettime(CLOCK_REALTIME, &until);
+	until.tv_sec += 3;
+	pthread_mutex_lock(&stateMutex);
+	while (! gotInv)
+		if (pthread_cond_timedwait(&stateCond, &stateMutex, &until)) {
+			printf("NO INV FAIL\n");
+			return EXIT_FAILURE;
+		}
+	pthread_mutex_unlock(&stateMutex);
+	CBRunOnEventLoop(comm->eventLoop, announceTransactions, NULL, true);
+	if (announced != TX_NUM - 1 || refused != 11 || comm->announceDuplicates != 11 || comm->announcedItems != TX_NUM) {
+		printf("DEDUPLICATION FAIL %i %i\n", announced, refused);
+		return EXIT_FAILURE;
+	}
+	// The block comes first, then the transactions in one batch.
+	int itemNum;
+	unsigned char * items = readInv(fd, &itemNum);
+	long long int blockTime = CBGetMilliseconds() - announceStart;
+	if (itemNum != 1 || CBArrayToInt32(items, 0) != CB_INVENTORY_ITEM_BLOCK || items[35] != 0xBB || blockTime >= TRICKLE / 2) {
+		printf("BLOCK FAIL\n");
+		return EXIT_FAILURE;
+	}
+	free(items);
+	items = readInv(fd, &itemNum);
+	long long int batchTime = CBGetMilliseconds() - announceStart;
+	printf("Block announced in %lli ms and %i transactions in %lli ms\n", blockTime, itemNum, batchTime);
+	if (itemNum != TX_NUM - 1 || batchTime > 2 * TRICKLE + 3 * CB_NETWORK_COMMUNICATOR_TIMEOUT_TICK) {
+		printf("BATCH FAIL\n");
+		return EXIT_FAILURE;
+	}
+	for (int x = 0; x < itemNum; x++) {
+		hash = getHash(x + 1);
+		if (CBArrayToInt32(items, x * 36) != CB_INVENTORY_ITEM_TX || memcmp(items + x * 36 + 4, CBByteArrayGetData(hash), 32)) {
+			printf("BATCH ITEM %i FAIL\n", x);
+			return EXIT_FAILURE;
+		}
+		CBReleaseObject(hash);
+	}
+	free(items);
+	if (comm->announceBatches != 1 || comm->announceBatchMax != TX_NUM - 1
+		|| comm->announceLatency != comm->announceLatencyMax || comm->announceLatency > batchTime) {
+		printf("BATCH STATISTICS FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Announcements over the size of an inv message.
+	CBRunOnEventLoop(comm->eventLoop, announceFull, NULL, true);
+	items = readInv(fd, &itemNum);
+	free(items);
+	if (itemNum != CB_INVENTORY_MAX_ITEMS || comm->announceBatches != 2 || comm->announceBatchMax != CB_INVENTORY_MAX_ITEMS) {
+		printf("FULL BATCH STATISTICS FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBRunOnEventLoop(comm->eventLoop, stop, comm, true);
+	CBReleaseObject(comm);
+	close(fd);
+	return EXIT_SUCCESS;
+}
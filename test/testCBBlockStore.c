@@ -0,0 +1,244 @@
+//
+//  testCBBlockStore.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "stdarg.h"
+#include "CBBlockStore.h"
+
+#define BLOCK_NUM 300
+#define MAX_BLOCK 50000
+#define FILE_SIZE 1000000
+
+void CBLogError(char * format, ...);
+void CBLogError(char * format, ...){
+	va_list argptr;
+	va_start(argptr, format);
+	vfprintf(stderr, format, argptr);
+	va_end(argptr);
+	printf("\n");
+}
+
+double elapsed(struct timespec * begin);
+double elapsed(struct timespec * begin){
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - begin->tv_sec) * 1e3 + (end.tv_nsec - begin->tv_nsec) / 1e6;
+}
+
+void closeWithoutSync(CBBlockStore * store);
+void closeWithoutSync(CBBlockStore * store){
+	CBFileUnmap(store->indexHeader, (uint64_t)(store->capacity + 1) * sizeof(CBBlockStoreRecord));
+	CBFileClose(store->indexFile);
+	for (uint32_t x = 0; x < store->fileNum; x++)
+		if (store->files[x].open) {
+			if (store->files[x].map)
+				CBFileUnmap(store->files[x].map, store->files[x].mapLength);
+			CBFileClose(store->files[x].file);
+		}
+	free(store->files);
+	free(store->table);
+	free(store->dataDir);
+}
+
+int main(){
+	unsigned int s = (unsigned int)time(NULL);
+	s = 1413590400;
+	printf("Session = %ui\n", s);
+	srand(s);
+	char dir[] = "/tmp/testCBBlockStoreXXXXXX";
+	if (! mkdtemp(dir)) {
+		printf("TEMP DIR FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Make blocks of random data with the hash of the first 80 bytes.
+	unsigned char * blocks[BLOCK_NUM + 1];
+	uint32_t lengths[BLOCK_NUM + 1];
+	unsigned char hashes[BLOCK_NUM + 1][32];
+	for (int x = 0; x <= BLOCK_NUM; x++) {
+		lengths[x] = 80 + rand() % (MAX_BLOCK - 80);
+		blocks[x] = malloc(lengths[x]);
+		for (uint32_t y = 0; y < lengths[x]; y++)
+			blocks[x][y] = rand();
+		unsigned char hash[32];
+		CBSha256(blocks[x], 80, hash);
+		CBSha256(hash, 32, hashes[x]);
+	}
+	CBBlockStore store;
+	if (! CBInitBlockStore(&store, dir, FILE_SIZE) || store.blockNum != 0 || store.fileSize != FILE_SIZE) {
+		printf("INIT NEW FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Keep only two files open at once.
+	store.maxOpenFiles = 2;
+	struct timespec begin;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (int x = 0; x < BLOCK_NUM; x++)
+		if (! CBBlockStoreAppend(&store, hashes[x], blocks[x], lengths[x])) {
+			printf("APPEND FAIL %i\n", x);
+			return EXIT_FAILURE;
+		}
+	printf("Append: %f ms for %i blocks in %u files\n", elapsed(&begin), BLOCK_NUM, store.appendFile + 1);
+	if (store.appendFile < 2 || ! CBBlockStoreAppend(&store, hashes[0], blocks[0], lengths[0]) || store.blockNum != BLOCK_NUM) {
+		printf("DUPLICATE FAIL\n");
+		return EXIT_FAILURE;
+	}
+	if (CBBlockStoreAppend(&store, hashes[BLOCK_NUM], blocks[BLOCK_NUM], FILE_SIZE + 1)) {
+		printf("TOO LARGE FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Store a real block and get it back
+	CBBlock * genesis = CBNewBlockGenesis();
+	if (! CBBlockStoreAppendBlock(&store, genesis)) {
+		printf("APPEND BLOCK FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBBlock * block = CBBlockStoreGetBlock(&store, CBBlockGetHash(genesis));
+	if (! block || block->transactionNum != 1
+		|| memcmp(CBTransactionGetHash(block->transactions[0]), CBTransactionGetHash(genesis->transactions[0]), 32)) {
+		printf("GET BLOCK FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBReleaseObject(block);
+	// Check the blocks are read from the files, which are not mapped past their ends.
+	for (int x = 0; x < BLOCK_NUM; x++) {
+		CBBlockStoreRecord * record = CBBlockStoreFind(&store, hashes[x]);
+		if (! record || record->length != lengths[x] || memcmp(CBBlockStoreGetData(&store, record), blocks[x], lengths[x])) {
+			printf("FIND FAIL %i\n", x);
+			return EXIT_FAILURE;
+		}
+		uint64_t length;
+		CBBlockStoreFile * file = store.files + record->fileID;
+		if (store.openFileNum > 2 || ! CBFileGetLength(file->file, &length) || file->mapLength > length) {
+			printf("OPEN FILES FAIL %i\n", x);
+			return EXIT_FAILURE;
+		}
+	}
+	if (CBBlockStoreFind(&store, hashes[BLOCK_NUM])) {
+		printf("FIND MISSING FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Send a block from the file to a socket
+	int sockets[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets)) {
+		printf("SOCKET PAIR FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBMessage * message = CBBlockStoreGetMessage(&store, hashes[7]);
+	unsigned char checksum[32], checksum2[32];
+	CBSha256(blocks[7], lengths[7], checksum);
+	CBSha256(checksum, 32, checksum2);
+	if (! message || ! message->fileBody || message->type != CB_MESSAGE_TYPE_BLOCK || message->bytes
+		|| message->fileLength != lengths[7] || memcmp(message->checksum, checksum2, 4)) {
+		printf("MESSAGE FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBDepObject socketID = {.i = sockets[0]};
+	unsigned char * received = malloc(lengths[7]);
+	uint32_t sent = 0, got = 0;
+	while (got < lengths[7]) {
+		if (sent < lengths[7]) {
+			int32_t len = CBSocketSendFile(socketID, message->file, message->fileOffset + sent, lengths[7] - sent);
+			if (len == CB_SOCKET_FAILURE) {
+				printf("SEND FILE FAIL\n");
+				return EXIT_FAILURE;
+			}
+			sent += len;
+		}
+		ssize_t len = read(sockets[1], received + got, lengths[7] - got);
+		if (len <= 0) {
+			printf("RECEIVE FAIL\n");
+			return EXIT_FAILURE;
+		}
+		got += len;
+	}
+	if (memcmp(received, blocks[7], lengths[7])) {
+		printf("SENT DATA FAIL\n");
+		return EXIT_FAILURE;
+	}
+	free(received);
+	close(sockets[0]);
+	close(sockets[1]);
+	CBReleaseObject(message);
+	CBDestroyBlockStore(&store);
+	// Reopen
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	if (! CBInitBlockStore(&store, dir, 0) || store.blockNum != BLOCK_NUM + 1 || store.fileSize != FILE_SIZE) {
+		printf("REOPEN FAIL\n");
+		return EXIT_FAILURE;
+	}
+	printf("Reopen: %f ms for %i blocks\n", elapsed(&begin), BLOCK_NUM + 1);
+	if (! CBBlockStoreFind(&store, CBBlockGetHash(genesis))) {
+		printf("REOPEN FIND FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Add blocks without syncing and damage the data of one, as if the process crashed while writing it.
+	uint32_t appendFile = store.appendFile, appendOffset = store.appendOffset;
+	for (int x = 0; x < 10; x++) {
+		blocks[x][0]++;
+		CBSha256(blocks[x], 80, checksum);
+		CBSha256(checksum, 32, hashes[x]);
+		if (! CBBlockStoreAppend(&store, hashes[x], blocks[x], lengths[x])) {
+			printf("APPEND TAIL FAIL %i\n", x);
+			return EXIT_FAILURE;
+		}
+	}
+	CBBlockStoreRecord * damaged = CBBlockStoreGetRecord(&store, BLOCK_NUM + 7);
+	unsigned char last = CBBlockStoreGetData(&store, damaged)[damaged->length - 1] + 1;
+	char filename[sizeof(dir) + 30];
+	CBDepObject damagedFile;
+	CBBlockStoreGetFileName(&store, damaged->fileID, filename);
+	if (! CBFileOpen(&damagedFile, filename, false) || ! CBFileWrite(damagedFile, &last, 1, damaged->offset + damaged->length - 1)) {
+		printf("DAMAGE FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBFileClose(damagedFile);
+	closeWithoutSync(&store);
+	if (! CBInitBlockStore(&store, dir, 0) || store.blockNum != BLOCK_NUM + 7) {
+		printf("CRASH RECOVERY FAIL %u\n", store.blockNum);
+		return EXIT_FAILURE;
+	}
+	if (! CBBlockStoreFind(&store, hashes[5]) || CBBlockStoreFind(&store, hashes[6])) {
+		printf("CRASH RECOVERY FIND FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// The damaged block is written again over the old one.
+	if (! CBBlockStoreAppend(&store, hashes[6], blocks[6], lengths[6]) || store.blockNum != BLOCK_NUM + 8
+		|| memcmp(CBBlockStoreGetData(&store, CBBlockStoreFind(&store, hashes[6])), blocks[6], lengths[6])) {
+		printf("APPEND AFTER RECOVERY FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBDestroyBlockStore(&store);
+	if (! CBInitBlockStore(&store, dir, 0) || store.blockNum != BLOCK_NUM + 8 || (store.appendFile == appendFile && store.appendOffset <= appendOffset)) {
+		printf("FINAL REOPEN FAIL\n");
+		return EXIT_FAILURE;
+	}
+	appendFile = store.appendFile;
+	CBDestroyBlockStore(&store);
+	for (uint32_t x = 0; x <= appendFile; x++) {
+		sprintf(filename, "%s/blocks%u.dat", dir, x);
+		unlink(filename);
+	}
+	sprintf(filename, "%s/blockIndex.dat", dir);
+	unlink(filename);
+	rmdir(dir);
+	CBReleaseObject(genesis);
+	for (int x = 0; x <= BLOCK_NUM; x++)
+		free(blocks[x]);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,230 @@
+//
+//  testCBBlockStoreSend.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "CBNetworkCommunicator.h"
+#include "CBBlockStore.h"
+
+#define PORT 45592
+#define BLOCK_NUM 4
+#define BLOCK_SIZE 300000
+#define FILE_SIZE 1000000 // Three blocks in each file.
+
+pthread_mutex_t stateMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t stateCond = PTHREAD_COND_INITIALIZER;
+bool queued = false;
+CBBlockStore store;
+unsigned char * blocks[BLOCK_NUM];
+unsigned char hashes[BLOCK_NUM][32];
+
+long long int CBGetMilliseconds(void){
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+void onPeerConnection(CBNetworkCommunicator * comm, CBPeer * peer);
+void onPeerConnection(CBNetworkCommunicator * comm, CBPeer * peer){
+	// Queue the blocks from the store. Nothing is sent until this returns.
+	for (int x = 0; x < BLOCK_NUM; x++) {
+		CBMessage * message = CBBlockStoreGetMessage(&store, hashes[x]);
+		if (! message || ! message->fileBody || ! CBNetworkCommunicatorSendMessage(comm, peer, message, NULL)) {
+			printf("QUEUE BLOCK %i FAIL\n", x);
+			exit(EXIT_FAILURE);
+		}
+		CBReleaseObject(message);
+	}
+	// Reading the last block makes the store close the first file, which the queued messages have their own handles of.
+	if (! CBBlockStoreGetData(&store, CBBlockStoreFind(&store, hashes[BLOCK_NUM - 1]))
+		|| store.openFileNum != 1 || store.files[0].open) {
+		printf("CLOSE FILE FAIL\n");
+		exit(EXIT_FAILURE);
+	}
+	pthread_mutex_lock(&stateMutex);
+	queued = true;
+	pthread_cond_signal(&stateCond);
+	pthread_mutex_unlock(&stateMutex);
+}
+void onSendQueueDrained(CBNetworkCommunicator * comm, CBPeer * peer);
+void onSendQueueDrained(CBNetworkCommunicator * comm, CBPeer * peer){
+	UNUSED(comm && peer);
+}
+bool acceptType(CBNetworkCommunicator * comm, CBPeer * peer, CBMessageType type);
+bool acceptType(CBNetworkCommunicator * comm, CBPeer * peer, CBMessageType type){
+	UNUSED(comm && peer && type);
+	return true;
+}
+CBOnMessageReceivedAction onMessageReceived(CBNetworkCommunicator * comm, CBPeer * peer, CBMessage * message);
+CBOnMessageReceivedAction onMessageReceived(CBNetworkCommunicator * comm, CBPeer * peer, CBMessage * message){
+	UNUSED(comm && peer && message);
+	return CB_MESSAGE_ACTION_CONTINUE;
+}
+void onNetworkError(CBNetworkCommunicator * comm, CBErrorReason reason);
+void onNetworkError(CBNetworkCommunicator * comm, CBErrorReason reason){
+	UNUSED(comm && reason);
+	printf("NETWORK ERROR FAIL\n");
+	exit(EXIT_FAILURE);
+}
+void onBadTime(void * foo);
+void onBadTime(void * foo){
+	UNUSED(foo);
+	printf("BAD TIME FAIL\n");
+	exit(EXIT_FAILURE);
+}
+
+void startListening(void * comm);
+void startListening(void * comm){
+	CBNetworkCommunicatorStartListening(comm);
+}
+void stop(void * comm);
+void stop(void * comm){
+	CBNetworkCommunicatorStop(comm);
+}
+
+bool readAll(int fd, unsigned char * buf, int len);
+bool readAll(int fd, unsigned char * buf, int len){
+	while (len) {
+		ssize_t num = recv(fd, buf, len, 0);
+		if (num <= 0)
+			return false;
+		buf += num;
+		len -= num;
+	}
+	return true;
+}
+
+int main(){
+	// Add blocks of random data with the hash of the first 80 bytes to a store.
+	char dir[] = "/tmp/testCBBlockStoreSendXXXXXX";
+	if (! mkdtemp(dir)) {
+		printf("TEMP DIR FAIL\n");
+		return EXIT_FAILURE;
+	}
+	if (! CBInitBlockStore(&store, dir, FILE_SIZE)) {
+		printf("INIT STORE FAIL\n");
+		return EXIT_FAILURE;
+	}
+	store.maxOpenFiles = 1;
+	for (int x = 0; x < BLOCK_NUM; x++) {
+		blocks[x] = malloc(BLOCK_SIZE);
+		for (int y = 0; y < BLOCK_SIZE; y++)
+			blocks[x][y] = rand();
+		unsigned char hash[32];
+		CBSha256(blocks[x], 80, hash);
+		CBSha256(hash, 32, hashes[x]);
+		if (! CBBlockStoreAppend(&store, hashes[x], blocks[x], BLOCK_SIZE)) {
+			printf("APPEND FAIL %i\n", x);
+			return EXIT_FAILURE;
+		}
+	}
+	if (CBBlockStoreFind(&store, hashes[0])->fileID == CBBlockStoreFind(&store, hashes[BLOCK_NUM - 1])->fileID) {
+		printf("BLOCK FILES FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Listening communicator which sends the blocks to the client when it connects.
+	CBNetworkCommunicatorCallbacks callbacks = {onPeerConnection, acceptType, onMessageReceived, onNetworkError, onSendQueueDrained};
+	CBNetworkCommunicator * comm = CBNewNetworkCommunicator(0, callbacks);
+	CBNetworkAddressManager * addrMan = CBNewNetworkAddressManager(onBadTime);
+	addrMan->callbackHandler = comm;
+	CBNetworkCommunicatorSetNetworkAddressManager(comm, addrMan);
+	CBReleaseObject(addrMan);
+	CBNetworkCommunicatorSetReachability(comm, CB_IP_IP4 | CB_IP_LOCAL, true);
+	CBByteArray * ip = CBNewByteArrayWithDataCopy((unsigned char [16]){0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF, 127, 0, 0, 1}, 16);
+	CBNetworkAddress * ourAddr = CBNewNetworkAddress(0, (CBSocketAddress){ip, PORT}, 0, false);
+	CBReleaseObject(ip);
+	CBNetworkCommunicatorSetOurIPv4(comm, ourAddr);
+	CBReleaseObject(ourAddr);
+	comm->networkID = CB_PRODUCTION_NETWORK_BYTES;
+	comm->flags = 0;
+	comm->maxConnections = 1;
+	comm->maxIncommingConnections = 1;
+	comm->sendTimeOut = 5000;
+	CBRunOnEventLoop(comm->eventLoop, startListening, comm, true);
+	if (! comm->ipData[CB_IP4_NETWORK].isListening) {
+		printf("LISTEN FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Connect with a small receive buffer, so that each block takes many sends.
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	int bufSize = 4096;
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufSize, sizeof(bufSize));
+	struct sockaddr_in addr = {0};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(PORT);
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		printf("CONNECT FAIL\n");
+		return EXIT_FAILURE;
+	}
+	struct timespec until;
+	clock_gettime(CLOCK_REALTIME, &until);
+	until.tv_sec += 3;
+	pthread_mutex_lock(&stateMutex);
+	while (! queued)
+		if (pthread_cond_timedwait(&stateCond, &stateMutex, &until)) {
+			printf("NO CONNECTION FAIL\n");
+			return EXIT_FAILURE;
+		}
+	pthread_mutex_unlock(&stateMutex);
+	// The blocks arrive in order with headers for the data in the files.
+	unsigned char * payload = malloc(BLOCK_SIZE);
+	for (int x = 0; x < BLOCK_NUM; x++) {
+		unsigned char header[24], hash[32], hash2[32];
+		if (! readAll(fd, header, 24)) {
+			printf("READ HEADER %i FAIL\n", x);
+			return EXIT_FAILURE;
+		}
+		if (CBArrayToInt32(header, CB_MESSAGE_HEADER_NETWORK_ID) != CB_PRODUCTION_NETWORK_BYTES
+			|| strncmp((char *)header + CB_MESSAGE_HEADER_TYPE, "block", 12)
+			|| CBArrayToInt32(header, CB_MESSAGE_HEADER_LENGTH) != BLOCK_SIZE) {
+			printf("HEADER %i FAIL\n", x);
+			return EXIT_FAILURE;
+		}
+		if (! readAll(fd, payload, BLOCK_SIZE)) {
+			printf("READ PAYLOAD %i FAIL\n", x);
+			return EXIT_FAILURE;
+		}
+		CBSha256(payload, BLOCK_SIZE, hash);
+		CBSha256(hash, 32, hash2);
+		if (memcmp(payload, blocks[x], BLOCK_SIZE) || memcmp(header + CB_MESSAGE_HEADER_CHECKSUM, hash2, 4)) {
+			printf("PAYLOAD %i FAIL\n", x);
+			return EXIT_FAILURE;
+		}
+	}
+	free(payload);
+	CBRunOnEventLoop(comm->eventLoop, stop, comm, true);
+	CBReleaseObject(comm);
+	close(fd);
+	uint32_t fileNum = store.fileNum;
+	CBDestroyBlockStore(&store);
+	char filename[sizeof(dir) + 30];
+	for (uint32_t x = 0; x < fileNum; x++) {
+		sprintf(filename, "%s/blocks%u.dat", dir, x);
+		unlink(filename);
+	}
+	sprintf(filename, "%s/blockIndex.dat", dir);
+	unlink(filename);
+	rmdir(dir);
+	for (int x = 0; x < BLOCK_NUM; x++)
+		free(blocks[x]);
+	return EXIT_SUCCESS;
+}
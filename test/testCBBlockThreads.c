@@ -0,0 +1,158 @@
+//
+//  testCBBlockThreads.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stdarg.h"
+#include "CBBlock.h"
+
+#define NUM_TX 8000
+#define ROUNDS 5
+
+void CBLogError(char * format, ...);
+void CBLogError(char * format, ...){
+	va_list argptr;
+	va_start(argptr, format);
+	vfprintf(stderr, format, argptr);
+	va_end(argptr);
+	printf("\n");
+}
+
+double elapsed(struct timespec * begin);
+double elapsed(struct timespec * begin){
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - begin->tv_sec) * 1e3 + (end.tv_nsec - begin->tv_nsec) / 1e6;
+}
+
+int main(){
+	unsigned int s = (unsigned int)time(NULL);
+	s = 1413590400;
+	printf("Session = %ui\n", s);
+	srand(s);
+	// Make a block of transactions with varying numbers of inputs and outputs
+	CBBlock * block = CBNewBlock();
+	block->version = 2;
+	block->prevBlockHash = CBNewByteArrayOfSize(32);
+	block->merkleRoot = CBNewByteArrayOfSize(32);
+	memset(CBByteArrayGetData(block->prevBlockHash), 0, 32);
+	memset(CBByteArrayGetData(block->merkleRoot), 0, 32);
+	block->target = 0x1D00FFFF;
+	block->time = 1413590400;
+	block->nonce = 0;
+	block->transactionNum = NUM_TX;
+	block->transactions = malloc(sizeof(*block->transactions) * NUM_TX);
+	for (int x = 0; x < NUM_TX; x++) {
+		block->transactions[x] = CBNewTransaction(0, 1);
+		int inputNum = 1 + rand() % 4, outputNum = 1 + rand() % 4;
+		for (int y = 0; y < inputNum; y++) {
+			CBByteArray * hash = CBNewByteArrayOfSize(32);
+			CBScript * script = CBNewScriptOfSize(107);
+			for (int z = 0; z < 32; z++)
+				CBByteArrayGetData(hash)[z] = rand();
+			for (int z = 0; z < 107; z++)
+				CBByteArrayGetData(script)[z] = rand();
+			CBTransactionTakeInput(block->transactions[x], CBNewTransactionInputTakeScriptAndHash(script, CB_TX_INPUT_FINAL, hash, y));
+		}
+		for (int y = 0; y < outputNum; y++) {
+			CBScript * script = CBNewScriptOfSize(25);
+			for (int z = 0; z < 25; z++)
+				CBByteArrayGetData(script)[z] = rand();
+			CBTransactionTakeOutput(block->transactions[x], CBNewTransactionOutputTakeScript(rand(), script));
+		}
+	}
+	CBByteArray * bytes = CBNewByteArrayOfSize(CBBlockCalculateLength(block, true));
+	CBGetMessage(block)->bytes = bytes;
+	CBBlockSerialise(block, true, true);
+	CBRetainObject(bytes);
+	CBReleaseObject(block);
+	// Parse to transaction hashes in order
+	unsigned char (*hashes)[32] = malloc(sizeof(*hashes) * NUM_TX);
+	struct timespec begin;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (int x = 0; x < ROUNDS; x++) {
+		block = CBNewBlockFromData(bytes);
+		if (CBBlockDeserialise(block, true) != bytes->length) {
+			printf("DESERIALISE FAIL\n");
+			return EXIT_FAILURE;
+		}
+		for (int y = 0; y < NUM_TX; y++)
+			memcpy(hashes[y], CBTransactionGetHash(block->transactions[y]), 32);
+		CBReleaseObject(block);
+	}
+	double sequentialTime = elapsed(&begin) / ROUNDS;
+	printf("Block of %i bytes in order: %.2fms\n", bytes->length, sequentialTime);
+	// Parse to transaction hashes on threads
+	int threads[3] = {1, 4, 0};
+	for (int t = 0; t < 3; t++) {
+		clock_gettime(CLOCK_MONOTONIC, &begin);
+		for (int x = 0; x < ROUNDS; x++) {
+			block = x % 2 ? CBNewBlockFromDataWithArena(bytes) : CBNewBlockFromData(bytes);
+			if (CBBlockDeserialiseWithThreads(block, true, threads[t]) != bytes->length || block->transactionNum != NUM_TX) {
+				printf("THREADS DESERIALISE FAIL %i\n", threads[t]);
+				return EXIT_FAILURE;
+			}
+			for (int y = 0; y < NUM_TX; y++)
+				if (! block->transactions[y]->hashSet || memcmp(block->transactions[y]->hash, hashes[y], 32)) {
+					printf("THREADS HASH FAIL %i %i\n", threads[t], y);
+					return EXIT_FAILURE;
+				}
+			if (x == 0) {
+				// The objects must serialise to the same data
+				CBByteArray * copy = CBByteArrayCopy(bytes);
+				CBReleaseObject(CBGetMessage(block)->bytes);
+				CBGetMessage(block)->bytes = copy;
+				if (CBBlockSerialise(block, true, true) != bytes->length
+					|| CBByteArrayCompare(copy, bytes) != CB_COMPARE_EQUAL) {
+					printf("THREADS SERIALISE FAIL %i\n", threads[t]);
+					return EXIT_FAILURE;
+				}
+			}
+			CBReleaseObject(block);
+		}
+		printf("Block on %i threads: %.2fms\n", threads[t], elapsed(&begin) / ROUNDS);
+	}
+	// Bad data must be rejected
+	for (int x = 0; x < 20; x++) {
+		CBByteArray * bad = CBByteArrayCopy(bytes);
+		if (x % 2)
+			bad->length = 82 + rand() % (bytes->length - 82);
+		else
+			// Make a script length too large
+			CBByteArraySetByte(bad, 83 + 4 + 1 + 36, 0xFF);
+		block = CBNewBlockFromData(bad);
+		if (CBBlockDeserialiseWithThreads(block, true, 4) != CB_DESERIALISE_ERROR || block->transactions) {
+			printf("BAD DATA FAIL %i\n", x);
+			return EXIT_FAILURE;
+		}
+		CBReleaseObject(block);
+		CBReleaseObject(bad);
+	}
+	// A header only block
+	CBByteArray * header = CBByteArraySubCopy(bytes, 0, 82);
+	CBByteArraySetByte(header, 80, 0);
+	CBByteArraySetByte(header, 81, 0);
+	block = CBNewBlockFromData(header);
+	if (CBBlockDeserialiseWithThreads(block, true, 4) != 82 || block->transactions) {
+		printf("HEADER FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBReleaseObject(block);
+	CBReleaseObject(header);
+	free(hashes);
+	CBReleaseObject(bytes);
+	return EXIT_SUCCESS;
+}
@@ -14,11 +14,16 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <time.h>
 #include <pthread.h>
 #include "CBDependencies.h"
 
+#define PRODUCERS 4
+#define PRODUCER_CALLBACKS 100000
+
 pthread_mutex_t argmutex = PTHREAD_MUTEX_INITIALIZER;
 CBDepObject eventLoop;
+int count = 0; // Only changed on the event loop.
 
 void callback(void * arg);
 void callback(void * arg){
@@ -29,6 +34,21 @@ void callback(void * arg){
 		CBRunOnEventLoop(eventLoop, callback, arg, 0);
 }
 
+void increment(void * arg);
+void increment(void * arg){
+	UNUSED(arg);
+	count++;
+}
+
+void * produce(void * arg);
+void * produce(void * arg){
+	UNUSED(arg);
+	for (int x = 0; x < PRODUCER_CALLBACKS; x++)
+		// Block now and then, so that blocking and other callbacks are mixed.
+		CBRunOnEventLoop(eventLoop, increment, NULL, x % 1000 == 999);
+	return NULL;
+}
+
 int main(){
 	unsigned int s = (unsigned int)time(NULL);
 	s = 1393368855;
@@ -42,6 +62,23 @@ int main(){
 		printf("ARG FAIL %u != 1500\n", arg);
 		return EXIT_FAILURE;
 	}
+	// Many threads giving callbacks at once
+	pthread_t producers[PRODUCERS];
+	struct timespec begin, end;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (int x = 0; x < PRODUCERS; x++)
+		pthread_create(&producers[x], NULL, produce, NULL);
+	for (int x = 0; x < PRODUCERS; x++)
+		pthread_join(producers[x], NULL);
+	// Callbacks are run in order, so every callback has run after this one.
+	CBRunOnEventLoop(eventLoop, increment, NULL, true);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if (count != PRODUCERS * PRODUCER_CALLBACKS + 1) {
+		printf("PRODUCERS COUNT FAIL %i != %i\n", count, PRODUCERS * PRODUCER_CALLBACKS + 1);
+		return EXIT_FAILURE;
+	}
+	double ms = (end.tv_sec - begin.tv_sec) * 1e3 + (end.tv_nsec - begin.tv_nsec) / 1e6;
+	printf("%i callbacks from %i threads in %f ms, %.0f callbacks per second\n", count, PRODUCERS, ms, count / ms * 1e3);
 	CBExitEventLoop(eventLoop);
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,440 @@
+//
+//  testCBCoinStore.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "stdarg.h"
+#include "CBCoinStore.h"
+#include "CBValidationFunctions.h"
+
+#define SEED_NUM 20000
+#define BLOCK_NUM 240
+#define TX_NUM 100
+#define FEE 1000
+#define LARGE_CACHE 0x10000000
+#define SMALL_CACHE 0x10000
+
+typedef struct{
+	unsigned char hash[32];
+	uint32_t index;
+	uint64_t value;
+} Coin;
+
+void CBLogError(char * format, ...);
+void CBLogError(char * format, ...){
+	va_list argptr;
+	va_start(argptr, format);
+	vfprintf(stderr, format, argptr);
+	va_end(argptr);
+	printf("\n");
+}
+
+double elapsed(struct timespec * begin);
+double elapsed(struct timespec * begin){
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - begin->tv_sec) * 1e3 + (end.tv_nsec - begin->tv_nsec) / 1e6;
+}
+
+void closeWithoutFlush(CBCoinStore * store);
+void closeWithoutFlush(CBCoinStore * store){
+	CBCoinStoreCacheClear(store);
+	free(store->buckets);
+	CBFileUnmap(store->indexHeader, store->indexLength);
+	CBFileClose(store->logFile);
+	CBFileClose(store->undoFile);
+	CBFileClose(store->indexFile);
+}
+
+CBScript * makeScript(void);
+CBScript * makeScript(void){
+	CBScript * script = CBNewScriptOfSize(25);
+	for (int x = 0; x < 25; x++)
+		CBByteArrayGetData(script)[x] = rand();
+	CBByteArrayGetData(script)[0] = CB_SCRIPT_OP_DUP;
+	return script;
+}
+
+void finishTx(CBTransaction * tx);
+void finishTx(CBTransaction * tx){
+	CBTransactionPrepareBytes(tx);
+	CBTransactionSerialise(tx, false);
+	CBTransactionGetHash(tx);
+}
+
+CBTransaction * makeTx(Coin * inputs, int inputNum, uint64_t * values, int outputNum);
+CBTransaction * makeTx(Coin * inputs, int inputNum, uint64_t * values, int outputNum){
+	CBTransaction * tx = CBNewTransaction(0, 1);
+	for (int x = 0; x < inputNum; x++) {
+		CBByteArray * hash = CBNewByteArrayWithDataCopy(inputs[x].hash, 32);
+		CBTransactionTakeInput(tx, CBNewTransactionInputTakeScriptAndHash(CBNewScriptOfSize(0), CB_TX_INPUT_FINAL, hash, inputs[x].index));
+	}
+	for (int x = 0; x < outputNum; x++)
+		CBTransactionTakeOutput(tx, CBNewTransactionOutputTakeScript(values[x], makeScript()));
+	finishTx(tx);
+	return tx;
+}
+
+// Makes a block spending coins from the pool, with a coinbase paying the reward and fees and an OP_RETURN output.
+CBBlock * makeBlock(unsigned char * prev, uint32_t height, Coin * pool, int * poolNum, int txNum);
+CBBlock * makeBlock(unsigned char * prev, uint32_t height, Coin * pool, int * poolNum, int txNum){
+	CBBlock * block = CBNewBlock();
+	block->prevBlockHash = CBNewByteArrayWithDataCopy(prev, 32);
+	for (int x = 0; x < 32; x++)
+		block->hash[x] = rand();
+	block->hashSet = true;
+	block->transactionNum = txNum + 1;
+	block->transactions = malloc(sizeof(*block->transactions) * (txNum + 1));
+	uint64_t fees = 0;
+	for (int x = 1; x <= txNum; x++) {
+		Coin inputs[2];
+		for (int y = 0; y < 2; y++) {
+			int pick = rand() % *poolNum;
+			inputs[y] = pool[pick];
+			pool[pick] = pool[--*poolNum];
+		}
+		uint64_t total = inputs[0].value + inputs[1].value - FEE;
+		uint64_t values[2] = {total / 2, total - total / 2};
+		fees += FEE;
+		CBTransaction * tx = makeTx(inputs, 2, values, 2);
+		block->transactions[x] = tx;
+		for (uint32_t y = 0; y < 2; y++) {
+			memcpy(pool[*poolNum].hash, CBTransactionGetHash(tx), 32);
+			pool[*poolNum].index = y;
+			pool[(*poolNum)++].value = values[y];
+		}
+	}
+	CBTransaction * coinbase = CBNewTransaction(0, 1);
+	CBByteArray * nullHash = CBNewByteArrayOfSize(32);
+	memset(CBByteArrayGetData(nullHash), 0, 32);
+	CBScript * script = CBNewScriptOfSize(4);
+	CBInt32ToArray(CBByteArrayGetData(script), 0, height);
+	CBTransactionTakeInput(coinbase, CBNewTransactionInputTakeScriptAndHash(script, CB_TX_INPUT_FINAL, nullHash, 0xFFFFFFFF));
+	CBTransactionTakeOutput(coinbase, CBNewTransactionOutputTakeScript(CBCalculateBlockReward(height) + fees, makeScript()));
+	script = CBNewScriptOfSize(2);
+	CBByteArrayGetData(script)[0] = CB_SCRIPT_OP_RETURN;
+	CBByteArrayGetData(script)[1] = 0;
+	CBTransactionTakeOutput(coinbase, CBNewTransactionOutputTakeScript(0, script));
+	finishTx(coinbase);
+	block->transactions[0] = coinbase;
+	return block;
+}
+
+bool checkCoins(CBCoinStore * store, Coin * pool, int poolNum);
+bool checkCoins(CBCoinStore * store, Coin * pool, int poolNum){
+	for (int x = 0; x < poolNum; x++) {
+		CBCoin * coin = CBCoinStoreGet(store, pool[x].hash, pool[x].index);
+		if (! coin || coin->value != pool[x].value || coin->scriptLength != 25)
+			return false;
+	}
+	return true;
+}
+
+bool connectBlocks(CBCoinStore * store, CBBlock ** blocks, int start, int end, bool prefetch, char * name);
+bool connectBlocks(CBCoinStore * store, CBBlock ** blocks, int start, int end, bool prefetch, char * name){
+	struct timespec begin;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (int x = start; x < end; x++) {
+		if (prefetch && ! CBCoinStorePrefetch(store, blocks[x], 0)) {
+			printf("PREFETCH FAIL %i\n", x);
+			return false;
+		}
+		if (CBCoinStoreConnectBlock(store, blocks[x], x + 1) != CB_COIN_STORE_OK) {
+			printf("CONNECT FAIL %i\n", x);
+			return false;
+		}
+	}
+	if (! CBCoinStoreFlush(store)) {
+		printf("FLUSH FAIL\n");
+		return false;
+	}
+	double time = elapsed(&begin);
+	printf("Connect %s: %.0f tx/s\n", name, (end - start) * TX_NUM / time * 1000);
+	return true;
+}
+
+// Checks that a block fails to connect and that the coins it spent are back.
+bool checkInvalid(CBCoinStore * store, CBBlock * block, Coin * spent, int spentNum);
+bool checkInvalid(CBCoinStore * store, CBBlock * block, Coin * spent, int spentNum){
+	unsigned char tip[32];
+	memcpy(tip, store->tip, 32);
+	uint64_t undoLength = store->undoLength;
+	bool ok = CBCoinStoreConnectBlock(store, block, BLOCK_NUM + 1) == CB_COIN_STORE_INVALID
+		&& ! memcmp(tip, store->tip, 32)
+		&& undoLength == store->undoLength
+		&& checkCoins(store, spent, spentNum);
+	for (int x = 0; ok && x < block->transactionNum; x++)
+		ok = ! CBCoinStoreGet(store, CBTransactionGetHash(block->transactions[x]), 0);
+	CBReleaseObject(block);
+	return ok;
+}
+
+int main(){
+	unsigned int s = (unsigned int)time(NULL);
+	s = 1413590400;
+	printf("Session = %ui\n", s);
+	srand(s);
+	char dir[] = "/tmp/testCBCoinStoreXXXXXX";
+	if (! mkdtemp(dir)) {
+		printf("TEMP DIR FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBCoinStore store;
+	if (! CBInitCoinStore(&store, dir, LARGE_CACHE) || store.indexHeader->coinNum) {
+		printf("INIT NEW FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Add coins to spend
+	Coin * pool = malloc(sizeof(*pool) * (SEED_NUM + TX_NUM * 2));
+	int poolNum = SEED_NUM;
+	unsigned char key[CB_COIN_KEY_SIZE], script[25];
+	for (int x = 0; x < SEED_NUM; x++) {
+		for (int y = 0; y < 32; y++)
+			pool[x].hash[y] = rand();
+		pool[x].index = rand() % 4;
+		pool[x].value = CB_ONE_BITCOIN;
+		for (int y = 0; y < 25; y++)
+			script[y] = rand();
+		CBCoinStoreMakeKey(key, pool[x].hash, pool[x].index);
+		CBCoinStoreAdd(&store, key, pool[x].value, 0, false, script, 25);
+	}
+	if (! CBCoinStoreFlush(&store) || store.indexHeader->coinNum != SEED_NUM || ! checkCoins(&store, pool, poolNum)) {
+		printf("SEED FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Make the blocks, keeping the coins at the middle and the end.
+	CBBlock * blocks[BLOCK_NUM];
+	unsigned char zero[32] = {0};
+	Coin * middlePool = malloc(sizeof(*pool) * (SEED_NUM + TX_NUM * 2)), * endPool = malloc(sizeof(*pool) * (SEED_NUM + TX_NUM * 2));
+	int middleNum = 0;
+	for (int x = 0; x < BLOCK_NUM; x++) {
+		if (x == BLOCK_NUM / 2) {
+			memcpy(middlePool, pool, sizeof(*pool) * poolNum);
+			middleNum = poolNum;
+		}
+		blocks[x] = makeBlock(x ? CBBlockGetHash(blocks[x - 1]) : zero, x + 1, pool, &poolNum, TX_NUM);
+	}
+	memcpy(endPool, pool, sizeof(*pool) * poolNum);
+	// Connect with a cache large enough for every coin, then with a small cache with and without prefetching.
+	if (! connectBlocks(&store, blocks, 0, BLOCK_NUM / 2, false, "large cache")
+		|| store.indexHeader->coinNum != SEED_NUM + BLOCK_NUM / 2
+		|| ! checkCoins(&store, middlePool, middleNum)) {
+		printf("LARGE CACHE FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBCoinStoreCacheClear(&store);
+	store.cacheLimit = SMALL_CACHE;
+	if (! connectBlocks(&store, blocks, BLOCK_NUM / 2, BLOCK_NUM * 3 / 4, false, "small cache")
+		|| ! connectBlocks(&store, blocks, BLOCK_NUM * 3 / 4, BLOCK_NUM, true, "small cache with prefetch")
+		|| store.indexHeader->coinNum != SEED_NUM + BLOCK_NUM
+		|| memcmp(store.tip, CBBlockGetHash(blocks[BLOCK_NUM - 1]), 32)
+		|| ! checkCoins(&store, endPool, poolNum)) {
+		printf("SMALL CACHE FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Invalid blocks are rolled back
+	store.cacheLimit = LARGE_CACHE;
+	Coin spent[4] = {pool[0], pool[1], pool[2], pool[3]};
+	uint64_t values[2] = {pool[0].value, pool[1].value - FEE};
+	CBBlock * block = makeBlock(store.tip, BLOCK_NUM + 1, pool, &poolNum, 0);
+	block->transactions = realloc(block->transactions, sizeof(*block->transactions) * 3);
+	block->transactions[1] = makeTx(spent, 2, values, 2);
+	Coin missing = spent[2];
+	missing.hash[0]++;
+	Coin inputs[2] = {spent[2], missing};
+	block->transactions[2] = makeTx(inputs, 2, values, 1);
+	block->transactionNum = 3;
+	if (! checkInvalid(&store, block, spent, 4)) {
+		printf("MISSING INPUT FAIL\n");
+		return EXIT_FAILURE;
+	}
+	block = makeBlock(store.tip, BLOCK_NUM + 1, pool, &poolNum, 0);
+	block->transactions = realloc(block->transactions, sizeof(*block->transactions) * 3);
+	block->transactions[1] = makeTx(spent, 2, values, 2);
+	values[0] = spent[2].value + spent[3].value + 1;
+	block->transactions[2] = makeTx(spent + 2, 2, values, 1);
+	block->transactionNum = 3;
+	if (! checkInvalid(&store, block, spent, 4)) {
+		printf("OVERSPEND FAIL\n");
+		return EXIT_FAILURE;
+	}
+	block = makeBlock(store.tip, BLOCK_NUM + 1, pool, &poolNum, 0);
+	block->transactions = realloc(block->transactions, sizeof(*block->transactions) * 3);
+	values[0] = spent[0].value;
+	block->transactions[1] = makeTx(spent, 2, values, 2);
+	Coin immature = {.index = 0, .value = CBCalculateBlockReward(BLOCK_NUM) + TX_NUM * FEE};
+	memcpy(immature.hash, CBTransactionGetHash(blocks[BLOCK_NUM - 1]->transactions[0]), 32);
+	values[0] = immature.value;
+	block->transactions[2] = makeTx(&immature, 1, values, 1);
+	block->transactionNum = 3;
+	if (! checkInvalid(&store, block, spent, 2) || ! CBCoinStoreGet(&store, immature.hash, 0)) {
+		printf("IMMATURE FAIL\n");
+		return EXIT_FAILURE;
+	}
+	block = makeBlock(store.tip, BLOCK_NUM + 1, pool, &poolNum, 0);
+	block->transactions[0]->outputs[0]->value++;
+	if (! checkInvalid(&store, block, spent, 4)) {
+		printf("COINBASE VALUE FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// A failed flush leaves the block connected and is not reported as an invalid block.
+	block = makeBlock(store.tip, BLOCK_NUM + 1, pool, &poolNum, 0);
+	CBDepObject logFile = store.logFile;
+	if (! CBFileOpen(&store.logFile, "/dev/full", false)) {
+		printf("OPEN FULL FAIL\n");
+		return EXIT_FAILURE;
+	}
+	store.cacheLimit = 0;
+	CBCoinStoreResult res = CBCoinStoreConnectBlock(&store, block, BLOCK_NUM + 1);
+	CBFileClose(store.logFile);
+	store.logFile = logFile;
+	store.cacheLimit = LARGE_CACHE;
+	if (res != CB_COIN_STORE_FLUSH_ERROR
+		|| memcmp(store.tip, CBBlockGetHash(block), 32)
+		|| ! CBCoinStoreFlush(&store)
+		|| memcmp(store.indexHeader->tip, CBBlockGetHash(block), 32)
+		|| CBCoinStoreDisconnectBlock(&store, block) != CB_COIN_STORE_OK
+		|| ! CBCoinStoreFlush(&store)) {
+		printf("FLUSH ERROR FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBReleaseObject(block);
+	// Reopen
+	CBDestroyCoinStore(&store);
+	struct timespec begin;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	if (! CBInitCoinStore(&store, dir, LARGE_CACHE)) {
+		printf("REOPEN FAIL\n");
+		return EXIT_FAILURE;
+	}
+	printf("Reopen: %f ms for %llu coins\n", elapsed(&begin), (unsigned long long int)store.indexHeader->coinNum);
+	if (store.indexHeader->coinNum != SEED_NUM + BLOCK_NUM
+		|| memcmp(store.tip, CBBlockGetHash(blocks[BLOCK_NUM - 1]), 32)
+		|| ! checkCoins(&store, endPool, poolNum)) {
+		printf("REOPEN COINS FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Disconnect back to the middle, and connect again.
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (int x = BLOCK_NUM - 1; x >= BLOCK_NUM / 2; x--)
+		if (CBCoinStoreDisconnectBlock(&store, blocks[x]) != CB_COIN_STORE_OK) {
+			printf("DISCONNECT FAIL %i\n", x);
+			return EXIT_FAILURE;
+		}
+	printf("Disconnect: %.0f tx/s\n", BLOCK_NUM / 2 * TX_NUM / elapsed(&begin) * 1000);
+	if (! CBCoinStoreFlush(&store)
+		|| store.indexHeader->coinNum != SEED_NUM + BLOCK_NUM / 2
+		|| memcmp(store.tip, CBBlockGetHash(blocks[BLOCK_NUM / 2 - 1]), 32)
+		|| ! checkCoins(&store, middlePool, middleNum)
+		|| CBCoinStoreGet(&store, endPool[poolNum - 1].hash, endPool[poolNum - 1].index)) {
+		printf("DISCONNECT COINS FAIL\n");
+		return EXIT_FAILURE;
+	}
+	if (CBCoinStoreDisconnectBlock(&store, blocks[BLOCK_NUM - 1]) != CB_COIN_STORE_ERROR) {
+		printf("DISCONNECT NOT TIP FAIL\n");
+		return EXIT_FAILURE;
+	}
+	if (! connectBlocks(&store, blocks, BLOCK_NUM / 2, BLOCK_NUM, false, "again")
+		|| store.indexHeader->coinNum != SEED_NUM + BLOCK_NUM
+		|| ! checkCoins(&store, endPool, poolNum)) {
+		printf("RECONNECT FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Connect blocks without flushing and lose them with a partly written batch, as if the process crashed.
+	CBBlock * lost[2];
+	for (int x = 0; x < 2; x++) {
+		lost[x] = makeBlock(store.tip, BLOCK_NUM + 1 + x, pool, &poolNum, TX_NUM);
+		if (CBCoinStoreConnectBlock(&store, lost[x], BLOCK_NUM + 1 + x) != CB_COIN_STORE_OK) {
+			printf("CONNECT LOST FAIL\n");
+			return EXIT_FAILURE;
+		}
+	}
+	uint64_t logLength = store.indexHeader->logLength;
+	unsigned char garbage[100];
+	for (int x = 0; x < 100; x++)
+		garbage[x] = rand();
+	CBInt32ToArray(garbage, 0, 50);
+	CBFileWrite(store.logFile, garbage, 100, logLength);
+	closeWithoutFlush(&store);
+	if (! CBInitCoinStore(&store, dir, LARGE_CACHE)) {
+		printf("CRASH REOPEN FAIL\n");
+		return EXIT_FAILURE;
+	}
+	uint64_t length;
+	if (memcmp(store.tip, CBBlockGetHash(blocks[BLOCK_NUM - 1]), 32)
+		|| store.indexHeader->coinNum != SEED_NUM + BLOCK_NUM
+		|| ! CBFileGetLength(store.logFile, &length) || length != logLength
+		|| ! checkCoins(&store, endPool, SEED_NUM)) {
+		printf("CRASH RECOVERY FAIL\n");
+		return EXIT_FAILURE;
+	}
+	for (int x = 0; x < 2; x++)
+		CBReleaseObject(lost[x]);
+	// A table which was being changed is made again from the log
+	store.indexHeader->clean = 0;
+	closeWithoutFlush(&store);
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	if (! CBInitCoinStore(&store, dir, LARGE_CACHE)) {
+		printf("REBUILD FAIL\n");
+		return EXIT_FAILURE;
+	}
+	printf("Rebuild: %f ms\n", elapsed(&begin));
+	if (memcmp(store.tip, CBBlockGetHash(blocks[BLOCK_NUM - 1]), 32)
+		|| store.indexHeader->coinNum != SEED_NUM + BLOCK_NUM
+		|| ! checkCoins(&store, endPool, SEED_NUM)
+		|| CBCoinStoreDisconnectBlock(&store, blocks[BLOCK_NUM - 1]) != CB_COIN_STORE_OK) {
+		printf("REBUILD COINS FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// A log which lost its last batch makes the table again to the tip of the log.
+	uint64_t shortLength = 0;
+	if (! CBCoinStoreFlush(&store)
+		|| ! (shortLength = store.indexHeader->logLength)
+		|| CBCoinStoreConnectBlock(&store, blocks[BLOCK_NUM - 1], BLOCK_NUM) != CB_COIN_STORE_OK
+		|| ! CBCoinStoreFlush(&store)) {
+		printf("SHORT LOG CONNECT FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBDestroyCoinStore(&store);
+	char filename[sizeof(dir) + 20];
+	sprintf(filename, "%s/coins.dat", dir);
+	if (truncate(filename, shortLength)) {
+		printf("TRUNCATE FAIL\n");
+		return EXIT_FAILURE;
+	}
+	if (! CBInitCoinStore(&store, dir, LARGE_CACHE)
+		|| memcmp(store.tip, CBBlockGetHash(blocks[BLOCK_NUM - 2]), 32)
+		|| store.indexHeader->logLength != shortLength
+		|| store.indexHeader->coinNum != SEED_NUM + BLOCK_NUM - 1) {
+		printf("SHORT LOG FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBDestroyCoinStore(&store);
+	sprintf(filename, "%s/coins.dat", dir);
+	unlink(filename);
+	sprintf(filename, "%s/coinIndex.dat", dir);
+	unlink(filename);
+	sprintf(filename, "%s/coinUndo.dat", dir);
+	unlink(filename);
+	rmdir(dir);
+	for (int x = 0; x < BLOCK_NUM; x++)
+		CBReleaseObject(blocks[x]);
+	free(pool);
+	free(middlePool);
+	free(endPool);
+	return EXIT_SUCCESS;
+}
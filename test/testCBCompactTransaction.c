@@ -0,0 +1,152 @@
+//
+//  testCBCompactTransaction.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+#include <stdio.h>
+#include <time.h>
+#include "CBCompactTransaction.h"
+#include "CBValidationFunctions.h"
+#include "stdarg.h"
+
+void CBLogError(char * format, ...);
+void CBLogError(char * format, ...){
+	va_list argptr;
+	va_start(argptr, format);
+	vfprintf(stderr, format, argptr);
+	va_end(argptr);
+	printf("\n");
+}
+
+CBScript * randomScript(void);
+CBScript * randomScript(void){
+	int len = rand() % 300;
+	if (len > 200)
+		len = 0;
+	CBScript * script = CBNewScriptOfSize(len);
+	for (int x = 0; x < len; x++) {
+		// Use plenty of CHECKSIG and CHECKMULTISIG operations so that sigops are counted.
+		int r = rand() % 4;
+		CBByteArraySetByte(script, x, r == 0 ? CB_SCRIPT_OP_CHECKSIG : (r == 1 ? CB_SCRIPT_OP_CHECKMULTISIG : CB_SCRIPT_OP_NOP));
+	}
+	return script;
+}
+
+int main(){
+	unsigned int s = (unsigned int)time(NULL);
+	s = 1413590400;
+	printf("Session = %ui\n", s);
+	srand(s);
+	for (int t = 0; t < 200; t++) {
+		CBTransaction * tx = CBNewTransaction(rand() % 3 ? 0 : rand() % 1000, 1);
+		int inputNum = 1 + rand() % 10, outputNum = 1 + rand() % 10;
+		for (int x = 0; x < inputNum; x++) {
+			unsigned char hash[32];
+			for (int y = 0; y < 32; y++)
+				hash[y] = t % 10 == 0 ? 0 : rand();
+			CBByteArray * prevOut = CBNewByteArrayWithDataCopy(hash, 32);
+			CBScript * script = randomScript();
+			CBTransactionTakeInput(tx, CBNewTransactionInput(script, rand() % 2 ? CB_TX_INPUT_FINAL : 0, prevOut, t % 10 == 1 ? 0 : rand()));
+			CBReleaseObject(prevOut);
+			CBReleaseObject(script);
+		}
+		for (int x = 0; x < outputNum; x++) {
+			CBScript * script = randomScript();
+			long long int value = t % 10 == 2 ? CB_MAX_MONEY / 2 + 1 : rand();
+			CBTransactionTakeOutput(tx, CBNewTransactionOutput(value, script));
+			CBReleaseObject(script);
+		}
+		CBTransactionPrepareBytes(tx);
+		CBTransactionSerialise(tx, false);
+		CBCompactTransaction * compact = CBNewCompactTransactionFromTransaction(tx);
+		if (! compact) {
+			printf("NEW COMPACT FAIL %i\n", t);
+			return EXIT_FAILURE;
+		}
+		// Check the fields
+		if (compact->inputNum != inputNum || compact->outputNum != outputNum
+			|| compact->length != CBGetMessage(tx)->bytes->length
+			|| compact->lockTime != (uint32_t)tx->lockTime || compact->version != tx->version) {
+			printf("COMPACT FIELDS FAIL %i\n", t);
+			return EXIT_FAILURE;
+		}
+		for (int x = 0; x < inputNum; x++) {
+			CBTransactionInput * input = tx->inputs[x];
+			if (memcmp(CBCompactInputPrevOutHash(compact, x), CBByteArrayGetData(input->prevOut.hash), 32)
+				|| compact->inputs[x].prevOutIndex != input->prevOut.index
+				|| compact->inputs[x].sequence != input->sequence
+				|| compact->inputs[x].scriptLength != (uint32_t)input->scriptObject->length
+				|| memcmp(CBCompactInputScript(compact, x), CBByteArrayGetData(input->scriptObject), input->scriptObject->length)) {
+				printf("COMPACT INPUT FAIL %i %i\n", t, x);
+				return EXIT_FAILURE;
+			}
+		}
+		for (int x = 0; x < outputNum; x++) {
+			CBTransactionOutput * output = tx->outputs[x];
+			if (compact->outputs[x].value != output->value
+				|| compact->outputs[x].scriptLength != (uint32_t)output->scriptObject->length
+				|| memcmp(CBCompactOutputScript(compact, x), CBByteArrayGetData(output->scriptObject), output->scriptObject->length)) {
+				printf("COMPACT OUTPUT FAIL %i %i\n", t, x);
+				return EXIT_FAILURE;
+			}
+		}
+		if (memcmp(CBCompactTransactionGetHash(compact), CBTransactionGetHash(tx), 32)) {
+			printf("COMPACT HASH FAIL %i\n", t);
+			return EXIT_FAILURE;
+		}
+		// Validation must agree
+		if (CBCompactTransactionGetSigOps(compact) != CBTransactionGetSigOps(tx)) {
+			printf("SIGOPS FAIL %i\n", t);
+			return EXIT_FAILURE;
+		}
+		for (int x = 0; x < 2; x++) {
+			long long int value1 = 0, value2 = 0;
+			bool res1 = CBCompactTransactionValidateBasic(compact, x, &value1);
+			bool res2 = CBTransactionValidateBasic(tx, x, &value2);
+			if (res1 != res2 || (res1 && value1 != value2)) {
+				printf("VALIDATE BASIC FAIL %i %i\n", t, x);
+				return EXIT_FAILURE;
+			}
+		}
+		if (CBCompactTransactionIsFinal(compact, 500, 500) != CBTransactionIsFinal(tx, 500, 500)) {
+			printf("IS FINAL FAIL %i\n", t);
+			return EXIT_FAILURE;
+		}
+		// Convert back
+		CBTransaction * tx2 = CBCompactTransactionToTransaction(compact);
+		CBTransactionPrepareBytes(tx2);
+		CBTransactionSerialise(tx2, true);
+		if (CBByteArrayCompare(CBGetMessage(tx)->bytes, CBGetMessage(tx2)->bytes) != CB_COMPARE_EQUAL) {
+			printf("ROUND TRIP FAIL %i\n", t);
+			return EXIT_FAILURE;
+		}
+		// Truncated data must be rejected
+		int len = rand() % compact->length;
+		if (CBNewCompactTransactionFromData(CBByteArrayGetData(CBGetMessage(tx)->bytes), len)) {
+			printf("TRUNCATED FAIL %i %i\n", t, len);
+			return EXIT_FAILURE;
+		}
+		CBReleaseObject(tx2);
+		CBReleaseObject(compact);
+		CBReleaseObject(tx);
+	}
+	// A bad script length must be rejected
+	unsigned char bad[60] = {1, 0, 0, 0, 1};
+	bad[41] = 0xFE;
+	bad[42] = 0xFF;
+	bad[43] = 0xFF;
+	if (CBNewCompactTransactionFromData(bad, 60)) {
+		printf("BAD SCRIPT LENGTH FAIL\n");
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,287 @@
+//
+//  testCBConnectionRacing.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "CBNetworkCommunicator.h"
+
+#define SLOW_PORT 45580 // Accepts no more connections, so connecting hangs.
+#define FAST_PORT 45581
+#define REFUSED_PORT 45582
+
+pthread_mutex_t connectedMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t connectedCond = PTHREAD_COND_INITIALIZER;
+int connectedPort = 0;
+
+long long int CBGetMilliseconds(void){
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+void onPeerConnection(CBNetworkCommunicator * comm, CBPeer * peer);
+void onPeerConnection(CBNetworkCommunicator * comm, CBPeer * peer){
+	UNUSED(comm);
+	pthread_mutex_lock(&connectedMutex);
+	connectedPort = peer->addr->sockAddr.port;
+	pthread_cond_signal(&connectedCond);
+	pthread_mutex_unlock(&connectedMutex);
+}
+bool acceptType(CBNetworkCommunicator * comm, CBPeer * peer, CBMessageType type);
+bool acceptType(CBNetworkCommunicator * comm, CBPeer * peer, CBMessageType type){
+	UNUSED(comm && peer && type);
+	return true;
+}
+CBOnMessageReceivedAction onMessageReceived(CBNetworkCommunicator * comm, CBPeer * peer, CBMessage * message);
+CBOnMessageReceivedAction onMessageReceived(CBNetworkCommunicator * comm, CBPeer * peer, CBMessage * message){
+	UNUSED(comm && peer && message);
+	return CB_MESSAGE_ACTION_CONTINUE;
+}
+void onNetworkError(CBNetworkCommunicator * comm, CBErrorReason reason);
+void onNetworkError(CBNetworkCommunicator * comm, CBErrorReason reason){
+	UNUSED(comm && reason);
+	printf("NETWORK ERROR FAIL\n");
+	exit(EXIT_FAILURE);
+}
+void onBadTime(void * foo);
+void onBadTime(void * foo){
+	UNUSED(foo);
+	printf("BAD TIME FAIL\n");
+	exit(EXIT_FAILURE);
+}
+
+int listenOn(int port, int backlog);
+int listenOn(int port, int backlog){
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	struct sockaddr_in addr = {0};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, backlog)) {
+		printf("LISTEN %i FAIL\n", port);
+		exit(EXIT_FAILURE);
+	}
+	return fd;
+}
+
+bool connectHangs(int port, int * fd);
+bool connectHangs(int port, int * fd){
+	// Connects without accepting, returning true if the connection does not complete.
+	*fd = socket(AF_INET, SOCK_STREAM, 0);
+	fcntl(*fd, F_SETFL, O_NONBLOCK);
+	struct sockaddr_in addr = {0};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	if (! connect(*fd, (struct sockaddr *)&addr, sizeof(addr)) || errno != EINPROGRESS)
+		return false;
+	struct pollfd pfd = {*fd, POLLOUT, 0};
+	return poll(&pfd, 1, 100) == 0;
+}
+
+CBNetworkAddress * newAddress(int port, int latency, int attempts, int successes);
+CBNetworkAddress * newAddress(int port, int latency, int attempts, int successes){
+	CBByteArray * ip = CBNewByteArrayWithDataCopy((unsigned char [16]){0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF, 127, 0, 0, 1}, 16);
+	CBNetworkAddress * addr = CBNewNetworkAddress(time(NULL), (CBSocketAddress){ip, port}, 0, true);
+	CBReleaseObject(ip);
+	addr->connectLatency = latency;
+	addr->connectAttempts = attempts;
+	addr->connectSuccesses = successes;
+	return addr;
+}
+
+CBNetworkCommunicator * newCommunicator(CBNetworkAddress * first, CBNetworkAddress * second);
+CBNetworkCommunicator * newCommunicator(CBNetworkAddress * first, CBNetworkAddress * second){
+	CBNetworkCommunicatorCallbacks callbacks = {onPeerConnection, acceptType, onMessageReceived, onNetworkError};
+	CBNetworkCommunicator * comm = CBNewNetworkCommunicator(0, callbacks);
+	CBNetworkAddressManager * addrMan = CBNewNetworkAddressManager(onBadTime);
+	addrMan->callbackHandler = comm;
+	CBNetworkAddressManagerAddAddress(addrMan, first);
+	CBNetworkAddressManagerAddAddress(addrMan, second);
+	CBNetworkCommunicatorSetNetworkAddressManager(comm, addrMan);
+	CBReleaseObject(addrMan);
+	CBNetworkCommunicatorSetReachability(comm, CB_IP_IP4 | CB_IP_LOCAL, true);
+	// Connections begin with a version message, which the listeners ignore.
+	CBByteArray * ip = CBNewByteArrayWithDataCopy((unsigned char [16]){0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF, 127, 0, 0, 1}, 16);
+	CBNetworkAddress * ourAddr = CBNewNetworkAddress(0, (CBSocketAddress){ip, 45583}, 0, false);
+	CBReleaseObject(ip);
+	CBNetworkCommunicatorSetOurIPv4(comm, ourAddr);
+	CBReleaseObject(ourAddr);
+	CBByteArray * userAgent = CBNewByteArrayFromString(CB_USER_AGENT_SEGMENT, false);
+	CBNetworkCommunicatorSetUserAgent(comm, userAgent);
+	CBReleaseObject(userAgent);
+	comm->networkID = CB_PRODUCTION_NETWORK_BYTES;
+	comm->version = CB_PONG_VERSION;
+	comm->flags = CB_NETWORK_COMMUNICATOR_AUTO_HANDSHAKE;
+	comm->maxConnections = 1;
+	comm->raceConnections = 1;
+	comm->connectionTimeOut = 5000;
+	return comm;
+}
+
+void tryConnections(void * comm);
+void tryConnections(void * comm){
+	CBNetworkCommunicatorTryConnections(comm, false);
+}
+void stop(void * comm);
+void stop(void * comm){
+	CBNetworkCommunicatorStop(comm);
+}
+
+long long int waitForConnection(CBNetworkCommunicator * comm, int port);
+long long int waitForConnection(CBNetworkCommunicator * comm, int port){
+	long long int start = CBGetMilliseconds();
+	pthread_mutex_lock(&connectedMutex);
+	connectedPort = 0;
+	pthread_mutex_unlock(&connectedMutex);
+	CBRunOnEventLoop(comm->eventLoop, tryConnections, comm, true);
+	struct timespec until;
+	clock_gettime(CLOCK_REALTIME, &until);
+	until.tv_sec += 3;
+	pthread_mutex_lock(&connectedMutex);
+	while (! connectedPort)
+		if (pthread_cond_timedwait(&connectedCond, &connectedMutex, &until)) {
+			printf("NO CONNECTION FAIL\n");
+			exit(EXIT_FAILURE);
+		}
+	if (connectedPort != port) {
+		printf("CONNECTED TO %i NOT %i FAIL\n", connectedPort, port);
+		exit(EXIT_FAILURE);
+	}
+	pthread_mutex_unlock(&connectedMutex);
+	return CBGetMilliseconds() - start;
+}
+
+CBNetworkCommunicator * checkComm;
+int checkConnecting, checkAttempting;
+void getCounts(void * unused);
+void getCounts(void * unused){
+	UNUSED(unused);
+	checkConnecting = checkComm->connectingNum;
+	checkAttempting = checkComm->attemptingOrWorkingConnections;
+}
+void checkCounts(CBNetworkCommunicator * comm, char * test);
+void checkCounts(CBNetworkCommunicator * comm, char * test){
+	checkComm = comm;
+	CBRunOnEventLoop(comm->eventLoop, getCounts, NULL, true);
+	if (checkConnecting || checkAttempting != 1) {
+		printf("%s COUNTS %i %i FAIL\n", test, checkConnecting, checkAttempting);
+		exit(EXIT_FAILURE);
+	}
+}
+
+int main(){
+	// Addresses are ranked by the expected time to connect.
+	CBNetworkAddress * reliable = newAddress(1, 100, 10, 10);
+	CBNetworkAddress * unknown = newAddress(2, 0, 0, 0);
+	CBNetworkAddress * unreliable = newAddress(3, 100, 10, 0);
+	CBNetworkAddress * ranked[3] = {unreliable, unknown, reliable};
+	qsort(ranked, 3, sizeof(*ranked), CBNetworkAddressCompareConnectScore);
+	if (ranked[0] != reliable || ranked[1] != unknown || ranked[2] != unreliable) {
+		printf("RANKING FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBNetworkAddressRecordConnect(unknown, true);
+	CBNetworkAddressRecordConnectLatency(unknown, 40);
+	CBNetworkAddressRecordConnectLatency(unknown, 80);
+	if (unknown->connectAttempts != 1 || unknown->connectSuccesses != 1 || unknown->connectLatency != 50) {
+		printf("RECORD FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBReleaseObject(reliable);
+	CBReleaseObject(unknown);
+	CBReleaseObject(unreliable);
+	// Fill the accept queue of the slow listener so further connections hang.
+	int slowFd = listenOn(SLOW_PORT, 0);
+	int fastFd = listenOn(FAST_PORT, 16);
+	int fillers[8], fillerNum = 0;
+	for (;;) {
+		if (fillerNum == 8) {
+			printf("FILL ACCEPT QUEUE FAIL\n");
+			return EXIT_FAILURE;
+		}
+		if (connectHangs(SLOW_PORT, &fillers[fillerNum++]))
+			break;
+	}
+	close(fillers[--fillerNum]);
+	// The slow address has connected quickly before so is tried first. Another is raced against it and the slow attempt is cancelled.
+	CBNetworkAddress * slow = newAddress(SLOW_PORT, 10, 10, 10);
+	CBNetworkAddress * fast = newAddress(FAST_PORT, 0, 0, 0);
+	CBNetworkCommunicator * comm = newCommunicator(slow, fast);
+	long long int elapsed = waitForConnection(comm, FAST_PORT);
+	printf("Raced connection in %lli ms\n", elapsed);
+	// The slow attempt is not waited on until it times out.
+	if (elapsed >= comm->connectionTimeOut) {
+		printf("RACE TIME FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// The slow attempt was made first and cancelled, recording that it took at least the race delay, without counting as a failure.
+	checkCounts(comm, "RACE");
+	if (slow->connectLatency < CB_NETWORK_COMMUNICATOR_RACE_DELAY || slow->connectAttempts != 10
+		|| fast->connectAttempts != 1 || fast->connectSuccesses != 1) {
+		printf("RACE STATISTICS FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBNetworkAddress * got = CBNetworkAddressManagerGotNetworkAddress(comm->addresses, slow);
+	if (! got) {
+		printf("CANCELLED ADDRESS RETURNED FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBReleaseObject(got);
+	if (CBNetworkAddressCompareConnectScore(&fast, &slow) >= 0) {
+		printf("RACE RANKING FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBRunOnEventLoop(comm->eventLoop, stop, comm, true);
+	CBReleaseObject(comm);
+	CBReleaseObject(slow);
+	CBReleaseObject(fast);
+	// A refused connection is replaced straight away. Without racing, the other address is only tried as the replacement.
+	CBNetworkAddress * refused = newAddress(REFUSED_PORT, 10, 10, 10);
+	fast = newAddress(FAST_PORT, 0, 0, 0);
+	comm = newCommunicator(refused, fast);
+	comm->raceConnections = 0;
+	elapsed = waitForConnection(comm, FAST_PORT);
+	printf("Replaced refused connection in %lli ms\n", elapsed);
+	if (elapsed >= comm->connectionTimeOut) {
+		printf("REPLACE TIME FAIL\n");
+		return EXIT_FAILURE;
+	}
+	checkCounts(comm, "REPLACE");
+	if (refused->connectAttempts != 11 || refused->connectSuccesses != 10) {
+		printf("REFUSED STATISTICS FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBRunOnEventLoop(comm->eventLoop, stop, comm, true);
+	CBReleaseObject(comm);
+	CBReleaseObject(refused);
+	CBReleaseObject(fast);
+	for (int x = 0; x < fillerNum; x++)
+		close(fillers[x]);
+	close(slowFd);
+	close(fastFd);
+	return EXIT_SUCCESS;
+}
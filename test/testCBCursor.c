@@ -0,0 +1,231 @@
+//
+//  testCBCursor.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stdarg.h"
+#include "CBCursor.h"
+#include "CBBlock.h"
+#include "CBInventory.h"
+
+#define NUM_RECORDS 200000
+#define NUM_TX 1000
+#define NUM_ITEMS 50000
+#define ROUNDS 20
+
+void CBLogError(char * format, ...);
+void CBLogError(char * format, ...){
+	va_list argptr;
+	va_start(argptr, format);
+	vfprintf(stderr, format, argptr);
+	va_end(argptr);
+	printf("\n");
+}
+
+double elapsed(struct timespec * begin);
+double elapsed(struct timespec * begin){
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - begin->tv_sec) * 1e3 + (end.tv_nsec - begin->tv_nsec) / 1e6;
+}
+
+int main(){
+	unsigned int s = (unsigned int)time(NULL);
+	s = 1413590400;
+	printf("Session = %ui\n", s);
+	srand(s);
+	// Test reads against the CBByteArray functions
+	CBByteArray * bytes = CBNewByteArrayOfSize(40);
+	for (int x = 0; x < 40; x++)
+		CBByteArraySetByte(bytes, x, rand());
+	CBByteArray * sub = CBNewByteArraySubReference(bytes, 3, 37);
+	CBCursor cursor;
+	CBInitCursor(&cursor, sub);
+	if (CBCursorReadByte(&cursor) != CBByteArrayGetByte(sub, 0)
+		|| CBCursorReadInt16(&cursor) != CBByteArrayReadInt16(sub, 1)
+		|| CBCursorReadInt32(&cursor) != (uint32_t)CBByteArrayReadInt32(sub, 3)
+		|| CBCursorReadInt64(&cursor) != (uint64_t)CBByteArrayReadInt64(sub, 7)
+		|| CBCursorReadPort(&cursor) != CBByteArrayReadPort(sub, 15)
+		|| cursor.offset != 17) {
+		printf("READ FAIL\n");
+		return EXIT_FAILURE;
+	}
+	if (! CBCursorHas(&cursor, 20) || CBCursorHas(&cursor, 21)) {
+		printf("HAS FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Var ints of each size, including where they do not fit
+	long long int values[4] = {252, 0xFFFF, 0xFFFFFFFF, 0x100000000};
+	for (int x = 0; x < 4; x++) {
+		CBVarInt varInt = CBVarIntFromUInt64(values[x]);
+		CBByteArraySetVarInt(sub, 0, varInt);
+		CBInitCursor(&cursor, sub);
+		CBVarInt result;
+		if (! CBCursorReadVarInt(&cursor, &result) || result.val != values[x] || result.size != varInt.size || cursor.offset != varInt.size) {
+			printf("VAR INT FAIL %i\n", x);
+			return EXIT_FAILURE;
+		}
+		CBInitCursor(&cursor, sub);
+		cursor.length = varInt.size - 1;
+		if (CBCursorReadVarInt(&cursor, &result) || cursor.offset != 0) {
+			printf("TRUNCATED VAR INT FAIL %i\n", x);
+			return EXIT_FAILURE;
+		}
+	}
+	CBReleaseObject(sub);
+	CBReleaseObject(bytes);
+	// Benchmark reading records of a 32-bit integer, a var int and a 64-bit integer.
+	bytes = CBNewByteArrayOfSize(NUM_RECORDS * 21);
+	int length = 0;
+	for (int x = 0; x < NUM_RECORDS; x++) {
+		CBByteArraySetInt32(bytes, length, rand());
+		length += 4;
+		CBVarInt varInt = CBVarIntFromUInt64(rand() % 4 ? rand() % 253 : rand());
+		CBByteArraySetVarInt(bytes, length, varInt);
+		length += varInt.size;
+		CBByteArraySetInt64(bytes, length, ((uint64_t)rand() << 32) | rand());
+		length += 8;
+	}
+	bytes->length = length;
+	uint64_t sum1 = 0, sum2 = 0;
+	struct timespec begin;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (int x = 0; x < ROUNDS; x++)
+		for (int offset = 0; offset < length;) {
+			sum1 += (uint32_t)CBByteArrayReadInt32(bytes, offset);
+			CBVarInt varInt = CBByteArrayReadVarInt(bytes, offset + 4);
+			sum1 += varInt.val;
+			sum1 += CBByteArrayReadInt64(bytes, offset + 4 + varInt.size);
+			offset += 12 + varInt.size;
+		}
+	double byteArrayTime = elapsed(&begin) / ROUNDS;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (int x = 0; x < ROUNDS; x++) {
+		CBInitCursor(&cursor, bytes);
+		while (CBCursorHas(&cursor, 1)) {
+			sum2 += CBCursorReadInt32(&cursor);
+			CBVarInt varInt;
+			CBCursorReadVarInt(&cursor, &varInt);
+			sum2 += varInt.val;
+			sum2 += CBCursorReadInt64(&cursor);
+		}
+	}
+	double cursorTime = elapsed(&begin) / ROUNDS;
+	if (sum1 != sum2) {
+		printf("RECORD SUM FAIL\n");
+		return EXIT_FAILURE;
+	}
+	printf("Reading %i records: CBByteArray %.3fms, CBCursor %.3fms.\n", NUM_RECORDS, byteArrayTime, cursorTime);
+	CBReleaseObject(bytes);
+	// Benchmark serialising and deserialising a block
+	CBBlock * block = CBNewBlock();
+	block->version = 2;
+	block->prevBlockHash = CBNewByteArrayOfSize(32);
+	block->merkleRoot = CBNewByteArrayOfSize(32);
+	memset(CBByteArrayGetData(block->prevBlockHash), 0, 32);
+	memset(CBByteArrayGetData(block->merkleRoot), 0, 32);
+	block->target = 0x1D00FFFF;
+	block->time = 1413590400;
+	block->nonce = 0;
+	block->transactionNum = NUM_TX;
+	block->transactions = malloc(sizeof(*block->transactions) * NUM_TX);
+	for (int x = 0; x < NUM_TX; x++) {
+		block->transactions[x] = CBNewTransaction(0, 1);
+		for (int y = 0; y < 2; y++) {
+			CBByteArray * hash = CBNewByteArrayOfSize(32);
+			CBScript * script = CBNewScriptOfSize(107);
+			for (int z = 0; z < 32; z++)
+				CBByteArrayGetData(hash)[z] = rand();
+			for (int z = 0; z < 107; z++)
+				CBByteArrayGetData(script)[z] = rand();
+			CBTransactionTakeInput(block->transactions[x], CBNewTransactionInputTakeScriptAndHash(script, CB_TX_INPUT_FINAL, hash, y));
+			script = CBNewScriptOfSize(25);
+			for (int z = 0; z < 25; z++)
+				CBByteArrayGetData(script)[z] = rand();
+			CBTransactionTakeOutput(block->transactions[x], CBNewTransactionOutputTakeScript(rand(), script));
+		}
+	}
+	bytes = CBNewByteArrayOfSize(CBBlockCalculateLength(block, true));
+	CBGetMessage(block)->bytes = bytes;
+	CBRetainObject(bytes);
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (int x = 0; x < ROUNDS; x++)
+		if (CBBlockSerialise(block, true, true) != bytes->length) {
+			printf("BLOCK SERIALISE FAIL\n");
+			return EXIT_FAILURE;
+		}
+	double serialiseTime = elapsed(&begin) / ROUNDS;
+	unsigned char hash[32];
+	memcpy(hash, CBTransactionGetHash(block->transactions[NUM_TX - 1]), 32);
+	CBReleaseObject(block);
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (int x = 0; x < ROUNDS; x++) {
+		block = CBNewBlockFromData(bytes);
+		if (CBBlockDeserialise(block, true) != bytes->length
+			|| memcmp(CBTransactionGetHash(block->transactions[NUM_TX - 1]), hash, 32)) {
+			printf("BLOCK DESERIALISE FAIL\n");
+			return EXIT_FAILURE;
+		}
+		CBReleaseObject(block);
+	}
+	double deserialiseTime = elapsed(&begin) / ROUNDS;
+	printf("Block of %i transactions: serialise %.3fms, deserialise %.3fms.\n", NUM_TX, serialiseTime, deserialiseTime);
+	// Truncated blocks must fail
+	for (int x = 0; x < 100; x++) {
+		CBByteArray * truncated = CBNewByteArraySubReference(bytes, 0, rand() % bytes->length);
+		block = CBNewBlockFromData(truncated);
+		if (CBBlockDeserialise(block, true) != CB_DESERIALISE_ERROR) {
+			printf("TRUNCATED BLOCK FAIL\n");
+			return EXIT_FAILURE;
+		}
+		CBReleaseObject(block);
+		CBReleaseObject(truncated);
+	}
+	CBReleaseObject(bytes);
+	// Benchmark serialising and deserialising an inventory
+	CBInventory * inv = CBNewInventory();
+	for (int x = 0; x < NUM_ITEMS; x++) {
+		CBByteArray * itemHash = CBNewByteArrayOfSize(32);
+		for (int y = 0; y < 32; y++)
+			CBByteArrayGetData(itemHash)[y] = rand();
+		CBInventoryTakeInventoryItem(inv, CBNewInventoryItem(CB_INVENTORY_ITEM_TX, itemHash));
+		CBReleaseObject(itemHash);
+	}
+	CBInventoryPrepareBytes(inv);
+	bytes = CBGetMessage(inv)->bytes;
+	CBRetainObject(bytes);
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (int x = 0; x < ROUNDS; x++)
+		if (CBInventorySerialise(inv, true) != bytes->length) {
+			printf("INVENTORY SERIALISE FAIL\n");
+			return EXIT_FAILURE;
+		}
+	serialiseTime = elapsed(&begin) / ROUNDS;
+	CBReleaseObject(inv);
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (int x = 0; x < ROUNDS; x++) {
+		inv = CBNewInventoryFromData(bytes);
+		if (CBInventoryDeserialise(inv) != bytes->length || inv->itemNum != NUM_ITEMS) {
+			printf("INVENTORY DESERIALISE FAIL\n");
+			return EXIT_FAILURE;
+		}
+		CBReleaseObject(inv);
+	}
+	deserialiseTime = elapsed(&begin) / ROUNDS;
+	printf("Inventory of %i items: serialise %.3fms, deserialise %.3fms.\n", NUM_ITEMS, serialiseTime, deserialiseTime);
+	CBReleaseObject(bytes);
+	return EXIT_SUCCESS;
+}
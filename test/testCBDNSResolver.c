@@ -0,0 +1,313 @@
+//
+//  testCBDNSResolver.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "CBDNSResolver.h"
+
+#define SEED_NUM 4 // The number of resolver threads, so all seeds are resolved at once.
+#define MAX_HELD 16
+
+// A stub DNS server. A queries are not answered until A queries for all of the seeds have been received, which only happens if the seeds are resolved at the same time.
+
+typedef struct{
+	unsigned char query[512];
+	int len;
+	struct sockaddr_in from;
+} HeldQuery;
+
+int serverFd;
+bool release = false; // Answer the A queries for the seeds.
+bool holdAll = false; // Hold the A queries of any domain.
+int queries[SEED_NUM]; // The number of A queries for each seed. Queries are only sent again when they are not answered in time.
+HeldQuery held[MAX_HELD];
+int heldNum = 0;
+pthread_mutex_t serverMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t heldCond = PTHREAD_COND_INITIALIZER;
+
+long long int CBGetMilliseconds(void){
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+int putRecord(unsigned char * buf, int len, uint16_t type, unsigned char * data, int dataLen);
+int putRecord(unsigned char * buf, int len, uint16_t type, unsigned char * data, int dataLen){
+	// Named with a pointer to the question.
+	unsigned char record[10] = {0xC0, 12, type >> 8, type, 0, 1, 0, 0, 1, 0};
+	memcpy(buf + len, record, 10);
+	len += 10;
+	buf[len++] = dataLen >> 8;
+	buf[len++] = dataLen;
+	memcpy(buf + len, data, dataLen);
+	return len + dataLen;
+}
+
+void answer(unsigned char * query, int len, struct sockaddr_in * to);
+void answer(unsigned char * query, int len, struct sockaddr_in * to){
+	unsigned char buf[512];
+	memcpy(buf, query, len);
+	char name[256];
+	int pos = 12, nameLen = 0;
+	while (query[pos]) {
+		if (nameLen)
+			name[nameLen++] = '.';
+		memcpy(name + nameLen, query + pos + 1, query[pos]);
+		nameLen += query[pos];
+		pos += query[pos] + 1;
+	}
+	name[nameLen] = '\0';
+	uint16_t type = query[pos + 1] << 8 | query[pos + 2];
+	buf[2] |= 0x80;
+	buf[3] = 0x80;
+	int answers = 0;
+	if (! strcmp(name, "missing.test"))
+		// NXDOMAIN
+		buf[3] |= 3;
+	else if (type == 1 && ! strncmp(name, "seed", 4)) {
+		unsigned char seed = name[4] - '0';
+		if (seed == 0) {
+			// A CNAME before the addresses.
+			len = putRecord(buf, len, 5, (unsigned char []){5, 's', 'e', 'e', 'd', 'x', 0xC0, 12}, 8);
+			answers++;
+		}
+		len = putRecord(buf, len, 1, (unsigned char []){20 + seed, 1, 2, 3}, 4);
+		len = putRecord(buf, len, 1, (unsigned char []){20 + seed, 4, 5, 6}, 4);
+		answers += 2;
+	}else if (type == 1 && ! strcmp(name, "late.test")) {
+		len = putRecord(buf, len, 1, (unsigned char []){30, 1, 2, 3}, 4);
+		answers++;
+	}else if (type == 28 && ! strcmp(name, "seed1.test")) {
+		len = putRecord(buf, len, 28, (unsigned char []){0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1}, 16);
+		answers++;
+	}
+	buf[6] = 0;
+	buf[7] = answers;
+	sendto(serverFd, buf, len, 0, (struct sockaddr *)to, sizeof(*to));
+}
+
+void * server(void * unused);
+void * server(void * unused){
+	UNUSED(unused);
+	for (;;) {
+		HeldQuery query;
+		socklen_t fromLen = sizeof(query.from);
+		query.len = (int)recvfrom(serverFd, query.query, sizeof(query.query), 0, (struct sockaddr *)&query.from, &fromLen);
+		if (query.len < 17)
+			continue;
+		int pos = 12;
+		while (query.query[pos] && pos < query.len)
+			pos += query.query[pos] + 1;
+		uint16_t type = query.query[pos + 1] << 8 | query.query[pos + 2];
+		pthread_mutex_lock(&serverMutex);
+		bool isSeed = ! memcmp(query.query + 13, "seed", 4);
+		if (type == 1 && (holdAll || (isSeed && ! release))) {
+			if (isSeed && ! holdAll)
+				queries[query.query[17] - '0']++;
+			if (heldNum < MAX_HELD)
+				held[heldNum++] = query;
+			pthread_cond_signal(&heldCond);
+			bool all = ! holdAll;
+			for (int x = 0; x < SEED_NUM; x++)
+				all &= queries[x] != 0;
+			if (all) {
+				release = true;
+				for (int x = 0; x < heldNum; x++)
+					answer(held[x].query, held[x].len, &held[x].from);
+				heldNum = 0;
+			}
+		}else{
+			if (type == 1 && isSeed)
+				queries[query.query[17] - '0']++;
+			answer(query.query, query.len, &query.from);
+		}
+		pthread_mutex_unlock(&serverMutex);
+	}
+	return NULL;
+}
+
+void onNetworkError(CBNetworkCommunicator * comm, CBErrorReason reason);
+void onNetworkError(CBNetworkCommunicator * comm, CBErrorReason reason){
+	UNUSED(comm && reason);
+}
+void onBadTime(void * foo);
+void onBadTime(void * foo){
+	UNUSED(foo);
+	printf("BAD TIME FAIL\n");
+	exit(EXIT_FAILURE);
+}
+
+char * domains[SEED_NUM + 1] = {"seed0.test", "seed1.test", "seed2.test", "seed3.test", "missing.test"};
+
+void loadSeeds(void * vcomm);
+void loadSeeds(void * vcomm){
+	CBNetworkCommunicator * comm = vcomm;
+	for (int x = 0; x < SEED_NUM + 1; x++) {
+		if (! CBNetworkCommunicatorLoadDNS(comm, domains[x])) {
+			printf("LOAD DNS FAIL\n");
+			exit(EXIT_FAILURE);
+		}
+		comm->dnsLookups++;
+	}
+}
+
+int lookups;
+void getLookups(void * comm);
+void getLookups(void * comm){
+	lookups = ((CBNetworkCommunicator *)comm)->dnsLookups;
+}
+
+unsigned char checkIP[16];
+bool found;
+void checkAddress(void * comm);
+void checkAddress(void * comm){
+	CBByteArray * ip = CBNewByteArrayWithDataCopy(checkIP, 16);
+	CBNetworkAddress * addr = CBNewNetworkAddress(0, (CBSocketAddress){ip, 8333}, 0, false);
+	CBReleaseObject(ip);
+	CBNetworkAddress * got = CBNetworkAddressManagerGotNetworkAddress(((CBNetworkCommunicator *)comm)->addresses, addr);
+	found = got != NULL;
+	if (got)
+		CBReleaseObject(got);
+	CBReleaseObject(addr);
+}
+
+bool hasIPv4(CBNetworkCommunicator * comm, unsigned char a, unsigned char b, unsigned char c, unsigned char d);
+bool hasIPv4(CBNetworkCommunicator * comm, unsigned char a, unsigned char b, unsigned char c, unsigned char d){
+	memcpy(checkIP, (unsigned char [16]){0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF, a, b, c, d}, 16);
+	CBRunOnEventLoop(comm->eventLoop, checkAddress, comm, true);
+	return found;
+}
+
+void cancel(void * comm);
+void cancel(void * comm){
+	CBNetworkCommunicatorCancelDNS(comm);
+}
+
+void loadLate(void * comm);
+void loadLate(void * comm){
+	if (! CBNetworkCommunicatorLoadDNS(comm, "late.test")) {
+		printf("LOAD LATE DNS FAIL\n");
+		exit(EXIT_FAILURE);
+	}
+	((CBNetworkCommunicator *)comm)->dnsLookups++;
+}
+
+int main(){
+	// Start the stub server on an ephemeral port.
+	serverFd = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in addr = {0};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t addrLen = sizeof(addr);
+	if (bind(serverFd, (struct sockaddr *)&addr, addrLen) || getsockname(serverFd, (struct sockaddr *)&addr, &addrLen)) {
+		printf("STUB SERVER FAIL\n");
+		return EXIT_FAILURE;
+	}
+	char serverStr[32];
+	sprintf(serverStr, "127.0.0.1:%i", ntohs(addr.sin_port));
+	setenv("CB_DNS_SERVER", serverStr, 1);
+	pthread_t serverThread;
+	pthread_create(&serverThread, NULL, server, NULL);
+	// A communicator which does not make connections itself.
+	CBNetworkCommunicatorCallbacks callbacks = {NULL, NULL, NULL, onNetworkError};
+	CBNetworkCommunicator * comm = CBNewNetworkCommunicator(0, callbacks);
+	CBNetworkAddressManager * addrMan = CBNewNetworkAddressManager(onBadTime);
+	addrMan->callbackHandler = comm;
+	CBNetworkCommunicatorSetNetworkAddressManager(comm, addrMan);
+	comm->flags = CB_NETWORK_COMMUNICATOR_INCOMING_ONLY;
+	// Resolve the seeds, which only succeeds when they are resolved at the same time.
+	long long int start = CBGetMilliseconds();
+	CBRunOnEventLoop(comm->eventLoop, loadSeeds, comm, true);
+	do {
+		usleep(10000);
+		CBRunOnEventLoop(comm->eventLoop, getLookups, comm, true);
+		if (CBGetMilliseconds() - start > CB_DNS_TIMEOUT * CB_DNS_ATTEMPTS * 2) {
+			printf("LOOKUPS NOT FINISHED FAIL\n");
+			return EXIT_FAILURE;
+		}
+	} while (lookups);
+	// Resolved one at a time, the queries for a seed would time out and be sent again before the others were sent.
+	for (int x = 0; x < SEED_NUM; x++)
+		if (queries[x] != 1) {
+			printf("CONCURRENT LOOKUPS %i FAIL\n", x);
+			return EXIT_FAILURE;
+		}
+	for (unsigned char x = 0; x < SEED_NUM; x++)
+		if (! hasIPv4(comm, 20 + x, 1, 2, 3) || ! hasIPv4(comm, 20 + x, 4, 5, 6)) {
+			printf("SEED %u ADDRESSES FAIL\n", x);
+			return EXIT_FAILURE;
+		}
+	memcpy(checkIP, (unsigned char []){0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1}, 16);
+	CBRunOnEventLoop(comm->eventLoop, checkAddress, comm, true);
+	if (! found) {
+		printf("IPV6 ADDRESS FAIL\n");
+		return EXIT_FAILURE;
+	}
+	if (comm->addresses->addrNum != SEED_NUM * 2 + 1) {
+		printf("ADDRESS NUM %i FAIL\n", comm->addresses->addrNum);
+		return EXIT_FAILURE;
+	}
+	// Cancelled lookups do not give addresses.
+	pthread_mutex_lock(&serverMutex);
+	holdAll = true;
+	pthread_mutex_unlock(&serverMutex);
+	CBRunOnEventLoop(comm->eventLoop, loadLate, comm, true);
+	// Cancel once the stub server has the query.
+	pthread_mutex_lock(&serverMutex);
+	while (! heldNum)
+		pthread_cond_wait(&heldCond, &serverMutex);
+	pthread_mutex_unlock(&serverMutex);
+	CBRunOnEventLoop(comm->eventLoop, cancel, comm, true);
+	CBRunOnEventLoop(comm->eventLoop, getLookups, comm, true);
+	if (lookups) {
+		printf("CANCEL LOOKUPS FAIL\n");
+		return EXIT_FAILURE;
+	}
+	pthread_mutex_lock(&serverMutex);
+	for (int x = 0; x < heldNum; x++)
+		answer(held[x].query, held[x].len, &held[x].from);
+	heldNum = 0;
+	holdAll = false;
+	pthread_mutex_unlock(&serverMutex);
+	// The answered lookup is removed on the event loop before its result would be given.
+	start = CBGetMilliseconds();
+	for (bool waiting = true; waiting;) {
+		pthread_mutex_lock(&CBDNSMutex);
+		waiting = CBDNSLookups != NULL;
+		pthread_mutex_unlock(&CBDNSMutex);
+		if (waiting) {
+			if (CBGetMilliseconds() - start > CB_DNS_TIMEOUT * CB_DNS_ATTEMPTS * 2) {
+				printf("CANCELLED LOOKUP NOT FINISHED FAIL\n");
+				return EXIT_FAILURE;
+			}
+			usleep(1000);
+		}
+	}
+	CBRunOnEventLoop(comm->eventLoop, getLookups, comm, true);
+	if (lookups || hasIPv4(comm, 30, 1, 2, 3)) {
+		printf("CANCEL FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBReleaseObject(addrMan);
+	CBReleaseObject(comm);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,89 @@
+//
+//  testCBEcdsaVerify.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stdarg.h"
+#include "CBDependencies.h"
+
+#define NUM_KEYS 8
+
+void CBLogError(char * format, ...);
+void CBLogError(char * format, ...){
+	va_list argptr;
+	va_start(argptr, format);
+	vfprintf(stderr, format, argptr);
+	va_end(argptr);
+	printf("\n");
+}
+
+int main(){
+	unsigned int s = (unsigned int)time(NULL);
+	s = 1413590400;
+	printf("Session = %ui\n", s);
+	srand(s);
+	unsigned char privKeys[NUM_KEYS][CB_PRIVKEY_SIZE];
+	unsigned char pubKeys[NUM_KEYS][CB_PUBKEY_SIZE];
+	unsigned char hashes[NUM_KEYS][32];
+	unsigned char sigs[NUM_KEYS][74];
+	int sigLens[NUM_KEYS];
+	for (int x = 0; x < NUM_KEYS; x++) {
+		for (int y = 0; y < CB_PRIVKEY_SIZE; y++)
+			privKeys[x][y] = rand();
+		privKeys[x][0] &= 0x7F; // Keep below the curve order
+		for (int y = 0; y < 32; y++)
+			hashes[x][y] = rand();
+		CBKeyGetPublicKey(privKeys[x], pubKeys[x]);
+		sigLens[x] = CBKeySign(privKeys[x], hashes[x], sigs[x]);
+	}
+	// Use a cache smaller than the number of keys so that entries are evicted and reused.
+	CBDepObject ctx;
+	if (!CBNewEcdsaVerifyContext(&ctx, 3)) {
+		printf("NEW CONTEXT FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Public key whose x coordinate is above the field prime.
+	unsigned char badKey[CB_PUBKEY_SIZE];
+	memset(badKey, 0xFF, CB_PUBKEY_SIZE);
+	badKey[0] = 0x02;
+	for (int x = 0; x < 200; x++) {
+		int i = rand() % NUM_KEYS;
+		if (!CBEcdsaVerifyWithContext(ctx, sigs[i], sigLens[i], hashes[i], pubKeys[i], CB_PUBKEY_SIZE)) {
+			printf("VERIFY FAIL %i AT %i\n", i, x);
+			return EXIT_FAILURE;
+		}
+		int j = (i + 1 + rand() % (NUM_KEYS - 1)) % NUM_KEYS;
+		if (CBEcdsaVerifyWithContext(ctx, sigs[i], sigLens[i], hashes[i], pubKeys[j], CB_PUBKEY_SIZE)) {
+			printf("WRONG KEY VERIFIED %i %i AT %i\n", i, j, x);
+			return EXIT_FAILURE;
+		}
+		if (CBEcdsaVerifyWithContext(ctx, sigs[i], sigLens[i], hashes[j], pubKeys[i], CB_PUBKEY_SIZE)) {
+			printf("WRONG HASH VERIFIED %i %i AT %i\n", i, j, x);
+			return EXIT_FAILURE;
+		}
+		if (x % 7 == 0 && CBEcdsaVerifyWithContext(ctx, sigs[i], sigLens[i], hashes[i], badKey, CB_PUBKEY_SIZE)) {
+			printf("BAD KEY VERIFIED AT %i\n", x);
+			return EXIT_FAILURE;
+		}
+		// The thread-local context must agree.
+		if (!CBEcdsaVerify(sigs[i], sigLens[i], hashes[i], pubKeys[i], CB_PUBKEY_SIZE)) {
+			printf("THREAD CONTEXT VERIFY FAIL %i AT %i\n", i, x);
+			return EXIT_FAILURE;
+		}
+	}
+	CBFreeEcdsaVerifyContext(ctx);
+	return EXIT_SUCCESS;
+}
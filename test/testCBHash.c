@@ -0,0 +1,112 @@
+//
+//  testCBHash.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stdarg.h"
+#include "CBDependencies.h"
+
+void CBLogError(char * format, ...);
+void CBLogError(char * format, ...){
+	va_list argptr;
+	va_start(argptr, format);
+	vfprintf(stderr, format, argptr);
+	va_end(argptr);
+	printf("\n");
+}
+
+int main(){
+	unsigned int s = (unsigned int)time(NULL);
+	s = 1413590400;
+	printf("Session = %ui\n", s);
+	srand(s);
+	unsigned char data[1000];
+	for (int x = 0; x < 1000; x++)
+		data[x] = rand();
+	for (int len = 0; len <= 1000; len += 37) {
+		// Test streaming SHA-256 in random pieces against the one shot function
+		unsigned char expected[64], result[64];
+		unsigned char midstate[CB_SHA512_MIDSTATE_SIZE];
+		CBSha256(data, len, expected);
+		CBSha256Context ctx256, fork256;
+		CBSha256Init(&ctx256);
+		int cursor = 0, split = len ? rand() % len : 0;
+		while (cursor < len) {
+			int piece = rand() % 150;
+			if (piece > len - cursor)
+				piece = len - cursor;
+			if (cursor <= split && cursor + piece > split) {
+				// Fork a copy and carry on with a copy of the midstate too
+				CBSha256Update(&ctx256, data + cursor, split - cursor);
+				fork256 = ctx256;
+				CBSha256GetMidstate(&ctx256, midstate);
+				CBSha256Init(&ctx256);
+				CBSha256SetMidstate(&ctx256, midstate);
+				CBSha256Update(&fork256, data + split, len - split);
+				CBSha256Final(&fork256, result);
+				if (memcmp(result, expected, 32)) {
+					printf("SHA-256 FORK FAIL AT %i\n", len);
+					return EXIT_FAILURE;
+				}
+				piece -= split - cursor;
+				cursor = split;
+			}
+			CBSha256Update(&ctx256, data + cursor, piece);
+			cursor += piece;
+		}
+		CBSha256Final(&ctx256, result);
+		if (memcmp(result, expected, 32)) {
+			printf("SHA-256 STREAM FAIL AT %i\n", len);
+			return EXIT_FAILURE;
+		}
+		// Test SHA-512 with a midstate taken after each piece
+		CBSha512(data, len, expected);
+		CBSha512Context ctx512;
+		CBSha512Init(&ctx512);
+		for (cursor = 0; cursor < len;) {
+			int piece = rand() % 300;
+			if (piece > len - cursor)
+				piece = len - cursor;
+			CBSha512Update(&ctx512, data + cursor, piece);
+			cursor += piece;
+			CBSha512GetMidstate(&ctx512, midstate);
+			CBSha512Init(&ctx512);
+			CBSha512SetMidstate(&ctx512, midstate);
+		}
+		CBSha512Final(&ctx512, result);
+		if (memcmp(result, expected, 64)) {
+			printf("SHA-512 STREAM FAIL AT %i\n", len);
+			return EXIT_FAILURE;
+		}
+	}
+	// Check the midstate format with the SHA-256 initial state after one block of zeros.
+	unsigned char zeros[64] = {0};
+	unsigned char midstate[CB_SHA256_MIDSTATE_SIZE];
+	CBSha256Context ctx;
+	CBSha256Init(&ctx);
+	CBSha256Update(&ctx, zeros, 64);
+	CBSha256Update(&ctx, zeros, 3);
+	CBSha256GetMidstate(&ctx, midstate);
+	if (CBArrayToInt64(midstate, 32) != 67) {
+		printf("MIDSTATE LENGTH FAIL\n");
+		return EXIT_FAILURE;
+	}
+	if (memcmp(midstate, (unsigned char []){0xda, 0x56, 0x98, 0xbe}, 4)) {
+		printf("MIDSTATE STATE FAIL\n");
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
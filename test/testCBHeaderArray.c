@@ -0,0 +1,243 @@
+//
+//  testCBHeaderArray.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stdarg.h"
+#include "CBHeaderArray.h"
+#include "CBBlockHeaders.h"
+
+#define ROUNDS 20
+
+void CBLogError(char * format, ...);
+void CBLogError(char * format, ...){
+	va_list argptr;
+	va_start(argptr, format);
+	vfprintf(stderr, format, argptr);
+	va_end(argptr);
+	printf("\n");
+}
+
+double elapsed(struct timespec * begin);
+double elapsed(struct timespec * begin){
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - begin->tv_sec) * 1e3 + (end.tv_nsec - begin->tv_nsec) / 1e6;
+}
+
+int main(){
+	unsigned int s = (unsigned int)time(NULL);
+	s = 1413590400;
+	printf("Session = %ui\n", s);
+	srand(s);
+	// The first three headers of the main chain
+	unsigned char headers[3][80] = {
+		{0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3B, 0xA3, 0xED, 0xFD, 0x7A, 0x7B, 0x12, 0xB2, 0x7A, 0xC7, 0x2C, 0x3E, 0x67, 0x76, 0x8F, 0x61, 0x7F, 0xC8, 0x1B, 0xC3, 0x88, 0x8A, 0x51, 0x32, 0x3A, 0x9F, 0xB8, 0xAA, 0x4B, 0x1E, 0x5E, 0x4A, 0x29, 0xAB, 0x5F, 0x49, 0xFF, 0xFF, 0x00, 0x1D, 0x1D, 0xAC, 0x2B, 0x7C},
+		{0x01, 0x00, 0x00, 0x00, 0x6F, 0xE2, 0x8C, 0x0A, 0xB6, 0xF1, 0xB3, 0x72, 0xC1, 0xA6, 0xA2, 0x46, 0xAE, 0x63, 0xF7, 0x4F, 0x93, 0x1E, 0x83, 0x65, 0xE1, 0x5A, 0x08, 0x9C, 0x68, 0xD6, 0x19, 0x00, 0x00, 0x00, 0x00, 0x00, 0x98, 0x20, 0x51, 0xFD, 0x1E, 0x4B, 0xA7, 0x44, 0xBB, 0xBE, 0x68, 0x0E, 0x1F, 0xEE, 0x14, 0x67, 0x7B, 0xA1, 0xA3, 0xC3, 0x54, 0x0B, 0xF7, 0xB1, 0xCD, 0xB6, 0x06, 0xE8, 0x57, 0x23, 0x3E, 0x0E, 0x61, 0xBC, 0x66, 0x49, 0xFF, 0xFF, 0x00, 0x1D, 0x01, 0xE3, 0x62, 0x99},
+		{0x01, 0x00, 0x00, 0x00, 0x48, 0x60, 0xEB, 0x18, 0xBF, 0x1B, 0x16, 0x20, 0xE3, 0x7E, 0x94, 0x90, 0xFC, 0x8A, 0x42, 0x75, 0x14, 0x41, 0x6F, 0xD7, 0x51, 0x59, 0xAB, 0x86, 0x68, 0x8E, 0x9A, 0x83, 0x00, 0x00, 0x00, 0x00, 0xD5, 0xFD, 0xCC, 0x54, 0x1E, 0x25, 0xDE, 0x1C, 0x7A, 0x5A, 0xDD, 0xED, 0xF2, 0x48, 0x58, 0xB8, 0xBB, 0x66, 0x5C, 0x9F, 0x36, 0xEF, 0x74, 0x4E, 0xE4, 0x2C, 0x31, 0x60, 0x22, 0xC9, 0x0F, 0x9B, 0xB0, 0xBC, 0x66, 0x49, 0xFF, 0xFF, 0x00, 0x1D, 0x08, 0xD2, 0xBD, 0x61},
+	};
+	// Make a "headers" payload with the headers
+	unsigned char payload[1 + 3 * 82];
+	payload[0] = 3;
+	for (int x = 0; x < 3; x++) {
+		memcpy(payload + 1 + x * 82, headers[x], 80);
+		payload[81 + x * 82] = 0;
+		payload[82 + x * 82] = 0;
+	}
+	CBHeaderArray * array = CBNewHeaderArrayFromPayload(payload, sizeof(payload));
+	if (! array || array->headerNum != 3) {
+		printf("PAYLOAD FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Compare with CBBlock objects
+	CBByteArray * bytes = CBNewByteArrayWithDataCopy(payload, sizeof(payload));
+	CBBlockHeaders * blockHeaders = CBNewBlockHeadersFromData(bytes);
+	if (CBBlockHeadersDeserialise(blockHeaders) != sizeof(payload)) {
+		printf("BLOCK HEADERS DESERIALISE FAIL\n");
+		return EXIT_FAILURE;
+	}
+	for (int x = 0; x < 3; x++) {
+		CBBlock * block = blockHeaders->blockHeaders[x];
+		if (memcmp(CBHeaderArrayGetHash(array, x), CBBlockGetHash(block), 32)) {
+			printf("HASH FAIL %i\n", x);
+			return EXIT_FAILURE;
+		}
+		if (memcmp(CBHeaderArrayGetPrevBlockHash(array, x), CBByteArrayGetData(block->prevBlockHash), 32)
+			|| memcmp(CBHeaderArrayGetMerkleRoot(array, x), CBByteArrayGetData(block->merkleRoot), 32)
+			|| (int)CBHeaderArrayGetVersion(array, x) != block->version
+			|| CBHeaderArrayGetTime(array, x) != block->time
+			|| (int)CBHeaderArrayGetTarget(array, x) != block->target
+			|| CBHeaderArrayGetNonce(array, x) != block->nonce) {
+			printf("FIELD FAIL %i\n", x);
+			return EXIT_FAILURE;
+		}
+		CBBlock * fromArray = CBHeaderArrayGetBlock(array, x);
+		if (memcmp(CBBlockGetHash(fromArray), CBBlockGetHash(block), 32) || fromArray->nonce != block->nonce) {
+			printf("GET BLOCK FAIL %i\n", x);
+			return EXIT_FAILURE;
+		}
+		CBReleaseObject(fromArray);
+	}
+	// Check validation
+	if (CBHeaderArrayFindInvalid(array, NULL) != 3) {
+		printf("VALID FAIL\n");
+		return EXIT_FAILURE;
+	}
+	if (CBHeaderArrayFindInvalid(array, CBHeaderArrayGetHash(array, 1)) != 0) {
+		printf("FIRST PREV HASH FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Appending the headers after themselves breaks the linkage at the genesis block
+	CBHeaderArray * twice = CBNewHeaderArray(1);
+	for (int x = 0; x < 2; x++)
+		if (CBHeaderArrayAppendPayload(twice, payload, sizeof(payload)) != sizeof(payload)) {
+			printf("APPEND PAYLOAD FAIL\n");
+			return EXIT_FAILURE;
+		}
+	if (twice->headerNum != 6 || CBHeaderArrayFindInvalid(twice, NULL) != 3) {
+		printf("APPEND LINKAGE FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBReleaseObject(twice);
+	// Changing the nonce fails the proof of work. The hashes must be recalculated.
+	CBHeaderArray * bad = CBNewHeaderArray(0);
+	for (int x = 0; x < 3; x++)
+		CBHeaderArrayAppendBlock(bad, blockHeaders->blockHeaders[x]);
+	if (bad->hashedNum != 3 || CBHeaderArrayFindInvalid(bad, NULL) != 3) {
+		printf("APPEND BLOCK FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBHeaderArrayGetHeader(bad, 2)[76]++;
+	bad->hashedNum = 2;
+	if (CBHeaderArrayFindInvalid(bad, NULL) != 2) {
+		printf("PROOF OF WORK FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBReleaseObject(bad);
+	// Check bad payloads
+	for (int x = 0; x < (int)sizeof(payload); x++)
+		if (CBNewHeaderArrayFromPayload(payload, x)) {
+			printf("TRUNCATED PAYLOAD FAIL %i\n", x);
+			return EXIT_FAILURE;
+		}
+	payload[82] = 1;
+	if (CBHeaderArrayAppendPayload(array, payload, sizeof(payload)) != CB_DESERIALISE_ERROR || array->headerNum != 3) {
+		printf("NULL BYTE FAIL\n");
+		return EXIT_FAILURE;
+	}
+	payload[82] = 0;
+	// Serialise through CBBlockHeaders
+	CBBlockHeaders * flat = CBNewBlockHeadersFromData(bytes);
+	if (CBBlockHeadersDeserialiseFlat(flat) != sizeof(payload) || flat->headerArray->headerNum != 3) {
+		printf("DESERIALISE FLAT FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBReleaseObject(bytes);
+	CBReleaseObject(flat);
+	flat = CBNewBlockHeaders();
+	flat->headerArray = array;
+	CBBlockHeadersPrepareBytes(flat);
+	if (CBBlockHeadersSerialise(flat, false) != sizeof(payload)
+		|| memcmp(CBByteArrayGetData(CBGetMessage(flat)->bytes), payload, sizeof(payload))) {
+		printf("SERIALISE FLAT FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBReleaseObject(flat);
+	CBReleaseObject(blockHeaders);
+	// Validate a repeated chain across threads with the first invalid header in the first range.
+	CBHeaderArray * repeated = CBNewHeaderArray(0);
+	for (int x = 0; x < 2000; x++)
+		CBHeaderArrayAppend(repeated, headers[x % 3]);
+	for (int threads = 1; threads < 5; threads += 3) {
+		if (CBHeaderArrayValidate(repeated, 0, NULL, threads) != 3) {
+			printf("VALIDATE REPEATED FAIL %i\n", threads);
+			return EXIT_FAILURE;
+		}
+		if (CBHeaderArrayValidate(repeated, 1, NULL, threads) != 3) {
+			printf("VALIDATE FROM ONE FAIL %i\n", threads);
+			return EXIT_FAILURE;
+		}
+		if (CBHeaderArrayValidate(repeated, 3, NULL, threads) != 3) {
+			printf("VALIDATE PREVIOUS FAIL %i\n", threads);
+			return EXIT_FAILURE;
+		}
+		if (CBHeaderArrayValidate(repeated, 3, headers[0] + 4, threads) != 6) {
+			printf("VALIDATE PREV HASH FAIL %i\n", threads);
+			return EXIT_FAILURE;
+		}
+		if (CBHeaderArrayValidate(repeated, 1999, NULL, threads) != 2000) {
+			printf("VALIDATE LAST FAIL %i\n", threads);
+			return EXIT_FAILURE;
+		}
+		CBHeaderArrayGetHeader(repeated, 1)[76]++;
+		repeated->hashedNum = 0;
+		if (CBHeaderArrayValidate(repeated, 0, NULL, threads) != 1) {
+			printf("VALIDATE PROOF OF WORK FAIL %i\n", threads);
+			return EXIT_FAILURE;
+		}
+		CBHeaderArrayGetHeader(repeated, 1)[76]--;
+		if (memcmp(CBHeaderArrayGetHash(repeated, 1998), CBHeaderArrayGetHash(repeated, 0), 32)) {
+			printf("VALIDATE HASHES FAIL %i\n", threads);
+			return EXIT_FAILURE;
+		}
+	}
+	CBReleaseObject(repeated);
+	// Compare the time to deserialise and hash full "headers" messages.
+	unsigned char * big = malloc(3 + 2000 * 82);
+	CBVarInt num = CBVarIntFromUInt64(2000);
+	CBByteArraySetVarIntData(big, 0, num);
+	for (int x = 0; x < 2000; x++) {
+		memcpy(big + num.size + x * 82, headers[x % 3], 80);
+		big[num.size + x * 82 + 80] = 0;
+		big[num.size + x * 82 + 81] = 0;
+	}
+	bytes = CBNewByteArrayWithData(big, num.size + 2000 * 82);
+	struct timespec begin;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (int x = 0; x < ROUNDS; x++) {
+		blockHeaders = CBNewBlockHeadersFromData(bytes);
+		if (CBBlockHeadersDeserialise(blockHeaders) != bytes->length) {
+			printf("BIG BLOCK HEADERS FAIL\n");
+			return EXIT_FAILURE;
+		}
+		for (int y = 0; y < 2000; y++)
+			CBBlockGetHash(blockHeaders->blockHeaders[y]);
+		CBReleaseObject(blockHeaders);
+	}
+	printf("CBBlock headers: %f ms per message\n", elapsed(&begin) / ROUNDS);
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (int x = 0; x < ROUNDS; x++) {
+		array = CBNewHeaderArrayFromPayload(CBByteArrayGetData(bytes), bytes->length);
+		if (! array || array->headerNum != 2000) {
+			printf("BIG HEADER ARRAY FAIL\n");
+			return EXIT_FAILURE;
+		}
+		CBHeaderArrayCalculateHashes(array);
+		CBReleaseObject(array);
+	}
+	printf("CBHeaderArray: %f ms per message\n", elapsed(&begin) / ROUNDS);
+	array = CBNewHeaderArrayFromPayload(CBByteArrayGetData(bytes), bytes->length);
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (int x = 0; x < ROUNDS; x++)
+		if (CBHeaderArrayValidate(array, 0, NULL, 0) != 3) {
+			printf("BIG VALIDATE FAIL\n");
+			return EXIT_FAILURE;
+		}
+	printf("CBHeaderArrayValidate: %f ms per message\n", elapsed(&begin) / ROUNDS);
+	CBReleaseObject(array);
+	CBReleaseObject(bytes);
+	return EXIT_SUCCESS;
+}
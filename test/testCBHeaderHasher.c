@@ -0,0 +1,179 @@
+//
+//  testCBHeaderHasher.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stdarg.h"
+#include "CBHeaderHasher.h"
+#include "CBBlock.h"
+#include "CBValidationFunctions.h"
+
+void CBLogError(char * format, ...);
+void CBLogError(char * format, ...){
+	va_list argptr;
+	va_start(argptr, format);
+	vfprintf(stderr, format, argptr);
+	va_end(argptr);
+	printf("\n");
+}
+
+int main(){
+	unsigned int s = (unsigned int)time(NULL);
+	s = 1413590400;
+	printf("Session = %ui\n", s);
+	srand(s);
+	CBBlock * genesis = CBNewBlockGenesis();
+	CBHeaderHasher hasher;
+	CBInitHeaderHasher(&hasher, CBByteArrayGetData(CBGetMessage(genesis)->bytes));
+	// Test the genesis hash
+	unsigned char hash[32];
+	CBHeaderHasherHash(&hasher, 0x7C2BAC1D, hash);
+	if (memcmp(hash, genesis->hash, 32)) {
+		printf("GENESIS HASH FAIL\n");
+		return EXIT_FAILURE;
+	}
+	if (!CBHeaderHasherMeetsTarget(&hasher, hash)) {
+		printf("GENESIS TARGET FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Test the lanes against single hashing
+	uint32_t nonces[CB_HEADER_HASHER_LANES];
+	unsigned char hashes[CB_HEADER_HASHER_LANES * 32];
+	for (int x = 0; x < CB_HEADER_HASHER_LANES; x++)
+		nonces[x] = rand();
+	CBHeaderHasherHashLanes(&hasher, nonces, hashes);
+	for (int x = 0; x < CB_HEADER_HASHER_LANES; x++) {
+		CBHeaderHasherHash(&hasher, nonces[x], hash);
+		if (memcmp(hash, hashes + x * 32, 32)) {
+			printf("LANE %i HASH FAIL\n", x);
+			return EXIT_FAILURE;
+		}
+		if (CBHeaderHasherMeetsTarget(&hasher, hash)) {
+			printf("LANE %i TARGET FAIL\n", x);
+			return EXIT_FAILURE;
+		}
+	}
+	// Test hashing separate headers with a number which is not a multiple of the lanes
+	unsigned char headers[CB_HEADER_HASHER_LANES * 3 + 5][80];
+	unsigned char headerHashes[CB_HEADER_HASHER_LANES * 3 + 5][32];
+	for (int x = 0; x < CB_HEADER_HASHER_LANES * 3 + 5; x++)
+		for (int y = 0; y < 80; y++)
+			headers[x][y] = rand();
+	CBHeaderHasherHashHeaders(headers[0], CB_HEADER_HASHER_LANES * 3 + 5, headerHashes[0]);
+	for (int x = 0; x < CB_HEADER_HASHER_LANES * 3 + 5; x++) {
+		CBSha256(headers[x], 80, hash);
+		CBSha256(hash, 32, hash);
+		if (memcmp(hash, headerHashes[x], 32)) {
+			printf("HEADER %i HASH FAIL\n", x);
+			return EXIT_FAILURE;
+		}
+	}
+	// Search for the genesis nonce, not starting on a lane boundary.
+	uint32_t nonce = 0x7C2BAC1D - 21;
+	if (CBHeaderHasherSearch(&hasher, &nonce, 20, hash)) {
+		printf("SEARCH FOUND FALSE NONCE\n");
+		return EXIT_FAILURE;
+	}
+	if (nonce != 0x7C2BAC1D - 1) {
+		printf("SEARCH NEXT NONCE FAIL\n");
+		return EXIT_FAILURE;
+	}
+	if (!CBHeaderHasherSearch(&hasher, &nonce, 100, hash)) {
+		printf("SEARCH NOT FOUND FAIL\n");
+		return EXIT_FAILURE;
+	}
+	if (nonce != 0x7C2BAC1D || memcmp(hash, genesis->hash, 32) || CBArrayToInt32(hasher.header, 76) != 0x7C2BAC1D) {
+		printf("SEARCH NONCE FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Test an easy target and that the time change gives a matching hash
+	unsigned char header[80];
+	memcpy(header, CBByteArrayGetData(CBGetMessage(genesis)->bytes), 80);
+	CBInt32ToArray(header, 72, 0x207fffff);
+	CBInitHeaderHasher(&hasher, header);
+	CBHeaderHasherSetTime(&hasher, 1413590400);
+	nonce = 0;
+	if (!CBHeaderHasherSearch(&hasher, &nonce, 1000, hash)) {
+		printf("EASY SEARCH FAIL\n");
+		return EXIT_FAILURE;
+	}
+	unsigned char calcHash[32];
+	CBSha256(hasher.header, 80, calcHash);
+	CBSha256(calcHash, 32, calcHash);
+	if (memcmp(hash, calcHash, 32) || hash[31] & 0x80) {
+		printf("EASY SEARCH HASH FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Test the left branch of merkle trees with different numbers of hashes
+	for (int num = 1; num <= 9; num++) {
+		CBByteArray * leaves[9];
+		unsigned char flat[9 * 32], branch[4 * 32], root[32];
+		for (int x = 0; x < num; x++) {
+			for (int y = 0; y < 32; y++)
+				flat[x * 32 + y] = rand();
+			leaves[x] = CBNewByteArrayWithDataCopy(flat + x * 32, 32);
+		}
+		CBMerkleNode * tree = CBBuildMerkleTree(leaves, num);
+		int branchNum = CBMerkleTreeGetLeftBranch(tree, branch);
+		CBMerkleRootFromLeftBranch(flat, branch, branchNum, root);
+		CBCalculateMerkleRoot(flat, num);
+		if (memcmp(root, flat, 32)) {
+			printf("LEFT BRANCH ROOT FAIL AT %i\n", num);
+			return EXIT_FAILURE;
+		}
+		CBFreeMerkleTree(tree);
+		for (int x = 0; x < num; x++)
+			CBReleaseObject(leaves[x]);
+	}
+	// Test the extra nonce with the genesis coinbase and four other hashes
+	CBTransaction * coinbase = genesis->transactions[0];
+	CBByteArray * leaves[5];
+	unsigned char flat[5 * 32], branch[3 * 32];
+	leaves[0] = CBNewByteArrayWithDataCopy(CBTransactionGetHash(coinbase), 32);
+	for (int x = 1; x < 5; x++) {
+		for (int y = 0; y < 32; y++)
+			flat[x * 32 + y] = rand();
+		leaves[x] = CBNewByteArrayWithDataCopy(flat + x * 32, 32);
+	}
+	CBMerkleNode * tree = CBBuildMerkleTree(leaves, 5);
+	int branchNum = CBMerkleTreeGetLeftBranch(tree, branch);
+	// The extra nonce goes over the start of the input script.
+	CBHeaderHasherSetExtraNonce(&hasher, coinbase, 42, 4, 0x12345678, branch, branchNum);
+	if (CBArrayToInt32(CBByteArrayGetData(CBGetMessage(coinbase)->bytes), 42) != 0x12345678) {
+		printf("EXTRA NONCE WRITE FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBSha256(CBByteArrayGetData(CBGetMessage(coinbase)->bytes), CBGetMessage(coinbase)->bytes->length, calcHash);
+	CBSha256(calcHash, 32, flat);
+	CBCalculateMerkleRoot(flat, 5);
+	if (memcmp(hasher.header + 36, flat, 32)) {
+		printf("EXTRA NONCE ROOT FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// The midstate must follow the new merkle root
+	CBHeaderHasherHash(&hasher, 1234, hash);
+	CBSha256(hasher.header, 80, calcHash);
+	CBSha256(calcHash, 32, calcHash);
+	if (memcmp(hash, calcHash, 32)) {
+		printf("EXTRA NONCE HASH FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBFreeMerkleTree(tree);
+	for (int x = 0; x < 5; x++)
+		CBReleaseObject(leaves[x]);
+	CBReleaseObject(genesis);
+	return EXIT_SUCCESS;
+}
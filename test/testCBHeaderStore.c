@@ -0,0 +1,219 @@
+//
+//  testCBHeaderStore.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "stdarg.h"
+#include "CBHeaderStore.h"
+#include "CBValidationFunctions.h"
+
+#define SYNTHETIC_NUM 100000
+
+void CBLogError(char * format, ...);
+void CBLogError(char * format, ...){
+	va_list argptr;
+	va_start(argptr, format);
+	vfprintf(stderr, format, argptr);
+	va_end(argptr);
+	printf("\n");
+}
+
+double elapsed(struct timespec * begin);
+double elapsed(struct timespec * begin){
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - begin->tv_sec) * 1e3 + (end.tv_nsec - begin->tv_nsec) / 1e6;
+}
+
+void closeWithoutSync(CBHeaderStore * store);
+void closeWithoutSync(CBHeaderStore * store){
+	CBFileUnmap(store->indexHeader, sizeof(CBHeaderStoreIndexHeader) + (uint64_t)store->indexHeader->tableSize * 4);
+	CBFileUnmap(store->fileHeader, (uint64_t)(store->capacity + 1) * sizeof(CBHeaderStoreRecord));
+	CBFileClose(store->recordFile);
+	CBFileClose(store->indexFile);
+}
+
+int main(){
+	unsigned int s = (unsigned int)time(NULL);
+	s = 1413590400;
+	printf("Session = %ui\n", s);
+	srand(s);
+	char dir[] = "/tmp/testCBHeaderStoreXXXXXX";
+	if (! mkdtemp(dir)) {
+		printf("TEMP DIR FAIL\n");
+		return EXIT_FAILURE;
+	}
+	char recordFile[sizeof(dir) + 20], indexFile[sizeof(dir) + 20];
+	sprintf(recordFile, "%s/headers.dat", dir);
+	sprintf(indexFile, "%s/headerIndex.dat", dir);
+	// The first three headers of the main chain
+	unsigned char headers[3][80] = {
+		{0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3B, 0xA3, 0xED, 0xFD, 0x7A, 0x7B, 0x12, 0xB2, 0x7A, 0xC7, 0x2C, 0x3E, 0x67, 0x76, 0x8F, 0x61, 0x7F, 0xC8, 0x1B, 0xC3, 0x88, 0x8A, 0x51, 0x32, 0x3A, 0x9F, 0xB8, 0xAA, 0x4B, 0x1E, 0x5E, 0x4A, 0x29, 0xAB, 0x5F, 0x49, 0xFF, 0xFF, 0x00, 0x1D, 0x1D, 0xAC, 0x2B, 0x7C},
+		{0x01, 0x00, 0x00, 0x00, 0x6F, 0xE2, 0x8C, 0x0A, 0xB6, 0xF1, 0xB3, 0x72, 0xC1, 0xA6, 0xA2, 0x46, 0xAE, 0x63, 0xF7, 0x4F, 0x93, 0x1E, 0x83, 0x65, 0xE1, 0x5A, 0x08, 0x9C, 0x68, 0xD6, 0x19, 0x00, 0x00, 0x00, 0x00, 0x00, 0x98, 0x20, 0x51, 0xFD, 0x1E, 0x4B, 0xA7, 0x44, 0xBB, 0xBE, 0x68, 0x0E, 0x1F, 0xEE, 0x14, 0x67, 0x7B, 0xA1, 0xA3, 0xC3, 0x54, 0x0B, 0xF7, 0xB1, 0xCD, 0xB6, 0x06, 0xE8, 0x57, 0x23, 0x3E, 0x0E, 0x61, 0xBC, 0x66, 0x49, 0xFF, 0xFF, 0x00, 0x1D, 0x01, 0xE3, 0x62, 0x99},
+		{0x01, 0x00, 0x00, 0x00, 0x48, 0x60, 0xEB, 0x18, 0xBF, 0x1B, 0x16, 0x20, 0xE3, 0x7E, 0x94, 0x90, 0xFC, 0x8A, 0x42, 0x75, 0x14, 0x41, 0x6F, 0xD7, 0x51, 0x59, 0xAB, 0x86, 0x68, 0x8E, 0x9A, 0x83, 0x00, 0x00, 0x00, 0x00, 0xD5, 0xFD, 0xCC, 0x54, 0x1E, 0x25, 0xDE, 0x1C, 0x7A, 0x5A, 0xDD, 0xED, 0xF2, 0x48, 0x58, 0xB8, 0xBB, 0x66, 0x5C, 0x9F, 0x36, 0xEF, 0x74, 0x4E, 0xE4, 0x2C, 0x31, 0x60, 0x22, 0xC9, 0x0F, 0x9B, 0xB0, 0xBC, 0x66, 0x49, 0xFF, 0xFF, 0x00, 0x1D, 0x08, 0xD2, 0xBD, 0x61},
+	};
+	CBHeaderArray * array = CBNewHeaderArray(3);
+	for (int x = 0; x < 3; x++)
+		CBHeaderArrayAppend(array, headers[x]);
+	CBHeaderStore store;
+	if (! CBInitHeaderStore(&store, dir) || store.headerNum != 0) {
+		printf("INIT NEW FAIL\n");
+		return EXIT_FAILURE;
+	}
+	if (CBHeaderStoreAppendArray(&store, array, 0, CB_HEADER_STORE_VALID) != 3 || store.headerNum != 3) {
+		printf("APPEND ARRAY FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// The work of each header with the maximum target is 0x100010001
+	for (int x = 0; x < 3; x++) {
+		unsigned char * work = CBHeaderStoreGetRecord(&store, x)->work;
+		for (int y = 0; y < 32; y++)
+			if (work[y] != ((y == 0 || y == 2 || y == 4) ? x + 1 : 0)) {
+				printf("WORK FAIL %i %i\n", x, y);
+				return EXIT_FAILURE;
+			}
+	}
+	CBBlock * block = CBHeaderStoreGetBlock(&store, 1);
+	if (memcmp(block->hash, CBHeaderArrayGetHash(array, 1), 32) || block->nonce != CBHeaderArrayGetNonce(array, 1)) {
+		printf("GET BLOCK FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Appending a header which does not follow the last fails.
+	if (CBHeaderStoreAppendBlock(&store, block, 0) || store.headerNum != 3) {
+		printf("APPEND LINKAGE FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBReleaseObject(block);
+	// Add synthetic headers after the main chain headers, which are not checked for proof of work.
+	unsigned char header[80];
+	memset(header, 0, 80);
+	CBInt32ToArray(header, 72, CB_MAX_TARGET);
+	struct timespec begin;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (uint32_t x = 3; x < SYNTHETIC_NUM; x++) {
+		memcpy(header + 4, CBHeaderStoreGetRecord(&store, x - 1)->hash, 32);
+		CBInt32ToArray(header, 76, x);
+		if (! CBHeaderStoreAppend(&store, header, NULL, 0)) {
+			printf("APPEND FAIL %u\n", x);
+			return EXIT_FAILURE;
+		}
+	}
+	printf("Append: %f ms for %i headers\n", elapsed(&begin), SYNTHETIC_NUM);
+	memcpy(header + 4, CBHeaderStoreGetRecord(&store, SYNTHETIC_NUM - 1)->hash, 32);
+	CBInt32ToArray(header, 72, 0x02000001);
+	if (CBHeaderStoreAppend(&store, header, NULL, 0)) {
+		printf("BAD TARGET FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Find headers by hash
+	for (int x = 0; x < 1000; x++) {
+		uint32_t height = rand() % SYNTHETIC_NUM, found;
+		if (! CBHeaderStoreFind(&store, CBHeaderStoreGetRecord(&store, height)->hash, &found) || found != height) {
+			printf("FIND FAIL %u\n", height);
+			return EXIT_FAILURE;
+		}
+	}
+	uint32_t found;
+	if (CBHeaderStoreFind(&store, header, &found)) {
+		printf("FIND MISSING FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// The chain descriptor has the last ten hashes, then a doubling gap to the genesis block.
+	CBChainDescriptor * chainDesc = CBHeaderStoreGetChainDescriptor(&store);
+	if (chainDesc->hashNum < 20 || chainDesc->hashNum > 40
+		|| memcmp(CBByteArrayGetData(chainDesc->hashes[0]), CBHeaderStoreGetRecord(&store, SYNTHETIC_NUM - 1)->hash, 32)
+		|| memcmp(CBByteArrayGetData(chainDesc->hashes[9]), CBHeaderStoreGetRecord(&store, SYNTHETIC_NUM - 10)->hash, 32)
+		|| memcmp(CBByteArrayGetData(chainDesc->hashes[10]), CBHeaderStoreGetRecord(&store, SYNTHETIC_NUM - 12)->hash, 32)
+		|| memcmp(CBByteArrayGetData(chainDesc->hashes[chainDesc->hashNum - 1]), CBHeaderArrayGetHash(array, 0), 32)) {
+		printf("CHAIN DESCRIPTOR FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBReleaseObject(chainDesc);
+	CBHeaderStoreSetFlags(&store, 5, CB_HEADER_STORE_VALID | CB_HEADER_STORE_HAVE_DATA);
+	CBDestroyHeaderStore(&store);
+	// Reopen without reading or hashing the headers
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	if (! CBInitHeaderStore(&store, dir) || store.headerNum != SYNTHETIC_NUM) {
+		printf("REOPEN FAIL\n");
+		return EXIT_FAILURE;
+	}
+	printf("Reopen: %f ms for %i headers\n", elapsed(&begin), SYNTHETIC_NUM);
+	if (! CBHeaderStoreFind(&store, CBHeaderArrayGetHash(array, 2), &found) || found != 2
+		|| CBHeaderStoreGetRecord(&store, 5)->flags != (CB_HEADER_STORE_VALID | CB_HEADER_STORE_HAVE_DATA)) {
+		printf("REOPEN FIND FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Add headers without syncing and damage one, as if the process crashed while writing it.
+	CBInt32ToArray(header, 72, CB_MAX_TARGET);
+	for (uint32_t x = SYNTHETIC_NUM; x < SYNTHETIC_NUM + 10; x++) {
+		memcpy(header + 4, CBHeaderStoreGetRecord(&store, x - 1)->hash, 32);
+		CBInt32ToArray(header, 76, x);
+		if (! CBHeaderStoreAppend(&store, header, NULL, 0)) {
+			printf("APPEND TAIL FAIL %u\n", x);
+			return EXIT_FAILURE;
+		}
+	}
+	unsigned char lostHash[32];
+	memcpy(lostHash, CBHeaderStoreGetRecord(&store, SYNTHETIC_NUM + 7)->hash, 32);
+	CBHeaderStoreGetRecord(&store, SYNTHETIC_NUM + 5)->header[76]++;
+	closeWithoutSync(&store);
+	if (! CBInitHeaderStore(&store, dir) || store.headerNum != SYNTHETIC_NUM + 5) {
+		printf("CRASH RECOVERY FAIL %u\n", store.headerNum);
+		return EXIT_FAILURE;
+	}
+	if (! CBHeaderStoreFind(&store, CBHeaderStoreGetRecord(&store, SYNTHETIC_NUM + 4)->hash, &found) || found != SYNTHETIC_NUM + 4
+		|| CBHeaderStoreFind(&store, lostHash, &found)) {
+		printf("CRASH RECOVERY FIND FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Remove headers and add them back
+	unsigned char removedHeader[80];
+	memcpy(removedHeader, CBHeaderStoreGetRecord(&store, 60000)->header, 80);
+	memcpy(lostHash, CBHeaderStoreGetRecord(&store, 60001)->hash, 32);
+	if (! CBHeaderStoreTruncate(&store, 60000) || CBHeaderStoreFind(&store, lostHash, &found)) {
+		printf("TRUNCATE FAIL\n");
+		return EXIT_FAILURE;
+	}
+	closeWithoutSync(&store);
+	if (! CBInitHeaderStore(&store, dir) || store.headerNum != 60000) {
+		printf("TRUNCATE REOPEN FAIL\n");
+		return EXIT_FAILURE;
+	}
+	uint32_t usedSlots = store.indexHeader->usedSlots;
+	if (! CBHeaderStoreAppend(&store, removedHeader, NULL, 0)
+		|| ! CBHeaderStoreFind(&store, CBHeaderStoreGetRecord(&store, 60000)->hash, &found) || found != 60000
+		|| store.indexHeader->usedSlots != usedSlots) {
+		printf("APPEND AFTER TRUNCATE FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBDestroyHeaderStore(&store);
+	// A damaged hash table is made again.
+	FILE * f = fopen(indexFile, "r+b");
+	fputc(0, f);
+	fclose(f);
+	if (! CBInitHeaderStore(&store, dir) || store.headerNum != 60001 || store.indexHeader->usedSlots != 60001
+		|| ! CBHeaderStoreFind(&store, CBHeaderArrayGetHash(array, 1), &found) || found != 1) {
+		printf("REBUILD INDEX FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBDestroyHeaderStore(&store);
+	CBReleaseObject(array);
+	unlink(recordFile);
+	unlink(indexFile);
+	rmdir(dir);
+	return EXIT_SUCCESS;
+}
@@ -291,7 +291,7 @@ int main(){
 	CBNetworkCommunicatorSetReachability(commListen, CB_IP_IP4 | CB_IP_LOCAL, true);
 	addrManListen->callbackHandler = commListen;
 	commListen->networkID = CB_PRODUCTION_NETWORK_BYTES;
-	commListen->flags = CB_NETWORK_COMMUNICATOR_AUTO_HANDSHAKE | CB_NETWORK_COMMUNICATOR_AUTO_PING | CB_NETWORK_COMMUNICATOR_AUTO_DISCOVERY;
+	commListen->flags = CB_NETWORK_COMMUNICATOR_AUTO_HANDSHAKE | CB_NETWORK_COMMUNICATOR_AUTO_PING | CB_NETWORK_COMMUNICATOR_AUTO_DISCOVERY | CB_NETWORK_COMMUNICATOR_BATCH_RECEIVE;
 	commListen->version = CB_PONG_VERSION;
 	commListen->maxConnections = 3;
 	commListen->maxIncommingConnections = 3; // One for connector, one for the other listener and an extra so that we continue to share our address.
@@ -302,7 +302,7 @@ int main(){
 	CBNetworkCommunicatorSetNetworkAddressManager(commListen, addrManListen);
 	CBNetworkCommunicatorSetUserAgent(commListen, userAgent);
 	CBNetworkCommunicatorSetOurIPv4(commListen, addrListen);
-	// Second listening CBNetworkCommunicator setup.
+	// Second listening CBNetworkCommunicator setup, which reads each message separately.
 	CBNetworkAddressManager * addrManListen2 = CBNewNetworkAddressManager(onBadTime);
 	addrManListen2->maxAddressesInBucket = 2;
 	CBNetworkCommunicator * commListen2 = CBNewNetworkCommunicator(0, callbacks);
@@ -330,7 +330,7 @@ int main(){
 	CBNetworkCommunicatorSetReachability(commConnect, CB_IP_IP4 | CB_IP_LOCAL, true);
 	addrManConnect->callbackHandler = commConnect;
 	commConnect->networkID = CB_PRODUCTION_NETWORK_BYTES;
-	commConnect->flags = CB_NETWORK_COMMUNICATOR_AUTO_HANDSHAKE | CB_NETWORK_COMMUNICATOR_AUTO_PING | CB_NETWORK_COMMUNICATOR_AUTO_DISCOVERY;
+	commConnect->flags = CB_NETWORK_COMMUNICATOR_AUTO_HANDSHAKE | CB_NETWORK_COMMUNICATOR_AUTO_PING | CB_NETWORK_COMMUNICATOR_AUTO_DISCOVERY | CB_NETWORK_COMMUNICATOR_BATCH_RECEIVE;
 	commConnect->version = CB_PONG_VERSION;
 	commConnect->maxConnections = 2;
 	commConnect->maxIncommingConnections = 0;
@@ -0,0 +1,104 @@
+//
+//  testCBObject.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stdarg.h"
+#include "CBMessage.h"
+
+#define NUM_THREADS 8
+#define NUM_MESSAGES 4
+#define ITERATIONS 200000
+
+CBMessage * messages[NUM_MESSAGES];
+int freed = 0;
+
+void CBLogError(char * format, ...);
+void CBLogError(char * format, ...){
+	va_list argptr;
+	va_start(argptr, format);
+	vfprintf(stderr, format, argptr);
+	va_end(argptr);
+	printf("\n");
+}
+
+void countFree(void * vself);
+void countFree(void * vself){
+	__atomic_fetch_add(&freed, 1, __ATOMIC_RELAXED);
+	CBFreeMessage(vself);
+}
+
+void retainRelease(void * arg);
+void retainRelease(void * arg){
+	int start = *(int *)arg;
+	for (int x = 0; x < ITERATIONS; x++) {
+		CBMessage * msg = messages[(start + x) % NUM_MESSAGES];
+		CBRetainObject(msg);
+		CBRetainObject(msg);
+		CBReleaseObject(msg);
+		CBReleaseObject(msg);
+	}
+}
+
+void runThreads(void (*func)(void *));
+void runThreads(void (*func)(void *)){
+	CBDepObject threads[NUM_THREADS];
+	int starts[NUM_THREADS];
+	for (int x = 0; x < NUM_THREADS; x++) {
+		starts[x] = x;
+		CBNewThread(threads + x, func, starts + x);
+	}
+	for (int x = 0; x < NUM_THREADS; x++) {
+		CBThreadJoin(threads[x]);
+		CBFreeThread(threads[x]);
+	}
+}
+
+int main(){
+	for (int x = 0; x < NUM_MESSAGES; x++) {
+		messages[x] = CBNewMessageByObject();
+		CBGetObject(messages[x])->free = countFree;
+	}
+	runThreads(retainRelease);
+	for (int x = 0; x < NUM_MESSAGES; x++) {
+		if (CBGetObject(messages[x])->references != 1) {
+			printf("REFERENCES FAIL %i\n", CBGetObject(messages[x])->references);
+			return EXIT_FAILURE;
+		}
+		if (freed) {
+			printf("FREED EARLY FAIL\n");
+			return EXIT_FAILURE;
+		}
+	}
+	// Release the last references from different threads together
+	for (int x = 0; x < NUM_MESSAGES; x++)
+		for (int y = 0; y < NUM_THREADS - 1; y++)
+			CBRetainObject(messages[x]);
+	CBDepObject threads[NUM_THREADS];
+	for (int x = 0; x < NUM_THREADS; x++)
+		CBNewThread(threads + x, CBReleaseObject, messages[x % NUM_MESSAGES]);
+	for (int x = 0; x < NUM_THREADS; x++) {
+		CBThreadJoin(threads[x]);
+		CBFreeThread(threads[x]);
+	}
+	for (int x = 0; x < NUM_MESSAGES; x++)
+		for (int y = NUM_THREADS / NUM_MESSAGES; y < NUM_THREADS; y++)
+			CBReleaseObject(messages[x]);
+	if (freed != NUM_MESSAGES) {
+		printf("FREE FAIL %i\n", freed);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
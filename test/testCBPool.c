@@ -0,0 +1,172 @@
+//
+//  testCBPool.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "stdarg.h"
+#include "CBBlock.h"
+
+#define NUM_TX 2000
+#define ROUNDS 20
+#define THREAD_OBJECTS 10000
+#define THREADS 1000
+
+void CBLogError(char * format, ...);
+void CBLogError(char * format, ...){
+	va_list argptr;
+	va_start(argptr, format);
+	vfprintf(stderr, format, argptr);
+	va_end(argptr);
+	printf("\n");
+}
+
+void * allocateAndExit(void * unused);
+void * allocateAndExit(void * unused){
+	// Leaves a full cache of byte arrays for the thread, which is flushed when the thread exits.
+	CBByteArray ** arrays = malloc(sizeof(*arrays) * THREAD_OBJECTS);
+	for (int x = 0; x < THREAD_OBJECTS; x++)
+		arrays[x] = CBNewByteArrayOfSize(1);
+	for (int x = 0; x < THREAD_OBJECTS; x++)
+		CBReleaseObject(arrays[x]);
+	free(arrays);
+	return unused;
+}
+
+double elapsed(struct timespec * begin);
+double elapsed(struct timespec * begin){
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - begin->tv_sec) * 1e3 + (end.tv_nsec - begin->tv_nsec) / 1e6;
+}
+
+int main(){
+	unsigned int s = (unsigned int)time(NULL);
+	s = 1413590400;
+	printf("Session = %ui\n", s);
+	srand(s);
+	// Make a block with 2000 transactions of two inputs and two outputs
+	CBBlock * block = CBNewBlock();
+	block->version = 2;
+	block->prevBlockHash = CBNewByteArrayOfSize(32);
+	block->merkleRoot = CBNewByteArrayOfSize(32);
+	memset(CBByteArrayGetData(block->prevBlockHash), 0, 32);
+	memset(CBByteArrayGetData(block->merkleRoot), 0, 32);
+	block->target = 0x1D00FFFF;
+	block->time = 1413590400;
+	block->nonce = 0;
+	block->transactionNum = NUM_TX;
+	block->transactions = malloc(sizeof(*block->transactions) * NUM_TX);
+	for (int x = 0; x < NUM_TX; x++) {
+		block->transactions[x] = CBNewTransaction(0, 1);
+		for (int y = 0; y < 2; y++) {
+			CBByteArray * hash = CBNewByteArrayOfSize(32);
+			CBScript * script = CBNewScriptOfSize(107);
+			for (int z = 0; z < 32; z++)
+				CBByteArrayGetData(hash)[z] = rand();
+			for (int z = 0; z < 107; z++)
+				CBByteArrayGetData(script)[z] = rand();
+			CBTransactionTakeInput(block->transactions[x], CBNewTransactionInputTakeScriptAndHash(script, CB_TX_INPUT_FINAL, hash, y));
+			script = CBNewScriptOfSize(25);
+			for (int z = 0; z < 25; z++)
+				CBByteArrayGetData(script)[z] = rand();
+			CBTransactionTakeOutput(block->transactions[x], CBNewTransactionOutputTakeScript(rand(), script));
+		}
+	}
+	CBByteArray * bytes = CBNewByteArrayOfSize(CBBlockCalculateLength(block, true));
+	CBGetMessage(block)->bytes = bytes;
+	CBBlockSerialise(block, true, true);
+	CBRetainObject(bytes);
+	unsigned char hashes[NUM_TX][32];
+	for (int x = 0; x < NUM_TX; x++)
+		memcpy(hashes[x], CBTransactionGetHash(block->transactions[x]), 32);
+	CBReleaseObject(block);
+	// Deserialise with the pools
+	int slabs = 0;
+	struct timespec begin;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (int x = 0; x < ROUNDS; x++) {
+		block = CBNewBlockFromData(bytes);
+		if (CBBlockDeserialise(block, true) != bytes->length) {
+			printf("POOL DESERIALISE FAIL\n");
+			return EXIT_FAILURE;
+		}
+		if (memcmp(CBTransactionGetHash(block->transactions[x * 37]), hashes[x * 37], 32)) {
+			printf("POOL HASH FAIL\n");
+			return EXIT_FAILURE;
+		}
+		CBReleaseObject(block);
+		if (x == 0)
+			slabs = CBByteArrayPool.slabNum;
+		else if (CBByteArrayPool.slabNum != slabs) {
+			printf("POOL REUSE FAIL\n");
+			return EXIT_FAILURE;
+		}
+	}
+	double poolTime = elapsed(&begin) / ROUNDS;
+	// Deserialise with an arena
+	int objects = 0, chunks = 0;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (int x = 0; x < ROUNDS; x++) {
+		block = CBNewBlockFromDataWithArena(bytes);
+		if (CBBlockDeserialise(block, true) != bytes->length) {
+			printf("ARENA DESERIALISE FAIL\n");
+			return EXIT_FAILURE;
+		}
+		if (memcmp(CBTransactionGetHash(block->transactions[x * 37]), hashes[x * 37], 32)) {
+			printf("ARENA HASH FAIL\n");
+			return EXIT_FAILURE;
+		}
+		objects = block->arena->references - 1;
+		chunks = block->arena->chunkNum;
+		CBReleaseObject(block);
+	}
+	double arenaTime = elapsed(&begin) / ROUNDS;
+	// A transaction retained from an arena block outlives the block.
+	block = CBNewBlockFromDataWithArena(bytes);
+	CBBlockDeserialise(block, true);
+	CBTransaction * tx = block->transactions[1234];
+	CBRetainObject(tx);
+	CBReleaseObject(block);
+	tx->hashSet = false;
+	if (memcmp(CBTransactionGetHash(tx), hashes[1234], 32)) {
+		printf("ARENA RETAIN FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBReleaseObject(tx);
+	// Objects made outside of a block do not use the arena.
+	if (CBGetCurrentArena()) {
+		printf("CURRENT ARENA NOT RESTORED FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// The caches of threads are returned to the pools when the threads exit, so that threads do not keep taking slabs.
+	int threadSlabs = 0;
+	for (int x = 0; x < THREADS; x++) {
+		pthread_t thread;
+		pthread_create(&thread, NULL, allocateAndExit, NULL);
+		pthread_join(thread, NULL);
+		if (x == 0)
+			threadSlabs = CBByteArrayPool.slabNum;
+		else if (CBByteArrayPool.slabNum != threadSlabs) {
+			printf("THREAD CACHE FLUSH FAIL %i != %i\n", CBByteArrayPool.slabNum, threadSlabs);
+			return EXIT_FAILURE;
+		}
+	}
+	printf("Deserialising %i transactions makes %i objects.\n", NUM_TX, objects);
+	printf("Pools: %.2fms per block with %i byte array slabs. Arena: %.2fms per block with %i chunks.\n", poolTime, slabs, arenaTime, chunks);
+	CBReleaseObject(bytes);
+	return EXIT_SUCCESS;
+}
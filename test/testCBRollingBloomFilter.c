@@ -0,0 +1,128 @@
+//
+//  testCBRollingBloomFilter.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "CBRollingBloomFilter.h"
+
+#define ITEMS 10000
+#define RATE 0.001
+#define TRIALS 200000
+
+void getHash(unsigned char * hash, uint32_t x);
+void getHash(unsigned char * hash, uint32_t x){
+	// Hashes which only differ in a few bytes.
+	memset(hash, 0, 32);
+	memcpy(hash + 12, &x, 4);
+}
+
+int main(){
+	unsigned int s = (unsigned int)time(NULL);
+	printf("Session = %ui\n", s);
+	srand(s);
+	unsigned char hash[32];
+	// The model of the false positive rate falls as blocks are added.
+	if (CBRollingBloomFilterFalsePositiveRate(1000, 100) <= CBRollingBloomFilterFalsePositiveRate(1000, 200)
+		|| CBRollingBloomFilterFalsePositiveRate(1000, 1) < 0.999
+		|| CBRollingBloomFilterFalsePositiveRate(1, 1) > 1e-20) {
+		printf("MODEL FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBRollingBloomFilter * filter = CBNewRollingBloomFilter(ITEMS, RATE, ((uint64_t)rand() << 32) | (uint32_t)rand());
+	if (! filter) {
+		printf("NEW FAIL\n");
+		return EXIT_FAILURE;
+	}
+	uint32_t blockNum = filter->blockNum;
+	printf("%u blocks for each generation, %u bytes\n", blockNum, 2 * blockNum * (uint32_t)sizeof(CBBloomBlock));
+	if ((uintptr_t)filter->generations[0] % sizeof(CBBloomBlock)) {
+		printf("ALIGNMENT FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Fill the filter, so that the oldest generation is full.
+	int added = 0;
+	for (uint32_t x = 0; x < ITEMS; x++) {
+		getHash(hash, x);
+		added += CBRollingBloomFilterAdd(filter, hash);
+	}
+	// Some may be refused as false positives.
+	if (added < ITEMS - ITEMS * RATE * 10) {
+		printf("ADD FAIL %i\n", added);
+		return EXIT_FAILURE;
+	}
+	// Adding again is refused.
+	getHash(hash, ITEMS - 1);
+	if (CBRollingBloomFilterAdd(filter, hash)) {
+		printf("ADD AGAIN FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// The most recent half of the items are always found.
+	for (uint32_t x = ITEMS / 2; x < ITEMS; x++) {
+		getHash(hash, x);
+		if (! CBRollingBloomFilterContains(filter, hash)) {
+			printf("FALSE NEGATIVE %u FAIL\n", x);
+			return EXIT_FAILURE;
+		}
+	}
+	// The false positive rate is near to the requested rate.
+	int falsePositives = 0;
+	for (uint32_t x = 0; x < TRIALS; x++) {
+		getHash(hash, x + 0x80000000);
+		falsePositives += CBRollingBloomFilterContains(filter, hash);
+	}
+	double rate = (double)falsePositives / TRIALS;
+	printf("False positive rate = %f\n", rate);
+	if (rate > RATE * 2) {
+		printf("FALSE POSITIVE RATE FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// After two more generations, the first items are forgotten and the memory is the same.
+	for (uint32_t x = 0; x < ITEMS + 2; x++) {
+		getHash(hash, x + 0x40000000);
+		CBRollingBloomFilterAdd(filter, hash);
+	}
+	int remembered = 0;
+	for (uint32_t x = 0; x < ITEMS; x++) {
+		getHash(hash, x);
+		remembered += CBRollingBloomFilterContains(filter, hash);
+	}
+	if (remembered > ITEMS * RATE * 10 || filter->blockNum != blockNum) {
+		printf("FORGET FAIL %i\n", remembered);
+		return EXIT_FAILURE;
+	}
+	CBReleaseObject(filter);
+	// A hash seen again while in the older generation is kept when the older generation is cleared.
+	filter = CBNewRollingBloomFilter(ITEMS, RATE, ((uint64_t)rand() << 32) | (uint32_t)rand());
+	for (uint32_t x = 0; x < ITEMS; x++) {
+		getHash(hash, x);
+		CBRollingBloomFilterAdd(filter, hash);
+	}
+	getHash(hash, 0);
+	if (CBRollingBloomFilterAdd(filter, hash)) {
+		printf("ADD OLDER GENERATION FAIL\n");
+		return EXIT_FAILURE;
+	}
+	for (uint32_t x = 0; x < ITEMS / 2 + 1; x++) {
+		getHash(hash, x + 0x40000000);
+		CBRollingBloomFilterAdd(filter, hash);
+	}
+	getHash(hash, 0);
+	if (! CBRollingBloomFilterContains(filter, hash)) {
+		printf("REFRESH FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBReleaseObject(filter);
+	return EXIT_SUCCESS;
+}
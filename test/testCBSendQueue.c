@@ -0,0 +1,266 @@
+//
+//  testCBSendQueue.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "CBNetworkCommunicator.h"
+
+#define PORT 45590
+#define BIG_BLOCK 1000000
+#define DELAY 200 // Milliseconds the client waits before reading, so that the queue backs up.
+
+pthread_mutex_t stateMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t stateCond = PTHREAD_COND_INITIALIZER;
+bool queued = false;
+bool drained = false;
+CBPeer * thePeer = NULL;
+CBMessage * refusedBlock = NULL;
+int bigBlocks = 0;
+// The order the messages should arrive in.
+char * expected[] = {"pong", "pong", "block", "block", "block", "block", "block", "inv", "addr", "addr", "addr"};
+#define EXPECTED_NUM (int)(sizeof(expected) / sizeof(*expected))
+
+long long int CBGetMilliseconds(void){
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+CBMessage * newMessage(CBMessageType type, int size);
+CBMessage * newMessage(CBMessageType type, int size){
+	CBMessage * message = CBNewMessageByObject();
+	message->type = type;
+	message->bytes = CBNewByteArrayOfSize(size);
+	memset(CBByteArrayGetData(message->bytes), 0, size);
+	message->serialised = true;
+	return message;
+}
+
+bool queueMessage(CBNetworkCommunicator * comm, CBMessageType type, int size);
+bool queueMessage(CBNetworkCommunicator * comm, CBMessageType type, int size){
+	CBMessage * message = newMessage(type, size);
+	bool ok = CBNetworkCommunicatorSendMessage(comm, thePeer, message, NULL);
+	if (! ok && type == CB_MESSAGE_TYPE_BLOCK)
+		refusedBlock = message;
+	else
+		CBReleaseObject(message);
+	return ok;
+}
+
+void onPeerConnection(CBNetworkCommunicator * comm, CBPeer * peer);
+void onPeerConnection(CBNetworkCommunicator * comm, CBPeer * peer){
+	thePeer = peer;
+	// Queue messages with lower priorities first. Nothing is sent until this returns.
+	for (int x = 0; x < 3; x++)
+		if (! queueMessage(comm, CB_MESSAGE_TYPE_ADDR, 1000)) {
+			printf("ADDR QUEUE FAIL\n");
+			exit(EXIT_FAILURE);
+		}
+	if (! queueMessage(comm, CB_MESSAGE_TYPE_INV, 100)
+		|| ! queueMessage(comm, CB_MESSAGE_TYPE_BLOCK, 200000)
+		|| ! queueMessage(comm, CB_MESSAGE_TYPE_PONG, 8)) {
+		printf("QUEUE FAIL\n");
+		exit(EXIT_FAILURE);
+	}
+	// Fill the queue with blocks until one is refused.
+	while (queueMessage(comm, CB_MESSAGE_TYPE_BLOCK, BIG_BLOCK))
+		bigBlocks++;
+	if (bigBlocks != 3 || ! peer->sendQueueFull || peer->sendQueueRefused != 1
+		|| peer->sendQueueBytes > CB_SEND_QUEUE_MAX_BYTES || peer->sendQueueBytes + BIG_BLOCK + 24 <= CB_SEND_QUEUE_MAX_BYTES) {
+		printf("BYTE BUDGET FAIL %i %u\n", bigBlocks, peer->sendQueueBytes);
+		exit(EXIT_FAILURE);
+	}
+	// Control messages are never refused for the size of the queue.
+	if (! queueMessage(comm, CB_MESSAGE_TYPE_PONG, 8) || peer->sendQueueSize != 10) {
+		printf("CONTROL REFUSED FAIL\n");
+		exit(EXIT_FAILURE);
+	}
+	pthread_mutex_lock(&stateMutex);
+	queued = true;
+	pthread_cond_signal(&stateCond);
+	pthread_mutex_unlock(&stateMutex);
+}
+void onSendQueueDrained(CBNetworkCommunicator * comm, CBPeer * peer);
+void onSendQueueDrained(CBNetworkCommunicator * comm, CBPeer * peer){
+	if (peer != thePeer || peer->sendQueueBytes >= CB_SEND_QUEUE_LOW_WATERMARK || drained || ! refusedBlock) {
+		printf("DRAINED CALLBACK FAIL\n");
+		exit(EXIT_FAILURE);
+	}
+	drained = true;
+	// Send the refused block again, which goes before the inv and addr messages still queued.
+	if (! CBNetworkCommunicatorSendMessage(comm, peer, refusedBlock, NULL)) {
+		printf("RETRY REFUSED FAIL\n");
+		exit(EXIT_FAILURE);
+	}
+	CBReleaseObject(refusedBlock);
+	refusedBlock = NULL;
+}
+bool acceptType(CBNetworkCommunicator * comm, CBPeer * peer, CBMessageType type);
+bool acceptType(CBNetworkCommunicator * comm, CBPeer * peer, CBMessageType type){
+	UNUSED(comm && peer && type);
+	return true;
+}
+CBOnMessageReceivedAction onMessageReceived(CBNetworkCommunicator * comm, CBPeer * peer, CBMessage * message);
+CBOnMessageReceivedAction onMessageReceived(CBNetworkCommunicator * comm, CBPeer * peer, CBMessage * message){
+	UNUSED(comm && peer && message);
+	return CB_MESSAGE_ACTION_CONTINUE;
+}
+void onNetworkError(CBNetworkCommunicator * comm, CBErrorReason reason);
+void onNetworkError(CBNetworkCommunicator * comm, CBErrorReason reason){
+	UNUSED(comm && reason);
+	printf("NETWORK ERROR FAIL\n");
+	exit(EXIT_FAILURE);
+}
+void onBadTime(void * foo);
+void onBadTime(void * foo){
+	UNUSED(foo);
+	printf("BAD TIME FAIL\n");
+	exit(EXIT_FAILURE);
+}
+
+void startListening(void * comm);
+void startListening(void * comm){
+	CBNetworkCommunicatorStartListening(comm);
+}
+void stop(void * comm);
+void stop(void * comm){
+	CBNetworkCommunicatorStop(comm);
+}
+
+uint32_t gotMessagesSent, gotRefused, gotBytes;
+int gotSize, gotLatency, gotLatencyMax;
+bool gotDrained;
+void getStatistics(void * unused);
+void getStatistics(void * unused){
+	UNUSED(unused);
+	gotDrained = drained;
+	gotMessagesSent = thePeer->messagesSent;
+	gotRefused = thePeer->sendQueueRefused;
+	gotBytes = thePeer->sendQueueBytes;
+	gotSize = thePeer->sendQueueSize;
+	gotLatency = thePeer->sendQueueLatency;
+	gotLatencyMax = thePeer->sendQueueLatencyMax;
+}
+
+bool readAll(int fd, unsigned char * buf, int len);
+bool readAll(int fd, unsigned char * buf, int len){
+	while (len) {
+		ssize_t num = recv(fd, buf, len, 0);
+		if (num <= 0)
+			return false;
+		if (buf)
+			buf += num;
+		len -= num;
+	}
+	return true;
+}
+
+int main(){
+	// Priorities
+	if (CBNetworkCommunicatorGetSendPriority(CB_MESSAGE_TYPE_VERACK) != CB_SEND_PRIORITY_CONTROL
+		|| CBNetworkCommunicatorGetSendPriority(CB_MESSAGE_TYPE_BLOCK) != CB_SEND_PRIORITY_BLOCK
+		|| CBNetworkCommunicatorGetSendPriority(CB_MESSAGE_TYPE_TX) != CB_SEND_PRIORITY_TX
+		|| CBNetworkCommunicatorGetSendPriority(CB_MESSAGE_TYPE_ALT) != CB_SEND_PRIORITY_TX
+		|| CBNetworkCommunicatorGetSendPriority(CB_MESSAGE_TYPE_ADDR) != CB_SEND_PRIORITY_ADDR) {
+		printf("PRIORITY FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Listening communicator which sends to the client when it connects.
+	CBNetworkCommunicatorCallbacks callbacks = {onPeerConnection, acceptType, onMessageReceived, onNetworkError, onSendQueueDrained};
+	CBNetworkCommunicator * comm = CBNewNetworkCommunicator(0, callbacks);
+	CBNetworkAddressManager * addrMan = CBNewNetworkAddressManager(onBadTime);
+	addrMan->callbackHandler = comm;
+	CBNetworkCommunicatorSetNetworkAddressManager(comm, addrMan);
+	CBReleaseObject(addrMan);
+	CBNetworkCommunicatorSetReachability(comm, CB_IP_IP4 | CB_IP_LOCAL, true);
+	CBByteArray * ip = CBNewByteArrayWithDataCopy((unsigned char [16]){0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF, 127, 0, 0, 1}, 16);
+	CBNetworkAddress * ourAddr = CBNewNetworkAddress(0, (CBSocketAddress){ip, PORT}, 0, false);
+	CBReleaseObject(ip);
+	CBNetworkCommunicatorSetOurIPv4(comm, ourAddr);
+	CBReleaseObject(ourAddr);
+	comm->networkID = CB_PRODUCTION_NETWORK_BYTES;
+	comm->flags = 0;
+	comm->maxConnections = 1;
+	comm->maxIncommingConnections = 1;
+	comm->sendTimeOut = 5000;
+	CBRunOnEventLoop(comm->eventLoop, startListening, comm, true);
+	if (! comm->ipData[CB_IP4_NETWORK].isListening) {
+		printf("LISTEN FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Connect with a small receive buffer, and do not read until the messages have been queued.
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	int bufSize = 4096;
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufSize, sizeof(bufSize));
+	struct sockaddr_in addr = {0};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(PORT);
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		printf("CONNECT FAIL\n");
+		return EXIT_FAILURE;
+	}
+	struct timespec until;
+	clock_gettime(CLOCK_REALTIME, &until);
+	until.tv_sec += 3;
+	pthread_mutex_lock(&stateMutex);
+	while (! queued)
+		if (pthread_cond_timedwait(&stateCond, &stateMutex, &until)) {
+			printf("NO CONNECTION FAIL\n");
+			return EXIT_FAILURE;
+		}
+	pthread_mutex_unlock(&stateMutex);
+	usleep(DELAY * 1000);
+	// Messages arrive in order of priority, and in the order they were queued for each priority.
+	for (int x = 0; x < EXPECTED_NUM; x++) {
+		unsigned char header[24];
+		if (! readAll(fd, header, 24)) {
+			printf("READ HEADER %i FAIL\n", x);
+			return EXIT_FAILURE;
+		}
+		if (strncmp((char *)header + CB_MESSAGE_HEADER_TYPE, expected[x], 12)) {
+			printf("MESSAGE %i IS %.12s NOT %s FAIL\n", x, header + CB_MESSAGE_HEADER_TYPE, expected[x]);
+			return EXIT_FAILURE;
+		}
+		uint32_t length = CBArrayToInt32(header, CB_MESSAGE_HEADER_LENGTH);
+		unsigned char * payload = malloc(length);
+		if (! readAll(fd, payload, length)) {
+			printf("READ PAYLOAD %i FAIL\n", x);
+			return EXIT_FAILURE;
+		}
+		free(payload);
+	}
+	CBRunOnEventLoop(comm->eventLoop, getStatistics, NULL, true);
+	if (! gotDrained) {
+		printf("NOT DRAINED FAIL\n");
+		return EXIT_FAILURE;
+	}
+	printf("Sent %u messages with a queue latency of %i ms, at most %i ms\n", gotMessagesSent, gotLatency, gotLatencyMax);
+	if (gotMessagesSent != EXPECTED_NUM || gotRefused != 1 || gotBytes || gotSize
+		|| gotLatencyMax < DELAY || gotLatency > gotLatencyMax) {
+		printf("STATISTICS FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBRunOnEventLoop(comm->eventLoop, stop, comm, true);
+	CBReleaseObject(comm);
+	close(fd);
+	return EXIT_SUCCESS;
+}
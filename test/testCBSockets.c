@@ -0,0 +1,284 @@
+//
+//  testCBSockets.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+// Simulates peers over the loopback interface using only the networking dependencies, so that the network libraries can be checked and compared. Each peer sends a message which is echoed back, one message at a time.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "CBNetworkCommunicator.h"
+
+#define PEER_NUM 64
+#define ROUND_TRIPS 2000
+#define MESSAGE_SIZE 280 // A header and a small payload
+#define HEADER_SIZE 24
+#define PORT 45570
+
+typedef struct{
+	CBDepObject socket;
+	CBDepObject connectEvent;
+	CBDepObject receiveEvent;
+	CBDepObject sendEvent;
+	bool hasEvents;
+	bool client;
+	bool idle; // Never sent anything, so the receive event times out.
+	unsigned char buffer[MESSAGE_SIZE];
+	int received;
+	int sent;
+	int roundTrips;
+} Connection;
+
+typedef struct{
+	CBDepObject loop;
+	CBDepObject listenSocket;
+	CBDepObject acceptEvent;
+	CBDepObject timer;
+	Connection clients[PEER_NUM + 1];
+	Connection servers[PEER_NUM + 1];
+	int accepted;
+	int done;
+	struct timespec end; // When the last peer finished.
+	int ticks;
+	bool idleTimedOut;
+	bool failed;
+} Simulator;
+
+void fail(Simulator * sim, char * reason);
+void fail(Simulator * sim, char * reason){
+	printf("%s FAIL\n", reason);
+	__atomic_store_n(&sim->failed, true, __ATOMIC_SEQ_CST);
+}
+
+void fillMessage(Connection * conn);
+void fillMessage(Connection * conn){
+	for (int x = 0; x < MESSAGE_SIZE; x++)
+		conn->buffer[x] = x + conn->roundTrips;
+}
+
+void continueSend(Simulator * sim, Connection * conn);
+void continueSend(Simulator * sim, Connection * conn){
+	while (conn->sent < MESSAGE_SIZE) {
+		int32_t len = CBSocketSend(conn->socket, conn->buffer + conn->sent, MESSAGE_SIZE - conn->sent);
+		if (len == CB_SOCKET_FAILURE) {
+			fail(sim, "SEND");
+			return;
+		}
+		if (! len)
+			break;
+		conn->sent += len;
+	}
+}
+
+void startSend(Simulator * sim, Connection * conn);
+void startSend(Simulator * sim, Connection * conn){
+	conn->sent = 0;
+	continueSend(sim, conn);
+	if (conn->sent < MESSAGE_SIZE && ! CBSocketAddEvent(conn->sendEvent, 5000))
+		fail(sim, "ADD SEND EVENT");
+}
+
+void onCanSend(void * vsim, void * vconn);
+void onCanSend(void * vsim, void * vconn){
+	Connection * conn = vconn;
+	continueSend(vsim, conn);
+	if (conn->sent == MESSAGE_SIZE)
+		CBSocketRemoveEvent(conn->sendEvent);
+}
+
+void onCanReceive(void * vsim, void * vconn);
+void onCanReceive(void * vsim, void * vconn){
+	Simulator * sim = vsim;
+	Connection * conn = vconn;
+	// Read the header and then the payload, with one read for each callback like CBNetworkCommunicator.
+	int32_t len = CBSocketReceive(conn->socket, conn->buffer + conn->received, (conn->received < HEADER_SIZE ? HEADER_SIZE : MESSAGE_SIZE) - conn->received);
+	if (len == CB_SOCKET_CONNECTION_CLOSE || len == CB_SOCKET_FAILURE) {
+		fail(sim, "RECEIVE");
+		return;
+	}
+	conn->received += len;
+	if (conn->received != MESSAGE_SIZE)
+		return;
+	conn->received = 0;
+	if (! conn->client) {
+		// Echo the message
+		startSend(sim, conn);
+		return;
+	}
+	for (int x = 0; x < MESSAGE_SIZE; x++)
+		if (conn->buffer[x] != (unsigned char)(x + conn->roundTrips)) {
+			fail(sim, "ECHO DATA");
+			return;
+		}
+	if (++conn->roundTrips == ROUND_TRIPS) {
+		if (sim->done + 1 == PEER_NUM)
+			clock_gettime(CLOCK_MONOTONIC, &sim->end);
+		__atomic_add_fetch(&sim->done, 1, __ATOMIC_SEQ_CST);
+		return;
+	}
+	fillMessage(conn);
+	startSend(sim, conn);
+}
+
+void setUpConnection(Simulator * sim, Connection * conn, int receiveTimeout);
+void setUpConnection(Simulator * sim, Connection * conn, int receiveTimeout){
+	if (! CBSocketCanReceiveEvent(&conn->receiveEvent, sim->loop, conn->socket, onCanReceive, conn)
+		|| ! CBSocketCanSendEvent(&conn->sendEvent, sim->loop, conn->socket, onCanSend, conn)) {
+		fail(sim, "EVENTS");
+		return;
+	}
+	conn->hasEvents = true;
+	if (! CBSocketAddEvent(conn->receiveEvent, receiveTimeout))
+		fail(sim, "ADD RECEIVE EVENT");
+}
+
+void onAccept(void * vsim, CBDepObject socket);
+void onAccept(void * vsim, CBDepObject socket){
+	Simulator * sim = vsim;
+	CBSocketAddress sockAddr;
+	if (sim->accepted == PEER_NUM + 1) {
+		fail(sim, "TOO MANY ACCEPTS");
+		return;
+	}
+	Connection * conn = &sim->servers[sim->accepted];
+	if (! CBSocketAccept(socket, &conn->socket, &sockAddr)) {
+		fail(sim, "ACCEPT");
+		return;
+	}
+	CBReleaseObject(sockAddr.ip);
+	sim->accepted++;
+	setUpConnection(sim, conn, 0);
+}
+
+void onConnect(void * vsim, void * vconn);
+void onConnect(void * vsim, void * vconn){
+	Simulator * sim = vsim;
+	Connection * conn = vconn;
+	CBSocketFreeEvent(conn->connectEvent);
+	setUpConnection(sim, conn, conn->idle ? 100 : 5000);
+	if (! conn->idle) {
+		fillMessage(conn);
+		startSend(sim, conn);
+	}
+}
+
+void onTimeOut(void * vsim, void * vconn, CBTimeOutType type);
+void onTimeOut(void * vsim, void * vconn, CBTimeOutType type){
+	Simulator * sim = vsim;
+	Connection * conn = vconn;
+	if (conn->idle && type == CB_TIMEOUT_RECEIVE && ! sim->idleTimedOut) {
+		CBSocketRemoveEvent(conn->receiveEvent);
+		__atomic_store_n(&sim->idleTimedOut, true, __ATOMIC_SEQ_CST);
+	}else
+		fail(sim, "TIMEOUT");
+}
+
+void onError(void * vsim);
+void onError(void * vsim){
+	fail(vsim, "LOOP ERROR");
+}
+
+void onTimer(void * vsim);
+void onTimer(void * vsim){
+	Simulator * sim = vsim;
+	if (__atomic_add_fetch(&sim->ticks, 1, __ATOMIC_SEQ_CST) == 5)
+		CBEndTimer(sim->timer);
+}
+
+void start(void * vsim);
+void start(void * vsim){
+	Simulator * sim = vsim;
+	if (! CBSocketBind(&sim->listenSocket, false, PORT)
+		|| ! CBSocketCanAcceptEvent(&sim->acceptEvent, sim->loop, sim->listenSocket, onAccept)
+		|| ! CBSocketAddEvent(sim->acceptEvent, 0)
+		|| ! CBSocketListen(sim->listenSocket, PEER_NUM + 1)) {
+		fail(sim, "LISTEN");
+		return;
+	}
+	if (! CBStartTimer(sim->loop, &sim->timer, 10, onTimer, sim)) {
+		fail(sim, "TIMER");
+		return;
+	}
+	unsigned char loopBack[16] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF, 127, 0, 0, 1};
+	for (int x = 0; x <= PEER_NUM; x++) {
+		Connection * conn = &sim->clients[x];
+		conn->client = true;
+		conn->idle = x == PEER_NUM;
+		if (CBNewSocket(&conn->socket, false) != CB_SOCKET_OK
+			|| ! CBSocketConnect(conn->socket, loopBack, false, PORT)
+			|| ! CBSocketDidConnectEvent(&conn->connectEvent, sim->loop, conn->socket, onConnect, conn)
+			|| ! CBSocketAddEvent(conn->connectEvent, 5000)) {
+			fail(sim, "CONNECT");
+			return;
+		}
+	}
+}
+
+void stop(void * vsim);
+void stop(void * vsim){
+	Simulator * sim = vsim;
+	for (int x = 0; x <= PEER_NUM; x++) {
+		Connection * conns[2] = {&sim->clients[x], &sim->servers[x]};
+		for (int y = 0; y < 2; y++) {
+			if (conns[y]->hasEvents) {
+				CBSocketFreeEvent(conns[y]->receiveEvent);
+				CBSocketFreeEvent(conns[y]->sendEvent);
+			}
+			if (y == 0 || x < sim->accepted)
+				CBCloseSocket(conns[y]->socket);
+		}
+	}
+	CBSocketFreeEvent(sim->acceptEvent);
+	CBCloseSocket(sim->listenSocket);
+}
+
+int main(int argc, char * argv[]){
+	UNUSED(argc);
+	Simulator * sim = calloc(1, sizeof(*sim));
+	struct timespec begin;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	if (! CBNewEventLoop(&sim->loop, onError, onTimeOut, sim)) {
+		printf("NEW LOOP FAIL\n");
+		return EXIT_FAILURE;
+	}
+	CBRunOnEventLoop(sim->loop, start, sim, true);
+	for (int x = 0; x < 60000; x++) {
+		if (__atomic_load_n(&sim->failed, __ATOMIC_SEQ_CST))
+			return EXIT_FAILURE;
+		if (__atomic_load_n(&sim->done, __ATOMIC_SEQ_CST) == PEER_NUM
+			&& __atomic_load_n(&sim->idleTimedOut, __ATOMIC_SEQ_CST)
+			&& __atomic_load_n(&sim->ticks, __ATOMIC_SEQ_CST) >= 5)
+			break;
+		usleep(1000);
+	}
+	if (sim->done != PEER_NUM || ! sim->idleTimedOut) {
+		printf("INCOMPLETE FAIL %i %i\n", sim->done, sim->idleTimedOut);
+		return EXIT_FAILURE;
+	}
+	double ms = (sim->end.tv_sec - begin.tv_sec) * 1e3 + (sim->end.tv_nsec - begin.tv_nsec) / 1e6;
+	char * name = strrchr(argv[0], '/');
+	printf("%s: %i round trips with %i peers in %f ms, %.0f round trips per second\n", name ? name + 1 : argv[0], PEER_NUM * ROUND_TRIPS, PEER_NUM, ms, PEER_NUM * ROUND_TRIPS / ms * 1e3);
+	// The timer should not fire after it has ended.
+	usleep(50000);
+	if (__atomic_load_n(&sim->ticks, __ATOMIC_SEQ_CST) != 5) {
+		printf("TIMER END FAIL %i\n", sim->ticks);
+		return EXIT_FAILURE;
+	}
+	CBRunOnEventLoop(sim->loop, stop, sim, true);
+	CBExitEventLoop(sim->loop);
+	usleep(10000);
+	free(sim);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,200 @@
+//
+//  testCBTimerWheel.c
+//  cbitcoin
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 agent
+//
+//  This file is part of cbitcoin. It is subject to the license terms
+//  in the LICENSE file found in the top-level directory of this
+//  distribution and at http://www.cbitcoin.com/license.html. No part of
+//  cbitcoin, including this file, may be copied, modified, propagated,
+//  or distributed except according to the terms contained in the
+//  LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "CBTimerWheel.h"
+
+#define TICK 100
+#define ENTRY_NUM 1000
+#define STEPS 2000
+
+typedef struct{
+	CBTimerWheelEntry entry;
+	int64_t armed; // The time the timeout was last set.
+	int timeout;
+	int expired;
+	int64_t expiredAt;
+} Timeout;
+
+typedef struct{
+	int64_t now;
+	Timeout * removeOnExpire; // Removed by the callback of the first expiry.
+	Timeout * rearmOnExpire; // Set again by the callback.
+	CBTimerWheel * wheel;
+} Clock;
+
+void onExpire(void * vclock, CBTimerWheelEntry * entry);
+void onExpire(void * vclock, CBTimerWheelEntry * entry){
+	Clock * clock = vclock;
+	Timeout * timeout = entry->owner;
+	timeout->expired++;
+	timeout->expiredAt = clock->now;
+	if (CBTimerWheelIsPending(entry)) {
+		printf("EXPIRED ENTRY PENDING FAIL\n");
+		exit(EXIT_FAILURE);
+	}
+	if (clock->removeOnExpire) {
+		CBTimerWheelRemove(&clock->removeOnExpire->entry);
+		clock->removeOnExpire = NULL;
+	}
+	if (clock->rearmOnExpire == timeout) {
+		clock->rearmOnExpire = NULL;
+		timeout->armed = clock->now;
+		CBTimerWheelSet(clock->wheel, entry, timeout->timeout);
+	}
+}
+
+void set(Clock * clock, Timeout * timeout, int ms);
+void set(Clock * clock, Timeout * timeout, int ms){
+	timeout->armed = clock->now;
+	timeout->timeout = ms;
+	CBTimerWheelSet(clock->wheel, &timeout->entry, ms);
+}
+
+void advance(Clock * clock, int64_t now);
+void advance(Clock * clock, int64_t now){
+	// Advance a tick at a time as the loop timer would, so expiry times are recorded by tick.
+	while (clock->now < now) {
+		clock->now += TICK;
+		CBTimerWheelAdvance(clock->wheel, clock->now);
+	}
+}
+
+void checkExpired(Timeout * timeout, int expired, char * test);
+void checkExpired(Timeout * timeout, int expired, char * test){
+	if (timeout->expired != expired) {
+		printf("%s EXPIRED %i != %i FAIL\n", test, timeout->expired, expired);
+		exit(EXIT_FAILURE);
+	}
+	if (expired && (timeout->expiredAt - timeout->armed < timeout->timeout
+					|| timeout->expiredAt - timeout->armed > timeout->timeout + 2 * TICK)) {
+		printf("%s EXPIRY TIME %lli AFTER %i FAIL\n", test, (long long)(timeout->expiredAt - timeout->armed), timeout->timeout);
+		exit(EXIT_FAILURE);
+	}
+}
+
+int main(){
+	unsigned int s = (unsigned int)time(NULL);
+	printf("Session = %ui\n", s);
+	srand(s);
+	CBTimerWheel * wheel = malloc(sizeof(*wheel));
+	Clock clock = {0, NULL, NULL, wheel};
+	CBInitTimerWheel(wheel, TICK, 0, onExpire, &clock);
+	Timeout a = {0}, b = {0}, c = {0};
+	CBInitTimerWheelEntry(&a.entry, &a);
+	CBInitTimerWheelEntry(&b.entry, &b);
+	CBInitTimerWheelEntry(&c.entry, &c);
+	// A timeout expires once, and not early.
+	set(&clock, &a, 1000);
+	advance(&clock, 900);
+	checkExpired(&a, 0, "SIMPLE");
+	advance(&clock, 2000);
+	checkExpired(&a, 1, "SIMPLE");
+	if (CBTimerWheelIsPending(&a.entry)) {
+		printf("SIMPLE PENDING FAIL\n");
+		return EXIT_FAILURE;
+	}
+	// Restarting a timeout before it expires extends it.
+	a.expired = 0;
+	set(&clock, &a, 500);
+	for (int x = 0; x < 20; x++) {
+		advance(&clock, clock.now + 300);
+		set(&clock, &a, 500);
+	}
+	checkExpired(&a, 0, "RESTART");
+	advance(&clock, clock.now + 800);
+	checkExpired(&a, 1, "RESTART");
+	// A shorter timeout moves the entry to an earlier slot.
+	a.expired = 0;
+	set(&clock, &a, 60000);
+	set(&clock, &a, 200);
+	advance(&clock, clock.now + 500);
+	checkExpired(&a, 1, "SHORTEN");
+	// Timeouts longer than a revolution of the wheel.
+	a.expired = 0;
+	set(&clock, &a, 3 * CB_TIMER_WHEEL_SLOTS * TICK + 50);
+	advance(&clock, clock.now + 3 * CB_TIMER_WHEEL_SLOTS * TICK);
+	checkExpired(&a, 0, "LONG");
+	advance(&clock, clock.now + 1000);
+	checkExpired(&a, 1, "LONG");
+	// Removed entries do not expire.
+	a.expired = 0;
+	set(&clock, &a, 300);
+	CBTimerWheelRemove(&a.entry);
+	CBTimerWheelRemove(&a.entry);
+	advance(&clock, clock.now + 1000);
+	checkExpired(&a, 0, "REMOVE");
+	// A zero timeout removes the entry.
+	set(&clock, &a, 300);
+	set(&clock, &a, 0);
+	advance(&clock, clock.now + 1000);
+	checkExpired(&a, 0, "ZERO");
+	// Callbacks can remove entries in the same slot and set the expired entry again.
+	a.expired = b.expired = c.expired = 0;
+	set(&clock, &a, 400);
+	set(&clock, &b, 400);
+	set(&clock, &c, 400);
+	clock.rearmOnExpire = &a;
+	clock.removeOnExpire = &b;
+	advance(&clock, clock.now + 700);
+	if (a.expired != 1 || b.expired || c.expired != 1 || clock.rearmOnExpire || CBTimerWheelIsPending(&b.entry) || ! CBTimerWheelIsPending(&a.entry)) {
+		printf("CALLBACK CHANGES FAIL\n");
+		return EXIT_FAILURE;
+	}
+	a.expired = 0;
+	advance(&clock, clock.now + 700);
+	checkExpired(&a, 1, "CALLBACK REARM");
+	// Many timeouts which are restarted and changed at random, like peers receiving data.
+	Timeout * timeouts = calloc(ENTRY_NUM, sizeof(*timeouts));
+	for (int x = 0; x < ENTRY_NUM; x++) {
+		CBInitTimerWheelEntry(&timeouts[x].entry, &timeouts[x]);
+		set(&clock, &timeouts[x], 100 + rand() % 60000);
+	}
+	for (int step = 0; step < STEPS; step++) {
+		for (int x = 0; x < ENTRY_NUM / 10; x++) {
+			Timeout * timeout = &timeouts[rand() % ENTRY_NUM];
+			if (timeout->expired)
+				continue;
+			if (rand() % 20 == 0)
+				set(&clock, timeout, 100 + rand() % 60000);
+			else
+				set(&clock, timeout, timeout->timeout);
+		}
+		advance(&clock, clock.now + TICK);
+		for (int x = 0; x < ENTRY_NUM; x++) {
+			if (timeouts[x].expired > 1) {
+				printf("RANDOM EXPIRED TWICE FAIL\n");
+				return EXIT_FAILURE;
+			}
+			if (! timeouts[x].expired && clock.now - timeouts[x].armed > timeouts[x].timeout + 2 * TICK) {
+				printf("RANDOM NOT EXPIRED FAIL\n");
+				return EXIT_FAILURE;
+			}
+			if (timeouts[x].expired)
+				checkExpired(&timeouts[x], 1, "RANDOM");
+		}
+	}
+	// Time restarting timeouts, which should not depend on the number of entries.
+	struct timespec begin, end;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (int x = 0; x < 10000000; x++)
+		CBTimerWheelSet(wheel, &timeouts[x % ENTRY_NUM].entry, 5000 + (x & 1023));
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("Restarted timeouts in %f ns each\n", ((end.tv_sec - begin.tv_sec) * 1e9 + (end.tv_nsec - begin.tv_nsec)) / 10000000);
+	free(timeouts);
+	free(wheel);
+	return EXIT_SUCCESS;
+}
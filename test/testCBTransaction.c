@@ -30,6 +30,15 @@ void CBLogError(char * format, ...){
 	printf("\n");
 }
 
+CBTransactionInputSigner signers[8];
+
+bool keyring(void * keyringObj, int input, CBTransactionInputSigner * signer);
+bool keyring(void * keyringObj, int input, CBTransactionInputSigner * signer){
+	UNUSED(keyringObj);
+	*signer = signers[input];
+	return true;
+}
+
 int main(){
 	unsigned int s = (unsigned int)time(NULL);
 	s = 1337544566;
@@ -179,7 +188,7 @@ int main(){
 	// Second output test
 	CBByteArraySetInt64(bytes, 168, randInt64);
 	CBByteArraySetVarInt(bytes, 176, CBVarIntFromUInt64(6));
-	CBByteArraySetBytes(bytes, 177, scripts[4], 7);
+	CBByteArraySetBytes(bytes, 177, scripts[4], 6);
 	// Lock time
 	CBByteArraySetInt32(bytes, 183, randInt);
 	CBTransaction * tx = CBNewTransactionFromData(bytes);
@@ -809,7 +818,7 @@ int main(){
 	unsigned char * signatures[21];
 	CBTransactionGetInputHashForSignature(tx, outputScript, 0, CB_SIGHASH_ALL, hash);
 	for (int x = 0; x < 21; x++) {
-		signatures[x] = malloc(sigSizes[x] + 1);
+		signatures[x] = malloc(ECDSA_size(keys[x]) + 1);
 		ECDSA_sign(0, hash, 32, signatures[x], &sigSizes[x], keys[x]);
 		signatures[x][sigSizes[x]] = CB_SIGHASH_ALL;
 	}
@@ -1434,6 +1443,69 @@ int main(){
 		return 1;
 	}
 	CBReleaseObject(script);
+	// Test CBTransactionSignAll
+	tx = CBNewTransaction(0, 1);
+	CBScript * signAllScripts[8];
+	signAllScripts[0] = CBNewScriptPubKeyHashOutput(CBKeyPairGetHash(keyPairs[0]));
+	signAllScripts[1] = CBNewScriptPubKeyOutput(keyPairs[1]->pubkey.key);
+	signAllScripts[2] = CBNewScriptMultisigOutput((unsigned char *[2]){keyPairs[0]->pubkey.key, keyPairs[1]->pubkey.key}, 2, 2);
+	signAllScripts[3] = CBNewScriptP2SHOutput(p2shScript);
+	for (int x = 4; x < 8; x++)
+		signAllScripts[x] = CBNewScriptPubKeyHashOutput(CBKeyPairGetHash(keyPairs[x % 2]));
+	CBSignType signAllTypes[8] = {CB_SIGHASH_ALL, CB_SIGHASH_ALL, CB_SIGHASH_ALL, CB_SIGHASH_ALL, CB_SIGHASH_ALL | CB_SIGHASH_ANYONECANPAY, CB_SIGHASH_NONE, CB_SIGHASH_SINGLE, CB_SIGHASH_ALL};
+	CBScriptOutputType signAllOutputTypes[8] = {CB_TX_OUTPUT_TYPE_KEYHASH, CB_TX_OUTPUT_TYPE_PUBKEY, CB_TX_OUTPUT_TYPE_MULTISIG, CB_TX_OUTPUT_TYPE_PUBKEY, CB_TX_OUTPUT_TYPE_KEYHASH, CB_TX_OUTPUT_TYPE_KEYHASH, CB_TX_OUTPUT_TYPE_KEYHASH, CB_TX_OUTPUT_TYPE_KEYHASH};
+	for (int x = 0; x < 8; x++) {
+		prev = CBNewByteArrayOfSize(32);
+		memset(CBByteArrayGetData(prev), x, 32);
+		CBTransactionTakeInput(tx, CBNewTransactionInput(NULL, CB_TX_INPUT_FINAL - x, prev, x));
+		CBReleaseObject(prev);
+		CBTransactionAddOutput(tx, CBNewTransactionOutput(1000 + x, signAllScripts[x]));
+		signers[x].type = signAllOutputTypes[x];
+		signers[x].prevOutSubScript = x == 3 ? p2shScript : signAllScripts[x];
+		signers[x].keys = keyPairs + (x == 2 || x == 3 ? 0 : x % 2);
+		signers[x].keyNum = x == 2 ? 2 : 1;
+		signers[x].signType = signAllTypes[x];
+		signers[x].p2shScript = x == 3 ? p2shScript : NULL;
+	}
+	// The last input is left alone
+	signers[7].keyNum = 0;
+	tx->inputs[7]->scriptObject = CBNewScriptOfSize(1);
+	CBByteArraySetByte(tx->inputs[7]->scriptObject, 0, CB_SCRIPT_OP_1);
+	// Check the hashes from the shared parts
+	CBTransactionSigHashParts parts;
+	CBTransactionGetSigHashParts(tx, &parts);
+	for (int x = 0; x < 7; x++) {
+		unsigned char partsHash[32];
+		CBTransactionGetInputHashForSignature(tx, signAllScripts[x], x, signAllTypes[x], hash);
+		CBTransactionGetInputHashForSignatureFromParts(tx, &parts, signAllScripts[x], x, signAllTypes[x], partsHash);
+		if (memcmp(hash, partsHash, 32)) {
+			printf("SIG HASH FROM PARTS FAIL %i\n", x);
+			return 1;
+		}
+	}
+	CBFreeTransactionSigHashParts(&parts);
+	if (!CBTransactionSignAll(tx, keyring, NULL, 4)) {
+		printf("CBTransactionSignAll FAIL\n");
+		return 1;
+	}
+	CBTransactionPrepareBytes(tx);
+	CBTransactionSerialise(tx, true);
+	for (int x = 0; x < 7; x++) {
+		stack = CBNewEmptyScriptStack();
+		CBScriptExecute(tx->inputs[x]->scriptObject, &stack, NULL, NULL, 0, false);
+		if (CBScriptExecute(signAllScripts[x], &stack, CBTransactionGetInputHashForSignature, tx, x, true) != CB_SCRIPT_TRUE) {
+			printf("CBTransactionSignAll EXECUTE FAIL %i\n", x);
+			return 1;
+		}
+		CBFreeScriptStack(stack);
+	}
+	if (tx->inputs[7]->scriptObject->length != 1 || CBByteArrayGetByte(tx->inputs[7]->scriptObject, 0) != CB_SCRIPT_OP_1) {
+		printf("CBTransactionSignAll UNSIGNED INPUT FAIL\n");
+		return 1;
+	}
+	for (int x = 0; x < 8; x++)
+		CBReleaseObject(signAllScripts[x]);
+	CBReleaseObject(tx);
 	// ??? Add standards tests
 	return 0;
 }
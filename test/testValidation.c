@@ -360,6 +360,16 @@ int main(){
 		return 1;
 	}
 	free(work.data);
+	// The same target with the smallest exponent
+	CBBigInt work2;
+	CBCalculateBlockWork(&work, 0x037F0000);
+	CBCalculateBlockWork(&work2, 0x04007F00);
+	if (work.length != work2.length || memcmp(work.data, work2.data, work.length)) {
+		printf("BLOCK WORK CALCULATION SMALLEST EXPONENT FAIL\n");
+		return 1;
+	}
+	free(work.data);
+	free(work2.data);
 	// Test transaction lock
 	tx = CBNewTransaction(0, 1);
 	CBScript * nullScript = CBNewScriptOfSize(0);